@@ -39,6 +39,18 @@
  * copied or reformated from the parsed XML. Clients or drivers that get more
  * than maxqsiz bytes behind are forcibly shut down.
  *
+ * Readers do not build an XML tree for each message. They only scan the text for the
+ * end of each message, with the same rules as lilxml, then pick the tag, device and
+ * name out of the opening tag to route it. The full tree is only built for the few
+ * messages that need their content, and for tracing. Each message is a slice of the
+ * buffer it was read into, and the buffer has its own usage count, so the text is
+ * never copied on its way from reader to writers. Writers send several messages in
+ * one writev(2).
+ *
+ * Each device.property that clients and snooping drivers have shown interest in is
+ * kept in a hash index with a list of who is interested, so a message is routed by
+ * looking up its device and name rather than by checking each client and driver.
+ *
  * Mutexes:
  *  [] The overall list of clients is guarded by a rwlock as clients come and go.
  *  [] Each client structure contains a mutex to guard its queue of messages.
@@ -46,7 +58,8 @@
  *  [] Each driver structure contains a mutex to guard its queue of messages.
  *  [] Each driver structure contains a rwlock to guard its list of snooping devices.
  *  [] Each driver structure contains a rwlock write-locked when/if it is restarted.
- *  [] Each message contains a mutex to guard its usage count.
+ *  [] Each subscription index contains a rwlock to guard its entries.
+ *  [] Message and buffer usage counts are changed atomically.
  *  [] The log file is marshalled by a mutex.
  *
  */
@@ -63,6 +76,7 @@
 #include <time.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include <limits.h>
 #include <pthread.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -70,6 +84,7 @@
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
@@ -83,25 +98,79 @@
 #define	REMOTEDVR	(-1234)		/* invalid PID to flag remote drivers */
 #define	MAXRBUF		40960		/* max read buffer */
 #define	MAXWSIZ		40960		/* max bytes/write */
+#define	MAXWMSGS	64		/* max Msgs/write */
+#define	MAXHDRATT	256		/* max length of tag and attributes used for routing */
+#define	MAXSCANDEPTH	32		/* max element nesting while scanning */
+#define	NIDXBUCKETS	1024		/* initial subscription index buckets, power of 2 */
 #define	DEFMAXQSIZ	50		/* default max q behind, MB */
 #define	RDRTIME		2		/* remote driver retry delay, secs */
 #define EXITEXFAIL	98		/* driver execlp failed */
 #define	RESTARTDT	10		/* don't restart a driver sooner than this, seconds */
 static char lockout_fn[] = "/tmp/noindi";	/* do not restart local driver if this exists */
 
+/* buffer that a reader reads into, holding the text of one or more Msgs.
+ * freed when the reader and the last Msg in it are finished.
+ */
+typedef struct {
+    int count;				/* n users, reader and Msgs -- change atomically */
+    int total;				/* total space at buf[] */
+    char buf[];				/* content */
+} MsgBuf;
+
 /* associate a usage count with a single message queued to potentially multiple
  * drivers or clients.
  */
 typedef struct {
-    pthread_mutex_t count_lock;		/* lock whenever changing count */
-    int count;				/* number of consumers left */
-    int total;				/* total space at cp[] */
+    int count;				/* number of consumers left -- change atomically */
+    int total;				/* total space at cp[], iff our own */
     int used;				/* cp[] space actually in use */
-    int next;				/* processing index into cp[] */
-    char *cp;				/* content: buf at first then malloced for more */
-    char buf[MAXRBUF];			/* local fast buf for most messages */
+    int root;				/* index into cp[] of root element '<' */
+    char *cp;				/* content: in bp or malloced here */
+    MsgBuf *bp;				/* buffer holding cp, or NULL if cp is our own */
 } Msg;
 
+/* states of the shallow scan for the end of a message.
+ * these follow lilxml, except content whitespace and entities are not kept.
+ */
+typedef enum {
+    SC_LOOK4START = 0,			/* looking for first element start */
+    SC_LOOK4TAG,			/* looking for element tag */
+    SC_INTAG,				/* reading tag */
+    SC_LOOK4ATTRN,			/* looking for attr name, > or / */
+    SC_INATTRN,				/* reading attr name */
+    SC_LOOK4ATTRV,			/* looking for attr value */
+    SC_SAWSLASH,			/* saw / in element opening */
+    SC_INATTRV,				/* in attr value */
+    SC_ENTINATTRV,			/* in entity in attr value */
+    SC_INCON,				/* reading content */
+    SC_ENTINCON,			/* in entity in content */
+    SC_SAWLTINCON,			/* saw < in content */
+    SC_LOOK4CLOSETAG,			/* looking for closing tag after < */
+    SC_INCLOSETAG,			/* reading closing tag */
+} ScanState;
+
+/* incremental state of reading and scanning messages from one connection.
+ * offsets are from the start of the message being scanned so they survive
+ * moving it to a new buffer.
+ */
+typedef struct {
+    MsgBuf *bp;				/* buffer being read into, or NULL */
+    int used;				/* bp->buf[] space read into */
+    int start;				/* index into bp->buf[] of message being scanned */
+    int next;				/* index into bp->buf[] of next char to scan */
+    ScanState cs;			/* current scan state */
+    int ln;				/* line number for diags */
+    int lastc;				/* last char, to find <! and <? */
+    int skipping;			/* in comment or declaration */
+    int delim;				/* attribute value delimiter */
+    int root;				/* offset of root element '<' */
+    int depth;				/* n open elements */
+    int tag[MAXSCANDEPTH];		/* offset of tag of each open element */
+    int tagl[MAXSCANDEPTH];		/* length of tag of each open element */
+    int etag;				/* offset of closing tag */
+    int etagl;				/* length of closing tag, -1 while reading it */
+} Reader;
+
 /* BLOB handling, NEVER is the default */
 typedef enum {B_NEVER=0, B_ALSO, B_ONLY} BLOBHandling;
 
@@ -115,8 +184,30 @@ typedef struct {
 typedef struct {
     Property prop;
     BLOBHandling blob;			/* when to snoop BLOBs */
+    struct _DvrInfo *dp;		/* driver doing the snooping */
 } Snoopee;
 
+/* one device.property in a subscription index, with everyone interested in it.
+ * dev or name may be empty to mean any.
+ */
+typedef struct _IdxEntry {
+    struct _IdxEntry *next;		/* next entry in same bucket */
+    unsigned int hash;			/* hash of prop */
+    Property prop;			/* device and property name */
+    void **subs;			/* malloced array of subscribers */
+    int nsubs;				/* n entries in subs[] */
+} IdxEntry;
+
+/* hash index of device.property to subscribers.
+ * subscribers are ClInfo for clients and Snoopee for drivers.
+ */
+typedef struct {
+    IdxEntry **buckets;			/* malloced array of bucket lists */
+    int nbuckets;			/* n entries in buckets[], power of 2 */
+    int nentries;			/* n entries in all buckets */
+    pthread_rwlock_t rwlock;		/* guard access to all of the above */
+} PropIndex;
+
 /* info for each connected client.
  * clinfo is a list of pointers to ClInfo pointers so they don't move when list grows.
  * list never shrinks, but entries are reused via active.
@@ -132,9 +223,9 @@ typedef struct {
     struct sockaddr_in addr;		/* client address */
     char addrname[32];			/* client host in ascii */
     int err;				/* set on fatal error */
-    LilXML *lp;				/* XML parsing context */
-    Msg *mp;				/* new incoming message */
+    Reader rd;				/* incoming message reader */
     FQ *msgq;				/* outbound Msg queue  -- guard with q_lock */
+    int qbytes;				/* total used of Msgs on msgq -- guard with q_lock */
     pthread_cond_t go_cond;		/* tell writer thread to send next msqq */
     pthread_mutex_t q_lock;		/* guard access to msqg and go_cond */
 } ClInfo;
@@ -146,7 +237,7 @@ static pthread_rwlock_t cl_rwlock;	/* guard scanning clinfo */
  * list never changes or moves so it can be an array,
  * but some may be locked if/when restarting
  */
-typedef struct {
+typedef struct _DvrInfo {
     char *name;				/* programm name or remote description */
     char dev[MAXINDIDEVICE];		/* device served by this driver */
     Snoopee **sprops;			/* malloced array of ptrs to malloced props we snoop */
@@ -162,9 +253,9 @@ typedef struct {
     pthread_t stderr_thr;		/* stderr reader thread */
     time_t start;			/* time this driver was started */
     int restarts;			/* n times this process has been restarted */
-    LilXML *lp;				/* XML parsing context */
-    Msg *mp;				/* new incoming message */
+    Reader rd;				/* incoming message reader */
     FQ *msgq;				/* outbound Msg queue  -- guard with q_lock */
+    int qbytes;				/* total used of Msgs on msgq -- guard with q_lock */
     pthread_cond_t go_cond;		/* tell writer thread to send next msqq */
     pthread_mutex_t q_lock;		/* guard access to msqg and go_cond */
     pthread_rwlock_t restart_lock;	/* lock out this device while restarting */
@@ -172,6 +263,11 @@ typedef struct {
 static DvrInfo *dvrinfo;		/* malloced array of DvrInfo */
 static int ndvrinfo;			/* n total */
 
+/* who is interested in each device.property */
+static PropIndex clprops;		/* ClInfo by props[] */
+static PropIndex clblobs;		/* ClInfo by blobs[] */
+static PropIndex snoops;		/* Snoopee by DvrInfo sprops[] */
+
 /* local variables */
 static char *me;			/* our argv[0] name */
 static int port = INDIPORT;		/* public INDI port */
@@ -201,12 +297,20 @@ static int openRemoteConnection (char host[], int port);
 static void restartDvr (DvrInfo *dp);
 static void q2Drivers (char *dev, Msg *mp, char *roottag);
 static void q2SnoopingDrivers (int isblob, char *dev, char *name, Msg *mp);
+static void q2Snooper (Snoopee *sp, int isblob, Msg *mp);
 static void q2Clients (ClInfo *notme, int isblob, char *dev, char *name, Msg *mp);
+static void q2Client (ClInfo *cp, Msg *mp);
 static void addSnoopDevice (DvrInfo *dp, char *dev, char *name);;
 static Snoopee *findSnoopDevice (DvrInfo *dp, char *dev, char *name);
 static void addClDevice (ClInfo *cp, int isblob, char *dev, char *name);
 static void rmClDevice (ClInfo *cp, int isblob, char *dev, char *name);
 static int findClDevice (ClInfo *cp, int isblob, char *dev, char *name);
+static void rmClDevices (ClInfo *cp);
+static void initIndex (PropIndex *ip);
+static IdxEntry *findIndex (PropIndex *ip, char *dev, char *name);
+static void addIndex (PropIndex *ip, char *dev, char *name, void *sub);
+static void rmIndex (PropIndex *ip, char *dev, char *name, void *sub);
+static unsigned int hashProp (const char *dev, const char *name);
 static void logMsg (const char *label, DvrInfo *dp, ClInfo *cp, Msg *mp);
 static void *driverStdoutReaderThread (void *);
 static void *driverStderrReaderThread (void *);
@@ -216,18 +320,25 @@ static void *clientWriterThread (void *);
 static void onDriverError (DvrInfo *dp);
 static void onClientError (ClInfo *cp);
 static int pushMsg (DvrInfo *dp, ClInfo *cp, Msg *mp);
-static int msgQSize (FQ *q);
+static int popMsgs (FQ *q, int *qbytes, Msg *mpa[], int maxmp);
+static int writeMsgs (int fd, Msg *mpa[], int nmp);
 static void decMsg (Msg *mp);
-static void minMsg (Msg *mp, int add);
-static Msg *splitMsg (Msg *mp, int keep);
 static Msg *newMsg (void);
 static void addMsg (Msg *mp, char buf[], int bufl);
 static void incMsg (Msg *mp);
 static void drainMsgs (FQ *qp);
+static void initReader (Reader *rp);
+static void freeReader (Reader *rp);
+static int readMore (Reader *rp, int fd);
+static Msg *nextMsg (Reader *rp, char err[]);
+static int scanXMLchar (Reader *rp, int c, int pos, char err[]);
+static void crackMsg (Msg *mp, char tag[], int natts, const char *atts[], char *valus[]);
+static XMLEle *parseMsg (Msg *mp);
+static void decBuf (MsgBuf *bp);
 static void crackBLOB (char *enableBLOB, BLOBHandling *bp);
 static void traceMsg (XMLEle *root);
 static char *tstamp (char *s);
-static void logDvrMsg (XMLEle *root, char *dev);
+static void logDvrMsg (Msg *mp, char *dev);
 static void logMessage (const char *fmt, ...);
 static char *strncpyz (char *dst, const char *src, int n);
 static void ssleep (int ms);
@@ -305,6 +416,11 @@ main (int ac, char *av[])
 	nclinfo = 0;
 	pthread_rwlock_init (&cl_rwlock, NULL);
 
+	/* prep empty subscription indices */
+	initIndex (&clprops);
+	initIndex (&clblobs);
+	initIndex (&snoops);
+
 	/* announce we are online before starting remote drivers */
 	indiListen();
 
@@ -507,9 +623,9 @@ startLocalDvr (DvrInfo *dp)
 	dp->wfd = wp[1];
     dp->efd = ep[0];
 	dp->err = 0;
-	dp->lp = newLilXML();
-	dp->mp = newMsg();
+	initReader (&dp->rd);
 	dp->msgq = newFQ(1);
+	dp->qbytes = 0;
 	pthread_mutex_init (&dp->q_lock, NULL);
 	pthread_cond_init (&dp->go_cond, NULL);
 	pthread_rwlock_init (&dp->sprops_rwlock, NULL);
@@ -590,9 +706,9 @@ startRemoteDvr (DvrInfo *dp)
 	dp->rfd = sockfd;
 	dp->wfd = sockfd;
 	dp->err = 0;
-	dp->lp = newLilXML();
-	dp->mp = newMsg();
+	initReader (&dp->rd);
 	dp->msgq = newFQ(1);
+	dp->qbytes = 0;
 	pthread_mutex_init (&dp->q_lock, NULL);
 	pthread_cond_init (&dp->go_cond, NULL);
 	pthread_rwlock_init (&dp->sprops_rwlock, NULL);
@@ -794,8 +910,7 @@ newClient()
 	memset (cp, 0, sizeof(*cp));
 	cp->active = 1;
 	cp->s = s;
-	cp->lp = newLilXML();
-	cp->mp = newMsg();
+	initReader (&cp->rd);
 	cp->msgq = newFQ(1);
 	pthread_mutex_init (&cp->q_lock, NULL);
 	pthread_cond_init (&cp->go_cond, NULL);
@@ -858,16 +973,17 @@ newClSocket ()
 static void *
 clientReaderThread (void *vp)
 {
+	static const char *atts[] = {"device", "name"};
 	ClInfo *cp = (ClInfo *)vp;
-	int i, nr;
+	int nr;
 
 	/* read until client disconnects */
 	while (1) {
-	    /* insure more message space */
-	    minMsg (cp->mp, MAXRBUF);
+	    char err[1024];
+	    Msg *mp;
 
-	    /* read more from client directly into cp->mp */
-	    nr = read (cp->s, cp->mp->cp + cp->mp->used, cp->mp->total - cp->mp->used);
+	    /* read more from client directly into its reader */
+	    nr = readMore (&cp->rd, cp->s);
 	    if (nr <= 0) {
 		if (nr < 0)
 		    logMessage ("from Client %d: read error: %s\n", cp->s, strerror(errno));
@@ -876,70 +992,66 @@ clientReaderThread (void *vp)
 		onClientError (cp);
 		return (NULL);	/* thread exit */
 	    }
-	    cp->mp->used += nr;
-
-	    /* process XML, sending when find closure */
-	    for (i = 0; i < nr; i++) {
-		char err[1024];
-		XMLEle *root = readXMLEle (cp->lp, cp->mp->cp[cp->mp->next++], err);
-		if (root) {
-		    /* found new complete message */
-
-		    char *roottag = tagXMLEle(root);
-		    char *dev = findXMLAttValu (root, "device");
-		    char *name = findXMLAttValu (root, "name");
-		    int isblob = !strcmp (roottag, "setBLOBVector");
-		    Msg *newmp;
-
-		    /* keep the good part and start a new msg with remaining */
-		    newmp = splitMsg (cp->mp, cp->mp->next);
-
-		    if (verbose > 3) {
-			logMessage ("from Client %d: read:\n", cp->s);
+
+	    /* process XML, sending each message when find closure */
+	    while ((mp = nextMsg (&cp->rd, err)) != NULL) {
+		/* found new complete message */
+
+		char roottag[MAXHDRATT], dev[MAXHDRATT], name[MAXHDRATT];
+		char *valus[] = {dev, name};
+		int isblob;
+
+		crackMsg (mp, roottag, 2, atts, valus);
+		isblob = !strcmp (roottag, "setBLOBVector");
+
+		if (verbose > 3) {
+		    XMLEle *root = parseMsg (mp);
+		    logMessage ("from Client %d: read:\n", cp->s);
+		    if (root) {
 			traceMsg (root);
-		    } else if (verbose > 2) {
-			logMessage ("from Client %d: read <%s device='%s' name='%s'>\n",
-					cp->s, roottag, dev, name);
-		    } else if (verbose > 1)
-			logMsg ("from", NULL, cp, cp->mp);
-
-		    /* enableBLOB control is just handled locally. */
-		    if (!strcmp (roottag, "enableBLOB")) {
-			BLOBHandling bh;
+			delXMLEle (root);
+		    }
+		} else if (verbose > 2) {
+		    logMessage ("from Client %d: read <%s device='%s' name='%s'>\n",
+				    cp->s, roottag, dev, name);
+		} else if (verbose > 1)
+		    logMsg ("from", NULL, cp, mp);
+
+		/* enableBLOB control is just handled locally. */
+		if (!strcmp (roottag, "enableBLOB")) {
+		    XMLEle *root = parseMsg (mp);
+		    BLOBHandling bh = B_NEVER;
+		    if (root) {
 			crackBLOB (pcdataXMLEle(root), &bh);
-			if (bh == B_ALSO || bh == B_ONLY)
-			    addClDevice (cp, 1, dev, name);
-			else
-			    rmClDevice (cp, 1, dev, name);
-			goto done;
+			delXMLEle (root);
 		    }
+		    if (bh == B_ALSO || bh == B_ONLY)
+			addClDevice (cp, 1, dev, name);
+		    else
+			rmClDevice (cp, 1, dev, name);
+		    goto done;
+		}
 
-		    /* snag interested properties */
-		    addClDevice (cp, 0, dev, name);
-
-		    /* send message to driver(s) responsible for dev */
-		    q2Drivers (dev, cp->mp, roottag);
-
-		    /* echo new* commands back to other clients */
-		    if (!strncmp (roottag, "new", 3))
-			q2Clients (cp, isblob, dev, name, cp->mp);
+		/* snag interested properties */
+		addClDevice (cp, 0, dev, name);
 
-		  done:
+		/* send message to driver(s) responsible for dev */
+		q2Drivers (dev, mp, roottag);
 
-		    /* we're done with this msg here */
-		    decMsg (cp->mp);
+		/* echo new* commands back to other clients */
+		if (!strncmp (roottag, "new", 3))
+		    q2Clients (cp, isblob, dev, name, mp);
 
-		    /* continue with newmp */
-		    cp->mp = newmp;
+	      done:
 
-		    /* done with root */
-		    delXMLEle (root);
+		/* we're done with this msg here */
+		decMsg (mp);
+	    }
 
-		} else if (err[0]) {
-		    logMessage ("from Client %d: XML error: %s\n", cp->s, err);
-		    onClientError (cp);
-		    return (NULL);	/* thread exit */
-		}
+	    if (err[0]) {
+		logMessage ("from Client %d: XML error: %s\n", cp->s, err);
+		onClientError (cp);
+		return (NULL);	/* thread exit */
 	    }
 	}
 
@@ -948,15 +1060,15 @@ clientReaderThread (void *vp)
 }
 
 /* thread to send Msgs to the given client.
- * wait for CV, pop message from queue, send and free if we are the last user.
+ * wait for CV, pop messages from queue, send and free each if we are the last user.
  * shut down this client and return if trouble.
  */
 static void *
 clientWriterThread (void *vp)
 {
 	ClInfo *cp = (ClInfo *)vp;
-	int nsent, nsend, nw;
-	Msg *mp;
+	Msg *mpa[MAXWMSGS];
+	int i, nmp;
 
 
 	while (1) {
@@ -976,44 +1088,34 @@ clientWriterThread (void *vp)
 
 	    } else {
 
-		/* get next message */
-		mp = (Msg *) popFQ (cp->msgq);
-		if (!mp)
+		/* get next messages */
+		nmp = popMsgs (cp->msgq, &cp->qbytes, mpa, MAXWMSGS);
+		if (nmp == 0)
 		    Bye ("Bug! Client %d message queue is empty!\n", cp->s);
 		if (verbose > 1)
-		    logMsg ("send to", NULL, cp, mp);
+		    for (i = 0; i < nmp; i++)
+			logMsg ("send to", NULL, cp, mpa[i]);
 
-		/* ok to let others q us more msgs while we send this one */
+		/* ok to let others q us more msgs while we send these */
 		pthread_mutex_unlock (&cp->q_lock);
 
-		/* send */
-		for (nsent = 0; nsent < mp->used; nsent += nw) {
-		    nsend = mp->used - nsent;
-		    if (nsend > MAXWSIZ)
-			nsend = MAXWSIZ;
-		    nw = write (cp->s, mp->cp+nsent, nsend);
-		    if (nw <= 0) {
-			if (nw == 0)
-			    logMessage ("to Client %d: write returned 0 with %d on q\n", cp->s, nFQ(cp->msgq));
-			else if (verbose > 1 || errno != EPIPE) {
-			    /* EPIPE errors are not reported because they are
-			     * too numerous to be interesting as we wait for
-			     * clientReader to detect problem and set dp->err
-			     */
-			    logMessage ("to Client %d: write with %d on q: %s\n", cp->s, nFQ(cp->msgq),
-			    							strerror(errno));
-			}
-
-			/* give up, let reader thread discover pipe error and set cp->err */
-			break;
+		/* send, each followed by one more nl to help DOM parsers */
+		if (writeMsgs (cp->s, mpa, nmp) < 0) {
+		    if (verbose > 1 || errno != EPIPE) {
+			/* EPIPE errors are not reported because they are
+			 * too numerous to be interesting as we wait for
+			 * clientReader to detect problem and set dp->err
+			 */
+			logMessage ("to Client %d: write with %d on q: %s\n", cp->s, nFQ(cp->msgq),
+									strerror(errno));
 		    }
-		}
 
-		/* one more nl to help DOM parsers */
-		(void) write (cp->s, "\n", 1);
+		    /* give up, let reader thread discover pipe error and set cp->err */
+		}
 
-		/* finished with this message, even if error sending */
-		decMsg (mp);
+		/* finished with these messages, even if error sending */
+		for (i = 0; i < nmp; i++)
+		    decMsg (mpa[i]);
 	    }
 	}
 
@@ -1028,15 +1130,16 @@ clientWriterThread (void *vp)
 static void *
 driverStdoutReaderThread (void *vp)
 {
+	static const char *atts[] = {"device", "name"};
 	DvrInfo *dp = (DvrInfo *)vp;
-	int i, nr;
+	int nr;
 
 	while (1) {
-	    /* insure more message space */
-	    minMsg (dp->mp, MAXRBUF);
+	    char err[1024];
+	    Msg *mp;
 
 	    /* read more from driver */
-	    nr = read (dp->rfd, dp->mp->cp + dp->mp->used, dp->mp->total - dp->mp->used);
+	    nr = readMore (&dp->rd, dp->rfd);
 	    if (nr <= 0) {
 		if (nr < 0)
 		    logMessage ("from Driver %s: stdin %s\n", dp->name, strerror(errno));
@@ -1045,80 +1148,77 @@ driverStdoutReaderThread (void *vp)
 		onDriverError (dp);
 		return (NULL);	/* thread exit */
 	    }
-	    dp->mp->used += nr;
-
-	    /* process XML, sending when find closure */
-	    for (i = 0; i < nr; i++) {
-		char err[1024];
-		XMLEle *root = readXMLEle (dp->lp, dp->mp->cp[dp->mp->next++], err);
-		if (root) {
-		    /* found new complete message */
-
-		    char *roottag = tagXMLEle(root);
-		    char *dev = findXMLAttValu (root, "device");
-		    char *name = findXMLAttValu (root, "name");
-		    int isblob = !strcmp (roottag, "setBLOBVector");
-		    Msg *newmp;
-
-		    /* keep the good part and start a new msg with remaining */
-		    newmp = splitMsg (dp->mp, dp->mp->next);
-
-		    if (verbose > 3) {
-			logMessage ("from Driver %s: read:\n", dp->name);
+
+	    /* process XML, sending each message when find closure */
+	    while ((mp = nextMsg (&dp->rd, err)) != NULL) {
+		/* found new complete message */
+
+		char roottag[MAXHDRATT], dev[MAXHDRATT], name[MAXHDRATT];
+		char *valus[] = {dev, name};
+		int isblob;
+
+		crackMsg (mp, roottag, 2, atts, valus);
+		isblob = !strcmp (roottag, "setBLOBVector");
+
+		if (verbose > 3) {
+		    XMLEle *root = parseMsg (mp);
+		    logMessage ("from Driver %s: read:\n", dp->name);
+		    if (root) {
 			traceMsg (root);
-		    } else if (verbose > 2) {
-			logMessage ("from Driver %s: read <%s device='%s' name='%s'>\n",
-					dp->name, roottag, dev, name);
-		    } else if (verbose > 1)
-			logMsg ("from", dp, NULL, dp->mp);
-
-		    /* that's all if driver is just registering a snoop */
-		    if (!strcmp (roottag, "getProperties")) {
-			addSnoopDevice (dp, dev, name);
-                        q2Drivers (dev, dp->mp, roottag);        // force initial report
-			goto done;
+			delXMLEle (root);
 		    }
+		} else if (verbose > 2) {
+		    logMessage ("from Driver %s: read <%s device='%s' name='%s'>\n",
+				    dp->name, roottag, dev, name);
+		} else if (verbose > 1)
+		    logMsg ("from", dp, NULL, mp);
+
+		/* that's all if driver is just registering a snoop */
+		if (!strcmp (roottag, "getProperties")) {
+		    addSnoopDevice (dp, dev, name);
+		    q2Drivers (dev, mp, roottag);        // force initial report
+		    goto done;
+		}
 
-		    /* that's all if driver is just registering a BLOB mode */
-		    if (!strcmp (roottag, "enableBLOB")) {
-			Snoopee *sp = findSnoopDevice (dp, dev, name);
-			if (sp)
+		/* that's all if driver is just registering a BLOB mode */
+		if (!strcmp (roottag, "enableBLOB")) {
+		    Snoopee *sp = findSnoopDevice (dp, dev, name);
+		    if (sp) {
+			XMLEle *root = parseMsg (mp);
+			if (root) {
 			    crackBLOB (pcdataXMLEle (root), &sp->blob);
-			goto done;
-		    }
-
-		    /* snag device name if not known yet */
-		    if (!dp->dev[0] && dev[0]) {
-			strncpyz (dp->dev, dev, MAXINDIDEVICE-1);
-			if (verbose > 1)
-			    logMessage ("Driver %s snooping for %s\n", dp->name, dp->dev);
+			    delXMLEle (root);
+			}
 		    }
+		    goto done;
+		}
 
-		    /* log messages if any */
-		    logDvrMsg (root, dev);
-
-		    /* send to interested clients */
-		    q2Clients (NULL, isblob, dev, name, dp->mp);
+		/* snag device name if not known yet */
+		if (!dp->dev[0] && dev[0]) {
+		    strncpyz (dp->dev, dev, MAXINDIDEVICE-1);
+		    if (verbose > 1)
+			logMessage ("Driver %s snooping for %s\n", dp->name, dp->dev);
+		}
 
-		    /* send to snooping drivers */
-		    q2SnoopingDrivers (isblob, dev, name, dp->mp);
+		/* log messages if any */
+		logDvrMsg (mp, dev);
 
-		done:
+		/* send to interested clients */
+		q2Clients (NULL, isblob, dev, name, mp);
 
-		    /* we're done with this msg here */
-		    decMsg (dp->mp);
+		/* send to snooping drivers */
+		q2SnoopingDrivers (isblob, dev, name, mp);
 
-		    /* continue with newmp */
-		    dp->mp = newmp;
+	    done:
 
-		    /* done with root */
-		    delXMLEle (root);
+		/* we're done with this msg here */
+		decMsg (mp);
+	    }
 
-		} else if (err[0]) {
-		    logMessage ("Driver %s: XML error: %s\n", dp->name, err);
-		    onDriverError (dp);
-		    return (NULL);	/* thread exit */
-		}
+	    if (err[0]) {
+		logMessage ("Driver %s: XML error: %s\n", dp->name, err);
+		onDriverError (dp);
+		return (NULL);	/* thread exit */
 	    }
 	}
 
@@ -1167,15 +1267,15 @@ driverStderrReaderThread (void *vp)
 }
 
 /* thread to send Msgs to the given local driver.
- * wait for CV, pop message from queue, send and free if we are the last user.
+ * wait for CV, pop messages from queue, send and free each if we are the last user.
  * restart this driver if trouble.
  */
 static void *
 driverWriterThread (void *vp)
 {
 	DvrInfo *dp = (DvrInfo *)vp;
-	int nsent, nsend, nw;
-	Msg *mp;
+	Msg *mpa[MAXWMSGS];
+	int i, nmp;
 
 	while (1) {
 
@@ -1194,43 +1294,33 @@ driverWriterThread (void *vp)
 
 	    } else {
 
-		/* get next message */
-		mp = (Msg *) popFQ (dp->msgq);
-		if (!mp)
+		/* get next messages */
+		nmp = popMsgs (dp->msgq, &dp->qbytes, mpa, MAXWMSGS);
+		if (nmp == 0)
 		    Bye ("Bug! Driver %s message queue is empty!\n", dp->name);
 		if (verbose > 1)
-		    logMsg ("send to", dp, NULL, mp);
+		    for (i = 0; i < nmp; i++)
+			logMsg ("send to", dp, NULL, mpa[i]);
 
-		/* ok to let others q us more msgs while we send this one */
+		/* ok to let others q us more msgs while we send these */
 		pthread_mutex_unlock (&dp->q_lock);
 
-		/* send */
-		for (nsent = 0; nsent < mp->used; nsent += nw) {
-		    nsend = mp->used - nsent;
-		    if (nsend > MAXWSIZ)
-			nsend = MAXWSIZ;
-		    nw = write (dp->wfd, mp->cp+nsent, nsend);
-		    if (nw <= 0) {
-			if (nw == 0)
-			    logMessage ("to Driver %s: write returned 0 with %d on q\n", dp->name, nFQ(dp->msgq));
-			else if (verbose > 1 || errno != EPIPE) {
-			    /* EPIPE errors are not reported because they are
-			     * too numerous to be interesting as we wait for
-			     * driverStdinReader to detect problem and set dp->err
-			     */
-			    logMessage ("to Driver %s: write with %d on q: %s\n", dp->name, nFQ(dp->msgq), strerror(errno));
-			}
-
-			/* give up, let reader thread discover pipe error and set dp->err */
-			break;
+		/* send, each followed by one more nl to help DOM parsers */
+		if (writeMsgs (dp->wfd, mpa, nmp) < 0) {
+		    if (verbose > 1 || errno != EPIPE) {
+			/* EPIPE errors are not reported because they are
+			 * too numerous to be interesting as we wait for
+			 * driverStdinReader to detect problem and set dp->err
+			 */
+			logMessage ("to Driver %s: write with %d on q: %s\n", dp->name, nFQ(dp->msgq), strerror(errno));
 		    }
-		}
 
-		/* one more nl to help DOM parsers */
-		(void) write (dp->wfd, "\n", 1);
+		    /* give up, let reader thread discover pipe error and set dp->err */
+		}
 
-		/* finished with this message, even if error sending */
-		decMsg (mp);
+		/* finished with these messages, even if error sending */
+		for (i = 0; i < nmp; i++)
+		    decMsg (mpa[i]);
 	    }
 	}
 
@@ -1278,10 +1368,10 @@ shutdownClient (ClInfo *cp)
 	close (cp->s);
 
 	/* free memory and locks */
-	delLilXML (cp->lp);
+	rmClDevices (cp);
+	freeReader (&cp->rd);
 	free (cp->props);
 	free (cp->blobs);
-	decMsg (cp->mp);
 	pthread_mutex_destroy (&cp->q_lock);
 	pthread_cond_destroy (&cp->go_cond);
 	pthread_rwlock_destroy (&cp->props_rwlock);
@@ -1366,11 +1456,15 @@ restartDvr (DvrInfo *dp)
 
 	/* free memory and locks */
 	logMessage ("Driver %s: freeing memory and locks\n", dp->name);
-	for (i = 0; i < dp->nsprops; i++)
+	pthread_rwlock_wrlock (&snoops.rwlock);
+	for (i = 0; i < dp->nsprops; i++) {
+	    Property *pp = &dp->sprops[i]->prop;
+	    rmIndex (&snoops, pp->dev, pp->name, dp->sprops[i]);
 	    free (dp->sprops[i]);
+	}
+	pthread_rwlock_unlock (&snoops.rwlock);
 	free (dp->sprops);
-	delLilXML (dp->lp);
-	decMsg (dp->mp);
+	freeReader (&dp->rd);
 	pthread_mutex_destroy (&dp->q_lock);
 	pthread_cond_destroy (&dp->go_cond);
 	pthread_rwlock_destroy (&dp->sprops_rwlock);
@@ -1457,43 +1551,73 @@ q2Drivers (char *dev, Msg *mp, char *roottag)
 
 /* put Msg mp on queue of each driver snooping dev/name.
  * if is BLOB always honor current mode.
+ * N.B. a driver snooping both dev.name and all of dev only uses the former, as
+ *   that is the one findSnoopDevice() would find first.
  */
 static void
 q2SnoopingDrivers (int isblob, char *dev, char *name, Msg *mp)
 {
-	DvrInfo *dp;
-	int ql;
+	IdxEntry *exact, *any;
+	int i, j;
 
-	/* queue message to each driver if it is not restarting and
-	 * it is snooping for this dev/name
-	 */
-	for (dp = dvrinfo; dp < &dvrinfo[ndvrinfo]; dp++) {
+	/* read access */
+	pthread_rwlock_rdlock (&snoops.rwlock);
+
+	/* those snooping exactly dev.name */
+	exact = findIndex (&snoops, dev, name);
+	if (exact)
+	    for (i = 0; i < exact->nsubs; i++)
+		q2Snooper ((Snoopee *) exact->subs[i], isblob, mp);
+
+	/* those snooping all of dev, unless already done */
+	any = name[0] ? findIndex (&snoops, dev, "") : NULL;
+	if (any) {
+	    for (i = 0; i < any->nsubs; i++) {
+		Snoopee *sp = (Snoopee *) any->subs[i];
+		for (j = 0; exact && j < exact->nsubs; j++)
+		    if (((Snoopee *) exact->subs[j])->dp == sp->dp)
+			break;
+		if (!exact || j == exact->nsubs)
+		    q2Snooper (sp, isblob, mp);
+	    }
+	}
 
-	    if (pthread_rwlock_tryrdlock (&dp->restart_lock) == 0) {
+	/* unlock */
+	pthread_rwlock_unlock (&snoops.rwlock);
+}
 
-		Snoopee *sp = findSnoopDevice (dp, dev, name);
+/* put Msg mp on queue of the driver of Snoopee sp unless it is restarting.
+ * if is BLOB always honor current mode.
+ */
+static void
+q2Snooper (Snoopee *sp, int isblob, Msg *mp)
+{
+	DvrInfo *dp = sp->dp;
+	int ql;
 
-		/* nothing for dp if not snooping for dev/name or wrong BLOB mode */
-		if (sp && !((isblob && sp->blob==B_NEVER) || (!isblob && sp->blob==B_ONLY))) {
+	/* nothing for dp if wrong BLOB mode */
+	if ((isblob && sp->blob==B_NEVER) || (!isblob && sp->blob==B_ONLY))
+	    return;
 
-		    /* ok: queue message to this driver -- beware it getting too far behind */
-		    ql = pushMsg (dp, NULL, mp);
-		    if (ql > maxqsiz) {
-			logMessage ("Driver %s: %d bytes behind in %d messages, restarting\n",
-						    dp->name, ql, nFQ(dp->msgq));
+	/* N.B. only try, restartDvr holds restart_lock while it waits for snoops.rwlock */
+	if (pthread_rwlock_tryrdlock (&dp->restart_lock) == 0) {
 
-			/* close reader socket to force driverStdoutReader to set err */
-			close (dp->rfd);
+	    /* ok: queue message to this driver -- beware it getting too far behind */
+	    ql = pushMsg (dp, NULL, mp);
+	    if (ql > maxqsiz) {
+		logMessage ("Driver %s: %d bytes behind in %d messages, restarting\n",
+					    dp->name, ql, nFQ(dp->msgq));
 
-			/* just blow away stderr reader, if we have one */
-			if (dp->pid != REMOTEDVR)
-			    pthread_cancel (dp->stderr_thr);
-		    }
-		}
+		/* close reader socket to force driverStdoutReader to set err */
+		close (dp->rfd);
 
-		/* done with this dvr */
-		pthread_rwlock_unlock (&dp->restart_lock);
+		/* just blow away stderr reader, if we have one */
+		if (dp->pid != REMOTEDVR)
+		    pthread_cancel (dp->stderr_thr);
 	    }
+
+	    /* done with this dvr */
+	    pthread_rwlock_unlock (&dp->restart_lock);
 	}
 }
 
@@ -1518,10 +1642,18 @@ addSnoopDevice (DvrInfo *dp, char *dev, char *name)
 	if (!dp->sprops)
 	    Bye ("No memory to add %d snoop device to %s.%s\n", dp->nsprops+1, dev, name);
 	sp = dp->sprops[dp->nsprops++] = (Snoopee *) calloc (1, sizeof(Snoopee));
+	if (!sp)
+	    Bye ("No memory for snoop device %s.%s\n", dev, name);
 
 	strncpyz (sp->prop.dev, dev, MAXINDIDEVICE-1);
 	strncpyz (sp->prop.name, name, MAXINDINAME-1);
 	sp->blob = B_NEVER;
+	sp->dp = dp;
+
+	/* index it too */
+	pthread_rwlock_wrlock (&snoops.rwlock);
+	addIndex (&snoops, sp->prop.dev, sp->prop.name, sp);
+	pthread_rwlock_unlock (&snoops.rwlock);
 
 	/* unlock */
 	pthread_rwlock_unlock (&dp->sprops_rwlock);
@@ -1559,45 +1691,92 @@ findSnoopDevice (DvrInfo *dp, char *dev, char *name)
 
 /* put Msg mp on queue of each client interested in dev/name, except notme.
  * if BLOB always honor current mode.
+ * N.B. addClDevice() never adds a property that overlaps one a client already has,
+ *   so no client can be found under more than one of the index entries we look up.
  */
 static void
 q2Clients (ClInfo *notme, int isblob, char *dev, char *name, Msg *mp)
 {
+	PropIndex *ip = isblob ? &clblobs : &clprops;
 	ClInfo *cp;
-	int i, ql;
+	int i;
 
 	/* read access */
 	pthread_rwlock_rdlock (&cl_rwlock);
 
-	/* queue message to each interested client */
-	for (i = 0; i < nclinfo; i++) {
-	    /* in use? notme? want this dev/name? blob? */
-	    cp = clinfo[i];
-	    if (!cp->active || cp == notme)
-		continue;
-	    if (findClDevice (cp, isblob, dev, name) < 0)
-		continue;
+	if (!dev[0] || !name[0]) {
+
+	    /* message for any device or property: check each client */
+	    for (i = 0; i < nclinfo; i++) {
+		/* in use? notme? want this dev/name? blob? */
+		cp = clinfo[i];
+		if (!cp->active || cp == notme)
+		    continue;
+		if (findClDevice (cp, isblob, dev, name) < 0)
+		    continue;
+		q2Client (cp, mp);
+	    }
 
-	    /* ok: queue message to this client -- beware it getting too far behind */
-            if (verbose > 2)
-                logMsg ("queue to", NULL, cp, mp);
-	    ql = pushMsg (NULL, cp, mp);
-	    if (ql > maxqsiz) {
-		logMessage ("Client %d: %d bytes behind in %d messages, shutting down\n",
-					cp->s, ql, nFQ(cp->msgq));
-		/* close socket to force clientReader to set err */
-		shutdown (cp->s, SHUT_RDWR);
-		close (cp->s);
+	} else {
+
+	    /* look up those interested in dev.name, all of dev, name of any dev, or everything */
+	    char *devs[] = {dev, dev, "", ""};
+	    char *names[] = {name, "", name, ""};
+	    ClInfo *cpbuf[64], **cpa = cpbuf;
+	    int j, ncp = 0;
+
+	    if (nclinfo > 64) {
+		cpa = (ClInfo **) malloc (nclinfo*sizeof(ClInfo *));
+		if (!cpa)
+		    Bye ("No memory to route to %d clients\n", nclinfo);
+	    }
+
+	    pthread_rwlock_rdlock (&ip->rwlock);
+	    for (i = 0; i < 4; i++) {
+		IdxEntry *ep = findIndex (ip, devs[i], names[i]);
+		for (j = 0; ep && j < ep->nsubs && ncp < nclinfo; j++) {
+		    cp = (ClInfo *) ep->subs[j];
+		    if (cp->active && cp != notme)
+			cpa[ncp++] = cp;
+		}
 	    }
+	    pthread_rwlock_unlock (&ip->rwlock);
+
+	    for (i = 0; i < ncp; i++)
+		q2Client (cpa[i], mp);
+
+	    if (cpa != cpbuf)
+		free (cpa);
 	}
 
 	/* unlock */
 	pthread_rwlock_unlock (&cl_rwlock);
 }
 
+/* put Msg mp on queue of client cp.
+ * N.B. we assume cl_rwlock is already read-locked.
+ */
+static void
+q2Client (ClInfo *cp, Msg *mp)
+{
+	int ql;
+
+	/* ok: queue message to this client -- beware it getting too far behind */
+	if (verbose > 2)
+	    logMsg ("queue to", NULL, cp, mp);
+	ql = pushMsg (NULL, cp, mp);
+	if (ql > maxqsiz) {
+	    logMessage ("Client %d: %d bytes behind in %d messages, shutting down\n",
+				    cp->s, ql, nFQ(cp->msgq));
+	    /* close socket to force clientReader to set err */
+	    shutdown (cp->s, SHUT_RDWR);
+	    close (cp->s);
+	}
+}
+
 
 /* increment mp count then push it onto dp or cp's queue for writing.
- * while we have the q locked find the total size of its messages.
+ * while we have the q locked add to the total size of its messages.
  */
 static int
 pushMsg (DvrInfo *dp, ClInfo *cp, Msg *mp)
@@ -1605,15 +1784,18 @@ pushMsg (DvrInfo *dp, ClInfo *cp, Msg *mp)
 	FQ *qp;
 	pthread_mutex_t *lp;
 	pthread_cond_t *vp;
+	int *bp;
 	int n;
 
 	/* get appropriate q and locks */
 	if (dp) {
 	    qp = dp->msgq;
+	    bp = &dp->qbytes;
 	    lp = &dp->q_lock;
 	    vp = &dp->go_cond;
 	} else if (cp) {
 	    qp = cp->msgq;
+	    bp = &cp->qbytes;
 	    lp = &cp->q_lock;
 	    vp = &cp->go_cond;
 	} else
@@ -1625,13 +1807,74 @@ pushMsg (DvrInfo *dp, ClInfo *cp, Msg *mp)
 	/* push onto this queue, handy time to get size too */
 	pthread_mutex_lock (lp);
 	pushFQ (qp, mp);
-	n = msgQSize (qp);
+	n = (*bp += mp->used);
 	pthread_cond_signal (vp);
 	pthread_mutex_unlock (lp);
 
 	return (n);
 }
 
+/* pop up to maxmp Msgs from q into mpa[], but no more than MAXWSIZ bytes unless the
+ *   first is larger, and take them off the total size at qbytes.
+ * return number popped.
+ * N.B. we assume q is already locked.
+ */
+static int
+popMsgs (FQ *q, int *qbytes, Msg *mpa[], int maxmp)
+{
+	int nmp = 0, l = 0;
+
+	while (nmp < maxmp && nFQ(q) > 0) {
+	    Msg *mp = (Msg *) peekFQ (q);
+	    if (nmp > 0 && l + mp->used > MAXWSIZ)
+		break;
+	    (void) popFQ (q);
+	    mpa[nmp++] = mp;
+	    l += mp->used;
+	    *qbytes -= mp->used;
+	}
+
+	return (nmp);
+}
+
+/* write the nmp Msgs in mpa[] to fd, each followed by a nl, with as few calls as possible.
+ * return 0 if ok, else -1 with errno.
+ */
+static int
+writeMsgs (int fd, Msg *mpa[], int nmp)
+{
+	struct iovec iov[2*MAXWMSGS], *iop = iov;
+	int i, niov = 0;
+
+	for (i = 0; i < nmp; i++) {
+	    iov[niov].iov_base = mpa[i]->cp;
+	    iov[niov++].iov_len = mpa[i]->used;
+	    iov[niov].iov_base = (void *) "\n";
+	    iov[niov++].iov_len = 1;
+	}
+
+	/* loop until all sent, picking up after partial writes */
+	while (niov > 0) {
+	    ssize_t nw = writev (fd, iop, niov > IOV_MAX ? IOV_MAX : niov);
+	    if (nw <= 0) {
+		if (nw == 0)
+		    errno = EIO;
+		return (-1);
+	    }
+	    while (niov > 0 && (size_t)nw >= iop->iov_len) {
+		nw -= iop->iov_len;
+		iop++;
+		niov--;
+	    }
+	    if (niov > 0) {
+		iop->iov_base = (char *)iop->iov_base + nw;
+		iop->iov_len -= nw;
+	    }
+	}
+
+	return (0);
+}
+
 /* log message mp associated with either dp or cp (not both) with a label.
  * label is typically "from" or "to".
  */
@@ -1639,46 +1882,33 @@ static void
 logMsg (const char *label, DvrInfo *dp, ClInfo *cp, Msg *mp)
 {
 	XMLEle *root;
-	char ynot[1024];
 	char *roottag, *dev, *name, *pc;
+	int count;
 
 	/* parse and pull apart a little bit */
-	root = parseXML (mp->cp, ynot);
+	root = parseMsg (mp);
 	if (!root)
 	    return;
 	roottag = tagXMLEle(root);
 	dev = findXMLAttValu (root, "device");
 	name = findXMLAttValu (root, "name");
 	pc = pcdataXMLEle (root);
+	count = __atomic_load_n (&mp->count, __ATOMIC_RELAXED);
 
 	/* print enough to be recognized */
 	if (dp)
 	    logMessage ("%s Driver %s: q depth %d, msg count %d: \"<%.4s %s.%s>%.10s\"\n",
-			label, dp->name, nFQ(dp->msgq), mp->count,
+			label, dp->name, nFQ(dp->msgq), count,
 			    roottag, dev[0] ? dev : "*", name[0] ? name : "*", pc);
 	else if (cp)
 	    logMessage ("%s Client %d: q depth %d, msg count %d: \"<%.4s %s.%s>%.10s\"\n",
-			label, cp->s, nFQ(cp->msgq), mp->count,
+			label, cp->s, nFQ(cp->msgq), count,
 			    roottag, dev[0] ? dev : "*", name[0] ? name : "*", pc);
 
 	delXMLEle (root);
 }
 
-/* return total size of all Msqs on the given q */
-static int
-msgQSize (FQ *q)
-{
-	int i, l = 0;
-
-	for (i = 0; i < nFQ(q); i++) {
-	    Msg *mp = (Msg *) peekiFQ(q,i);
-	    l += mp->used;
-	}
-
-	return (l);
-}
-
-/* return pointer to one new empty Msg,
+/* return pointer to one new empty Msg with its own storage,
  * counting us as the first user.
  */
 static Msg *
@@ -1688,20 +1918,27 @@ newMsg (void)
 	if (!newmp)
 	    Bye ("No memory for new Msg\n");
 	newmp->count = 1;
+	newmp->total = 0;
 	newmp->used = 0;
-	newmp->next = 0;
-	newmp->cp = newmp->buf;
-	newmp->total = sizeof(newmp->buf);
-	pthread_mutex_init (&newmp->count_lock, NULL);
+	newmp->root = 0;
+	newmp->cp = NULL;
+	newmp->bp = NULL;
 	return (newmp);
 }
 
-/* add buf[bufl] to mp, growing if necessary
+/* add buf[bufl] to mp, growing if necessary.
+ * N.B. only for Msgs with their own storage, ie, not from nextMsg().
  */
 static void
 addMsg (Msg *mp, char buf[], int bufl)
 {
-	minMsg (mp, bufl);
+	if (mp->total - mp->used < bufl) {
+	    int newtot = mp->used + bufl;
+	    mp->cp = (char *) realloc (mp->cp, newtot);
+	    if (!mp->cp)
+		Bye ("No memory to grow Msg to %d\n", newtot);
+	    mp->total = newtot;
+	}
 	memcpy (mp->cp + mp->used, buf, bufl);
 	mp->used += bufl;
 }
@@ -1710,9 +1947,7 @@ addMsg (Msg *mp, char buf[], int bufl)
 static void
 incMsg (Msg *mp)
 {
-	pthread_mutex_lock (&mp->count_lock);
-	mp->count += 1;
-	pthread_mutex_unlock (&mp->count_lock);
+	__atomic_add_fetch (&mp->count, 1, __ATOMIC_RELAXED);
 }
 
 /* decrement count, free if reaches 0.
@@ -1721,61 +1956,448 @@ incMsg (Msg *mp)
 static void
 decMsg (Msg *mp)
 {
-	pthread_mutex_lock (&mp->count_lock);
-	if (--mp->count <= 0) {
-	    if (mp->cp != mp->buf)
+	if (__atomic_sub_fetch (&mp->count, 1, __ATOMIC_ACQ_REL) <= 0) {
+	    if (mp->bp)
+		decBuf (mp->bp);
+	    else
 		free (mp->cp);
-	    pthread_mutex_destroy (&mp->count_lock);
 	    free (mp);
-	} else
-	    pthread_mutex_unlock (&mp->count_lock);
+	}
 }
 
+/* decrement bp count, free if reaches 0.
+ */
+static void
+decBuf (MsgBuf *bp)
+{
+	if (__atomic_sub_fetch (&bp->count, 1, __ATOMIC_ACQ_REL) <= 0)
+	    free (bp);
+}
 
-/* insure mp has at least min unused.
+/* free all Msgs in the given q
  */
 static void
-minMsg (Msg *mp, int min)
-{
-	int unused = mp->total - mp->used;
-	if (unused < min) {
-	    int newtot = mp->used + 2*min;
-	    if (mp->cp == mp->buf) {
-		/* first time, use malloc and copy from buf */
-		mp->cp = (char *) malloc (newtot);
-		if (!mp->cp)
-		    Bye ("No memory for new minMsg cp of %d\n", newtot);
-		memcpy (mp->cp, mp->buf, mp->used);
-	    } else {
-		/* already from heap, just realloc */
-		mp->cp = (char *) realloc (mp->cp, newtot);
-		if (!mp->cp)
-		    Bye ("No memory to grow cp in minMsg to %d\n", newtot);
+drainMsgs (FQ *qp)
+{
+	Msg *mp;
+
+	while ((mp = (Msg*) popFQ(qp)) != NULL)
+	    decMsg (mp);	/* decrements count and frees at 0 */
+}
+
+/* init a Reader with no buffer yet, ready to scan for a new message.
+ */
+static void
+initReader (Reader *rp)
+{
+	memset (rp, 0, sizeof(*rp));
+	rp->cs = SC_LOOK4START;
+	rp->ln = 1;
+}
+
+/* finished with rp, release its buffer.
+ */
+static void
+freeReader (Reader *rp)
+{
+	if (rp->bp)
+	    decBuf (rp->bp);
+	initReader (rp);
+}
+
+/* read more from fd into rp.
+ * if rp has too little room left, move the part of the message being scanned to
+ * a new buffer, leaving the Msgs already found in the old one.
+ * return count as from read(2).
+ */
+static int
+readMore (Reader *rp, int fd)
+{
+	int nr;
+
+	if (!rp->bp || rp->bp->total - rp->used < MAXRBUF/2) {
+	    int partial = rp->bp ? rp->used - rp->start : 0;
+	    int newtot = MAXRBUF + 2*partial;
+	    MsgBuf *newbp = (MsgBuf *) malloc (sizeof(MsgBuf) + newtot);
+	    if (!newbp)
+		Bye ("No memory for new read buffer of %d\n", newtot);
+	    newbp->count = 1;
+	    newbp->total = newtot;
+	    if (rp->bp) {
+		memcpy (newbp->buf, rp->bp->buf + rp->start, partial);
+		rp->next -= rp->start;
+		decBuf (rp->bp);
 	    }
-	    mp->total = newtot;
+	    rp->bp = newbp;
+	    rp->used = partial;
+	    rp->start = 0;
 	}
+
+	nr = read (fd, rp->bp->buf + rp->used, rp->bp->total - rp->used);
+	if (nr > 0)
+	    rp->used += nr;
+	return (nr);
 }
 
-/* retain only nkeep in mp and return new Msg with remainder.
+/* scan what rp has read so far for the end of the next message.
+ * if found return a new Msg with its text, still in the read buffer, and start over.
+ * if need more return NULL with err[0] = '\0'.
+ * if real trouble, return NULL with reason in err[].
+ * N.B. this follows readXMLEle(), including its handling of <! and <?, so it finds the
+ *   same messages and errors, but it does not build the tree.
  */
 static Msg *
-splitMsg (Msg *mp, int nkeep)
+nextMsg (Reader *rp, char err[])
 {
-	Msg *newmp = newMsg();
-	addMsg (newmp, mp->cp + nkeep, mp->used - nkeep);
-	mp->used = nkeep;
-	return (newmp);
+	err[0] = '\0';
+
+	while (rp->next < rp->used) {
+	    int c = (unsigned char) rp->bp->buf[rp->next];
+	    int pos = rp->next++ - rp->start;
+	    int s;
+
+	    /* EOF? */
+	    if (c == 0) {
+		sprintf (err, "Line %d: early XML EOF", rp->ln);
+		return (NULL);
+	    }
+
+	    /* new line? */
+	    if (c == '\n')
+		rp->ln++;
+
+	    /* skip comments and declarations. requires 1 char history */
+	    if (!rp->skipping && rp->lastc == '<' && (c == '?' || c == '!')) {
+		rp->skipping = 1;
+		rp->lastc = c;
+		continue;
+	    }
+	    if (rp->skipping) {
+		if (c == '>')
+		    rp->skipping = 0;
+		rp->lastc = c;
+		continue;
+	    }
+	    if (c == '<') {
+		rp->lastc = '<';
+		continue;
+	    }
+
+	    /* do a pending '<' first then c */
+	    if (rp->lastc == '<' && scanXMLchar (rp, '<', pos-1, err) < 0)
+		return (NULL);
+
+	    s = scanXMLchar (rp, c, pos, err);
+	    if (s < 0)
+		return (NULL);
+	    if (s == 0) {
+		rp->lastc = c;
+		continue;
+	    }
+
+	    /* found closure: Msg is a slice of the buffer */
+	    {
+		Msg *mp = (Msg *) malloc (sizeof(Msg));
+		if (!mp)
+		    Bye ("No memory for new Msg\n");
+		mp->count = 1;
+		mp->total = 0;
+		mp->used = rp->next - rp->start;
+		mp->root = rp->root;
+		mp->cp = rp->bp->buf + rp->start;
+		mp->bp = rp->bp;
+		__atomic_add_fetch (&rp->bp->count, 1, __ATOMIC_RELAXED);
+
+		/* start over with the next message */
+		rp->start = rp->next;
+		rp->cs = SC_LOOK4START;
+		rp->ln = 1;
+		rp->lastc = 0;
+		rp->depth = 0;
+
+		return (mp);
+	    }
+	}
+
+	return (NULL);
 }
 
-/* free all Msgs in the given q
+/* 1 if c is a valid token character, else 0.
+ * it can be alpha or '_' or numeric unless start.
+ */
+static int
+isTokenChar (int start, int c)
+{
+	return (isalpha(c) || c == '_' || (!start && isdigit(c)));
+}
+
+/* process one more char at pos from the start of the message being scanned by rp.
+ * if find final closure, return 1.
+ * if need more, return 0.
+ * if real trouble, return -1 and put reason in err.
+ */
+static int
+scanXMLchar (Reader *rp, int c, int pos, char err[])
+{
+	char *msg = rp->bp->buf + rp->start;
+
+	switch (rp->cs) {
+	case SC_LOOK4START:		/* looking for first element start */
+	    if (c == '<') {
+		rp->root = pos;
+		rp->depth = 1;
+		rp->cs = SC_LOOK4TAG;
+	    }
+	    /* silently ignore until resync */
+	    break;
+
+	case SC_LOOK4TAG:		/* looking for element tag */
+	    if (isTokenChar (1, c)) {
+		rp->tag[rp->depth-1] = pos;
+		rp->cs = SC_INTAG;
+	    } else if (!isspace(c)) {
+		sprintf (err, "Line %d: Bogus tag char %c", rp->ln, c);
+		return (-1);
+	    }
+	    break;
+
+	case SC_INTAG:			/* reading tag */
+	    if (isTokenChar (0, c))
+		break;
+	    rp->tagl[rp->depth-1] = pos - rp->tag[rp->depth-1];
+	    if (c == '>')
+		rp->cs = SC_INCON;
+	    else if (c == '/')
+		rp->cs = SC_SAWSLASH;
+	    else
+		rp->cs = SC_LOOK4ATTRN;
+	    break;
+
+	case SC_LOOK4ATTRN:		/* looking for attr name, > or / */
+	    if (c == '>')
+		rp->cs = SC_INCON;
+	    else if (c == '/')
+		rp->cs = SC_SAWSLASH;
+	    else if (isTokenChar (1, c))
+		rp->cs = SC_INATTRN;
+	    else if (!isspace(c)) {
+		sprintf (err, "Line %d: Bogus leading attr name char: %c", rp->ln, c);
+		return (-1);
+	    }
+	    break;
+
+	case SC_SAWSLASH:		/* saw / in element opening */
+	    if (c == '>') {
+		if (rp->depth == 1)
+		    return (1);		/* root has no content */
+		rp->depth--;
+		rp->cs = SC_INCON;
+	    } else {
+		sprintf (err, "Line %d: Bogus char %c before >", rp->ln, c);
+		return (-1);
+	    }
+	    break;
+
+	case SC_INATTRN:		/* reading attr name */
+	    if (isspace(c) || c == '=')
+		rp->cs = SC_LOOK4ATTRV;
+	    else if (!isTokenChar (0, c)) {
+		sprintf (err, "Line %d: Bogus attr name char: %c", rp->ln, c);
+		return (-1);
+	    }
+	    break;
+
+	case SC_LOOK4ATTRV:		/* looking for attr value */
+	    if (c == '\'' || c == '"') {
+		rp->delim = c;
+		rp->cs = SC_INATTRV;
+	    } else if (!(isspace(c) || c == '=')) {
+		sprintf (err, "Line %d: No value for attribute", rp->ln);
+		return (-1);
+	    }
+	    break;
+
+	case SC_INATTRV:		/* in attr value */
+	    if (c == '&')
+		rp->cs = SC_ENTINATTRV;
+	    else if (c == rp->delim)
+		rp->cs = SC_LOOK4ATTRN;
+	    break;
+
+	case SC_ENTINATTRV:		/* working on entity in attr valu */
+	    if (c == ';')
+		rp->cs = SC_INATTRV;
+	    break;
+
+	case SC_INCON:			/* reading content */
+	    if (c == '&')
+		rp->cs = SC_ENTINCON;
+	    else if (c == '<')
+		rp->cs = SC_SAWLTINCON;
+	    break;
+
+	case SC_ENTINCON:		/* working on entity in content */
+	    if (c == ';')
+		rp->cs = SC_INCON;
+	    break;
+
+	case SC_SAWLTINCON:		/* saw < in content */
+	    if (c == '/') {
+		rp->cs = SC_LOOK4CLOSETAG;
+	    } else {
+		if (rp->depth == MAXSCANDEPTH) {
+		    sprintf (err, "Line %d: elements nested more than %d deep", rp->ln, MAXSCANDEPTH);
+		    return (-1);
+		}
+		rp->depth++;
+		if (isTokenChar (1, c)) {
+		    rp->tag[rp->depth-1] = pos;
+		    rp->cs = SC_INTAG;
+		} else
+		    rp->cs = SC_LOOK4TAG;
+	    }
+	    break;
+
+	case SC_LOOK4CLOSETAG:		/* looking for closing tag after < */
+	    if (isTokenChar (1, c)) {
+		rp->etag = pos;
+		rp->etagl = -1;
+		rp->cs = SC_INCLOSETAG;
+	    } else if (!isspace(c)) {
+		sprintf (err, "Line %d: Bogus preend tag char %c", rp->ln, c);
+		return (-1);
+	    }
+	    break;
+
+	case SC_INCLOSETAG:		/* reading closing tag */
+	    if (isTokenChar (0, c) && rp->etagl < 0)
+		break;
+	    if (c == '>') {
+		int d = rp->depth-1;
+		if (rp->etagl < 0)
+		    rp->etagl = pos - rp->etag;
+		if (rp->etagl != rp->tagl[d] || strncmp (msg+rp->etag, msg+rp->tag[d], rp->etagl)) {
+		    sprintf (err, "Line %d: closing tag %.*s does not match %.*s", rp->ln,
+					rp->etagl, msg+rp->etag, rp->tagl[d], msg+rp->tag[d]);
+		    return (-1);
+		} else if (rp->depth > 1) {
+		    rp->depth--;
+		    rp->cs = SC_INCON;	/* back to content after nested elem */
+		} else
+		    return (1);		/* yes! */
+	    } else if (isspace(c)) {
+		if (rp->etagl < 0)
+		    rp->etagl = pos - rp->etag;
+	    } else {
+		sprintf (err, "Line %d: Bogus end tag char %c", rp->ln, c);
+		return (-1);
+	    }
+	    break;
+	}
+
+	return (0);
+}
+
+/* pick apart the opening tag of the root element of mp without building a tree.
+ * copy its tag to tag[] and the value of each of the natts attributes named in atts[]
+ * to the same entry of valus[], or "" if absent. each is MAXHDRATT long, longer values
+ * are truncated. values are decoded as by lilxml.
  */
 static void
-drainMsgs (FQ *qp)
+crackMsg (Msg *mp, char tag[], int natts, const char *atts[], char *valus[])
 {
-	Msg *mp;
+	char *s = mp->cp + mp->root + 1;
+	char *end = mp->cp + mp->used;
+	int i, l;
 
-	while ((mp = (Msg*) popFQ(qp)) != NULL)
-	    decMsg (mp);	/* decrements count and frees at 0 */
+	for (i = 0; i < natts; i++)
+	    valus[i][0] = '\0';
+
+	/* tag */
+	while (s < end && isspace((unsigned char)*s))
+	    s++;
+	for (l = 0; s < end && isTokenChar (l == 0, (unsigned char)*s); s++)
+	    if (l < MAXHDRATT-1)
+		tag[l++] = *s;
+	tag[l] = '\0';
+
+	/* each attribute, until end of opening tag */
+	while (s < end) {
+	    char *an, *valu = NULL;
+	    int anl, delim;
+
+	    while (s < end && isspace((unsigned char)*s))
+		s++;
+	    if (s == end || *s == '>' || *s == '/')
+		break;
+
+	    /* name, and whether we want it */
+	    an = s;
+	    while (s < end && isTokenChar (0, (unsigned char)*s))
+		s++;
+	    anl = s - an;
+	    for (i = 0; i < natts; i++)
+		if (!strncmp (atts[i], an, anl) && atts[i][anl] == '\0')
+		    valu = valus[i];
+
+	    /* value */
+	    while (s < end && (isspace((unsigned char)*s) || *s == '='))
+		s++;
+	    if (s == end)
+		break;
+	    delim = *s++;
+	    for (l = 0; s < end && *s != delim; ) {
+		int c = (unsigned char) *s++;
+		if (c == '&') {
+		    /* entity runs to ; even past delim, as in lilxml */
+		    static const char *ents[] = {"amp;&", "apos;'", "lt;<", "gt;>", "quot;\""};
+		    char *semi = memchr (s, ';', end - s);
+		    char *ent = s - 1;
+		    if (!semi)
+			break;
+		    s = semi + 1;
+		    for (i = 0; i < 5; i++) {
+			int el = strchr (ents[i], ';') - ents[i] + 1;
+			if (el == semi - ent && !strncmp (ents[i], ent+1, el))
+			    break;
+		    }
+		    if (i < 5) {
+			if (valu && l < MAXHDRATT-1)
+			    valu[l++] = ents[i][strlen(ents[i])-1];
+		    } else {
+			for (; ent < s; ent++)
+			    if (valu && l < MAXHDRATT-1)
+				valu[l++] = *ent;
+		    }
+		} else if (valu && !iscntrl(c) && l < MAXHDRATT-1)
+		    valu[l++] = c;
+	    }
+	    if (valu)
+		valu[l] = '\0';
+	    s++;	/* skip delim */
+	}
+}
+
+/* return the full XML tree of mp, else NULL.
+ * N.B. it is up to the caller to delete any tree returned with delXMLEle().
+ */
+static XMLEle *
+parseMsg (Msg *mp)
+{
+	LilXML *lp = newLilXML();
+	XMLEle *root = NULL;
+	char ynot[1024];
+	int i;
+
+	for (i = 0; i < mp->used; i++) {
+	    root = readXMLEle (lp, mp->cp[i], ynot);
+	    if (root || ynot[0])
+		break;
+	}
+
+	delLilXML (lp);
+
+	return (root);
 }
 
 /* return index of props[] or blobs[] if cp may be interested in dev/name
@@ -1819,6 +2441,7 @@ findClDevice (ClInfo *cp, int isblob, char *dev, char *name)
 static void
 addClDevice (ClInfo *cp, int isblob, char *dev, char *name)
 {
+	PropIndex *ip;
 	Property *pp;
 
 	/* no dups */
@@ -1851,6 +2474,12 @@ addClDevice (ClInfo *cp, int isblob, char *dev, char *name)
 	strncpyz (pp->dev, dev, MAXINDIDEVICE-1);
 	strncpyz (pp->name, name, MAXINDINAME-1);
 
+	/* index it too */
+	ip = isblob ? &clblobs : &clprops;
+	pthread_rwlock_wrlock (&ip->rwlock);
+	addIndex (ip, pp->dev, pp->name, cp);
+	pthread_rwlock_unlock (&ip->rwlock);
+
 	/* unlock and finished */
 	pthread_rwlock_unlock (&cp->props_rwlock);
 }
@@ -1862,27 +2491,173 @@ addClDevice (ClInfo *cp, int isblob, char *dev, char *name)
 static void
 rmClDevice (ClInfo *cp, int isblob, char *dev, char *name)
 {
+	PropIndex *ip = isblob ? &clblobs : &clprops;
 	int i;
 
 	while ((i = findClDevice (cp, isblob, dev, name)) >= 0) {
 
 	    /* protect while modifying */
 	    pthread_rwlock_wrlock (&cp->props_rwlock);
+	    pthread_rwlock_wrlock (&ip->rwlock);
 
-	    if (isblob)
+	    if (isblob) {
+		rmIndex (ip, cp->blobs[i].dev, cp->blobs[i].name, cp);
 		memmove (&cp->blobs[i], &cp->blobs[i+1],
 			    (--cp->nblobs - i)*sizeof(Property));
-	    else
+	    } else {
+		rmIndex (ip, cp->props[i].dev, cp->props[i].name, cp);
 		memmove (&cp->props[i], &cp->props[i+1],
 			    (--cp->nprops - i)*sizeof(Property));
+	    }
 
 	    /* don't bother to realloc smaller, also avoids dealing with empty array */
 
 	    /* unlock */
+	    pthread_rwlock_unlock (&ip->rwlock);
 	    pthread_rwlock_unlock (&cp->props_rwlock);
 	}
 }
 
+/* remove all of client cp's props[] and blobs[] from the indices.
+ */
+static void
+rmClDevices (ClInfo *cp)
+{
+	int i;
+
+	pthread_rwlock_wrlock (&clprops.rwlock);
+	for (i = 0; i < cp->nprops; i++)
+	    rmIndex (&clprops, cp->props[i].dev, cp->props[i].name, cp);
+	pthread_rwlock_unlock (&clprops.rwlock);
+
+	pthread_rwlock_wrlock (&clblobs.rwlock);
+	for (i = 0; i < cp->nblobs; i++)
+	    rmIndex (&clblobs, cp->blobs[i].dev, cp->blobs[i].name, cp);
+	pthread_rwlock_unlock (&clblobs.rwlock);
+}
+
+/* init ip with no entries.
+ */
+static void
+initIndex (PropIndex *ip)
+{
+	ip->nbuckets = NIDXBUCKETS;
+	ip->nentries = 0;
+	ip->buckets = (IdxEntry **) calloc (ip->nbuckets, sizeof(IdxEntry *));
+	if (!ip->buckets)
+	    Bye ("No memory for subscription index\n");
+	pthread_rwlock_init (&ip->rwlock, NULL);
+}
+
+/* return 32 bit FNV-1a hash of dev and name.
+ */
+static unsigned int
+hashProp (const char *dev, const char *name)
+{
+	unsigned int h = 2166136261u;
+
+	for (; *dev; dev++)
+	    h = (h ^ (unsigned char)*dev) * 16777619u;
+	h = (h ^ '.') * 16777619u;
+	for (; *name; name++)
+	    h = (h ^ (unsigned char)*name) * 16777619u;
+
+	return (h);
+}
+
+/* return the entry in ip for exactly dev and name, else NULL.
+ * N.B. we assume ip->rwlock is already locked.
+ */
+static IdxEntry *
+findIndex (PropIndex *ip, char *dev, char *name)
+{
+	unsigned int h = hashProp (dev, name);
+	IdxEntry *ep;
+
+	for (ep = ip->buckets[h & (ip->nbuckets-1)]; ep; ep = ep->next)
+	    if (ep->hash == h && !strcmp (ep->prop.dev, dev) && !strcmp (ep->prop.name, name))
+		return (ep);
+
+	return (NULL);
+}
+
+/* add sub to the entry in ip for dev and name, adding the entry if new.
+ * N.B. we assume ip->rwlock is already write-locked.
+ */
+static void
+addIndex (PropIndex *ip, char *dev, char *name, void *sub)
+{
+	IdxEntry *ep = findIndex (ip, dev, name);
+
+	if (!ep) {
+	    /* grow to keep buckets short */
+	    if (ip->nentries >= 2*ip->nbuckets) {
+		int newn = 2*ip->nbuckets;
+		IdxEntry **newb = (IdxEntry **) calloc (newn, sizeof(IdxEntry *));
+		int i;
+		if (!newb)
+		    Bye ("No memory to grow subscription index to %d\n", newn);
+		for (i = 0; i < ip->nbuckets; i++) {
+		    while ((ep = ip->buckets[i]) != NULL) {
+			ip->buckets[i] = ep->next;
+			ep->next = newb[ep->hash & (newn-1)];
+			newb[ep->hash & (newn-1)] = ep;
+		    }
+		}
+		free (ip->buckets);
+		ip->buckets = newb;
+		ip->nbuckets = newn;
+	    }
+
+	    ep = (IdxEntry *) calloc (1, sizeof(IdxEntry));
+	    if (!ep)
+		Bye ("No memory for subscription index entry %s.%s\n", dev, name);
+	    ep->hash = hashProp (dev, name);
+	    strncpyz (ep->prop.dev, dev, MAXINDIDEVICE-1);
+	    strncpyz (ep->prop.name, name, MAXINDINAME-1);
+	    ep->next = ip->buckets[ep->hash & (ip->nbuckets-1)];
+	    ip->buckets[ep->hash & (ip->nbuckets-1)] = ep;
+	    ip->nentries++;
+	}
+
+	ep->subs = (void **) realloc (ep->subs, (ep->nsubs+1)*sizeof(void *));
+	if (!ep->subs)
+	    Bye ("No memory to add %d subscribers to %s.%s\n", ep->nsubs+1, dev, name);
+	ep->subs[ep->nsubs++] = sub;
+}
+
+/* remove sub from the entry in ip for dev and name, and the entry if now empty.
+ * harmless if absent.
+ * N.B. we assume ip->rwlock is already write-locked.
+ */
+static void
+rmIndex (PropIndex *ip, char *dev, char *name, void *sub)
+{
+	unsigned int h = hashProp (dev, name);
+	IdxEntry **epp, *ep;
+	int i;
+
+	for (epp = &ip->buckets[h & (ip->nbuckets-1)]; (ep = *epp) != NULL; epp = &ep->next)
+	    if (ep->hash == h && !strcmp (ep->prop.dev, dev) && !strcmp (ep->prop.name, name))
+		break;
+	if (!ep)
+	    return;
+
+	for (i = 0; i < ep->nsubs; i++) {
+	    if (ep->subs[i] == sub) {
+		memmove (&ep->subs[i], &ep->subs[i+1], (--ep->nsubs - i)*sizeof(void *));
+		break;
+	    }
+	}
+
+	if (ep->nsubs == 0) {
+	    *epp = ep->next;
+	    free (ep->subs);
+	    free (ep);
+	    ip->nentries--;
+	}
+}
+
 /* convert the string value of enableBLOB to our B_ state value.
  * default to NEVER if unrecognized.
  */
@@ -1946,16 +2721,20 @@ tstamp (char *s)
 	return (s);
 }
 
-/* log any message in root (known to be from device dev)
+/* log any message in mp (known to be from device dev)
  */
 static void
-logDvrMsg (XMLEle *root, char *dev)
+logDvrMsg (Msg *mp, char *dev)
 {
+	static const char *atts[] = {"message", "timestamp"};
+	char tag[MAXHDRATT], msg[MAXHDRATT], tsa[MAXHDRATT];
+	char *valus[] = {msg, tsa};
 	char stamp[64];
 	char *ts, *ms;
 
 	/* get message, if any */
-	ms = findXMLAttValu (root, "message");
+	crackMsg (mp, tag, 2, atts, valus);
+	ms = msg;
 	if (!ms[0])
 	    return;
 
@@ -1963,7 +2742,7 @@ logDvrMsg (XMLEle *root, char *dev)
 	pthread_mutex_lock (&log_lock);
 
 	/* get timestamp now if not provided */
-	ts = findXMLAttValu (root, "timestamp");
+	ts = tsa;
 	if (!ts[0])
 	    ts = tstamp (stamp);
 
@@ -2027,14 +2806,16 @@ logMessage (const char *fmt, ...)
 	pthread_mutex_unlock (&log_lock);
 }
 
-/* exactly like strncpy() but insures dst is terminated if src happens to have exactly n chars.
+/* like strncpy() but copies at most n chars then always terminates, so dst must hold n+1.
+ * the copy is sized with strnlen() rather than left to strncpy(), which gcc warns may truncate.
  */
 static char *
 strncpyz (char *dst, const char *src, int n)
 {
-	char *dp = strncpy (dst, src, n);
-	dp[n] = '\0';
-	return (dp);
+	size_t l = strnlen (src, n);
+	memcpy (dst, src, l);
+	dst[l] = '\0';
+	return (dst);
 }
 
 /* sleep that uses select(2), just to avoid the signals sleep(3) might use.
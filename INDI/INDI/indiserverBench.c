@@ -0,0 +1,674 @@
+/* indiserverBench: replay INDI traffic through an indiserver and measure routing.
+ *
+ * The given indiserver is started with one remote driver per device in the traffic,
+ *   each of which connects back to us, so we play all the drivers. We also connect
+ *   the given number of clients. Then each message of the traffic is written by the
+ *   driver of its device, as fast as possible or at the given rate, and the time of
+ *   each arrival at each client and snooping driver is recorded.
+ *
+ * The traffic is a file of INDI XML as sent by indiserver to a client, which is
+ *   easily recorded from a running system with, for example,
+ *     echo "<getProperties version='1.7'/>" | nc localhost 7624 > night.xml
+ *   If no file is given, traffic is generated.
+ *
+ * Each message is tagged with an extra attribute, bseq, holding its sequence number
+ *   so its arrivals can be matched to when it was sent.
+ *
+ * Reported are the rate of messages through the server, and percentiles of the
+ *   latency from a driver sending a message to each recipient reading it, and to the
+ *   last recipient reading it.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "lilxml.h"
+#include "indiapi.h"
+
+#define	DEFPORT		7700		/* default indiserver port */
+#define	DEFNCLIENTS	12		/* default n clients who want everything */
+#define	DEFNDCLIENTS	12		/* default n clients who want one device */
+#define	DEFNSNOOPS	4		/* default n properties snooped by each driver */
+#define	DEFNGEN		200000		/* default n messages to generate */
+#define	DEFNGENDEV	70		/* default n devices to generate */
+#define	NGENPROPS	20		/* n properties of each generated device */
+#define	QUIETMS		1000		/* done when nothing arrives for this long, ms */
+#define	MAXRBUF		65536		/* read buffer */
+
+/* one message of the traffic */
+typedef struct {
+    int dev;				/* index into devs[] */
+    char *name;				/* property name, malloced */
+    char *txt;				/* text to send with bseq, malloced */
+    int len;				/* strlen(txt) */
+} BMsg;
+
+/* one connection whose arrivals we record */
+typedef struct {
+    int fd;				/* socket */
+    char carry[32];			/* end of last read, in case bseq is split */
+    int ncarry;				/* n used in carry[] */
+} Conn;
+
+static char *me;			/* our argv[0] name */
+static char **devs;			/* malloced list of malloced device names */
+static int ndevs;			/* n in devs[] */
+static int *dvrfd;			/* socket for each of devs[] */
+static BMsg *msgs;			/* malloced list of messages to replay */
+static int nmsgs;			/* n in msgs[] */
+static double *sendt;			/* time each msgs[] was sent */
+static double *lastt;			/* time each msgs[] last arrived */
+static float *lat;			/* malloced latency of each arrival, secs */
+static int nlat, mlat;			/* n used and malloced in lat[] */
+static Conn *conns;			/* malloced list of connections to watch */
+static int nconns;			/* n in conns[] */
+static volatile int done;		/* tell receiver to stop */
+static volatile double lastrecv;	/* time of last arrival */
+
+static void usage (void);
+static void loadTraffic (char *fn);
+static void genTraffic (int n, int ndev);
+static void addMsg (char *txt, int len, char *dev, char *name);
+static int findDev (char *dev);
+static int listenOn (int port);
+static int connectTo (int port);
+static void startServer (char *server, int port, int dport, pid_t *pidp);
+static void acceptDrivers (int lfd);
+static void sendStr (int fd, const char *s);
+static void *receiverThread (void *);
+static void scanArrivals (Conn *cp, char *buf, int n, double now);
+static double now (void);
+static void sleepUntil (double t);
+static int cmpf (const void *a, const void *b);
+static void Bye (const char *fmt, ...);
+
+int
+main (int ac, char *av[])
+{
+	char *server, *fn = NULL;
+	int port = DEFPORT;
+	int nclients = DEFNCLIENTS;
+	int ndclients = DEFNDCLIENTS;
+	int nsnoops = DEFNSNOOPS;
+	int ngen = DEFNGEN;
+	int ngendev = DEFNGENDEV;
+	double rate = 0;
+	pthread_t rthr;
+	pid_t pid;
+	double t0, t1;
+	int lfd, i, j;
+	float *fanout;
+	int nfanout;
+
+	me = av[0];
+
+	/* crack args */
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++) {
+		if (ac < 2)
+		    usage();
+		switch (*s) {
+		case 'c': nclients = atoi(*++av); break;
+		case 'd': ndclients = atoi(*++av); break;
+		case 'g': ngen = atoi(*++av); break;
+		case 'n': ngendev = atoi(*++av); break;
+		case 'p': port = atoi(*++av); break;
+		case 'r': rate = atof(*++av); break;
+		case 's': nsnoops = atoi(*++av); break;
+		default: usage();
+		}
+		ac--;
+	    }
+	}
+	if (ac < 1 || ac > 2)
+	    usage();
+	server = av[0];
+	if (ac == 2)
+	    fn = av[1];
+
+	signal (SIGPIPE, SIG_IGN);
+	srand (1);
+
+	/* get the traffic */
+	if (fn)
+	    loadTraffic (fn);
+	else
+	    genTraffic (ngen, ngendev);
+	if (nmsgs == 0)
+	    Bye ("No messages to replay\n");
+	fprintf (stderr, "%d messages from %d devices\n", nmsgs, ndevs);
+
+	sendt = (double *) calloc (nmsgs, sizeof(double));
+	lastt = (double *) calloc (nmsgs, sizeof(double));
+	conns = (Conn *) calloc (ndevs + nclients + ndclients, sizeof(Conn));
+	if (!sendt || !lastt || !conns)
+	    Bye ("No memory for %d messages\n", nmsgs);
+
+	/* start the server with each device as a remote driver connecting to us */
+	lfd = listenOn (port+1);
+	startServer (server, port, port+1, &pid);
+	acceptDrivers (lfd);
+	close (lfd);
+
+	/* each driver snoops on some properties of other devices */
+	for (i = 0; i < ndevs; i++) {
+	    for (j = 0; j < nsnoops; j++) {
+		BMsg *mp = &msgs[rand() % nmsgs];
+		char buf[1024];
+		if (mp->dev == i)
+		    continue;
+		snprintf (buf, sizeof(buf), "<getProperties version='%g' device='%s' name='%s'/>\n",
+						INDIV, devs[mp->dev], mp->name);
+		sendStr (dvrfd[i], buf);
+	    }
+	}
+
+	/* clients who want everything, then clients who want one device */
+	for (i = 0; i < nclients + ndclients; i++) {
+	    char buf[1024];
+	    int fd = connectTo (port);
+	    if (i < nclients)
+		snprintf (buf, sizeof(buf), "<getProperties version='%g'/>\n", INDIV);
+	    else
+		snprintf (buf, sizeof(buf), "<getProperties version='%g' device='%s'/>\n",
+						INDIV, devs[rand() % ndevs]);
+	    sendStr (fd, buf);
+	    conns[nconns++].fd = fd;
+	}
+
+	/* let it settle then start recording arrivals */
+	sleepUntil (now() + 1);
+	lastrecv = now();
+	if (pthread_create (&rthr, NULL, receiverThread, NULL))
+	    Bye ("receiver thread: %s\n", strerror(errno));
+
+	/* replay */
+	t0 = now();
+	for (i = 0; i < nmsgs; i++) {
+	    BMsg *mp = &msgs[i];
+	    int nw, ns;
+
+	    if (rate > 0)
+		sleepUntil (t0 + i/rate);
+
+	    sendt[i] = now();
+	    for (ns = 0; ns < mp->len; ns += nw) {
+		nw = write (dvrfd[mp->dev], mp->txt + ns, mp->len - ns);
+		if (nw <= 0)
+		    Bye ("write to driver %s: %s\n", devs[mp->dev], strerror(errno));
+	    }
+	}
+	t1 = now();
+
+	/* wait until quiet */
+	while (now() - lastrecv < QUIETMS/1000.0)
+	    sleepUntil (now() + QUIETMS/10000.0);
+	done = 1;
+	pthread_join (rthr, NULL);
+
+	kill (pid, SIGTERM);
+	waitpid (pid, NULL, 0);
+
+	/* fanout is complete when the last recipient has it */
+	fanout = (float *) malloc (nmsgs * sizeof(float));
+	if (!fanout)
+	    Bye ("No memory for %d messages\n", nmsgs);
+	for (nfanout = i = 0; i < nmsgs; i++)
+	    if (lastt[i] > 0)
+		fanout[nfanout++] = lastt[i] - sendt[i];
+
+	if (nlat == 0)
+	    Bye ("Nothing arrived\n");
+	qsort (lat, nlat, sizeof(float), cmpf);
+	qsort (fanout, nfanout, sizeof(float), cmpf);
+
+	printf ("messages       %d in %.3f s sending, %.3f s until last arrival\n",
+						nmsgs, t1-t0, lastrecv-t0);
+	printf ("msgs/sec       %.0f\n", nmsgs/(lastrecv-t0));
+	printf ("arrivals       %d, %.1f per message, %.0f/sec\n", nlat, (double)nlat/nmsgs,
+						nlat/(lastrecv-t0));
+	printf ("arrival  usec  p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n",
+		1e6*lat[nlat/2], 1e6*lat[(int)(nlat*0.90)], 1e6*lat[(int)(nlat*0.99)], 1e6*lat[nlat-1]);
+	printf ("fanout   usec  p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n",
+		1e6*fanout[nfanout/2], 1e6*fanout[(int)(nfanout*0.90)],
+		1e6*fanout[(int)(nfanout*0.99)], 1e6*fanout[nfanout-1]);
+
+	return (0);
+}
+
+/* print usage message and exit (2) */
+static void
+usage(void)
+{
+	fprintf (stderr,"Usage: %s [options] indiserver [traffic.xml]\n", me);
+	fprintf (stderr,"Purpose: replay INDI traffic through indiserver, report msgs/sec and latency\n");
+	fprintf (stderr,"Options:\n");
+	fprintf (stderr," -c n : clients who want everything, default %d\n", DEFNCLIENTS);
+	fprintf (stderr," -d n : clients who want one device, default %d\n", DEFNDCLIENTS);
+	fprintf (stderr," -g n : messages to generate if no traffic given, default %d\n", DEFNGEN);
+	fprintf (stderr," -n n : devices to generate if no traffic given, default %d\n", DEFNGENDEV);
+	fprintf (stderr," -p p : indiserver port, drivers use p+1, default %d\n", DEFPORT);
+	fprintf (stderr," -r r : send r messages/sec, default as fast as possible\n");
+	fprintf (stderr," -s n : properties snooped by each driver, default %d\n", DEFNSNOOPS);
+
+	exit (2);
+}
+
+/* read the messages in fn.
+ */
+static void
+loadTraffic (char *fn)
+{
+	LilXML *lp = newLilXML();
+	char ynot[1024];
+	char *buf = NULL;
+	long nbuf = 0, mbuf = 0, start = 0;
+	FILE *fp;
+	int c;
+
+	fp = fopen (fn, "r");
+	if (!fp)
+	    Bye ("%s: %s\n", fn, strerror(errno));
+
+	while ((c = getc (fp)) != EOF) {
+	    XMLEle *root;
+
+	    if (nbuf == mbuf) {
+		mbuf = mbuf ? 2*mbuf : MAXRBUF;
+		buf = (char *) realloc (buf, mbuf);
+		if (!buf)
+		    Bye ("No memory to read %s\n", fn);
+	    }
+	    buf[nbuf++] = c;
+
+	    root = readXMLEle (lp, c, ynot);
+	    if (root) {
+		char *dev = findXMLAttValu (root, "device");
+		if (dev[0])
+		    addMsg (buf+start, nbuf-start, dev, findXMLAttValu (root, "name"));
+		delXMLEle (root);
+		start = nbuf;
+	    } else if (ynot[0])
+		Bye ("%s: %s\n", fn, ynot);
+	}
+
+	fclose (fp);
+	free (buf);
+	delLilXML (lp);
+}
+
+/* generate n messages from ndev devices, like a quiet night.
+ */
+static void
+genTraffic (int n, int ndev)
+{
+	char buf[4096], dev[64], name[64];
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+	    int l;
+
+	    snprintf (dev, sizeof(dev), "dev%02d", rand() % ndev);
+	    snprintf (name, sizeof(name), "prop%02d", rand() % NGENPROPS);
+	    l = snprintf (buf, sizeof(buf),
+		"<setNumberVector device='%s' name='%s' state='Ok' timeout='0' timestamp='2026-10-17T02:00:%02d.%06d'>\n",
+								dev, name, i/1000000 % 60, i % 1000000);
+	    for (j = 0; j < 4; j++)
+		l += snprintf (buf+l, sizeof(buf)-l, "    <oneNumber name='e%d'>\n      %.6f\n    </oneNumber>\n",
+								j, rand()/(double)RAND_MAX);
+	    l += snprintf (buf+l, sizeof(buf)-l, "</setNumberVector>\n");
+	    addMsg (buf, l, dev, name);
+	}
+}
+
+/* add the message in txt[len] from dev, inserting its bseq attribute.
+ */
+static void
+addMsg (char *txt, int len, char *dev, char *name)
+{
+	BMsg *mp;
+	char seq[32];
+	int i, sl;
+
+	msgs = (BMsg *) realloc (msgs, (nmsgs+1)*sizeof(BMsg));
+	if (!msgs)
+	    Bye ("No memory for %d messages\n", nmsgs+1);
+	mp = &msgs[nmsgs];
+
+	/* insert after the root tag */
+	for (i = 0; i < len-1; i++)
+	    if (txt[i] == '<' && txt[i+1] != '?' && txt[i+1] != '!')
+		break;
+	for (i++; i < len && txt[i] != ' ' && txt[i] != '>' && txt[i] != '/'; i++)
+	    continue;
+	sl = snprintf (seq, sizeof(seq), " bseq='%d'", nmsgs);
+
+	mp->txt = (char *) malloc (len + sl + 1);
+	mp->name = strdup (name);
+	if (!mp->txt || !mp->name)
+	    Bye ("No memory for message %d\n", nmsgs);
+	memcpy (mp->txt, txt, i);
+	memcpy (mp->txt + i, seq, sl);
+	memcpy (mp->txt + i + sl, txt + i, len - i);
+	mp->len = len + sl;
+	mp->txt[mp->len] = '\0';
+	mp->dev = findDev (dev);
+
+	nmsgs++;
+}
+
+/* return index of dev in devs[], adding if new.
+ */
+static int
+findDev (char *dev)
+{
+	int i;
+
+	for (i = 0; i < ndevs; i++)
+	    if (!strcmp (devs[i], dev))
+		return (i);
+
+	devs = (char **) realloc (devs, (ndevs+1)*sizeof(char *));
+	if (!devs || !(devs[ndevs] = strdup (dev)))
+	    Bye ("No memory for device %s\n", dev);
+	return (ndevs++);
+}
+
+/* return a socket listening on port, else exit.
+ */
+static int
+listenOn (int port)
+{
+	struct sockaddr_in sa;
+	int fd, reuse = 1;
+
+	if ((fd = socket (AF_INET, SOCK_STREAM, 0)) < 0)
+	    Bye ("socket: %s\n", strerror(errno));
+	memset (&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	sa.sin_port = htons ((unsigned short)port);
+	if (setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0)
+	    Bye ("setsockopt: %s\n", strerror(errno));
+	if (bind (fd, (struct sockaddr*)&sa, sizeof(sa)) < 0)
+	    Bye ("bind %d: %s\n", port, strerror(errno));
+	if (listen (fd, 1024) < 0)
+	    Bye ("listen: %s\n", strerror(errno));
+
+	return (fd);
+}
+
+/* return a socket connected to port on this host, retrying for a while, else exit.
+ */
+static int
+connectTo (int port)
+{
+	struct sockaddr_in sa;
+	int try, one = 1;
+
+	memset (&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	sa.sin_port = htons ((unsigned short)port);
+
+	for (try = 0; try < 100; try++) {
+	    int fd = socket (AF_INET, SOCK_STREAM, 0);
+	    if (fd < 0)
+		Bye ("socket: %s\n", strerror(errno));
+	    if (connect (fd, (struct sockaddr*)&sa, sizeof(sa)) == 0) {
+		(void) setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		return (fd);
+	    }
+	    close (fd);
+	    sleepUntil (now() + 0.1);
+	}
+
+	Bye ("connect %d: %s\n", port, strerror(errno));
+	return (-1);
+}
+
+/* start server on port with each of devs[] as a remote driver at dport.
+ */
+static void
+startServer (char *server, int port, int dport, pid_t *pidp)
+{
+	char **args = (char **) calloc (ndevs + 8, sizeof(char *));
+	char ps[32];
+	int i, na = 0;
+
+	if (!args)
+	    Bye ("No memory for %d server args\n", ndevs);
+
+	snprintf (ps, sizeof(ps), "%d", port);
+	args[na++] = server;
+	args[na++] = "-n";
+	args[na++] = "-p";
+	args[na++] = ps;
+	args[na++] = "-m";
+	args[na++] = "10000";
+	for (i = 0; i < ndevs; i++) {
+	    if (asprintf (&args[na++], "%s@127.0.0.1:%d", devs[i], dport) < 0)
+		Bye ("No memory for server args\n");
+	}
+	args[na] = NULL;
+
+	*pidp = fork();
+	if (*pidp < 0)
+	    Bye ("fork: %s\n", strerror(errno));
+	if (*pidp == 0) {
+	    /* quiet, but keep stderr if it fails to start */
+	    int fd = open ("/dev/null", O_WRONLY);
+	    if (fd >= 0)
+		dup2 (fd, 2);
+	    execvp (server, args);
+	    _exit (1);
+	}
+}
+
+/* accept a connection from the server for each of devs[], which it names in its first
+ * message.
+ */
+static void
+acceptDrivers (int lfd)
+{
+	int i, n, n0 = ndevs, one = 1;
+
+	dvrfd = (int *) malloc (ndevs * sizeof(int));
+	if (!dvrfd)
+	    Bye ("No memory for %d drivers\n", ndevs);
+	for (i = 0; i < ndevs; i++)
+	    dvrfd[i] = -1;
+
+	for (n = 0; n < ndevs; n++) {
+	    LilXML *lp = newLilXML();
+	    XMLEle *root = NULL;
+	    char ynot[1024];
+	    int fd, d;
+
+	    fd = accept (lfd, NULL, NULL);
+	    if (fd < 0)
+		Bye ("accept: %s\n", strerror(errno));
+	    (void) setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	    /* N.B. read one char at a time so nothing after the first message is lost */
+	    while (!root) {
+		char c;
+		if (read (fd, &c, 1) != 1)
+		    Bye ("Driver connection closed before naming its device\n");
+		root = readXMLEle (lp, c, ynot);
+		if (!root && ynot[0])
+		    Bye ("Driver connection: %s\n", ynot);
+	    }
+	    d = findDev (findXMLAttValu (root, "device"));
+	    if (d >= n0 || dvrfd[d] != -1)
+		Bye ("Server connected for unexpected device %s\n", devs[d]);
+	    dvrfd[d] = fd;
+	    conns[nconns++].fd = fd;
+	    delXMLEle (root);
+	    delLilXML (lp);
+	}
+}
+
+/* write all of s to fd, else exit.
+ */
+static void
+sendStr (int fd, const char *s)
+{
+	int l = strlen (s), nw;
+
+	for (; l > 0; l -= nw, s += nw) {
+	    nw = write (fd, s, l);
+	    if (nw <= 0)
+		Bye ("write: %s\n", strerror(errno));
+	}
+}
+
+/* thread to read from all conns[] and record each arrival until done.
+ */
+static void *
+receiverThread (void *vp)
+{
+	struct pollfd *pfds = (struct pollfd *) calloc (nconns, sizeof(struct pollfd));
+	char *buf = (char *) malloc (MAXRBUF + sizeof(conns[0].carry));
+	int i;
+
+	(void) vp;
+
+	if (!pfds || !buf)
+	    Bye ("No memory for receiver\n");
+	for (i = 0; i < nconns; i++) {
+	    pfds[i].fd = conns[i].fd;
+	    pfds[i].events = POLLIN;
+	}
+
+	while (!done) {
+	    int np = poll (pfds, nconns, 10);
+	    double t;
+
+	    if (np < 0)
+		Bye ("poll: %s\n", strerror(errno));
+	    if (np == 0)
+		continue;
+
+	    t = now();
+	    for (i = 0; i < nconns; i++) {
+		Conn *cp = &conns[i];
+		int nr;
+
+		if (!(pfds[i].revents & (POLLIN|POLLHUP|POLLERR)))
+		    continue;
+
+		/* prepend what was left from last time */
+		memcpy (buf, cp->carry, cp->ncarry);
+		nr = read (cp->fd, buf + cp->ncarry, MAXRBUF);
+		if (nr <= 0) {
+		    pfds[i].fd = -1;
+		    continue;
+		}
+		scanArrivals (cp, buf, cp->ncarry + nr, t);
+	    }
+	    lastrecv = t;
+	}
+
+	free (pfds);
+	free (buf);
+	return (NULL);
+}
+
+/* record the arrival at t of each message in buf[n] read from cp.
+ * keep enough of the end in cp->carry to find one split by the read.
+ */
+static void
+scanArrivals (Conn *cp, char *buf, int n, double t)
+{
+	static const char key[] = "bseq='";
+	char *s = buf, *end = buf + n, *used = buf, *keep;
+
+	while ((s = memmem (s, end - s, key, sizeof(key)-1)) != NULL) {
+	    char *q = memchr (s + sizeof(key)-1, '\'', end - (s + sizeof(key)-1));
+	    int seq;
+	    if (!q)
+		break;
+	    seq = atoi (s + sizeof(key)-1);
+	    if (seq >= 0 && seq < nmsgs && sendt[seq] > 0) {
+		if (nlat == mlat) {
+		    mlat = mlat ? 2*mlat : 1024*1024;
+		    lat = (float *) realloc (lat, mlat * sizeof(float));
+		    if (!lat)
+			Bye ("No memory for %d arrivals\n", mlat);
+		}
+		lat[nlat++] = t - sendt[seq];
+		lastt[seq] = t;
+	    }
+	    used = s = q + 1;
+	}
+
+	/* keep the end unless it has been used */
+	keep = end - (int)sizeof(cp->carry);
+	if (keep < used)
+	    keep = used;
+	cp->ncarry = end - keep;
+	memcpy (cp->carry, keep, cp->ncarry);
+}
+
+/* return CLOCK_MONOTONIC in secs */
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec/1e9);
+}
+
+/* sleep until now() is t */
+static void
+sleepUntil (double t)
+{
+	struct timespec ts;
+
+	ts.tv_sec = (time_t) t;
+	ts.tv_nsec = (long) ((t - ts.tv_sec)*1e9);
+	while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+	    continue;
+}
+
+/* qsort compare for floats */
+static int
+cmpf (const void *a, const void *b)
+{
+	float fa = *(const float *)a, fb = *(const float *)b;
+
+	return (fa < fb ? -1 : fa > fb ? 1 : 0);
+}
+
+/* fatal error: print and exit */
+static void
+Bye (const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start (ap, fmt);
+	vfprintf (stderr, fmt, ap);
+	va_end (ap);
+
+	exit (1);
+}
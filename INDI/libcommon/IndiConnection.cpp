@@ -5,11 +5,16 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
 #include <signal.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <sys/types.h>  // provides 'umask'
 #include <sys/stat.h>  // provides 'umask'
 #include <sys/time.h>  // provides 'setrlimit'
@@ -25,7 +30,7 @@ using std::stringstream;
 using std::endl;
 using pcf::TimeStamp;
 using pcf::IndiConnection;
-using pcf::IndiXmlParser;
+using pcf::IndiStreamParser;
 using pcf::IndiMessage;
 using pcf::IndiProperty;
 
@@ -91,12 +96,16 @@ IndiConnection::~IndiConnection()
     {
         //do nothing
     }
-    
-    if(m_fstreamOutput && m_fstreamOutput != m_fstreamSTDOUT)
+
+    if ( m_fdOutput >= 0 && m_fdOutput != STDOUT_FILENO )
     {
-        fclose(m_fstreamOutput);
+        ::close( m_fdOutput );
     }
 
+    if ( m_fdWake >= 0 )
+    {
+        ::close( m_fdWake );
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -119,9 +128,11 @@ void IndiConnection::construct( const string &szName,
   // These are the two descriptors we will use to talk to the outside world.
   m_fdInput = STDIN_FILENO;
 
-  //We start with STDOUT.  
-  m_fstreamSTDOUT = fdopen(STDOUT_FILENO, "w+");  
-  setOutputFd(STDOUT_FILENO);
+  //We start with STDOUT.
+  m_fdOutput = STDOUT_FILENO;
+
+  // This lets 'sendXml' and 'quitProcess' wake up the 'process' loop.
+  m_fdWake = ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
 
   // setup the signal handler.
   //::signal( SIGHUP, IndiConnection::handleSignal );
@@ -280,6 +291,30 @@ void *IndiConnection::pthreadProcess( void *pUnknown )
 
 void IndiConnection::process()
 {
+  // We wait on the input, the wake-up eventfd, and the output when it is
+  // blocked. Each is registered with epoll once, and only changed when the
+  // file descriptors or what we wait for change.
+  int fdEpoll = ::epoll_create1( EPOLL_CLOEXEC );
+  if ( fdEpoll < 0 )
+  {
+    std::cerr << __FILE__ << " " << __LINE__ << " epoll_create1: "
+              << ::strerror( errno ) << std::endl;
+    return;
+  }
+
+  epoll_event eeWake;
+  eeWake.events = EPOLLIN;
+  eeWake.data.fd = m_fdWake;
+  ::epoll_ctl( fdEpoll, EPOLL_CTL_ADD, m_fdWake, &eeWake );
+
+  // What is registered now. The input and output may be the same socket,
+  // in which case it is registered once for both.
+  int fdInput = -1;
+  int fdOutput = -1;
+  uint32_t uiOutputEvents = 0;
+  // A regular file can't be waited on, but is always ready to read.
+  bool oInputAlwaysReady = false;
+
   // Loop here until we are told to quit or we hit an error.
   while ( m_oQuitProcess == false )
   {
@@ -289,48 +324,100 @@ void IndiConnection::process()
       // this loop reading input.
       update();
 
-      // The length of the command received.
-      int nInputBufLen = 0;
-      ::memset( &m_vecInputBuf[0], 0, InputBufSize );
-
-      // Create and clear out the FD set.
-      fd_set fdsRead;
-      FD_ZERO( &fdsRead );
-      // Watch input to see when we get some input.
-      FD_SET( m_fdInput, &fdsRead );
+      // The output waits for EPOLLOUT only while it is blocked.
+      bool oBlocked = false;
+      {
+        MutexLock::AutoLock autoOut( &m_mutOutput );
+        oBlocked = m_oOutputBlocked;
+      }
 
-      // The argument to 'select' must be +1 greater than the largest fd.
-      int nHighestNumberedFd = m_fdInput;
+      uint32_t uiWantedEvents = ( oBlocked ? static_cast<uint32_t>( EPOLLOUT ) : 0u );
 
-      // Set the timeout on the select call.
-      timeval tv;
-      tv.tv_sec = 1; //0;
-      tv.tv_usec = 0; //10000;
+      if ( fdInput != m_fdInput || fdOutput != m_fdOutput ||
+           uiOutputEvents != uiWantedEvents )
+      {
+        if ( fdInput >= 0 )
+          ::epoll_ctl( fdEpoll, EPOLL_CTL_DEL, fdInput, NULL );
+        if ( fdOutput >= 0 && fdOutput != fdInput )
+          ::epoll_ctl( fdEpoll, EPOLL_CTL_DEL, fdOutput, NULL );
+
+        fdInput = m_fdInput;
+        fdOutput = m_fdOutput;
+        uiOutputEvents = uiWantedEvents;
+        oInputAlwaysReady = false;
+
+        epoll_event eeInput;
+        eeInput.events = EPOLLIN;
+        eeInput.data.fd = fdInput;
+        if ( fdOutput == fdInput )
+          eeInput.events |= uiOutputEvents;
+        if ( fdInput >= 0 &&
+             ::epoll_ctl( fdEpoll, EPOLL_CTL_ADD, fdInput, &eeInput ) < 0 &&
+             errno == EPERM )
+          oInputAlwaysReady = true;
+
+        if ( fdOutput >= 0 && fdOutput != fdInput && uiOutputEvents != 0 )
+        {
+          epoll_event eeOutput;
+          eeOutput.events = uiOutputEvents;
+          eeOutput.data.fd = fdOutput;
+          ::epoll_ctl( fdEpoll, EPOLL_CTL_ADD, fdOutput, &eeOutput );
+        }
+      }
 
-      // We need a timeout on the select to ensure that we loop around and
+      // We need a timeout on the wait to ensure that we loop around and
       // call the 'update' function regularly.
-      int nRetval = ::select( nHighestNumberedFd + 1, &fdsRead, NULL, NULL, &tv );
-      //int nRetval = ::select( nHighestNumberedFd+1, &fdsRead, NULL, NULL, NULL );
+      epoll_event veeReady[3];
+      int nRetval = ::epoll_wait( fdEpoll, veeReady, 3,
+                                  ( oInputAlwaysReady ? 0 : 1000 ) );
 
       if ( nRetval == -1 )
       {
-        if ( m_oQuitProcess == false )
+        // A signal is not an error, so go straight back to waiting.
+        if ( errno != EINTR && m_oQuitProcess == false )
         {
           Thread::sleep( 1 );
         }
+        continue;
       }
-      else if ( nRetval == 0 )
+
+      bool oInputReady = oInputAlwaysReady;
+      bool oOutputReady = false;
+      for ( int ii = 0; ii < nRetval; ii++ )
       {
-        // Timed out - just loop back around.
+        if ( veeReady[ii].data.fd == m_fdWake )
+        {
+          uint64_t ullCount = 0;
+          ssize_t nRead = ::read( m_fdWake, &ullCount, sizeof( ullCount ) );
+          static_cast<void>(nRead);
+          oOutputReady = true;
+        }
+        else
+        {
+          if ( ( veeReady[ii].events & EPOLLOUT ) != 0 )
+            oOutputReady = true;
+          if ( veeReady[ii].data.fd == fdInput &&
+               ( veeReady[ii].events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ) != 0 )
+            oInputReady = true;
+        }
       }
-      // We must check the input file descriptor.
-      else if ( FD_ISSET( m_fdInput, &fdsRead ) != 0 )
+
+      // Send whatever is waiting before reading more, so a slow reader
+      // does not hold up what we have already decided to send.
+      if ( oOutputReady == true )
+      {
+        MutexLock::AutoLock autoOut( &m_mutOutput );
+        flushOutput();
+      }
+
+      if ( oInputReady == true )
       {
         // Receive a command
-        nInputBufLen = ::read( m_fdInput, &m_vecInputBuf[0], InputBufSize );
+        int nInputBufLen = ::read( m_fdInput, &m_vecInputBuf[0], InputBufSize );
         if ( nInputBufLen < 0 )
         {
-          m_oQuitProcess = true;
+          if ( errno != EAGAIN && errno != EINTR )
+            m_oQuitProcess = true;
         }
         else if ( nInputBufLen == 0 )
         {
@@ -339,25 +426,20 @@ void IndiConnection::process()
         }
         else
         {
-          // A message for the error.
-          std::string szErrorMsg;
-          // Now, is this a command which fits our requirements?
-          m_ixpIndi.parseXml( ( char * )( &m_vecInputBuf[0] ), nInputBufLen, szErrorMsg );
+          // Parse each complete message in the buffer and dispatch it. The
+          // parser keeps any partial message at the end for the next read.
+          const char *pcInput = ( const char * )( &m_vecInputBuf[0] );
+          unsigned int uiUsed = 0;
 
-          while( m_ixpIndi.getState() == IndiXmlParser::CompleteState )
+          while ( uiUsed < ( unsigned int )( nInputBufLen ) )
           {
-            // Create the message from the XML.
-            IndiMessage imRecv = m_ixpIndi.createIndiMessage();
-            const IndiProperty &ipRecv = imRecv.getProperty();
-
-            // Dispatch!
-            dispatch( imRecv.getType(), ipRecv );
-
-            // Get ready for some new XML.
-            //m_ixpIndi.clear();
+            uiUsed += m_ispIndi.parse( pcInput + uiUsed, nInputBufLen - uiUsed );
 
-            //Test whether there is more unparsed data.
-            m_ixpIndi.parseXml( "", szErrorMsg);
+            if ( m_ispIndi.getState() == IndiStreamParser::CompleteState )
+            {
+              // Dispatch!
+              dispatch( m_ispIndi.getType(), m_ispIndi.getProperty() );
+            }
           }
         }
       }
@@ -370,24 +452,248 @@ void IndiConnection::process()
     }
   }
 
+  ::close( fdEpoll );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 /// \brief IndiConnection::sendXml
-/// Sends an XML string out. 
+/// Sends an XML string out. The message is queued, and as much of the queue
+/// as the output will take is written now. Anything left is written by the
+/// 'process' loop when the output can take more.
 /// \param szXml The XML to send.
+
 void IndiConnection::sendXml( const string &szXml ) const
+{
+  sendXml( szXml, "" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief IndiConnection::sendXml
+/// Sends an XML string out. If a message with the same key is still waiting
+/// to be sent, it is replaced by this one, so a slow reader only gets the
+/// latest. Any message without a key keeps its place in the order: no
+/// message sent after it will replace one sent before it.
+/// If the queue is full, a message with a key is held back, still replaced by
+/// newer ones, and queued once there is room, so the latest value of every
+/// key is always sent. A message without a key is always queued, after any
+/// held back before it.
+/// \param szXml The XML to send.
+/// \param szKey The key to replace a waiting message, or empty for none.
+
+void IndiConnection::sendXml( const string &szXml,
+                              const string &szKey ) const
 {
   MutexLock::AutoLock autoOut( &m_mutOutput );
-  
-  if(!m_fstreamOutput)
+
+  if ( m_fdOutput < 0 )
   {
     return;
   }
 
-  ::fprintf( m_fstreamOutput, "%s", szXml.c_str() );
-  fflush(m_fstreamOutput);
+  m_osOutput.ullNumQueued++;
+
+  if ( szKey.empty() == true )
+  {
+    admitDeferred( true );
+    m_mapOutputKeys.clear();
+  }
+  else
+  {
+    std::unordered_map<string, uint64_t>::iterator itr = m_mapOutputKeys.find( szKey );
+    if ( itr != m_mapOutputKeys.end() )
+    {
+      OutputMsg &omPrev = m_dqOutput[itr->second - m_ullOutputSeq];
+      m_osOutput.ullNumPendingBytes += szXml.size();
+      m_osOutput.ullNumPendingBytes -= omPrev.szXml.size();
+      omPrev.szXml = szXml;
+      m_osOutput.ullNumCoalesced++;
+      return;
+    }
+
+    std::unordered_map<string, string>::iterator itrDef = m_mapDeferred.find( szKey );
+    if ( itrDef != m_mapDeferred.end() )
+    {
+      itrDef->second = szXml;
+      m_osOutput.ullNumCoalesced++;
+      return;
+    }
+
+    // Anything already held back goes first.
+    if ( m_dqDeferredKeys.empty() == false ||
+         m_osOutput.ullNumPendingBytes + szXml.size() > m_ullMaxOutputBytes )
+    {
+      m_dqDeferredKeys.push_back( szKey );
+      m_mapDeferred[szKey] = szXml;
+      m_osOutput.ullNumDeferred++;
+      return;
+    }
+
+    m_mapOutputKeys[szKey] = m_ullOutputSeq + m_dqOutput.size();
+  }
+
+  m_dqOutput.push_back( OutputMsg() );
+  m_dqOutput.back().szKey = szKey;
+  m_dqOutput.back().szXml = szXml;
+  m_osOutput.ullNumPending = m_dqOutput.size();
+  m_osOutput.ullNumPendingBytes += szXml.size();
+  if ( m_osOutput.ullNumPendingBytes > m_osOutput.ullMaxPendingBytes )
+    m_osOutput.ullMaxPendingBytes = m_osOutput.ullNumPendingBytes;
 
+  // If the output is blocked, the 'process' loop is already waiting for it.
+  if ( m_oOutputBlocked == false )
+  {
+    flushOutput();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief IndiConnection::admitDeferred
+/// Moves the messages held back by the limit on the output into the queue,
+/// oldest first. Must be called with 'm_mutOutput' locked.
+/// \param oAll If true all are queued, otherwise only as many as fit, and at
+/// least one if the queue is empty.
+
+void IndiConnection::admitDeferred( const bool &oAll ) const
+{
+  while ( m_dqDeferredKeys.empty() == false )
+  {
+    std::unordered_map<string, string>::iterator itr = m_mapDeferred.find( m_dqDeferredKeys.front() );
+    if ( oAll == false && m_dqOutput.empty() == false &&
+         m_osOutput.ullNumPendingBytes + itr->second.size() > m_ullMaxOutputBytes )
+    {
+      break;
+    }
+
+    m_mapOutputKeys[itr->first] = m_ullOutputSeq + m_dqOutput.size();
+    m_dqOutput.push_back( OutputMsg() );
+    m_dqOutput.back().szKey = itr->first;
+    m_dqOutput.back().szXml.swap( itr->second );
+    m_osOutput.ullNumPendingBytes += m_dqOutput.back().szXml.size();
+
+    m_mapDeferred.erase( itr );
+    m_dqDeferredKeys.pop_front();
+  }
+
+  m_osOutput.ullNumPending = m_dqOutput.size();
+  if ( m_osOutput.ullNumPendingBytes > m_osOutput.ullMaxPendingBytes )
+    m_osOutput.ullMaxPendingBytes = m_osOutput.ullNumPendingBytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief IndiConnection::flushOutput
+/// Writes as much of the output queue as the output will take without
+/// blocking. Must be called with 'm_mutOutput' locked.
+
+void IndiConnection::flushOutput() const
+{
+  while ( m_dqOutput.empty() == false )
+  {
+    // Once a message has started to be sent, it can't be replaced.
+    OutputMsg &omFront = m_dqOutput.front();
+    if ( omFront.szKey.empty() == false )
+    {
+      std::unordered_map<string, uint64_t>::iterator itr = m_mapOutputKeys.find( omFront.szKey );
+      if ( itr != m_mapOutputKeys.end() && itr->second == m_ullOutputSeq )
+        m_mapOutputKeys.erase( itr );
+    }
+
+    iovec viovOut[MaxWriteMsgs];
+    int nNumIov = 0;
+    for ( std::deque<OutputMsg>::const_iterator itr = m_dqOutput.begin();
+          itr != m_dqOutput.end() && nNumIov < MaxWriteMsgs; ++itr, ++nNumIov )
+    {
+      size_t uiOffset = ( nNumIov == 0 ) ? ( m_uiOutputOffset ) : ( 0 );
+      viovOut[nNumIov].iov_base = const_cast<char *>( itr->szXml.data() + uiOffset );
+      viovOut[nNumIov].iov_len = itr->szXml.size() - uiOffset;
+    }
+
+    ssize_t nWritten = ::writev( m_fdOutput, viovOut, nNumIov );
+    if ( nWritten < 0 )
+    {
+      if ( errno == EINTR )
+        continue;
+
+      if ( errno == EAGAIN || errno == EWOULDBLOCK )
+      {
+        if ( m_oOutputBlocked == false )
+        {
+          m_oOutputBlocked = true;
+          m_osOutput.ullNumBlocked++;
+          wakeProcess();
+        }
+        return;
+      }
+
+      // The reader is gone, so nothing waiting can be sent.
+      std::cerr << __FILE__ << " " << __LINE__ << " writev: "
+                << ::strerror( errno ) << std::endl;
+      m_osOutput.ullNumErrors++;
+      m_ullOutputSeq += m_dqOutput.size();
+      m_dqOutput.clear();
+      m_mapOutputKeys.clear();
+      m_dqDeferredKeys.clear();
+      m_mapDeferred.clear();
+      m_uiOutputOffset = 0;
+      m_osOutput.ullNumPending = 0;
+      m_osOutput.ullNumPendingBytes = 0;
+      break;
+    }
+
+    m_osOutput.ullNumBytesWritten += nWritten;
+    m_osOutput.ullNumPendingBytes -= nWritten;
+
+    // Drop the messages which were completely written.
+    size_t uiLeft = nWritten;
+    while ( m_dqOutput.empty() == false &&
+            m_dqOutput.front().szXml.size() - m_uiOutputOffset <= uiLeft )
+    {
+      uiLeft -= m_dqOutput.front().szXml.size() - m_uiOutputOffset;
+      m_uiOutputOffset = 0;
+      m_dqOutput.pop_front();
+      m_ullOutputSeq++;
+      m_osOutput.ullNumWritten++;
+    }
+    m_uiOutputOffset += uiLeft;
+    m_osOutput.ullNumPending = m_dqOutput.size();
+
+    // Whatever was held back can now take the room made.
+    admitDeferred( false );
+  }
+
+  m_oOutputBlocked = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief IndiConnection::wakeProcess
+/// Wakes up the 'process' loop.
+
+void IndiConnection::wakeProcess() const
+{
+  uint64_t ullOne = 1;
+  ssize_t nWritten = ::write( m_fdWake, &ullOne, sizeof( ullOne ) );
+  static_cast<void>(nWritten);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief IndiConnection::getOutputStats
+/// Returns the counters describing how well the output is keeping up.
+/// \return A copy of the counters.
+
+IndiConnection::OutputStats IndiConnection::getOutputStats() const
+{
+  MutexLock::AutoLock autoOut( &m_mutOutput );
+  return m_osOutput;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief IndiConnection::setMaxOutputBytes
+/// Sets the limit on the bytes waiting to be sent.
+/// \param ullMaxBytes The limit in bytes.
+
+void IndiConnection::setMaxOutputBytes( const uint64_t &ullMaxBytes )
+{
+  MutexLock::AutoLock autoOut( &m_mutOutput );
+  m_ullMaxOutputBytes = ullMaxBytes;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -427,21 +733,34 @@ void IndiConnection::setInputFd( const int &iFd )
 
 void IndiConnection::setOutputFd( const int &iFd )
 {
-    m_fdOutput = iFd;
+    MutexLock::AutoLock autoOut( &m_mutOutput );
 
     //Close if it's open as long as it isn't STDOUT
-    if(m_fstreamOutput && m_fstreamOutput != m_fstreamSTDOUT)
+    if ( m_fdOutput >= 0 && m_fdOutput != STDOUT_FILENO && m_fdOutput != iFd )
     {
-        fclose(m_fstreamOutput);
+        ::close( m_fdOutput );
     }
 
-    if(iFd == STDOUT_FILENO)
-    {
-        m_fstreamOutput = m_fstreamSTDOUT;
-    }
-    else
+    m_fdOutput = iFd;
+
+    // Anything waiting was for the old output.
+    m_ullOutputSeq += m_dqOutput.size();
+    m_dqOutput.clear();
+    m_mapOutputKeys.clear();
+    m_dqDeferredKeys.clear();
+    m_mapDeferred.clear();
+    m_uiOutputOffset = 0;
+    m_oOutputBlocked = false;
+    m_osOutput.ullNumPending = 0;
+    m_osOutput.ullNumPendingBytes = 0;
+
+    // A slow reader must not block the writer. STDOUT is shared with the rest
+    // of the process, so it is left as it is.
+    if ( m_fdOutput >= 0 && m_fdOutput != STDOUT_FILENO )
     {
-        m_fstreamOutput = fdopen(m_fdOutput, "w+");
+        int nFlags = ::fcntl( m_fdOutput, F_GETFL );
+        if ( nFlags >= 0 )
+            ::fcntl( m_fdOutput, F_SETFL, nFlags | O_NONBLOCK );
     }
 }
 
@@ -492,7 +811,7 @@ string IndiConnection::getVersion() const
 
 void IndiConnection::setProtocolVersion( const string &ProtocolVersion )
 {
-  m_ixpIndi.setProtocolVersion( ProtocolVersion );
+  m_szProtocolVersion = ProtocolVersion;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -502,7 +821,7 @@ void IndiConnection::setProtocolVersion( const string &ProtocolVersion )
 
 string IndiConnection::getProtocolVersion() const
 {
-  return m_ixpIndi.getProtocolVersion();
+  return m_szProtocolVersion;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -512,6 +831,7 @@ string IndiConnection::getProtocolVersion() const
 void IndiConnection::quitProcess()
 {
   m_oQuitProcess = true;
+  wakeProcess();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
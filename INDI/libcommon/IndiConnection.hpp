@@ -12,11 +12,16 @@
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <unordered_map>
+#include <stdint.h>
+#include <unistd.h>
 #include "Thread.hpp"
 #include "MutexLock.hpp"
 #include "TimeStamp.hpp"
 //#include "ConfigFile.hpp"
 #include "IndiXmlParser.hpp"
+#include "IndiStreamParser.hpp"
 #include "IndiMessage.hpp"
 #include "IndiProperty.hpp"
 
@@ -31,6 +36,44 @@ class IndiConnection : public pcf::Thread
     {
       // This is the size of the input buffer to hold the incoming commands.
       InputBufSize = 65536,
+      // The most messages written in one call to 'writev'.
+      MaxWriteMsgs = 64,
+      // The default limit on the bytes waiting to be sent.
+      DefaultMaxOutputBytes = 4194304,
+    };
+
+  public:
+    /// Counters describing how well the output is keeping up.
+    struct OutputStats
+    {
+      /// The number of messages given to 'sendXml'.
+      uint64_t ullNumQueued {0};
+      /// The number of messages replaced by a newer one before being sent.
+      uint64_t ullNumCoalesced {0};
+      /// The number of messages held back because the queue was full.
+      uint64_t ullNumDeferred {0};
+      /// The number of messages written.
+      uint64_t ullNumWritten {0};
+      /// The number of bytes written.
+      uint64_t ullNumBytesWritten {0};
+      /// The number of times the output could not take everything we had.
+      uint64_t ullNumBlocked {0};
+      /// The number of write errors. The queue is emptied on an error.
+      uint64_t ullNumErrors {0};
+      /// The messages and bytes waiting to be sent now.
+      uint64_t ullNumPending {0};
+      uint64_t ullNumPendingBytes {0};
+      /// The most bytes ever waiting to be sent.
+      uint64_t ullMaxPendingBytes {0};
+    };
+
+  private:
+    /// A message waiting to be sent.
+    struct OutputMsg
+    {
+      /// If not empty, a newer message with the same key replaces this one.
+      std::string szKey;
+      std::string szXml;
     };
 
   // construction/destruction/assign/copy
@@ -57,6 +100,15 @@ class IndiConnection : public pcf::Thread
     /// Listens on the file descriptor in a loop for incoming INDI messages.
     /// Exits when the 'Quit Process' flag becomes true.
     void process();
+    /// Writes as much of the output queue as the output will take without
+    /// blocking. Must be called with 'm_mutOutput' locked.
+    void flushOutput() const;
+    /// Moves the messages held back by the limit on the output into the
+    /// queue, as many as fit or all of them. Must be called with
+    /// 'm_mutOutput' locked.
+    void admitDeferred( const bool &oAll ) const;
+    /// Wakes up the 'process' loop.
+    void wakeProcess() const;
 
   // Standard client interface methods.
   public:
@@ -103,6 +155,14 @@ class IndiConnection : public pcf::Thread
     /// Sends an XML string out to a file descriptor. If there is an error,
     /// it will be logged.
     virtual void sendXml( const std::string &szXml ) const;
+    /// Sends an XML string out to a file descriptor. If a message with the
+    /// same key is still waiting to be sent, it is replaced by this one.
+    void sendXml( const std::string &szXml,
+                  const std::string &szKey ) const;
+    /// Returns the counters describing how well the output is keeping up.
+    OutputStats getOutputStats() const;
+    /// Sets the limit on the bytes waiting to be sent.
+    void setMaxOutputBytes( const uint64_t &ullMaxBytes );
 
     /// Which FD will be used for input?
     void setInputFd( const int &iFd );
@@ -138,6 +198,8 @@ class IndiConnection : public pcf::Thread
     std::string m_szName;
     /// the version of this software. may be "none".
     std::string m_szVersion;
+    /// The INDI protocol version.
+    std::string m_szProtocolVersion;
     /// Is this client generating additional messages?
     bool m_oIsVerboseModeEnabled;
     /// Which CPU do we want to run the worker thread on?
@@ -149,20 +211,38 @@ class IndiConnection : public pcf::Thread
     //Changed from static to prevent app-wide INDI shutdown.
     bool m_oQuitProcess {false};
     
-    /// This is the object that conglomerates all the INDI XML
-    pcf::IndiXmlParser m_ixpIndi;
+    /// This is the object that parses the incoming INDI XML.
+    pcf::IndiStreamParser m_ispIndi;
     /// A mutex to protect output.
     mutable pcf::MutexLock m_mutOutput;
     /// The file descriptor to read from.
     int m_fdInput;
     
     /// The file descriptor to write to.
-    int m_fdOutput;
-
-    /// Stream for safer output
-    FILE * m_fstreamOutput {NULL};
+    int m_fdOutput {STDOUT_FILENO};
+    /// An eventfd used to wake up the 'process' loop.
+    int m_fdWake {-1};
 
-    FILE * m_fstreamSTDOUT {NULL};
+    /// The messages waiting to be sent, oldest first.
+    mutable std::deque<OutputMsg> m_dqOutput;
+    /// The number of bytes of the first message already sent.
+    mutable size_t m_uiOutputOffset {0};
+    /// The sequence number of the first message in the queue. The sequence
+    /// number of a message is its index in the queue plus this.
+    mutable uint64_t m_ullOutputSeq {0};
+    /// The sequence number of the queued message for each key. A message
+    /// which has started to be sent is no longer in here.
+    mutable std::unordered_map<std::string, uint64_t> m_mapOutputKeys;
+    /// The keys of the messages held back because the queue was full, oldest
+    /// first, and the latest message for each. They are queued as it drains.
+    mutable std::deque<std::string> m_dqDeferredKeys;
+    mutable std::unordered_map<std::string, std::string> m_mapDeferred;
+    /// Does 'process' need to wait for the output to be writable?
+    mutable bool m_oOutputBlocked {false};
+    /// The limit on the bytes waiting to be sent.
+    uint64_t m_ullMaxOutputBytes {DefaultMaxOutputBytes};
+    /// The counters describing how well the output is keeping up.
+    mutable OutputStats m_osOutput;
 
     /// If the processing of INDI messages is put in a separate thread,
     /// this is the thread id of it.
@@ -442,7 +442,8 @@ void IndiDriver::sendSetProperty( const IndiProperty &ipSend ) const
   {
     IndiXmlParser ixp( IndiMessage( IndiMessage::SetProperty, _ipSend ),
                        getProtocolVersion() );
-    sendXml( ixp.createXmlString() );
+    // Only the latest value of a property needs to reach a slow reader.
+    sendXml( ixp.createXmlString(), _ipSend.createUniqueKey() );
   }
 }
 
@@ -458,7 +459,7 @@ void IndiDriver::sendSetProperties( const vector<IndiProperty> &vecIpSend )
     {
       IndiXmlParser ixp( IndiMessage( IndiMessage::SetProperty, vecIpSend[ii] ),
                          getProtocolVersion() );
-      sendXml( ixp.createXmlString() );
+      sendXml( ixp.createXmlString(), vecIpSend[ii].createUniqueKey() );
     }
   }
 }
@@ -67,9 +67,15 @@ IndiElement::IndiElement( const string &szName,
 
 IndiElement::IndiElement( const IndiElement &ieRhs ) : m_szFormat(ieRhs.m_szFormat), m_szLabel(ieRhs.m_szLabel),
                                                          m_szMax(ieRhs.m_szMax), m_szMin(ieRhs.m_szMin), m_szName(ieRhs.m_szName),
-                                                          m_szSize(ieRhs.m_szSize), m_szStep(ieRhs.m_szStep), m_szValue(ieRhs.m_szValue),
+                                                          m_szSize(ieRhs.m_szSize), m_szStep(ieRhs.m_szStep),
                                                            m_lsValue(ieRhs.m_lsValue), m_ssValue(ieRhs.m_ssValue)
 {
+  pcf::ReadWriteLock::AutoRLock rwAuto( &ieRhs.m_rwData );
+
+  // Copy the number and the string, so the string is formatted only once.
+  m_szValue = ieRhs.valueString();
+  m_tNumericType = ieRhs.m_tNumericType;
+  m_ullValue = ieRhs.m_ullValue;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -95,7 +101,10 @@ const IndiElement &IndiElement::operator=( const IndiElement &ieRhs )
     m_szName = ieRhs.m_szName;
     m_szSize = ieRhs.m_szSize;
     m_szStep = ieRhs.m_szStep;
-    m_szValue = ieRhs.m_szValue;
+    m_szValue = ieRhs.getValue();
+    m_tNumericType = ieRhs.getNumericType();
+    m_ullValue = ieRhs.m_ullValue;
+    m_oFormatted = true;
     m_lsValue = ieRhs.m_lsValue;
     m_ssValue = ieRhs.m_ssValue;
   }
@@ -119,7 +128,7 @@ bool IndiElement::operator==( const IndiElement &ieRhs ) const
            m_szName == ieRhs.m_szName &&
            m_szSize == ieRhs.m_szSize &&
            m_szStep == ieRhs.m_szStep &&
-           m_szValue == ieRhs.m_szValue &&
+           valueString() == ieRhs.getValue() &&
            m_lsValue == ieRhs.m_lsValue &&
            m_ssValue == ieRhs.m_ssValue );
 }
@@ -133,7 +142,7 @@ string IndiElement::createString() const
   stringstream ssOutput;
   ssOutput << "{ "
            << "\"name\" : \"" << m_szName << "\" , "
-           << "\"value\" : \"" << m_szValue << "\" , "
+           << "\"value\" : \"" << valueString() << "\" , "
            << "\"lightstate\" : \"" << getLightStateString( m_lsValue ) << "\" , "
            << "\"switchstate\" : \"" << getSwitchStateString( m_ssValue ) << "\" , "
            << "\"label\" : \"" << m_szLabel << "\" , "
@@ -162,6 +171,9 @@ void IndiElement::clear()
   m_szSize = "0";
   m_szStep = "0";
   m_szValue = "";
+  m_tNumericType = NotNumeric;
+  m_ullValue = 0;
+  m_oFormatted = true;
   m_lsValue = UnknownLightState;
   m_ssValue = UnknownSwitchState;
 }
@@ -273,7 +285,7 @@ bool IndiElement::isNumeric() const
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
 
   int iValue;
-  std::stringstream ssValue( m_szValue );
+  std::stringstream ssValue( valueString() );
 
   // Try to stream the data into the int variable.
   // If we fail, this value is not numeric.
@@ -282,6 +294,67 @@ bool IndiElement::isNumeric() const
 //  return ( ssValue >> iValue );
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// How the value is stored, NotNumeric if it was set as a string.
+
+IndiElement::NumericType IndiElement::getNumericType() const
+{
+  pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
+  return m_tNumericType;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Returns the value string, formatting the number first if it has changed
+/// since it was last formatted. The read or write lock must be held. Readers
+/// can get here together, so the formatting has its own lock.
+
+const string &IndiElement::valueString() const
+{
+  if ( m_oFormatted.load( std::memory_order_acquire ) == false )
+  {
+    pcf::MutexLock::AutoLock mutAuto( &m_mutFormat );
+
+    if ( m_oFormatted.load( std::memory_order_relaxed ) == false )
+    {
+      switch ( m_tNumericType )
+      {
+        case NumericInt:
+          m_szValue = formatNumber( m_llValue );
+          break;
+        case NumericUInt:
+          m_szValue = formatNumber( m_ullValue );
+          break;
+        case NumericReal:
+          m_szValue = formatNumber( m_xValue );
+          break;
+        default:
+          break;
+      }
+      m_oFormatted.store( true, std::memory_order_release );
+    }
+  }
+
+  return m_szValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Returns the stored number as a double. The lock must be held.
+
+double IndiElement::numericAsDouble() const
+{
+  switch ( m_tNumericType )
+  {
+    case NumericInt:
+      return static_cast<double>( m_llValue );
+    case NumericUInt:
+      return static_cast<double>( m_ullValue );
+    case NumericReal:
+      return m_xValue;
+    default:
+      return 0;
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Returns the bool value. If the value is 0, "false", or any other non-value.
 /*
@@ -402,7 +475,7 @@ IndiElement::operator unsigned int() const
 string IndiElement::get() const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
-  return m_szValue;
+  return valueString();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -411,7 +484,7 @@ string IndiElement::get() const
 string IndiElement::getValue() const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
-  return m_szValue;
+  return valueString();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -423,10 +496,12 @@ void IndiElement::getValue( char *pcValue, unsigned int &uiSize ) const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
 
+  const string &szValue = valueString();
+
   // Modify the number of bytes to copy. It will be the lesser of the two sizes.
-  uiSize = ( uiSize > m_szValue.size() ) ? ( m_szValue.size() ) : ( uiSize );
+  uiSize = ( uiSize > szValue.size() ) ? ( szValue.size() ) : ( uiSize );
 
-  ::memcpy( pcValue, m_szValue.c_str(), uiSize );
+  ::memcpy( pcValue, szValue.c_str(), uiSize );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -528,6 +603,8 @@ void IndiElement::setValue( const string &szValue )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
   m_szValue = szValue;
+  m_tNumericType = NotNumeric;
+  m_oFormatted = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -538,6 +615,8 @@ void IndiElement::setValue( const char *pcValue,
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
   m_szValue.assign( const_cast<char *>( pcValue ), uiSize );
+  m_tNumericType = NotNumeric;
+  m_oFormatted = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -617,7 +696,7 @@ bool IndiElement::hasValidSwitchState() const
 bool IndiElement::hasValidValue() const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
-  return ( m_szValue.size() > 0 );
+  return ( m_tNumericType != NotNumeric || m_szValue.size() > 0 );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
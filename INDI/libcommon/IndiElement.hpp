@@ -6,6 +6,10 @@
 /// form it is a name-value pair with other attributes associated with it.
 /// All access is protected by a read-write lock.
 ///
+/// Numeric values are stored as numbers, and are only formatted as a string
+/// when the string is asked for (usually when the element is sent). This
+/// makes repeatedly setting and comparing numbers cheap.
+///
 ////////////////////////////////////////////////////////////////////////////////
 
 #ifndef INDI_ELEMENT_HPP
@@ -13,9 +17,15 @@
 #pragma once
 
 #include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <cmath>
+#include <atomic>
 #include <string>
 #include <sstream>
 #include <exception>
+#include <type_traits>
+#include "MutexLock.hpp"
 #include "ReadWriteLock.hpp"
 
 namespace pcf
@@ -66,6 +76,15 @@ class IndiElement
       On
     };
 
+    // How the value is stored if it was set as a number.
+    enum NumericType
+    {
+      NotNumeric = 0,
+      NumericInt,
+      NumericUInt,
+      NumericReal
+    };
+
     // Constructor/copy constructor/destructor.
   public:
     /// Constructor.
@@ -162,6 +181,23 @@ class IndiElement
     // Is the value (not LightState or SwitchState) a numeric?
     bool isNumeric() const;
 
+    /// How the value is stored, NotNumeric if it was set as a string.
+    NumericType getNumericType() const;
+
+    /// Returns true if the value differs from ttValue. If both are numbers
+    /// the raw values are compared, and a difference of no more than
+    /// xTolerance is not a change. Otherwise the strings are compared.
+    template <class TT> bool isChanged( const TT &ttValue,
+                                        const double &xTolerance = 0 ) const;
+
+    /// Returns true if TT is stored as a number rather than as a string.
+    /// Bools and chars are not, as they stream as words and characters.
+    template <class TT> static constexpr bool isNumber();
+
+    /// Returns the string for a number, the same as a stringstream with
+    /// precision 15 would give, but without the cost of a stringstream.
+    template <class TT> static std::string formatNumber( const TT &ttValue );
+
     /// Returns the string type given the enumerated type.
     static std::string convertTypeToString( const Type &tType );
     /// Returns the enumerated type given the tag.
@@ -196,6 +232,17 @@ class IndiElement
     template <class TT> void setValue( const TT &ttValue );
     template <class TT> void set( const TT &ttValue );
 
+    // Helpers, which must be called with the lock held.
+  private:
+    /// Stores the value, as a number if it is one.
+    template <class TT> void storeValue( const TT &ttValue );
+    /// Returns the value string, formatting the number first if needed.
+    const std::string &valueString() const;
+    /// Returns the stored number as a double.
+    double numericAsDouble() const;
+    /// Returns the string for any value, as a stringstream with precision 15.
+    template <class TT> static std::string toString( const TT &ttValue );
+
     // Members.
   private:
     /// If this is a number or BLOB, this is the 'printf' format.
@@ -219,8 +266,26 @@ class IndiElement
     /// If this is a number, this is increment for it.
     std::string m_szStep {"0"};
     
-    /// This is the value of the data.
-    std::string m_szValue;
+    /// This is the value of the data. If the value is a number, this is only
+    /// up to date if m_oFormatted is true.
+    mutable std::string m_szValue;
+
+    /// How the value is stored.
+    NumericType m_tNumericType {NotNumeric};
+
+    /// If the value is a number, this is it.
+    union
+    {
+      int64_t m_llValue;
+      uint64_t m_ullValue;
+      double m_xValue {0};
+    };
+
+    /// Whether m_szValue has been formatted from the number.
+    mutable std::atomic<bool> m_oFormatted {true};
+
+    /// Protects formatting m_szValue, which can happen under a read lock.
+    mutable pcf::MutexLock m_mutFormat;
     
     /// This can also be the value.
     LightStateType m_lsValue {UnknownLightState};
@@ -241,9 +306,154 @@ class IndiElement
 template <class TT> pcf::IndiElement::IndiElement( const std::string &szName,
                                                    const TT &ttValue ) : m_szName(szName)
 {
-  std::stringstream ssValue;
-  ssValue << std::boolalpha << ttValue;
-  m_szValue = ssValue.str();
+  storeValue( ttValue );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Returns true if TT is stored as a number rather than as a string.
+
+template <class TT> constexpr bool pcf::IndiElement::isNumber()
+{
+  return std::is_arithmetic<TT>::value &&
+         !std::is_same<TT, bool>::value &&
+         !std::is_same<TT, char>::value &&
+         !std::is_same<TT, signed char>::value &&
+         !std::is_same<TT, unsigned char>::value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Returns the string for a number, matching a stringstream with precision 15.
+
+template <class TT> std::string pcf::IndiElement::formatNumber( const TT &ttValue )
+{
+  static_assert( isNumber<TT>(), "formatNumber requires a numeric type" );
+
+  char pcBuf[32];
+  int nLen = 0;
+
+  if constexpr ( std::is_floating_point<TT>::value )
+    nLen = ::snprintf( pcBuf, sizeof( pcBuf ), "%.15g", static_cast<double>( ttValue ) );
+  else if constexpr ( std::is_signed<TT>::value )
+    nLen = ::snprintf( pcBuf, sizeof( pcBuf ), "%" PRId64, static_cast<int64_t>( ttValue ) );
+  else
+    nLen = ::snprintf( pcBuf, sizeof( pcBuf ), "%" PRIu64, static_cast<uint64_t>( ttValue ) );
+
+  return std::string( pcBuf, nLen );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Returns the string for any value, as a stringstream with precision 15.
+
+template <class TT> std::string pcf::IndiElement::toString( const TT &ttValue )
+{
+  if constexpr ( isNumber<TT>() )
+  {
+    return formatNumber( ttValue );
+  }
+  else
+  {
+    std::stringstream ssValue;
+    ssValue.precision( 15 );
+    ssValue << std::boolalpha << ttValue;
+    return ssValue.str();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Stores the value, as a number if it is one. The write lock must be held.
+
+template <class TT> void pcf::IndiElement::storeValue( const TT &ttValue )
+{
+  if constexpr ( isNumber<TT>() )
+  {
+    if constexpr ( std::is_floating_point<TT>::value )
+    {
+      m_tNumericType = NumericReal;
+      m_xValue = ttValue;
+    }
+    else if constexpr ( std::is_signed<TT>::value )
+    {
+      m_tNumericType = NumericInt;
+      m_llValue = ttValue;
+    }
+    else
+    {
+      m_tNumericType = NumericUInt;
+      m_ullValue = ttValue;
+    }
+    // Format when the string is next needed.
+    m_oFormatted = false;
+  }
+  else
+  {
+    m_tNumericType = NotNumeric;
+    m_oFormatted = true;
+
+    if constexpr ( std::is_same<TT, bool>::value )
+    {
+      m_szValue = ( ttValue ) ? ( "true" ) : ( "false" );
+    }
+    else if constexpr ( std::is_convertible<TT, std::string>::value )
+    {
+      m_szValue = ttValue;
+    }
+    else
+    {
+      m_szValue = toString( ttValue );
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Returns true if the value differs from ttValue, within a tolerance if
+/// both are numbers.
+
+template <class TT> bool pcf::IndiElement::isChanged( const TT &ttValue,
+                                                      const double &xTolerance ) const
+{
+  pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
+
+  if constexpr ( isNumber<TT>() )
+  {
+    if ( m_tNumericType == NotNumeric )
+      return ( valueString() != formatNumber( ttValue ) );
+
+    // Integers of the same signedness can be compared exactly.
+    if constexpr ( std::is_integral<TT>::value && std::is_signed<TT>::value )
+    {
+      if ( m_tNumericType == NumericInt && xTolerance == 0 )
+        return ( m_llValue != static_cast<int64_t>( ttValue ) );
+    }
+    else if constexpr ( std::is_integral<TT>::value )
+    {
+      if ( m_tNumericType == NumericUInt && xTolerance == 0 )
+        return ( m_ullValue != static_cast<uint64_t>( ttValue ) );
+    }
+
+    double xOld = numericAsDouble();
+    double xNew = static_cast<double>( ttValue );
+
+    // A NaN is not a change from a NaN, as the strings are the same.
+    if ( std::isnan( xOld ) || std::isnan( xNew ) )
+      return ( std::isnan( xOld ) != std::isnan( xNew ) );
+
+    if ( xOld == xNew )
+      return false;
+
+    return !( std::fabs( xNew - xOld ) <= xTolerance );
+  }
+  else if constexpr ( std::is_same<TT, bool>::value )
+  {
+    return ( valueString() != ( ( ttValue ) ? ( "true" ) : ( "false" ) ) );
+  }
+  else if constexpr ( std::is_convertible<TT, std::string>::value )
+  {
+    return ( valueString() != ttValue );
+  }
+  else
+  {
+    return ( valueString() != toString( ttValue ) );
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -253,9 +463,25 @@ template <class TT> TT pcf::IndiElement::get() const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
 
+  // Numbers are returned without a round trip through the string.
+  if constexpr ( isNumber<TT>() )
+  {
+    switch ( m_tNumericType )
+    {
+      case NumericInt:
+        return static_cast<TT>( m_llValue );
+      case NumericUInt:
+        return static_cast<TT>( m_ullValue );
+      case NumericReal:
+        return static_cast<TT>( m_xValue );
+      default:
+        break;
+    }
+  }
+
   TT tValue;
   //  stream the data into the variable.
-  std::stringstream ssValue( m_szValue );
+  std::stringstream ssValue( valueString() );
   ssValue >> std::boolalpha >> tValue;
   return tValue;
 }
@@ -267,9 +493,25 @@ template <class TT> TT pcf::IndiElement::getValue() const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
 
+  // Numbers are returned without a round trip through the string.
+  if constexpr ( isNumber<TT>() )
+  {
+    switch ( m_tNumericType )
+    {
+      case NumericInt:
+        return static_cast<TT>( m_llValue );
+      case NumericUInt:
+        return static_cast<TT>( m_ullValue );
+      case NumericReal:
+        return static_cast<TT>( m_xValue );
+      default:
+        break;
+    }
+  }
+
   TT tValue;
   //  stream the data into the variable.
-  std::stringstream ssValue( m_szValue );
+  std::stringstream ssValue( valueString() );
   ssValue >> std::boolalpha >> tValue;
   return tValue;
 }
@@ -281,11 +523,7 @@ template <class TT> TT pcf::IndiElement::getValue() const
 template <class TT> const TT &pcf::IndiElement::operator= ( const TT &ttValue )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
-
-  std::stringstream ssValue;
-  ssValue.precision( 15 );
-  ssValue << std::boolalpha << ttValue;
-  m_szValue = ssValue.str();
+  storeValue( ttValue );
   return ttValue;
 }
 
@@ -295,11 +533,7 @@ template <class TT> const TT &pcf::IndiElement::operator= ( const TT &ttValue )
 template <class TT> void pcf::IndiElement::set( const TT &ttValue )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
-
-  std::stringstream ssValue;
-  ssValue.precision( 15 );
-  ssValue << std::boolalpha << ttValue;
-  m_szValue = ssValue.str();
+  storeValue( ttValue );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -308,11 +542,7 @@ template <class TT> void pcf::IndiElement::set( const TT &ttValue )
 template <class TT> void pcf::IndiElement::setValue( const TT &ttValue )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
-
-  std::stringstream ssValue;
-  ssValue.precision( 15 );
-  ssValue << std::boolalpha << ttValue;
-  m_szValue = ssValue.str();
+  storeValue( ttValue );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -322,10 +552,7 @@ template <class TT> void pcf::IndiElement::setMax( const TT &ttMax )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  std::stringstream ssValue;
-  ssValue.precision( 15 );
-  ssValue << std::boolalpha << ttMax;
-  m_szMax = ssValue.str();
+  m_szMax = toString( ttMax );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -335,10 +562,7 @@ template <class TT> void pcf::IndiElement::setMin( const TT &ttMin )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  std::stringstream ssValue;
-  ssValue.precision( 15 );
-  ssValue << std::boolalpha << ttMin;
-  m_szMin = ssValue.str();
+  m_szMin = toString( ttMin );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -348,10 +572,7 @@ template <class TT> void pcf::IndiElement::setSize( const TT &ttSize )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  std::stringstream ssValue;
-  ssValue.precision( 15 );
-  ssValue << std::boolalpha << ttSize;
-  m_szSize = ssValue.str();
+  m_szSize = toString( ttSize );
 }
 
 /*
@@ -376,10 +597,7 @@ template <class TT> void pcf::IndiElement::setStep( const TT &ttStep )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  std::stringstream ssValue;
-  ssValue.precision( 15 );
-  ssValue << std::boolalpha << ttStep;
-  m_szStep = ssValue.str();
+  m_szStep = toString( ttStep );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
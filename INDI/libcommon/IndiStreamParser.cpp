@@ -0,0 +1,659 @@
+/// IndiStreamParser.cpp
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include "IndiStreamParser.hpp"
+#include "TimeStamp.hpp"
+
+using std::string;
+using std::vector;
+using pcf::IndiElement;
+using pcf::IndiMessage;
+using pcf::IndiProperty;
+using pcf::IndiStreamParser;
+using pcf::TimeStamp;
+
+namespace
+{
+// The defaults of the element attributes, so they are not constructed each time.
+const string g_szDefaultFormat( "%g" );
+const string g_szZero( "0" );
+
+// Can this character start (oStart true) or continue a tag or attribute name?
+// These are the same rules as lilxml.
+inline bool isTokenChar( const bool &oStart, const char &c )
+{
+  const unsigned char uc = static_cast<unsigned char>( c );
+  return ( ::isalpha( uc ) || c == '_' ||
+           ( oStart == false && ( ::isdigit( uc ) || c == '.' || c == ':' || c == '-' ) ) );
+}
+
+// Remove trailing whitespace.
+inline void chomp( string &szText )
+{
+  size_t sz = szText.size();
+  while ( sz > 0 && ::isspace( static_cast<unsigned char>( szText[sz-1] ) ) )
+    sz--;
+  szText.resize( sz );
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+
+IndiStreamParser::IndiStreamParser() : m_vecAttrs( NumAttrs )
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+
+IndiStreamParser::~IndiStreamParser()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Forget any partial message and all cached properties.
+
+void IndiStreamParser::clear()
+{
+  m_tParseState = LookForStart;
+  m_tState = IncompleteState;
+  m_oResync = false;
+  m_nDepth = 0;
+  m_pipCurr = nullptr;
+  m_pieCurr = nullptr;
+  m_mapProps.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+IndiStreamParser::State IndiStreamParser::getState() const
+{
+  return m_tState;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const IndiMessage::Type &IndiStreamParser::getType() const
+{
+  return m_tMsgType;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const IndiProperty &IndiStreamParser::getProperty() const
+{
+  return ( m_pipCurr != nullptr ) ? ( *m_pipCurr ) : ( m_ipEmpty );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+unsigned int IndiStreamParser::getNumErrors() const
+{
+  return m_uiNumErrors;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Parses bytes until the end of the next complete message, or the end of the
+/// bytes. Returns the number of bytes used.
+
+unsigned int IndiStreamParser::parse( const char *pcXml,
+                                      const unsigned int &uiNumBytes )
+{
+  m_tState = IncompleteState;
+
+  unsigned int ii = 0;
+  while ( ii < uiNumBytes )
+  {
+    char c = pcXml[ii++];
+
+    switch ( m_tParseState )
+    {
+      case LookForStart:
+        // Anything between messages is ignored.
+        if ( c == '<' )
+          m_tParseState = SawLt;
+        break;
+
+      case SawLt:
+        if ( c == '/' && m_oResync == true )
+        {
+          // The end of the message we gave up on.
+          m_tParseState = InDeclaration;
+        }
+        else if ( c == '/' )
+        {
+          m_szTag.clear();
+          m_tParseState = InEndTag;
+        }
+        else if ( c == '?' || c == '!' )
+        {
+          m_tParseState = InDeclaration;
+        }
+        else if ( isTokenChar( true, c ) )
+        {
+          m_szTag.assign( 1, c );
+          m_tParseState = InTag;
+        }
+        else if ( ::isspace( static_cast<unsigned char>( c ) ) == 0 )
+        {
+          error( "bad tag character" );
+        }
+        break;
+
+      case InTag:
+        if ( isTokenChar( false, c ) )
+        {
+          m_szTag += c;
+          break;
+        }
+        beginTag();
+        if ( m_oResync == true )
+        {
+          // This is not the start of a message, so keep skipping.
+          m_nDepth = 0;
+          m_tParseState = ( c == '>' ) ? ( LookForStart ) : ( InDeclaration );
+        }
+        else if ( c == '>' )
+        {
+          openElement();
+          m_tParseState = InContent;
+        }
+        else if ( c == '/' )
+          m_tParseState = SawSlash;
+        else if ( ::isspace( static_cast<unsigned char>( c ) ) != 0 )
+          m_tParseState = LookForAttrName;
+        else
+          error( "bad tag character" );
+        break;
+
+      case LookForAttrName:
+        if ( c == '>' )
+        {
+          openElement();
+          m_tParseState = InContent;
+        }
+        else if ( c == '/' )
+          m_tParseState = SawSlash;
+        else if ( isTokenChar( true, c ) )
+        {
+          m_szAttrName.assign( 1, c );
+          m_tParseState = InAttrName;
+        }
+        else if ( ::isspace( static_cast<unsigned char>( c ) ) == 0 )
+          error( "bad attribute name character" );
+        break;
+
+      case InAttrName:
+        if ( isTokenChar( false, c ) )
+          m_szAttrName += c;
+        else if ( ::isspace( static_cast<unsigned char>( c ) ) != 0 || c == '=' )
+          m_tParseState = LookForAttrValue;
+        else
+          error( "bad attribute name character" );
+        break;
+
+      case LookForAttrValue:
+        if ( c == '"' || c == '\'' )
+        {
+          m_cDelim = c;
+          m_szAttrValue.clear();
+          m_tParseState = InAttrValue;
+        }
+        else if ( ::isspace( static_cast<unsigned char>( c ) ) == 0 && c != '=' )
+          error( "no attribute value" );
+        break;
+
+      case InAttrValue:
+        if ( c == m_cDelim )
+        {
+          endAttribute();
+          m_tParseState = LookForAttrName;
+        }
+        else if ( c == '&' )
+        {
+          m_szEntity.assign( 1, c );
+          m_tParseState = EntityInAttrValue;
+        }
+        else if ( ::iscntrl( static_cast<unsigned char>( c ) ) == 0 )
+          m_szAttrValue += c;
+        break;
+
+      case EntityInAttrValue:
+        m_szEntity += c;
+        if ( c == ';' || m_szEntity.size() >= MaxEntitySize )
+        {
+          decodeEntity( m_szAttrValue );
+          m_tParseState = InAttrValue;
+        }
+        break;
+
+      case SawSlash:
+        if ( c != '>' )
+        {
+          error( "bad character before '>'" );
+          break;
+        }
+        openElement();
+        if ( closeElement() == true )
+        {
+          m_tParseState = LookForStart;
+          m_tState = CompleteState;
+          return ii;
+        }
+        m_tParseState = InContent;
+        break;
+
+      case InContent:
+        if ( c == '<' )
+        {
+          m_tParseState = SawLt;
+        }
+        else if ( c == '&' )
+        {
+          m_szEntity.assign( 1, c );
+          m_tParseState = EntityInContent;
+        }
+        else if ( m_szText.size() > 0 || ::isspace( static_cast<unsigned char>( c ) ) == 0 )
+        {
+          // Take the whole run of text up to the next markup at once.
+          unsigned int uiStart = ii - 1;
+          while ( ii < uiNumBytes && pcXml[ii] != '<' && pcXml[ii] != '&' )
+            ii++;
+          m_szText.append( pcXml + uiStart, ii - uiStart );
+        }
+        break;
+
+      case EntityInContent:
+        m_szEntity += c;
+        if ( c == ';' || m_szEntity.size() >= MaxEntitySize )
+        {
+          decodeEntity( m_szText );
+          m_tParseState = InContent;
+        }
+        break;
+
+      case InEndTag:
+        if ( isTokenChar( m_szTag.size() == 0, c ) )
+        {
+          m_szTag += c;
+        }
+        else if ( c == '>' )
+        {
+          if ( m_nDepth < 1 || m_szTag != m_vecTags[m_nDepth-1] )
+          {
+            error( "end tag does not match" );
+            break;
+          }
+          if ( closeElement() == true )
+          {
+            m_tParseState = LookForStart;
+            m_tState = CompleteState;
+            return ii;
+          }
+          m_tParseState = InContent;
+        }
+        else if ( ::isspace( static_cast<unsigned char>( c ) ) == 0 )
+          error( "bad end tag character" );
+        break;
+
+      case InDeclaration:
+        if ( c == '>' )
+          m_tParseState = ( m_nDepth == 0 ) ? ( LookForStart ) : ( InContent );
+        break;
+    }
+  }
+
+  return ii;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Called when the tag name of a start tag is complete.
+
+void IndiStreamParser::beginTag()
+{
+  m_nDepth++;
+
+  if ( (int)( m_vecTags.size() ) < m_nDepth )
+    m_vecTags.push_back( m_szTag );
+  else
+    m_vecTags[m_nDepth-1] = m_szTag;
+
+  // Only the attributes of the message and its elements are kept.
+  if ( m_nDepth <= 2 )
+  {
+    for ( unsigned int ii = 0; ii < m_vecAttrs.size(); ii++ )
+      m_vecAttrs[ii].clear();
+  }
+
+  if ( m_nDepth == 1 )
+  {
+    bool oKnown = false;
+    m_tMsgType = IndiMessage::Unknown;
+    m_tPropType = IndiProperty::Unknown;
+    m_tContentType = ValueContent;
+
+    // The message types, the same as IndiXmlParser.
+    static const struct
+    {
+      const char *pcTag;
+      IndiMessage::Type tMsgType;
+      IndiProperty::Type tPropType;
+      ContentType tContentType;
+    } s_msgTypes[] =
+    {
+      { "defBLOBVector", IndiMessage::Define, IndiProperty::BLOB, ValueContent },
+      { "defLightVector", IndiMessage::Define, IndiProperty::Light, LightContent },
+      { "defNumberVector", IndiMessage::Define, IndiProperty::Number, ValueContent },
+      { "defSwitchVector", IndiMessage::Define, IndiProperty::Switch, SwitchContent },
+      { "defTextVector", IndiMessage::Define, IndiProperty::Text, ValueContent },
+      { "delProperty", IndiMessage::Delete, IndiProperty::Unknown, ValueContent },
+      { "enableBLOB", IndiMessage::EnableBLOB, IndiProperty::Unknown, ValueContent },
+      { "getProperties", IndiMessage::GetProperties, IndiProperty::Unknown, ValueContent },
+      { "message", IndiMessage::Message, IndiProperty::Unknown, ValueContent },
+      { "newBLOBVector", IndiMessage::NewProperty, IndiProperty::BLOB, ValueContent },
+      { "newNumberVector", IndiMessage::NewProperty, IndiProperty::Number, ValueContent },
+      { "newSwitchVector", IndiMessage::NewProperty, IndiProperty::Switch, SwitchContent },
+      { "newTextVector", IndiMessage::NewProperty, IndiProperty::Text, ValueContent },
+      { "setBLOBVector", IndiMessage::SetProperty, IndiProperty::BLOB, ValueContent },
+      { "setLightVector", IndiMessage::SetProperty, IndiProperty::Light, LightContent },
+      { "setNumberVector", IndiMessage::SetProperty, IndiProperty::Number, ValueContent },
+      { "setSwitchVector", IndiMessage::SetProperty, IndiProperty::Switch, SwitchContent },
+      { "setTextVector", IndiMessage::SetProperty, IndiProperty::Text, ValueContent },
+    };
+
+    for ( unsigned int ii = 0; ii < sizeof( s_msgTypes ) / sizeof( s_msgTypes[0] ); ii++ )
+    {
+      if ( m_szTag == s_msgTypes[ii].pcTag )
+      {
+        m_tMsgType = s_msgTypes[ii].tMsgType;
+        m_tPropType = s_msgTypes[ii].tPropType;
+        m_tContentType = s_msgTypes[ii].tContentType;
+        oKnown = true;
+        break;
+      }
+    }
+
+    // After an error, we start again at the next message we know.
+    if ( oKnown == true )
+      m_oResync = false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Called when an attribute is complete.
+
+void IndiStreamParser::endAttribute()
+{
+  if ( m_nDepth > 2 )
+    return;
+
+  Attribute tAttr = convertStringToAttribute( m_szAttrName );
+
+  if ( tAttr != UnknownAttr )
+    m_vecAttrs[tAttr] = m_szAttrValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Called at the '>' of a start tag, after all its attributes.
+
+void IndiStreamParser::openElement()
+{
+  m_szText.clear();
+
+  if ( m_nDepth == 1 )
+  {
+    openMessage();
+  }
+  else if ( m_nDepth == 2 && m_pipCurr != nullptr )
+  {
+    const string &szName = m_vecAttrs[NameAttr];
+
+    if ( m_pipCurr->find( szName ) == false )
+      m_pipCurr->add( IndiElement( szName ) );
+
+    m_pieCurr = &m_pipCurr->at( szName );
+
+    // Anything not given is reset to the default, as if the element was new.
+    const string &szFormat = m_vecAttrs[FormatAttr];
+    m_pieCurr->setFormat( ( szFormat.size() > 0 ) ? ( szFormat ) : ( g_szDefaultFormat ) );
+    m_pieCurr->setLabel( m_vecAttrs[LabelAttr] );
+    const string &szMax = m_vecAttrs[MaxAttr];
+    m_pieCurr->setMax( ( szMax.size() > 0 ) ? ( szMax ) : ( g_szZero ) );
+    const string &szMin = m_vecAttrs[MinAttr];
+    m_pieCurr->setMin( ( szMin.size() > 0 ) ? ( szMin ) : ( g_szZero ) );
+    const string &szSize = m_vecAttrs[SizeAttr];
+    m_pieCurr->setSize( ( szSize.size() > 0 ) ? ( szSize ) : ( g_szZero ) );
+    const string &szStep = m_vecAttrs[StepAttr];
+    m_pieCurr->setStep( ( szStep.size() > 0 ) ? ( szStep ) : ( g_szZero ) );
+
+    // Remember which elements are in this message.
+    if ( m_uiNumSeen < m_vecSeen.size() )
+      m_vecSeen[m_uiNumSeen] = szName;
+    else
+      m_vecSeen.push_back( szName );
+    m_uiNumSeen++;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Called at the end of an element. Returns true if a message is complete.
+
+bool IndiStreamParser::closeElement()
+{
+  bool oComplete = false;
+
+  if ( m_nDepth == 1 )
+  {
+    chomp( m_szText );
+    closeMessage();
+    oComplete = true;
+  }
+  else if ( m_nDepth == 2 && m_pieCurr != nullptr )
+  {
+    chomp( m_szText );
+
+    switch ( m_tContentType )
+    {
+      case LightContent:
+        m_pieCurr->setLightState( IndiElement::getLightStateType( m_szText ) );
+        break;
+      case SwitchContent:
+        m_pieCurr->setSwitchState( IndiElement::getSwitchStateType( m_szText ) );
+        break;
+      default:
+        m_pieCurr->setValue( m_szText );
+    }
+    m_pieCurr = nullptr;
+  }
+
+  m_szText.clear();
+  m_nDepth--;
+
+  return oComplete;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Prepares the cached property for the new message. Every attribute is set,
+/// so nothing is left over from the last time this property was received.
+
+void IndiStreamParser::openMessage()
+{
+  const string &szDevice = m_vecAttrs[DeviceAttr];
+  const string &szName = m_vecAttrs[NameAttr];
+
+  m_szKey.assign( m_vecTags[0] );
+  m_szKey += ' ';
+  m_szKey += szDevice;
+  m_szKey += '.';
+  m_szKey += szName;
+
+  std::unordered_map<string, IndiProperty>::iterator itr = m_mapProps.find( m_szKey );
+
+  if ( itr == m_mapProps.end() )
+  {
+    // Don't let a stream of unique names grow the cache without limit.
+    if ( m_mapProps.size() >= MaxCachedProperties )
+      m_mapProps.clear();
+
+    itr = m_mapProps.emplace( m_szKey, IndiProperty( m_tPropType ) ).first;
+  }
+
+  m_pipCurr = &itr->second;
+  m_pieCurr = nullptr;
+  m_uiNumSeen = 0;
+
+  m_pipCurr->setDevice( szDevice );
+  m_pipCurr->setGroup( m_vecAttrs[GroupAttr] );
+  m_pipCurr->setLabel( m_vecAttrs[LabelAttr] );
+  m_pipCurr->setMessage( m_vecAttrs[MessageAttr] );
+  m_pipCurr->setName( szName );
+  m_pipCurr->setPerm( IndiProperty::getPropertyPermType( m_vecAttrs[PermAttr] ) );
+  m_pipCurr->setRule( IndiProperty::getSwitchRuleType( m_vecAttrs[RuleAttr] ) );
+  m_pipCurr->setState( IndiProperty::getPropertyStateType( m_vecAttrs[StateAttr] ) );
+  m_pipCurr->setTimeout( ::strtod( m_vecAttrs[TimeoutAttr].c_str(), NULL ) );
+  m_pipCurr->setVersion( m_vecAttrs[VersionAttr] );
+
+  m_szTimeStamp = m_vecAttrs[TimeStampAttr];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Finishes the message once all its elements are in.
+
+void IndiStreamParser::closeMessage()
+{
+  if ( m_pipCurr == nullptr )
+    return;
+
+  // Remove the elements from the last time which are not in this message.
+  if ( m_uiNumSeen != m_pipCurr->getNumElements() )
+  {
+    vector<string> vecRemove;
+    const std::map<string, IndiElement> &mapElements = m_pipCurr->getElements();
+    std::map<string, IndiElement>::const_iterator itr = mapElements.begin();
+    for ( ; itr != mapElements.end(); ++itr )
+    {
+      unsigned int ii = 0;
+      while ( ii < m_uiNumSeen && m_vecSeen[ii] != itr->first )
+        ii++;
+      if ( ii == m_uiNumSeen )
+        vecRemove.push_back( itr->first );
+    }
+    for ( unsigned int ii = 0; ii < vecRemove.size(); ii++ )
+      m_pipCurr->remove( vecRemove[ii] );
+  }
+
+  // This matches IndiXmlParser: adding elements sets the time to now, so the
+  // timestamp attribute is only used for a message without elements.
+  if ( m_uiNumSeen == 0 && m_szTimeStamp.size() > 0 )
+  {
+    TimeStamp tsMod;
+    tsMod.fromFormattedIso8601Str( m_szTimeStamp );
+    m_pipCurr->setTimeStamp( tsMod );
+  }
+  else
+  {
+    m_pipCurr->setTimeStamp( TimeStamp::now() );
+  }
+
+  // A BLOB enable message has no elements, but has data in it.
+  if ( m_tMsgType == IndiMessage::EnableBLOB )
+    *m_pipCurr = IndiProperty::getBLOBEnableType( m_szText );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Appends the entity in m_szEntity to szText, decoded if it is one we know,
+/// otherwise as it is.
+
+void IndiStreamParser::decodeEntity( string &szText )
+{
+  if ( m_szEntity == "&amp;" )
+    szText += '&';
+  else if ( m_szEntity == "&apos;" )
+    szText += '\'';
+  else if ( m_szEntity == "&lt;" )
+    szText += '<';
+  else if ( m_szEntity == "&gt;" )
+    szText += '>';
+  else if ( m_szEntity == "&quot;" )
+    szText += '"';
+  else
+    szText += m_szEntity;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Logs an error and skips to the start of the next message.
+
+void IndiStreamParser::error( const char *pcWhy )
+{
+  m_uiNumErrors++;
+
+  std::cerr << "Error processing XML: " << pcWhy;
+  if ( m_nDepth > 0 )
+    std::cerr << " in '" << m_vecTags[0] << "'";
+  std::cerr << std::endl;
+
+  m_tParseState = LookForStart;
+  m_oResync = true;
+  m_nDepth = 0;
+  m_pipCurr = nullptr;
+  m_pieCurr = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Returns the attribute given its name.
+
+IndiStreamParser::Attribute IndiStreamParser::convertStringToAttribute( const string &szName )
+{
+  // Switch on the first letter so most names need only one comparison.
+  switch ( szName.size() > 0 ? szName[0] : 0 )
+  {
+    case 'd':
+      if ( szName == "device" ) return DeviceAttr;
+      break;
+    case 'f':
+      if ( szName == "format" ) return FormatAttr;
+      break;
+    case 'g':
+      if ( szName == "group" ) return GroupAttr;
+      break;
+    case 'l':
+      if ( szName == "label" ) return LabelAttr;
+      break;
+    case 'm':
+      if ( szName == "message" ) return MessageAttr;
+      if ( szName == "max" ) return MaxAttr;
+      if ( szName == "min" ) return MinAttr;
+      break;
+    case 'n':
+      if ( szName == "name" ) return NameAttr;
+      break;
+    case 'p':
+      if ( szName == "perm" ) return PermAttr;
+      break;
+    case 'r':
+      if ( szName == "rule" ) return RuleAttr;
+      break;
+    case 's':
+      if ( szName == "state" ) return StateAttr;
+      if ( szName == "size" ) return SizeAttr;
+      if ( szName == "step" ) return StepAttr;
+      break;
+    case 't':
+      if ( szName == "timeout" ) return TimeoutAttr;
+      if ( szName == "timestamp" ) return TimeStampAttr;
+      break;
+    case 'v':
+      if ( szName == "version" ) return VersionAttr;
+      break;
+  }
+
+  return UnknownAttr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
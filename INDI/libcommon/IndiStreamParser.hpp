@@ -0,0 +1,214 @@
+/// IndiStreamParser.hpp
+///
+/// An incremental parser for the stream of INDI XML messages read from a
+/// connection. The bytes are scanned once, as they arrive, by a state machine
+/// which keeps its place between calls, so a message split across reads is
+/// never re-scanned. Each message is decoded straight into an IndiProperty
+/// which is kept and reused the next time the same property arrives, so in
+/// the steady state parsing allocates no memory.
+///
+/// This replaces the lilxml tree built by IndiXmlParser for input. That class
+/// is still used to create the XML for output.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INDI_STREAM_PARSER_HPP
+#define INDI_STREAM_PARSER_HPP
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "IndiProperty.hpp"
+#include "IndiMessage.hpp"
+
+namespace pcf
+{
+class IndiStreamParser
+{
+  private:
+    // Where we are in the XML.
+    enum ParseState
+    {
+      LookForStart = 0,
+      SawLt,
+      InTag,
+      LookForAttrName,
+      InAttrName,
+      LookForAttrValue,
+      InAttrValue,
+      EntityInAttrValue,
+      SawSlash,
+      InContent,
+      EntityInContent,
+      InEndTag,
+      InDeclaration,
+    };
+
+    // The attributes we use, of the message and of its elements.
+    enum Attribute
+    {
+      UnknownAttr = -1,
+      // The message.
+      DeviceAttr = 0,
+      GroupAttr,
+      LabelAttr,
+      MessageAttr,
+      NameAttr,
+      PermAttr,
+      RuleAttr,
+      StateAttr,
+      TimeoutAttr,
+      TimeStampAttr,
+      VersionAttr,
+      // The elements.
+      FormatAttr,
+      MaxAttr,
+      MinAttr,
+      SizeAttr,
+      StepAttr,
+      NumAttrs
+    };
+
+    // How the content of an element is stored.
+    enum ContentType
+    {
+      ValueContent = 0,
+      LightContent,
+      SwitchContent
+    };
+
+    enum Constants
+    {
+      // An entity longer than this is not one we know, and is kept as text.
+      MaxEntitySize = 8,
+      // If this many properties are cached, the cache is emptied.
+      MaxCachedProperties = 16384,
+    };
+
+  public:
+    enum State
+    {
+      UnknownState = 0,
+      IncompleteState,
+      CompleteState
+    };
+
+  // Constructor/destructor.
+  public:
+    /// Constructor.
+    IndiStreamParser();
+    /// Destructor.
+    virtual ~IndiStreamParser();
+
+  // Prevent these from being invoked.
+  private:
+    IndiStreamParser( const IndiStreamParser &ispRhs );
+    const IndiStreamParser &operator= ( const IndiStreamParser &ispRhs );
+
+  // Methods.
+  public:
+    /// Forget any partial message and all cached properties.
+    void clear();
+    /// Parses bytes until the end of the next complete message, or the end of
+    /// the bytes. Returns the number of bytes used. If a message is complete,
+    /// the state is CompleteState and the message can be retrieved with
+    /// getType and getProperty. Call again with the remaining bytes to
+    /// continue. A message can be split across any number of calls.
+    unsigned int parse( const char *pcXml,
+                        const unsigned int &uiNumBytes );
+    /// Gets the state, showing whether a message is complete.
+    State getState() const;
+    /// The type of the message just completed.
+    const pcf::IndiMessage::Type &getType() const;
+    /// The property from the message just completed. It is valid until the
+    /// next call to parse or clear, and will be reused for the next message
+    /// for the same property, so copy it to keep it.
+    const pcf::IndiProperty &getProperty() const;
+    /// The number of errors found in the XML so far.
+    unsigned int getNumErrors() const;
+
+  // Helper functions.
+  private:
+    /// Called when the tag name of a start tag is complete.
+    void beginTag();
+    /// Called when an attribute is complete.
+    void endAttribute();
+    /// Called at the '>' of a start tag, after all its attributes.
+    void openElement();
+    /// Called at the end of an element. Returns true if a message is complete.
+    bool closeElement();
+    /// Prepares the cached property for the new message.
+    void openMessage();
+    /// Finishes the message once all its elements are in.
+    void closeMessage();
+    /// Appends the entity to szText, decoded if it is one we know.
+    void decodeEntity( std::string &szText );
+    /// Logs an error and skips to the start of the next message.
+    void error( const char *pcWhy );
+    /// Returns the attribute given its name.
+    static Attribute convertStringToAttribute( const std::string &szName );
+
+  // Members.
+  private:
+    /// Where we are in the XML.
+    ParseState m_tParseState {LookForStart};
+    /// Whether a message has just been completed.
+    State m_tState {IncompleteState};
+    /// The depth of the element being parsed. The message is depth 1.
+    int m_nDepth {0};
+    /// The quote character around the attribute value being parsed.
+    char m_cDelim {'"'};
+    /// The number of errors so far.
+    unsigned int m_uiNumErrors {0};
+    /// After an error, everything is skipped until the next message starts.
+    bool m_oResync {false};
+
+    /// The tag being parsed.
+    std::string m_szTag;
+    /// The tags of the open elements, to match the end tags. Only the first
+    /// m_nDepth are used.
+    std::vector<std::string> m_vecTags;
+    /// The attribute name being parsed.
+    std::string m_szAttrName;
+    /// The attribute value being parsed.
+    std::string m_szAttrValue;
+    /// The entity being parsed.
+    std::string m_szEntity;
+    /// The content of the element being parsed.
+    std::string m_szText;
+    /// The values of the attributes of the message or element being parsed.
+    /// An empty value means it was not given.
+    std::vector<std::string> m_vecAttrs;
+
+    /// The message type of the message being parsed.
+    pcf::IndiMessage::Type m_tMsgType {pcf::IndiMessage::Unknown};
+    /// The property type of the message being parsed.
+    pcf::IndiProperty::Type m_tPropType {pcf::IndiProperty::Unknown};
+    /// How the content of the elements of the message is stored.
+    ContentType m_tContentType {ValueContent};
+
+    /// The timestamp attribute of the message being parsed.
+    std::string m_szTimeStamp;
+    /// The key of the property being parsed in the cache.
+    std::string m_szKey;
+    /// The properties, reused each time the same one is received.
+    std::unordered_map<std::string, pcf::IndiProperty> m_mapProps;
+    /// The property being parsed, which is in m_mapProps.
+    pcf::IndiProperty *m_pipCurr {nullptr};
+    /// The element being parsed, which is in *m_pipCurr.
+    pcf::IndiElement *m_pieCurr {nullptr};
+    /// The names of the elements in this message, to find those in the
+    /// cached property which are not. Only the first m_uiNumSeen are used.
+    std::vector<std::string> m_vecSeen;
+    unsigned int m_uiNumSeen {0};
+
+    /// Returned while there is no property.
+    pcf::IndiProperty m_ipEmpty;
+
+}; // class IndiStreamParser
+} // namespace pcf
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // INDI_STREAM_PARSER_HPP
@@ -0,0 +1,213 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../IndiDriver.hpp"
+#include "../IndiStreamParser.hpp"
+
+using namespace pcf;
+
+/// A driver which sends and does nothing else
+class quietDriver : public IndiDriver
+{
+public:
+   quietDriver() : IndiDriver("quiet", "1", "1.7")
+   {
+      enableResponseMode(true);
+   }
+
+   virtual void update()
+   {
+   }
+};
+
+/// A property to send, with one number
+IndiProperty numberProp( const std::string & name,
+                         int value
+                       )
+{
+   IndiProperty prop(IndiProperty::Number, "quiet", name);
+   prop.add(IndiElement("value", value));
+   return prop;
+}
+
+/// Read and parse until an update of the named property to the value arrives
+std::vector<IndiMessage> drain( int fd,
+                                const std::string & name,
+                                int value
+                              )
+{
+   std::vector<IndiMessage> msgs;
+   IndiStreamParser isp;
+
+   bool done = false;
+   while(!done)
+   {
+      pollfd pfd = {fd, POLLIN, 0};
+      if(::poll(&pfd, 1, 5000) <= 0) break; //timed out, so the test will fail
+
+      char buf[4096];
+      int n = ::read(fd, buf, sizeof(buf));
+      if(n <= 0) break;
+
+      unsigned int used = 0;
+      while(used < (unsigned int) n)
+      {
+         used += isp.parse(buf + used, n - used);
+         if(isp.getState() == IndiStreamParser::CompleteState)
+         {
+            msgs.push_back(IndiMessage(isp.getType(), isp.getProperty()));
+
+            const IndiProperty & prop = isp.getProperty();
+            if(isp.getType() == IndiMessage::SetProperty && prop.getName() == name && prop["value"].get<int>() == value) done = true;
+         }
+      }
+   }
+
+   return msgs;
+}
+
+SCENARIO( "Sending to a slow reader", "[IndiConnection]" )
+{
+   GIVEN("a driver writing to a small pipe which is not being read")
+   {
+      int fds[2];
+      REQUIRE( ::pipe(fds) == 0 );
+      ::fcntl(fds[0], F_SETPIPE_SZ, 4096);
+      ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+      int fdsIn[2];
+      REQUIRE( ::pipe(fdsIn) == 0 );
+
+      quietDriver drv;
+      drv.setOutputFd(fds[1]);
+      drv.setInputFd(fdsIn[0]);
+
+      //The process loop writes what is waiting once the pipe has room
+      std::thread proc([&drv](){ drv.processIndiRequests(false); });
+
+      WHEN("many updates are sent")
+      {
+         //This fills the pipe, and then the rest wait in the queue
+         for(int n = 0; n < 1000; ++n)
+         {
+            drv.sendSetProperty(numberProp("prop" + std::to_string(n % 10), n));
+         }
+
+         IndiConnection::OutputStats stats = drv.getOutputStats();
+         REQUIRE( stats.ullNumQueued == 1000 );
+         REQUIRE( stats.ullNumBlocked == 1 );
+         REQUIRE( stats.ullNumCoalesced > 900 );
+         REQUIRE( stats.ullNumPending <= 11 );
+
+         //Only the latest value of each property is waiting
+         drv.sendSetProperty(numberProp("prop0", 1000));
+         std::vector<IndiMessage> msgs = drain(fds[0], "prop0", 1000);
+
+         std::map<std::string, int> last;
+         for(size_t n = 0; n < msgs.size(); ++n)
+         {
+            const IndiProperty & prop = msgs[n].getProperty();
+            int v = prop["value"].get<int>();
+
+            //Values of a property only ever increase
+            if(last.count(prop.getName()) > 0) REQUIRE( v > last[prop.getName()] );
+            last[prop.getName()] = v;
+         }
+
+         REQUIRE( last.size() == 10 );
+         REQUIRE( last["prop0"] == 1000 );
+         for(int n = 1; n < 10; ++n) REQUIRE( last["prop" + std::to_string(n)] == 990 + n );
+
+         stats = drv.getOutputStats();
+         REQUIRE( stats.ullNumWritten + stats.ullNumCoalesced == 1001 );
+         REQUIRE( stats.ullNumPending == 0 );
+         REQUIRE( stats.ullNumPendingBytes == 0 );
+         REQUIRE( stats.ullNumDeferred == 0 );
+      }
+
+      WHEN("another message comes between two updates")
+      {
+         for(int n = 0; n < 100; ++n) drv.sendSetProperty(numberProp("fill", n));
+
+         drv.sendSetProperty(numberProp("prop", 1));
+         drv.sendDelProperty(numberProp("prop", 0));
+         drv.sendSetProperty(numberProp("prop", 2));
+
+         drv.sendSetProperty(numberProp("fill", 100));
+         std::vector<IndiMessage> msgs = drain(fds[0], "fill", 100);
+
+         //The update before the delete is not replaced by the one after it
+         std::vector<int> order;
+         for(size_t n = 0; n < msgs.size(); ++n)
+         {
+            if(msgs[n].getProperty().getName() != "prop") continue;
+            if(msgs[n].getType() == IndiMessage::Delete) order.push_back(0);
+            else order.push_back(msgs[n].getProperty()["value"].get<int>());
+         }
+
+         REQUIRE( order == std::vector<int>({1, 0, 2}) );
+      }
+
+      WHEN("the queue is full")
+      {
+         drv.setMaxOutputBytes(1024);
+
+         for(int n = 0; n < 1000; ++n)
+         {
+            drv.sendSetProperty(numberProp("prop" + std::to_string(n), n));
+         }
+
+         IndiConnection::OutputStats stats = drv.getOutputStats();
+         REQUIRE( stats.ullNumDeferred > 0 );
+         REQUIRE( stats.ullNumPendingBytes <= 1024 );
+         REQUIRE( stats.ullNumCoalesced == 0 );
+
+         //New values of properties which were held back, and of one which was queued
+         drv.sendSetProperty(numberProp("prop1", 2001));
+         drv.sendSetProperty(numberProp("prop500", 2500));
+         drv.sendSetProperty(numberProp("prop998", 2998));
+         drv.sendSetProperty(numberProp("prop999", 2999));
+
+         stats = drv.getOutputStats();
+         REQUIRE( stats.ullNumPendingBytes <= 1024 );
+
+         std::vector<IndiMessage> msgs = drain(fds[0], "prop999", 2999);
+
+         //The latest value of every property arrives, none of them more than once after being held back
+         std::map<std::string, int> last;
+         for(size_t n = 0; n < msgs.size(); ++n)
+         {
+            const IndiProperty & prop = msgs[n].getProperty();
+            last[prop.getName()] = prop["value"].get<int>();
+         }
+
+         REQUIRE( last.size() == 1000 );
+         for(int n = 0; n < 1000; ++n)
+         {
+            int expected = n;
+            if(n == 1 || n == 500 || n == 998 || n == 999) expected += 2000;
+            REQUIRE( last["prop" + std::to_string(n)] == expected );
+         }
+
+         stats = drv.getOutputStats();
+         REQUIRE( stats.ullNumWritten + stats.ullNumCoalesced == 1004 );
+         REQUIRE( stats.ullNumPending == 0 );
+         REQUIRE( stats.ullNumPendingBytes == 0 );
+      }
+
+      drv.quitProcess();
+      proc.join();
+
+      ::close(fds[0]);
+      ::close(fdsIn[0]);
+      ::close(fdsIn[1]);
+   }
+}
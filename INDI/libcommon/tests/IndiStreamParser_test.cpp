@@ -0,0 +1,372 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../IndiStreamParser.hpp"
+#include "../IndiXmlParser.hpp"
+
+using namespace pcf;
+
+/// Hand-written traffic in the form xindiserver sends, with the odd things a stream can have.
+const char * sampleTraffic =
+"<getProperties version=\"1.7\"/>\n"
+"<getProperties version=\"1.7\" device=\"camwfs\"/>\n"
+"<defSwitchVector device=\"camwfs\" name=\"fsm\" label=\"FSM State\" group=\"FSM\" state=\"Idle\" perm=\"rw\" rule=\"OneOfMany\" timeout=\"60\" timestamp=\"2023-05-12T21:04:55.123456\">\n"
+"    <defSwitch name=\"READY\" label=\"Ready \xe2\x9c\x93\">\n"
+"On\n"
+"    </defSwitch>\n"
+"    <defSwitch name=\"OPERATING\">\n"
+"Off\n"
+"    </defSwitch>\n"
+"</defSwitchVector>\n"
+"<defLightVector device=\"camwfs\" name=\"alarms\" state=\"Alert\" timestamp=\"2023-05-12T21:04:55.123456\">\n"
+"    <defLight name=\"temp\">Alert</defLight>\n"
+"    <defLight name=\"power\">Ok</defLight>\n"
+"</defLightVector>\n"
+"<defTextVector device=\"camwfs\" name=\"status\" state=\"Ok\" perm=\"ro\" timestamp=\"2023-05-12T21:04:55.123456\">\n"
+"    <defText name=\"message\" label=\"Status &amp; Mode\">\n"
+"  ready &lt;cooling&gt; &quot;ok&quot; &apos;done&apos; &bogus; 5 \n"
+"    </defText>\n"
+"</defTextVector>\n"
+"<setNumberVector device='camwfs' name='temp_ccd' state='Busy' timestamp='2023-05-12T21:04:56.5'>\n"
+"    <oneNumber name='current'>-15.25</oneNumber>\n"
+"    <oneNumber name='target'>-15</oneNumber>\n"
+"</setNumberVector>\n"
+"<setNumberVector device=\"camwfs\" name=\"temp_ccd\" state=\"Ok\">\n"
+"    <oneNumber name=\"current\">\n"
+"-15.0\n"
+"    </oneNumber>\n"
+"</setNumberVector>\n"
+"<newSwitchVector device=\"camwfs\" name=\"fsm\">\n"
+"    <oneSwitch name=\"OPERATING\">On</oneSwitch>\n"
+"</newSwitchVector>\n"
+"<newTextVector device=\"camwfs\" name=\"status\"><oneText name=\"message\"></oneText></newTextVector>\n"
+"<message device=\"camwfs\" timestamp=\"2023-05-12T21:04:57.000001\" message=\"starting up\"/>\n"
+"<enableBLOB device=\"camwfs\">Also</enableBLOB>\n"
+"<delProperty device=\"camwfs\" name=\"fsm\" timestamp=\"2023-05-12T21:04:58.25\"/>\n"
+"<setBLOBVector device=\"camwfs\" name=\"image\" state=\"Ok\">\n"
+"    <oneBLOB name=\"frame\" size=\"12\" format=\".fits\">\n"
+"SGVsbG8gV29y\n"
+"bGQh\n"
+"    </oneBLOB>\n"
+"</setBLOBVector>\n"
+"<setNumberVector device=\"camwfs\" name=\"temp_ccd\" state=\"Ok\"><oneNumber name=\"current\">-14.5</oneNumber><oneNumber name=\"target\">-15</oneNumber></setNumberVector>";
+
+/// Make traffic like a busy server's: definitions of many properties, then many updates.
+std::string makeTraffic( int nProps,
+                         int nSets
+                       )
+{
+   std::string xml;
+
+   std::vector<IndiProperty> props;
+   for(int n = 0; n < nProps; ++n)
+   {
+      IndiProperty prop(IndiProperty::Number, "dev" + std::to_string(n%10), "prop" + std::to_string(n));
+      prop.setState(IndiProperty::Ok);
+      prop.setPerm(IndiProperty::ReadWrite);
+      prop.setLabel("Property " + std::to_string(n));
+      prop.setGroup("Group");
+      for(int e = 0; e < 2 + n % 5; ++e)
+      {
+         IndiElement el("el" + std::to_string(e), 0);
+         el.setFormat("%0.3f");
+         el.setMin(-100);
+         el.setMax(100);
+         el.setStep(0.1);
+         prop.add(el);
+      }
+      props.push_back(prop);
+
+      xml += IndiXmlParser(IndiMessage(IndiMessage::Define, prop)).createXmlString();
+   }
+
+   for(int s = 0; s < nSets; ++s)
+   {
+      IndiProperty & prop = props[s % nProps];
+      for(unsigned e = 0; e < prop.getNumElements(); ++e) prop[e].set(s*0.001 + e);
+
+      xml += IndiXmlParser(IndiMessage(IndiMessage::SetProperty, prop)).createXmlString();
+   }
+
+   return xml;
+}
+
+/// Parse the way IndiConnection used to, with IndiXmlParser
+std::vector<IndiMessage> parseOld( const std::string & xml,
+                                   size_t chunk
+                                 )
+{
+   std::vector<IndiMessage> msgs;
+   IndiXmlParser ixp;
+   std::string szErrorMsg;
+
+   for(size_t st = 0; st < xml.size(); st += chunk)
+   {
+      ixp.parseXml(xml.data() + st, std::min(chunk, xml.size() - st), szErrorMsg);
+
+      while(ixp.getState() == IndiXmlParser::CompleteState)
+      {
+         msgs.push_back(ixp.createIndiMessage());
+         ixp.parseXml("", szErrorMsg);
+      }
+   }
+
+   return msgs;
+}
+
+/// Parse with IndiStreamParser, in chunks of the given sizes in turn
+std::vector<IndiMessage> parseNew( IndiStreamParser & isp,
+                                   const std::string & xml,
+                                   const std::vector<size_t> & chunks
+                                 )
+{
+   std::vector<IndiMessage> msgs;
+
+   size_t st = 0;
+   for(size_t n = 0; st < xml.size(); ++n)
+   {
+      unsigned int len = std::min(chunks[n % chunks.size()], xml.size() - st);
+
+      unsigned int used = 0;
+      while(used < len)
+      {
+         used += isp.parse(xml.data() + st + used, len - used);
+         if(isp.getState() == IndiStreamParser::CompleteState)
+         {
+            msgs.push_back(IndiMessage(isp.getType(), isp.getProperty()));
+         }
+      }
+
+      st += len;
+   }
+
+   return msgs;
+}
+
+/// Count the messages which differ in anything but the time
+size_t countDifferent( const std::vector<IndiMessage> & msgs1,
+                       const std::vector<IndiMessage> & msgs2
+                     )
+{
+   if(msgs1.size() != msgs2.size()) return std::max(msgs1.size(), msgs2.size());
+
+   size_t ndiff = 0;
+   for(size_t n = 0; n < msgs1.size(); ++n)
+   {
+      const IndiProperty & p1 = msgs1[n].getProperty();
+      const IndiProperty & p2 = msgs2[n].getProperty();
+
+      bool same = ( msgs1[n].getType() == msgs2[n].getType() &&
+                    p1.getType() == p2.getType() &&
+                    p1.getDevice() == p2.getDevice() &&
+                    p1.getGroup() == p2.getGroup() &&
+                    p1.getLabel() == p2.getLabel() &&
+                    p1.getMessage() == p2.getMessage() &&
+                    p1.getName() == p2.getName() &&
+                    p1.getPerm() == p2.getPerm() &&
+                    p1.getRule() == p2.getRule() &&
+                    p1.getState() == p2.getState() &&
+                    p1.getTimeout() == p2.getTimeout() &&
+                    p1.getVersion() == p2.getVersion() &&
+                    p1.getBLOBEnable() == p2.getBLOBEnable() &&
+                    p1.getNumElements() == p2.getNumElements() );
+
+      for(unsigned e = 0; same && e < p1.getNumElements(); ++e)
+      {
+         const IndiElement & e1 = p1[e];
+         const IndiElement & e2 = p2[e];
+
+         same = ( e1.getName() == e2.getName() &&
+                  e1.getFormat() == e2.getFormat() &&
+                  e1.getLabel() == e2.getLabel() &&
+                  e1.getMax() == e2.getMax() &&
+                  e1.getMin() == e2.getMin() &&
+                  e1.getSize() == e2.getSize() &&
+                  e1.getStep() == e2.getStep() &&
+                  e1.getValue() == e2.getValue() &&
+                  e1.getLightState() == e2.getLightState() &&
+                  e1.getSwitchState() == e2.getSwitchState() );
+      }
+
+      if(!same)
+      {
+         std::cerr << "message " << n << " differs:\n" << p1.createString() << "\n" << p2.createString() << "\n";
+         ++ndiff;
+      }
+   }
+
+   return ndiff;
+}
+
+SCENARIO( "Parsing a stream of INDI XML", "[IndiStreamParser]" )
+{
+   GIVEN("sample traffic")
+   {
+      std::string xml = sampleTraffic;
+      std::vector<IndiMessage> msgsOld = parseOld(xml, 65536);
+      REQUIRE( msgsOld.size() == 14 );
+
+      WHEN("it arrives in one read")
+      {
+         IndiStreamParser isp;
+         std::vector<IndiMessage> msgs = parseNew(isp, xml, {65536});
+         REQUIRE( countDifferent(msgsOld, msgs) == 0 );
+         REQUIRE( isp.getNumErrors() == 0 );
+
+         REQUIRE( msgs[0].getType() == IndiMessage::GetProperties );
+         REQUIRE( msgs[0].getProperty().getVersion() == "1.7" );
+
+         const IndiProperty & fsm = msgs[2].getProperty();
+         REQUIRE( fsm.getRule() == IndiProperty::OneOfMany );
+         REQUIRE( fsm["READY"].getSwitchState() == IndiElement::On );
+         REQUIRE( fsm["READY"].getLabel() == "Ready \xe2\x9c\x93" );
+
+         REQUIRE( msgs[3].getProperty()["temp"].getLightState() == IndiElement::Alert );
+
+         REQUIRE( msgs[4].getProperty().getPerm() == IndiProperty::ReadOnly );
+         REQUIRE( msgs[4].getProperty()["message"].getLabel() == "Status & Mode" );
+         REQUIRE( msgs[4].getProperty()["message"].getValue() == "ready <cooling> \"ok\" 'done' &bogus; 5" );
+
+         REQUIRE( msgs[5].getProperty()["current"].get<double>() == -15.25 );
+         REQUIRE( msgs[6].getProperty()["current"].getValue() == "-15.0" );
+
+         REQUIRE( msgs[9].getProperty().getTimeStamp().getFormattedIso8601Str() == "2023-05-12T21:04:57.000001Z" );
+         REQUIRE( msgs[10].getProperty().getBLOBEnable() == IndiProperty::Also );
+         REQUIRE( msgs[11].getType() == IndiMessage::Delete );
+
+         REQUIRE( msgs[12].getProperty()["frame"].getValue() == "SGVsbG8gV29y\nbGQh" );
+      }
+
+      WHEN("it arrives a byte at a time")
+      {
+         IndiStreamParser isp;
+         std::vector<IndiMessage> msgs = parseNew(isp, xml, {1});
+         REQUIRE( countDifferent(msgsOld, msgs) == 0 );
+      }
+
+      WHEN("it arrives in reads of random sizes")
+      {
+         std::mt19937 gen(42);
+         std::uniform_int_distribution<size_t> dist(1, 200);
+
+         for(int t = 0; t < 20; ++t)
+         {
+            std::vector<size_t> chunks;
+            for(int n = 0; n < 100; ++n) chunks.push_back(dist(gen));
+
+            IndiStreamParser isp;
+            std::vector<IndiMessage> msgs = parseNew(isp, xml, chunks);
+            REQUIRE( countDifferent(msgsOld, msgs) == 0 );
+         }
+      }
+
+      WHEN("a message changes the elements of one already parsed")
+      {
+         IndiStreamParser isp;
+         std::vector<IndiMessage> msgs = parseNew(isp, xml, {65536});
+
+         //The cached property had "current" and "target", but the second update has only "current"
+         REQUIRE( msgs[5].getProperty().getNumElements() == 2 );
+         REQUIRE( msgs[6].getProperty().getNumElements() == 1 );
+         REQUIRE( msgs[13].getProperty().getNumElements() == 2 );
+      }
+   }
+
+   GIVEN("traffic with errors")
+   {
+      std::string xml = "<setNumberVector device=\"d\" name=\"n\"><oneNumber name=\"a\">1</oneNumbr></setNumberVector>\n"
+                        "<setNumberVector device=\"d\" name=\"n\"><oneNumber name=\"a\">2</oneNumber></setNumberVector>\n"
+                        "<setNumberVector device=\"d\" name=\"n\"><oneNumber name=a>3</oneNumber></setNumberVector>\n"
+                        "<setNumberVector device=\"d\" name=\"n\"><oneNumber name=\"a\">4</oneNumber></setNumberVector>\n";
+
+      WHEN("parsing")
+      {
+         IndiStreamParser isp;
+         std::vector<IndiMessage> msgs = parseNew(isp, xml, {65536});
+
+         //Each bad message is skipped, and parsing picks up at the next
+         REQUIRE( isp.getNumErrors() == 2 );
+         REQUIRE( msgs.size() == 2 );
+         REQUIRE( msgs[0].getProperty()["a"].getValue() == "2" );
+         REQUIRE( msgs[1].getProperty()["a"].getValue() == "4" );
+      }
+   }
+
+   GIVEN("generated traffic")
+   {
+      std::string xml = makeTraffic(100, 1000);
+      std::vector<IndiMessage> msgsOld = parseOld(xml, 65536);
+      REQUIRE( msgsOld.size() == 1100 );
+
+      WHEN("it arrives in reads of random sizes")
+      {
+         std::mt19937 gen(7);
+         std::uniform_int_distribution<size_t> dist(1, 8192);
+
+         std::vector<size_t> chunks;
+         for(int n = 0; n < 1000; ++n) chunks.push_back(dist(gen));
+
+         IndiStreamParser isp;
+         std::vector<IndiMessage> msgs = parseNew(isp, xml, chunks);
+         REQUIRE( countDifferent(msgsOld, msgs) == 0 );
+      }
+   }
+}
+
+SCENARIO( "Benchmarking INDI XML parsing", "[.benchmark][IndiStreamParser]" )
+{
+   GIVEN("traffic of 200 properties and 50000 updates")
+   {
+      std::string xml = makeTraffic(200, 50000);
+
+      WHEN("parsing in 64 kB reads")
+      {
+         auto t0 = std::chrono::steady_clock::now();
+         size_t nOld = 0;
+         {
+            IndiXmlParser ixp;
+            std::string szErrorMsg;
+            for(size_t st = 0; st < xml.size(); st += 65536)
+            {
+               ixp.parseXml(xml.data() + st, std::min<size_t>(65536, xml.size() - st), szErrorMsg);
+               while(ixp.getState() == IndiXmlParser::CompleteState)
+               {
+                  IndiMessage imRecv = ixp.createIndiMessage();
+                  nOld += imRecv.getProperty().getNumElements() > 0;
+                  ixp.parseXml("", szErrorMsg);
+               }
+            }
+         }
+         auto t1 = std::chrono::steady_clock::now();
+         size_t nNew = 0;
+         {
+            IndiStreamParser isp;
+            for(size_t st = 0; st < xml.size(); st += 65536)
+            {
+               unsigned int len = std::min<size_t>(65536, xml.size() - st);
+               unsigned int used = 0;
+               while(used < len)
+               {
+                  used += isp.parse(xml.data() + st + used, len - used);
+                  if(isp.getState() == IndiStreamParser::CompleteState) nNew += isp.getProperty().getNumElements() > 0;
+               }
+            }
+         }
+         auto t2 = std::chrono::steady_clock::now();
+
+         double to = std::chrono::duration<double>(t1-t0).count();
+         double tn = std::chrono::duration<double>(t2-t1).count();
+
+         std::cout << "IndiXmlParser: " << nOld/to << " msgs/sec, IndiStreamParser: " << nNew/tn << " msgs/sec, speedup " << to/tn << "\n";
+
+         REQUIRE( nOld == 50200 );
+         REQUIRE( nNew == nOld );
+      }
+   }
+}
@@ -1,4 +1,3 @@
-import glob
 from purepyindi2 import device, properties, constants, messages
 from purepyindi2.messages import DefNumber, DefSwitch, DefText
 import sys
@@ -63,26 +62,22 @@ RETRY_WAIT_SEC = 2
 CREATE_CONNECTION_TIMEOUT_SEC = 2
 EXIT_TIMEOUT_SEC = 2
 
-def _run_logdump_thread(logger_name, logdump_dir, logdump_args, name, message_queue):
+def _run_logdump_thread(logger_name, logdump_dir, logdump_args, names, message_queue):
+    # One logdump follows all the devices, including those with no files yet, and tags each line with its "app"
     log = logging.getLogger(logger_name)
-    glob_pat = logdump_dir + f'/{name}_*'
-    has_no_logs = len(glob.glob(glob_pat)) == 0
-    if has_no_logs:
-        log.debug(f"No matching files found for {glob_pat}")
     while True:
-        while has_no_logs := len(glob.glob(glob_pat)) == 0:
-            time.sleep(RETRY_WAIT_SEC)
         try:
-            args = logdump_args + ('--dir='+logdump_dir, '-J', '-f', name)
-            log.debug(f"Running logdump command {repr(' '.join(args))} for {name} in follow mode")
+            args = logdump_args + ('--dir='+logdump_dir, '-J', '-f') + tuple(sorted(names))
+            log.debug(f"Running logdump command {repr(' '.join(args))} in follow mode")
             p = subprocess.Popen(args, stdout=subprocess.PIPE, stdin=subprocess.DEVNULL, stderr=subprocess.DEVNULL, text=True)
             for line in p.stdout:
-                message = Telem.from_json(name, line)
+                message = Telem.from_json(None, line)
                 message_queue.put(message)
-            if p.returncode != 0:
-                raise RuntimeError(f"{name} logdump exited with {p.returncode} ({repr(' '.join(args))})")
+            p.wait()
+            raise RuntimeError(f"logdump exited with {p.returncode} ({repr(' '.join(args))})")
         except Exception as e:
-            log.exception(f"Exception in log/telem follower for {name}")
+            log.exception(f"Exception in log/telem follower")
+        time.sleep(RETRY_WAIT_SEC)
 
 @xconf.config
 class dbIngestConfig(BaseDeviceConfig):
@@ -99,12 +94,12 @@ class dbIngest(XDevice):
     startup_ts_sec : float
     records_since_startup : float
 
-    def launch_follower(self, dev):
-        args = self.log.name + '.' + dev, '/opt/MagAOX/telem', (self.config.logdump_exe, '--ext=.bintel'), dev, self.telem_queue
+    def launch_follower(self, devs):
+        args = self.log.name + '.telem', '/opt/MagAOX/telem', (self.config.logdump_exe, '--ext=.bintel'), devs, self.telem_queue
         telem_thread = threading.Thread(target=_run_logdump_thread, args=args, daemon=True)
         telem_thread.start()
-        self.log.debug(f"Watching {dev} for incoming telem")
-        self.telem_threads.append((dev, telem_thread))
+        self.log.debug(f"Watching {len(devs)} devices for incoming telem")
+        self.telem_threads.append(('telem', telem_thread))
 
     def refresh_properties(self):
         self.properties['last_update']['timestamp'] = self.last_update_ts_sec
@@ -163,8 +158,7 @@ class dbIngest(XDevice):
 
         self.telem_queue = queue.Queue()
         self.telem_threads = []
-        for dev in device_names:
-            self.launch_follower(dev)
+        self.launch_follower(device_names)
         
         self.startup_ts_sec = time.time()
         
@@ -94,7 +94,7 @@ protected:
 
     float m_poke_amp {0.0};
 
-    float m_dmSleep {10000}; ///<The time to sleep for the DM command to be applied, in microseconds. Default is 10000.
+    unsigned m_nSettleFrames {1}; ///< The number of WFS frames to skip after each DM command, including the one being taken when it is sent.  Default is 1.
 
     // Pupil fitting:
     int m_pupilPixels {68600}; ///< The number of pixels in the pupil. Default is 68600.
@@ -116,6 +116,8 @@ protected:
     std::mutex m_wfsImageMutex;
 
     milkImage<float> m_rawImage;
+
+    uint64_t m_rawCnt0 {0}; ///< The cnt0 of the WFS frame in m_rawImage
     
     milkImage<float> m_wfsDark;
 
@@ -123,7 +125,7 @@ protected:
 
     milkImage<float> m_pokeImage;
 
-    float (*wfsPixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as float
+    pixKernels<float> wfsPixkern; ///< The kernels to extract the image data as float
 
     float m_wfsFps {-1}; ///< The WFS camera FPS
 
@@ -356,7 +358,7 @@ void dmPokeCenter::setupConfig()
     config.add("pokecen.pokeX", "", "pokecen.pokeX", argType::Required, "pokecen", "pokeX", false, "vector<int>", "The x-coordinates of the actuators to poke. ");
     config.add("pokecen.pokeY", "", "pokecen.pokeY", argType::Required, "pokecen", "pokeY", false, "vector<int>", "The y-coordinates of the actuators to poke. ");
     config.add("pokecen.pokeAmp", "", "pokecen.pokeAmp", argType::Required, "pokecen", "pokeAmp", false, "float", "The poke amplitude, in DM command units. Default is 0.");
-    config.add("pokecen.dmSleep", "", "pokecen.dmSleep", argType::Required, "pokecen", "dmSleep", false, "float", "The time to sleep for the DM command to be applied, in microseconds. Default is 10000.");
+    config.add("pokecen.nSettleFrames", "", "pokecen.nSettleFrames", argType::Required, "pokecen", "nSettleFrames", false, "int", "The number of WFS frames to skip after each DM command, including the one being taken when it is sent. Default is 1.");
     config.add("pokecen.nPokeImages", "", "pokecen.nPokeImages", argType::Required, "pokecen", "nPokeImages", false, "int", "The number of poke images to average.  Default 5.");
     config.add("pokecen.nPupilImages", "", "pokecen.nPupilImages", argType::Required, "pokecen", "nPupilImages", false, "int", "The number of pupil images to average. Default 20.");
     config.add("pokecen.pupilPixels", "", "pokecen.pupilPixels", argType::Required, "pokecen", "pupilPixels", false, "int", "The number of pixels in the pupil. Default is 68600.");
@@ -399,7 +401,7 @@ int dmPokeCenter::loadConfigImpl( mx::app::appConfigurator & _config )
 
     _config(m_poke_amp, "pokecen.pokeAmp");
 
-    _config(m_dmSleep, "pokecen.dmSleep");
+    _config(m_nSettleFrames, "pokecen.nSettleFrames");
 
     _config(m_nPokeImages, "pokecen.nPokeImages");
     _config(m_nPupilImages, "pokecen.nPupilImages");
@@ -592,7 +594,7 @@ int dmPokeCenter::allocate( const wfsShmimT & dummy)
 
     m_pupilImage.create(m_configName + "_pupil", shmimMonitorT::m_width, shmimMonitorT::m_height);
 
-    wfsPixget = getPixPointer<float>(shmimMonitorT::m_dataType);
+    wfsPixkern = getPixKernels<float>(shmimMonitorT::m_dataType);
 
     try
     {
@@ -619,13 +621,14 @@ int dmPokeCenter::processImage( void * curr_src,
 {
     static_cast<void>(dummy); //be unused
 
+    std::unique_lock<std::mutex> lock(m_wfsImageMutex);
+
     float * data = m_rawImage().data();
 
     //Copy the data out as float no matter what type it is
-    for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
-    {
-        data[nn] = wfsPixget(curr_src, nn);
-    }
+    wfsPixkern.convert(data, curr_src, shmimMonitorT::m_width*shmimMonitorT::m_height);
+
+    m_rawCnt0 = shmimMonitorT::lastCnt0();
 
     if(sem_post(&m_imageSemaphore) < 0)
     {
@@ -785,7 +788,9 @@ int dmPokeCenter::runSensor(bool firstRun)
             XWC_SEM_TIMEDWAIT_LOOP( m_imageSemaphore, ts )
 
             //If here we got an image
+            std::unique_lock<std::mutex> lock(m_wfsImageMutex);
             m_wfsDark() += m_rawImage();
+            lock.unlock();
             ++n;
         }
 
@@ -847,7 +852,9 @@ int dmPokeCenter::runSensor(bool firstRun)
         XWC_SEM_TIMEDWAIT_LOOP( m_imageSemaphore, ts )
 
         //If here we got an image.  m_rawImage will have been updated
+        std::unique_lock<std::mutex> lock(m_wfsImageMutex);
         m_pupilImage() += m_rawImage();
+        lock.unlock();
         ++n;            
     }
 
@@ -856,118 +863,65 @@ int dmPokeCenter::runSensor(bool firstRun)
 
     tmpFF.write("/tmp/pupilImage.fits", m_pupilImage());
 
-    m_dmImage.setZero();
-
-    for(size_t nn = 0; nn < m_poke_x.size(); ++nn)
-    {
-        m_dmImage( m_poke_x[nn], m_poke_y[nn]) = m_poke_amp;
-    }
-        
+    //** Now we record the poke images, synchronized to the WFS frames **//
     m_pokeImage.setWrite();
     m_pokeImage().setZero();
-        
-    m_dmStream = m_dmImage;
-
-    mx::sys::microSleep(m_dmSleep);
-
-    //flush semaphore so we take the _next_ good image
-    XWC_SEM_FLUSH(m_imageSemaphore);
-
-    //** And wait one image **//
-    XWC_SEM_WAIT_TS(ts, m_imageSemWait_sec, m_imageSemWait_nsec);
-    ready = false;
-    while(!ready)
-    {
-        XWC_SEM_TIMEDWAIT_LOOP( m_imageSemaphore, ts )
-        else
-        {
-            ready = true;
-        }
-        
-        if(m_stopMeasurement || m_shutdown)
-        {
-            m_dmImage.setZero();
-            m_dmStream = m_dmImage;
-            return 0;
-        }
-    }
-
-    n = 0;
-    while(n < m_nPokeImages && !m_stopMeasurement && !m_shutdown)
-    {    
-        /* POSITIVE POKE */
-
-        //** Now we record the poke image **//
-        XWC_SEM_WAIT_TS(ts, m_imageSemWait_sec, m_imageSemWait_nsec);
-        XWC_SEM_TIMEDWAIT_LOOP( m_imageSemaphore, ts )
 
-        //If here, we got an image.  m_rawImage will have been updated
-        m_pokeImage() += m_rawImage();
+    dev::dmPokeSequencer pokeSeq;
+    pokeSeq.setup(1, m_nSettleFrames, m_nPokeImages, 1);
 
-        ++n;
-    }
-        
-    if(m_stopMeasurement || m_shutdown) 
-    {
-        m_dmImage.setZero();
-        m_dmStream = m_dmImage;
-        return 0;
-    }
+    std::unique_lock<std::mutex> lock(m_wfsImageMutex);
+    pokeSeq.start(m_rawCnt0);
+    lock.unlock();
 
     m_dmImage.setZero();
 
     for(size_t nn = 0; nn < m_poke_x.size(); ++nn)
     {
-        m_dmImage( m_poke_x[nn], m_poke_y[nn]) = -m_poke_amp;
+        m_dmImage( m_poke_x[nn], m_poke_y[nn]) = m_poke_amp;
     }
-       
-    m_dmStream = m_dmImage;
 
-    mx::sys::microSleep(m_dmSleep);
-
-    //flush semaphore so we take the _next_ good image
-    XWC_SEM_FLUSH(m_imageSemaphore);
+    m_dmStream = m_dmImage;
 
-    //** And wait one image **//
-    XWC_SEM_WAIT_TS(ts, m_imageSemWait_sec, m_imageSemWait_nsec);
-    ready = false;
-    while(!ready)
+    while(!pokeSeq.done() && !m_stopMeasurement && !m_shutdown)
     {
+        XWC_SEM_WAIT_TS(ts, m_imageSemWait_sec, m_imageSemWait_nsec);
         XWC_SEM_TIMEDWAIT_LOOP( m_imageSemaphore, ts )
-        else
+
+        //If here, we got an image.  m_rawImage will have been updated, and the lock keeps it with its cnt0
+        lock.lock();
+        if(pokeSeq.frame(m_rawCnt0))
         {
-            ready = true;
+            m_pokeImage() += static_cast<float>(pokeSeq.sign())*m_rawImage();
         }
+        lock.unlock();
 
-        if(m_stopMeasurement || m_shutdown)
+        //The positive poke is done, so go straight to the negative poke
+        if(pokeSeq.next())
         {
-            m_dmImage.setZero();
+            for(size_t nn = 0; nn < m_poke_x.size(); ++nn)
+            {
+                m_dmImage( m_poke_x[nn], m_poke_y[nn]) = pokeSeq.sign()*m_poke_amp;
+            }
+
             m_dmStream = m_dmImage;
-            return 0;
         }
     }
 
-    n = 0;
-    while(n < m_nPokeImages && !m_stopMeasurement && !m_shutdown)
-    {    
-        /* NEGATIVE POKE */
-
-        //** Now we record the poke image **//
-        XWC_SEM_WAIT_TS(ts, m_imageSemWait_sec, m_imageSemWait_nsec);
-        XWC_SEM_TIMEDWAIT_LOOP( m_imageSemaphore, ts )
-
-        //If here, we got an image.  m_rawImage will have been updated
-        m_pokeImage() -= m_rawImage();
+    if(m_stopMeasurement || m_shutdown)
+    {
+        m_dmImage.setZero();
+        m_dmStream = m_dmImage;
 
-        ++n;
+        return 0;
     }
 
-    if(m_stopMeasurement || m_shutdown)
+    if(!pokeSeq.done())
     {
         m_dmImage.setZero();
         m_dmStream = m_dmImage;
 
-        return 0;
+        return log<software_error,-1>({__FILE__, __LINE__, "error waiting for WFS frame"});
     }
 
     m_pokeImage() = m_pokeImage()/(2);
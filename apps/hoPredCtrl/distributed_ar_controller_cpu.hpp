@@ -0,0 +1,334 @@
+#ifndef PCDDSC_CPU_HPP
+#define PCDDSC_CPU_HPP
+
+#include <iostream>
+
+#include "../../libMagAOX/utils/workerPool.hpp"
+
+#include "recursive_least_squares_cpu.hpp"
+#include "new_matrix_cpu.hpp"
+
+namespace DDSPC
+{
+namespace cpu
+{
+
+/*
+	The CPU version of the DistributedAutoRegressiveController.
+
+	The buffers are nmodes x (buffer_size+1), one column per frame, so copying a frame into the feature
+	vectors is a column copy.  Each step is split across the modes by the workerPool, and each part also
+	has a block version so the PredictiveController can do it in the same job as its own work on those modes.
+*/
+class DistributedAutoRegressiveController{
+
+	public:
+		RecursiveLeastSquares rls;
+
+		Eigen::MatrixXf measurement_buffer;
+		Eigen::MatrixXf command_buffer;
+		Matrix phi;
+		Matrix xf;
+
+		Eigen::VectorXf command;
+		Matrix delta_command;
+		Matrix controller;
+		Matrix condition_matrix;
+		Matrix wp;
+
+		MagAOX::utils::workerPool* pool;
+
+		int nhistory, nfuture, nmodes, nfeatures;
+		unsigned long long int buffer_size;
+		unsigned long long int buffer_index;
+
+		Matrix lambda;
+		float gamma;
+
+		bool use_predictor;
+		float int_gain;
+		float int_leakage;
+
+		DistributedAutoRegressiveController(MagAOX::utils::workerPool* new_pool, int num_history, int num_future, int num_modes, float new_gamma, float* new_lambda, float P0);
+
+		void set_new_regularization(float* new_lambda);
+		inline void set_new_gamma(float new_gamma){
+			gamma = new_gamma;
+		};
+
+		inline void set_integrator(bool new_use_predictor, float new_int_gain, float new_int_leakage){
+				use_predictor = new_use_predictor;
+				int_gain = new_int_gain;
+				int_leakage = new_int_leakage;
+		};
+
+		void reset_data_buffer();
+		void reset_controller();
+
+		void add_measurement(const Eigen::VectorXf & new_measurement);
+		void update_predictor();
+		void update_controller();
+
+		inline Eigen::VectorXf & get_command(){
+			return command;
+		};
+
+		Eigen::VectorXf & get_new_control_command(float clip_val, const Eigen::VectorXf & exploration_signal);
+
+		// The steps for the modes [m0, m0+nm)
+		void add_measurement(const Eigen::VectorXf & new_measurement, int m0, int nm);
+		void get_new_control_command(float clip_val, const Eigen::VectorXf & exploration_signal, int m0, int nm);
+
+		// The step for the modes [m0, m0+nm)
+		void update_controller(int m0, int nm);
+
+	protected:
+		// Working space for update_controller
+		Matrix H11, H12, invH11col;
+};
+
+inline DistributedAutoRegressiveController::DistributedAutoRegressiveController(MagAOX::utils::workerPool* new_pool, int num_history, int num_future, int num_modes, float new_gamma, float* new_lambda, float P0)
+	: rls(num_future - 1 + 2 * num_history, num_future, num_modes, new_gamma, P0),
+	  phi(0.0, num_future - 1 + 2 * num_history, 1, num_modes),
+	  xf(0.0, num_future, 1, num_modes),
+	  delta_command(0.0, 1, 1, num_modes),
+	  controller(0.0, 1, 2 * num_history - 1, num_modes),
+	  condition_matrix(0.0, num_future, num_future, num_modes),
+	  wp(0.0, 2 * num_history - 1, 1, num_modes),
+	  lambda(0.0, 1, 1, num_modes),
+	  H11(0.0, num_future, num_future, num_modes),
+	  H12(0.0, num_future, 2 * num_history - 1, num_modes),
+	  invH11col(0.0, num_future, 1, num_modes)
+{
+	pool = new_pool;
+
+	nhistory = num_history;
+	nfuture = num_future;
+	nmodes = num_modes;
+
+	// Use all future DM commands except the most recent because that one will only have an effect in later measurements
+	nfeatures = nfuture - 1 + 2 * nhistory;
+
+	gamma = new_gamma;
+
+	// The buffer size is a power of two, minus one so it is also the mask to cycle through the buffer
+	int num_bits = 0;
+	for(int n = nhistory + nfuture + 2; n > 0; n >>= 1){
+		++num_bits;
+	}
+	buffer_size = (1ULL << num_bits) - 1;
+
+	measurement_buffer.setZero(nmodes, buffer_size + 1);
+	command_buffer.setZero(nmodes, buffer_size + 1);
+	command.setZero(nmodes);
+
+	// The condition matrix starts at zero, as in the CUDA version, until set_new_regularization
+	for(int k=0; k < nmodes; ++k){
+		lambda.data(k, 0) = new_lambda[k];
+	}
+
+	// Initialize controller with an integrator
+	controller.data.col(nhistory-1).setConstant(-0.15);
+
+	buffer_index = 0;
+
+	use_predictor = false;
+	int_gain = 0.2;
+	int_leakage = 0.95;
+}
+
+inline void DistributedAutoRegressiveController::reset_data_buffer(){
+	buffer_index = 0;
+
+	measurement_buffer.setZero();
+	command_buffer.setZero();
+	command.setZero();
+	delta_command.set_to_zero();
+	phi.set_to_zero();
+	xf.set_to_zero();
+	wp.set_to_zero();
+}
+
+inline void DistributedAutoRegressiveController::reset_controller(){
+	controller.set_to_zero();
+	rls.reset();
+}
+
+inline void DistributedAutoRegressiveController::add_measurement(const Eigen::VectorXf & new_measurement){
+	pool->run([this, &new_measurement](size_t part){
+		int m0, nm;
+		batch_range(part, pool->nParts(), nmodes, m0, nm);
+		add_measurement(new_measurement, m0, nm);
+	});
+}
+
+inline void DistributedAutoRegressiveController::add_measurement(const Eigen::VectorXf & new_measurement, int m0, int nm){
+	if(nm <= 0) return;
+
+	// Copy the new measurement into our data buffer
+	measurement_buffer.col(buffer_index & buffer_size).segment(m0, nm) = new_measurement.segment(m0, nm);
+
+	// The future and past commands
+	for(int i=0; i < (nfuture - 1 + nhistory); i++){
+		lanesT(phi.lanes(i, 0, m0), nm) = command_buffer.col((buffer_index-1-i) & buffer_size).segment(m0, nm).array();
+	}
+
+	// The past measurements
+	int phi_offset = nfuture-1 + nhistory;
+	int data_offset = nfuture;
+	for(int i=0; i < nhistory; i++){
+		lanesT(phi.lanes(i + phi_offset, 0, m0), nm) = measurement_buffer.col((buffer_index-data_offset-i) & buffer_size).segment(m0, nm).array();
+	}
+
+	// The future measurements
+	for(int i=0; i < nfuture; i++){
+		lanesT(xf.lanes(i, 0, m0), nm) = measurement_buffer.col((buffer_index-i) & buffer_size).segment(m0, nm).array();
+	}
+
+	// The past vector for the control command, the N-1 past commands and the N past measurements
+	for(int i=0; i < nhistory-1; i++){
+		lanesT(wp.lanes(i, 0, m0), nm) = command_buffer.col((buffer_index-1-i) & buffer_size).segment(m0, nm).array();
+	}
+
+	int offset = nhistory-1;
+	for(int i=0; i < nhistory; i++){
+		lanesT(wp.lanes(i + offset, 0, m0), nm) = measurement_buffer.col((buffer_index-i) & buffer_size).segment(m0, nm).array();
+	}
+}
+
+inline void DistributedAutoRegressiveController::update_predictor(){
+	pool->run([this](size_t part){
+		int m0, nm;
+		batch_range(part, pool->nParts(), nmodes, m0, nm);
+		rls.update(phi, xf, m0, nm);
+	});
+}
+
+inline void DistributedAutoRegressiveController::update_controller(){
+	pool->run([this](size_t part){
+		int m0, nm;
+		batch_range(part, pool->nParts(), nmodes, m0, nm);
+		update_controller(m0, nm);
+	});
+}
+
+inline void DistributedAutoRegressiveController::update_controller(int m0, int nm){
+	if(nm <= 0) return;
+
+	const int nw = nfeatures - nfuture;
+	Matrix & A = rls.A;
+
+	// A consists of two submatrices, Bs and As.
+	// Bs does the system dynamics, columns 0 to nfuture-1, and As the prediction, columns nfuture to the end.
+
+	// H12 = B.T.dot( As )
+	for(int i=0; i < nfuture; ++i){
+		for(int c=0; c < nw; ++c){
+			lanesT h(H12.lanes(i, c, m0), nm);
+			h = const_lanesT(A.lanes(0, i, m0), nm) * const_lanesT(A.lanes(0, nfuture + c, m0), nm);
+			for(int p=1; p < nfuture; ++p){
+				h += const_lanesT(A.lanes(p, i, m0), nm) * const_lanesT(A.lanes(p, nfuture + c, m0), nm);
+			}
+		}
+	}
+
+	// H11 = B.T.dot( B ) plus the regularization
+	for(int i=0; i < nfuture; ++i){
+		for(int j=0; j < nfuture; ++j){
+			lanesT h(H11.lanes(i, j, m0), nm);
+			h = const_lanesT(condition_matrix.lanes(i, j, m0), nm);
+			for(int p=0; p < nfuture; ++p){
+				h += const_lanesT(A.lanes(p, i, m0), nm) * const_lanesT(A.lanes(p, j, m0), nm);
+			}
+		}
+	}
+
+	// Only the last row of the inverse of H11 is needed.  H11 is symmetric, so this is the last column,
+	// the solution of H11 z = e.  H11 is also positive definite with regularization, so Gaussian elimination
+	// needs no pivoting, which keeps every mode in step.
+	lanesT(invH11col.lanes(nfuture-1, 0, m0), nm) = 1.0;
+	for(int i=0; i < nfuture-1; ++i){
+		lanesT(invH11col.lanes(i, 0, m0), nm) = 0.0;
+	}
+
+	for(int j=0; j < nfuture; ++j){
+		const_lanesT pivot(H11.lanes(j, j, m0), nm);
+		for(int i=j+1; i < nfuture; ++i){
+			// The factor is kept in the lower triangle, which is not needed again
+			lanesT f(H11.lanes(i, j, m0), nm);
+			f /= pivot;
+			for(int c=j+1; c < nfuture; ++c){
+				lanesT(H11.lanes(i, c, m0), nm) -= f * const_lanesT(H11.lanes(j, c, m0), nm);
+			}
+			lanesT(invH11col.lanes(i, 0, m0), nm) -= f * const_lanesT(invH11col.lanes(j, 0, m0), nm);
+		}
+	}
+
+	for(int i=nfuture-1; i >= 0; --i){
+		lanesT z(invH11col.lanes(i, 0, m0), nm);
+		for(int c=i+1; c < nfuture; ++c){
+			z -= const_lanesT(H11.lanes(i, c, m0), nm) * const_lanesT(invH11col.lanes(c, 0, m0), nm);
+		}
+		z /= const_lanesT(H11.lanes(i, i, m0), nm);
+	}
+
+	// The controller is minus the last row of the inverse times H12
+	for(int c=0; c < nw; ++c){
+		lanesT ctrl(controller.lanes(0, c, m0), nm);
+		ctrl = -const_lanesT(invH11col.lanes(0, 0, m0), nm) * const_lanesT(H12.lanes(0, c, m0), nm);
+		for(int i=1; i < nfuture; ++i){
+			ctrl -= const_lanesT(invH11col.lanes(i, 0, m0), nm) * const_lanesT(H12.lanes(i, c, m0), nm);
+		}
+	}
+}
+
+inline void DistributedAutoRegressiveController::set_new_regularization(float* new_lambda){
+	// Setup the condition matrix
+	for(int k=0; k < nmodes; ++k){
+		lambda.data(k, 0) = new_lambda[k];
+	}
+	condition_matrix.set_identity(lambda.data.data());
+
+	// We used a new regularization parameter, so update the controller!
+	// This can then be used to adapt to noisy measurements.
+	update_controller();
+}
+
+inline Eigen::VectorXf & DistributedAutoRegressiveController::get_new_control_command(float clip_val, const Eigen::VectorXf & exploration_signal){
+	pool->run([this, clip_val, &exploration_signal](size_t part){
+		int m0, nm;
+		batch_range(part, pool->nParts(), nmodes, m0, nm);
+		get_new_control_command(clip_val, exploration_signal, m0, nm);
+	});
+
+	buffer_index++;
+	return command;
+}
+
+inline void DistributedAutoRegressiveController::get_new_control_command(float clip_val, const Eigen::VectorXf & exploration_signal, int m0, int nm){
+	if(nm <= 0) return;
+
+	// Switch between the predictor and integrator
+	if(use_predictor){
+		lanesT delta(delta_command.lanes(0, 0, m0), nm);
+
+		delta = const_lanesT(controller.lanes(0, 0, m0), nm) * const_lanesT(wp.lanes(0, 0, m0), nm);
+		for(int i=1; i < nfeatures - nfuture; ++i){
+			delta += const_lanesT(controller.lanes(0, i, m0), nm) * const_lanesT(wp.lanes(i, 0, m0), nm);
+		}
+
+		delta += exploration_signal.segment(m0, nm).array();
+		delta = delta.max(-clip_val).min(clip_val);
+
+		// Copy the new command into our data buffer
+		command_buffer.col(buffer_index & buffer_size).segment(m0, nm) = delta.matrix();
+		command.segment(m0, nm) += delta.matrix();
+	}else{
+		command.segment(m0, nm) = int_leakage * command.segment(m0, nm) - int_gain * measurement_buffer.col(buffer_index & buffer_size).segment(m0, nm);
+	}
+}
+
+}
+}
+
+#endif
@@ -20,7 +20,13 @@ using namespace mx::improc;
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#ifdef HOPREDCTRL_CPU
+#include "predictive_controller_cpu.hpp"
+typedef DDSPC::cpu::PredictiveController predictiveControllerT;
+#else
 #include "predictive_controller.cuh"
+typedef DDSPC::PredictiveController predictiveControllerT;
+#endif
 
 using namespace DDSPC;
 
@@ -132,7 +138,7 @@ protected:
 
 	// The dark image parameters
 	eigenImage<realT> m_darkImage;
-	realT (*dark_pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+	pixKernels<realT> dark_pixkern; ///< The kernels to extract the dark data as our desired type realT.
 	bool m_darkSet {false};
 
 	// Predictive control parameters
@@ -151,7 +157,12 @@ protected:
 	realT m_intgain;
 	realT m_intleak;
 
-	DDSPC::PredictiveController* controller;
+	predictiveControllerT* controller;
+
+#ifdef HOPREDCTRL_CPU
+	int m_cpuThreads {1};				///< The number of threads for the CPU controller, including the frame thread
+	std::vector<int> m_cpuThreadCpus;	///< The CPUs to pin the other controller threads to
+#endif
 
 	// Learning time
 	int m_exploration_steps;
@@ -345,6 +356,11 @@ void hoPredCtrl::setupConfig()
 	config.add("parameters.exploration_steps", "", "parameters.exploration_steps", argType::Required, "parameters", "exploration_steps", false, "int", "The update clip value.");
 	config.add("parameters.exploration_rms", "", "parameters.exploration_rms", argType::Required, "parameters", "exploration_rms", false, "float", "The update clip value.");
 
+#ifdef HOPREDCTRL_CPU
+	config.add("parameters.cpu_threads", "", "parameters.cpu_threads", argType::Required, "parameters", "cpu_threads", false, "int", "The number of threads for the CPU controller, including the frame thread.  Default 1.");
+	config.add("parameters.cpu_thread_cpus", "", "parameters.cpu_thread_cpus", argType::Required, "parameters", "cpu_thread_cpus", false, "vector<int>", "The CPUs to pin the other controller threads to.  Default is not pinned.");
+#endif
+
 	// Read in the learning parameters as a vector.
 	// config.add("parameters.exploration_steps", "", "parameters.exploration_steps",  argType::Required, "parameters", "exploration_steps", false, "vector<int>", "The number of steps for each training iteration.");
 	// config.add("parameters.exploration_rms", "", "parameters.exploration_rms",  argType::Required, "parameters", "exploration_rms", false, "vector<double>", "The rms for each training iteration.");
@@ -413,6 +429,12 @@ int hoPredCtrl::loadConfigImpl( mx::app::appConfigurator & _config )
 	_config(m_exploration_rms, "parameters.exploration_rms");
 	std::cout << "Nexplore:: "<< m_exploration_steps << " with " << m_exploration_rms << " rms." << std::endl;
 
+#ifdef HOPREDCTRL_CPU
+	_config(m_cpuThreads, "parameters.cpu_threads");
+	_config(m_cpuThreadCpus, "parameters.cpu_thread_cpus");
+	std::cout << "cpu_threads=" << m_cpuThreads << std::endl;
+#endif
+
 	_config(m_dmChannel, "parameters.channel");
 	std::cout << "Open DM tweeter channel at " << m_dmChannel << std::endl;
 	std::cout << "Done reading config Impl." << std::endl;
@@ -707,7 +729,10 @@ int hoPredCtrl::allocate(const dev::shmimT & dummy)
 	}
 
 	// Controller setup
-	controller = new DDSPC::PredictiveController(m_numHist, m_numFut, m_numModes, m_measurement_size, m_gamma, m_lambda, m_inv_covariance, m_dmWidth * m_dmHeight);
+	controller = new predictiveControllerT(m_numHist, m_numFut, m_numModes, m_measurement_size, m_gamma, m_lambda, m_inv_covariance, m_dmWidth * m_dmHeight);
+#ifdef HOPREDCTRL_CPU
+	controller->set_threads(m_cpuThreads, m_cpuThreadCpus);
+#endif
 	controller->set_interaction_matrix(m_interaction_matrix.data());
 	controller->set_mapping_matrix(m_mapping_matrix.data());
 	std::cerr << "Finished intializing the controller.\n";
@@ -918,9 +943,9 @@ int hoPredCtrl::allocate(const darkShmimT & dummy)
    
    m_darkImage.resize(darkMonitorT::m_width, darkMonitorT::m_height);
    
-   dark_pixget = getPixPointer<realT>(darkMonitorT::m_dataType);
+   dark_pixkern = getPixKernels<realT>(darkMonitorT::m_dataType);
    
-   if(dark_pixget == nullptr)
+   if(dark_pixkern.convert == nullptr)
    {
       log<software_error>({__FILE__, __LINE__, "bad data type"});
       return -1;
@@ -941,11 +966,7 @@ int hoPredCtrl::processImage( void * curr_src,
    
    realT * data = m_darkImage.data();
    
-   for(unsigned nn=0; nn < darkMonitorT::m_width*darkMonitorT::m_height; ++nn)
-   {
-      //data[nn] = *( (int16_t * ) (curr_src + nn*shmimMonitorT::m_dmDataType));
-      data[nn] = dark_pixget(curr_src, nn);
-   }
+   dark_pixkern.convert(data, curr_src, darkMonitorT::m_width*darkMonitorT::m_height);
    
    m_darkSet = true;
 	
@@ -0,0 +1,148 @@
+#ifndef PCMATRIX_CPU_HPP
+#define PCMATRIX_CPU_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+namespace DDSPC
+{
+namespace cpu
+{
+
+/*
+	A batch of small matrices, one per mode, for the CPU backend.
+
+	Unlike the CUDA Matrix the batch index is stored fastest: element (i,j) of every matrix in the batch
+	is one contiguous column of data.  The same operation on a range of the batch is then a single vector
+	operation, which is how the per-mode matrices are vectorized across modes.
+
+	Files are written and read in the format of the CUDA Matrix, with the batch index slowest, so saved
+	states can be loaded by either backend.
+*/
+class Matrix{
+	public:
+		int nrows_;
+		int ncols_;
+		int batch_size_;
+		int size_; // The number of elements in each matrix
+		int total_size_;
+
+		// batch_size_ x size_, column-major. Column (i + j*nrows_) holds element (i,j) of each matrix.
+		Eigen::MatrixXf data;
+
+		Matrix(float initialization_value, int num_rows, int num_columns, int num_batches=1){
+			nrows_ = num_rows;
+			ncols_ = num_columns;
+			batch_size_ = num_batches;
+			size_ = nrows_ * ncols_;
+			total_size_ = size_ * batch_size_;
+
+			data.resize(batch_size_, size_);
+			data.setConstant(initialization_value);
+		};
+
+		// Pointer to element (i,j) of matrix b, followed by the same element of matrices b+1, b+2, ...
+		inline float* lanes(int i, int j, int b){
+			return data.data() + (i + j * nrows_) * batch_size_ + b;
+		};
+
+		inline const float* lanes(int i, int j, int b) const{
+			return data.data() + (i + j * nrows_) * batch_size_ + b;
+		};
+
+		// The matrix of a batch of one
+		inline Eigen::Map<Eigen::MatrixXf> mat(){
+			return Eigen::Map<Eigen::MatrixXf>(data.data(), nrows_, ncols_);
+		};
+
+		void set_to_zero(){
+			data.setZero();
+		};
+
+		// Set the diagonal of each matrix to value[b], and the rest to zero
+		void set_identity(const float* value){
+			data.setZero();
+			for(int i=0; i < std::min(nrows_, ncols_); ++i){
+				data.col(i + i * nrows_) = Eigen::Map<const Eigen::VectorXf>(value, batch_size_);
+			}
+		};
+
+		void to_file(std::string filename) const;
+		void from_file(std::string filename);
+};
+
+// The lanes of an element for a range of the batch
+typedef Eigen::Map<Eigen::ArrayXf> lanesT;
+typedef Eigen::Map<const Eigen::ArrayXf> const_lanesT;
+
+/*
+	The range of the batch done by one part of a job split across a workerPool.
+	Ranges start on multiples of 16 so that parts do not write to the same cache line.
+*/
+inline void batch_range(size_t part, size_t num_parts, int batch_size, int & b0, int & nb){
+	int start = ((part * batch_size / num_parts) / 16) * 16;
+	int end = (((part + 1) * batch_size / num_parts) / 16) * 16;
+
+	if(part + 1 == num_parts){
+		end = batch_size;
+	}
+
+	b0 = start;
+	nb = end - start;
+}
+
+inline void Matrix::to_file(std::string filename) const{
+	std::fstream f;
+	f.open(filename, std::ios::out);
+
+	if(!f.is_open()){
+		std::cerr << __FILE__ << " " << __LINE__ << " could not open " << filename << "\n";
+		return;
+	}
+
+	f << "Shape: (" << nrows_ << " , " << ncols_  << " , " << batch_size_ << ")\n";
+	for(int k=0; k < batch_size_; ++k){
+		for(int e=0; e < size_; ++e){
+			f << data(k, e);
+			if(k < batch_size_ - 1 || e < size_ - 1){
+				f << ",";
+			}
+		}
+	}
+
+	f.close();
+}
+
+inline void Matrix::from_file(std::string filename){
+	std::ifstream myfile(filename);
+
+	if(!myfile.is_open()){
+		std::cerr << __FILE__ << " " << __LINE__ << " could not open " << filename << "\n";
+		return;
+	}
+
+	std::string shape;
+	std::getline(myfile, shape); // The line with the shape
+
+	std::string item;
+	int n = 0;
+	while(std::getline(myfile, item, ',') && n < total_size_){
+		data(n / size_, n % size_) = std::stof(item);
+		++n;
+	}
+
+	if(n != total_size_){
+		std::cerr << __FILE__ << " " << __LINE__ << " read " << n << " of " << total_size_ << " elements from " << filename << "\n";
+	}
+}
+
+}
+}
+
+#endif
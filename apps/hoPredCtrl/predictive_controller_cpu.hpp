@@ -0,0 +1,250 @@
+#ifndef RDDSC_CPU_HPP
+#define RDDSC_CPU_HPP
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "../../libMagAOX/utils/workerPool.hpp"
+
+#include "new_matrix_cpu.hpp"
+#include "distributed_ar_controller_cpu.hpp"
+
+namespace DDSPC
+{
+namespace cpu
+{
+
+/*
+	The CPU version of the PredictiveController, with the same interface as the CUDA version.
+
+	The work of each call is split across the modes, and the actuators for the final mapping, by a
+	pool of threads which can be pinned to CPUs with set_threads.  By default the caller does all the work.
+*/
+class PredictiveController{
+	private:
+		int m_num_history;
+		int m_num_future;
+		int m_num_modes;
+		int m_num_measurements;
+		int m_num_actuators;
+
+		float m_gamma;
+		std::vector<float> m_lambda;
+		float m_P0;
+
+		unsigned long long int m_exploration_buffer_size;
+		unsigned long long int m_exploration_index;
+
+		Eigen::VectorXf m_exploration_signal;
+		Eigen::VectorXf m_voltages;
+		Matrix m_interaction_matrix;
+		Matrix m_mode_mapping_matrix;
+
+		Eigen::MatrixXf m_exploration_buffer;
+
+		MagAOX::utils::workerPool m_pool;
+
+	public:
+
+		std::unique_ptr<DistributedAutoRegressiveController> controller;
+
+		Eigen::VectorXf m_measurement;
+
+		PredictiveController(int num_history, int num_future, int num_modes, int num_measurements, float gamma, float lambda, float P0, int num_actuators);
+
+		// Split the work across threads, including the caller's, optionally pinning the others to cpus
+		void set_threads(int num_threads, const std::vector<int> & cpus = {}){
+			m_pool.start(num_threads, cpus);
+		};
+
+		int get_threads(){
+			return m_pool.nParts();
+		};
+
+		// Just direct function wrappers
+		void reset_data_buffer(){controller->reset_data_buffer();};
+		void reset_controller(){controller->reset_controller();};
+		void update_predictor(){controller->update_predictor();};
+		void update_controller(){controller->update_controller();};
+
+		// This function should reset the buffers and set the current control command to zero.
+		void set_zero();
+
+		// Training signal
+		void get_next_exploration_signal();
+		void create_exploration_buffer(float rms, int exploration_buffer_size);
+
+		// New wrapper functions
+		void set_new_regularization(float new_lambda);
+		void set_new_gamma(float new_gamma);
+
+		void set_interaction_matrix(float* interaction_matrix);
+		void set_mapping_matrix(float* mapping_matrix);
+		void add_measurement(float* new_wfs_measurement);
+		float* get_command(float clip_val);
+
+		void save_state(std::string path);
+		void load_state(std::string path, std::string timestamp);
+};
+
+inline PredictiveController::PredictiveController(int num_history, int num_future, int num_modes, int num_measurements, float gamma, float lambda, float P0, int num_actuators)
+	: m_interaction_matrix(1.0, num_modes, num_measurements, 1),
+	  m_mode_mapping_matrix(1.0, num_actuators, num_modes, 1)
+{
+	m_num_history = num_history;
+	m_num_future = num_future;
+	m_num_modes = num_modes;
+	m_num_measurements = num_measurements;
+	m_num_actuators = num_actuators;
+
+	m_exploration_buffer_size = 0;
+	m_exploration_index = 0;
+
+	m_gamma = gamma;
+	m_P0 = P0;
+
+	m_lambda.assign(num_modes, lambda);
+
+	m_measurement.setZero(num_modes);
+	m_exploration_signal.setZero(num_modes);
+	m_voltages.setZero(num_actuators);
+
+	controller.reset(new DistributedAutoRegressiveController(&m_pool, m_num_history, m_num_future, m_num_modes, m_gamma, m_lambda.data(), m_P0));
+}
+
+inline void PredictiveController::create_exploration_buffer(float rms, int exploration_buffer_size){
+	std::cout << " Create buffer with size: " << exploration_buffer_size << std::endl;
+	m_exploration_index = 0;
+	m_exploration_buffer_size = exploration_buffer_size;
+
+	std::random_device rd;
+	std::default_random_engine generator{rd()};
+	std::normal_distribution<float> distribution(0.0, rms);
+
+	// A random binary signal, +/- rms
+	m_exploration_buffer.resize(m_num_modes, m_exploration_buffer_size + 1);
+	for(unsigned long long int k=0; k < m_exploration_buffer_size + 1; ++k){
+		for(int i=0; i < m_num_modes; ++i){
+			m_exploration_buffer(i, k) = (distribution(generator) > 0) ? rms : -rms;
+		}
+	}
+}
+
+inline void PredictiveController::get_next_exploration_signal(){
+	if(m_exploration_index < m_exploration_buffer_size){
+		m_exploration_signal = m_exploration_buffer.col(m_exploration_index);
+		m_exploration_index += 1;
+	}else{
+		m_exploration_signal.setZero();
+	}
+}
+
+inline void PredictiveController::set_new_regularization(float lambda){
+	for(int i=0; i < m_num_modes; ++i){
+		m_lambda[i] = lambda;
+	}
+	controller->set_new_regularization(m_lambda.data());
+}
+
+inline void PredictiveController::set_new_gamma(float new_gamma){
+	// As in the CUDA version this only refreshes the controller, the forgetting factor is set at construction.
+	static_cast<void>(new_gamma);
+	controller->set_new_regularization(m_lambda.data());
+}
+
+inline void PredictiveController::set_interaction_matrix(float* interaction_matrix){
+	m_interaction_matrix.mat() = Eigen::Map<Eigen::MatrixXf>(interaction_matrix, m_num_modes, m_num_measurements);
+}
+
+inline void PredictiveController::set_mapping_matrix(float* mapping_matrix){
+	m_mode_mapping_matrix.mat() = Eigen::Map<Eigen::MatrixXf>(mapping_matrix, m_num_actuators, m_num_modes);
+}
+
+inline void PredictiveController::add_measurement(float* new_wfs_measurement){
+	Eigen::Map<const Eigen::VectorXf> wfs(new_wfs_measurement, m_num_measurements);
+	Eigen::Map<Eigen::MatrixXf> im = m_interaction_matrix.mat();
+
+	// Each part reconstructs its modes and adds them to the controller
+	m_pool.run([this, &wfs, &im](size_t part){
+		int m0, nm;
+		batch_range(part, m_pool.nParts(), m_num_modes, m0, nm);
+		if(nm <= 0) return;
+
+		m_measurement.segment(m0, nm).noalias() = im.middleRows(m0, nm) * wfs;
+		controller->add_measurement(m_measurement, m0, nm);
+	});
+}
+
+inline void PredictiveController::set_zero(){
+	controller->command.setZero();
+}
+
+inline float* PredictiveController::get_command(float clip_val){
+	get_next_exploration_signal();
+
+	// Determine the command vector
+	Eigen::VectorXf & command = controller->get_new_control_command(clip_val, m_exploration_signal);
+
+	// Map to the actuators, each part doing a range of actuators
+	Eigen::Map<Eigen::MatrixXf> mapping = m_mode_mapping_matrix.mat();
+	m_pool.run([this, &command, &mapping](size_t part){
+		int a0, na;
+		batch_range(part, m_pool.nParts(), m_num_actuators, a0, na);
+		if(na <= 0) return;
+
+		m_voltages.segment(a0, na).noalias() = mapping.middleRows(a0, na) * command;
+	});
+
+	return m_voltages.data();
+}
+
+inline void PredictiveController::save_state(std::string path){
+	using namespace std::chrono;
+	uint64_t elapsed_time = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+
+	std::ostringstream oss;
+	oss << elapsed_time;
+	std::string timestamp(oss.str());
+	std::cout << timestamp << std::endl;
+
+	// Make the header file with all the parameters
+	std::fstream f;
+	f.open(path + "header_" + timestamp + ".txt", std::ios::out);
+	f << "Header file for the Predictive controller. \n\r";
+
+	f << "Time: " << timestamp << "\n\r";
+	f << "History: " << m_num_history << "\n\r";
+	f << "Future: " << m_num_future << "\n\r";
+	f << "Gamma: " << m_gamma << "\n\r";
+	f << "Num modes: " << m_num_modes << "\n\r";
+	f << "Num measurements: " << m_num_measurements << "\n\r";
+	f.close();
+
+	// Save the current controller
+	controller->controller.to_file(path + "controller_" + timestamp + ".csv");
+	controller->condition_matrix.to_file(path + "condition_matrix_" + timestamp + ".csv");
+	controller->rls.A.to_file(path + "prediction_matrix_" + timestamp + ".csv");
+	controller->rls.P.to_file(path + "covariance_matrix_" + timestamp + ".csv");
+
+	// The modal reconstructor
+	m_mode_mapping_matrix.to_file(path + "mode_mapping_matrix_" + timestamp + ".csv");
+	m_interaction_matrix.to_file(path + "interaction_matrix_" + timestamp + ".csv");
+}
+
+inline void PredictiveController::load_state(std::string path, std::string timestamp){
+	controller->rls.A.from_file(path + "prediction_matrix_" + timestamp + ".csv"); // These are learned
+	controller->rls.P.from_file(path + "covariance_matrix_" + timestamp + ".csv"); // These are learned
+
+	// Create the controller
+	update_controller();
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef PCRLS_CPU_HPP
+#define PCRLS_CPU_HPP
+
+#include "new_matrix_cpu.hpp"
+
+namespace DDSPC
+{
+namespace cpu
+{
+
+/*
+	The CPU version of the batched Recursive Least Squares.
+
+	Each update is done for a range of the batch, with every step a vector operation across the range,
+	so that a workerPool can split the modes between threads.  The equations are those of the CUDA version.
+*/
+class RecursiveLeastSquares{
+
+	public:
+		Matrix K; // Gain matrix
+		float gamma; // The forgetting factor
+		float _initial_covariance;
+		int _num_features;
+		int _num_predictors;
+		int _batch_size;
+
+		Matrix err; // The a-priori prediction error
+		Matrix xtP;
+		Matrix cn;
+
+		Matrix A; // Prediction matrix
+		Matrix P; // Inverse covariance
+
+		RecursiveLeastSquares(int num_features, int num_predictors, int batch_size, float forgetting_factor, float P0);
+
+		// Update the batch range [b0, b0+nb) with features x and the values y they predict
+		void update(const Matrix & x, const Matrix & y, int b0, int nb);
+		void reset();
+};
+
+inline RecursiveLeastSquares::RecursiveLeastSquares(int num_features, int num_predictors, int batch_size, float forgetting_factor, float P0)
+	: K(0, 1, num_features, batch_size),
+	  err(0, num_predictors, 1, batch_size),
+	  xtP(0, 1, num_features, batch_size),
+	  cn(0, 1, 1, batch_size),
+	  A(0, num_predictors, num_features, batch_size),
+	  P(0, num_features, num_features, batch_size)
+{
+	gamma = forgetting_factor;
+	_initial_covariance = P0;
+	_num_features = num_features;
+	_num_predictors = num_predictors;
+	_batch_size = batch_size;
+
+	reset();
+}
+
+inline void RecursiveLeastSquares::reset(){
+	A.set_to_zero();
+	K.set_to_zero();
+	err.set_to_zero();
+	xtP.set_to_zero();
+	cn.set_to_zero();
+
+	std::vector<float> P0(_batch_size, _initial_covariance);
+	P.set_identity(P0.data());
+}
+
+inline void RecursiveLeastSquares::update(const Matrix & x, const Matrix & y, int b0, int nb){
+	if(nb <= 0) return;
+
+	const int nf = _num_features;
+	const int np = _num_predictors;
+
+	// xtP = x.T P
+	for(int j=0; j < nf; ++j){
+		lanesT xtp(xtP.lanes(0, j, b0), nb);
+		xtp = const_lanesT(x.lanes(0, 0, b0), nb) * const_lanesT(P.lanes(0, j, b0), nb);
+		for(int i=1; i < nf; ++i){
+			xtp += const_lanesT(x.lanes(i, 0, b0), nb) * const_lanesT(P.lanes(i, j, b0), nb);
+		}
+	}
+
+	// cn = xtP x + gamma
+	lanesT c(cn.lanes(0, 0, b0), nb);
+	c = const_lanesT(xtP.lanes(0, 0, b0), nb) * const_lanesT(x.lanes(0, 0, b0), nb);
+	for(int j=1; j < nf; ++j){
+		c += const_lanesT(xtP.lanes(0, j, b0), nb) * const_lanesT(x.lanes(j, 0, b0), nb);
+	}
+	c += gamma;
+
+	// K = xtP / cn
+	for(int j=0; j < nf; ++j){
+		lanesT(K.lanes(0, j, b0), nb) = const_lanesT(xtP.lanes(0, j, b0), nb) / c;
+	}
+
+	// The a-priori error, err = y - A x
+	for(int p=0; p < np; ++p){
+		lanesT e(err.lanes(p, 0, b0), nb);
+		e = const_lanesT(A.lanes(p, 0, b0), nb) * const_lanesT(x.lanes(0, 0, b0), nb);
+		for(int i=1; i < nf; ++i){
+			e += const_lanesT(A.lanes(p, i, b0), nb) * const_lanesT(x.lanes(i, 0, b0), nb);
+		}
+		e = const_lanesT(y.lanes(p, 0, b0), nb) - e;
+	}
+
+	// A = A + err K
+	for(int i=0; i < nf; ++i){
+		const_lanesT k(K.lanes(0, i, b0), nb);
+		for(int p=0; p < np; ++p){
+			lanesT(A.lanes(p, i, b0), nb) += const_lanesT(err.lanes(p, 0, b0), nb) * k;
+		}
+	}
+
+	// P = (P - xtP.T K) / gamma
+	const float igamma = 1.0 / gamma;
+	for(int j=0; j < nf; ++j){
+		const_lanesT k(K.lanes(0, j, b0), nb);
+		for(int i=0; i < nf; ++i){
+			lanesT Pij(P.lanes(i, j, b0), nb);
+			Pij = (Pij - const_lanesT(xtP.lanes(0, i, b0), nb) * k) * igamma;
+		}
+	}
+}
+
+}
+}
+
+#endif
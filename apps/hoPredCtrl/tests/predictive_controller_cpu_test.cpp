@@ -0,0 +1,403 @@
+/** \file predictive_controller_cpu_test.cpp
+  * \brief Catch2 tests for the CPU backend of the hoPredCtrl predictive controller.
+  *
+  * History:
+  * - 2026-10-17 created
+  */
+
+#include "../../../tests/catch2/catch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../predictive_controller_cpu.hpp"
+
+namespace PCCPUTEST
+{
+
+/// A per-mode, double precision reference for the controller, written directly from the CUDA version
+struct referenceController
+{
+   int nhist, nfut, nmodes, nfeat;
+   double gamma;
+   unsigned long long bufferSize {0};
+   unsigned long long bufferIndex {0};
+
+   std::vector<Eigen::MatrixXd> A, P, ctrl;
+   std::vector<Eigen::VectorXd> phi, xf, wp;
+   Eigen::MatrixXd measBuf, cmdBuf;
+   Eigen::VectorXd command, lambda;
+
+   bool usePredictor {false};
+   double intGain {0.2};
+   double intLeak {0.95};
+
+   referenceController( int nh, int nf, int nm, double g, double P0 ) : nhist(nh), nfut(nf), nmodes(nm), gamma(g)
+   {
+      nfeat = nfut - 1 + 2*nhist;
+
+      int nbits = 0;
+      for(int n = nhist + nfut + 2; n > 0; n >>= 1) ++nbits;
+      bufferSize = (1ULL << nbits) - 1;
+
+      measBuf.setZero(nmodes, bufferSize+1);
+      cmdBuf.setZero(nmodes, bufferSize+1);
+      command.setZero(nmodes);
+      lambda.setZero(nmodes);
+
+      for(int k = 0; k < nmodes; ++k)
+      {
+         A.push_back(Eigen::MatrixXd::Zero(nfut, nfeat));
+         P.push_back(P0*Eigen::MatrixXd::Identity(nfeat, nfeat));
+         ctrl.push_back(Eigen::MatrixXd::Zero(1, nfeat - nfut));
+         ctrl.back()(0, nhist-1) = -0.15;
+         phi.push_back(Eigen::VectorXd::Zero(nfeat));
+         xf.push_back(Eigen::VectorXd::Zero(nfut));
+         wp.push_back(Eigen::VectorXd::Zero(nfeat - nfut));
+      }
+   }
+
+   void addMeasurement( const Eigen::VectorXd & meas )
+   {
+      measBuf.col(bufferIndex & bufferSize) = meas;
+
+      for(int k = 0; k < nmodes; ++k)
+      {
+         for(int i = 0; i < nfut - 1 + nhist; ++i) phi[k](i) = cmdBuf(k, (bufferIndex-1-i) & bufferSize);
+         for(int i = 0; i < nhist; ++i) phi[k](i + nfut - 1 + nhist) = measBuf(k, (bufferIndex-nfut-i) & bufferSize);
+         for(int i = 0; i < nfut; ++i) xf[k](i) = measBuf(k, (bufferIndex-i) & bufferSize);
+         for(int i = 0; i < nhist - 1; ++i) wp[k](i) = cmdBuf(k, (bufferIndex-1-i) & bufferSize);
+         for(int i = 0; i < nhist; ++i) wp[k](i + nhist - 1) = measBuf(k, (bufferIndex-i) & bufferSize);
+      }
+   }
+
+   void getCommand( double clip,
+                    const Eigen::VectorXd & explore
+                  )
+   {
+      for(int k = 0; k < nmodes; ++k)
+      {
+         if(usePredictor)
+         {
+            double delta = (ctrl[k] * wp[k])(0) + explore(k);
+            delta = std::max(-clip, std::min(clip, delta));
+            cmdBuf(k, bufferIndex & bufferSize) = delta;
+            command(k) += delta;
+         }
+         else
+         {
+            command(k) = intLeak*command(k) - intGain*measBuf(k, bufferIndex & bufferSize);
+         }
+      }
+
+      ++bufferIndex;
+   }
+
+   void updatePredictor()
+   {
+      for(int k = 0; k < nmodes; ++k)
+      {
+         Eigen::RowVectorXd xtP = phi[k].transpose() * P[k];
+         double cn = xtP.dot(phi[k]) + gamma;
+         Eigen::RowVectorXd K = xtP / cn;
+         Eigen::VectorXd err = xf[k] - A[k] * phi[k];
+         A[k] += err * K;
+         P[k] = (P[k] - xtP.transpose() * K) / gamma;
+      }
+   }
+
+   void updateController()
+   {
+      for(int k = 0; k < nmodes; ++k)
+      {
+         Eigen::MatrixXd B = A[k].leftCols(nfut);
+         Eigen::MatrixXd H12 = B.transpose() * A[k].rightCols(nfeat - nfut);
+         Eigen::MatrixXd H11 = B.transpose() * B + lambda(k) * Eigen::MatrixXd::Identity(nfut, nfut);
+         Eigen::MatrixXd invH11 = H11.inverse();
+         ctrl[k] = -invH11.row(nfut-1) * H12;
+      }
+   }
+};
+
+/// A seeded recording of wavefront sensor frames, from AR(2) modal disturbances seen through a random response
+struct wfsRecording
+{
+   Eigen::MatrixXf frames; // nmeas x nframes
+   Eigen::MatrixXf im;     // nmodes x nmeas
+   Eigen::MatrixXf mapping;// nact x nmodes
+
+   wfsRecording( int nmodes, int nmeas, int nact, int nframes, unsigned seed )
+   {
+      std::mt19937 gen(seed);
+      std::normal_distribution<float> norm(0.0, 1.0);
+      std::uniform_real_distribution<float> unif(0.0, 1.0);
+
+      Eigen::MatrixXf resp(nmeas, nmodes);
+      for(int i = 0; i < resp.size(); ++i) resp.data()[i] = norm(gen);
+
+      im = (resp.transpose() * resp).inverse() * resp.transpose();
+
+      mapping.resize(nact, nmodes);
+      for(int i = 0; i < mapping.size(); ++i) mapping.data()[i] = norm(gen) / nmodes;
+
+      //Each mode is a damped oscillator at its own frequency
+      Eigen::VectorXf a1(nmodes), a2(nmodes), x1 = Eigen::VectorXf::Zero(nmodes), x2 = Eigen::VectorXf::Zero(nmodes);
+      for(int k = 0; k < nmodes; ++k)
+      {
+         float r = 0.9 + 0.09*unif(gen);
+         float w = 0.05 + 0.5*unif(gen);
+         a1(k) = 2*r*cos(w);
+         a2(k) = -r*r;
+      }
+
+      frames.resize(nmeas, nframes);
+      for(int f = 0; f < nframes; ++f)
+      {
+         Eigen::VectorXf x(nmodes);
+         for(int k = 0; k < nmodes; ++k) x(k) = a1(k)*x1(k) + a2(k)*x2(k) + 0.01*norm(gen);
+         x2 = x1;
+         x1 = x;
+
+         frames.col(f) = resp * x;
+         for(int i = 0; i < nmeas; ++i) frames(i, f) += 0.001*norm(gen);
+      }
+   }
+};
+
+} //namespace PCCPUTEST
+
+using namespace PCCPUTEST;
+
+SCENARIO( "Batched matrices for the CPU controller", "[hoPredCtrl::cpu]" )
+{
+   GIVEN("a batch of 2x3 matrices")
+   {
+      DDSPC::cpu::Matrix m(0, 2, 3, 4);
+      for(int k = 0; k < 4; ++k)
+      {
+         for(int j = 0; j < 3; ++j)
+         {
+            for(int i = 0; i < 2; ++i) m.lanes(i, j, k)[0] = i + 10*j + 100*k;
+         }
+      }
+
+      WHEN("writing a file")
+      {
+         m.to_file("/tmp/pccpu_test_matrix.csv");
+
+         std::ifstream fin("/tmp/pccpu_test_matrix.csv");
+         std::string shape, data;
+         std::getline(fin, shape);
+         std::getline(fin, data);
+
+         //The format of the CUDA Matrix, column-major with the batch slowest
+         REQUIRE( shape == "Shape: (2 , 3 , 4)" );
+         REQUIRE( data.substr(0, 23) == "0,1,10,11,20,21,100,101" );
+      }
+
+      WHEN("reading it back")
+      {
+         m.to_file("/tmp/pccpu_test_matrix.csv");
+
+         DDSPC::cpu::Matrix m2(0, 2, 3, 4);
+         m2.from_file("/tmp/pccpu_test_matrix.csv");
+
+         REQUIRE( m2.data == m.data );
+      }
+
+      WHEN("splitting the batch across parts")
+      {
+         //Parts cover the batch in order, starting on multiples of 16
+         int next = 0;
+         for(size_t p = 0; p < 3; ++p)
+         {
+            int b0, nb;
+            DDSPC::cpu::batch_range(p, 3, 100, b0, nb);
+            REQUIRE( b0 == next );
+            REQUIRE( b0 % 16 == 0 );
+            next = b0 + nb;
+         }
+         REQUIRE( next == 100 );
+      }
+   }
+}
+
+SCENARIO( "The CPU controller matches the reference", "[hoPredCtrl::cpu]" )
+{
+   GIVEN("a recording of wavefront sensor frames")
+   {
+      int nhist = 4, nfut = 2, nmodes = 37, nmeas = 60, nact = 25, nframes = 400;
+      float gamma = 0.995, P0 = 1.0, lambda = 0.1, clip = 0.1, rms = 0.02;
+
+      wfsRecording rec(nmodes, nmeas, nact, nframes, 1234);
+
+      for(int nthreads : {1, 3})
+      {
+         WHEN("learning in closed loop with exploration, with " + std::to_string(nthreads) + " threads")
+         {
+            MagAOX::utils::workerPool pool;
+            pool.start(nthreads);
+
+            std::vector<float> lambdas(nmodes, lambda);
+            DDSPC::cpu::DistributedAutoRegressiveController dar(&pool, nhist, nfut, nmodes, gamma, lambdas.data(), P0);
+            dar.set_integrator(true, 0.2, 0.95);
+            dar.set_new_regularization(lambdas.data());
+
+            referenceController ref(nhist, nfut, nmodes, gamma, P0);
+            ref.usePredictor = true;
+            ref.lambda.setConstant(lambda);
+            ref.updateController();
+
+            //The modal disturbances, with the commands of the last frame added as a DM would
+            Eigen::MatrixXf dist = rec.im * rec.frames;
+
+            std::mt19937 gen(5678);
+            std::bernoulli_distribution coin(0.5);
+
+            Eigen::VectorXf cmd = Eigen::VectorXf::Zero(nmodes);
+            Eigen::VectorXd rcmd = Eigen::VectorXd::Zero(nmodes);
+
+            double maxErr = 0;
+            double maxCmd = 0;
+            for(int f = 0; f < nframes; ++f)
+            {
+               Eigen::VectorXf explore(nmodes);
+               for(int k = 0; k < nmodes; ++k) explore(k) = coin(gen) ? rms : -rms;
+
+               Eigen::VectorXf meas = dist.col(f) + cmd;
+               dar.add_measurement(meas);
+               cmd = dar.get_new_control_command(clip, explore);
+               dar.update_predictor();
+               dar.update_controller();
+
+               ref.addMeasurement(dist.col(f).cast<double>() + rcmd);
+               ref.getCommand(clip, explore.cast<double>());
+               rcmd = ref.command;
+               ref.updatePredictor();
+               ref.updateController();
+
+               maxErr = std::max(maxErr, (cmd.cast<double>() - rcmd).cwiseAbs().maxCoeff());
+               maxCmd = std::max(maxCmd, rcmd.cwiseAbs().maxCoeff());
+            }
+
+            REQUIRE( maxCmd > 0 );
+            REQUIRE( maxErr < 1e-3*maxCmd );
+
+            //The learned controllers agree
+            double maxCtrl = 0;
+            double maxCtrlErr = 0;
+            for(int k = 0; k < nmodes; ++k)
+            {
+               for(int c = 0; c < 2*nhist - 1; ++c)
+               {
+                  maxCtrl = std::max(maxCtrl, fabs(ref.ctrl[k](0, c)));
+                  maxCtrlErr = std::max(maxCtrlErr, fabs(dar.controller.data(k, c) - ref.ctrl[k](0, c)));
+               }
+            }
+            REQUIRE( maxCtrl > 0 );
+            REQUIRE( maxCtrlErr < 1e-3*maxCtrl );
+
+            //A saved state gives the same controller when loaded
+            dar.rls.A.to_file("/tmp/pccpu_test_prediction_matrix_1.csv");
+            dar.rls.P.to_file("/tmp/pccpu_test_covariance_matrix_1.csv");
+
+            DDSPC::cpu::PredictiveController pc(nhist, nfut, nmodes, nmeas, gamma, lambda, P0, nact);
+            pc.set_new_regularization(lambda);
+            pc.load_state("/tmp/pccpu_test_", "1");
+
+            double maxLoadErr = (pc.controller->controller.data - dar.controller.data).cwiseAbs().maxCoeff();
+            REQUIRE( maxLoadErr < 1e-4*maxCtrl );
+         }
+
+         WHEN("replayed through the predictive controller with " + std::to_string(nthreads) + " threads")
+         {
+            DDSPC::cpu::PredictiveController pc(nhist, nfut, nmodes, nmeas, gamma, lambda, P0, nact);
+            pc.set_interaction_matrix(rec.im.data());
+            pc.set_mapping_matrix(rec.mapping.data());
+            pc.set_threads(nthreads);
+            REQUIRE( pc.get_threads() == nthreads );
+
+            referenceController ref(nhist, nfut, nmodes, gamma, P0);
+            Eigen::MatrixXd im = rec.im.cast<double>();
+            Eigen::MatrixXd mapping = rec.mapping.cast<double>();
+
+            //The integrator, then the predictor from the initial controller
+            double maxErr = 0;
+            double maxV = 0;
+            for(int f = 0; f < nframes; ++f)
+            {
+               if(f == nframes/2)
+               {
+                  pc.controller->set_integrator(true, 0.2, 0.95);
+                  ref.usePredictor = true;
+               }
+
+               Eigen::VectorXf wfs = rec.frames.col(f);
+               pc.add_measurement(wfs.data());
+               ref.addMeasurement(im * wfs.cast<double>());
+
+               Eigen::Map<Eigen::VectorXf> volts(pc.get_command(clip), nact);
+               ref.getCommand(clip, Eigen::VectorXd::Zero(nmodes));
+               Eigen::VectorXd rvolts = mapping * ref.command;
+
+               maxErr = std::max(maxErr, (volts.cast<double>() - rvolts).cwiseAbs().maxCoeff());
+               maxV = std::max(maxV, rvolts.cwiseAbs().maxCoeff());
+            }
+
+            REQUIRE( maxV > 0 );
+            REQUIRE( maxErr < 1e-3*maxV );
+         }
+      }
+   }
+}
+
+SCENARIO( "Benchmarking the CPU controller", "[.benchmark][hoPredCtrl::cpu]" )
+{
+   GIVEN("a controller learning on every frame")
+   {
+      int nhist = 10, nfut = 3, nmeas = 4000, nact = 952, nframes = 200;
+
+      int nthreads = std::thread::hardware_concurrency();
+      if(nthreads < 1) nthreads = 1;
+
+      for(int nmodes : {100, 250, 500, 1000, 2000})
+      {
+         for(int nt : {1, nthreads})
+         {
+            DDSPC::cpu::PredictiveController pc(nhist, nfut, nmodes, nmeas, 0.999, 0.1, 1.0, nact);
+
+            Eigen::MatrixXf im = Eigen::MatrixXf::Random(nmodes, nmeas);
+            Eigen::MatrixXf mapping = Eigen::MatrixXf::Random(nact, nmodes);
+            Eigen::MatrixXf frames = Eigen::MatrixXf::Random(nmeas, 16);
+            pc.set_interaction_matrix(im.data());
+            pc.set_mapping_matrix(mapping.data());
+            pc.set_threads(nt);
+            pc.controller->set_integrator(true, 0.2, 0.95);
+
+            std::vector<double> dt;
+            for(int f = 0; f < nframes; ++f)
+            {
+               auto t0 = std::chrono::steady_clock::now();
+
+               pc.add_measurement(frames.col(f % 16).data());
+               pc.get_command(0.1);
+               pc.update_predictor();
+               pc.update_controller();
+
+               auto t1 = std::chrono::steady_clock::now();
+               dt.push_back(std::chrono::duration<double>(t1-t0).count());
+            }
+
+            std::sort(dt.begin(), dt.end());
+            std::cout << "modes: " << nmodes << " threads: " << nt << " median: " << dt[dt.size()/2]*1e6 << " usec, 99%: " << dt[(dt.size()*99)/100]*1e6 << " usec\n";
+
+            if(nt == nthreads) break;
+         }
+      }
+   }
+}
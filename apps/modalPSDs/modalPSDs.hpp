@@ -17,6 +17,8 @@
 #include <mx/math/fft/fftwEnvironment.hpp>
 #include <mx/math/fft/fft.hpp>
 
+#include "psdEngine.hpp"
+
 /** \defgroup modalPSDs
   * \brief An application to calculate rolling PSDs of modal amplitudes
   *
@@ -74,6 +76,8 @@ protected:
 
    int m_nPSDHistory{ 100 }; //
 
+   int m_psdThreads{ 1 }; ///< The number of threads calculating PSDs, including the PSD Calculation thread.  The default is 1.
+
 
    ///@}
 
@@ -93,15 +97,10 @@ protected:
 
    std::vector<realT> m_win; ///< The window function.  By default this is Hann.
 
-   realT* m_tsWork{ nullptr };
-   size_t m_tsWorkSize{ 0 };
-
-   std::complex<realT>* m_fftWork{ nullptr };
-   size_t m_fftWorkSize{ 0 };
+   psdEngine m_engine; ///< Calculates the PSDs of all modes, split across m_psdThreads threads.
 
-   std::vector<realT> m_psd;
+   double m_psdCalcTime{ 0 }; ///< The time taken to calculate the PSDs in the last cycle, in seconds.
 
-   mx::math::fft::fftT< realT, std::complex<realT>, 1, 0> m_fft;
    mx::math::fft::fftwEnvironment<realT> m_fftEnv;
 
    /** \name PSD Calculation Thread
@@ -194,6 +193,7 @@ protected:
    pcf::IndiProperty m_indiP_overSize;
    pcf::IndiProperty m_indiP_fpsSource;
    pcf::IndiProperty m_indiP_fps;
+   pcf::IndiProperty m_indiP_psdCalc;
 
 public:
 
@@ -216,6 +216,8 @@ void modalPSDs::setupConfig()
    config.add("circBuff.fpsSource", "", "circBuff.fpsSource", argType::Required, "circBuff", "fpsSource", false, "string", "Device name for getting fps to set circular buffer length.  This device should have *.fps.current.");
    config.add("circBuff.defaultFPS", "", "circBuff.defaultFPS", argType::Required, "circBuff", "defaultFPS", false, "realT", "Default FPS at startup, will enable changing average length with psdTime before INDI available.");
    config.add("circBuff.psdTime", "", "circBuff.psdTime", argType::Required, "circBuff", "psdTime", false, "realT", "The length of time over which to calculate PSDs.  The default is 1 sec.");
+
+   config.add("psd.threads", "", "psd.threads", argType::Required, "psd", "threads", false, "int", "The number of threads calculating PSDs, including the PSD calculation thread.  The default is 1.");
 }
 
 int modalPSDs::loadConfigImpl(mx::app::appConfigurator& _config)
@@ -226,6 +228,9 @@ int modalPSDs::loadConfigImpl(mx::app::appConfigurator& _config)
    _config(m_fps, "circBuff.defaultFPS");
    _config(m_psdTime, "circBuff.psdTime");
 
+   _config(m_psdThreads, "psd.threads");
+   if(m_psdThreads < 1) m_psdThreads = 1;
+
    return 0;
 }
 
@@ -253,6 +258,11 @@ int modalPSDs::appStartup()
    m_indiP_fps.add(pcf::IndiElement("current"));
    m_indiP_fps["current"] = m_fps;
 
+   CREATE_REG_INDI_RO_NUMBER(m_indiP_psdCalc, "psdCalc", "PSD Calculation", "PSD Setup");
+   m_indiP_psdCalc.add(pcf::IndiElement("time"));
+   m_indiP_psdCalc["time"] = m_psdCalcTime;
+   m_indiP_psdCalc.add(pcf::IndiElement("threads"));
+   m_indiP_psdCalc["threads"] = m_psdThreads;
 
    SHMIMMONITOR_APP_STARTUP;
 
@@ -273,6 +283,8 @@ int modalPSDs::appLogic()
 
    SHMIMMONITOR_UPDATE_INDI;
 
+   updateIfChanged(m_indiP_psdCalc, "time", m_psdCalcTime);
+
    return 0;
 }
 
@@ -300,8 +312,7 @@ int modalPSDs::appShutdown()
       free(m_freqStream);
    }
 
-   if (m_tsWork) fftw_free(m_tsWork);
-   if (m_fftWork) fftw_free(m_fftWork);
+   m_engine.clear();
 
    return 0;
 }
@@ -358,17 +369,6 @@ int modalPSDs::allocate(const dev::shmimT& dummy)
    m_win.resize(m_tsSize);
    mx::sigproc::window::hann(m_win);
 
-   //Set up the FFT and working memory
-   m_fft.plan(m_tsSize, MXFFT_FORWARD, false);
-
-   if (m_tsWork) fftw_free(m_tsWork);
-   m_tsWork = mx::math::fft::fftw_malloc<realT>(m_tsSize);
-
-   if (m_fftWork) fftw_free(m_fftWork);
-   m_fftWork = mx::math::fft::fftw_malloc<std::complex<realT>>((m_tsSize / 2 + 1));
-
-   m_psd.resize(m_tsSize / 2 + 1);
-
    if (m_fps > 0)
    {
       m_df = 1.0 / (m_tsSize / m_fps);
@@ -378,12 +378,25 @@ int modalPSDs::allocate(const dev::shmimT& dummy)
       m_df = 1.0 / (m_tsSize);
    }
 
+   //Set up the FFTs and working memory.  The mean is over as many whole overlaps as fit in the circ buff.
+   if (m_engine.setup(m_nModes, m_tsSize, m_tsOverlapSize, shmimMonitorT::m_depth / m_tsOverlapSize, m_df, m_win, m_psdThreads) < 0)
+   {
+      log<software_error>({ __FILE__,__LINE__, "error setting up PSD calculation" });
+      return -1;
+   }
+
+   if (m_engine.nFull() > shmimMonitorT::m_depth)
+   {
+      log<software_error>({ __FILE__,__LINE__, "circ buff is shorter than the PSD time: " + std::to_string(shmimMonitorT::m_depth) });
+      return -1;
+   }
+
    //Create the shared memory images
    uint32_t imsize[3];
 
    //First the frequency
    imsize[0] = 1;
-   imsize[1] = m_psd.size();
+   imsize[1] = m_engine.nFreq();
    imsize[2] = 1;
 
    if (m_freqStream)
@@ -395,7 +408,7 @@ int modalPSDs::allocate(const dev::shmimT& dummy)
 
    ImageStreamIO_createIm_gpu(m_freqStream, (m_configName + "_freq").c_str(), 3, imsize, IMAGESTRUCT_FLOAT, -1, 1, IMAGE_NB_SEMAPHORE, 0, CIRCULAR_BUFFER | ZAXIS_TEMPORAL, 0);
    m_freqStream->md->write = 1;
-   for (size_t n = 0; n < m_psd.size(); ++n)
+   for (size_t n = 0; n < m_engine.nFreq(); ++n)
    {
       m_freqStream->array.F[n] = n * m_df;
    }
@@ -429,7 +442,7 @@ int modalPSDs::allocatePSDStreams()
    }
 
    uint32_t imsize[3];
-   imsize[0] = m_psd.size();
+   imsize[0] = m_engine.nFreq();
    imsize[1] = m_nModes;
    imsize[2] = m_nPSDHistory;
 
@@ -443,14 +456,14 @@ int modalPSDs::allocatePSDStreams()
       free(m_avgpsdStream);
    }
 
-   imsize[0] = m_psd.size();
+   imsize[0] = m_engine.nFreq();
    imsize[1] = m_nModes;
    imsize[2] = 1;
 
    m_avgpsdStream = static_cast<IMAGE*>(malloc(sizeof(IMAGE)));
    ImageStreamIO_createIm_gpu(m_avgpsdStream, (m_configName + "_psds").c_str(), 3, imsize, IMAGESTRUCT_FLOAT, -1, 1, IMAGE_NB_SEMAPHORE, 0, CIRCULAR_BUFFER | ZAXIS_TEMPORAL, 0);
 
-   m_psdBuffer.resize(m_psd.size(), m_nModes);
+   m_psdBuffer.resize(m_engine.nFreq(), m_nModes);
 
    return 0;
 }
@@ -514,6 +527,9 @@ void modalPSDs::psdThreadExec()
       if (ne1 > m_tsOverlapSize) ne1 -= m_tsSize;
       else ne1 = m_ampCircBuff.size() + ne1 - m_tsSize;
 
+      //The first segment, and any after skipping ahead, start over
+      bool full = true;
+
       while (m_psdRestarting == false && !shutdown())
       {
          //Used to check if we are getting too behind
@@ -523,46 +539,13 @@ void modalPSDs::psdThreadExec()
          ne0 = ne1;
 
          std::cerr << "calculating: " << ne0 << " " << m_ampCircBuff.size() << " " << m_tsSize << "\n";
-         double t0 = mx::sys::get_curr_time();
 
-         for (size_t m = 0; m < shmimMonitorT::m_width * shmimMonitorT::m_height; ++m) //Loop over each mode
-         {
-            //get mean going over entire TS
-            realT mn = 0;
-            for (size_t n = 0; n < m_ampCircBuff.size(); ++n)
-            {
-               mn += m_ampCircBuff[n][m];
-            }
-            mn /= m_ampCircBuff.size();
-
-            double var = 0;
-            for (size_t n = 0; n < m_tsSize; ++n)
-            {
-               m_tsWork[n] = (m_ampCircBuff.at(ne0, n)[m] - mn); //load mean subtracted chunk
-               var += pow(m_tsWork[n], 2);
-
-               m_tsWork[n] *= m_win[n];
-            }
-            var /= m_tsSize;
-
-            m_fft(m_fftWork, m_tsWork);
-
-            double nm = 0;
-            for (size_t n = 0; n < m_psd.size(); ++n)
-            {
-               m_psd[n] = norm(m_fftWork[n]);
-               nm += m_psd[n] * m_df;
-            }
-
-            for (size_t n = 0; n < m_psd.size(); ++n)
-            {
-               m_psd[n] *= (var / nm);
-            }
-
-            //Put it in the buffer for uploading to shmim
-            for (size_t n = 0; n < m_psd.size(); ++n) m_psdBuffer(n, m) = m_psd[n];
+         //The frames being added end with the segment.  When starting over these are all the frames used for the mean.
+         size_t nIn = (full) ? m_engine.nFull() : m_tsOverlapSize;
+         ampCircBuffT::indexT st = (ne0 + m_ampCircBuff.size() + m_tsSize - nIn) % m_ampCircBuff.size();
 
-         }
+         m_engine.calc( [this, st](size_t n){ return m_ampCircBuff.at(st, n); }, full, m_psdBuffer.data());
+         full = false;
 
          //------------------------- the raw psds ---------------------------
          m_rawpsdStream->md->write = 1;
@@ -632,8 +615,8 @@ void modalPSDs::psdThreadExec()
          m_avgpsdStream->md->write = 0;
          ImageStreamIO_sempost(m_avgpsdStream, -1);
 
-         double t1 = mx::sys::get_curr_time();
-         std::cerr << "done " << t1 - t0 << "\n";
+         m_psdCalcTime = m_engine.calcTime();
+         std::cerr << "done " << m_psdCalcTime << "\n";
 
          //Have to be cycling within the overlap
          if (m_ampCircBuff.mono() - mono0 >= m_tsOverlapSize)
@@ -642,6 +625,8 @@ void modalPSDs::psdThreadExec()
             ne0 = m_ampCircBuff.latest();
             if (ne0 > m_tsOverlapSize) ne0 -= m_tsOverlapSize;
             else ne0 = m_ampCircBuff.size() + ne0 - m_tsOverlapSize;
+
+            full = true;
          }
 
          //Now wait until we get to next one
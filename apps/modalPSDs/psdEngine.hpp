@@ -0,0 +1,370 @@
+/** \file psdEngine.hpp
+  * \brief Batched calculation of the PSDs of many modes for the modalPSDs app
+  *
+  * \ingroup modalPSDs_files
+  */
+
+#ifndef modalPSDs_psdEngine_hpp
+#define modalPSDs_psdEngine_hpp
+
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include <fftw3.h>
+
+#include "../../libMagAOX/utils/workerPool.hpp"
+
+namespace MagAOX
+{
+namespace app
+{
+
+/// Calculate the rolling PSDs of many modes at once, split across a pool of threads.
+/** The input is a sequence of frames, each holding the amplitudes of all modes at one time.  The engine
+  * keeps the current segment of each mode contiguous, so successive segments which overlap by
+  * \f$ N - H \f$ samples (for segment length \f$ N \f$ and hop \f$ H \f$) only need the \f$ H \f$ new
+  * samples to be transposed in.  The mean of each mode over the last several hops is kept as a sum per hop,
+  * so it is updated with the new hop rather than recalculated over the whole history.
+  *
+  * The modes are split into one block per thread of a utils::workerPool.  Each block has its own batched real
+  * FFT plan over all of its modes, and its own buffers, so the threads share nothing while they work.  The
+  * calling thread does the first block.
+  *
+  * The window makes each segment's transform different even where the data overlap, so each segment is
+  * still transformed in full.
+  *
+  * This uses the single precision FFTW interface, so only float is supported.
+  *
+  * \ingroup modalPSDs
+  */
+class psdEngine
+{
+public:
+
+   typedef float realT;
+   typedef std::complex<realT> complexT;
+
+   /// Get the pointer to the amplitudes of frame n of those being added, in time order.
+   typedef std::function<const realT *(size_t)> frameAccessT;
+
+protected:
+
+   size_t m_nModes {0}; ///< The number of modes
+   size_t m_tsSize {0}; ///< The length of each segment
+   size_t m_hop {0}; ///< The number of samples between the starts of successive segments
+   size_t m_nMeanHops {0}; ///< The number of hops over which the mean is calculated
+   size_t m_nFreq {0}; ///< The number of frequencies in each PSD, m_tsSize/2 + 1
+   realT m_df {1}; ///< The frequency spacing
+
+   std::vector<realT> m_win; ///< The window
+
+   std::vector<realT> m_seg; ///< The current segment of each mode, contiguous by mode
+
+   std::vector<double> m_hopSums; ///< The sum of each mode over each of the last m_nMeanHops hops, contiguous by mode
+   size_t m_hopPos {0}; ///< The position in m_hopSums of the newest hop
+
+   /// The FFT plan and buffers of one block of modes
+   struct block
+   {
+      size_t m_mode0 {0}; ///< The first mode in the block
+      size_t m_nBlockModes {0}; ///< The number of modes in the block
+      realT * m_in {nullptr}; ///< The windowed segments
+      fftwf_complex * m_out {nullptr}; ///< The transforms
+      fftwf_plan m_plan {nullptr}; ///< The batched plan
+   };
+
+   std::vector<block> m_blocks; ///< One block for each thread
+
+   utils::workerPool m_pool; ///< The threads, one part for each block
+
+   double m_calcTime {0}; ///< The time taken by the last call to calc, in seconds
+
+public:
+
+   psdEngine()
+   {
+   }
+
+   ~psdEngine()
+   {
+      clear();
+   }
+
+   psdEngine( const psdEngine & ) = delete;
+   psdEngine & operator=( const psdEngine & ) = delete;
+
+   /// Allocate the buffers, plan the FFTs and start the threads
+   /** Any previous setup is cleared first.  This must not be called while calc is running.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int setup( size_t nModes,    ///< [in] the number of modes
+              size_t tsSize,    ///< [in] the length of each segment
+              size_t hop,       ///< [in] the number of samples between the starts of successive segments, 0 < hop <= tsSize
+              size_t nMeanHops, ///< [in] the number of hops over which to calculate the mean.  Increased if needed to cover a segment.
+              realT df,         ///< [in] the frequency spacing
+              const std::vector<realT> & win, ///< [in] the window, of length tsSize
+              size_t nThreads   ///< [in] the number of threads, including the caller's.  Reduced to the number of modes if larger.
+            );
+
+   /// Stop the threads and free the buffers and plans
+   void clear();
+
+   /// Get the number of frequencies in each PSD
+   size_t nFreq() const
+   {
+      return m_nFreq;
+   }
+
+   /// Get the number of frames which must be given to calc when starting over
+   size_t nFull() const
+   {
+      return m_nMeanHops*m_hop;
+   }
+
+   /// Get the number of threads in use, including the caller's
+   size_t nThreads() const
+   {
+      return m_blocks.size();
+   }
+
+   /// Get the time taken by the last call to calc
+   /**
+     * \returns the time in seconds
+     */
+   double calcTime() const
+   {
+      return m_calcTime;
+   }
+
+   /// Add frames and calculate the PSDs of the segment which ends with them
+   /** If full is true the engine starts over, and nFull() frames must be given.  These are used for the
+     * mean, and the last m_tsSize of them are the segment.  Otherwise the next hop of frames is given, and
+     * the segment advances by one hop.
+     *
+     * Each PSD is normalized so that its integral is the variance of the segment about the mean.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int calc( const frameAccessT & frame, ///< [in] gives the frames being added, in time order
+             bool full,                  ///< [in] if true the engine starts over with nFull() frames, otherwise one hop is added
+             realT * psds                ///< [out] the PSDs, contiguous by mode, m_nFreq per mode
+           );
+
+protected:
+
+   /// Add frames to, and calculate the PSDs of, one block
+   void calcBlock( block & blk,                ///< [in] the block
+                   const frameAccessT & frame, ///< [in] gives the frames being added
+                   bool full,                  ///< [in] if true the segment and hop sums are rebuilt
+                   realT * psds                ///< [out] the PSDs of all modes
+                 );
+};
+
+inline
+int psdEngine::setup( size_t nModes,
+                      size_t tsSize,
+                      size_t hop,
+                      size_t nMeanHops,
+                      realT df,
+                      const std::vector<realT> & win,
+                      size_t nThreads
+                    )
+{
+   clear();
+
+   if(nModes == 0 || tsSize == 0 || hop == 0 || hop > tsSize || win.size() != tsSize) return -1;
+
+   m_nModes = nModes;
+   m_tsSize = tsSize;
+   m_hop = hop;
+   m_nFreq = tsSize/2 + 1;
+   m_df = df;
+   m_win = win;
+
+   //The mean has to cover at least one segment
+   size_t minHops = (tsSize + hop - 1)/hop;
+   m_nMeanHops = (nMeanHops < minHops) ? minHops : nMeanHops;
+
+   m_seg.assign(m_nModes*m_tsSize, 0);
+   m_hopSums.assign(m_nModes*m_nMeanHops, 0);
+   m_hopPos = 0;
+
+   if(nThreads < 1) nThreads = 1;
+   if(nThreads > m_nModes) nThreads = m_nModes;
+
+   m_blocks.resize(nThreads);
+
+   for(size_t b = 0; b < m_blocks.size(); ++b)
+   {
+      block & blk = m_blocks[b];
+      blk.m_mode0 = (b*m_nModes)/nThreads;
+      blk.m_nBlockModes = ((b+1)*m_nModes)/nThreads - blk.m_mode0;
+
+      blk.m_in = fftwf_alloc_real(blk.m_nBlockModes*m_tsSize);
+      blk.m_out = fftwf_alloc_complex(blk.m_nBlockModes*m_nFreq);
+
+      if(blk.m_in == nullptr || blk.m_out == nullptr)
+      {
+         clear();
+         return -1;
+      }
+
+      //One plan for all modes of the block, each a contiguous segment.
+      int n = m_tsSize;
+      blk.m_plan = fftwf_plan_many_dft_r2c( 1, &n, blk.m_nBlockModes, blk.m_in, nullptr, 1, m_tsSize,
+                                                                      blk.m_out, nullptr, 1, m_nFreq, FFTW_MEASURE );
+
+      if(blk.m_plan == nullptr)
+      {
+         clear();
+         return -1;
+      }
+   }
+
+   m_pool.start(m_blocks.size());
+
+   return 0;
+}
+
+inline
+void psdEngine::clear()
+{
+   m_pool.stop();
+
+   for(size_t b = 0; b < m_blocks.size(); ++b)
+   {
+      if(m_blocks[b].m_plan) fftwf_destroy_plan(m_blocks[b].m_plan);
+      if(m_blocks[b].m_in) fftwf_free(m_blocks[b].m_in);
+      if(m_blocks[b].m_out) fftwf_free(m_blocks[b].m_out);
+   }
+   m_blocks.clear();
+
+   m_nModes = 0;
+   m_nFreq = 0;
+}
+
+inline
+int psdEngine::calc( const frameAccessT & frame,
+                     bool full,
+                     realT * psds
+                   )
+{
+   if(m_blocks.size() == 0) return -1;
+
+   timespec ts0, ts1;
+   clock_gettime(CLOCK_MONOTONIC, &ts0);
+
+   //The newest hop replaces the oldest in the mean
+   if(full) m_hopPos = m_nMeanHops - 1;
+   else m_hopPos = (m_hopPos + 1) % m_nMeanHops;
+
+   m_pool.run( [this, &frame, full, psds](size_t b){ calcBlock(m_blocks[b], frame, full, psds); } );
+
+   clock_gettime(CLOCK_MONOTONIC, &ts1);
+   m_calcTime = (ts1.tv_sec - ts0.tv_sec) + (ts1.tv_nsec - ts0.tv_nsec)/1e9;
+
+   return 0;
+}
+
+inline
+void psdEngine::calcBlock( block & blk,
+                           const frameAccessT & frame,
+                           bool full,
+                           realT * psds
+                         )
+{
+   size_t m0 = blk.m_mode0;
+   size_t m1 = blk.m_mode0 + blk.m_nBlockModes;
+
+   //-- Transpose the new frames in, and sum them by hop
+   size_t nNew;
+   if(full)
+   {
+      nNew = nFull();
+
+      for(size_t m = m0; m < m1; ++m)
+      {
+         for(size_t h = 0; h < m_nMeanHops; ++h) m_hopSums[m*m_nMeanHops + h] = 0;
+      }
+   }
+   else
+   {
+      nNew = m_hop;
+
+      for(size_t m = m0; m < m1; ++m)
+      {
+         memmove(&m_seg[m*m_tsSize], &m_seg[m*m_tsSize + m_hop], (m_tsSize - m_hop)*sizeof(realT));
+         m_hopSums[m*m_nMeanHops + m_hopPos] = 0;
+      }
+   }
+
+   for(size_t n = 0; n < nNew; ++n)
+   {
+      const realT * f = frame(n);
+
+      //When starting over the frames fill all hops, oldest first
+      size_t h = full ? n/m_hop : m_hopPos;
+
+      //Only the last m_tsSize frames are in the segment
+      long sn = (long) n + m_tsSize - nNew;
+
+      for(size_t m = m0; m < m1; ++m)
+      {
+         m_hopSums[m*m_nMeanHops + h] += f[m];
+         if(sn >= 0) m_seg[m*m_tsSize + sn] = f[m];
+      }
+   }
+
+   //-- Remove the mean, apply the window, and transform
+   std::vector<double> var(blk.m_nBlockModes);
+
+   for(size_t m = m0; m < m1; ++m)
+   {
+      double sum = 0;
+      for(size_t h = 0; h < m_nMeanHops; ++h) sum += m_hopSums[m*m_nMeanHops + h];
+      realT mn = sum / nFull();
+
+      const realT * seg = &m_seg[m*m_tsSize];
+      realT * in = blk.m_in + (m - m0)*m_tsSize;
+
+      double v = 0;
+      for(size_t n = 0; n < m_tsSize; ++n)
+      {
+         realT d = seg[n] - mn;
+         v += d*d;
+         in[n] = d*m_win[n];
+      }
+      var[m - m0] = v / m_tsSize;
+   }
+
+   fftwf_execute(blk.m_plan);
+
+   //-- Normalize so the integral is the variance
+   for(size_t m = m0; m < m1; ++m)
+   {
+      const complexT * out = reinterpret_cast<const complexT *>(blk.m_out + (m - m0)*m_nFreq);
+      realT * psd = psds + m*m_nFreq;
+
+      double nm = 0;
+      for(size_t n = 0; n < m_nFreq; ++n)
+      {
+         psd[n] = std::norm(out[n]);
+         nm += psd[n];
+      }
+      nm *= m_df;
+
+      realT scale = (nm > 0) ? var[m - m0] / nm : 0;
+      for(size_t n = 0; n < m_nFreq; ++n) psd[n] *= scale;
+   }
+}
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //modalPSDs_psdEngine_hpp
@@ -39,4 +39,117 @@ SCENARIO( "INDI Callbacks", "[modalPSDs]" )
 }
 
 
+/// Calculate the PSD of one mode directly, for comparison with psdEngine
+std::vector<float> directPSD( const std::vector<std::vector<float>> & frames, ///< all the frames
+                              size_t end,                                      ///< one past the last frame in the segment
+                              size_t tsSize,                                   ///< the segment length
+                              size_t nMean,                                    ///< the number of frames in the mean
+                              size_t m,                                        ///< the mode
+                              const std::vector<float> & win,                  ///< the window
+                              float df                                         ///< the frequency spacing
+                            )
+{
+    double mn = 0;
+    for(size_t n = end - nMean; n < end; ++n) mn += frames[n][m];
+    mn /= nMean;
+
+    std::vector<double> ts(tsSize);
+    double var = 0;
+    for(size_t n = 0; n < tsSize; ++n)
+    {
+        ts[n] = frames[end - tsSize + n][m] - mn;
+        var += ts[n]*ts[n];
+        ts[n] *= win[n];
+    }
+    var /= tsSize;
+
+    std::vector<float> psd(tsSize/2 + 1);
+    double nm = 0;
+    for(size_t k = 0; k < psd.size(); ++k)
+    {
+        std::complex<double> c = 0;
+        for(size_t n = 0; n < tsSize; ++n) c += ts[n] * std::exp(std::complex<double>(0, -2*M_PI*k*n/tsSize));
+        psd[k] = std::norm(c);
+        nm += psd[k]*df;
+    }
+
+    for(size_t k = 0; k < psd.size(); ++k) psd[k] *= var/nm;
+
+    return psd;
+}
+
+SCENARIO( "Calculating PSDs of many modes", "[modalPSDs]" )
+{
+    GIVEN("segments overlapping by half")
+    {
+        size_t nModes = 7;
+        size_t tsSize = 16;
+        size_t hop = 8;
+        size_t nMeanHops = 4;
+        float df = 0.5;
+
+        std::vector<float> win(tsSize);
+        for(size_t n = 0; n < tsSize; ++n) win[n] = 0.5*(1 - cos(2*M_PI*n/(tsSize-1)));
+
+        //Each mode a different sinusoid plus an offset and a drift
+        std::vector<std::vector<float>> frames(100, std::vector<float>(nModes));
+        for(size_t n = 0; n < frames.size(); ++n)
+        {
+            for(size_t m = 0; m < nModes; ++m) frames[n][m] = m + 0.01*n + sin(2*M_PI*(m+1)*n/tsSize + m);
+        }
+
+        for(size_t nThreads : {1, 3, 10})
+        {
+            WHEN("using " + std::to_string(nThreads) + " threads")
+            {
+                psdEngine pe;
+                REQUIRE( pe.setup(nModes, tsSize, hop, nMeanHops, df, win, nThreads) == 0 );
+                REQUIRE( pe.nFreq() == tsSize/2 + 1 );
+                REQUIRE( pe.nFull() == nMeanHops*hop );
+                REQUIRE( pe.nThreads() == std::min(nThreads, nModes) );
+
+                std::vector<float> psds(nModes*pe.nFreq());
+
+                //Start over, then advance by a hop at a time
+                size_t end = pe.nFull() + 3;
+                REQUIRE( pe.calc([&](size_t n){ return frames[end - pe.nFull() + n].data(); }, true, psds.data()) == 0 );
+
+                for(int c = 0; c < 5; ++c)
+                {
+                    if(c > 0)
+                    {
+                        end += hop;
+                        REQUIRE( pe.calc([&](size_t n){ return frames[end - hop + n].data(); }, false, psds.data()) == 0 );
+                    }
+
+                    REQUIRE( pe.calcTime() >= 0 );
+
+                    for(size_t m = 0; m < nModes; ++m)
+                    {
+                        std::vector<float> psd = directPSD(frames, end, tsSize, pe.nFull(), m, win, df);
+                        for(size_t k = 0; k < psd.size(); ++k)
+                        {
+                            REQUIRE( psds[m*pe.nFreq() + k] == Approx(psd[k]).margin(1e-5) );
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN("invalid sizes")
+    {
+        psdEngine pe;
+        std::vector<float> win(16, 1);
+
+        REQUIRE( pe.setup(0, 16, 8, 4, 1, win, 1) == -1 );
+        REQUIRE( pe.setup(7, 16, 0, 4, 1, win, 1) == -1 );
+        REQUIRE( pe.setup(7, 16, 17, 4, 1, win, 1) == -1 );
+        REQUIRE( pe.setup(7, 8, 4, 4, 1, win, 1) == -1 );
+
+        std::vector<float> psds(100);
+        REQUIRE( pe.calc([](size_t){ return nullptr; }, true, psds.data()) == -1 );
+    }
+}
+
 //} //namespace modalPSDs_test 
@@ -1353,6 +1353,7 @@ int ocam2KCtrl::acquireAndCheckValid()
             long framesSkipped = m_currImageNumber - m_lastImageNumber - 1;
             
             log<text_log>("frames skipped: " + std::to_string(framesSkipped), logPrio::LOG_ERROR);
+            m_fgDropped += framesSkipped;
             
             m_lastImageNumber = -1;
             m_nextMode = m_modeName;
@@ -1378,6 +1379,7 @@ int ocam2KCtrl::acquireAndCheckValid()
       }
    }
    m_lastImageNumber = m_currImageNumber;
+   m_currImageFrameNo = m_currImageNumber;
    return 0;
 }
 
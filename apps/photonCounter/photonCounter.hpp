@@ -16,6 +16,8 @@ using namespace mx::improc;
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "pixelQuantiles.hpp"
+
 namespace MagAOX
 {
 namespace app
@@ -68,13 +70,14 @@ protected:
    ///@}
 
 	sem_t m_smSemaphore; ///< Semaphore used to synchronize the fg thread and the sm thread.
-	realT (*pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+	pixKernels<realT> m_pixKernels; ///< The bulk pixel kernels for the data type of the input stream.
 	void * m_curr_src {nullptr};
 
 	int m_image_width;
 	int m_image_height;
 
-	mx::improc::eigenCube<realT> m_calibrationCube;
+	pixelQuantiles<realT> m_quantiles; ///< Streaming estimate of the threshold quantile of each pixel during calibration.
+	mx::improc::eigenImage<realT> m_calibrationFrame; ///< The current calibration frame, converted to realT.
 	mx::improc::eigenImage<realT> m_dark_image;   
 	mx::improc::eigenImage<realT> m_thresholdImage;
 	mx::improc::eigenImage<realT> m_photonCountedImage;
@@ -322,8 +325,13 @@ int photonCounter::allocate(const dev::shmimT & dummy)
 	m_image_height = shmimMonitorT::m_height;
 	m_image_width = shmimMonitorT::m_width;
 
-	m_calibrationCube.resize(shmimMonitorT::m_width, shmimMonitorT::m_height, calibration_steps);
-	m_calibrationCube.setZero();
+	m_pixKernels = getPixKernels<realT>(shmimMonitorT::m_dataType);
+	if(m_pixKernels.countAbove == nullptr)
+	{
+		return log<software_error,-1>({__FILE__, __LINE__, "unsupported data type"});
+	}
+
+	m_calibrationFrame.resize(shmimMonitorT::m_width, shmimMonitorT::m_height);
 
 	m_thresholdImage.resize(shmimMonitorT::m_width, shmimMonitorT::m_height);
 	m_thresholdImage.setZero();
@@ -352,24 +360,23 @@ int photonCounter::processImage( void * curr_src,
 {
    static_cast<void>(dummy); //be unused
 
-   // Set the internal pointer to the new data stream
-   	Eigen::Map<eigenImage<unsigned short>> camera_image( static_cast<unsigned short *>(curr_src), m_image_height, m_image_width);
+   size_t npix = m_image_width * m_image_height;
 
    if(m_calibrate){
 	
 	   if(current_calibration_iteration == 0)
+	   {
 	   		std::cout << "Start data collection" << std::endl;
+	   		m_quantiles.init(npix, m_quantile_cut);
+	   		m_dark_image.setZero();
+	   }
 		
 		m_calibrationSet = false;
 		
-		// Copy the data into the stream
-		for(uint32_t col_i=0; col_i < m_image_width; ++col_i){
-			for(uint32_t row_i=0; row_i < m_image_height; ++row_i){
-
-				m_calibrationCube.image(current_calibration_iteration)(row_i, col_i) = (float)camera_image(row_i, col_i);
-
-			}
-		}
+		// Update the threshold estimates and the dark sum with this frame, so memory and time per frame do not depend on the number of frames
+		m_pixKernels.convert(m_calibrationFrame.data(), curr_src, npix);
+		m_quantiles.add(m_calibrationFrame.data());
+		m_dark_image += m_calibrationFrame;
 
 		current_calibration_iteration += 1;
 
@@ -377,48 +384,14 @@ int photonCounter::processImage( void * curr_src,
 			// We have collected enough data!
 			current_calibration_iteration = 0;
 			m_calibrate = false;
-			m_calibrationSet = true;
 
-			// Measure the average dark frame
-			m_calibrationCube.mean(m_dark_image);
-
-			// Copy the data into the stream
-			for(uint32_t col_i=0; col_i < m_image_width; ++col_i){
-				for(uint32_t row_i=0; row_i < m_image_height; ++row_i){
-					
-					if( col_i == 0){
-					 	std::cout << "The dark : " << m_dark_image(row_i, col_i) << " ";
-					}
-
-					// Get the time-series of the pixel of interest
-					// auto pixelVec = m_calibrationCube.pixel(row_i, col_i);
-					
-					// Dark subtract the timeseries
-					// for(size_t p=0; p<pixelVec.size(); p++){
-					// 	pixelVec(p, 0) = pixelVec(p, 0) - m_dark_image(row_i, col_i);
-					// }
-					std::vector<float> tempVec;
-					for(int ti=0; ti < calibration_steps; ti++){
-						float val = m_calibrationCube.image(ti)(row_i, col_i);
-						tempVec.push_back(val);
-					}
-					
-					// Make it a standard library vector
-					// float* start = &pixelVec(0,0);
-					// float* end = &pixelVec(0,0) + pixelVec.size() * sizeof(float);
-					//
-					// Sort the array
-					std::sort(tempVec.begin(), tempVec.end());
-					
-					// Find the qth quantile
-					int q_index = (int)(m_quantile_cut * tempVec.size());
-					if( col_i == 0 )
-						std::cout <<"q0: [" << tempVec[0] << ", " << tempVec[q_index] << ", " << tempVec[tempVec.size()-1] << "]" << std::endl;
-					
-					m_thresholdImage(row_i, col_i) = tempVec[q_index];
-					
-				}
-			}
+			// The average dark frame
+			m_dark_image /= m_quantiles.count();
+
+			// The qth quantile of each pixel
+			m_quantiles.quantile(m_thresholdImage.data());
+
+			m_calibrationSet = true;
 
 			std::cout << "Calibration done!" << std::endl;
 		}
@@ -427,20 +400,8 @@ int photonCounter::processImage( void * curr_src,
    }else{
 	   
 		if(m_calibrationSet){
-			// if( m_stack_frames_index == 0 )
-			// 	std::cout << "Start collecting data for stacking..." << std::endl;
-
 			// Apply photon counting
-			for(uint32_t col_i=0; col_i < m_image_width; ++col_i){
-				for(uint32_t row_i=0; row_i < m_image_height; ++row_i){
-					float dI = (float)camera_image(row_i, col_i); // - m_dark_image(row_i, col_i);
-					
-					if( dI > m_thresholdImage(row_i, col_i)){
-						m_photonCountedImage(row_i, col_i) += 1.0;
-					}
-
-				}
-			}
+			m_pixKernels.countAbove(m_photonCountedImage.data(), curr_src, m_thresholdImage.data(), npix);
 			
 			m_stack_frames_index += 1;
 
@@ -519,18 +480,11 @@ inline
 int photonCounter::loadImageIntoStream(void * dest)
 {
    //Here is where we do it.   
-   Eigen::Map<eigenImage<float>> photon_counted_out(static_cast<uint16_t*>(dest), frameGrabberT::m_width, frameGrabberT::m_height );
+   Eigen::Map<eigenImage<float>> photon_counted_out(static_cast<float*>(dest), frameGrabberT::m_width, frameGrabberT::m_height );
    
 	// Copy the data into the stream
-	for(uint32_t col_i=0; col_i < m_image_width; ++col_i){
-		for(uint32_t row_i=0; row_i < m_image_height; ++row_i){
-			
-			photon_counted_out(row_i, col_i) = m_photonCountedImage(row_i, col_i);
-
-			m_photonCountedImage(row_i, col_i) = 0.0;
-
-		}
-	}
+	photon_counted_out = m_photonCountedImage;
+	m_photonCountedImage.setZero();
 
    return 0;
 }
@@ -627,8 +581,6 @@ INDI_NEWCALLBACK_DEFN(photonCounter, m_indiP_calibrateSteps )(const pcf::IndiPro
 	std::lock_guard<std::mutex> guard(m_indiMutex);
 
 	calibration_steps = target;
-	m_calibrationCube.resize(m_image_width, m_image_height, calibration_steps);
-	m_calibrationCube.setZero();
 
 	updateIfChanged(m_indiP_calibrateSteps, "target", calibration_steps);
 
@@ -0,0 +1,247 @@
+/** \file pixelQuantiles.hpp
+  * \brief Streaming per-pixel quantile estimates for the photonCounter
+  *
+  * \ingroup photonCounter_files
+  *
+  * History:
+  * - 2026-10-17 created
+  */
+
+#ifndef photonCounter_pixelQuantiles_hpp
+#define photonCounter_pixelQuantiles_hpp
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../../libMagAOX/ImageStreamIO/pixaccess.hpp"
+
+namespace MagAOX
+{
+namespace app
+{
+
+/// Adjust one middle marker of the P-squared algorithm
+/** Both the parabolic and linear predictions are calculated, and the result selected, so that this has no branches
+  * and the loop over pixels calling it vectorizes.
+  */
+template<typename realT>
+inline
+void p2Adjust( realT qm,      ///< [in] the height of the marker below
+               realT & q,     ///< [in/out] the height of this marker
+               realT qp,      ///< [in] the height of the marker above
+               realT nm,      ///< [in] the position of the marker below
+               realT & n,     ///< [in/out] the position of this marker
+               realT np,      ///< [in] the position of the marker above
+               realT desired  ///< [in] the desired position of this marker
+             )
+{
+   realT d = desired - n;
+   bool up = (d >= 1) & (np - n > 1);
+   bool down = (d <= -1) & (nm - n < -1);
+   realT s = up ? 1 : -1;
+
+   realT qpar = q + s/(np - nm) * ( (n - nm + s)*(qp - q)/(np - n) + (np - n - s)*(q - qm)/(n - nm) );
+   realT qlin = up ? q + (qp - q)/(np - n) : q - (qm - q)/(nm - n);
+   realT qnew = (qm < qpar && qpar < qp) ? qpar : qlin;
+
+   bool move = up | down;
+   q = move ? qnew : q;
+   n = move ? n + s : n;
+}
+
+/// Update the P-squared markers of every pixel with a new frame
+/** Requires that the markers were initialized from the first 5 frames.
+  */
+template<typename realT>
+PIXACCESS_TARGET_CLONES
+void p2Update( realT * __restrict__ q0,       ///< [in/out] the minimum of each pixel
+               realT * __restrict__ q1,       ///< [in/out] the first middle marker of each pixel
+               realT * __restrict__ q2,       ///< [in/out] the quantile marker of each pixel
+               realT * __restrict__ q3,       ///< [in/out] the third middle marker of each pixel
+               realT * __restrict__ q4,       ///< [in/out] the maximum of each pixel
+               realT * __restrict__ n1,       ///< [in/out] the position of the first middle marker of each pixel
+               realT * __restrict__ n2,       ///< [in/out] the position of the quantile marker of each pixel
+               realT * __restrict__ n3,       ///< [in/out] the position of the third middle marker of each pixel
+               const realT * __restrict__ im, ///< [in] the new frame
+               realT last,                    ///< [in] the position of the maximum, one less than the number of frames including this one
+               realT d1,                      ///< [in] the desired position of the first middle marker
+               realT d2,                      ///< [in] the desired position of the quantile marker
+               realT d3,                      ///< [in] the desired position of the third middle marker
+               size_t npix                    ///< [in] the number of pixels
+             )
+{
+   for(size_t k = 0; k < npix; ++k)
+   {
+      realT x = im[k];
+
+      realT Q0 = (x < q0[k]) ? x : q0[k];
+      realT Q1 = q1[k];
+      realT Q2 = q2[k];
+      realT Q3 = q3[k];
+      realT Q4 = (x > q4[k]) ? x : q4[k];
+
+      //The markers above the new value move up one position
+      realT N1 = n1[k] + ((x < Q1) ? 1 : 0);
+      realT N2 = n2[k] + ((x < Q2) ? 1 : 0);
+      realT N3 = n3[k] + ((x < Q3) ? 1 : 0);
+
+      p2Adjust<realT>(Q0, Q1, Q2, 0, N1, N2, d1);
+      p2Adjust<realT>(Q1, Q2, Q3, N1, N2, N3, d2);
+      p2Adjust<realT>(Q2, Q3, Q4, N2, N3, last, d3);
+
+      q0[k] = Q0;
+      q1[k] = Q1;
+      q2[k] = Q2;
+      q3[k] = Q3;
+      q4[k] = Q4;
+      n1[k] = N1;
+      n2[k] = N2;
+      n3[k] = N3;
+   }
+}
+
+/// Sort 5 values for each pixel in place, with a sorting network
+template<typename realT>
+PIXACCESS_TARGET_CLONES
+void p2Sort5( realT * __restrict__ q0, ///< [in/out] the first value of each pixel
+              realT * __restrict__ q1, ///< [in/out] the second value of each pixel
+              realT * __restrict__ q2, ///< [in/out] the third value of each pixel
+              realT * __restrict__ q3, ///< [in/out] the fourth value of each pixel
+              realT * __restrict__ q4, ///< [in/out] the fifth value of each pixel
+              size_t npix              ///< [in] the number of pixels
+            )
+{
+   for(size_t k = 0; k < npix; ++k)
+   {
+      realT v[5] = {q0[k], q1[k], q2[k], q3[k], q4[k]};
+
+      static constexpr int net[9][2] = {{0,1},{3,4},{2,4},{2,3},{0,3},{0,2},{1,4},{1,3},{1,2}};
+      for(int c = 0; c < 9; ++c)
+      {
+         realT a = v[net[c][0]];
+         realT b = v[net[c][1]];
+         v[net[c][0]] = (a < b) ? a : b;
+         v[net[c][1]] = (a < b) ? b : a;
+      }
+
+      q0[k] = v[0];
+      q1[k] = v[1];
+      q2[k] = v[2];
+      q3[k] = v[3];
+      q4[k] = v[4];
+   }
+}
+
+/// Streaming estimates of one quantile of the time series of each pixel
+/** Uses the P-squared algorithm of Jain and Chlamtac (1985, CACM 28, 1076).  Each pixel keeps 5 marker heights and
+  * the positions of the 3 middle markers, so memory does not depend on the number of frames, and each frame is
+  * one pass over the pixels.  The markers of all pixels are stored as separate arrays so that the update vectorizes.
+  *
+  * Positions are stored as realT, so with float they are exact for up to \f$ 2^{24} \f$ frames.
+  *
+  * \tparam realT the floating point type of the frames and estimates
+  *
+  * \ingroup photonCounter
+  */
+template<typename realT>
+class pixelQuantiles
+{
+protected:
+   realT m_p {0.5};    ///< The quantile to estimate
+   size_t m_npix {0};  ///< The number of pixels
+   uint64_t m_count {0}; ///< The number of frames added
+
+   std::vector<realT> m_q[5]; ///< The marker heights of each pixel.  Before 5 frames, the frames themselves.
+   std::vector<realT> m_n[3]; ///< The positions of the middle markers of each pixel.  The others are 0 and m_count-1.
+
+public:
+
+   /// Setup for a new estimate, discarding any frames already added
+   void init( size_t npix, ///< [in] the number of pixels in each frame
+              realT p      ///< [in] the quantile to estimate, 0 <= p <= 1
+            )
+   {
+      m_npix = npix;
+      m_p = p;
+      m_count = 0;
+
+      for(int i = 0; i < 5; ++i) m_q[i].assign(npix, 0);
+      for(int i = 0; i < 3; ++i) m_n[i].assign(npix, i+1);
+   }
+
+   /// Get the quantile being estimated
+   realT p() const
+   {
+      return m_p;
+   }
+
+   /// Get the number of pixels in each frame
+   size_t npix() const
+   {
+      return m_npix;
+   }
+
+   /// Get the number of frames added
+   uint64_t count() const
+   {
+      return m_count;
+   }
+
+   /// Add a frame
+   void add( const realT * im /**< [in] the frame, with npix() pixels*/)
+   {
+      if(m_count < 5)
+      {
+         std::copy(im, im + m_npix, m_q[m_count].data());
+         ++m_count;
+
+         if(m_count == 5)
+         {
+            p2Sort5(m_q[0].data(), m_q[1].data(), m_q[2].data(), m_q[3].data(), m_q[4].data(), m_npix);
+         }
+
+         return;
+      }
+
+      ++m_count;
+
+      realT last = m_count - 1;
+      p2Update<realT>(m_q[0].data(), m_q[1].data(), m_q[2].data(), m_q[3].data(), m_q[4].data(),
+                      m_n[0].data(), m_n[1].data(), m_n[2].data(), im,
+                      last, last*m_p/2, last*m_p, last*(1+m_p)/2, m_npix);
+   }
+
+   /// Get the current estimate of the quantile of each pixel
+   /** Before 5 frames have been added this is the order statistic at p*count() of the frames added so far, and
+      * with no frames it is 0.
+      */
+   void quantile( realT * q /**< [out] the estimates, with npix() pixels*/) const
+   {
+      if(m_count >= 5)
+      {
+         std::copy(m_q[2].begin(), m_q[2].end(), q);
+         return;
+      }
+
+      if(m_count == 0)
+      {
+         std::fill(q, q + m_npix, 0);
+         return;
+      }
+
+      size_t idx = std::min<size_t>(m_p * m_count, m_count - 1);
+      for(size_t k = 0; k < m_npix; ++k)
+      {
+         realT v[4];
+         for(size_t i = 0; i < m_count; ++i) v[i] = m_q[i][k];
+         std::sort(v, v + m_count);
+         q[k] = v[idx];
+      }
+   }
+};
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //photonCounter_pixelQuantiles_hpp
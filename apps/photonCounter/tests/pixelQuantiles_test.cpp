@@ -0,0 +1,188 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../pixelQuantiles.hpp"
+
+using namespace MagAOX::app;
+
+/// Simulated EMCCD frames: a bias and read noise which differ by pixel, plus photons with exponential gain
+struct emccdFrames
+{
+   size_t m_npix;
+   std::mt19937 m_gen;
+   std::normal_distribution<float> m_read {0, 1};
+   std::uniform_real_distribution<float> m_uni {0, 1};
+   std::exponential_distribution<float> m_gain {1.0/200};
+
+   explicit emccdFrames( size_t npix ) : m_npix(npix), m_gen(4242)
+   {
+   }
+
+   void next( std::vector<float> & im )
+   {
+      im.resize(m_npix);
+      for(size_t k = 0; k < m_npix; ++k)
+      {
+         float v = 100 + (k % 17) + (3 + (k % 5)) * m_read(m_gen);
+         if(m_uni(m_gen) < 0.05) v += m_gain(m_gen);
+         im[k] = std::round(v); //as read from a uint16 stream
+      }
+   }
+};
+
+/// Check the P-squared estimate against the order statistic used by the sorting calibration
+void checkQuantiles( float p,
+                     size_t nframes
+                   )
+{
+   size_t npix = 259;
+
+   emccdFrames gen(npix);
+   pixelQuantiles<float> pq;
+   pq.init(npix, p);
+
+   std::vector<std::vector<float>> series(npix, std::vector<float>(nframes));
+   std::vector<float> im;
+   for(size_t f = 0; f < nframes; ++f)
+   {
+      gen.next(im);
+      pq.add(im.data());
+      for(size_t k = 0; k < npix; ++k) series[k][f] = im[k];
+   }
+
+   REQUIRE( pq.count() == nframes );
+
+   std::vector<float> q(npix);
+   pq.quantile(q.data());
+
+   double maxErr = 0;
+   double meanErr = 0;
+   for(size_t k = 0; k < npix; ++k)
+   {
+      std::sort(series[k].begin(), series[k].end());
+      float exact = series[k][(size_t)(p * nframes)];
+      float sigma = 3 + (k % 5);
+      maxErr = std::max<double>(maxErr, std::fabs(q[k] - exact)/sigma);
+      meanErr += std::fabs(q[k] - exact)/sigma;
+   }
+   meanErr /= npix;
+
+   REQUIRE( meanErr < 0.1 );
+   REQUIRE( maxErr < 0.5 );
+}
+
+SCENARIO( "Streaming per-pixel quantiles", "[photonCounter]" )
+{
+   GIVEN("simulated EMCCD frames")
+   {
+      WHEN("estimating the median")
+      {
+         checkQuantiles(0.5, 4000);
+      }
+
+      WHEN("estimating a threshold in the tail of the read noise")
+      {
+         checkQuantiles(0.9, 4000);
+      }
+
+      WHEN("fewer than 5 frames were added")
+      {
+         pixelQuantiles<float> pq;
+         pq.init(2, 0.5);
+
+         std::vector<float> q(2);
+         pq.quantile(q.data());
+         REQUIRE( q[0] == 0 );
+
+         float f0[2] = {3, -1};
+         float f1[2] = {1, -2};
+         float f2[2] = {2, -3};
+         pq.add(f0);
+         pq.add(f1);
+         pq.add(f2);
+
+         pq.quantile(q.data());
+         REQUIRE( q[0] == 2 );
+         REQUIRE( q[1] == -2 );
+      }
+   }
+
+   GIVEN("5 values in every order")
+   {
+      WHEN("initializing the markers")
+      {
+         std::vector<int> v = {0, 1, 2, 3, 4};
+         std::vector<float> q[5];
+
+         do
+         {
+            for(int i = 0; i < 5; ++i) q[i].push_back(v[i]);
+         } while(std::next_permutation(v.begin(), v.end()));
+
+         size_t npix = q[0].size();
+         REQUIRE( npix == 120 );
+
+         p2Sort5(q[0].data(), q[1].data(), q[2].data(), q[3].data(), q[4].data(), npix);
+
+         size_t nbad = 0;
+         for(size_t k = 0; k < npix; ++k)
+         {
+            for(int i = 0; i < 5; ++i) if(q[i][k] != i) ++nbad;
+         }
+         REQUIRE( nbad == 0 );
+      }
+   }
+}
+
+SCENARIO( "Benchmarking calibration", "[.benchmark][photonCounter]" )
+{
+   GIVEN("512x512 frames")
+   {
+      WHEN("calibrating with 1000 frames")
+      {
+         size_t npix = 512*512;
+         size_t nframes = 1000;
+
+         emccdFrames gen(npix);
+         std::vector<std::vector<float>> frames(20);
+         for(auto & f : frames) gen.next(f);
+
+         pixelQuantiles<float> pq;
+         pq.init(npix, 0.9);
+
+         auto t0 = std::chrono::steady_clock::now();
+         for(size_t f = 0; f < nframes; ++f) pq.add(frames[f % frames.size()].data());
+         auto t1 = std::chrono::steady_clock::now();
+
+         //The sorting calibration, stored cube then a sort of each pixel
+         std::vector<float> cube(npix*nframes);
+         for(size_t f = 0; f < nframes; ++f) std::copy(frames[f % frames.size()].begin(), frames[f % frames.size()].end(), cube.begin() + f*npix);
+
+         auto t2 = std::chrono::steady_clock::now();
+         std::vector<float> thresh(npix);
+         for(size_t k = 0; k < npix; ++k)
+         {
+            std::vector<float> tmp;
+            for(size_t f = 0; f < nframes; ++f) tmp.push_back(cube[f*npix + k]);
+            std::sort(tmp.begin(), tmp.end());
+            thresh[k] = tmp[(size_t)(0.9*nframes)];
+         }
+         auto t3 = std::chrono::steady_clock::now();
+
+         double tpf = std::chrono::duration<double>(t1-t0).count()/nframes;
+         double tsort = std::chrono::duration<double>(t3-t2).count();
+
+         std::cout << "P2: " << tpf*1e6 << " usec per frame, " << 32*npix/1048576.0 << " MB\n";
+         std::cout << "sort: " << tsort << " sec at the end, " << 4.0*npix*nframes/1048576.0 << " MB\n";
+
+         REQUIRE( thresh[0] > 0 );
+      }
+   }
+}
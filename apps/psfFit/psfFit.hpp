@@ -50,7 +50,7 @@ struct darkShmimT
   * \ingroup psfFit
   */
 class psfFit : public MagAOXApp<true>, public dev::shmimMonitor<psfFit>, public dev::shmimMonitor<psfFit,darkShmimT>, 
-                                      public dev::frameGrabber<psfFit>, public dev::telemeter<psfFit>
+                                      public dev::frameGrabber<psfFit>, public dev::streamProcessor<psfFit>, public dev::telemeter<psfFit>
 {
    //Give the test harness access.
    friend class psfFit_test;
@@ -58,6 +58,7 @@ class psfFit : public MagAOXApp<true>, public dev::shmimMonitor<psfFit>, public
    friend class dev::shmimMonitor<psfFit>;
    friend class dev::shmimMonitor<psfFit,darkShmimT>;
    friend class dev::frameGrabber<psfFit>;
+   friend class dev::streamProcessor<psfFit>;
 
    friend class dev::telemeter<psfFit>;
 
@@ -70,6 +71,9 @@ public:
    //The base frameGrabber type
    typedef dev::frameGrabber<psfFit> frameGrabberT;
 
+   //The base streamProcessor type
+   typedef dev::streamProcessor<psfFit> streamProcessorT;
+
    //The base telemeter type
    typedef dev::telemeter<psfFit> telemeterT;
 
@@ -103,7 +107,6 @@ protected:
 
     mx::improc::eigenImage<float> m_dark;
    
-    bool m_updated {false};
     float m_x {0};
     float m_y {0};
 
@@ -179,8 +182,6 @@ protected:
 
    std::mutex m_imageMutex;
 
-   sem_t m_smSemaphore {0}; ///< Semaphore used to synchronize the fg thread and the sm thread.
-
 public:
 
    /** \name dev::frameGrabber interface
@@ -211,13 +212,6 @@ public:
      */
    int startAcquisition();
    
-   /// Implementation of the framegrabber acquireAndCheckValid interface
-   /** 
-     * \returns 0 on success
-     * \returns -1 on error
-     */
-   int acquireAndCheckValid();
-   
    /// Implementation of the framegrabber loadImageIntoStream interface
    /** 
      * \returns 0 on success
@@ -283,6 +277,7 @@ void psfFit::setupConfig()
    shmimMonitorT::setupConfig(config);
    darkShmimMonitorT::setupConfig(config);
    frameGrabberT::setupConfig(config);
+   streamProcessorT::setupConfig(config);
    telemeterT::setupConfig(config);
    
    config.add("fitter.fpsSource", "", "fitter.fpsSource", argType::Required, "fitter", "fpsSource", false, "string", "Device name for getting fps if time-based averaging is used.  This device should have *.fps.current.");
@@ -297,6 +292,7 @@ int psfFit::loadConfigImpl( mx::app::appConfigurator & _config )
    darkShmimMonitorT::loadConfig(_config);
 
    frameGrabberT::loadConfig(_config);
+   streamProcessorT::loadConfig(_config);
    telemeterT::loadConfig(_config);
 
     _config(m_fpsSource, "fitter.fpsSource");
@@ -315,6 +311,11 @@ void psfFit::loadConfig()
 inline
 int psfFit::appStartup()
 {
+   if(streamProcessorT::appStartup() < 0)
+   {
+      return log<software_error,-1>({__FILE__, __LINE__});
+   }
+
    if(shmimMonitorT::appStartup() < 0)
    {
       return log<software_error,-1>({__FILE__, __LINE__});
@@ -325,12 +326,6 @@ int psfFit::appStartup()
       return log<software_error,-1>({__FILE__, __LINE__});
    }
 
-   if(sem_init(&m_smSemaphore, 0,0) < 0)
-   {
-      log<software_critical>({__FILE__, __LINE__, errno,0, "Initializing S.M. semaphore"});
-      return -1;
-   }
-
    if(frameGrabberT::appStartup() < 0)
    {
       return log<software_error,-1>({__FILE__, __LINE__});
@@ -475,7 +470,6 @@ int psfFit::allocate(const dev::shmimT & dummy)
         m_ycb.maxEntries(cbSz);
     }
 
-   m_updated = false;
    return 0;
 }
    
@@ -535,13 +529,10 @@ int psfFit::processImage( void* curr_src,
 */
 
 
-    m_updated = true;
-
     //signal framegrabber
     //Now tell the f.g. to get going
-    if(sem_post(&m_smSemaphore) < 0)
+    if(streamProcessorT::postImage() < 0)
     {
-        log<software_critical>({__FILE__, __LINE__, errno, 0, "Error posting to semaphore"});
         return -1;
     }
          
@@ -611,47 +602,12 @@ int psfFit::startAcquisition()
    return 0;
 }
 
-inline
-int psfFit::acquireAndCheckValid()
-{
-   timespec ts;
-         
-   if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
-   {
-      log<software_critical>({__FILE__,__LINE__,errno, 0, "clock_gettime"}); 
-      return -1;
-   }
-         
-   ts.tv_sec += 1;
-        
-   if(sem_timedwait(&m_smSemaphore, &ts) == 0)
-   {
-      if( m_updated )
-      {
-         clock_gettime(CLOCK_REALTIME, &m_currImageTimestamp);
-         return 0;
-      }
-      else
-      {
-         return 1;
-      }
-   }
-   else
-   {
-      return 1;
-   }
-
-
-}
-
 inline
 int psfFit::loadImageIntoStream(void * dest)
 {
    ((float *) dest)[0] = m_x - m_dx;
    ((float *) dest)[1] = m_y - m_dy;
 
-   m_updated = false;
-
    return 0;
 }
 
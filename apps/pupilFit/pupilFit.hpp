@@ -51,7 +51,8 @@ struct refShmimT
 /** 
   * \ingroup pupilFit
   */
-class pupilFit : public MagAOXApp<true>, public dev::shmimMonitor<pupilFit>, public dev::shmimMonitor<pupilFit,refShmimT>, public dev::frameGrabber<pupilFit>, public dev::telemeter<pupilFit>
+class pupilFit : public MagAOXApp<true>, public dev::shmimMonitor<pupilFit>, public dev::shmimMonitor<pupilFit,refShmimT>, public dev::frameGrabber<pupilFit>,
+                                        public dev::streamProcessor<pupilFit>, public dev::telemeter<pupilFit>
 {
    //Give the test harness access.
    friend class pupilFit_test;
@@ -59,6 +60,7 @@ class pupilFit : public MagAOXApp<true>, public dev::shmimMonitor<pupilFit>, pub
    friend class dev::shmimMonitor<pupilFit>;
    friend class dev::shmimMonitor<pupilFit,refShmimT>;
    friend class dev::frameGrabber<pupilFit>;
+   friend class dev::streamProcessor<pupilFit>;
 
    friend class dev::telemeter<pupilFit>;
 
@@ -71,6 +73,9 @@ public:
    //The base frameGrabber type
    typedef dev::frameGrabber<pupilFit> frameGrabberT;
 
+   //The base streamProcessor type
+   typedef dev::streamProcessor<pupilFit> streamProcessorT;
+
    //The base telemeter type
    typedef dev::telemeter<pupilFit> telemeterT;
 
@@ -338,12 +343,6 @@ public:
                      const refShmimT &
                    );
 
-protected:
-
-   bool m_updated {false}; //tells the f.g. that there is an actual image, not just a sem timeout
-
-   sem_t m_smSemaphore {0}; ///< Semaphore used to synchronize the fg thread and the sm thread.
-
 public:
 
    /** \name dev::frameGrabber interface
@@ -374,13 +373,6 @@ public:
      */
    int startAcquisition();
    
-   /// Implementation of the framegrabber acquireAndCheckValid interface
-   /** 
-     * \returns 0 on success
-     * \returns -1 on error
-     */
-   int acquireAndCheckValid();
-   
    /// Implementation of the framegrabber loadImageIntoStream interface
    /** 
      * \returns 0 on success
@@ -468,6 +460,7 @@ void pupilFit::setupConfig()
    shmimMonitorT::setupConfig(config);
    refShmimMonitorT::setupConfig(config);
    frameGrabberT::setupConfig(config);
+   streamProcessorT::setupConfig(config);
    telemeterT::setupConfig(config);
 
    config.add("shmimMonitor.shmimName", "", "shmimMonitor.shmimName", argType::Required, "shmimMonitor", "shmimName", false, "string", "The name of the ImageStreamIO shared memory image. Will be used as /tmp/<shmimName>.im.shm. Default is camwfs_avg");
@@ -506,6 +499,7 @@ int pupilFit::loadConfigImpl( mx::app::appConfigurator & _config )
    if(refShmimMonitorT::m_shmimName != "") m_setPointSource = USEREFIM;
 
    frameGrabberT::loadConfig(_config);
+   streamProcessorT::loadConfig(_config);
    telemeterT::loadConfig(_config);
 
    _config(m_threshold, "fit.threshold");
@@ -543,6 +537,11 @@ void pupilFit::loadConfig()
 inline
 int pupilFit::appStartup()
 {
+   if(streamProcessorT::appStartup() < 0)
+   {
+      return log<software_error,-1>({__FILE__, __LINE__});
+   }
+
    if(shmimMonitorT::appStartup() < 0)
    {
       return log<software_error,-1>({__FILE__, __LINE__});
@@ -553,12 +552,6 @@ int pupilFit::appStartup()
       return log<software_error,-1>({__FILE__, __LINE__});
    }
 
-   if(sem_init(&m_smSemaphore, 0,0) < 0)
-   {
-      log<software_critical>({__FILE__, __LINE__, errno,0, "Initializing S.M. semaphore"});
-      return -1;
-   }
-
    if(frameGrabberT::appStartup() < 0)
    {
       return log<software_error,-1>({__FILE__, __LINE__});
@@ -1017,10 +1010,8 @@ int pupilFit::processImage( void* curr_src,
    
    //signal framegrabber
 //Now tell the f.g. to get going
-   m_updated = true;
-   if(sem_post(&m_smSemaphore) < 0)
+   if(streamProcessorT::postImage() < 0)
    {
-      log<software_critical>({__FILE__, __LINE__, errno, 0, "Error posting to semaphore"});
       return -1;
    }
          
@@ -1316,44 +1307,12 @@ int pupilFit::startAcquisition()
    return 0;
 }
 
-inline
-int pupilFit::acquireAndCheckValid()
-{
-   timespec ts;
-         
-   if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
-   {
-      log<software_critical>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
-      return -1;
-   }
-         
-   ts.tv_sec += 1;
-        
-   if(sem_timedwait(&m_smSemaphore, &ts) == 0)
-   {
-      if( m_updated )
-      {
-         clock_gettime(CLOCK_REALTIME, &m_currImageTimestamp);
-         return 0;
-      }
-      else
-      {
-         return 1;
-      }
-   }
-   else
-   {
-      return 1;
-   }
-}
-
 inline
 int pupilFit::loadImageIntoStream(void * dest)
 {
    ((float *) dest)[0] = m_avg_dx;
    ((float *) dest)[1] = m_avg_dy;
 
-   m_updated = false;
    return 0;
 }
 
@@ -16,6 +16,10 @@ using namespace mx::improc;
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "../../libMagAOX/utils/workerPool.hpp"
+
+#include "slopeKernels.hpp"
+
 namespace MagAOX
 {
 namespace app
@@ -53,7 +57,8 @@ struct darkShmimT
   * \ingroup pwfsSlopeCalc
   * 
   */
-class pwfsSlopeCalc : public MagAOXApp<true>, public dev::shmimMonitor<pwfsSlopeCalc>, public dev::shmimMonitor<pwfsSlopeCalc,darkShmimT>, public dev::frameGrabber<pwfsSlopeCalc>, public dev::telemeter<pwfsSlopeCalc>
+class pwfsSlopeCalc : public MagAOXApp<true>, public dev::shmimMonitor<pwfsSlopeCalc>, public dev::shmimMonitor<pwfsSlopeCalc,darkShmimT>, public dev::frameGrabber<pwfsSlopeCalc>,
+                                      public dev::streamProcessor<pwfsSlopeCalc>, public dev::telemeter<pwfsSlopeCalc>
 {
 
    //Give the test harness access.
@@ -62,6 +67,7 @@ class pwfsSlopeCalc : public MagAOXApp<true>, public dev::shmimMonitor<pwfsSlope
    friend class dev::shmimMonitor<pwfsSlopeCalc>;
    friend class dev::shmimMonitor<pwfsSlopeCalc,darkShmimT>;
    friend class dev::frameGrabber<pwfsSlopeCalc>;
+   friend class dev::streamProcessor<pwfsSlopeCalc>;
    friend class dev::telemeter<pwfsSlopeCalc>;
    
    //The base shmimMonitor type
@@ -73,6 +79,9 @@ class pwfsSlopeCalc : public MagAOXApp<true>, public dev::shmimMonitor<pwfsSlope
    //The base frameGrabber type
    typedef dev::frameGrabber<pwfsSlopeCalc> frameGrabberT;
    
+   //The base streamProcessor type
+   typedef dev::streamProcessor<pwfsSlopeCalc> streamProcessorT;
+   
    //The base telemeter type
    typedef dev::telemeter<pwfsSlopeCalc> telemeterT;
 
@@ -109,11 +118,13 @@ protected:
    int m_pupil_D {56}; ///< the pupil diameter, just one applied to all pupils.
    
    int m_pupil_buffer {1}; ///< the edge buffer for the pupils, just one applied to all pupils.  Default is 1.
+
+   std::string m_normalization {"frame"}; ///< How the slopes are normalized, "frame" by the mean intensity of the frame or "pixel" by the intensity of each pixel.  Default is "frame".
+
+   int m_threads {1}; ///< The number of threads calculating slopes, including the frame grabber thread.  Default is 1.
    
    ///@}
 
-   sem_t m_smSemaphore; ///< Semaphore used to synchronize the fg thread and the sm thread.
-   
    realT (*pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
    
    void * m_curr_src {nullptr};
@@ -121,7 +132,7 @@ protected:
    int m_quadSize {60};
    
    mx::improc::eigenImage<realT> m_darkImage;
-   realT (*dark_pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+   pixKernels<realT> dark_pixkern; ///< The kernels to extract the dark data as our desired type realT.
    bool m_darkSet {false};
    
    int m_pupil_sx_1; ///< the starting x-coordinate of pupil 1 quadrant, calculated from the pupil center, diameter, and buffer.
@@ -135,6 +146,18 @@ protected:
    
    int m_pupil_sx_4; ///< the starting x-coordinate of pupil 4 quadrant, calculated from the pupil center, diameter, and buffer.
    int m_pupil_sy_4; ///< the starting y-coordinate of pupil 4 quadrant, calculated from the pupil center, diameter, and buffer.
+
+   bool m_perPixel {false}; ///< Whether the slopes are normalized by pixel, set from m_normalization.
+
+   size_t m_pupilOffset[4] {0,0,0,0}; ///< The linear position in the image of the start of each pupil quadrant, calculated from the starting coordinates.
+
+   slopeColumnT<realT> m_slopeColumn {nullptr}; ///< The slope kernel for the image data type, number of pupils, and normalization.
+
+   std::vector<realT> m_zeroDark; ///< A dark of zeros, used if the dark is not the size of the image.
+
+   std::vector<realT> m_acc; ///< The total intensity of each row of the quadrants, for each thread.
+
+   utils::workerPool m_pool; ///< The threads, each calculating a range of columns.
    
 public:
    /// Default c'tor.
@@ -210,13 +233,6 @@ protected:
      */
    int startAcquisition();
    
-   /// Implementation of the framegrabber acquireAndCheckValid interface
-   /** 
-     * \returns 0 on success
-     * \returns -1 on error
-     */
-   int acquireAndCheckValid();
-   
    /// Implementation of the framegrabber loadImageIntoStream interface
    /** 
      * \returns 0 on success
@@ -270,6 +286,7 @@ void pwfsSlopeCalc::setupConfig()
    darkMonitorT::setupConfig(config);
    
    frameGrabberT::setupConfig(config);
+   streamProcessorT::setupConfig(config);
    telemeterT::setupConfig(config);
 
    config.add("pupil.fitter", "", "pupil.fitter", argType::Required, "pupil", "fitter", false, "int", "The device name of the pupil fitter.  If set, then pupil position is set by the fitter reference.");
@@ -279,6 +296,10 @@ void pwfsSlopeCalc::setupConfig()
    config.add("pupil.buffer", "", "pupil.buffer", argType::Required, "pupil", "buffer", false, "int", "The edge buffer for the pupils.  Default is 1.");
    
    config.add("pupil.numPupils", "", "pupil.numPupils", argType::Required, "pupil", "numPupils", false, "int", "The number of pupils.  Default is 4.  3 is also supported.");
+
+   config.add("slopes.normalization", "", "slopes.normalization", argType::Required, "slopes", "normalization", false, "string", "How to normalize the slopes: 'frame' by the mean intensity of the frame, or 'pixel' by the intensity of each pixel.  Default is 'frame'.");
+
+   config.add("slopes.threads", "", "slopes.threads", argType::Required, "slopes", "threads", false, "int", "The number of threads calculating slopes, including the frame grabber thread.  Default is 1.  More can help with large cameras.");
    
    
    
@@ -302,6 +323,7 @@ int pwfsSlopeCalc::loadConfigImpl( mx::app::appConfigurator & _config )
    shmimMonitorT::loadConfig(_config);
    darkMonitorT::loadConfig(_config);
    frameGrabberT::loadConfig(_config);
+   streamProcessorT::loadConfig(_config);
    telemeterT::loadConfig(_config);
 
    config(m_fitter, "pupil.fitter");
@@ -316,6 +338,26 @@ int pwfsSlopeCalc::loadConfigImpl( mx::app::appConfigurator & _config )
    config(m_pupil_cy_3, "pupil.cy_3");
    config(m_pupil_cx_4, "pupil.cx_4");
    config(m_pupil_cy_4, "pupil.cy_4");
+
+   config(m_normalization, "slopes.normalization");
+   if(m_normalization == "pixel")
+   {
+      m_perPixel = true;
+   }
+   else if(m_normalization == "frame")
+   {
+      m_perPixel = false;
+   }
+   else
+   {
+      log<text_log>("unknown slopes.normalization " + m_normalization + ", using frame", logPrio::LOG_WARNING);
+      m_normalization = "frame";
+      m_perPixel = false;
+   }
+
+   config(m_threads, "slopes.threads");
+   if(m_threads < 1) m_threads = 1;
+
    return 0;
 }
 
@@ -328,10 +370,9 @@ void pwfsSlopeCalc::loadConfig()
 inline
 int pwfsSlopeCalc::appStartup()
 {
-   if(sem_init(&m_smSemaphore, 0,0) < 0)
+   if(streamProcessorT::appStartup() < 0)
    {
-      log<software_critical>({__FILE__, __LINE__, errno,0, "Initializing S.M. semaphore"});
-      return -1;
+      return log<software_error,-1>({__FILE__, __LINE__});
    }
    
    if(shmimMonitorT::appStartup() < 0)
@@ -459,13 +500,7 @@ int pwfsSlopeCalc::processImage( void * curr_src,
    m_curr_src = curr_src;
 
    //Now tell the f.g. to get going
-   if(sem_post(&m_smSemaphore) < 0)
-   {
-      log<software_critical>({__FILE__, __LINE__, errno, 0, "Error posting to semaphore"});
-       return -1;
-   }
-
-   return 0;
+   return streamProcessorT::postImage();
 }
 
 inline
@@ -481,9 +516,9 @@ int pwfsSlopeCalc::allocate(const darkShmimT & dummy)
 //    }
    
    m_darkImage.resize(darkMonitorT::m_width, darkMonitorT::m_height);
-   dark_pixget = getPixPointer<realT>(darkMonitorT::m_dataType);
+   dark_pixkern = getPixKernels<realT>(darkMonitorT::m_dataType);
    
-   if(dark_pixget == nullptr)
+   if(dark_pixkern.convert == nullptr)
    {
       log<software_error>({__FILE__, __LINE__, "bad data type"});
       return -1;
@@ -501,11 +536,7 @@ int pwfsSlopeCalc::processImage( void * curr_src,
    
    realT * data = m_darkImage.data();
    
-   for(unsigned nn=0; nn < darkMonitorT::m_width*darkMonitorT::m_height; ++nn)
-   {
-      //data[nn] = *( (int16_t * ) (curr_src + nn*shmimMonitorT::m_typeSize));
-      data[nn] = dark_pixget(curr_src, nn);
-   }
+   dark_pixkern.convert(data, curr_src, darkMonitorT::m_width*darkMonitorT::m_height);
    
    m_darkSet = true;
    
@@ -537,7 +568,44 @@ int pwfsSlopeCalc::configureAcquisition()
    
    m_pupil_sx_4 = m_pupil_cx_4 - 0.5*m_quadSize;
    m_pupil_sy_4 = m_pupil_cy_4 - 0.5*m_quadSize;
-   
+
+   if(m_numPupils != 3 && m_numPupils != 4)
+   {
+      log<software_error>({__FILE__, __LINE__, "unsupported number of pupils: " + std::to_string(m_numPupils)});
+      return -1;
+   }
+
+   //Make the pupil index table, checking that each quadrant is in the image
+   int sx[4] = {m_pupil_sx_1, m_pupil_sx_2, m_pupil_sx_3, m_pupil_sx_4};
+   int sy[4] = {m_pupil_sy_1, m_pupil_sy_2, m_pupil_sy_3, m_pupil_sy_4};
+
+   for(int p = 0; p < m_numPupils; ++p)
+   {
+      if(sx[p] < 0 || sy[p] < 0 || sx[p] + m_quadSize > (int) shmimMonitorT::m_width || sy[p] + m_quadSize > (int) shmimMonitorT::m_height)
+      {
+         log<software_error>({__FILE__, __LINE__, "pupil " + std::to_string(p+1) + " quadrant is outside the image"});
+         sleep(1);
+         return -1;
+      }
+
+      m_pupilOffset[p] = sx[p] + sy[p]*shmimMonitorT::m_width;
+   }
+
+   m_slopeColumn = getSlopeColumn<realT>(shmimMonitorT::m_dataType, m_numPupils, m_perPixel);
+   if(m_slopeColumn == nullptr)
+   {
+      log<software_error>({__FILE__, __LINE__, "bad data type"});
+      return -1;
+   }
+
+   m_zeroDark.assign(shmimMonitorT::m_width*shmimMonitorT::m_height, 0);
+
+   //Each thread does a range of columns
+   size_t nParts = std::min(m_threads, m_quadSize);
+   if(m_pool.nParts() != nParts) m_pool.start(nParts);
+
+   m_acc.resize(nParts*m_quadSize);
+
    //m_quadSize = shmimMonitorT::m_width/2;
    frameGrabberT::m_width = m_quadSize;
    frameGrabberT::m_height = 2*m_quadSize;
@@ -552,89 +620,58 @@ int pwfsSlopeCalc::startAcquisition()
    return 0;
 }
 
-inline
-int pwfsSlopeCalc::acquireAndCheckValid()
-{
-   timespec ts;
-         
-   if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
-   {
-      log<software_critical>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
-      return -1;
-   }
-         
-   ts.tv_sec += 1;
-        
-   if(sem_timedwait(&m_smSemaphore, &ts) == 0)
-   {
-      clock_gettime(CLOCK_REALTIME, &m_currImageTimestamp);
-      return 0;
-   }
-   else
-   {
-      return 1;
-   }
-}
-
 inline
 int pwfsSlopeCalc::loadImageIntoStream(void * dest)
 {
    //Here is where we do it.
-   Eigen::Map<eigenImage<unsigned short>> pwfsIm( static_cast<unsigned short *>(m_curr_src), shmimMonitorT::m_width, shmimMonitorT::m_height );
-   Eigen::Map<eigenImage<float>> slopesIm(static_cast<float*>(dest), frameGrabberT::m_width, frameGrabberT::m_height );
-   
-   static float sqrt32 = sqrt(3.0)/2;
-   
-   float norm = 0;
-   int N = 0;
-   if(m_numPupils == 3)
-   {
-      for(int rr=0; rr< m_quadSize; ++rr)
-      {
-         for(int cc=0; cc< m_quadSize; ++cc)
-         {
-            float I2 = pwfsIm(rr+m_pupil_sx_1,cc+m_pupil_sy_1) - m_darkImage(rr+m_pupil_sx_1,cc+m_pupil_sy_1);
-            float I3 = pwfsIm(rr+m_pupil_sx_2,cc+m_pupil_sy_2) - m_darkImage(rr+m_pupil_sx_2,cc+m_pupil_sy_2);
-            float I1 = pwfsIm(rr+m_pupil_sx_3,cc+m_pupil_sy_3) - m_darkImage(rr+m_pupil_sx_3,cc+m_pupil_sy_3);
-           
-            norm += I1+I2+I3;
-            ++N;
-            
-            slopesIm(rr,cc) = sqrt32*(I2-I3);///norm;
-            slopesIm(rr,cc+m_quadSize) = (I1-0.5*(I2+I3));///norm;
-         }
-      }
-   }
-   else
+   realT * slopes = static_cast<realT *>(dest);
+
+   size_t width = shmimMonitorT::m_width;
+   size_t typeSize = shmimMonitorT::m_typeSize;
+   size_t quadSize = m_quadSize;
+
+   //Use the dark only if it matches the image
+   const realT * dark = m_zeroDark.data();
+   if(m_darkImage.rows() == (int) width && m_darkImage.cols() == (int) shmimMonitorT::m_height) dark = m_darkImage.data();
+
+   const char * src = static_cast<const char *>(m_curr_src);
+
+   size_t nParts = m_pool.nParts();
+
+   m_pool.run( [&](size_t part)
    {
-   
-      for(int rr=0; rr< m_quadSize; ++rr)
+      size_t c0 = (part*quadSize)/nParts;
+      size_t c1 = ((part+1)*quadSize)/nParts;
+
+      realT * acc = m_acc.data() + part*quadSize;
+      for(size_t rr = 0; rr < quadSize; ++rr) acc[rr] = 0;
+
+      const void * psrc[4];
+      const realT * pdark[4];
+
+      //Columns are contiguous, so each pupil is read a column at a time
+      for(size_t cc = c0; cc < c1; ++cc)
       {
-         for(int cc=0; cc< m_quadSize; ++cc)
+         for(int p = 0; p < m_numPupils; ++p)
          {
-            float I1 = pwfsIm(rr+m_pupil_sx_1,cc+m_pupil_sy_1) - m_darkImage(rr+m_pupil_sx_1,cc+m_pupil_sy_1);
-            float I2 = pwfsIm(rr+m_pupil_sx_2,cc+m_pupil_sy_2) - m_darkImage(rr+m_pupil_sx_2,cc+m_pupil_sy_2);
-            float I3 = pwfsIm(rr+m_pupil_sx_3,cc+m_pupil_sy_3) - m_darkImage(rr+m_pupil_sx_3,cc+m_pupil_sy_3);
-            float I4 = pwfsIm(rr+m_pupil_sx_4,cc+m_pupil_sy_4) - m_darkImage(rr+m_pupil_sx_4,cc+m_pupil_sy_4);
-         
-            norm += I1+I2+I3+I4;
-            ++N;
-            
-            slopesIm(rr,cc) = ((I1+I3) - (I2+I4));///norm;
-            slopesIm(rr,cc+m_quadSize) = ((I1+I2)-(I3+I4));///norm;
+            size_t off = m_pupilOffset[p] + cc*width;
+            psrc[p] = src + off*typeSize;
+            pdark[p] = dark + off;
          }
+
+         m_slopeColumn(slopes + cc*quadSize, slopes + (cc+quadSize)*quadSize, acc, psrc, pdark, quadSize);
       }
-   }
-    
-   norm /= N;
-   for(size_t ii=0; ii< frameGrabberT::m_height; ++ii)
-   {
-      for(size_t jj=0; jj < frameGrabberT::m_width; ++jj)
-      {
-         slopesIm(jj,ii)/=norm;
-      }
-   }
-   
+   });
+
+   if(m_perPixel) return 0;
+
+   //Normalize by the mean intensity of the frame
+   double norm = 0;
+   for(size_t n = 0; n < m_acc.size(); ++n) norm += m_acc[n];
+   norm /= quadSize*quadSize;
+
+   slopeScale<realT>(slopes, (norm != 0) ? 1.0/norm : 0, 2*quadSize*quadSize);
+
    return 0;
 }
 
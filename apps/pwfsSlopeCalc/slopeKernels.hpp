@@ -0,0 +1,196 @@
+/** \file slopeKernels.hpp
+  * \brief Kernels to calculate slopes from PWFS images of any data type
+  *
+  * \ingroup pwfsSlopeCalc_files
+  */
+
+#ifndef pwfsSlopeCalc_slopeKernels_hpp
+#define pwfsSlopeCalc_slopeKernels_hpp
+
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+#include "../../libMagAOX/ImageStreamIO/pixaccess.hpp"
+
+namespace MagAOX
+{
+namespace app
+{
+
+/// Calculate the slopes of one column of the pupil quadrants
+/** Each pupil is read, and dark subtracted, at the same position in its quadrant.  With 4 pupils the slopes are
+  * \f$ s_x = (I_1 + I_3) - (I_2 + I_4) \f$ and \f$ s_y = (I_1 + I_2) - (I_3 + I_4) \f$.  With 3 pupils they are
+  * \f$ s_x = \frac{\sqrt{3}}{2} (I_2 - I_3) \f$ and \f$ s_y = I_1 - \frac{1}{2}(I_2 + I_3) \f$, where pupil 1 of
+  * the geometry is \f$ I_2 \f$, pupil 2 is \f$ I_3 \f$, and pupil 3 is \f$ I_1 \f$.
+  *
+  * If perPixel is true each slope is divided by the total intensity of its pixel, or is 0 if that is not positive.
+  * Otherwise the total intensity of each pixel is added to acc, for normalizing by the whole frame afterwards.
+  *
+  * This is a plain loop over the column, which the compiler vectorizes and clones for each SIMD instruction set.
+  *
+  * \tparam realT the type of the slopes
+  * \tparam dataT the type of the image data
+  * \tparam nPupils the number of pupils, 3 or 4
+  * \tparam perPixel whether to normalize by pixel
+  */
+template<typename realT, typename dataT, int nPupils, bool perPixel>
+PIXACCESS_TARGET_CLONES
+void slopeColumn( realT * __restrict__ sx,         ///< [out] the x slopes of the column
+                  realT * __restrict__ sy,         ///< [out] the y slopes of the column
+                  realT * __restrict__ acc,        ///< [in/out] the total intensity of each pixel is added to this, if not perPixel
+                  const void * const * src,        ///< [in] the start of the column in each pupil, of type dataT
+                  const realT * const * dark,      ///< [in] the start of the column in the dark for each pupil
+                  size_t n                         ///< [in] the length of the column
+                )
+{
+   static_assert(nPupils == 3 || nPupils == 4, "slopeColumn: only 3 or 4 pupils are supported");
+
+   const dataT * __restrict__ s1 = static_cast<const dataT *>(src[0]);
+   const dataT * __restrict__ s2 = static_cast<const dataT *>(src[1]);
+   const dataT * __restrict__ s3 = static_cast<const dataT *>(src[2]);
+   const realT * __restrict__ d1 = dark[0];
+   const realT * __restrict__ d2 = dark[1];
+   const realT * __restrict__ d3 = dark[2];
+
+   if constexpr(nPupils == 3)
+   {
+      const realT sqrt32 = std::sqrt(3.0)/2;
+
+      for(size_t i = 0; i < n; ++i)
+      {
+         realT I2 = s1[i] - d1[i];
+         realT I3 = s2[i] - d2[i];
+         realT I1 = s3[i] - d3[i];
+
+         realT x = sqrt32*(I2-I3);
+         realT y = I1 - static_cast<realT>(0.5)*(I2+I3);
+         realT tot = I1 + I2 + I3;
+
+         if constexpr(perPixel)
+         {
+            realT nrm = (tot > 0) ? 1/tot : 0;
+            sx[i] = x*nrm;
+            sy[i] = y*nrm;
+         }
+         else
+         {
+            sx[i] = x;
+            sy[i] = y;
+            acc[i] += tot;
+         }
+      }
+   }
+   else
+   {
+      const dataT * __restrict__ s4 = static_cast<const dataT *>(src[3]);
+      const realT * __restrict__ d4 = dark[3];
+
+      for(size_t i = 0; i < n; ++i)
+      {
+         realT I1 = s1[i] - d1[i];
+         realT I2 = s2[i] - d2[i];
+         realT I3 = s3[i] - d3[i];
+         realT I4 = s4[i] - d4[i];
+
+         realT x = (I1+I3) - (I2+I4);
+         realT y = (I1+I2) - (I3+I4);
+         realT tot = I1 + I2 + I3 + I4;
+
+         if constexpr(perPixel)
+         {
+            realT nrm = (tot > 0) ? 1/tot : 0;
+            sx[i] = x*nrm;
+            sy[i] = y*nrm;
+         }
+         else
+         {
+            sx[i] = x;
+            sy[i] = y;
+            acc[i] += tot;
+         }
+      }
+   }
+}
+
+/// Scale slopes in place: s *= scale
+template<typename realT>
+PIXACCESS_TARGET_CLONES
+void slopeScale( realT * __restrict__ s, ///< [in/out] the slopes
+                 realT scale,            ///< [in] the scale factor
+                 size_t n                ///< [in] the number of slopes
+               )
+{
+   for(size_t i = 0; i < n; ++i) s[i] *= scale;
+}
+
+/// Pointer to a slopeColumn instantiation
+template<typename realT>
+using slopeColumnT = void (*)(realT *, realT *, realT *, const void * const *, const realT * const *, size_t);
+
+/// Get the slopeColumn kernel for a data type
+template<typename realT, int imageStructDataT>
+slopeColumnT<realT> getSlopeColumn( int nPupils, ///< [in] the number of pupils, 3 or 4
+                                    bool perPixel ///< [in] whether to normalize by pixel
+                                  )
+{
+   typedef typename imageStructDataType<imageStructDataT>::type dataT;
+
+   if(nPupils == 3)
+   {
+      if(perPixel) return &slopeColumn<realT, dataT, 3, true>;
+      else return &slopeColumn<realT, dataT, 3, false>;
+   }
+   else if(nPupils == 4)
+   {
+      if(perPixel) return &slopeColumn<realT, dataT, 4, true>;
+      else return &slopeColumn<realT, dataT, 4, false>;
+   }
+
+   std::cerr << "getSlopeColumn: unsupported number of pupils: " << nPupils << " " << __FILE__ << " " << __LINE__ << "\n";
+   return nullptr;
+}
+
+/// Get the slopeColumn kernel for a data type
+/**
+  * \returns the kernel
+  * \returns nullptr if the type or the number of pupils is not supported
+  */
+template<typename realT>
+slopeColumnT<realT> getSlopeColumn( int imageStructDataT, ///< [in] the ImageStreamIO data type
+                                    int nPupils,          ///< [in] the number of pupils, 3 or 4
+                                    bool perPixel         ///< [in] whether to normalize by pixel
+                                  )
+{
+   switch(imageStructDataT)
+   {
+      case IMAGESTRUCT_UINT8:
+         return getSlopeColumn<realT, IMAGESTRUCT_UINT8>(nPupils, perPixel);
+      case IMAGESTRUCT_INT8:
+         return getSlopeColumn<realT, IMAGESTRUCT_INT8>(nPupils, perPixel);
+      case IMAGESTRUCT_UINT16:
+         return getSlopeColumn<realT, IMAGESTRUCT_UINT16>(nPupils, perPixel);
+      case IMAGESTRUCT_INT16:
+         return getSlopeColumn<realT, IMAGESTRUCT_INT16>(nPupils, perPixel);
+      case IMAGESTRUCT_UINT32:
+         return getSlopeColumn<realT, IMAGESTRUCT_UINT32>(nPupils, perPixel);
+      case IMAGESTRUCT_INT32:
+         return getSlopeColumn<realT, IMAGESTRUCT_INT32>(nPupils, perPixel);
+      case IMAGESTRUCT_UINT64:
+         return getSlopeColumn<realT, IMAGESTRUCT_UINT64>(nPupils, perPixel);
+      case IMAGESTRUCT_INT64:
+         return getSlopeColumn<realT, IMAGESTRUCT_INT64>(nPupils, perPixel);
+      case IMAGESTRUCT_FLOAT:
+         return getSlopeColumn<realT, IMAGESTRUCT_FLOAT>(nPupils, perPixel);
+      case IMAGESTRUCT_DOUBLE:
+         return getSlopeColumn<realT, IMAGESTRUCT_DOUBLE>(nPupils, perPixel);
+      default:
+         std::cerr << "getSlopeColumn: Unknown or unsupported data type. " << __FILE__ << " " << __LINE__ << "\n";
+         return nullptr;
+   }
+}
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //pwfsSlopeCalc_slopeKernels_hpp
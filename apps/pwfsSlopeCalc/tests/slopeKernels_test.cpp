@@ -0,0 +1,123 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../slopeKernels.hpp"
+
+using namespace MagAOX::app;
+
+/// Check the kernel for a data type against the slopes calculated directly
+template<typename dataT, int imageStructDataT>
+void checkSlopes( int nPupils,
+                  bool perPixel
+                )
+{
+   size_t n = 37;
+
+   std::vector<std::vector<dataT>> im(nPupils, std::vector<dataT>(n));
+   std::vector<std::vector<float>> dk(nPupils, std::vector<float>(n));
+
+   const void * src[4];
+   const float * dark[4];
+   for(int p = 0; p < nPupils; ++p)
+   {
+      for(size_t i = 0; i < n; ++i)
+      {
+         im[p][i] = 10 + (i*(p+3)) % 50;
+         dk[p][i] = 0.25*p + (i % 3);
+      }
+      src[p] = im[p].data();
+      dark[p] = dk[p].data();
+   }
+
+   //The last pixel has no light
+   for(int p = 0; p < nPupils; ++p)
+   {
+      im[p][n-1] = 0;
+      dk[p][n-1] = 0;
+   }
+
+   std::vector<float> sx(n), sy(n), acc(n, 1);
+
+   slopeColumnT<float> kern = getSlopeColumn<float>(imageStructDataT, nPupils, perPixel);
+   REQUIRE( kern != nullptr );
+
+   kern(sx.data(), sy.data(), acc.data(), src, dark, n);
+
+   for(size_t i = 0; i < n; ++i)
+   {
+      double I[4];
+      for(int p = 0; p < nPupils; ++p) I[p] = im[p][i] - dk[p][i];
+
+      double x, y, tot;
+      if(nPupils == 3)
+      {
+         x = sqrt(3.0)/2*(I[0] - I[1]);
+         y = I[2] - 0.5*(I[0] + I[1]);
+         tot = I[0] + I[1] + I[2];
+      }
+      else
+      {
+         x = (I[0] + I[2]) - (I[1] + I[3]);
+         y = (I[0] + I[1]) - (I[2] + I[3]);
+         tot = I[0] + I[1] + I[2] + I[3];
+      }
+
+      if(perPixel)
+      {
+         double nrm = (tot > 0) ? 1/tot : 0;
+         REQUIRE( sx[i] == Approx(x*nrm).margin(1e-6) );
+         REQUIRE( sy[i] == Approx(y*nrm).margin(1e-6) );
+         REQUIRE( acc[i] == 1 );
+      }
+      else
+      {
+         REQUIRE( sx[i] == Approx(x) );
+         REQUIRE( sy[i] == Approx(y) );
+         REQUIRE( acc[i] == Approx(1 + tot) );
+      }
+   }
+}
+
+SCENARIO( "Calculating PWFS slopes", "[pwfsSlopeCalc]" )
+{
+   GIVEN("images of each data type")
+   {
+      for(int nPupils : {3, 4})
+      {
+         for(bool perPixel : {false, true})
+         {
+            WHEN(std::to_string(nPupils) + " pupils, " + (perPixel ? "per pixel" : "per frame"))
+            {
+               checkSlopes<uint8_t, IMAGESTRUCT_UINT8>(nPupils, perPixel);
+               checkSlopes<int8_t, IMAGESTRUCT_INT8>(nPupils, perPixel);
+               checkSlopes<uint16_t, IMAGESTRUCT_UINT16>(nPupils, perPixel);
+               checkSlopes<int16_t, IMAGESTRUCT_INT16>(nPupils, perPixel);
+               checkSlopes<uint32_t, IMAGESTRUCT_UINT32>(nPupils, perPixel);
+               checkSlopes<int32_t, IMAGESTRUCT_INT32>(nPupils, perPixel);
+               checkSlopes<uint64_t, IMAGESTRUCT_UINT64>(nPupils, perPixel);
+               checkSlopes<int64_t, IMAGESTRUCT_INT64>(nPupils, perPixel);
+               checkSlopes<float, IMAGESTRUCT_FLOAT>(nPupils, perPixel);
+               checkSlopes<double, IMAGESTRUCT_DOUBLE>(nPupils, perPixel);
+            }
+         }
+      }
+   }
+
+   GIVEN("unsupported geometries and types")
+   {
+      REQUIRE( getSlopeColumn<float>(IMAGESTRUCT_UINT16, 2, false) == nullptr );
+      REQUIRE( getSlopeColumn<float>(IMAGESTRUCT_UINT16, 5, true) == nullptr );
+      REQUIRE( getSlopeColumn<float>(-1, 4, false) == nullptr );
+   }
+
+   GIVEN("scaling")
+   {
+      std::vector<float> s = {1, -2, 3, 0.5};
+      slopeScale<float>(s.data(), 2, s.size());
+      REQUIRE( s == std::vector<float>({2, -4, 6, 1}) );
+   }
+}
@@ -150,7 +150,7 @@ protected:
 
    sem_t m_smSemaphore {0}; ///< Semaphore used to synchronize the fg thread and the sm thread.
    
-   realT (*pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+   pixKernels<realT> pixkern; ///< The kernels to extract the image data as our desired type realT.
    
    ///Mutex for locking dark operations.
    std::mutex m_darkMutex;
@@ -158,12 +158,12 @@ protected:
    mx::improc::eigenImage<realT> m_darkImage;
    bool m_darkSet {false};
    bool m_darkValid {false};
-   realT (*dark_pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+   pixKernels<realT> dark_pixkern; ///< The kernels to extract the dark data as our desired type realT.
    
    mx::improc::eigenImage<realT> m_dark2Image;
    bool m_dark2Set {false};
    bool m_dark2Valid {false};
-   realT (*dark2_pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+   pixKernels<realT> dark2_pixkern; ///< The kernels to extract the dark2 data as our desired type realT.
    
    
 public:
@@ -649,9 +649,9 @@ int shmimIntegrator::allocate(const dev::shmimT & dummy)
    m_avgImage.resize(shmimMonitorT::m_width, shmimMonitorT::m_height);
    //m_avgImage.setZero();
    
-   pixget = getPixPointer<realT>(shmimMonitorT::m_dataType);
+   pixkern = getPixKernels<realT>(shmimMonitorT::m_dataType);
    
-   if(pixget == nullptr)
+   if(pixkern.convert == nullptr)
    {
       log<software_error>({__FILE__, __LINE__, "bad data type"});
       return -1;
@@ -707,10 +707,7 @@ int shmimIntegrator::processImage( void * curr_src,
       
       realT * data = m_avgImage.data();
       
-      for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
-      {
-         data[nn] += pixget(curr_src, nn);
-      }
+      pixkern.accumulate(data, curr_src, shmimMonitorT::m_width*shmimMonitorT::m_height);
       ++m_sinceUpdate;
       if(m_sinceUpdate >= m_nAverage)
       {
@@ -795,10 +792,7 @@ int shmimIntegrator::processImage( void * curr_src,
    {
       realT * data = m_accumImages.image(m_currImage).data();
       
-      for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
-      {
-         data[nn] = pixget(curr_src, nn);
-      }
+      pixkern.convert(data, curr_src, shmimMonitorT::m_width*shmimMonitorT::m_height);
       ++m_nprocessed;
       ++m_currImage;
       if(m_currImage >= m_nAverage) m_currImage = 0;
@@ -861,9 +855,9 @@ int shmimIntegrator::allocate(const darkShmimT & dummy)
    m_darkImage.resize(darkMonitorT::m_width, darkMonitorT::m_height);
    m_darkImage.setZero();
 
-   dark_pixget = getPixPointer<realT>(darkMonitorT::m_dataType);
+   dark_pixkern = getPixKernels<realT>(darkMonitorT::m_dataType);
    
-   if(dark_pixget == nullptr)
+   if(dark_pixkern.convert == nullptr)
    {
       log<software_error>({__FILE__, __LINE__, "bad data type"});
       m_darkSet = false;
@@ -893,11 +887,7 @@ int shmimIntegrator::processImage( void * curr_src,
    
    realT * data = m_darkImage.data();
    
-   for(unsigned nn=0; nn < darkMonitorT::m_width*darkMonitorT::m_height; ++nn)
-   {
-      //data[nn] = *( (int16_t * ) (curr_src + nn*shmimMonitorT::m_typeSize));
-      data[nn] = dark_pixget(curr_src, nn);
-   }
+   dark_pixkern.convert(data, curr_src, darkMonitorT::m_width*darkMonitorT::m_height);
    
     m_darkSet = true; //There is a dark set and ready to use, but it may or may not be valid.
    
@@ -914,9 +904,9 @@ int shmimIntegrator::allocate(const dark2ShmimT & dummy)
    m_dark2Image.resize(dark2MonitorT::m_width, dark2MonitorT::m_height);
    m_dark2Image.setZero();
 
-   dark2_pixget = getPixPointer<realT>(dark2MonitorT::m_dataType);
+   dark2_pixkern = getPixKernels<realT>(dark2MonitorT::m_dataType);
    
-   if(dark2_pixget == nullptr)
+   if(dark2_pixkern.convert == nullptr)
    {
       log<software_error>({__FILE__, __LINE__, "bad data type"});
       m_dark2Set = false;
@@ -946,11 +936,7 @@ int shmimIntegrator::processImage( void * curr_src,
    
    realT * data = m_dark2Image.data();
    
-   for(unsigned nn=0; nn < dark2MonitorT::m_width*dark2MonitorT::m_height; ++nn)
-   {
-      //data[nn] = *( (int16_t * ) (curr_src + nn*shmimMonitorT::m_typeSize));
-      data[nn] = dark2_pixget(curr_src, nn);
-   }
+   dark2_pixkern.convert(data, curr_src, dark2MonitorT::m_width*dark2MonitorT::m_height);
    
    m_dark2Set = true; //There is a dark set and ready to use, but it may or may not be valid.
    
@@ -0,0 +1,314 @@
+/** \file indiCompRuleGraph.hpp
+  * \brief Incremental evaluation of the rules for the MagAO-X stateRuleEngine
+  *
+  * \ingroup stateRuleEngine_files
+  */
+
+#ifndef stateRuleEngine_indiCompRuleGraph_hpp
+#define stateRuleEngine_indiCompRuleGraph_hpp
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+#include "indiCompRuleConfig.hpp"
+
+/// The rules of a rule engine compiled into a dependency graph, with memoized values
+/** Each rule is a node, with edges from the rules it compares (its inputs) to it.  The nodes are sorted
+  * so that every rule comes after its inputs.  The value of each node is memoized, and a rule is only
+  * re-evaluated when one of the properties it reads, or one of its input rules, changes.  A ruleCompRule
+  * is evaluated from the memoized values of its inputs, so a rule shared by many others is evaluated once.
+  *
+  * A rule which can't be evaluated, e.g. because its property has not been received yet, is not known.
+  * A rule with an input which is not known is also not known.
+  *
+  * This does not own the rules or properties, which must outlive it.
+  */
+struct indiRuleGraph
+{
+    /// A rule in the graph
+    struct ruleNode
+    {
+        std::string name;                ///< The name of the rule
+        indiCompRule * rule {nullptr};   ///< The rule
+        std::vector<size_t> inputs;      ///< The nodes of the rules this rule compares, in the order of indiCompRule::inputRules
+        std::vector<size_t> dependents;  ///< The nodes of the rules which compare this rule
+        bool known {false};              ///< Whether the value is known
+        bool value {false};              ///< The memoized value, only meaningful if known
+        bool queued {false};             ///< Whether the node is queued for evaluation
+        uint64_t evaluations {0};        ///< The number of times the rule has been evaluated
+    };
+
+    /// The nodes, sorted so that every rule comes after its inputs
+    std::vector<ruleNode> nodes;
+
+    /// The nodes of the rules which read each property
+    std::unordered_map<const pcf::IndiProperty *, std::vector<size_t>> propRules;
+
+protected:
+
+    /// Nodes waiting to be evaluated, smallest index first so inputs are evaluated before their dependents
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> m_queue;
+
+    /// Working space for the values of a rule's inputs
+    std::vector<bool> m_vals;
+
+public:
+
+    /// Compile the rules into the graph
+    /** Any previous graph is cleared.  No rule is evaluated.
+      *
+      * \throws mx::err::invalidconfig if a rule compares a rule which is not in the map
+      * \throws mx::err::invalidconfig if the rules contain a cycle
+      */
+    void compile( indiRuleMaps & maps /**< [in] contains the rules to compile*/);
+
+    /// Evaluate every rule
+    /** Used to get the initial values after compiling.
+      */
+    void evaluate( std::vector<size_t> & changed /**< [out] the nodes whose known state or value changed, in evaluation order*/);
+
+    /// Re-evaluate the rules which depend on a property, after it changes
+    /** Only the rules which read the property are evaluated, and then only the dependents of rules
+      * whose known state or value changed, and so on up the graph.
+      */
+    void update( const pcf::IndiProperty * prop, ///< [in] the property which changed
+                 std::vector<size_t> & changed   ///< [out] the nodes whose known state or value changed, in evaluation order
+               );
+
+    /// Get the node of a rule by name
+    /**
+      * \returns the index of the node
+      * \returns nodes.size() if the rule is not found
+      */
+    size_t find( const std::string & name /**< [in] the name of the rule*/) const;
+
+protected:
+
+    /// Queue a node for evaluation if it is not already queued
+    void queue( size_t n /**< [in] the node*/);
+
+    /// Evaluate the queued nodes, and their dependents if they change
+    void run( std::vector<size_t> & changed /**< [out] the nodes whose known state or value changed*/);
+
+    /// Evaluate one node
+    /**
+      * \returns true if the known state or value of the node changed
+      * \returns false otherwise
+      */
+    bool evaluateNode( ruleNode & node /**< [in/out] the node*/);
+};
+
+inline
+void indiRuleGraph::compile( indiRuleMaps & maps )
+{
+    nodes.clear();
+    propRules.clear();
+    m_queue = decltype(m_queue)();
+
+    std::unordered_map<const indiCompRule *, size_t> ruleIdx;
+    std::vector<std::vector<indiCompRule *>> inRules(maps.rules.size());
+
+    //Number the rules in map order
+    std::vector<ruleNode> unsorted;
+    for(auto it = maps.rules.begin(); it != maps.rules.end(); ++it)
+    {
+        ruleIdx[it->second] = unsorted.size();
+        unsorted.emplace_back();
+        unsorted.back().name = it->first;
+        unsorted.back().rule = it->second;
+    }
+
+    //Kahn's algorithm: a rule is ready when all of its inputs are placed
+    std::vector<size_t> nPending(unsorted.size(), 0);
+    std::vector<std::vector<size_t>> dependents(unsorted.size());
+
+    for(size_t n = 0; n < unsorted.size(); ++n)
+    {
+        unsorted[n].rule->inputRules(inRules[n]);
+
+        for(size_t r = 0; r < inRules[n].size(); ++r)
+        {
+            auto rit = ruleIdx.find(inRules[n][r]);
+            if(rit == ruleIdx.end())
+            {
+                mxThrowException(mx::err::invalidconfig, "indiRuleGraph::compile", "rule " + unsorted[n].name + " compares a rule which is not in the map");
+            }
+
+            dependents[rit->second].push_back(n);
+            ++nPending[n];
+        }
+    }
+
+    std::vector<size_t> order;
+    for(size_t n = 0; n < unsorted.size(); ++n)
+    {
+        if(nPending[n] == 0) order.push_back(n);
+    }
+
+    for(size_t o = 0; o < order.size(); ++o)
+    {
+        for(size_t d : dependents[order[o]])
+        {
+            if(--nPending[d] == 0) order.push_back(d);
+        }
+    }
+
+    if(order.size() != unsorted.size())
+    {
+        std::string cyc;
+        for(size_t n = 0; n < unsorted.size(); ++n)
+        {
+            if(nPending[n] > 0) cyc += " " + unsorted[n].name;
+        }
+
+        mxThrowException(mx::err::invalidconfig, "indiRuleGraph::compile", "rules form a cycle:" + cyc);
+    }
+
+    //Place the nodes in sorted order, and connect them
+    std::vector<size_t> sortedIdx(unsorted.size());
+    for(size_t o = 0; o < order.size(); ++o) sortedIdx[order[o]] = o;
+
+    nodes.resize(unsorted.size());
+    for(size_t o = 0; o < order.size(); ++o)
+    {
+        size_t n = order[o];
+        nodes[o].name = unsorted[n].name;
+        nodes[o].rule = unsorted[n].rule;
+
+        for(size_t r = 0; r < inRules[n].size(); ++r)
+        {
+            size_t in = sortedIdx[ruleIdx[inRules[n][r]]];
+            nodes[o].inputs.push_back(in);
+
+            //A rule may compare the same rule twice
+            if(std::find(nodes[in].dependents.begin(), nodes[in].dependents.end(), o) == nodes[in].dependents.end())
+            {
+                nodes[in].dependents.push_back(o);
+            }
+        }
+
+        std::vector<const pcf::IndiProperty *> props;
+        nodes[o].rule->inputProperties(props);
+        for(size_t p = 0; p < props.size(); ++p)
+        {
+            propRules[props[p]].push_back(o);
+        }
+    }
+}
+
+inline
+void indiRuleGraph::evaluate( std::vector<size_t> & changed )
+{
+    for(size_t n = 0; n < nodes.size(); ++n)
+    {
+        queue(n);
+    }
+
+    run(changed);
+}
+
+inline
+void indiRuleGraph::update( const pcf::IndiProperty * prop,
+                            std::vector<size_t> & changed
+                          )
+{
+    auto it = propRules.find(prop);
+    if(it == propRules.end())
+    {
+        changed.clear();
+        return;
+    }
+
+    for(size_t n : it->second)
+    {
+        queue(n);
+    }
+
+    run(changed);
+}
+
+inline
+size_t indiRuleGraph::find( const std::string & name ) const
+{
+    for(size_t n = 0; n < nodes.size(); ++n)
+    {
+        if(nodes[n].name == name) return n;
+    }
+
+    return nodes.size();
+}
+
+inline
+void indiRuleGraph::queue( size_t n )
+{
+    if(nodes[n].queued) return;
+
+    nodes[n].queued = true;
+    m_queue.push(n);
+}
+
+inline
+void indiRuleGraph::run( std::vector<size_t> & changed )
+{
+    changed.clear();
+
+    //Dependents always have larger indices, so each node is evaluated after all of its queued inputs
+    while(!m_queue.empty())
+    {
+        size_t n = m_queue.top();
+        m_queue.pop();
+        nodes[n].queued = false;
+
+        if(!evaluateNode(nodes[n])) continue;
+
+        changed.push_back(n);
+
+        for(size_t d : nodes[n].dependents)
+        {
+            queue(d);
+        }
+    }
+}
+
+inline
+bool indiRuleGraph::evaluateNode( ruleNode & node )
+{
+    bool known = true;
+    bool value = false;
+
+    m_vals.resize(node.inputs.size());
+    for(size_t i = 0; i < node.inputs.size(); ++i)
+    {
+        if(!nodes[node.inputs[i]].known)
+        {
+            known = false;
+            break;
+        }
+        m_vals[i] = nodes[node.inputs[i]].value;
+    }
+
+    if(known)
+    {
+        ++node.evaluations;
+
+        try
+        {
+            value = node.rule->valueFromRules(m_vals);
+        }
+        catch(const std::exception & e)
+        {
+            known = false;
+        }
+    }
+
+    bool chg = (known != node.known) || (known && value != node.value);
+
+    node.known = known;
+    if(known) node.value = value;
+
+    return chg;
+}
+
+#endif //stateRuleEngine_indiCompRuleGraph_hpp
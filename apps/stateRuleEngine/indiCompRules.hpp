@@ -222,6 +222,39 @@ public:
       */
     virtual bool value() = 0;
 
+    /// Get the properties this rule reads
+    /** Used to find the rules which must be re-evaluated when a property changes.
+      * The default is no properties.
+      */
+    virtual void inputProperties( std::vector<const pcf::IndiProperty *> & props /**< [out] the properties are appended to this*/)
+    {
+        static_cast<void>(props);
+    }
+
+    /// Get the rules this rule compares
+    /** Used to order the rules so that each is evaluated after the rules it depends on.
+      * The default is no rules.
+      */
+    virtual void inputRules( std::vector<indiCompRule *> & rules /**< [out] the rules are appended to this*/)
+    {
+        static_cast<void>(rules);
+    }
+
+    /// Get the value of this rule given the values of the rules it compares
+    /** This lets a rule be evaluated from the memoized values of its input rules, rather than by
+      * evaluating them again.  The default ignores \p ruleVals and calls value(), which is correct for
+      * rules which only read properties.
+      *
+      * \returns the result of the comparison defined by the rule
+      *
+      * \throws mx::err::invalidconfig if the rule is not currently valid
+      */
+    virtual bool valueFromRules( const std::vector<bool> & ruleVals /**< [in] the values of the rules from inputRules, in the same order*/)
+    {
+        static_cast<void>(ruleVals);
+        return value();
+    }
+
     /// Compare two strings
     /** String comparison can only be Eq or Neq.
       *
@@ -452,6 +485,12 @@ public:
 
         return rv;
     }
+
+    /// Get the property this rule reads
+    virtual void inputProperties( std::vector<const pcf::IndiProperty *> & props /**< [out] the property is appended to this*/)
+    {
+        if(m_property) props.push_back(m_property);
+    }
 };
 
 /// A rule base class for testing elements in two properties
@@ -606,6 +645,13 @@ public:
 
         return rv;
     }
+
+    /// Get the properties this rule reads
+    virtual void inputProperties( std::vector<const pcf::IndiProperty *> & props /**< [out] the properties are appended to this*/)
+    {
+        if(m_property1) props.push_back(m_property1);
+        if(m_property2 && m_property2 != m_property1) props.push_back(m_property2);
+    }
 };
 
 /// Compare the value of a number element to a target
@@ -1103,6 +1149,37 @@ public:
 
         return std::get<bool>(rv);
     }
+
+    /// Get the rules this rule compares
+    virtual void inputRules( std::vector<indiCompRule *> & rules /**< [out] rule1 and rule2 are appended to this*/)
+    {
+        if(m_rule1) rules.push_back(m_rule1);
+        if(m_rule2) rules.push_back(m_rule2);
+    }
+
+    /// Get the value of this rule given the values of rule1 and rule2
+    /** The rules are not evaluated again, so their validity is not checked.
+      *
+      * \returns the value of the comparison, true or false
+      *
+      * 	hrows mx::err::invalidconfig if either rule pointer is nullptr
+      * 	hrows mx::err::invalidconfig on an error from the comparison
+      */
+    virtual bool valueFromRules( const std::vector<bool> & ruleVals /**< [in] the values of rule1 and rule2*/)
+    {
+        if(m_rule1 == nullptr || m_rule2 == nullptr || ruleVals.size() != 2)
+        {
+            mxThrowException(mx::err::invalidconfig, "ruleCompRule::valueFromRules", "rule1 or rule2 is nullptr");
+        }
+
+        boolorerr_t rv = compBool(ruleVals[0], ruleVals[1]);
+        if(isError(rv))
+        {
+            mxThrowException(mx::err::invalidconfig, "ruleCompRule::valueFromRules", std::get<std::string>(rv));
+        }
+
+        return std::get<bool>(rv);
+    }
 };
 
 #endif //stateRuleEngine_indiCompRules_hpp
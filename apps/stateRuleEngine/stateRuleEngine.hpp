@@ -11,7 +11,7 @@
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
-#include "indiCompRuleConfig.hpp"
+#include "indiCompRuleGraph.hpp"
 
 /** \defgroup stateRuleEngine
   * \brief The MagAO-X stateRuleEngine application 
@@ -51,6 +51,10 @@ protected:
      
     ///@}
 
+    indiRuleGraph m_ruleGraph; ///< The rules compiled for incremental evaluation
+
+    std::mutex m_ruleMutex; ///< Protects the rule properties and graph, which are updated by the INDI callbacks
+
 public:
     /// Default c'tor.
     stateRuleEngine();
@@ -87,6 +91,10 @@ public:
       */
     virtual int appShutdown();
  
+    /// Publish the value of a rule in the INDI property for its priority
+    /** Does nothing if the rule's priority is none, or if its value is not known.
+      */
+    void publishRule( const indiRuleGraph::ruleNode & node /**< [in] the node of the rule to publish*/);
  
     /// The static callback function to be registered for rule properties
     /** 
@@ -126,6 +134,8 @@ int stateRuleEngine::loadConfigImpl( mx::app::appConfigurator & _config )
 {
     loadRuleConfig(m_ruleMaps, _config);
 
+    m_ruleGraph.compile(m_ruleMaps);
+
     return 0;
 }
 
@@ -214,6 +224,13 @@ int stateRuleEngine::appStartup()
 
         registerIndiPropertySet( *it->second, devName, propName, st_newCallBack_ruleProp);
     }
+
+    //Get the initial values.  These are not known until the properties are received, and then
+    //are published by newCallBack_ruleProp.
+    std::lock_guard<std::mutex> lock(m_ruleMutex);
+
+    std::vector<size_t> changed;
+    m_ruleGraph.evaluate(changed);
     
     state(stateCodes::READY);
 
@@ -222,49 +239,7 @@ int stateRuleEngine::appStartup()
 
 int stateRuleEngine::appLogic()
 {
-    for(auto it = m_ruleMaps.rules.begin(); it != m_ruleMaps.rules.end(); ++it)
-    {
-        if(it->second->priority() != rulePriority::none)
-        {
-            try
-            {
-                bool val = it->second->value();
-
-                pcf::IndiElement::SwitchStateType onoff = pcf::IndiElement::Off;
-                if(val) onoff = pcf::IndiElement::On;
-
-                if(it->second->priority() == rulePriority::info)
-                {
-                    updateSwitchIfChanged(m_indiP_info, it->first, onoff);
-                }
-                else if(it->second->priority() == rulePriority::caution)
-                {
-                    updateSwitchIfChanged(m_indiP_caution, it->first, onoff);
-                }
-                else if(it->second->priority() == rulePriority::warning)
-                {
-                    updateSwitchIfChanged(m_indiP_warning, it->first, onoff);
-                }
-                else 
-                {
-                    updateSwitchIfChanged(m_indiP_alert, it->first, onoff);
-                }
-
-            }
-            catch(const std::exception & e)
-            {
-                ///\todo how to handle startup vs misconfiguration
-                
-                /*
-                if(it->second->priority() == rulePriority::none)
-                {
-                    updateSwitchIfChanged(m_indiP_info, it->first, pcf::IndiElement::Off);
-                }*/
-            }
-        }
-    }
-
-
+    //The rules are evaluated and published by newCallBack_ruleProp as their properties change
     return 0;
 }
 
@@ -273,6 +248,34 @@ int stateRuleEngine::appShutdown()
     return 0;
 }
 
+void stateRuleEngine::publishRule( const indiRuleGraph::ruleNode & node )
+{
+    if(node.rule->priority() == rulePriority::none) return;
+
+    ///\todo how to handle startup vs misconfiguration, when the value is not known
+    if(!node.known) return;
+
+    pcf::IndiElement::SwitchStateType onoff = pcf::IndiElement::Off;
+    if(node.value) onoff = pcf::IndiElement::On;
+
+    if(node.rule->priority() == rulePriority::info)
+    {
+        updateSwitchIfChanged(m_indiP_info, node.name, onoff);
+    }
+    else if(node.rule->priority() == rulePriority::caution)
+    {
+        updateSwitchIfChanged(m_indiP_caution, node.name, onoff);
+    }
+    else if(node.rule->priority() == rulePriority::warning)
+    {
+        updateSwitchIfChanged(m_indiP_warning, node.name, onoff);
+    }
+    else 
+    {
+        updateSwitchIfChanged(m_indiP_alert, node.name, onoff);
+    }
+}
+
 int stateRuleEngine::st_newCallBack_ruleProp( void * app,      
                                               const pcf::IndiProperty &ipRecv 
                                             )
@@ -288,17 +291,29 @@ int stateRuleEngine::newCallBack_ruleProp( const pcf::IndiProperty &ipRecv)
 {
     std::string key = ipRecv.createUniqueKey();
 
-    if(m_ruleMaps.props.count(key) == 0)
+    auto it = m_ruleMaps.props.find(key);
+    if(it == m_ruleMaps.props.end())
     {
         return 0;
     }
 
-    if(m_ruleMaps.props[key] == nullptr) //
+    if(it->second == nullptr) //
     {
         return 0;
     }
 
-    *m_ruleMaps.props[key] = ipRecv;
+    std::lock_guard<std::mutex> lock(m_ruleMutex);
+
+    *it->second = ipRecv;
+
+    //Re-evaluate only the rules which depend on this property, and publish the ones which change
+    std::vector<size_t> changed;
+    m_ruleGraph.update(it->second, changed);
+
+    for(size_t n : changed)
+    {
+        publishRule(m_ruleGraph.nodes[n]);
+    }
 
     return 0;
 }
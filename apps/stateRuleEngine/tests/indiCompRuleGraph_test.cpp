@@ -0,0 +1,171 @@
+#if(__cplusplus == 201703L)
+
+#include "../../../tests/catch2/catch.hpp"
+
+#include "../indiCompRuleGraph.hpp"
+
+SCENARIO( "incremental rule evaluation", "[stateRuleEngine::ruleGraph]" )
+{
+    GIVEN("two property rules, a rule comparing them, and a rule sharing one of them")
+    {
+        mx::app::writeConfigFile( "/tmp/ruleGraph_test.conf", {"A",        "A",        "A",       "A",      "B",        "B",        "B",       "B",
+                                                               "AB",       "AB",   "AB",    "AB",    "ABA",      "ABA",  "ABA",   "ABA" },
+                                                              {"ruleType", "property", "element", "target", "ruleType", "property", "element", "target",
+                                                               "ruleType", "comp", "rule1", "rule2", "ruleType", "comp", "rule1", "rule2" },
+                                                              {"txtVal",   "dev.p1",   "current", "test",   "swVal",    "dev.p2",   "sw",      "On",
+                                                               "ruleComp", "And",  "A",     "B",     "ruleComp", "Or",   "AB",    "A" } );
+        mx::app::appConfigurator config;
+        config.readConfig("/tmp/ruleGraph_test.conf");
+
+        indiRuleMaps maps;
+        loadRuleConfig(maps, config);
+
+        indiRuleGraph graph;
+        graph.compile(maps);
+
+        size_t A = graph.find("A");
+        size_t B = graph.find("B");
+        size_t AB = graph.find("AB");
+        size_t ABA = graph.find("ABA");
+
+        std::vector<size_t> changed;
+        graph.evaluate(changed);
+
+        WHEN("compiled")
+        {
+            REQUIRE(graph.nodes.size() == 4);
+            REQUIRE(A < AB);
+            REQUIRE(B < AB);
+            REQUIRE(AB < ABA);
+            REQUIRE(graph.find("C") == graph.nodes.size());
+
+            REQUIRE(graph.propRules[maps.props["dev.p1"]] == std::vector<size_t>({A}));
+            REQUIRE(graph.propRules[maps.props["dev.p2"]] == std::vector<size_t>({B}));
+            REQUIRE(graph.nodes[A].dependents.size() == 2);
+        }
+
+        WHEN("no properties have been received")
+        {
+            REQUIRE(changed.size() == 0);
+            REQUIRE(graph.nodes[A].known == false);
+            REQUIRE(graph.nodes[ABA].known == false);
+        }
+
+        WHEN("one property is received")
+        {
+            maps.props["dev.p1"]->add(pcf::IndiElement("current"));
+            (*maps.props["dev.p1"])["current"] = "test";
+
+            graph.update(maps.props["dev.p1"], changed);
+
+            REQUIRE(changed == std::vector<size_t>({A}));
+            REQUIRE(graph.nodes[A].known == true);
+            REQUIRE(graph.nodes[A].value == true);
+            REQUIRE(graph.nodes[AB].known == false);
+            REQUIRE(graph.nodes[ABA].known == false);
+        }
+
+        WHEN("both properties are received, then one changes")
+        {
+            maps.props["dev.p1"]->add(pcf::IndiElement("current"));
+            (*maps.props["dev.p1"])["current"] = "test";
+            graph.update(maps.props["dev.p1"], changed);
+
+            uint64_t aEvals = graph.nodes[A].evaluations;
+
+            maps.props["dev.p2"]->add(pcf::IndiElement("sw"));
+            (*maps.props["dev.p2"])["sw"].setSwitchState(pcf::IndiElement::On);
+            graph.update(maps.props["dev.p2"], changed);
+
+            REQUIRE(changed == std::vector<size_t>({B, AB, ABA}));
+            REQUIRE(graph.nodes[AB].value == true);
+            REQUIRE(graph.nodes[ABA].value == true);
+
+            //A was not evaluated again
+            REQUIRE(graph.nodes[A].evaluations == aEvals);
+
+            (*maps.props["dev.p1"])["current"] = "tset";
+            graph.update(maps.props["dev.p1"], changed);
+
+            //The shared rule A is evaluated once, and AB before ABA
+            REQUIRE(changed == std::vector<size_t>({A, AB, ABA}));
+            REQUIRE(graph.nodes[A].evaluations == aEvals + 1);
+            REQUIRE(graph.nodes[AB].value == false);
+            REQUIRE(graph.nodes[ABA].value == false);
+        }
+
+        WHEN("a property is received without changing its rule")
+        {
+            maps.props["dev.p1"]->add(pcf::IndiElement("current"));
+            (*maps.props["dev.p1"])["current"] = "test";
+            graph.update(maps.props["dev.p1"], changed);
+
+            maps.props["dev.p2"]->add(pcf::IndiElement("sw"));
+            (*maps.props["dev.p2"])["sw"].setSwitchState(pcf::IndiElement::On);
+            graph.update(maps.props["dev.p2"], changed);
+
+            uint64_t abEvals = graph.nodes[AB].evaluations;
+
+            graph.update(maps.props["dev.p2"], changed);
+
+            //The dependents are not evaluated
+            REQUIRE(changed.size() == 0);
+            REQUIRE(graph.nodes[AB].evaluations == abEvals);
+        }
+
+        WHEN("a property loses its element")
+        {
+            maps.props["dev.p1"]->add(pcf::IndiElement("current"));
+            (*maps.props["dev.p1"])["current"] = "test";
+            graph.update(maps.props["dev.p1"], changed);
+
+            maps.props["dev.p2"]->add(pcf::IndiElement("sw"));
+            (*maps.props["dev.p2"])["sw"].setSwitchState(pcf::IndiElement::On);
+            graph.update(maps.props["dev.p2"], changed);
+
+            *maps.props["dev.p2"] = pcf::IndiProperty(pcf::IndiProperty::Switch);
+            graph.update(maps.props["dev.p2"], changed);
+
+            REQUIRE(changed == std::vector<size_t>({B, AB, ABA}));
+            REQUIRE(graph.nodes[B].known == false);
+            REQUIRE(graph.nodes[ABA].known == false);
+        }
+    }
+
+    GIVEN("rules which compare each other")
+    {
+        mx::app::writeConfigFile( "/tmp/ruleGraph_test.conf", {"A",        "A",        "A",       "A",
+                                                               "X",        "X",     "X",     "Y",        "Y",     "Y" },
+                                                              {"ruleType", "property", "element", "target",
+                                                               "ruleType", "rule1", "rule2", "ruleType", "rule1", "rule2" },
+                                                              {"txtVal",   "dev.p1",   "current", "test",
+                                                               "ruleComp", "Y",     "A",     "ruleComp", "X",     "A" } );
+        mx::app::appConfigurator config;
+        config.readConfig("/tmp/ruleGraph_test.conf");
+
+        indiRuleMaps maps;
+        loadRuleConfig(maps, config);
+
+        WHEN("compiled")
+        {
+            indiRuleGraph graph;
+
+            bool caught = false;
+            try
+            {
+                graph.compile(maps);
+            }
+            catch(const mx::err::invalidconfig & e)
+            {
+                caught = true;
+            }
+            catch(...)
+            {
+            }
+
+            REQUIRE(caught==true);
+        }
+    }
+}
+
+#endif
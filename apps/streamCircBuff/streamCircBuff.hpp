@@ -36,10 +36,12 @@ namespace app
 class streamCircBuff : public MagAOXApp<true>, 
                        public dev::shmimMonitor<streamCircBuff>, 
                        public dev::frameGrabber<streamCircBuff>, 
+                       public dev::streamProcessor<streamCircBuff>, 
                        public dev::telemeter<streamCircBuff>
 {
    friend class dev::shmimMonitor<streamCircBuff>;
    friend class dev::frameGrabber<streamCircBuff>;
+   friend class dev::streamProcessor<streamCircBuff>;
    friend class dev::telemeter<streamCircBuff>;
 
 public:
@@ -60,6 +62,9 @@ public:
    /// The base frameGrabber type
    typedef dev::frameGrabber<streamCircBuff> frameGrabberT;
 
+   /// The base streamProcessor type
+   typedef dev::streamProcessor<streamCircBuff> streamProcessorT;
+
    /// The telemeter type
    typedef dev::telemeter<streamCircBuff> telemeterT;
 
@@ -73,8 +78,6 @@ protected:
 
    char * m_currSrc {nullptr};
 
-   sem_t m_smSemaphore {0}; ///< Semaphore used to synchronize the fg thread and the sm thread.
-
 public:
    /// Default c'tor.
    streamCircBuff();
@@ -151,13 +154,6 @@ protected:
      */
    int startAcquisition();
    
-   /// Implementation of the framegrabber acquireAndCheckValid interface
-   /** 
-     * \returns 0 on success
-     * \returns -1 on error
-     */
-   int acquireAndCheckValid();
-   
    /// Implementation of the framegrabber loadImageIntoStream interface
    /** 
      * \returns 0 on success
@@ -196,6 +192,8 @@ void streamCircBuff::setupConfig()
    
    FRAMEGRABBER_SETUP_CONFIG(config);
 
+   STREAMPROCESSOR_SETUP_CONFIG(config);
+
    TELEMETER_SETUP_CONFIG(config);
    
 }
@@ -206,6 +204,8 @@ int streamCircBuff::loadConfigImpl( mx::app::appConfigurator & _config )
    
    FRAMEGRABBER_LOAD_CONFIG(_config);
 
+   STREAMPROCESSOR_LOAD_CONFIG(_config);
+
    TELEMETER_LOAD_CONFIG(config);
    
    return 0;
@@ -218,11 +218,7 @@ void streamCircBuff::loadConfig()
 
 int streamCircBuff::appStartup()
 {
-   if(sem_init(&m_smSemaphore, 0,0) < 0)
-   {
-      log<software_critical>({__FILE__, __LINE__, errno,0, "Initializing S.M. semaphore"});
-      return -1;
-   }
+   STREAMPROCESSOR_APP_STARTUP;
 
    SHMIMMONITOR_APP_STARTUP;
 
@@ -281,13 +277,7 @@ int streamCircBuff::processImage( void * curr_src,
    m_currSrc = static_cast<char *>(curr_src);
 
    //Now tell the f.g. to get going
-   if(sem_post(&m_smSemaphore) < 0)
-   {
-      log<software_critical>({__FILE__, __LINE__, errno, 0, "Error posting to semaphore"});
-      return -1;
-   }
-
-   return 0;
+   return streamProcessorT::postImage();
 }
 
 int streamCircBuff::configureAcquisition()
@@ -315,34 +305,6 @@ int streamCircBuff::startAcquisition()
    return 0;
 }
 
-int streamCircBuff::acquireAndCheckValid()
-{
-   timespec ts;
-         
-   if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
-   {
-      log<software_critical>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
-      return -1;
-   }
-         
-   ts.tv_sec += 1;
-        
-   if(sem_timedwait(&m_smSemaphore, &ts) == 0)
-   {
-      clock_gettime(CLOCK_REALTIME, &m_currImageTimestamp);
-      return 0;
-   }
-   else
-   {
-      return 1;
-   }
-
-   if(m_currSrc == nullptr)
-   {
-      return 1;
-   }
-}
-
 int streamCircBuff::loadImageIntoStream(void * dest)
 {
    if(m_currSrc == nullptr)
@@ -9,6 +9,14 @@
 #ifndef streamWriter_hpp
 #define streamWriter_hpp
 
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+
 #include <ImageStreamIO/ImageStruct.h>
 #include <ImageStreamIO/ImageStreamIO.h>
 
@@ -24,6 +32,18 @@
 #define WRITING (2)
 #define STOP_WRITING (3)
 
+/// Alignment of the buffers, offsets, and sizes used for O_DIRECT writes.
+#define SW_DIRECT_ALIGN (4096)
+
+/** \name Zero-copy frame states
+ * The state of a circular buffer entry in zero-copy mode.  Values >= 0 are the index of the frame in the source ring.
+ * @{
+ */
+#define ZC_INBUFF (-1) ///< The frame has been copied into the circular buffer.
+#define ZC_LOST (-2)   ///< The frame was overwritten in the source ring before it could be copied.
+#define ZC_DONE (-3)   ///< The frame has been copied from the source ring by the encoder.
+///@}
+
 namespace MagAOX
 {
 namespace app
@@ -83,6 +103,20 @@ protected:
 
     bool m_compress{true};
 
+    size_t m_pipelineDepth{2}; ///< The number of chunks which can be encoded or waiting to be written at once.  Default is 2.
+
+    bool m_directIO{true}; ///< Whether to write files with O_DIRECT, bypassing the page cache.  Default is true.
+
+    size_t m_compressThreads{1}; ///< The number of threads compressing each chunk.  Default is 1, which compresses in the s.w. thread.
+
+    int m_compressThreadPrio{0}; ///< Priority of the compression threads.  Default is 0.
+
+    std::string m_compressCpuset; ///< The cpuset for the compression threads.  Ignored if empty (the default).
+
+    bool m_zeroCopy{false}; ///< Whether to encode directly from the source ring, rather than copying each frame on receipt.  Default is false.
+
+    size_t m_zeroCopyMargin{8}; ///< In zero-copy mode, frames within this many frames of being overwritten in the source ring are copied.  Default is 8.
+
     ///@}
 
     size_t m_width{0};     ///< The width of the image
@@ -93,6 +127,54 @@ protected:
     char *m_rawImageCircBuff{nullptr};
     uint64_t *m_timingCircBuff{nullptr};
 
+    /** \name Zero-copy
+     * In zero-copy mode the framegrabber thread does not copy frames into m_rawImageCircBuff, but records where each
+     * frame is in the source ring.  The encoder then copies the frames straight from the ring into the xrif buffer,
+     * saving a full copy of the data.  The timing data are still copied on receipt.
+     *
+     * Since the source keeps writing, the framegrabber thread watches the frames not yet encoded, and copies any
+     * which come within m_zeroCopyMargin frames of being overwritten into m_rawImageCircBuff (a rescue).  A copy from
+     * the ring, by either thread, is only trusted if the source had not started overwriting the slot by the time the
+     * copy finished.  A frame for which no trusted copy exists is lost, is zeroed in the output, and is counted.
+     *
+     * Zero-copy is used when configured and the source has a cntarray and a ring deeper than 2*m_zeroCopyMargin.
+     * Frames are assumed to be written to the ring in order.
+     * @{
+     */
+    bool m_zcActive{false}; ///< Whether zero-copy is active for the current stream.
+
+    std::unique_ptr<std::atomic<int64_t>[]> m_zcState; ///< The ring index or ZC_ state of each circular buffer entry.
+
+    char *m_zcRing{nullptr}; ///< The source ring data.
+
+    size_t m_zcRingDepth{0}; ///< The number of frames in the source ring.
+
+    uint64_t *m_zcCnt0{nullptr}; ///< The source's cnt0, the number of the latest frame written.
+
+    size_t m_zcPending{0}; ///< The oldest circular buffer entry which may still need to be rescued.
+
+    /// Copy frames for encoding, from the source ring or the circular buffer as appropriate.
+    /**
+     * \returns the number of frames which were lost
+     */
+    size_t copyFrames(char *dest,         ///< [out] the destination, with room for nFrames frames
+                      size_t frameStart,  ///< [in] the circular buffer position of the first frame
+                      size_t nFrames      ///< [in] the number of frames
+    );
+
+    /// Rescue frames at risk of being overwritten in the source ring.  Called by the framegrabber thread.
+    void rescueFrames(uint64_t latestCnt0 /**< [in] the source's latest cnt0 */);
+    ///@}
+
+    /** \name Frame Accounting
+     * @{
+     */
+    std::atomic<uint64_t> m_framesReceived{0}; ///< Frames received from the source.
+    std::atomic<uint64_t> m_framesSkipped{0};  ///< Frames the source wrote which were never seen, from gaps in cnt0.
+    std::atomic<uint64_t> m_framesRescued{0};  ///< Frames copied in zero-copy mode because they were about to be overwritten.
+    std::atomic<uint64_t> m_framesLost{0};     ///< Frames overwritten in the source ring before they could be copied.
+    ///@}
+
     size_t m_currImage{0};
 
     double m_currImageTime{0}; ///< The write-time of the current image
@@ -110,17 +192,54 @@ protected:
 
     uint64_t m_currSaveStopFrameNo{0};  ///< The frame number of the image at which saving stopped (for logging)
 
-    /// The xrif compression handle for image data
-    xrif_t m_xrif{nullptr};
+    /// The xrif handles, headers, and output buffer for one chunk in the encode/write pipeline.
+    struct writeSlot
+    {
+        /// The xrif compression handle for image data
+        xrif_t m_xrif{nullptr};
 
-    /// Storage for the xrif image data file header
-    char *m_xrif_header{nullptr};
+        /// Storage for the xrif image data file header
+        char *m_xrif_header{nullptr};
 
-    /// The xrif compression handle for image data
-    xrif_t m_xrif_timing{nullptr};
+        /// The xrif compression handle for timing data
+        xrif_t m_xrif_timing{nullptr};
 
-    /// Storage for the xrif image data file header
-    char *m_xrif_timing_header{nullptr};
+        /// Storage for the xrif timing data file header
+        char *m_xrif_timing_header{nullptr};
+
+        char *m_directBuff{nullptr}; ///< Block aligned buffer used to assemble the file for O_DIRECT writes.
+
+        size_t m_directBuffSz{0}; ///< The size of m_directBuff.
+
+        std::string m_fileName; ///< The name of the file to write.
+
+        double m_queuedTime{0}; ///< The time at which the chunk was queued for writing.
+    };
+
+    std::vector<writeSlot> m_slots; ///< The pipeline slots, m_pipelineDepth*m_compressThreads of them.
+
+    std::deque<size_t> m_freeSlots; ///< Slots available for encoding.
+
+    std::deque<size_t> m_writeQueue; ///< Encoded slots waiting to be written, in order.
+
+    std::mutex m_slotMutex; ///< Mutex protecting m_freeSlots and m_writeQueue.
+
+    std::condition_variable m_slotCond; ///< Signals a change to m_freeSlots or m_writeQueue.
+
+    /// The xrif handle of the most recently encoded chunk, for statistics.
+    xrif_t m_xrif{nullptr};
+
+    /** \name Pipeline Statistics
+     * @{
+     */
+    double m_encodeTime{0}; ///< The time taken to copy and encode the last chunk [sec]
+    double m_encodeRate{0}; ///< The rate at which the last chunk was copied and encoded, by all threads [bytes/sec]
+    double m_writeTime{0};  ///< The time taken to write the last chunk to disk [sec]
+    double m_writeLatency{0}; ///< The time from queueing to written for the last chunk [sec]
+    size_t m_queueDepth{0}; ///< The number of chunks waiting to be written.
+    size_t m_maxQueueDepth{0}; ///< The maximum of m_queueDepth since writing started.
+    uint64_t m_slotStalls{0}; ///< The number of times the encoder waited for a free slot.
+    ///@}
 
 public:
     /// Default c'tor
@@ -159,7 +278,7 @@ protected:
     static streamWriter *m_selfWriter; ///< Static pointer to this (set in constructor).  Used for getting out of the static SIGSEGV handler.
 
     /// Initialize the xrif system.
-    /** Allocates the handles and headers pointers.
+    /** Allocates the handles and headers pointers of each pipeline slot.
      *
      * \returns 0 on success.
      * \returns -1 on error.
@@ -254,10 +373,109 @@ protected:
     /// Execute the stream writer main loop.
     void swThreadExec();
 
-    /// Function called when semaphore is raised to do the encode and write.
+    /// Function called when semaphore is raised to do the encode.
+    /** Copies the chunk from the circular buffer into a free pipeline slot, encodes it, and queues it for
+     * writing.  Waits for a slot if all are in use.
+     *
+     * \returns 0 on success.
+     * \returns -1 on error.
+     */
     int doEncode();
     ///@}
 
+    /** \name Compression Threads
+     * With m_compressThreads > 1 each chunk is split into that many slabs of consecutive frames, which are copied and
+     * encoded in parallel by a pool of threads.  Each slab goes into its own pipeline slot and is written as a complete,
+     * standard, xrif file (image and timing), named by the time of its first frame.  So the output is just more, shorter,
+     * files, which xrif2fits and xrif2shmim read as usual.
+     *
+     * @{
+     */
+
+    /// A slab of frames to encode into a slot.
+    struct compressJob
+    {
+        size_t m_slotNo{0};     ///< The slot to encode into.
+        size_t m_frameStart{0}; ///< The circular buffer position of the first frame.
+        size_t m_nFrames{0};    ///< The number of frames.
+    };
+
+    /// A compression thread.
+    struct compressWorker
+    {
+        streamWriter *m_sw{nullptr}; ///< The streamWriter this belongs to.
+        std::thread m_thread;        ///< The thread.
+        bool m_threadInit{true};     ///< Synchronizer to ensure the thread initializes before doing dangerous things.
+        pid_t m_threadID{0};         ///< The thread pid.
+        pcf::IndiProperty m_threadProp; ///< The property to hold the thread details.
+    };
+
+    std::vector<std::unique_ptr<compressWorker>> m_compressWorkers; ///< The compression threads.
+
+    std::deque<compressJob> m_compressJobs; ///< The slabs waiting to be encoded.
+
+    size_t m_compressPending{0}; ///< The number of slabs of the current chunk not yet encoded.
+
+    std::mutex m_compressMutex; ///< Mutex protecting m_compressJobs and m_compressPending.
+
+    std::condition_variable m_compressCond; ///< Signals that jobs are available.
+
+    std::condition_variable m_compressDoneCond; ///< Signals that a job has finished.
+
+    /// Copy a slab from the circular buffers into its slot, encode it, and set its file name.
+    void encodeSlab(const compressJob &job /**< [in] the slab to encode */);
+
+    /// Thread starter, called by cwThreadStart on thread construction.  Calls cwThreadExec.
+    static void cwThreadStart(compressWorker *w /**< [in] the worker to run */);
+
+    /// Execute the compression thread main loop.
+    void cwThreadExec(compressWorker &w /**< [in] the worker being run */);
+    ///@}
+
+    /** \name File Writer Thread
+     * This thread writes encoded chunks to disk, so that encoding the next chunk overlaps writing the last one.
+     *
+     * @{
+     */
+    int m_fwThreadPrio{0}; ///< Priority of the file writer thread.  Default is 0.
+
+    std::string m_fwCpuset; ///< The cpuset for the file writer thread.  Ignored if empty (the default).
+
+    std::thread m_fwThread; ///< A separate thread for the file writing
+
+    bool m_fwThreadInit{true}; ///< Synchronizer to ensure f.w. thread initializes before doing dangerous things.
+
+    pid_t m_fwThreadID{0}; ///< F.w. thread pid.
+
+    std::atomic<bool> m_fwRunning{false}; ///< True from before the encoder can run until the f.w. thread has written its last chunk.
+
+    std::mutex m_fwWriteMutex; ///< Mutex so only one thread at a time writes queued chunks.
+
+    pcf::IndiProperty m_fwThreadProp; ///< The property to hold the f.w. thread details.
+
+    /// Thread starter, called by fwThreadStart on thread construction.  Calls fwThreadExec.
+    static void fwThreadStart(streamWriter *s /**< [in] a pointer to an streamWriter instance (normally this) */);
+
+    /// Execute the file writer main loop.
+    void fwThreadExec();
+
+    /// Write all queued chunks to disk, in order, in the calling thread.
+    /**
+     * \returns 0 on success.
+     * \returns -1 on error.
+     */
+    int writeQueued();
+
+    /// Write one encoded slot to its file.
+    /** The file is preallocated, and written with O_DIRECT from a block aligned buffer if m_directIO is true, falling
+     * back to normal buffered writes if the filesystem does not support O_DIRECT.
+     *
+     * \returns 0 on success.
+     * \returns -1 on error.
+     */
+    int writeSlotFile(writeSlot &slot /**< [in] the encoded slot to write */);
+    ///@}
+
     // INDI:
 protected:
     // declare our properties
@@ -265,6 +483,10 @@ protected:
 
     pcf::IndiProperty m_indiP_xrifStats;
 
+    pcf::IndiProperty m_indiP_pipeline;
+
+    pcf::IndiProperty m_indiP_frames;
+
 public:
     INDI_NEWCALLBACK_DECL(streamWriter, m_indiP_writing);
 
@@ -298,17 +520,23 @@ streamWriter::streamWriter() : MagAOXApp(MAGAOX_CURRENT_SHA1, MAGAOX_REPO_MODIFI
 
 streamWriter::~streamWriter() noexcept
 {
-    if (m_xrif)
-        xrif_delete(m_xrif);
+    for (size_t n = 0; n < m_slots.size(); ++n)
+    {
+        if (m_slots[n].m_xrif)
+            xrif_delete(m_slots[n].m_xrif);
+
+        if (m_slots[n].m_xrif_header)
+            free(m_slots[n].m_xrif_header);
 
-    if (m_xrif_header)
-        free(m_xrif_header);
+        if (m_slots[n].m_xrif_timing)
+            xrif_delete(m_slots[n].m_xrif_timing);
 
-    if (m_xrif_timing)
-        xrif_delete(m_xrif_timing);
+        if (m_slots[n].m_xrif_timing_header)
+            free(m_slots[n].m_xrif_timing_header);
 
-    if (m_xrif_timing_header)
-        free(m_xrif_timing_header);
+        if (m_slots[n].m_directBuff)
+            free(m_slots[n].m_directBuff);
+    }
 
     return;
 }
@@ -331,6 +559,24 @@ void streamWriter::setupConfig()
 
     config.add("writer.lz4accel", "", "writer.lz4accel", argType::Required, "writer", "lz4accel", false, "int", "The LZ4 acceleration parameter.  Larger is faster, but lower compression.");
 
+    config.add("writer.pipelineDepth", "", "writer.pipelineDepth", argType::Required, "writer", "pipelineDepth", false, "size_t", "The number of chunks which can be encoded or waiting to be written at once.  Must be at least 1.  Default is 2, so encoding overlaps writing.");
+
+    config.add("writer.compressThreads", "", "writer.compressThreads", argType::Required, "writer", "compressThreads", false, "size_t", "The number of threads compressing each chunk.  Each thread writes a separate xrif file holding its share of the chunk's frames.  Default is 1.");
+
+    config.add("writer.compressThreadPrio", "", "writer.compressThreadPrio", argType::Required, "writer", "compressThreadPrio", false, "int", "The real-time priority of the compression threads.  Default is 0.");
+
+    config.add("writer.compressCpuset", "", "writer.compressCpuset", argType::Required, "writer", "compressCpuset", false, "string", "The cpuset for the compression threads.");
+
+    config.add("writer.zeroCopy", "", "writer.zeroCopy", argType::Required, "writer", "zeroCopy", false, "bool", "Flag to set whether frames are encoded directly from the source ring buffer, rather than copied on receipt.  Only used if the source has a cntarray and a deep enough ring.  Default false.");
+
+    config.add("writer.zeroCopyMargin", "", "writer.zeroCopyMargin", argType::Required, "writer", "zeroCopyMargin", false, "size_t", "In zero-copy mode, frames within this many frames of being overwritten in the source ring are copied.  Default is 8.");
+
+    config.add("writer.directIO", "", "writer.directIO", argType::Required, "writer", "directIO", false, "bool", "Flag to set whether files are written with O_DIRECT, bypassing the page cache.  Default true.");
+
+    config.add("writer.fileThreadPrio", "", "writer.fileThreadPrio", argType::Required, "writer", "fileThreadPrio", false, "int", "The real-time priority of the file writer thread.  Default is 0.");
+
+    config.add("writer.fileCpuset", "", "writer.fileCpuset", argType::Required, "writer", "fileCpuset", false, "string", "The cpuset for the file writer thread.");
+
     config.add("writer.outName", "", "writer.outName", argType::Required, "writer", "outName", false, "int", "The name to use for output files.  Default is the shmimName.");
 
     config.add("framegrabber.shmimName", "", "framegrabber.shmimName", argType::Required, "framegrabber", "shmimName", false, "int", "The name of the stream to monitor. From /tmp/shmimName.im.shm.");
@@ -355,6 +601,19 @@ void streamWriter::loadConfig()
     config(m_swThreadPrio, "writer.threadPrio");
     config(m_swCpuset, "writer.cpuset");
     config(m_compress, "writer.compress");
+    config(m_pipelineDepth, "writer.pipelineDepth");
+    if (m_pipelineDepth < 1)
+        m_pipelineDepth = 1;
+    config(m_directIO, "writer.directIO");
+    config(m_zeroCopy, "writer.zeroCopy");
+    config(m_zeroCopyMargin, "writer.zeroCopyMargin");
+    config(m_compressThreads, "writer.compressThreads");
+    if (m_compressThreads < 1)
+        m_compressThreads = 1;
+    config(m_compressThreadPrio, "writer.compressThreadPrio");
+    config(m_compressCpuset, "writer.compressCpuset");
+    config(m_fwThreadPrio, "writer.fileThreadPrio");
+    config(m_fwCpuset, "writer.fileCpuset");
     config(m_lz4accel, "writer.lz4accel");
     if (m_lz4accel < XRIF_LZ4_ACCEL_MIN)
         m_lz4accel = XRIF_LZ4_ACCEL_MIN;
@@ -426,6 +685,38 @@ int streamWriter::appStartup()
 
     indi::addNumberElement<float>(m_indiP_xrifStats, "encodeFPS", 0, std::numeric_limits<float>::max(), 0.0, "%0.2f", "Total Encoding Rate [f.p.s.]");
 
+    // Register the pipeline INDI property
+    REG_INDI_NEWPROP_NOCB(m_indiP_pipeline, "pipeline", pcf::IndiProperty::Number);
+    m_indiP_pipeline.setLabel("encode/write pipeline");
+
+    indi::addNumberElement<float>(m_indiP_pipeline, "encode_ms", 0, std::numeric_limits<float>::max(), 0.0, "%0.3f", "Copy and Encode Time [msec]");
+
+    indi::addNumberElement<float>(m_indiP_pipeline, "encodeMBsec", 0, std::numeric_limits<float>::max(), 0.0, "%0.2f", "Copy and Encode Rate, All Threads [MB/sec]");
+
+    indi::addNumberElement<float>(m_indiP_pipeline, "write_ms", 0, std::numeric_limits<float>::max(), 0.0, "%0.3f", "File Write Time [msec]");
+
+    indi::addNumberElement<float>(m_indiP_pipeline, "latency_ms", 0, std::numeric_limits<float>::max(), 0.0, "%0.3f", "Queue to Written Latency [msec]");
+
+    indi::addNumberElement<int>(m_indiP_pipeline, "queueDepth", 0, std::numeric_limits<int>::max(), 1, "%d", "Chunks Waiting to Write");
+
+    indi::addNumberElement<int>(m_indiP_pipeline, "maxQueueDepth", 0, std::numeric_limits<int>::max(), 1, "%d", "Max Chunks Waiting to Write");
+
+    indi::addNumberElement<int>(m_indiP_pipeline, "stalls", 0, std::numeric_limits<int>::max(), 1, "%d", "Encoder Waits for a Free Slot");
+
+    // Register the frame accounting INDI property
+    REG_INDI_NEWPROP_NOCB(m_indiP_frames, "frames", pcf::IndiProperty::Number);
+    m_indiP_frames.setLabel("frame accounting");
+
+    indi::addNumberElement<double>(m_indiP_frames, "received", 0, std::numeric_limits<double>::max(), 1, "%0.0f", "Frames Received");
+
+    indi::addNumberElement<double>(m_indiP_frames, "skipped", 0, std::numeric_limits<double>::max(), 1, "%0.0f", "Frames Skipped by Source cnt0");
+
+    indi::addNumberElement<double>(m_indiP_frames, "rescued", 0, std::numeric_limits<double>::max(), 1, "%0.0f", "Zero-copy Frames Copied Early");
+
+    indi::addNumberElement<double>(m_indiP_frames, "lost", 0, std::numeric_limits<double>::max(), 1, "%0.0f", "Zero-copy Frames Overwritten");
+
+    indi::addNumberElement<int>(m_indiP_frames, "zeroCopy", 0, 1, 1, "%d", "Zero-copy Active");
+
     // Now set up the framegrabber and writer threads.
     //  - need SIGSEGV and SIGBUS handling for ImageStreamIO restarts
     //  - initialize the semaphore
@@ -451,11 +742,35 @@ int streamWriter::appStartup()
         return log<software_critical, -1>({__FILE__, __LINE__});
     }
 
+    // Set before the encoder starts, so it never writes chunks itself while the file writer is starting up.
+    m_fwRunning = true;
+
     if (threadStart(m_swThread, m_swThreadInit, m_swThreadID, m_swThreadProp, m_swThreadPrio, m_swCpuset, "streamwriter", this, swThreadStart) < 0)
     {
         log<software_critical, -1>({__FILE__, __LINE__});
     }
 
+    if (m_compressThreads > 1)
+    {
+        for (size_t n = 0; n < m_compressThreads; ++n)
+        {
+            m_compressWorkers.emplace_back(new compressWorker);
+            compressWorker *w = m_compressWorkers.back().get();
+            w->m_sw = this;
+
+            if (threadStart(w->m_thread, w->m_threadInit, w->m_threadID, w->m_threadProp, m_compressThreadPrio, m_compressCpuset, "compress" + std::to_string(n), w, cwThreadStart) < 0)
+            {
+                return log<software_critical, -1>({__FILE__, __LINE__});
+            }
+        }
+    }
+
+    if (threadStart(m_fwThread, m_fwThreadInit, m_fwThreadID, m_fwThreadProp, m_fwThreadPrio, m_fwCpuset, "filewriter", this, fwThreadStart) < 0)
+    {
+        m_fwRunning = false;
+        log<software_critical, -1>({__FILE__, __LINE__});
+    }
+
     if (telemeterT::appStartup() < 0)
     {
         return log<software_error, -1>({__FILE__, __LINE__});
@@ -497,6 +812,20 @@ int streamWriter::appLogic()
         return -1;
     }
 
+    try
+    {
+        if (pthread_tryjoin_np(m_fwThread.native_handle(), 0) == 0)
+        {
+            log<software_error>({__FILE__, __LINE__, "filewriter thread has exited"});
+            return -1;
+        }
+    }
+    catch (...)
+    {
+        log<software_error>({__FILE__, __LINE__, "filewriter thread has exited"});
+        return -1;
+    }
+
     switch (m_writing)
     {
     case NOT_WRITING:
@@ -544,16 +873,50 @@ int streamWriter::appShutdown()
     {
     }
 
-    if (m_xrif)
+    for (size_t n = 0; n < m_compressWorkers.size(); ++n)
     {
-        xrif_delete(m_xrif);
-        m_xrif = nullptr;
+        try
+        {
+            if (m_compressWorkers[n]->m_thread.joinable())
+            {
+                m_compressWorkers[n]->m_thread.join();
+            }
+        }
+        catch (...)
+        {
+        }
+    }
+    m_compressWorkers.clear();
+
+    try
+    {
+        if (m_fwThread.joinable())
+        {
+            m_fwThread.join();
+        }
     }
+    catch (...)
+    {
+    }
+
+    // Anything encoded after the file writer exited still goes to disk.
+    writeQueued();
 
-    if (m_xrif_timing)
+    m_xrif = nullptr;
+
+    for (size_t n = 0; n < m_slots.size(); ++n)
     {
-        xrif_delete(m_xrif_timing);
-        m_xrif_timing = nullptr;
+        if (m_slots[n].m_xrif)
+        {
+            xrif_delete(m_slots[n].m_xrif);
+            m_slots[n].m_xrif = nullptr;
+        }
+
+        if (m_slots[n].m_xrif_timing)
+        {
+            xrif_delete(m_slots[n].m_xrif_timing);
+            m_slots[n].m_xrif_timing = nullptr;
+        }
     }
 
     telemeterT::appShutdown();
@@ -563,55 +926,81 @@ int streamWriter::appShutdown()
 
 int streamWriter::initialize_xrif()
 {
-    xrif_error_t rv = xrif_new(&m_xrif);
-    if (rv != XRIF_NOERROR)
-    {
-        return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle allocation or initialization error."});
-    }
+    m_slots.resize(m_pipelineDepth * m_compressThreads);
 
-    if (m_compress)
+    for (size_t n = 0; n < m_slots.size(); ++n)
     {
-        rv = xrif_configure(m_xrif, XRIF_DIFFERENCE_PREVIOUS, XRIF_REORDER_BYTEPACK, XRIF_COMPRESS_LZ4);
-        if (rv != XRIF_NOERROR)
+        writeSlot &slot = m_slots[n];
+
+        if (slot.m_xrif == nullptr)
         {
-            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
+            xrif_error_t rv = xrif_new(&slot.m_xrif);
+            if (rv != XRIF_NOERROR)
+            {
+                return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle allocation or initialization error."});
+            }
         }
-    }
-    else
-    {
-        std::cerr << "not compressing . . . \n";
-        rv = xrif_configure(m_xrif, XRIF_DIFFERENCE_NONE, XRIF_REORDER_NONE, XRIF_COMPRESS_NONE);
-        if (rv != XRIF_NOERROR)
+
+        if (m_compress)
         {
-            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
+            xrif_error_t rv = xrif_configure(slot.m_xrif, XRIF_DIFFERENCE_PREVIOUS, XRIF_REORDER_BYTEPACK, XRIF_COMPRESS_LZ4);
+            if (rv != XRIF_NOERROR)
+            {
+                return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
+            }
+        }
+        else
+        {
+            std::cerr << "not compressing . . . \n";
+            xrif_error_t rv = xrif_configure(slot.m_xrif, XRIF_DIFFERENCE_NONE, XRIF_REORDER_NONE, XRIF_COMPRESS_NONE);
+            if (rv != XRIF_NOERROR)
+            {
+                return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
+            }
         }
-    }
 
-    errno = 0;
-    m_xrif_header = (char *)malloc(XRIF_HEADER_SIZE * sizeof(char));
-    if (m_xrif_header == NULL)
-    {
-        return log<software_critical, -1>({__FILE__, __LINE__, errno, 0, "xrif header allocation failed."});
-    }
+        if (slot.m_xrif_header == nullptr)
+        {
+            errno = 0;
+            slot.m_xrif_header = (char *)malloc(XRIF_HEADER_SIZE * sizeof(char));
+            if (slot.m_xrif_header == NULL)
+            {
+                return log<software_critical, -1>({__FILE__, __LINE__, errno, 0, "xrif header allocation failed."});
+            }
+        }
 
-    rv = xrif_new(&m_xrif_timing);
-    if (rv != XRIF_NOERROR)
-    {
-        return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle allocation or initialization error."});
-    }
+        if (slot.m_xrif_timing == nullptr)
+        {
+            xrif_error_t rv = xrif_new(&slot.m_xrif_timing);
+            if (rv != XRIF_NOERROR)
+            {
+                return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle allocation or initialization error."});
+            }
+        }
 
-    // m_xrif_timing->reorder_method = XRIF_REORDER_NONE;
-    rv = xrif_configure(m_xrif_timing, XRIF_DIFFERENCE_NONE, XRIF_REORDER_NONE, XRIF_COMPRESS_NONE);
-    if (rv != XRIF_NOERROR)
-    {
-        return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
+        xrif_error_t rv = xrif_configure(slot.m_xrif_timing, XRIF_DIFFERENCE_NONE, XRIF_REORDER_NONE, XRIF_COMPRESS_NONE);
+        if (rv != XRIF_NOERROR)
+        {
+            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
+        }
+
+        if (slot.m_xrif_timing_header == nullptr)
+        {
+            errno = 0;
+            slot.m_xrif_timing_header = (char *)malloc(XRIF_HEADER_SIZE * sizeof(char));
+            if (slot.m_xrif_timing_header == NULL)
+            {
+                return log<software_critical, -1>({__FILE__, __LINE__, errno, 0, "xrif header allocation failed."});
+            }
+        }
     }
 
-    errno = 0;
-    m_xrif_timing_header = (char *)malloc(XRIF_HEADER_SIZE * sizeof(char));
-    if (m_xrif_timing_header == NULL)
+    std::lock_guard<std::mutex> lock(m_slotMutex);
+    m_freeSlots.clear();
+    m_writeQueue.clear();
+    for (size_t n = 0; n < m_slots.size(); ++n)
     {
-        return log<software_critical, -1>({__FILE__, __LINE__, errno, 0, "xrif header allocation failed."});
+        m_freeSlots.push_back(n);
     }
 
     return 0;
@@ -701,75 +1090,131 @@ int streamWriter::allocate_circbufs()
         return log<software_critical, -1>({__FILE__, __LINE__, errno, 0, "buffer allocation failure"});
     }
 
+    m_zcState.reset(new (std::nothrow) std::atomic<int64_t>[m_circBuffLength]);
+    if (!m_zcState)
+    {
+        return log<software_critical, -1>({__FILE__, __LINE__, errno, 0, "buffer allocation failure"});
+    }
+
+    for (size_t n = 0; n < m_circBuffLength; ++n)
+    {
+        m_zcState[n] = ZC_INBUFF;
+    }
+    m_zcPending = 0;
+
     return 0;
 }
 
 int streamWriter::allocate_xrif()
 {
-    // Set up the image data xrif handle
-    xrif_error_t rv;
-
-    if (m_compress)
+    // Don't reconfigure a handle which still holds data to be written.
     {
-        rv = xrif_configure(m_xrif, XRIF_DIFFERENCE_PREVIOUS, XRIF_REORDER_BYTEPACK, XRIF_COMPRESS_LZ4);
-        if (rv != XRIF_NOERROR)
+        std::unique_lock<std::mutex> lock(m_slotMutex);
+        while (m_writeQueue.size() > 0 && !m_shutdown)
         {
-            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
+            m_slotCond.wait_for(lock, std::chrono::seconds(1));
         }
     }
-    else
+
+    xrif_error_t rv;
+
+    // Each slot holds at most one slab of a chunk
+    size_t slabLength = (m_writeChunkLength + m_compressThreads - 1) / m_compressThreads;
+
+    for (size_t n = 0; n < m_slots.size(); ++n)
     {
-        std::cerr << "not compressing . . . \n";
-        rv = xrif_configure(m_xrif, XRIF_DIFFERENCE_NONE, XRIF_REORDER_NONE, XRIF_COMPRESS_NONE);
+        writeSlot &slot = m_slots[n];
+
+        // Set up the image data xrif handle
+        if (m_compress)
+        {
+            rv = xrif_configure(slot.m_xrif, XRIF_DIFFERENCE_PREVIOUS, XRIF_REORDER_BYTEPACK, XRIF_COMPRESS_LZ4);
+            if (rv != XRIF_NOERROR)
+            {
+                return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
+            }
+        }
+        else
+        {
+            std::cerr << "not compressing . . . \n";
+            rv = xrif_configure(slot.m_xrif, XRIF_DIFFERENCE_NONE, XRIF_REORDER_NONE, XRIF_COMPRESS_NONE);
+            if (rv != XRIF_NOERROR)
+            {
+                return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
+            }
+        }
+
+        rv = xrif_set_size(slot.m_xrif, m_width, m_height, 1, slabLength, m_dataType);
         if (rv != XRIF_NOERROR)
         {
-            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
+            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_set_size error."});
         }
-    }
 
-    rv = xrif_set_size(m_xrif, m_width, m_height, 1, m_writeChunkLength, m_dataType);
-    if (rv != XRIF_NOERROR)
-    {
-        return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_set_size error."});
-    }
+        rv = xrif_allocate_raw(slot.m_xrif);
+        if (rv != XRIF_NOERROR)
+        {
+            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_allocate_raw error."});
+        }
 
-    rv = xrif_allocate_raw(m_xrif);
-    if (rv != XRIF_NOERROR)
-    {
-        return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_allocate_raw error."});
-    }
+        rv = xrif_allocate_reordered(slot.m_xrif);
+        if (rv != XRIF_NOERROR)
+        {
+            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_allocate_reordered error."});
+        }
 
-    rv = xrif_allocate_reordered(m_xrif);
-    if (rv != XRIF_NOERROR)
-    {
-        return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_allocate_reordered error."});
-    }
+        // Set up the timing data xrif handle
+        rv = xrif_configure(slot.m_xrif_timing, XRIF_DIFFERENCE_NONE, XRIF_REORDER_NONE, XRIF_COMPRESS_NONE);
+        if (rv != XRIF_NOERROR)
+        {
+            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
+        }
 
-    // Set up the timing data xrif handle
-    rv = xrif_configure(m_xrif_timing, XRIF_DIFFERENCE_NONE, XRIF_REORDER_NONE, XRIF_COMPRESS_NONE);
-    if (rv != XRIF_NOERROR)
-    {
-        return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif handle configuration error."});
-    }
+        rv = xrif_set_size(slot.m_xrif_timing, 5, 1, 1, slabLength, XRIF_TYPECODE_UINT64);
+        if (rv != XRIF_NOERROR)
+        {
+            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_set_size error."});
+        }
 
-    rv = xrif_set_size(m_xrif_timing, 5, 1, 1, m_writeChunkLength, XRIF_TYPECODE_UINT64);
-    if (rv != XRIF_NOERROR)
-    {
-        return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_set_size error."});
-    }
+        rv = xrif_allocate_raw(slot.m_xrif_timing);
+        if (rv != XRIF_NOERROR)
+        {
+            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_allocate_raw error."});
+        }
 
-    rv = xrif_allocate_raw(m_xrif_timing);
-    if (rv != XRIF_NOERROR)
-    {
-        return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_allocate_raw error."});
-    }
+        rv = xrif_allocate_reordered(slot.m_xrif_timing);
+        if (rv != XRIF_NOERROR)
+        {
+            return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_allocate_reordered error."});
+        }
 
-    rv = xrif_allocate_reordered(m_xrif_timing);
-    if (rv != XRIF_NOERROR)
-    {
-        return log<software_critical, -1>({__FILE__, __LINE__, 0, rv, "xrif_allocate_reordered error."});
+        // The O_DIRECT buffer holds both headers and both raw buffers, rounded up to whole blocks.
+        size_t directSz = 2 * XRIF_HEADER_SIZE + slot.m_xrif->raw_buffer_size + slot.m_xrif_timing->raw_buffer_size;
+        directSz = ((directSz + SW_DIRECT_ALIGN - 1) / SW_DIRECT_ALIGN) * SW_DIRECT_ALIGN;
+
+        if (m_directIO && directSz > slot.m_directBuffSz)
+        {
+            if (slot.m_directBuff)
+            {
+                free(slot.m_directBuff);
+                slot.m_directBuff = nullptr;
+                slot.m_directBuffSz = 0;
+            }
+
+            void *buff;
+            int prv = posix_memalign(&buff, SW_DIRECT_ALIGN, directSz);
+            if (prv != 0)
+            {
+                return log<software_critical, -1>({__FILE__, __LINE__, prv, 0, "O_DIRECT buffer allocation failed."});
+            }
+
+            slot.m_directBuff = (char *)buff;
+            slot.m_directBuffSz = directSz;
+        }
     }
 
+    m_maxQueueDepth = 0;
+    m_slotStalls = 0;
+
     return 0;
 }
 
@@ -909,6 +1354,24 @@ void streamWriter::fgThreadExec()
         if (allocate_xrif() < 0)
             return; // Will cause shutdown!
 
+        m_zcActive = false;
+        if (m_zeroCopy)
+        {
+            if (image.cntarray && image.md[0].naxis == 3 && length > 2 * m_zeroCopyMargin)
+            {
+                m_zcRing = (char *)image.array.raw;
+                m_zcRingDepth = length;
+                m_zcCnt0 = &image.md[0].cnt0;
+                m_zcActive = true;
+
+                log<text_log>("zero-copy active with source ring depth " + std::to_string(length), logPrio::LOG_INFO);
+            }
+            else
+            {
+                log<text_log>("zero-copy not possible for " + m_shmimName + ", copying frames on receipt", logPrio::LOG_NOTICE);
+            }
+        }
+
         uint8_t atype;
         size_t snx, sny, snz;
 
@@ -1011,16 +1474,26 @@ void streamWriter::fgThreadExec()
                 if (new_cnt0 - last_cnt0 > 1) //<- this is what we want to check.
                 {
                     log<text_log>("cnt0 changed by more than 1. Frame skipped.", logPrio::LOG_WARNING);
+                    m_framesSkipped += new_cnt0 - last_cnt0 - 1;
                 }
 
                 cnt0flag = 0;
 
                 last_cnt0 = new_cnt0;
 
-                char *curr_dest = m_rawImageCircBuff + m_currImage * m_width * m_height * m_typeSize;
-                char *curr_src = (char *)image.array.raw + curr_image * m_width * m_height * m_typeSize;
+                ++m_framesReceived;
 
-                memcpy(curr_dest, curr_src, m_width * m_height * m_typeSize);
+                if (m_zcActive)
+                {
+                    m_zcState[m_currImage].store(curr_image, std::memory_order_release);
+                }
+                else
+                {
+                    char *curr_dest = m_rawImageCircBuff + m_currImage * m_width * m_height * m_typeSize;
+                    char *curr_src = (char *)image.array.raw + curr_image * m_width * m_height * m_typeSize;
+
+                    memcpy(curr_dest, curr_src, m_width * m_height * m_typeSize);
+                }
 
                 uint64_t *curr_timing = m_timingCircBuff + 5 * m_currImage;
 
@@ -1169,6 +1642,23 @@ void streamWriter::fgThreadExec()
                         break;
                 }
 
+                if (m_zcActive)
+                {
+                    if (m_writing == NOT_WRITING)
+                    {
+                        // Nothing received so far will be encoded.
+                        m_zcPending = m_currImage + 1;
+                        if (m_zcPending >= m_circBuffLength)
+                        {
+                            m_zcPending = 0;
+                        }
+                    }
+                    else
+                    {
+                        rescueFrames(new_cnt0);
+                    }
+                }
+
                 ++m_currImage;
                 if (m_currImage >= m_circBuffLength)
                 {
@@ -1331,6 +1821,10 @@ void streamWriter::fgThreadExec()
                 ///\todo is this release necessary with closeIM?
                 image.semReadPID[m_semaphoreNumber] = 0; // release semaphore
             }
+            m_zcActive = false;
+            m_zcRing = nullptr;
+            m_zcCnt0 = nullptr;
+
             ImageStreamIO_closeIm(&image);
             opened = false;
         }
@@ -1474,32 +1968,172 @@ int streamWriter::doEncode()
     std::cerr << "nFrames: " << nFrames << "\n";
     #endif
 
+    // Split the chunk into slabs, one per compression thread, each of which is a complete xrif file.
+    size_t nSlabs = m_compressThreads;
+    if (nSlabs > nFrames)
+    {
+        nSlabs = nFrames;
+    }
+    if (nSlabs < 1)
+    {
+        nSlabs = 1;
+    }
+
+    // Get the free slots, waiting for the file writer if needed.
+    std::vector<size_t> slotNos(nSlabs);
+    {
+        std::unique_lock<std::mutex> lock(m_slotMutex);
+
+        if (m_freeSlots.size() < nSlabs)
+        {
+            ++m_slotStalls;
+        }
+
+        while (m_freeSlots.size() < nSlabs)
+        {
+            if (!m_fwRunning)
+            {
+                // The file writer is not running, so write in this thread.
+                lock.unlock();
+                if (writeQueued() < 0)
+                {
+                    return -1;
+                }
+                lock.lock();
+                continue;
+            }
+
+            m_slotCond.wait_for(lock, std::chrono::milliseconds(100));
+        }
+
+        for (size_t n = 0; n < nSlabs; ++n)
+        {
+            slotNos[n] = m_freeSlots.front();
+            m_freeSlots.pop_front();
+        }
+    }
+
+    double t0 = mx::sys::get_curr_time();
+
+    // Frames are spread as evenly as possible, with the first slabs getting any extra.
+    std::vector<compressJob> jobs(nSlabs);
+    size_t frameStart = saveStart;
+    for (size_t n = 0; n < nSlabs; ++n)
+    {
+        jobs[n].m_slotNo = slotNos[n];
+        jobs[n].m_frameStart = frameStart;
+        jobs[n].m_nFrames = nFrames / nSlabs + (n < nFrames % nSlabs ? 1 : 0);
+        frameStart += jobs[n].m_nFrames;
+    }
+
+    if (m_compressWorkers.size() > 0 && nSlabs > 1)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_compressMutex);
+            for (size_t n = 0; n < nSlabs; ++n)
+            {
+                m_compressJobs.push_back(jobs[n]);
+            }
+            m_compressPending += nSlabs;
+        }
+        m_compressCond.notify_all();
+
+        std::unique_lock<std::mutex> lock(m_compressMutex);
+        while (m_compressPending > 0)
+        {
+            m_compressDoneCond.wait_for(lock, std::chrono::milliseconds(100));
+        }
+    }
+    else
+    {
+        for (size_t n = 0; n < nSlabs; ++n)
+        {
+            encodeSlab(jobs[n]);
+        }
+    }
+
+    m_encodeTime = mx::sys::get_curr_time() - t0;
+    if (m_encodeTime > 0)
+    {
+        m_encodeRate = (nFrames * nBytes) / m_encodeTime;
+    }
+
+    m_xrif = m_slots[slotNos[0]].m_xrif;
+
+    // The last file name, for the test harness and debugging.
+    snprintf(m_fname, m_fnameSz, "%s", m_slots[slotNos[nSlabs - 1]].m_fileName.c_str());
+
+    recordSavingStats(true);
+
+    // Hand off to the file writer, in frame order
+    {
+        std::lock_guard<std::mutex> lock(m_slotMutex);
+
+        double qt = mx::sys::get_curr_time();
+        for (size_t n = 0; n < nSlabs; ++n)
+        {
+            m_slots[slotNos[n]].m_queuedTime = qt;
+            m_writeQueue.push_back(slotNos[n]);
+        }
+
+        m_queueDepth = m_writeQueue.size();
+        if (m_queueDepth > m_maxQueueDepth)
+        {
+            m_maxQueueDepth = m_queueDepth;
+        }
+    }
+    m_slotCond.notify_all();
+
+    // The data are out of the circular buffer now, so we're done with this chunk.
+    if (m_writing == STOP_WRITING)
+    {
+        m_writing = NOT_WRITING;
+        log<saving_stop>({0, saveStopFrameNo});
+    }
+
+    recordSavingState(true);
+
+    return 0;
+
+} // doEncode
+
+void streamWriter::encodeSlab(const compressJob &job)
+{
+    writeSlot &slot = m_slots[job.m_slotNo];
+
+    uint64_t saveStart = job.m_frameStart;
+    size_t nFrames = job.m_nFrames;
+
     // Configure xrif and copy image data -- this does no allocations
-    int rv = xrif_set_size(m_xrif, m_width, m_height, 1, nFrames, m_dataType);
+    int rv = xrif_set_size(slot.m_xrif, m_width, m_height, 1, nFrames, m_dataType);
     if (rv != XRIF_NOERROR)
     {
         // This is a big problem.  Report it as "ALERT" and go on.
         log<software_alert>({__FILE__, __LINE__, 0, rv, "xrif set size error. DATA POSSIBLY LOST"});
     }
 
-    rv = xrif_set_lz4_acceleration(m_xrif, m_lz4accel);
+    rv = xrif_set_lz4_acceleration(slot.m_xrif, m_lz4accel);
     if (rv != XRIF_NOERROR)
     {
         // This may just be out of range, it's only an error.
         log<software_error>({__FILE__, __LINE__, 0, rv, "xrif set LZ4 acceleration error."});
     }
 
-    memcpy(m_xrif->raw_buffer, m_rawImageCircBuff + saveStart * nBytes, nFrames * nBytes);
+    size_t nLost = copyFrames(slot.m_xrif->raw_buffer, saveStart, nFrames);
+    if (nLost > 0)
+    {
+        log<text_log>(std::to_string(nLost) + " frames overwritten in source before copy. Zeroed in " + m_outName + " output.", logPrio::LOG_WARNING);
+    }
 
     // Configure xrif and copy timing data -- no allocations
-    rv = xrif_set_size(m_xrif_timing, 5, 1, 1, nFrames, XRIF_TYPECODE_UINT64);
+    rv = xrif_set_size(slot.m_xrif_timing, 5, 1, 1, nFrames, XRIF_TYPECODE_UINT64);
     if (rv != XRIF_NOERROR)
     {
         // This is a big problem.  Report it as "ALERT" and go on.
         log<software_alert>({__FILE__, __LINE__, 0, rv, "xrif set size error. DATA POSSIBLY LOST."});
     }
 
-    rv = xrif_set_lz4_acceleration(m_xrif_timing, m_lz4accel);
+    rv = xrif_set_lz4_acceleration(slot.m_xrif_timing, m_lz4accel);
     if (rv != XRIF_NOERROR)
     {
         // This may just be out of range, it's only an error.
@@ -1513,115 +2147,431 @@ int streamWriter::doEncode()
     }
     #endif
 
-    memcpy(m_xrif_timing->raw_buffer, m_timingCircBuff + saveStart * 5, nFrames * 5 * sizeof(uint64_t));
+    memcpy(slot.m_xrif_timing->raw_buffer, m_timingCircBuff + saveStart * 5, nFrames * 5 * sizeof(uint64_t));
 
-    rv = xrif_encode(m_xrif);
+    // Now break down the acq time of the first image in the slab for use in file name
+    // This is done from the copy, since the circular buffer is free to be overwritten after the copy.
+    tm uttime; // The broken down time.
+    timespec fts;
+    fts.tv_sec = ((uint64_t *)slot.m_xrif_timing->raw_buffer)[1];
+    fts.tv_nsec = ((uint64_t *)slot.m_xrif_timing->raw_buffer)[2];
+
+    if (gmtime_r(&fts.tv_sec, &uttime) == 0)
+    {
+        // Yell at operator but keep going
+        log<software_alert>({__FILE__, __LINE__, errno, 0, "gmtime_r error.  possible loss of timing information."});
+    }
+
+    rv = xrif_encode(slot.m_xrif);
     if (rv != XRIF_NOERROR)
     {
         // This is a big problem.  Report it as "ALERT" and go on.
         log<software_alert>({__FILE__, __LINE__, 0, rv, "xrif encode error. DATA POSSIBLY LOST."});
     }
 
-    rv = xrif_write_header(m_xrif_header, m_xrif);
+    rv = xrif_write_header(slot.m_xrif_header, slot.m_xrif);
     if (rv != XRIF_NOERROR)
     {
         // This is a big problem.  Report it as "ALERT" and go on.
         log<software_alert>({__FILE__, __LINE__, 0, rv, "xrif write header error. DATA POSSIBLY LOST."});
     }
 
-    rv = xrif_encode(m_xrif_timing);
+    rv = xrif_encode(slot.m_xrif_timing);
     if (rv != XRIF_NOERROR)
     {
         // This is a big problem.  Report it as "ALERT" and go on.
         log<software_alert>({__FILE__, __LINE__, 0, rv, "xrif encode error. DATA POSSIBLY LOST."});
     }
 
-    rv = xrif_write_header(m_xrif_timing_header, m_xrif_timing);
+    rv = xrif_write_header(slot.m_xrif_timing_header, slot.m_xrif_timing);
     if (rv != XRIF_NOERROR)
     {
         // This is a big problem.  Report it as "ALERT" and go on.
         log<software_alert>({__FILE__, __LINE__, 0, rv, "xrif write header error. DATA POSSIBLY LOST"});
     }
 
-    // Now break down the acq time of the first image in the buffer for use in file name
-    tm uttime; // The broken down time.
-    timespec *fts = (timespec *)(m_timingCircBuff + saveStart * 5 + 1);
+    char tstamp[sizeof("YYYYMMDDHHMMSSNNNNNNNNN")];
+    rv = snprintf(tstamp, sizeof(tstamp), "%04i%02i%02i%02i%02i%02i%09i", uttime.tm_year + 1900,
+                  uttime.tm_mon + 1, uttime.tm_mday, uttime.tm_hour, uttime.tm_min, uttime.tm_sec, static_cast<int>(fts.tv_nsec));
 
-    if (gmtime_r(&fts->tv_sec, &uttime) == 0)
+    if (rv != sizeof("YYYYMMDDHHMMSSNNNNNNNNN") - 1)
     {
-        // Yell at operator but keep going
-        log<software_alert>({__FILE__, __LINE__, errno, 0, "gmtime_r error.  possible loss of timing information."});
+        // Something is very wrong.  Keep going to try to get it on disk.
+        log<software_alert>({__FILE__, __LINE__, errno, rv, "did not write enough chars to timestamp"});
     }
 
-    // Available size = m_fnameSz-m_fnameBase.size(), rather than assuming sizeof("YYYYMMDDHHMMSSNNNNNNNNN"), in case we screwed up somewhere.
-    rv = snprintf(m_fname + m_fnameBase.size(), m_fnameSz - m_fnameBase.size(), "%04i%02i%02i%02i%02i%02i%09i", uttime.tm_year + 1900,
-                  uttime.tm_mon + 1, uttime.tm_mday, uttime.tm_hour, uttime.tm_min, uttime.tm_sec, static_cast<int>(fts->tv_nsec));
+    slot.m_fileName = m_fnameBase + tstamp + ".xrif";
+}
 
-    if (rv != sizeof("YYYYMMDDHHMMSSNNNNNNNNN") - 1)
+size_t streamWriter::copyFrames(char *dest,
+                                size_t frameStart,
+                                size_t nFrames)
+{
+    size_t frameBytes = m_width * m_height * m_typeSize;
+    size_t nLost = 0;
+
+    for (size_t n = 0; n < nFrames; ++n)
     {
-        // Something is very wrong.  Keep going to try to get it on disk.
-        log<software_alert>({__FILE__, __LINE__, errno, rv, "did not write enough chars to timestamp"});
+        size_t p = frameStart + n;
+        char *curr_dest = dest + n * frameBytes;
+
+        int64_t st = m_zcState[p].load(std::memory_order_acquire);
+
+        if (st >= 0)
+        {
+            uint64_t cnt0 = m_timingCircBuff[5 * p];
+
+            memcpy(curr_dest, m_zcRing + st * frameBytes, frameBytes);
+
+            // The copy is good if the source had not yet started writing frame cnt0 + depth into this slot.
+            uint64_t latest = __atomic_load_n(m_zcCnt0, __ATOMIC_ACQUIRE);
+            if (latest + 1 < cnt0 + m_zcRingDepth)
+            {
+                m_zcState[p].compare_exchange_strong(st, ZC_DONE);
+                continue;
+            }
+
+            // Too late.  If the framegrabber thread didn't rescue it first, it's lost.
+            if (m_zcState[p].compare_exchange_strong(st, ZC_LOST))
+            {
+                st = ZC_LOST;
+            }
+        }
+
+        if (st == ZC_INBUFF)
+        {
+            memcpy(curr_dest, m_rawImageCircBuff + p * frameBytes, frameBytes);
+        }
+        else
+        {
+            memset(curr_dest, 0, frameBytes);
+            ++nLost;
+        }
     }
 
-    // Cover up the \0 inserted by snprintf
-    (m_fname + m_fnameBase.size())[23] = '.';
+    m_framesLost += nLost;
+
+    return nLost;
+}
+
+void streamWriter::rescueFrames(uint64_t latestCnt0)
+{
+    size_t frameBytes = m_width * m_height * m_typeSize;
 
-    FILE *fp_xrif = fopen(m_fname, "wb");
-    if (fp_xrif == NULL)
+    while (m_zcPending != m_currImage)
     {
-        // This is it.  If we can't write data to disk need to fix.
-        log<software_alert>({__FILE__, __LINE__, errno, 0, "failed to open file for writing"});
+        size_t p = m_zcPending;
+        int64_t st = m_zcState[p].load(std::memory_order_acquire);
 
-        free(m_fname);
-        m_fname = nullptr;
+        if (st >= 0)
+        {
+            uint64_t cnt0 = m_timingCircBuff[5 * p];
 
-        return -1; // will trigger a shutdown
+            // Frames are in order, so if this one is not at risk none of the later ones are.
+            if (cnt0 + m_zcRingDepth > latestCnt0 + 1 + m_zeroCopyMargin)
+            {
+                break;
+            }
+
+            memcpy(m_rawImageCircBuff + p * frameBytes, m_zcRing + st * frameBytes, frameBytes);
+
+            uint64_t latest = __atomic_load_n(m_zcCnt0, __ATOMIC_ACQUIRE);
+            int64_t newSt = (latest + 1 < cnt0 + m_zcRingDepth) ? ZC_INBUFF : ZC_LOST;
+
+            // Fails if the encoder got to it first, in which case the copy isn't needed.
+            if (m_zcState[p].compare_exchange_strong(st, newSt) && newSt == ZC_INBUFF)
+            {
+                ++m_framesRescued;
+            }
+        }
+
+        ++m_zcPending;
+        if (m_zcPending >= m_circBuffLength)
+        {
+            m_zcPending = 0;
+        }
     }
+}
 
-    size_t bw = fwrite(m_xrif_header, sizeof(uint8_t), XRIF_HEADER_SIZE, fp_xrif);
+void streamWriter::cwThreadStart(compressWorker *w)
+{
+    w->m_sw->cwThreadExec(*w);
+}
 
-    if (bw != XRIF_HEADER_SIZE)
+void streamWriter::cwThreadExec(compressWorker &w)
+{
+    w.m_threadID = syscall(SYS_gettid);
+
+    // Wait fpr the thread starter to finish initializing this thread.
+    while (w.m_threadInit == true && m_shutdown == 0)
     {
-        log<software_alert>({__FILE__, __LINE__, errno, 0, "failure writing header to file.  DATA LOSS LIKELY. bytes = " + std::to_string(bw)});
-        // We go on . . .
+        sleep(1);
     }
 
-    bw = fwrite(m_xrif->raw_buffer, sizeof(uint8_t), m_xrif->compressed_size, fp_xrif);
+    // On shutdown any jobs left are finished, so the encoder doesn't wait forever.
+    while (true)
+    {
+        compressJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_compressMutex);
+            if (m_compressJobs.size() == 0)
+            {
+                if (m_shutdown)
+                {
+                    break;
+                }
 
-    if (bw != m_xrif->compressed_size)
+                m_compressCond.wait_for(lock, std::chrono::nanoseconds(m_semWaitNSec));
+                continue;
+            }
+
+            job = m_compressJobs.front();
+            m_compressJobs.pop_front();
+        }
+
+        encodeSlab(job);
+
+        {
+            std::lock_guard<std::mutex> lock(m_compressMutex);
+            --m_compressPending;
+        }
+        m_compressDoneCond.notify_all();
+    }
+}
+
+void streamWriter::fwThreadStart(streamWriter *s)
+{
+    s->fwThreadExec();
+}
+
+void streamWriter::fwThreadExec()
+{
+    m_fwThreadID = syscall(SYS_gettid);
+
+    // Wait fpr the thread starter to finish initializing this thread.
+    while (m_fwThreadInit == true && m_shutdown == 0)
     {
-        log<software_alert>({__FILE__, __LINE__, errno, 0, "failure writing data to file.  DATA LOSS LIKELY. bytes = " + std::to_string(bw)});
+        sleep(1);
     }
 
-    bw = fwrite(m_xrif_timing_header, sizeof(uint8_t), XRIF_HEADER_SIZE, fp_xrif);
+    while (!m_shutdown)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_slotMutex);
+            if (m_writeQueue.size() == 0)
+            {
+                m_slotCond.wait_for(lock, std::chrono::nanoseconds(m_semWaitNSec));
+            }
+        }
+
+        if (writeQueued() < 0)
+        {
+            log<software_critical>({__FILE__, __LINE__, "error writing data"});
+            break;
+        }
+    }
+
+    // Drain anything the encoder has finished.  Chunks encoded after this are written by appShutdown.
+    writeQueued();
+
+    m_fwThreadID = 0;
+    m_fwRunning = false;
+}
+
+int streamWriter::writeQueued()
+{
+    std::lock_guard<std::mutex> writeLock(m_fwWriteMutex);
 
-    if (bw != XRIF_HEADER_SIZE)
+    while (true)
     {
-        log<software_alert>({__FILE__, __LINE__, errno, 0, "failure writing timing header to file.  DATA LOSS LIKELY.  bytes = " + std::to_string(bw)});
+        size_t slotNo;
+        {
+            std::lock_guard<std::mutex> lock(m_slotMutex);
+            if (m_writeQueue.size() == 0)
+            {
+                return 0;
+            }
+
+            slotNo = m_writeQueue.front();
+        }
+
+        writeSlot &slot = m_slots[slotNo];
+
+        double t0 = mx::sys::get_curr_time();
+
+        int rv = writeSlotFile(slot);
+
+        double t1 = mx::sys::get_curr_time();
+
+        // Only release the slot after it is written, so the encoder can't overwrite it.
+        {
+            std::lock_guard<std::mutex> lock(m_slotMutex);
+            m_writeQueue.pop_front();
+            m_freeSlots.push_back(slotNo);
+            m_queueDepth = m_writeQueue.size();
+        }
+        m_slotCond.notify_all();
+
+        m_writeTime = t1 - t0;
+        m_writeLatency = t1 - slot.m_queuedTime;
+
+        if (rv < 0)
+        {
+            return -1;
+        }
     }
+}
 
-    bw = fwrite(m_xrif_timing->raw_buffer, sizeof(uint8_t), m_xrif_timing->compressed_size, fp_xrif);
+int streamWriter::writeSlotFile(writeSlot &slot)
+{
+    size_t totalSz = 2 * XRIF_HEADER_SIZE + slot.m_xrif->compressed_size + slot.m_xrif_timing->compressed_size;
+
+    int fd = -1;
+    bool direct = false;
 
-    if (bw != m_xrif_timing->compressed_size)
+    if (m_directIO && slot.m_directBuff)
     {
-        log<software_alert>({__FILE__, __LINE__, errno, 0, "failure writing timing data to file. DATA LOSS LIKELY. bytes = " + std::to_string(bw)});
+        errno = 0;
+        fd = open(slot.m_fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if (fd >= 0)
+        {
+            direct = true;
+        }
+        else if (errno == EINVAL)
+        {
+            // The filesystem does not support O_DIRECT.  Say so once, then stop trying.
+            log<text_log>("O_DIRECT not supported for " + m_rawimageDir + ", using buffered writes.", logPrio::LOG_NOTICE);
+            m_directIO = false;
+        }
     }
 
-    fclose(fp_xrif);
+    if (fd < 0)
+    {
+        errno = 0;
+        fd = open(slot.m_fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    }
 
-    recordSavingStats(true);
+    if (fd < 0)
+    {
+        // This is it.  If we can't write data to disk need to fix.
+        log<software_alert>({__FILE__, __LINE__, errno, 0, "failed to open file for writing"});
+        return -1; // will trigger a shutdown
+    }
 
-    if (m_writing == STOP_WRITING)
+    size_t writeSz = totalSz;
+    if (direct)
     {
-        m_writing = NOT_WRITING;
-        log<saving_stop>({0, saveStopFrameNo});
+        writeSz = ((totalSz + SW_DIRECT_ALIGN - 1) / SW_DIRECT_ALIGN) * SW_DIRECT_ALIGN;
     }
 
-    recordSavingState(true);
+    // Preallocate so the filesystem can lay out the file in one extent.
+    if (fallocate(fd, 0, 0, writeSz) < 0)
+    {
+        if (errno == ENOSPC)
+        {
+            log<software_alert>({__FILE__, __LINE__, errno, 0, "no space on device for file.  DATA LOSS. bytes = " + std::to_string(writeSz)});
+            close(fd);
+            return -1; // will trigger a shutdown
+        }
+        else if (errno != EOPNOTSUPP && errno != ENOSYS)
+        {
+            // Not being able to preallocate is not fatal, the write will still be tried.
+            log<software_error>({__FILE__, __LINE__, errno, 0, "fallocate failed"});
+        }
+    }
 
-    return 0;
+    ssize_t bw;
 
-} // doEncode
+    if (direct)
+    {
+        // Assemble the file in the aligned buffer.  This copies only the compressed data.
+        char *dest = slot.m_directBuff;
+        memcpy(dest, slot.m_xrif_header, XRIF_HEADER_SIZE);
+        dest += XRIF_HEADER_SIZE;
+        memcpy(dest, slot.m_xrif->raw_buffer, slot.m_xrif->compressed_size);
+        dest += slot.m_xrif->compressed_size;
+        memcpy(dest, slot.m_xrif_timing_header, XRIF_HEADER_SIZE);
+        dest += XRIF_HEADER_SIZE;
+        memcpy(dest, slot.m_xrif_timing->raw_buffer, slot.m_xrif_timing->compressed_size);
+        dest += slot.m_xrif_timing->compressed_size;
+        memset(dest, 0, writeSz - totalSz);
+
+        size_t done = 0;
+        while (done < writeSz)
+        {
+            bw = pwrite(fd, slot.m_directBuff + done, writeSz - done, done);
+            if (bw < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                break;
+            }
+            done += bw;
+        }
+
+        if (done != writeSz)
+        {
+            log<software_alert>({__FILE__, __LINE__, errno, 0, "failure writing to file.  DATA LOSS LIKELY. bytes = " + std::to_string(done)});
+        }
+
+        // Remove the padding
+        if (ftruncate(fd, totalSz) < 0)
+        {
+            log<software_alert>({__FILE__, __LINE__, errno, 0, "failure truncating file.  File has trailing padding."});
+        }
+    }
+    else
+    {
+        iovec iov[4];
+        iov[0].iov_base = slot.m_xrif_header;
+        iov[0].iov_len = XRIF_HEADER_SIZE;
+        iov[1].iov_base = slot.m_xrif->raw_buffer;
+        iov[1].iov_len = slot.m_xrif->compressed_size;
+        iov[2].iov_base = slot.m_xrif_timing_header;
+        iov[2].iov_len = XRIF_HEADER_SIZE;
+        iov[3].iov_base = slot.m_xrif_timing->raw_buffer;
+        iov[3].iov_len = slot.m_xrif_timing->compressed_size;
+
+        size_t done = 0;
+        int iovn = 0;
+        while (iovn < 4)
+        {
+            bw = writev(fd, iov + iovn, 4 - iovn);
+            if (bw < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                break;
+            }
+            done += bw;
+
+            // Advance past what was written, in case of a short write.
+            while (iovn < 4 && (size_t)bw >= iov[iovn].iov_len)
+            {
+                bw -= iov[iovn].iov_len;
+                ++iovn;
+            }
+            if (iovn < 4)
+            {
+                iov[iovn].iov_base = (char *)iov[iovn].iov_base + bw;
+                iov[iovn].iov_len -= bw;
+            }
+        }
+
+        if (done != totalSz)
+        {
+            log<software_alert>({__FILE__, __LINE__, errno, 0, "failure writing to file.  DATA LOSS LIKELY. bytes = " + std::to_string(done)});
+        }
+    }
+
+    close(fd);
+
+    return 0;
+}
 
 INDI_NEWCALLBACK_DEFN(streamWriter, m_indiP_writing)
 (const pcf::IndiProperty &ipRecv)
@@ -1648,6 +2598,12 @@ INDI_NEWCALLBACK_DEFN(streamWriter, m_indiP_writing)
 
 void streamWriter::updateINDI()
 {
+    indi::updateIfChanged(m_indiP_frames, "received", (double)m_framesReceived, m_indiDriver, INDI_IDLE);
+    indi::updateIfChanged(m_indiP_frames, "skipped", (double)m_framesSkipped, m_indiDriver, INDI_IDLE);
+    indi::updateIfChanged(m_indiP_frames, "rescued", (double)m_framesRescued, m_indiDriver, INDI_IDLE);
+    indi::updateIfChanged(m_indiP_frames, "lost", (double)m_framesLost, m_indiDriver, (m_framesLost > 0) ? INDI_ALERT : INDI_IDLE);
+    indi::updateIfChanged(m_indiP_frames, "zeroCopy", (int)m_zcActive, m_indiDriver, INDI_IDLE);
+
     // Only update this if not changing
     if (m_writing == NOT_WRITING || m_writing == WRITING)
     {
@@ -1663,6 +2619,14 @@ void streamWriter::updateINDI()
             indi::updateIfChanged(m_indiP_xrifStats, "reorderFPS", m_xrif->reorder_rate / (m_width * m_height * m_typeSize), m_indiDriver, INDI_BUSY);
             indi::updateIfChanged(m_indiP_xrifStats, "compressMBsec", m_xrif->compress_rate / 1048576.0, m_indiDriver, INDI_BUSY);
             indi::updateIfChanged(m_indiP_xrifStats, "compressFPS", m_xrif->compress_rate / (m_width * m_height * m_typeSize), m_indiDriver, INDI_BUSY);
+
+            indi::updateIfChanged(m_indiP_pipeline, "encode_ms", m_encodeTime * 1000.0, m_indiDriver, INDI_BUSY);
+            indi::updateIfChanged(m_indiP_pipeline, "encodeMBsec", m_encodeRate / 1048576.0, m_indiDriver, INDI_BUSY);
+            indi::updateIfChanged(m_indiP_pipeline, "write_ms", m_writeTime * 1000.0, m_indiDriver, INDI_BUSY);
+            indi::updateIfChanged(m_indiP_pipeline, "latency_ms", m_writeLatency * 1000.0, m_indiDriver, INDI_BUSY);
+            indi::updateIfChanged(m_indiP_pipeline, "queueDepth", (int)m_queueDepth, m_indiDriver, INDI_BUSY);
+            indi::updateIfChanged(m_indiP_pipeline, "maxQueueDepth", (int)m_maxQueueDepth, m_indiDriver, INDI_BUSY);
+            indi::updateIfChanged(m_indiP_pipeline, "stalls", (int)m_slotStalls, m_indiDriver, INDI_BUSY);
         }
         else
         {
@@ -1676,6 +2640,14 @@ void streamWriter::updateINDI()
             indi::updateIfChanged(m_indiP_xrifStats, "reorderFPS", 0.0, m_indiDriver, INDI_IDLE);
             indi::updateIfChanged(m_indiP_xrifStats, "compressMBsec", 0.0, m_indiDriver, INDI_IDLE);
             indi::updateIfChanged(m_indiP_xrifStats, "compressFPS", 0.0, m_indiDriver, INDI_IDLE);
+
+            indi::updateIfChanged(m_indiP_pipeline, "encode_ms", m_encodeTime * 1000.0, m_indiDriver, INDI_IDLE);
+            indi::updateIfChanged(m_indiP_pipeline, "encodeMBsec", m_encodeRate / 1048576.0, m_indiDriver, INDI_IDLE);
+            indi::updateIfChanged(m_indiP_pipeline, "write_ms", m_writeTime * 1000.0, m_indiDriver, INDI_IDLE);
+            indi::updateIfChanged(m_indiP_pipeline, "latency_ms", m_writeLatency * 1000.0, m_indiDriver, INDI_IDLE);
+            indi::updateIfChanged(m_indiP_pipeline, "queueDepth", (int)m_queueDepth, m_indiDriver, INDI_IDLE);
+            indi::updateIfChanged(m_indiP_pipeline, "maxQueueDepth", (int)m_maxQueueDepth, m_indiDriver, INDI_IDLE);
+            indi::updateIfChanged(m_indiP_pipeline, "stalls", (int)m_slotStalls, m_indiDriver, INDI_IDLE);
         }
     }
 }
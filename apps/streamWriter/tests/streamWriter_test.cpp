@@ -101,28 +101,151 @@ struct streamWriter_test
       m_sw->m_currSaveStopFrameNo = stop;
       
       m_sw->m_writing = WRITING;
-      return m_sw->doEncode();
+      int rv = m_sw->doEncode();
+      if(rv < 0) return rv;
+
+      //No file writer thread in the test, so write here.
+      return m_sw->writeQueued();
    }
    
+   //Encode without writing, leaving the chunk in the write queue.
+   int encode_frames( int start,
+                      int stop
+                    )
+   {
+      m_sw->m_currSaveStart = start;
+      m_sw->m_currSaveStop = stop;
+      m_sw->m_currSaveStopFrameNo = stop;
+
+      m_sw->m_writing = WRITING;
+      return m_sw->doEncode();
+   }
+
+   int write_queued()
+   {
+      return m_sw->writeQueued();
+   }
+
+   size_t queued()
+   {
+      return m_sw->m_writeQueue.size();
+   }
+
+   void compress_threads( size_t n )
+   {
+      m_sw->m_compressThreads = n;
+   }
+
+   //The file names of the queued slots, in order.
+   std::vector<std::string> queued_files()
+   {
+      std::vector<std::string> names;
+      for(size_t n = 0; n < m_sw->m_writeQueue.size(); ++n)
+      {
+         names.push_back(m_sw->m_slots[m_sw->m_writeQueue[n]].m_fileName);
+      }
+      return names;
+   }
+
+   size_t free_slots()
+   {
+      return m_sw->m_freeSlots.size();
+   }
+
+   std::string fname()
+   {
+      return m_sw->m_fname;
+   }
+
+   std::vector<char> m_ring;  //A fake source ring for zero-copy
+   std::vector<char> m_saved; //The original circular buffer contents
+   uint64_t m_cnt0 {0};       //The fake source cnt0
+
+   //Move frames [start,stop) from the circular buffer to a fake source ring, as the framegrabber does in zero-copy mode.
+   void setup_zero_copy( size_t depth,
+                         size_t start,
+                         size_t stop
+                       )
+   {
+      size_t fb = m_sw->m_width*m_sw->m_height*m_sw->m_typeSize;
+
+      m_ring.assign(depth*fb, 0);
+      m_saved.assign(m_sw->m_rawImageCircBuff, m_sw->m_rawImageCircBuff + m_sw->m_circBuffLength*fb);
+
+      for(size_t p = start; p < stop; ++p)
+      {
+         size_t slot = m_sw->m_timingCircBuff[5*p] % depth;
+         memcpy(m_ring.data() + slot*fb, m_sw->m_rawImageCircBuff + p*fb, fb);
+         memset(m_sw->m_rawImageCircBuff + p*fb, 0, fb);
+         m_sw->m_zcState[p] = slot;
+      }
+
+      m_sw->m_zcRing = m_ring.data();
+      m_sw->m_zcRingDepth = depth;
+      m_sw->m_zcCnt0 = &m_cnt0;
+      m_sw->m_zcActive = true;
+   }
+
+   void source_cnt0( uint64_t cnt0 )
+   {
+      m_cnt0 = cnt0;
+   }
+
+   void rescue( size_t pending,
+                size_t currImage
+              )
+   {
+      m_sw->m_zcPending = pending;
+      m_sw->m_currImage = currImage;
+      m_sw->rescueFrames(m_cnt0);
+   }
+
+   //Put the original frames back in the circular buffer for comparison, with lost frames zeroed.
+   void restore_circbuf( const std::vector<size_t> & lost )
+   {
+      size_t fb = m_sw->m_width*m_sw->m_height*m_sw->m_typeSize;
+
+      memcpy(m_sw->m_rawImageCircBuff, m_saved.data(), m_saved.size());
+      for(size_t n = 0; n < lost.size(); ++n) memset(m_sw->m_rawImageCircBuff + lost[n]*fb, 0, fb);
+   }
+
+   uint64_t frames_lost()
+   {
+      return m_sw->m_framesLost;
+   }
+
+   uint64_t frames_rescued()
+   {
+      return m_sw->m_framesRescued;
+   }
+
    //Read the xrif archive back in and compare the results.
    int comp_frames_uint16( size_t start,
                            size_t stop
                          )
    {
+      return comp_frames_uint16(m_sw->m_fname, start, stop);
+   }
+
+   int comp_frames_uint16( const std::string & fname,
+                           size_t start,
+                           size_t stop
+                         )
+   {
       
-      std::cout << "Reading: " << m_sw->m_fname << "\n";
+      std::cout << "Reading: " << fname << "\n";
   
       xrif_t xrif;
       xrif_error_t xrv = xrif_new(&xrif);
       
       char header[XRIF_HEADER_SIZE];
       
-      FILE * fp_xrif = fopen(m_sw->m_fname, "rb");
+      FILE * fp_xrif = fopen(fname.c_str(), "rb");
       size_t nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
       
       if(nr != XRIF_HEADER_SIZE)
       {
-         std::cerr << "Error reading header of " << m_sw->m_fname  << "\n";
+         std::cerr << "Error reading header of " << fname  << "\n";
          fclose(fp_xrif);
          return -1;
       }
@@ -277,5 +400,129 @@ SCENARIO( "streamWriter encoding data", "[streamWriter]" )
          
          REQUIRE(sw_test.comp_frames_uint16(5,8) == 0);
       }
+
+      WHEN("encoding two chunks before writing either")
+      {
+         int circBuffLength = 10;
+         int writeChunkLength = 5;
+         REQUIRE(sw_test.setup_circbufs(120, 120, XRIF_TYPECODE_UINT16, circBuffLength) == 0);
+         REQUIRE(sw_test.setup_xrif(writeChunkLength) == 0);
+         REQUIRE(sw_test.setup_fname() == 0);
+
+         REQUIRE(sw_test.fill_circbuf_uint16() == 0);
+
+         REQUIRE(sw_test.encode_frames(0,5) == 0);
+         std::string fname0 = sw_test.fname();
+
+         REQUIRE(sw_test.encode_frames(5,10) == 0);
+         std::string fname1 = sw_test.fname();
+
+         REQUIRE(fname0 != fname1);
+         REQUIRE(sw_test.queued() == 2);
+         REQUIRE(sw_test.free_slots() == 0);
+
+         REQUIRE(sw_test.write_queued() == 0);
+
+         REQUIRE(sw_test.queued() == 0);
+         REQUIRE(sw_test.free_slots() == 2);
+
+         REQUIRE(sw_test.comp_frames_uint16(fname0, 0, 5) == 0);
+         REQUIRE(sw_test.comp_frames_uint16(fname1, 5, 10) == 0);
+      }
+
+      WHEN("compressing a chunk in slabs")
+      {
+         int circBuffLength = 10;
+         int writeChunkLength = 5;
+         sw_test.compress_threads(3);
+         REQUIRE(sw_test.setup_circbufs(120, 120, XRIF_TYPECODE_UINT16, circBuffLength) == 0);
+         REQUIRE(sw_test.setup_xrif(writeChunkLength) == 0);
+         REQUIRE(sw_test.setup_fname() == 0);
+
+         REQUIRE(sw_test.fill_circbuf_uint16() == 0);
+
+         REQUIRE(sw_test.free_slots() == 6);
+
+         REQUIRE(sw_test.encode_frames(5,10) == 0);
+
+         //5 frames in 3 slabs is 2, 2, and 1, each a complete file.
+         std::vector<std::string> names = sw_test.queued_files();
+         REQUIRE(names.size() == 3);
+
+         REQUIRE(sw_test.write_queued() == 0);
+
+         REQUIRE(sw_test.comp_frames_uint16(names[0], 5, 7) == 0);
+         REQUIRE(sw_test.comp_frames_uint16(names[1], 7, 9) == 0);
+         REQUIRE(sw_test.comp_frames_uint16(names[2], 9, 10) == 0);
+      }
+
+      WHEN("encoding from the source ring with zero-copy")
+      {
+         int circBuffLength = 10;
+         int writeChunkLength = 5;
+         REQUIRE(sw_test.setup_circbufs(120, 120, XRIF_TYPECODE_UINT16, circBuffLength) == 0);
+         REQUIRE(sw_test.setup_xrif(writeChunkLength) == 0);
+         REQUIRE(sw_test.setup_fname() == 0);
+
+         REQUIRE(sw_test.fill_circbuf_uint16() == 0);
+
+         //Frames 5-9 are in a ring of 20, and the source is on frame 9
+         sw_test.setup_zero_copy(20, 5, 10);
+         sw_test.source_cnt0(9);
+
+         REQUIRE(sw_test.write_frames(5,10) == 0);
+
+         sw_test.restore_circbuf({});
+         REQUIRE(sw_test.comp_frames_uint16(5,10) == 0);
+         REQUIRE(sw_test.frames_lost() == 0);
+      }
+
+      WHEN("encoding from the source ring after a frame is overwritten")
+      {
+         int circBuffLength = 10;
+         int writeChunkLength = 5;
+         REQUIRE(sw_test.setup_circbufs(120, 120, XRIF_TYPECODE_UINT16, circBuffLength) == 0);
+         REQUIRE(sw_test.setup_xrif(writeChunkLength) == 0);
+         REQUIRE(sw_test.setup_fname() == 0);
+
+         REQUIRE(sw_test.fill_circbuf_uint16() == 0);
+
+         //The source is writing frame 25 into the slot of frame 5
+         sw_test.setup_zero_copy(20, 5, 10);
+         sw_test.source_cnt0(24);
+
+         REQUIRE(sw_test.write_frames(5,10) == 0);
+
+         sw_test.restore_circbuf({5});
+         REQUIRE(sw_test.comp_frames_uint16(5,10) == 0);
+         REQUIRE(sw_test.frames_lost() == 1);
+      }
+
+      WHEN("rescuing frames before they are overwritten")
+      {
+         int circBuffLength = 10;
+         int writeChunkLength = 5;
+         REQUIRE(sw_test.setup_circbufs(120, 120, XRIF_TYPECODE_UINT16, circBuffLength) == 0);
+         REQUIRE(sw_test.setup_xrif(writeChunkLength) == 0);
+         REQUIRE(sw_test.setup_fname() == 0);
+
+         REQUIRE(sw_test.fill_circbuf_uint16() == 0);
+
+         sw_test.setup_zero_copy(20, 5, 10);
+
+         //On frame 16 with a margin of 8, only frame 5 is at risk
+         sw_test.source_cnt0(16);
+         sw_test.rescue(5, 0);
+         REQUIRE(sw_test.frames_rescued() == 1);
+
+         //Now all of 5-9 have been overwritten in the ring
+         sw_test.source_cnt0(30);
+
+         REQUIRE(sw_test.write_frames(5,10) == 0);
+
+         sw_test.restore_circbuf({6,7,8,9});
+         REQUIRE(sw_test.comp_frames_uint16(5,10) == 0);
+         REQUIRE(sw_test.frames_lost() == 4);
+      }
    }
 }
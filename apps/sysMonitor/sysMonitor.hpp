@@ -29,6 +29,8 @@
 #include <iterator>
 #include <sys/wait.h>
 
+#include "sysMonitorReaders.hpp"
+
 
 namespace MagAOX
 {
@@ -75,6 +77,9 @@ protected:
    float m_bootUsage = 0;   ///< Disk usage in /boot path as a value out of 100
    float m_ramUsage = 0;   ///< RAM usage as a decimal value between 0 and 1
 
+   double m_diskTempInterval {1}; ///< The minimum time between reads of the drive temperatures, which can wake the drives [sec]
+   double m_chronyInterval {1};   ///< The minimum time between queries of chronyd [sec]
+
    /// Updates Indi property values of all system statistics
    /** This includes updating values for core loads, core temps, drive temps, / usage, /boot usage, /data usage, and RAM usage
      * Unsure if this method can fail in any way, as of now always returns 0
@@ -106,17 +111,26 @@ public:
    /// Implementation of reading and logging each of the measured statistics
    virtual int appLogic();
 
-   /// Do any needed shutdown tasks; currently nothing in this app
+   /// Joins the set latency thread and closes the /proc and /sys files
    virtual int appShutdown();
 
 
    /// Finds all CPU core temperatures
+   /** Reads the hwmon or thermal zone sensors found by openReaders.  If there are none, calls
+     * findCPUTemperaturesSensors.
+     *
+     * \returns -1 on error reading the sensors
+     * \returns 0 on successful completion otherwise
+     */
+   int findCPUTemperatures(std::vector<float>&  /**< [out] the vector of measured CPU core temperatures*/);
+
+   /// Finds all CPU core temperatures using the sensors command
    /** Makes system call and then parses result to add temperatures to vector of values
      *
      * \returns -1 on error with system command or output reading
      * \returns 0 on successful completion otherwise
      */
-   int findCPUTemperatures(std::vector<float>&  /**< [out] the vector of measured CPU core temperatures*/);
+   int findCPUTemperaturesSensors(std::vector<float>&  /**< [out] the vector of measured CPU core temperatures*/);
 
 
    /// Parses string from system call to find CPU temperatures
@@ -161,9 +175,10 @@ public:
    int criticalCoreTemperature( std::vector<float>&   /**< [in] the vector of temperature values to be checked*/);
 
    /// Finds all CPU core usage loads
-   /** Makes system call and then parses result to add usage loads to vector of values
+   /** Reads /proc/stat, and calculates the load of each core since the last call.  The first
+     * call gives the loads since boot.
      *
-     * \returns -1 on error with system command or output file reading
+     * \returns -1 on error reading or parsing /proc/stat
      * \returns 0 on completion
      */
    int findCPULoads( std::vector<float>&   /**< [out] the vector of measured CPU usages*/);
@@ -181,7 +196,19 @@ public:
 
 
    /// Finds all drive temperatures
-   /** Makes 'hddtemp' system call and then parses result to add temperatures to vector of values
+   /** Reads the drivetemp and nvme hwmon sensors found by openReaders.  The drives configured in
+     * diskNames which have no sensor, for instance because the drivetemp module is not loaded, are
+     * read with findDiskTemperatureHddtemp.
+     *
+     * \returns -1 on error reading the sensors
+     * \returns 0 on successful completion otherwise
+     */
+   int findDiskTemperature( std::vector<std::string>& hdd_names, ///< [out] the names of the drives
+                            std::vector<float>& hdd_temps        ///< [out] the vector of measured drive temperatures
+                          );
+
+   /// Finds drive temperatures using hddtemp
+   /** Makes 'hddtemp' system call for the drives in m_hddtempDisks and then parses result to add temperatures to vector of values
      * For hard drive temp utility:
      * `wget http://dl.fedoraproject.org/pub/epel/7/x86_64/Packages/h/hddtemp-0.3-0.31.beta15.el7.x86_64.rpm`
      * `su`
@@ -191,9 +218,9 @@ public:
      * \returns -1 on error with system command or output reading
      * \returns 0 on successful completion otherwise
      */
-   int findDiskTemperature( std::vector<std::string>& hdd_names, ///< [out] the names of the drives reported by hddtemp 
-                            std::vector<float>& hdd_temps        ///< [out] the vector of measured drive temperatures
-                          );
+   int findDiskTemperatureHddtemp( std::vector<std::string>& hdd_names, ///< [out] the names of the drives reported by hddtemp 
+                                   std::vector<float>& hdd_temps        ///< [out] the vector of measured drive temperatures
+                                 );
 
 
    /// Parses string from system call to find drive temperatures
@@ -219,11 +246,11 @@ public:
 
 
    /// Finds usages of space for following directory paths: /; /data; /boot
-   /** These usage values are stored as integer values between 0 and 100 (e.g. value of 39 means directory is 39% full)
-     * If directory is not found, space usage value will remain 0
-     * \TODO: What about multiple drives? What does this do?
+   /** These usage values are stored as decimal values between 0 and 1 (e.g. value of 0.39 means directory is 39% full),
+     * calculated from statvfs the way df does.
+     * If directory is not a mount point, space usage value will remain 0
      *
-     * \returns -1 on error with system command or output reading
+     * \returns -1 on error with statvfs
      * \returns 0 if at least one of the return values is found
      */
    int findDiskUsage( float&,   /**< [out] the return value for usage in root path*/
@@ -247,8 +274,9 @@ public:
 
    /// Finds current RAM usage
    /** This usage value is stored as a decimal value between 0 and 1 (e.g. value of 0.39 means RAM usage is 39%)
+     * It is MemTotal - MemAvailable from /proc/meminfo, which is the used memory reported by free.
      *
-     * \returns -1 on error with system command or output reading
+     * \returns -1 on error reading or parsing /proc/meminfo
      * \returns 0 on completion
      */
    int findRamUsage(float&    /**< [out] the return value for current RAM usage*/);
@@ -264,6 +292,84 @@ public:
                       float&    /**< [out] the return value for current RAM usage*/
                     );
 
+   /** \name Native Readers
+     * The statistics are read from files in /proc and /sys which are opened once, at startup, rather
+     * than by running mpstat, sensors, df, free and hddtemp.  Loads and counter rates are the changes
+     * since the previous sample, so they are averages over the loop interval, which can be set as short
+     * as 0.1 sec with loopPause.
+     *
+     * The interrupt, soft interrupt, and context switch rates of each core are published to find the
+     * source of jitter on the real-time cores.  The per-core context switches are the schedule counts
+     * from /proc/schedstat, which requires a kernel with CONFIG_SCHEDSTATS.  Without it only the total
+     * from /proc/stat is published.
+     * @{
+     */
+protected:
+   sysmon::procFile m_procStat;       ///< /proc/stat, for the core loads and the system wide counters
+   sysmon::procFile m_procMeminfo;    ///< /proc/meminfo, for the RAM usage
+   sysmon::procFile m_procInterrupts; ///< /proc/interrupts, for the interrupts of each core
+   sysmon::procFile m_procSoftirqs;   ///< /proc/softirqs, for the soft interrupts of each core
+   sysmon::procFile m_procSchedstat;  ///< /proc/schedstat, for the context switches of each core
+
+   std::vector<sysmon::cpuTimes> m_cpuTimes;     ///< The core times of the latest sample
+   std::vector<sysmon::cpuTimes> m_lastCpuTimes; ///< The core times of the previous sample
+   sysmon::statTotals m_statTotals;              ///< The system wide counters of the latest sample
+   sysmon::statTotals m_lastStatTotals;          ///< The system wide counters of the previous sample
+   double m_statTime {0};                        ///< The time of the latest sample of /proc/stat [sec]
+   double m_lastStatTime {0};                    ///< The time of the previous sample of /proc/stat [sec]
+
+   sysmon::cpuCountTable m_irqTable;            ///< Parser for /proc/interrupts
+   sysmon::cpuCountTable m_softirqTable;        ///< Parser for /proc/softirqs
+   std::vector<uint64_t> m_irqCounts;           ///< The interrupts of each core in the latest sample
+   std::vector<uint64_t> m_lastIrqCounts;       ///< The interrupts of each core in the previous sample
+   std::vector<uint64_t> m_softirqCounts;       ///< The soft interrupts of each core in the latest sample
+   std::vector<uint64_t> m_lastSoftirqCounts;   ///< The soft interrupts of each core in the previous sample
+   std::vector<uint64_t> m_ctxswCounts;         ///< The context switches of each core in the latest sample
+   std::vector<uint64_t> m_lastCtxswCounts;     ///< The context switches of each core in the previous sample
+   double m_countTime {0};                      ///< The time of the latest sample of the per-core counters [sec]
+   double m_lastCountTime {0};                  ///< The time of the previous sample of the per-core counters [sec]
+
+   std::vector<std::string> m_coreCountNames;   ///< The element names of the per-core counter properties, cpu0 to cpuN and total
+   std::vector<std::string> m_ctxswNames;       ///< The element names of the context switch property, just total without schedstat
+   std::vector<float> m_coreIrqRates;           ///< The interrupt rate of each core, and the total [1/sec]
+   std::vector<float> m_coreSoftirqRates;       ///< The soft interrupt rate of each core, and the total [1/sec]
+   std::vector<float> m_coreCtxswRates;         ///< The context switch rate of each core, and the total [1/sec]
+
+   pcf::IndiProperty m_indiP_core_irqs;     ///< Indi variable for reporting the interrupt rate of each core
+   pcf::IndiProperty m_indiP_core_softirqs; ///< Indi variable for reporting the soft interrupt rate of each core
+   pcf::IndiProperty m_indiP_core_ctxsw;    ///< Indi variable for reporting the context switch rate of each core
+
+   std::vector<sysmon::tempSensor> m_cpuTempSensors;   ///< The CPU core temperature sensors
+   std::vector<sysmon::tempSensor> m_driveTempSensors; ///< The drive temperature sensors
+   std::vector<std::string> m_hddtempDisks;            ///< The drives in diskNames which have no sensor, read with hddtemp
+
+   double m_lastDiskTempTime {0}; ///< The time the drive temperatures were last read [sec]
+   double m_lastChronyTime {0};   ///< The time chronyd was last queried [sec]
+
+public:
+   /// Opens the /proc files and finds the temperature sensors
+   /** Also takes the first sample of /proc/stat and of the per-core counters, so the first values
+     * reported by appLogic are for one loop interval.
+     *
+     * \returns -1 if /proc/stat or /proc/meminfo can not be opened
+     * \returns 0 on success
+     */
+   int openReaders();
+
+   /// Closes the /proc and /sys files
+   void closeReaders();
+
+   /// Finds the interrupt, soft interrupt, and context switch rates of each core
+   /** The rates are the changes since the last call divided by the time between them.  Uses the
+     * system wide counters from the last two calls to findCPULoads for the totals.
+     *
+     * \returns -1 on error reading or parsing /proc/interrupts or /proc/softirqs
+     * \returns 0 on success
+     */
+   int findCoreCounters();
+
+   ///@}
+
    /** \name Chrony Status
      * @{
      */
@@ -362,7 +468,6 @@ public:
 
 inline sysMonitor::sysMonitor() : MagAOXApp(MAGAOX_CURRENT_SHA1, MAGAOX_REPO_MODIFIED)
 {
-   //m_loopPause = 100000; //Set default to 1 milli-second due to mpstat averaging time of 1 sec.
    return;
 }
 
@@ -374,6 +479,8 @@ void sysMonitor::setupConfig()
    config.add("criticalCoreTemp", "", "criticalCoreTemp", argType::Required, "", "criticalCoreTemp", false, "int", "The critical temperature for CPU cores.");
    config.add("warningDiskTemp", "", "warningDiskTemp", argType::Required, "", "warningDiskTemp", false, "int", "The warning temperature for the disk.");
    config.add("criticalDiskTemp", "", "criticalDiskTemp", argType::Required, "", "criticalDiskTemp", false, "int", "The critical temperature for disk.");
+   config.add("diskTempInterval", "", "diskTempInterval", argType::Required, "", "diskTempInterval", false, "double", "The minimum time between reads of the drive temperatures [sec].  Default is 1.");
+   config.add("chronyInterval", "", "chronyInterval", argType::Required, "", "chronyInterval", false, "double", "The minimum time between queries of chronyd [sec].  Default is 1.");
 
    dev::telemeter<sysMonitor>::setupConfig(config);
 }
@@ -410,12 +517,18 @@ void sysMonitor::loadConfig()
    config(m_criticalCoreTemp, "criticalCoreTemp");
    config(m_warningDiskTemp, "warningDiskTemp");
    config(m_criticalDiskTemp, "criticalDiskTemp");
+   config(m_diskTempInterval, "diskTempInterval");
+   config(m_chronyInterval, "chronyInterval");
 
    dev::telemeter<sysMonitor>::loadConfig(config);
 }
 
 int sysMonitor::appStartup()
 {
+   if (openReaders() < 0)
+   {
+      return log<software_critical, -1>({ __FILE__, __LINE__ });
+   }
 
    REG_INDI_NEWPROP_NOCB(m_indiP_core_temps, "core_temps", pcf::IndiProperty::Number);
    m_indiP_core_temps.add(pcf::IndiElement("max"));
@@ -429,6 +542,7 @@ int sysMonitor::appStartup()
 
    REG_INDI_NEWPROP_NOCB(m_indiP_drive_temps, "drive_temps", pcf::IndiProperty::Number);
    findDiskTemperature(m_diskNames, m_diskTemps);
+   m_lastDiskTempTime = sysmon::monotonicTime();
    for (unsigned int i = 0; i < m_diskTemps.size(); i++)
    {
       m_indiP_drive_temps.add(pcf::IndiElement(m_diskNames[i]));
@@ -446,6 +560,19 @@ int sysMonitor::appStartup()
    m_indiP_usage["data_usage"].set<double>(0.0);
    m_indiP_usage["ram_usage"].set<double>(0.0);
 
+   REG_INDI_NEWPROP_NOCB(m_indiP_core_irqs, "core_irqs", pcf::IndiProperty::Number);
+   REG_INDI_NEWPROP_NOCB(m_indiP_core_softirqs, "core_softirqs", pcf::IndiProperty::Number);
+   for (size_t n = 0; n < m_coreCountNames.size(); ++n)
+   {
+      m_indiP_core_irqs.add(pcf::IndiElement(m_coreCountNames[n], 0.0));
+      m_indiP_core_softirqs.add(pcf::IndiElement(m_coreCountNames[n], 0.0));
+   }
+
+   REG_INDI_NEWPROP_NOCB(m_indiP_core_ctxsw, "core_ctxsw", pcf::IndiProperty::Number);
+   for (size_t n = 0; n < m_ctxswNames.size(); ++n)
+   {
+      m_indiP_core_ctxsw.add(pcf::IndiElement(m_ctxswNames[n], 0.0));
+   }
 
 
    REG_INDI_NEWPROP_NOCB(m_indiP_chronyStatus, "chrony_status", pcf::IndiProperty::Text);
@@ -515,32 +642,43 @@ int sysMonitor::appLogic()
       log<software_error>({ __FILE__, __LINE__,"Could not log values for CPU core loads." });
    }
 
-
-   m_diskNames.clear();
-   m_diskTemps.clear();
-   int rvDiskTemp = findDiskTemperature(m_diskNames, m_diskTemps);
-
-   if (rvDiskTemp >= 0)
+   if (findCoreCounters() < 0)
    {
-      rvDiskTemp = criticalDiskTemperature(m_diskTemps);
+      log<software_error>({ __FILE__, __LINE__,"Could not get per-core counters." });
    }
 
-   if (rvDiskTemp >= 0)
+   //Drive temperatures change slowly, and reading them can wake the drives.
+   double now = sysmon::monotonicTime();
+   if (now - m_lastDiskTempTime >= m_diskTempInterval)
    {
-      if (rvDiskTemp == 1)
+      m_lastDiskTempTime = now;
+
+      m_diskNames.clear();
+      m_diskTemps.clear();
+      int rvDiskTemp = findDiskTemperature(m_diskNames, m_diskTemps);
+
+      if (rvDiskTemp >= 0)
       {
-         log<telem_drivetemps>({ m_diskNames, m_diskTemps }, logPrio::LOG_WARNING);
+         rvDiskTemp = criticalDiskTemperature(m_diskTemps);
       }
-      else if (rvDiskTemp == 2)
+
+      if (rvDiskTemp >= 0)
       {
-         log<telem_drivetemps>({ m_diskNames, m_diskTemps }, logPrio::LOG_ALERT);
-      }
+         if (rvDiskTemp == 1)
+         {
+            log<telem_drivetemps>({ m_diskNames, m_diskTemps }, logPrio::LOG_WARNING);
+         }
+         else if (rvDiskTemp == 2)
+         {
+            log<telem_drivetemps>({ m_diskNames, m_diskTemps }, logPrio::LOG_ALERT);
+         }
 
-      recordDriveTemps();
-   }
-   else
-   {
-      log<software_error>({ __FILE__, __LINE__,"Could not log values for drive temps." });
+         recordDriveTemps();
+      }
+      else
+      {
+         log<software_error>({ __FILE__, __LINE__,"Could not log values for drive temps." });
+      }
    }
 
    int rvDiskUsage = findDiskUsage(m_rootUsage, m_dataUsage, m_bootUsage);
@@ -557,12 +695,17 @@ int sysMonitor::appLogic()
    }
 
 
-   if (findChronyStatus() == 0)
+   if (now - m_lastChronyTime >= m_chronyInterval)
    {
-   }
-   else
-   {
-      log<software_error>({ __FILE__, __LINE__,"Could not get chronyd status." });
+      m_lastChronyTime = now;
+
+      if (findChronyStatus() == 0)
+      {
+      }
+      else
+      {
+         log<software_error>({ __FILE__, __LINE__,"Could not get chronyd status." });
+      }
    }
 
    if (telemeter<sysMonitor>::appLogic() < 0)
@@ -587,12 +730,243 @@ int sysMonitor::appShutdown()
    }
    catch (...) {}
 
+   closeReaders();
+
    dev::telemeter<sysMonitor>::appShutdown();
 
    return 0;
 }
 
+int sysMonitor::openReaders()
+{
+   if (m_procStat.open("/proc/stat") < 0)
+   {
+      return log<software_error, -1>({ __FILE__, __LINE__, errno, "opening /proc/stat" });
+   }
+
+   if (m_procMeminfo.open("/proc/meminfo") < 0)
+   {
+      return log<software_error, -1>({ __FILE__, __LINE__, errno, "opening /proc/meminfo" });
+   }
+
+   if (m_procInterrupts.open("/proc/interrupts") < 0)
+   {
+      log<software_error>({ __FILE__, __LINE__, errno, "opening /proc/interrupts" });
+   }
+
+   if (m_procSoftirqs.open("/proc/softirqs") < 0)
+   {
+      log<software_error>({ __FILE__, __LINE__, errno, "opening /proc/softirqs" });
+   }
+
+   if (m_procSchedstat.open("/proc/schedstat") == 0)
+   {
+      std::vector<uint64_t> counts;
+      if (m_procSchedstat.read() < 0 || sysmon::parseSchedstat(counts, m_procSchedstat.data(), m_procSchedstat.size()) < 0)
+      {
+         m_procSchedstat.close();
+      }
+   }
+
+   if (!m_procSchedstat.isOpen())
+   {
+      log<text_log>("per-core context switches are not available without /proc/schedstat", logPrio::LOG_NOTICE);
+   }
+
+   //The CPU temperature sensors
+   if (m_sysType == sysType::AMD)
+   {
+      sysmon::findHwmonTemps(m_cpuTempSensors, "k10temp", "Tctl");
+   }
+   else
+   {
+      sysmon::findHwmonTemps(m_cpuTempSensors, "coretemp", "Core ");
+   }
+
+   if (m_cpuTempSensors.size() == 0)
+   {
+      sysmon::findThermalZones(m_cpuTempSensors, { "x86_pkg_temp", "cpu-thermal", "cpu_thermal" });
+   }
+
+   if (m_cpuTempSensors.size() == 0)
+   {
+      log<text_log>("no CPU temperature sensors found in /sys, using sensors", logPrio::LOG_WARNING);
+   }
+   else
+   {
+      if (m_warningCoreTemp == 0) m_warningCoreTemp = m_cpuTempSensors[0].max;
+      if (m_criticalCoreTemp == 0) m_criticalCoreTemp = m_cpuTempSensors[0].crit;
+   }
+
+   //The drive temperature sensors, in the order of diskNames
+   std::vector<sysmon::tempSensor> drives;
+   sysmon::findDriveTemps(drives);
+
+   if (m_diskNameList.size() == 0)
+   {
+      m_driveTempSensors = std::move(drives);
+   }
+
+   for (size_t n = 0; n < m_diskNameList.size(); ++n)
+   {
+      std::string disk = m_diskNameList[n];
+      if (disk.compare(0, 5, "/dev/") == 0) disk.erase(0, 5);
+
+      size_t d = 0;
+      for (; d < drives.size(); ++d)
+      {
+         if (drives[d].name == disk) break;
+      }
+
+      if (d < drives.size())
+      {
+         m_driveTempSensors.push_back(std::move(drives[d]));
+         drives.erase(drives.begin() + d);
+      }
+      else
+      {
+         m_hddtempDisks.push_back(m_diskNameList[n]);
+      }
+   }
+
+   if (m_hddtempDisks.size() > 0)
+   {
+      log<text_log>("no temperature sensor found in /sys for " + std::to_string(m_hddtempDisks.size()) + " drive(s), using hddtemp", logPrio::LOG_WARNING);
+   }
+
+   //The first samples, so the first loop reports one interval
+   std::vector<float> loads;
+   if (findCPULoads(loads) < 0)
+   {
+      return log<software_error, -1>({ __FILE__, __LINE__ });
+   }
+
+   findCoreCounters();
+
+   size_t ncpu = std::max(m_cpuTimes.size(), m_irqCounts.size());
+
+   m_coreCountNames.clear();
+   for (size_t n = 0; n < ncpu; ++n)
+   {
+      m_coreCountNames.push_back("cpu" + std::to_string(n));
+   }
+
+   if (m_procSchedstat.isOpen())
+   {
+      m_ctxswNames = m_coreCountNames;
+   }
+   else
+   {
+      m_ctxswNames.clear();
+   }
+
+   m_coreCountNames.push_back("total");
+   m_ctxswNames.push_back("total");
+
+   m_coreIrqRates.resize(m_coreCountNames.size(), 0);
+   m_coreSoftirqRates.resize(m_coreCountNames.size(), 0);
+   m_coreCtxswRates.resize(m_ctxswNames.size(), 0);
+
+   return 0;
+}
+
+void sysMonitor::closeReaders()
+{
+   m_procStat.close();
+   m_procMeminfo.close();
+   m_procInterrupts.close();
+   m_procSoftirqs.close();
+   m_procSchedstat.close();
+   m_cpuTempSensors.clear();
+   m_driveTempSensors.clear();
+}
+
+int sysMonitor::findCoreCounters()
+{
+   m_lastIrqCounts.swap(m_irqCounts);
+   m_lastSoftirqCounts.swap(m_softirqCounts);
+   m_lastCtxswCounts.swap(m_ctxswCounts);
+   m_lastCountTime = m_countTime;
+
+   m_countTime = sysmon::monotonicTime();
+
+   int rv = 0;
+
+   if (m_procInterrupts.read() < 0 || m_irqTable.parse(m_irqCounts, m_procInterrupts.data(), m_procInterrupts.size()) < 0)
+   {
+      m_irqCounts.clear();
+      rv = -1;
+   }
+
+   if (m_procSoftirqs.read() < 0 || m_softirqTable.parse(m_softirqCounts, m_procSoftirqs.data(), m_procSoftirqs.size()) < 0)
+   {
+      m_softirqCounts.clear();
+      rv = -1;
+   }
+
+   if (m_procSchedstat.isOpen())
+   {
+      if (m_procSchedstat.read() < 0 || sysmon::parseSchedstat(m_ctxswCounts, m_procSchedstat.data(), m_procSchedstat.size()) < 0)
+      {
+         m_ctxswCounts.clear();
+         rv = -1;
+      }
+   }
+
+   //Nothing to difference against on the first call
+   if (m_lastCountTime == 0 || m_countTime <= m_lastCountTime) return rv;
+
+   double dt = m_countTime - m_lastCountTime;
+
+   //The last entry of each is the total, so there is always one fewer core
+   for (size_t n = 0; n + 1 < m_coreIrqRates.size(); ++n)
+   {
+      if (n < m_irqCounts.size() && n < m_lastIrqCounts.size()) m_coreIrqRates[n] = sysmon::countRate(m_lastIrqCounts[n], m_irqCounts[n], dt);
+      else m_coreIrqRates[n] = 0;
+
+      if (n < m_softirqCounts.size() && n < m_lastSoftirqCounts.size()) m_coreSoftirqRates[n] = sysmon::countRate(m_lastSoftirqCounts[n], m_softirqCounts[n], dt);
+      else m_coreSoftirqRates[n] = 0;
+   }
+
+   for (size_t n = 0; n + 1 < m_coreCtxswRates.size(); ++n)
+   {
+      if (n < m_ctxswCounts.size() && n < m_lastCtxswCounts.size()) m_coreCtxswRates[n] = sysmon::countRate(m_lastCtxswCounts[n], m_ctxswCounts[n], dt);
+      else m_coreCtxswRates[n] = 0;
+   }
+
+   //The totals are over the interval of /proc/stat
+   if (m_lastStatTime > 0 && m_statTime > m_lastStatTime && m_coreIrqRates.size() > 0)
+   {
+      double sdt = m_statTime - m_lastStatTime;
+      m_coreIrqRates.back() = sysmon::countRate(m_lastStatTotals.intr, m_statTotals.intr, sdt);
+      m_coreSoftirqRates.back() = sysmon::countRate(m_lastStatTotals.softirq, m_statTotals.softirq, sdt);
+      m_coreCtxswRates.back() = sysmon::countRate(m_lastStatTotals.ctxt, m_statTotals.ctxt, sdt);
+   }
+
+   return rv;
+}
+
 int sysMonitor::findCPUTemperatures(std::vector<float>& temps)
+{
+   if (m_cpuTempSensors.size() == 0)
+   {
+      return findCPUTemperaturesSensors(temps);
+   }
+
+   int rv = -1;
+   for (size_t n = 0; n < m_cpuTempSensors.size(); ++n)
+   {
+      float tempVal;
+      if (m_cpuTempSensors[n].read(tempVal) == 0)
+      {
+         temps.push_back(tempVal);
+         rv = 0;
+      }
+   }
+   return rv;
+}
+
+int sysMonitor::findCPUTemperaturesSensors(std::vector<float>& temps)
 {
    std::vector<std::string> commandList{ "sensors" };
 
@@ -809,40 +1183,35 @@ int sysMonitor::criticalCoreTemperature(std::vector<float>& v)
 
 int sysMonitor::findCPULoads(std::vector<float>& loads)
 {
-   std::vector<std::string> commandList{ "mpstat", "-P", "ALL", "1", "1" };
-   std::vector<std::string> commandOutput, commandError;
+   m_lastCpuTimes.swap(m_cpuTimes);
+   m_lastStatTotals = m_statTotals;
+   m_lastStatTime = m_statTime;
 
-   if (sys::runCommand(commandOutput, commandError, commandList) < 0)
-   {
-      if (commandOutput.size() < 1) return log<software_error, -1>({ __FILE__, __LINE__ });
-      else return log<software_error, -1>({ __FILE__, __LINE__, commandOutput[0] });
-   }
+   m_statTime = sysmon::monotonicTime();
 
-   if (commandError.size() > 0)
+   if (m_procStat.read() < 0)
    {
-      for (size_t n = 0; n < commandError.size(); ++n)
-      {
-         log<software_error>({ __FILE__, __LINE__, "mpstat stderr: " + commandError[n] });
-      }
+      return log<software_error, -1>({ __FILE__, __LINE__, errno, "reading /proc/stat" });
    }
 
-   int rv = -1;
-   // If output lines are less than 5 (with one CPU, guarenteed output is 5)
-   if (commandOutput.size() < 5)
+   if (sysmon::parseProcStat(m_cpuTimes, m_statTotals, m_procStat.data(), m_procStat.size()) < 0)
    {
-      return log<software_error, -1>({ __FILE__, __LINE__, "not enough lines returned by mpstat" });
+      return log<software_error, -1>({ __FILE__, __LINE__, "no CPUs in /proc/stat" });
    }
-   //start iterating at fourth line
-   for (auto line = commandOutput.begin() + 4; line != commandOutput.end(); line++)
+
+   for (size_t n = 0; n < m_cpuTimes.size(); ++n)
    {
-      float loadVal;
-      if (parseCPULoads(loadVal, *line) == 0)
+      if (n < m_lastCpuTimes.size())
       {
-         loads.push_back(loadVal);
-         rv = 0;
+         loads.push_back(sysmon::cpuLoad(m_lastCpuTimes[n], m_cpuTimes[n]));
+      }
+      else
+      {
+         loads.push_back(sysmon::cpuLoad(sysmon::cpuTimes(), m_cpuTimes[n]));
       }
    }
-   return rv;
+
+   return 0;
 }
 
 int sysMonitor::parseCPULoads( float & loadVal,
@@ -882,11 +1251,48 @@ int sysMonitor::parseCPULoads( float & loadVal,
 int sysMonitor::findDiskTemperature( std::vector<std::string>& hdd_names,
                                      std::vector<float>& hdd_temps
                                    )
+{
+   int rv = -1;
+   for (size_t n = 0; n < m_driveTempSensors.size(); ++n)
+   {
+      float tempVal;
+      if (m_driveTempSensors[n].read(tempVal) < 0) continue;
+
+      hdd_names.push_back(m_driveTempSensors[n].name);
+      hdd_temps.push_back(tempVal);
+
+      //The same levels as parseDiskTemperature sets
+      if (m_warningDiskTemp == 0)
+      {
+         m_warningDiskTemp = tempVal + (.1 * tempVal);
+      }
+      if (m_criticalDiskTemp == 0)
+      {
+         m_criticalDiskTemp = tempVal + (.2 * tempVal);
+      }
+
+      rv = 0;
+   }
+
+   if (m_hddtempDisks.size() > 0)
+   {
+      if (findDiskTemperatureHddtemp(hdd_names, hdd_temps) == 0)
+      {
+         rv = 0;
+      }
+   }
+
+   return rv;
+}
+
+int sysMonitor::findDiskTemperatureHddtemp( std::vector<std::string>& hdd_names,
+                                            std::vector<float>& hdd_temps
+                                          )
 {
    std::vector<std::string> commandList{ "hddtemp" };
-   for (size_t n = 0;n < m_diskNameList.size();++n)
+   for (size_t n = 0;n < m_hddtempDisks.size();++n)
    {
-      commandList.push_back(m_diskNameList[n]);
+      commandList.push_back(m_hddtempDisks[n]);
    }
 
    std::vector<std::string> commandOutput, commandError;
@@ -1010,33 +1416,22 @@ int sysMonitor::criticalDiskTemperature(std::vector<float>& v)
 
 int sysMonitor::findDiskUsage(float& rootUsage, float& dataUsage, float& bootUsage)
 {
-   std::vector<std::string> commandList{ "df" };
+   int rv = -1;
 
-   std::vector<std::string> commandOutput, commandError;
+   int rvRoot = sysmon::diskUsage(rootUsage, "/");
+   int rvData = sysmon::diskUsage(dataUsage, "/data");
+   int rvBoot = sysmon::diskUsage(bootUsage, "/boot");
 
-   if (sys::runCommand(commandOutput, commandError, commandList) < 0)
+   if (rvRoot < 0 || rvData < 0 || rvBoot < 0)
    {
-      if (commandOutput.size() < 1) return log<software_error, -1>({ __FILE__, __LINE__ });
-      else return log<software_error, -1>({ __FILE__, __LINE__, commandOutput[0] });
+      log<software_error>({ __FILE__, __LINE__, errno, "statvfs failed" });
    }
 
-   if (commandError.size() > 0)
+   if (rvRoot == 0 || rvData == 0 || rvBoot == 0)
    {
-      for (size_t n = 0; n < commandError.size(); ++n)
-      {
-         log<software_error>({ __FILE__, __LINE__, "df stderr: " + commandError[n] });
-      }
+      rv = 0;
    }
 
-   int rv = -1;
-   for (auto line : commandOutput)
-   {
-      int rvDiskUsage = parseDiskUsage(line, rootUsage, dataUsage, bootUsage);
-      if (rvDiskUsage == 0)
-      {
-         rv = 0;
-      }
-   }
    return rv;
 }
 
@@ -1102,32 +1497,17 @@ int sysMonitor::parseDiskUsage(std::string line, float& rootUsage, float& dataUs
 
 int sysMonitor::findRamUsage(float& ramUsage)
 {
-   std::vector<std::string> commandList{ "free", "-m" };
-
-   std::vector<std::string> commandOutput, commandError;
-
-   if (sys::runCommand(commandOutput, commandError, commandList) < 0)
+   if (m_procMeminfo.read() < 0)
    {
-      if (commandOutput.size() < 1) return log<software_error, -1>({ __FILE__, __LINE__ });
-      else return log<software_error, -1>({ __FILE__, __LINE__, commandOutput[0] });
+      return log<software_error, -1>({ __FILE__, __LINE__, errno, "reading /proc/meminfo" });
    }
 
-   if (commandError.size() > 0)
+   if (sysmon::parseMeminfo(ramUsage, m_procMeminfo.data(), m_procMeminfo.size()) < 0)
    {
-      for (size_t n = 0; n < commandError.size(); ++n)
-      {
-         log<software_error>({ __FILE__, __LINE__, "free stderr: " + commandError[n] });
-      }
+      return log<software_error, -1>({ __FILE__, __LINE__, "error parsing /proc/meminfo" });
    }
 
-   for (auto line : commandOutput)
-   {
-      if (parseRamUsage(line, ramUsage) == 0)
-      {
-         return 0;
-      }
-   }
-   return -1;
+   return 0;
 }
 
 int sysMonitor::parseRamUsage(std::string line, float& ramUsage)
@@ -1276,6 +1656,10 @@ int sysMonitor::updateVals()
 
    updateIfChanged(m_indiP_drive_temps, m_diskNames, m_diskTemps);
 
+   updateIfChanged(m_indiP_core_irqs, m_coreCountNames, m_coreIrqRates);
+   updateIfChanged(m_indiP_core_softirqs, m_coreCountNames, m_coreSoftirqRates);
+   updateIfChanged(m_indiP_core_ctxsw, m_ctxswNames, m_coreCtxswRates);
+
    updateIfChanged<float>(m_indiP_usage, { "root_usage","boot_usage","data_usage","ram_usage" }, { m_rootUsage,m_bootUsage,m_dataUsage,m_ramUsage });
 
 
@@ -0,0 +1,754 @@
+/** \file sysMonitorReaders.hpp
+  * \brief Readers of the /proc and /sys files used by the MagAO-X system monitor
+  *
+  * \ingroup sysMonitor_files
+  */
+
+#ifndef sysMonitorReaders_hpp
+#define sysMonitorReaders_hpp
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+namespace MagAOX
+{
+namespace app
+{
+namespace sysmon
+{
+
+/// A file in /proc or /sys which is kept open and read again from the start for each sample.
+/** The kernel generates the contents of these files when they are read from offset 0, so one
+  * open followed by a pread for each sample replaces the open, read and close of each sample.
+  * The buffer grows to fit the file, after which reading allocates nothing.
+  */
+class procFile
+{
+protected:
+   std::string m_path;
+   int m_fd {-1};
+   std::vector<char> m_buf;
+   size_t m_size {0};
+
+public:
+   procFile()
+   {
+   }
+
+   procFile( const procFile & ) = delete;
+   procFile & operator=( const procFile & ) = delete;
+
+   procFile( procFile && pf )
+   {
+      *this = std::move(pf);
+   }
+
+   procFile & operator=( procFile && pf )
+   {
+      if(this == &pf) return *this;
+
+      close();
+      m_path = std::move(pf.m_path);
+      m_fd = pf.m_fd;
+      m_buf = std::move(pf.m_buf);
+      m_size = pf.m_size;
+
+      pf.m_fd = -1;
+      pf.m_size = 0;
+
+      return *this;
+   }
+
+   ~procFile()
+   {
+      close();
+   }
+
+   /// Open the file, closing any file already open.
+   /**
+     * \returns 0 on success
+     * \returns -1 if the file can not be opened
+     */
+   int open( const std::string & path /**< [in] the path of the file */)
+   {
+      close();
+
+      m_path = path;
+      m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if(m_fd < 0) return -1;
+
+      if(m_buf.size() == 0) m_buf.resize(4096);
+      m_buf[0] = '\0';
+
+      return 0;
+   }
+
+   /// Close the file.
+   void close()
+   {
+      if(m_fd >= 0) ::close(m_fd);
+      m_fd = -1;
+      m_size = 0;
+   }
+
+   /// Check if the file is open
+   bool isOpen() const
+   {
+      return (m_fd >= 0);
+   }
+
+   /// Get the path of the file
+   const std::string & path() const
+   {
+      return m_path;
+   }
+
+   /// Read the whole file into the buffer, which is then null terminated.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int read()
+   {
+      if(m_fd < 0) return -1;
+
+      m_size = 0;
+      while(true)
+      {
+         if(m_size + 1 >= m_buf.size()) m_buf.resize(2*m_buf.size());
+
+         ssize_t rv = ::pread(m_fd, m_buf.data() + m_size, m_buf.size() - m_size - 1, m_size);
+         if(rv < 0)
+         {
+            if(errno == EINTR) continue;
+            m_size = 0;
+            m_buf[0] = '\0';
+            return -1;
+         }
+
+         if(rv == 0) break;
+         m_size += rv;
+      }
+
+      m_buf[m_size] = '\0';
+      return 0;
+   }
+
+   /// Read the file as one integer, the form of the hwmon and thermal zone values.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int read( long long & val /**< [out] the value in the file */)
+   {
+      if(read() < 0) return -1;
+
+      char * end;
+      long long v = strtoll(m_buf.data(), &end, 10);
+      if(end == m_buf.data()) return -1;
+
+      val = v;
+      return 0;
+   }
+
+   /// Get the contents from the last read
+   const char * data() const
+   {
+      return m_buf.data();
+   }
+
+   /// Get the size of the contents from the last read
+   size_t size() const
+   {
+      return m_size;
+   }
+};
+
+/// Get the time on the monotonic clock, for the intervals between samples
+/**
+  * \returns the time in seconds since an arbitrary start
+  */
+inline
+double monotonicTime()
+{
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+/// Parse an unsigned integer, skipping leading spaces.
+/**
+  * \returns a pointer to the character after the number
+  * \returns nullptr if there is no number before the end
+  */
+inline
+const char * parseCount( uint64_t & val,   ///< [out] the number
+                         const char * p,   ///< [in] where to start
+                         const char * end  ///< [in] the end of the text
+                       )
+{
+   while(p < end && (*p == ' ' || *p == '\t')) ++p;
+   if(p == end || *p < '0' || *p > '9') return nullptr;
+
+   uint64_t v = 0;
+   while(p < end && *p >= '0' && *p <= '9')
+   {
+      v = 10*v + (*p - '0');
+      ++p;
+   }
+
+   val = v;
+   return p;
+}
+
+/// Find the start of the next line
+/**
+  * \returns a pointer to the first character after the next newline, or end
+  */
+inline
+const char * nextLine( const char * p,   ///< [in] where to start
+                       const char * end  ///< [in] the end of the text
+                     )
+{
+   const char * nl = static_cast<const char *>(memchr(p, '\n', end - p));
+   if(nl == nullptr) return end;
+   return nl + 1;
+}
+
+/// The jiffies spent by one CPU, from /proc/stat
+struct cpuTimes
+{
+   uint64_t busy {0};  ///< Time not idle or waiting for I/O
+   uint64_t total {0}; ///< All time
+};
+
+/// The system wide counters from /proc/stat
+struct statTotals
+{
+   uint64_t ctxt {0};    ///< Context switches
+   uint64_t intr {0};    ///< Interrupts
+   uint64_t softirq {0}; ///< Soft interrupts
+};
+
+/// Parse the contents of /proc/stat
+/** The times of each cpuN line are stored at index N, so CPUs which are offline keep their place.
+  * The first 8 fields, user through steal, are summed for the total.  The guest times are
+  * already counted in user and nice.
+  *
+  * \returns 0 on success
+  * \returns -1 if no CPU lines are found
+  */
+inline
+int parseProcStat( std::vector<cpuTimes> & cpus, ///< [out] the times of each CPU
+                   statTotals & totals,          ///< [out] the system wide counters
+                   const char * buf,             ///< [in] the contents of /proc/stat
+                   size_t sz                     ///< [in] the size of the contents
+                 )
+{
+   const char * end = buf + sz;
+   int ncpu = 0;
+
+   for(const char * p = buf; p < end; )
+   {
+      const char * nl = nextLine(p, end);
+      size_t len = nl - p;
+
+      if(len > 4 && strncmp(p, "cpu", 3) == 0 && p[3] >= '0' && p[3] <= '9')
+      {
+         uint64_t n = 0;
+         const char * q = parseCount(n, p + 3, nl);
+
+         uint64_t f[8] = {0,0,0,0,0,0,0,0};
+         int nf = 0;
+         while(q && nf < 8)
+         {
+            q = parseCount(f[nf], q, nl);
+            if(q) ++nf;
+         }
+
+         if(nf >= 4)
+         {
+            if(n >= cpus.size()) cpus.resize(n + 1);
+
+            uint64_t total = 0;
+            for(int k = 0; k < nf; ++k) total += f[k];
+
+            cpus[n].total = total;
+            cpus[n].busy = total - f[3] - f[4];
+            ++ncpu;
+         }
+      }
+      else if(len > 5 && strncmp(p, "ctxt ", 5) == 0)
+      {
+         parseCount(totals.ctxt, p + 5, nl);
+      }
+      else if(len > 5 && strncmp(p, "intr ", 5) == 0)
+      {
+         parseCount(totals.intr, p + 5, nl);
+      }
+      else if(len > 8 && strncmp(p, "softirq ", 8) == 0)
+      {
+         parseCount(totals.softirq, p + 8, nl);
+      }
+
+      p = nl;
+   }
+
+   if(ncpu == 0) return -1;
+   return 0;
+}
+
+/// Calculate the load of a CPU between two samples
+/**
+  * \returns the fraction of the time between the samples which the CPU was busy, between 0 and 1
+  */
+inline
+float cpuLoad( const cpuTimes & prev, ///< [in] the earlier sample
+               const cpuTimes & curr  ///< [in] the later sample
+             )
+{
+   if(curr.total <= prev.total) return 0;
+
+   //iowait can go backwards, so busy can too.
+   if(curr.busy <= prev.busy) return 0;
+
+   float load = static_cast<float>(curr.busy - prev.busy) / static_cast<float>(curr.total - prev.total);
+   if(load > 1) load = 1;
+
+   return load;
+}
+
+/// Calculate the rate of a counter between two samples
+/**
+  * \returns the change per second, or 0 if the counter went backwards
+  */
+inline
+float countRate( uint64_t prev, ///< [in] the earlier count
+                 uint64_t curr, ///< [in] the later count
+                 double dt      ///< [in] the time between the samples [sec]
+               )
+{
+   if(curr <= prev || dt <= 0) return 0;
+
+   return (curr - prev) / dt;
+}
+
+/// Sums the columns of a per-CPU table, such as /proc/interrupts and /proc/softirqs
+/** The header line names the CPU of each column, since CPUs which are offline have no column.
+  * Rows with fewer counts than columns, such as ERR and MIS in /proc/interrupts, are not per-CPU
+  * and are skipped.  The column map is kept between calls so parsing allocates nothing once the
+  * number of CPUs is known.
+  */
+class cpuCountTable
+{
+protected:
+   std::vector<size_t> m_cols; ///< The CPU number of each column
+
+public:
+
+   /// Parse the table
+   /**
+     * \returns 0 on success
+     * \returns -1 if there is no header
+     */
+   int parse( std::vector<uint64_t> & counts, ///< [out] the sum of the counts of each CPU, indexed by CPU number
+              const char * buf,               ///< [in] the contents of the table
+              size_t sz                       ///< [in] the size of the contents
+            )
+   {
+      const char * end = buf + sz;
+      const char * p = buf;
+      const char * nl = nextLine(p, end);
+
+      m_cols.clear();
+      size_t maxcpu = 0;
+      for(const char * q = p; q < nl; )
+      {
+         const char * c = static_cast<const char *>(memmem(q, nl - q, "CPU", 3));
+         if(c == nullptr) break;
+
+         uint64_t n = 0;
+         q = parseCount(n, c + 3, nl);
+         if(q == nullptr) break;
+
+         m_cols.push_back(n);
+         if(n > maxcpu) maxcpu = n;
+      }
+
+      if(m_cols.size() == 0) return -1;
+
+      counts.resize(maxcpu + 1);
+      for(size_t n = 0; n < counts.size(); ++n) counts[n] = 0;
+
+      for(p = nl; p < end; p = nl)
+      {
+         nl = nextLine(p, end);
+
+         const char * q = static_cast<const char *>(memchr(p, ':', nl - p));
+         if(q == nullptr) continue;
+         ++q;
+
+         //Count first, so a short row is not added
+         const char * r = q;
+         size_t nc = 0;
+         uint64_t v = 0;
+         while(nc < m_cols.size() && (r = parseCount(v, r, nl)) != nullptr) ++nc;
+         if(nc < m_cols.size()) continue;
+
+         for(size_t k = 0; k < m_cols.size(); ++k)
+         {
+            q = parseCount(v, q, nl);
+            counts[m_cols[k]] += v;
+         }
+      }
+
+      return 0;
+   }
+};
+
+/// Parse the contents of /proc/schedstat for the number of times each CPU has scheduled.
+/** This is the third field of each cpuN line in versions 15 and later, and counts the context
+  * switches of the CPU, including switches to and from idle.
+  *
+  * \returns 0 on success
+  * \returns -1 if the version is not supported or there are no CPU lines
+  */
+inline
+int parseSchedstat( std::vector<uint64_t> & counts, ///< [out] the schedule count of each CPU, indexed by CPU number
+                    const char * buf,               ///< [in] the contents of /proc/schedstat
+                    size_t sz                       ///< [in] the size of the contents
+                  )
+{
+   const char * end = buf + sz;
+   int ncpu = 0;
+
+   for(const char * p = buf; p < end; )
+   {
+      const char * nl = nextLine(p, end);
+      size_t len = nl - p;
+
+      if(len > 8 && strncmp(p, "version ", 8) == 0)
+      {
+         uint64_t ver;
+         if(parseCount(ver, p + 8, nl) == nullptr || ver < 15) return -1;
+      }
+      else if(len > 4 && strncmp(p, "cpu", 3) == 0 && p[3] >= '0' && p[3] <= '9')
+      {
+         uint64_t n = 0, f = 0;
+         const char * q = parseCount(n, p + 3, nl);
+         for(int k = 0; k < 3 && q; ++k) q = parseCount(f, q, nl);
+
+         if(q)
+         {
+            if(n >= counts.size()) counts.resize(n + 1, 0);
+            counts[n] = f;
+            ++ncpu;
+         }
+      }
+
+      p = nl;
+   }
+
+   if(ncpu == 0) return -1;
+   return 0;
+}
+
+/// Parse the contents of /proc/meminfo for the RAM in use
+/** Memory in use is MemTotal - MemAvailable, which is the used column of free.
+  *
+  * \returns 0 on success
+  * \returns -1 if either value is missing
+  */
+inline
+int parseMeminfo( float & ramUsage,  ///< [out] the fraction of RAM in use, between 0 and 1
+                  const char * buf,  ///< [in] the contents of /proc/meminfo
+                  size_t sz          ///< [in] the size of the contents
+                )
+{
+   const char * end = buf + sz;
+   uint64_t total = 0, avail = 0;
+   bool haveTotal = false, haveAvail = false;
+
+   for(const char * p = buf; p < end && !(haveTotal && haveAvail); )
+   {
+      const char * nl = nextLine(p, end);
+      size_t len = nl - p;
+
+      if(len > 9 && strncmp(p, "MemTotal:", 9) == 0)
+      {
+         haveTotal = (parseCount(total, p + 9, nl) != nullptr);
+      }
+      else if(len > 13 && strncmp(p, "MemAvailable:", 13) == 0)
+      {
+         haveAvail = (parseCount(avail, p + 13, nl) != nullptr);
+      }
+
+      p = nl;
+   }
+
+   if(!haveTotal || !haveAvail || total == 0 || avail > total) return -1;
+
+   ramUsage = static_cast<float>(total - avail) / static_cast<float>(total);
+   return 0;
+}
+
+/// Get the fraction of a filesystem in use, as reported by df.
+/** Only paths which are mount points are reported, so a /data which is just a directory on the
+  * root filesystem is not reported as a copy of /.
+  *
+  * \returns 0 on success
+  * \returns 1 if the path is not a mount point
+  * \returns -1 on error
+  */
+inline
+int diskUsage( float & usage,             ///< [out] the fraction in use, between 0 and 1
+               const std::string & path   ///< [in] the mount point
+             )
+{
+   if(path != "/")
+   {
+      struct stat st, pst;
+      if(stat(path.c_str(), &st) < 0) return 1;
+      if(stat((path + "/..").c_str(), &pst) < 0) return -1;
+      if(st.st_dev == pst.st_dev) return 1;
+   }
+
+   struct statvfs sv;
+   if(statvfs(path.c_str(), &sv) < 0) return -1;
+
+   uint64_t used = sv.f_blocks - sv.f_bfree;
+   uint64_t avail = used + sv.f_bavail;
+   if(avail == 0) return -1;
+
+   usage = static_cast<float>(used) / static_cast<float>(avail);
+   return 0;
+}
+
+/// A temperature sensor in /sys, kept open
+struct tempSensor
+{
+   std::string name;  ///< The name of the sensor, its label or the device it measures
+   procFile input;    ///< The file with the temperature in millidegrees C
+   float max {0};     ///< The high temperature of the sensor, 0 if none [C]
+   float crit {0};    ///< The critical temperature of the sensor, 0 if none [C]
+
+   /// Read the temperature
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int read( float & temp /**< [out] the temperature [C] */)
+   {
+      long long mC;
+      if(input.read(mC) < 0) return -1;
+
+      temp = mC / 1000.0;
+      return 0;
+   }
+};
+
+/// Read the first line of a small file
+/**
+  * \returns 0 on success
+  * \returns -1 if the file can not be read
+  */
+inline
+int readLine( std::string & line,       ///< [out] the first line of the file
+              const std::string & path  ///< [in] the path of the file
+            )
+{
+   std::ifstream fin(path);
+   if(!fin.good()) return -1;
+
+   if(!std::getline(fin, line)) return -1;
+
+   return 0;
+}
+
+/// List the entries of a directory which start with a prefix, sorted by the number which follows it
+/**
+  * \returns the entries, empty if the directory can not be read
+  */
+inline
+std::vector<std::string> listEntries( const std::string & dir,   ///< [in] the directory
+                                      const std::string & prefix ///< [in] the prefix the entries must start with
+                                    )
+{
+   std::vector<std::pair<long, std::string>> ents;
+
+   DIR * d = opendir(dir.c_str());
+   if(d == nullptr) return std::vector<std::string>();
+
+   struct dirent * de;
+   while((de = readdir(d)) != nullptr)
+   {
+      std::string nm = de->d_name;
+      if(nm[0] == '.') continue;
+      if(nm.size() <= prefix.size() || nm.compare(0, prefix.size(), prefix) != 0) continue;
+
+      ents.push_back({strtol(nm.c_str() + prefix.size(), nullptr, 10), nm});
+   }
+
+   closedir(d);
+
+   std::sort(ents.begin(), ents.end());
+
+   std::vector<std::string> names;
+   for(size_t n = 0; n < ents.size(); ++n) names.push_back(ents[n].second);
+
+   return names;
+}
+
+/// Find the temperature sensors of the hwmon devices with a given driver name
+/** Each tempN_input of each matching hwmonM directory is opened, in numeric order.
+  *
+  * \returns the number of sensors found
+  */
+inline
+int findHwmonTemps( std::vector<tempSensor> & sensors,  ///< [out] the sensors found are appended
+                    const std::string & driver,         ///< [in] the driver name, e.g. coretemp
+                    const std::string & labelPrefix,    ///< [in] only sensors whose label starts with this are used, empty for all
+                    const std::string & root = "/sys/class/hwmon" ///< [in] [optional] the hwmon class directory
+                  )
+{
+   int nfound = 0;
+
+   std::vector<std::string> hwmons = listEntries(root, "hwmon");
+   for(size_t h = 0; h < hwmons.size(); ++h)
+   {
+      std::string dir = root + "/" + hwmons[h];
+
+      std::string name;
+      if(readLine(name, dir + "/name") < 0 || name != driver) continue;
+
+      std::vector<std::string> temps = listEntries(dir, "temp");
+      for(size_t t = 0; t < temps.size(); ++t)
+      {
+         size_t us = temps[t].find('_');
+         if(us == std::string::npos || temps[t].substr(us) != "_input") continue;
+
+         std::string base = dir + "/" + temps[t].substr(0, us);
+
+         std::string label;
+         if(readLine(label, base + "_label") < 0) label = temps[t].substr(0, us);
+
+         if(labelPrefix.size() > 0 && label.compare(0, labelPrefix.size(), labelPrefix) != 0) continue;
+
+         tempSensor ts;
+         ts.name = label;
+         if(ts.input.open(base + "_input") < 0) continue;
+
+         std::string lim;
+         if(readLine(lim, base + "_max") == 0) ts.max = strtol(lim.c_str(), nullptr, 10) / 1000.0;
+         if(readLine(lim, base + "_crit") == 0) ts.crit = strtol(lim.c_str(), nullptr, 10) / 1000.0;
+
+         sensors.push_back(std::move(ts));
+         ++nfound;
+      }
+   }
+
+   return nfound;
+}
+
+/// Find the thermal zones of given types
+/** Each zone's temp file is opened, and named by its type.  Trip points are not read.
+  *
+  * \returns the number of zones found
+  */
+inline
+int findThermalZones( std::vector<tempSensor> & sensors,       ///< [out] the zones found are appended
+                      const std::vector<std::string> & types,  ///< [in] the zone types to use, e.g. x86_pkg_temp
+                      const std::string & root = "/sys/class/thermal" ///< [in] [optional] the thermal class directory
+                    )
+{
+   int nfound = 0;
+
+   std::vector<std::string> zones = listEntries(root, "thermal_zone");
+   for(size_t z = 0; z < zones.size(); ++z)
+   {
+      std::string dir = root + "/" + zones[z];
+
+      std::string type;
+      if(readLine(type, dir + "/type") < 0) continue;
+      if(std::find(types.begin(), types.end(), type) == types.end()) continue;
+
+      tempSensor ts;
+      ts.name = type;
+      if(ts.input.open(dir + "/temp") < 0) continue;
+
+      sensors.push_back(std::move(ts));
+      ++nfound;
+   }
+
+   return nfound;
+}
+
+/// Find the temperature sensors of drives
+/** SATA drives are measured by the drivetemp hwmon driver, and the disk is found under
+  * device/block.  NVMe drives are measured by the nvme driver, whose device is the controller,
+  * and the disk is its first namespace.  Each sensor is named by its disk, e.g. sda or nvme0n1,
+  * which is how hddtemp names them.  Only the first temperature of each drive is used.
+  *
+  * \returns the number of drives found
+  */
+inline
+int findDriveTemps( std::vector<tempSensor> & sensors,  ///< [out] the sensors found are appended
+                    const std::string & root = "/sys/class/hwmon" ///< [in] [optional] the hwmon class directory
+                  )
+{
+   int nfound = 0;
+
+   std::vector<std::string> hwmons = listEntries(root, "hwmon");
+   for(size_t h = 0; h < hwmons.size(); ++h)
+   {
+      std::string dir = root + "/" + hwmons[h];
+
+      std::string name;
+      if(readLine(name, dir + "/name") < 0) continue;
+
+      std::vector<std::string> disks;
+      if(name == "drivetemp")
+      {
+         disks = listEntries(dir + "/device/block", "");
+      }
+      else if(name == "nvme")
+      {
+         std::vector<std::string> ents = listEntries(dir + "/device", "nvme");
+         for(size_t n = 0; n < ents.size(); ++n)
+         {
+            if(ents[n].find('n', 4) != std::string::npos) disks.push_back(ents[n]);
+         }
+      }
+      else continue;
+
+      if(disks.size() == 0) continue;
+
+      tempSensor ts;
+      ts.name = disks[0];
+      if(ts.input.open(dir + "/temp1_input") < 0) continue;
+
+      sensors.push_back(std::move(ts));
+      ++nfound;
+   }
+
+   return nfound;
+}
+
+} //namespace sysmon
+} //namespace app
+} //namespace MagAOX
+
+#endif //sysMonitorReaders_hpp
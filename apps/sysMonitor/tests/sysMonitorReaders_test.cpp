@@ -0,0 +1,320 @@
+/** \file sysMonitorReaders_test.cpp
+  * \brief Catch2 tests for the /proc and /sys readers in the sysMonitor app.
+  *
+  * History:
+  */
+#include "../../../tests/catch2/catch.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#include "../sysMonitorReaders.hpp"
+
+using namespace MagAOX::app;
+
+namespace sysMonitorReaders_test
+{
+
+/// Write a file in the fake sysfs tree
+void writeFile( const std::string & path,
+                const std::string & contents
+              )
+{
+   std::ofstream fout(path);
+   fout << contents;
+}
+
+SCENARIO( "Parsing /proc/stat", "[sysMonitorReaders]" )
+{
+   GIVEN("two samples of /proc/stat")
+   {
+      std::string s0 = "cpu  400 0 200 1400 0 0 0 0 0 0\n"
+                       "cpu0 100 0 100 800 0 0 0 0 0 0\n"
+                       "cpu1 300 0 100 600 0 0 0 0 0 0\n"
+                       "intr 1000 0 0 0\n"
+                       "ctxt 5000\n"
+                       "btime 1700000000\n"
+                       "softirq 300 0 100 0 200\n";
+
+      std::string s1 = "cpu  800 0 200 1800 0 0 0 0 0 0\n"
+                       "cpu0 100 0 100 900 0 0 0 0 0 0\n"
+                       "cpu1 600 0 100 700 100 0 0 0 0 0\n"
+                       "intr 1500 0 0 0\n"
+                       "ctxt 6000\n"
+                       "softirq 400 0 150 0 250\n";
+
+      std::vector<sysmon::cpuTimes> t0, t1;
+      sysmon::statTotals tot0, tot1;
+
+      WHEN("both are parsed")
+      {
+         REQUIRE( sysmon::parseProcStat(t0, tot0, s0.data(), s0.size()) == 0 );
+         REQUIRE( sysmon::parseProcStat(t1, tot1, s1.data(), s1.size()) == 0 );
+
+         REQUIRE( t0.size() == 2 );
+         REQUIRE( t0[0].total == 1000 );
+         REQUIRE( t0[0].busy == 200 );
+
+         //iowait is not busy
+         REQUIRE( t1[1].total == 1500 );
+         REQUIRE( t1[1].busy == 700 );
+
+         REQUIRE( tot0.ctxt == 5000 );
+         REQUIRE( tot1.intr == 1500 );
+         REQUIRE( tot1.softirq == 400 );
+
+         REQUIRE( sysmon::cpuLoad(t0[0], t1[0]) == 0 );
+         REQUIRE( sysmon::cpuLoad(t0[1], t1[1]) == Approx(0.6) );
+
+         REQUIRE( sysmon::countRate(tot0.ctxt, tot1.ctxt, 0.5) == 2000 );
+         REQUIRE( sysmon::countRate(tot1.ctxt, tot0.ctxt, 0.5) == 0 );
+      }
+
+      WHEN("there is no change")
+      {
+         REQUIRE( sysmon::parseProcStat(t0, tot0, s0.data(), s0.size()) == 0 );
+         REQUIRE( sysmon::cpuLoad(t0[0], t0[0]) == 0 );
+      }
+
+      WHEN("there are no cpu lines")
+      {
+         std::string bad = "intr 1000 0 0 0\nctxt 5000\n";
+         REQUIRE( sysmon::parseProcStat(t0, tot0, bad.data(), bad.size()) == -1 );
+      }
+   }
+}
+
+SCENARIO( "Parsing per-CPU tables", "[sysMonitorReaders]" )
+{
+   GIVEN("/proc/interrupts with CPU 1 offline")
+   {
+      std::string s = "           CPU0       CPU2       \n"
+                      "  0:         10          0   IO-APIC   2-edge      timer\n"
+                      " 24:          5         20   PCI-MSI 65536-edge      nvme0q0\n"
+                      "LOC:       1000       2000   Local timer interrupts\n"
+                      "ERR:          7\n"
+                      "MIS:          0\n";
+
+      sysmon::cpuCountTable tab;
+      std::vector<uint64_t> counts;
+
+      REQUIRE( tab.parse(counts, s.data(), s.size()) == 0 );
+      REQUIRE( counts.size() == 3 );
+      REQUIRE( counts[0] == 1015 );
+      REQUIRE( counts[1] == 0 );
+      REQUIRE( counts[2] == 2020 );
+
+      //Parsing again starts from 0
+      REQUIRE( tab.parse(counts, s.data(), s.size()) == 0 );
+      REQUIRE( counts[0] == 1015 );
+   }
+
+   GIVEN("/proc/softirqs")
+   {
+      std::string s = "                    CPU0       CPU1\n"
+                      "          HI:          1          2\n"
+                      "       TIMER:        100        200\n"
+                      "      NET_RX:         10          0\n";
+
+      sysmon::cpuCountTable tab;
+      std::vector<uint64_t> counts;
+
+      REQUIRE( tab.parse(counts, s.data(), s.size()) == 0 );
+      REQUIRE( counts.size() == 2 );
+      REQUIRE( counts[0] == 111 );
+      REQUIRE( counts[1] == 202 );
+   }
+
+   GIVEN("/proc/schedstat")
+   {
+      std::vector<uint64_t> counts;
+
+      std::string s = "version 15\n"
+                      "timestamp 4295\n"
+                      "cpu0 0 0 1234 600 700 300 99999 8888 77\n"
+                      "domain0 3 1 2 3 4 5 6 7 8 9\n"
+                      "cpu1 0 0 5678 600 700 300 99999 8888 77\n";
+
+      REQUIRE( sysmon::parseSchedstat(counts, s.data(), s.size()) == 0 );
+      REQUIRE( counts.size() == 2 );
+      REQUIRE( counts[0] == 1234 );
+      REQUIRE( counts[1] == 5678 );
+
+      std::string old = "version 14\ncpu0 0 0 1234 600 700 300 99999 8888 77\n";
+      REQUIRE( sysmon::parseSchedstat(counts, old.data(), old.size()) == -1 );
+   }
+}
+
+SCENARIO( "Parsing /proc/meminfo", "[sysMonitorReaders]" )
+{
+   GIVEN("/proc/meminfo")
+   {
+      float ram = -1;
+
+      WHEN("both values are present")
+      {
+         std::string s = "MemTotal:        8000000 kB\n"
+                         "MemFree:         1000000 kB\n"
+                         "MemAvailable:    6000000 kB\n";
+
+         REQUIRE( sysmon::parseMeminfo(ram, s.data(), s.size()) == 0 );
+         REQUIRE( ram == Approx(0.25) );
+      }
+
+      WHEN("MemAvailable is missing")
+      {
+         std::string s = "MemTotal:        8000000 kB\n"
+                         "MemFree:         1000000 kB\n";
+
+         REQUIRE( sysmon::parseMeminfo(ram, s.data(), s.size()) == -1 );
+         REQUIRE( ram == -1 );
+      }
+   }
+}
+
+SCENARIO( "Reading files and filesystems", "[sysMonitorReaders]" )
+{
+   GIVEN("an open file which changes")
+   {
+      char tmpl[] = "/tmp/sysMonitorReaders_testXXXXXX";
+      REQUIRE( mkdtemp(tmpl) != nullptr );
+      std::string dir = tmpl;
+
+      writeFile(dir + "/val", "42000\n");
+
+      sysmon::procFile pf;
+      REQUIRE( pf.open(dir + "/val") == 0 );
+
+      long long v;
+      REQUIRE( pf.read(v) == 0 );
+      REQUIRE( v == 42000 );
+
+      //The same fd sees the new contents
+      writeFile(dir + "/val", "43500\n");
+      REQUIRE( pf.read(v) == 0 );
+      REQUIRE( v == 43500 );
+
+      //Larger than the initial buffer
+      writeFile(dir + "/val", std::string(10000, 'x'));
+      REQUIRE( pf.read() == 0 );
+      REQUIRE( pf.size() == 10000 );
+      REQUIRE( pf.read(v) == -1 );
+
+      pf.close();
+      REQUIRE( pf.read() == -1 );
+
+      remove((dir + "/val").c_str());
+      remove(dir.c_str());
+   }
+
+   GIVEN("the root filesystem")
+   {
+      float usage = -1;
+      REQUIRE( sysmon::diskUsage(usage, "/") == 0 );
+      REQUIRE( usage >= 0 );
+      REQUIRE( usage <= 1 );
+
+      REQUIRE( sysmon::diskUsage(usage, "/this/does/not/exist") == 1 );
+   }
+}
+
+SCENARIO( "Finding temperature sensors", "[sysMonitorReaders]" )
+{
+   GIVEN("a fake sysfs tree")
+   {
+      char tmpl[] = "/tmp/sysMonitorReaders_testXXXXXX";
+      REQUIRE( mkdtemp(tmpl) != nullptr );
+      std::string root = tmpl;
+
+      std::string hw = root + "/hwmon";
+      std::string th = root + "/thermal";
+      mkdir(hw.c_str(), 0700);
+      mkdir(th.c_str(), 0700);
+
+      //coretemp, with the package first and the cores out of order
+      mkdir((hw + "/hwmon10").c_str(), 0700);
+      writeFile(hw + "/hwmon10/name", "coretemp\n");
+      writeFile(hw + "/hwmon10/temp1_label", "Package id 0\n");
+      writeFile(hw + "/hwmon10/temp1_input", "50000\n");
+      writeFile(hw + "/hwmon10/temp10_label", "Core 8\n");
+      writeFile(hw + "/hwmon10/temp10_input", "48000\n");
+      writeFile(hw + "/hwmon10/temp2_label", "Core 0\n");
+      writeFile(hw + "/hwmon10/temp2_input", "45000\n");
+      writeFile(hw + "/hwmon10/temp2_max", "100000\n");
+      writeFile(hw + "/hwmon10/temp2_crit", "105000\n");
+
+      //a SATA drive
+      mkdir((hw + "/hwmon2").c_str(), 0700);
+      writeFile(hw + "/hwmon2/name", "drivetemp\n");
+      writeFile(hw + "/hwmon2/temp1_input", "31000\n");
+      mkdir((hw + "/hwmon2/device").c_str(), 0700);
+      mkdir((hw + "/hwmon2/device/block").c_str(), 0700);
+      mkdir((hw + "/hwmon2/device/block/sdb").c_str(), 0700);
+
+      //an NVMe drive
+      mkdir((hw + "/hwmon3").c_str(), 0700);
+      writeFile(hw + "/hwmon3/name", "nvme\n");
+      writeFile(hw + "/hwmon3/temp1_input", "38000\n");
+      mkdir((hw + "/hwmon3/device").c_str(), 0700);
+      mkdir((hw + "/hwmon3/device/nvme0n1").c_str(), 0700);
+
+      //thermal zones
+      mkdir((th + "/thermal_zone0").c_str(), 0700);
+      writeFile(th + "/thermal_zone0/type", "acpitz\n");
+      writeFile(th + "/thermal_zone0/temp", "27800\n");
+      mkdir((th + "/thermal_zone1").c_str(), 0700);
+      writeFile(th + "/thermal_zone1/type", "x86_pkg_temp\n");
+      writeFile(th + "/thermal_zone1/temp", "51000\n");
+
+      WHEN("the cores are found")
+      {
+         std::vector<sysmon::tempSensor> sensors;
+         REQUIRE( sysmon::findHwmonTemps(sensors, "coretemp", "Core ", hw) == 2 );
+
+         REQUIRE( sensors[0].name == "Core 0" );
+         REQUIRE( sensors[1].name == "Core 8" );
+         REQUIRE( sensors[0].max == 100 );
+         REQUIRE( sensors[0].crit == 105 );
+         REQUIRE( sensors[1].max == 0 );
+
+         float temp;
+         REQUIRE( sensors[0].read(temp) == 0 );
+         REQUIRE( temp == 45 );
+         REQUIRE( sensors[1].read(temp) == 0 );
+         REQUIRE( temp == 48 );
+
+         REQUIRE( sysmon::findHwmonTemps(sensors, "k10temp", "Tctl", hw) == 0 );
+      }
+
+      WHEN("the drives are found")
+      {
+         std::vector<sysmon::tempSensor> sensors;
+         REQUIRE( sysmon::findDriveTemps(sensors, hw) == 2 );
+
+         REQUIRE( sensors[0].name == "sdb" );
+         REQUIRE( sensors[1].name == "nvme0n1" );
+
+         float temp;
+         REQUIRE( sensors[1].read(temp) == 0 );
+         REQUIRE( temp == 38 );
+      }
+
+      WHEN("the thermal zones are found")
+      {
+         std::vector<sysmon::tempSensor> sensors;
+         REQUIRE( sysmon::findThermalZones(sensors, {"x86_pkg_temp"}, th) == 1 );
+
+         REQUIRE( sensors[0].name == "x86_pkg_temp" );
+
+         float temp;
+         REQUIRE( sensors[0].read(temp) == 0 );
+         REQUIRE( temp == 51 );
+      }
+
+      std::string cmd = "rm -rf " + root;
+      REQUIRE( system(cmd.c_str()) == 0 );
+   }
+}
+
+} //namespace sysMonitorReaders_test
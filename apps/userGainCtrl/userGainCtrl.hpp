@@ -271,17 +271,17 @@ protected:
     mx::improc::eigenImage<realT> m_gainsCurrent; ///< The current gains.
     mx::improc::eigenImage<realT> m_gainsTarget; ///< The target gains.
     
-    realT (*pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+    pixKernels<realT> pixkern; ///< The kernels to extract the image data as our desired type realT.
     
     mx::improc::eigenImage<realT> m_mcsCurrent; ///< The current gains.
     mx::improc::eigenImage<realT> m_mcsTarget; ///< The target gains.
  
-    realT (*mc_pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+    pixKernels<realT> mc_pixkern; ///< The kernels to extract the image data as our desired type realT.
  
     mx::improc::eigenImage<realT> m_limitsCurrent; ///< The current gains.
     mx::improc::eigenImage<realT> m_limitsTarget; ///< The target gains.
  
-    realT (*limit_pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+    pixKernels<realT> limit_pixkern; ///< The kernels to extract the image data as our desired type realT.
  
     std::vector<uint16_t> m_modeBlockStart;
     std::vector<uint16_t> m_modeBlockN;
@@ -838,7 +838,7 @@ int userGainCtrl::allocate(const gainShmimT & dummy)
    
     getModeBlocks();
 
-    pixget = getPixPointer<realT>(shmimMonitorT::m_dataType);
+    pixkern = getPixKernels<realT>(shmimMonitorT::m_dataType);
 
     return 0;
 }
@@ -856,10 +856,7 @@ int userGainCtrl::processImage( void * curr_src,
 
    realT * data = m_gainsCurrent.data();
       
-   for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
-   {
-      data[nn] = pixget(curr_src, nn);
-   }
+   pixkern.convert(data, curr_src, shmimMonitorT::m_width*shmimMonitorT::m_height);
    
    //update blocks here.
 
@@ -974,7 +971,7 @@ int userGainCtrl::allocate(const multcoeffShmimT & dummy)
     m_mcsCurrent.resize(mcShmimMonitorT::m_width, mcShmimMonitorT::m_height);
     m_mcsTarget.resize(mcShmimMonitorT::m_width, mcShmimMonitorT::m_height);
    
-    mc_pixget = getPixPointer<realT>(mcShmimMonitorT::m_dataType);
+    mc_pixkern = getPixKernels<realT>(mcShmimMonitorT::m_dataType);
 
     return 0;
 }
@@ -992,10 +989,7 @@ int userGainCtrl::processImage( void * curr_src,
 
    realT * data = m_mcsCurrent.data();
       
-   for(unsigned nn=0; nn < mcShmimMonitorT::m_width*mcShmimMonitorT::m_height; ++nn)
-   {
-      data[nn] = mc_pixget(curr_src, nn);
-   }
+   mc_pixkern.convert(data, curr_src, mcShmimMonitorT::m_width*mcShmimMonitorT::m_height);
    
    //update blocks here.
 
@@ -1109,7 +1103,7 @@ int userGainCtrl::allocate(const limitShmimT & dummy)
     m_limitsCurrent.resize(limitShmimMonitorT::m_width, limitShmimMonitorT::m_height);
     m_limitsTarget.resize(limitShmimMonitorT::m_width, limitShmimMonitorT::m_height);
    
-    limit_pixget = getPixPointer<realT>(limitShmimMonitorT::m_dataType);
+    limit_pixkern = getPixKernels<realT>(limitShmimMonitorT::m_dataType);
 
     return 0;
 }
@@ -1127,10 +1121,7 @@ int userGainCtrl::processImage( void * curr_src,
 
    realT * data = m_limitsCurrent.data();
       
-   for(unsigned nn=0; nn < limitShmimMonitorT::m_width*limitShmimMonitorT::m_height; ++nn)
-   {
-      data[nn] = limit_pixget(curr_src, nn);
-   }
+   limit_pixkern.convert(data, curr_src, limitShmimMonitorT::m_width*limitShmimMonitorT::m_height);
    
    //update blocks here.
    
@@ -354,6 +354,22 @@ public:
                          const logPrioT & level              ///< [in] the level (verbosity) of this log
                        );
    
+   /// Create a formatted log entry in a pre-allocated buffer.
+   /** The buffer must be at least totalSize(len) bytes, where len is logT::length(msg) and 
+     * must be passed in.  This is used when buffers are managed by the caller, e.g. from a pool.
+     *
+     * \tparam logT is a log entry type
+     *
+     * \returns 0 on success, -1 on error.
+     */
+   template<typename logT>
+   static int createLog( char * logBuffer,                    ///< [out] a raw buffer of at least totalSize(len) bytes, populated with the log entry 
+                         const timespecX & ts,                ///< [in] the timestamp of this log entry.
+                         const msgLenT & len,                 ///< [in] the message length, from logT::length(msg)
+                         const typename logT::messageT & msg, ///< [in] the message to log (could be of type emptyMessage) 
+                         const logPrioT & level               ///< [in] the level (verbosity) of this log
+                       );
+   
    ///Extract the basic details of a log entry
    /** Convenience wrapper for the other extraction functions.
      * 
@@ -663,6 +679,48 @@ int logHeader::createLog( bufferPtrT & logBuffer,
 
 }
 
+template<typename logT>
+int logHeader::createLog( char * logBuffer,
+                          const timespecX & ts,
+                          const msgLenT & len,
+                          const typename logT::messageT & msg,
+                          const logPrioT & level
+                        )
+{
+   logPrioT lvl;
+   if(level == logPrio::LOG_DEFAULT) 
+   {
+      lvl = logT::defaultLevel;
+   }
+   else lvl = level;
+
+   internal_logHeader * lh = reinterpret_cast<internal_logHeader *>(logBuffer);
+   
+   lh->m_logLevel = lvl;
+   lh->m_eventCode = +logT::eventCode; //The + fixes an issue with undefined references
+   lh->m_timespecX = ts;
+
+   if( len < MAX_LEN0-1 )
+   {
+      lh->msgLen0 = len;
+   }
+   else if(len < MAX_LEN1)
+   {
+      lh->msgLen0 = MAX_LEN0-1;
+      lh->msgLen1 = len;
+   }
+   else
+   {
+      lh->msgLen0 = MAX_LEN0;
+      lh->msgLen2 = len;
+   }
+
+   //Each log-type is responsible for loading its message
+   logT::format( messageBuffer(logBuffer), msg);
+
+   return 0;
+}
+
 inline
 int logHeader::extractBasicLog( logPrioT & lvl,       
                                 eventCodeT & ec,       
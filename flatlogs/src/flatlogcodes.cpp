@@ -453,6 +453,70 @@ int emitLogTypes( const std::string & fileName,
    return 0;
 }
 
+///Write the logSchemata.hpp header.
+int emitSchemataHeader( const std::string & fileName,
+                        std::map<uint16_t, typeSchemaPair> & logCodes
+                      )
+{
+   typedef std::map<uint16_t, typeSchemaPair> mapT;
+
+   mapT::iterator it = logCodes.begin();
+
+   std::ofstream fout;
+   fout.open(fileName);
+
+   fout << "#ifndef logger_logSchemata_hpp\n";
+   fout << "#define logger_logSchemata_hpp\n";
+
+   fout << "#include <string>\n";
+   fout << "#include <flatlogs/flatlogs.hpp>\n";
+
+   fout << "#include \"../logBinarySchemata.hpp\"\n";
+
+   ///\todo Need to allow specification of the namespaces
+   fout << "namespace MagAOX\n";
+   fout << "{\n";
+   fout << "namespace logger\n";
+   fout << "{\n";
+   fout << "inline int logSchema( std::string & typeName,\n";
+   fout << "                      const uint8_t * & binarySchema,\n";
+   fout << "                      unsigned int & binarySchemaLength,\n";
+   fout << "                      flatlogs::eventCodeT ec\n";
+   fout << "                    )\n";
+   fout << "{\n";
+   fout << "   switch(ec)\n";
+   fout << "   {\n";
+   for(; it!=logCodes.end(); ++it)
+   {
+      fout << "      case " << it->first << ":\n";
+      fout << "         typeName = \"" << it->second.type << "\";\n";
+      if (it->second.schema == "empty_log")
+      {
+         fout << "         binarySchema = nullptr;\n";
+         fout << "         binarySchemaLength = 0;\n";
+      }
+      else
+      {
+         fout << "         binarySchema = reinterpret_cast<const uint8_t *>(" << it->second.schema << "_bfbs);\n";
+         fout << "         binarySchemaLength = " << it->second.schema << "_bfbs_len;\n";
+      }
+      fout << "         return 0;\n";
+   }
+      fout << "      default:\n";
+      fout << "         return -1;\n";
+   fout << "   }\n";
+   fout << "}\n";
+
+   fout << "}\n"; //namespace logger
+   fout << "}\n"; //namespace MagAOX
+
+   fout << "#endif\n"; //logger_logSchemata_hpp
+
+   fout.close();
+
+   return 0;
+}
+
 ///Write binarySchemataDeclarations.inc
 int emitBinarySchemataDeclarations( const std::string & fileName,
                                     std::set<std::string> & schemas
@@ -491,6 +555,7 @@ int main()
    std::string logCodesHeader = generatedDir + "/logCodes.hpp";
    std::string logTypesHeader = generatedDir + "/logTypes.hpp";
    std::string logCodeValidHeader = generatedDir + "/logCodeValid.hpp";
+   std::string logSchemataHeader = generatedDir + "/logSchemata.hpp";
    std::string binarySchemataDeclarations = generatedDir + "/binarySchemataDeclarations.inc";
    mapT logCodes;
    setT schemas;
@@ -506,6 +571,7 @@ int main()
    emitLogCodes( logCodesHeader, logCodes );
    emitLogTypes( logTypesHeader, logCodes );
    emitCodeValidHeader( logCodeValidHeader, logCodes);
+   emitSchemataHeader( logSchemataHeader, logCodes);
    emitBinarySchemataDeclarations( binarySchemataDeclarations, schemas );
 
    std::string flatc = "flatc -o " + schemaGeneratedDir + " --cpp --reflect-types --reflect-names";
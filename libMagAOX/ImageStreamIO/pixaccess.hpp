@@ -5,8 +5,23 @@
 #ifndef pixaccess_h
 #define pixaccess_h
 
+#include <iostream>
+
 #include "ImageStruct.hpp"
 
+/// Attribute to compile the bulk pixel kernels for each SIMD instruction set, with the best chosen at load time.
+/** The kernels are plain loops which the compiler vectorizes.  Without -march the build targets SSE2 only, so with
+  * GCC on x86-64 each kernel is also cloned for AVX2 and AVX-512.  Define PIXACCESS_TARGET_CLONES (empty to
+  * disable) before including this file to override.
+  */
+#ifndef PIXACCESS_TARGET_CLONES
+   #if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && !defined(__CUDACC__)
+      #define PIXACCESS_TARGET_CLONES __attribute__((target_clones("avx512f","avx2","default")))
+   #else
+      #define PIXACCESS_TARGET_CLONES
+   #endif
+#endif
+
 ///Function to cast the data type to float.
 /** Accesses the imdata pointer at linear position idx, and then casts the result to float.
   *
@@ -60,6 +75,142 @@ returnT (*getPixPointer(int imageStructDataT))(void*, size_t)
          return nullptr;
    }
 }
+
+/** \name Bulk Pixel Kernels
+  * These process a whole image per call, so the data type is dispatched once per image rather than once per pixel,
+  * and the loops vectorize.  Get the kernels for an image's type with getPixKernels.
+  * @{
+  */
+
+///Convert an image to realT: dest = src
+template<typename realT, typename dataT>
+PIXACCESS_TARGET_CLONES
+void pixConvert( realT * __restrict__ dest, ///< [out] the converted image
+                 const void * src,          ///< [in] the image data, of type dataT
+                 size_t npix                ///< [in] the number of pixels
+               )
+{
+   const dataT * __restrict__ s = static_cast<const dataT *>(src);
+   for(size_t n = 0; n < npix; ++n) dest[n] = s[n];
+}
+
+///Add an image to an accumulator: dest += src
+template<typename realT, typename dataT>
+PIXACCESS_TARGET_CLONES
+void pixAccumulate( realT * __restrict__ dest, ///< [in/out] the accumulator
+                    const void * src,          ///< [in] the image data, of type dataT
+                    size_t npix                ///< [in] the number of pixels
+                  )
+{
+   const dataT * __restrict__ s = static_cast<const dataT *>(src);
+   for(size_t n = 0; n < npix; ++n) dest[n] += s[n];
+}
+
+///Convert an image to realT and subtract a dark: dest = src - dark
+template<typename realT, typename dataT>
+PIXACCESS_TARGET_CLONES
+void pixDarkSubtract( realT * __restrict__ dest,       ///< [out] the dark subtracted image
+                      const void * src,                ///< [in] the image data, of type dataT
+                      const realT * __restrict__ dark, ///< [in] the dark
+                      size_t npix                      ///< [in] the number of pixels
+                    )
+{
+   const dataT * __restrict__ s = static_cast<const dataT *>(src);
+   for(size_t n = 0; n < npix; ++n) dest[n] = s[n] - dark[n];
+}
+
+///Convert an image to realT and scale it: dest = src * scale
+template<typename realT, typename dataT>
+PIXACCESS_TARGET_CLONES
+void pixScale( realT * __restrict__ dest, ///< [out] the scaled image
+               const void * src,          ///< [in] the image data, of type dataT
+               realT scale,               ///< [in] the scale factor
+               size_t npix                ///< [in] the number of pixels
+             )
+{
+   const dataT * __restrict__ s = static_cast<const dataT *>(src);
+   for(size_t n = 0; n < npix; ++n) dest[n] = s[n] * scale;
+}
+
+///Count the pixels above a threshold: dest += (src > threshold) ? 1 : 0
+template<typename realT, typename dataT>
+PIXACCESS_TARGET_CLONES
+void pixCountAbove( realT * __restrict__ dest,            ///< [in/out] the counts
+                    const void * src,                     ///< [in] the image data, of type dataT
+                    const realT * __restrict__ threshold, ///< [in] the threshold of each pixel
+                    size_t npix                           ///< [in] the number of pixels
+                  )
+{
+   const dataT * __restrict__ s = static_cast<const dataT *>(src);
+   for(size_t n = 0; n < npix; ++n) dest[n] += (static_cast<realT>(s[n]) > threshold[n]) ? 1 : 0;
+}
+
+///The bulk pixel kernels for one image data type.
+/** All members are nullptr if the type is not supported.
+  */
+template<typename realT>
+struct pixKernels
+{
+   void (*convert)(realT *, const void *, size_t) {nullptr}; ///< pixConvert for the data type
+   void (*accumulate)(realT *, const void *, size_t) {nullptr}; ///< pixAccumulate for the data type
+   void (*darkSubtract)(realT *, const void *, const realT *, size_t) {nullptr}; ///< pixDarkSubtract for the data type
+   void (*scale)(realT *, const void *, realT, size_t) {nullptr}; ///< pixScale for the data type
+   void (*countAbove)(realT *, const void *, const realT *, size_t) {nullptr}; ///< pixCountAbove for the data type
+};
+
+///Get the bulk pixel kernels for the type
+template<typename realT, int imageStructDataT>
+pixKernels<realT> getPixKernels()
+{
+   typedef typename imageStructDataType<imageStructDataT>::type dataT;
+
+   pixKernels<realT> k;
+   k.convert = &pixConvert<realT, dataT>;
+   k.accumulate = &pixAccumulate<realT, dataT>;
+   k.darkSubtract = &pixDarkSubtract<realT, dataT>;
+   k.scale = &pixScale<realT, dataT>;
+   k.countAbove = &pixCountAbove<realT, dataT>;
+
+   return k;
+}
+
+///Get the bulk pixel kernels for the type
+/**
+  * \returns the kernels, which are all nullptr if the type is unknown or unsupported
+  */
+template<typename realT>
+pixKernels<realT> getPixKernels(int imageStructDataT)
+{
+   switch(imageStructDataT)
+   {
+      case IMAGESTRUCT_UINT8:
+         return getPixKernels<realT, IMAGESTRUCT_UINT8>();
+      case IMAGESTRUCT_INT8:
+         return getPixKernels<realT, IMAGESTRUCT_INT8>();
+      case IMAGESTRUCT_UINT16:
+         return getPixKernels<realT, IMAGESTRUCT_UINT16>();
+      case IMAGESTRUCT_INT16:
+         return getPixKernels<realT, IMAGESTRUCT_INT16>();
+      case IMAGESTRUCT_UINT32:
+         return getPixKernels<realT, IMAGESTRUCT_UINT32>();
+      case IMAGESTRUCT_INT32:
+         return getPixKernels<realT, IMAGESTRUCT_INT32>();
+      case IMAGESTRUCT_UINT64:
+         return getPixKernels<realT, IMAGESTRUCT_UINT64>();
+      case IMAGESTRUCT_INT64:
+         return getPixKernels<realT, IMAGESTRUCT_INT64>();
+      case IMAGESTRUCT_FLOAT:
+         return getPixKernels<realT, IMAGESTRUCT_FLOAT>();
+      case IMAGESTRUCT_DOUBLE:
+         return getPixKernels<realT, IMAGESTRUCT_DOUBLE>();
+      default:
+         std::cerr << "getPixKernels: Unknown or unsupported data type. " << __FILE__ << " " << __LINE__ << "\n";
+         return pixKernels<realT>();
+   }
+}
+
+///@}
+
 #endif
 
 
@@ -0,0 +1,147 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "../pixaccess.hpp"
+
+/// Fill an image of type dataT with values which are exact in float
+template<typename dataT>
+std::vector<dataT> testImage( size_t npix )
+{
+   std::vector<dataT> im(npix);
+   for(size_t n = 0; n < npix; ++n) im[n] = (n*7) % 100;
+   return im;
+}
+
+/// Check each kernel against getPix for one type
+template<int imageStructDataT>
+void checkKernels()
+{
+   typedef typename imageStructDataType<imageStructDataT>::type dataT;
+
+   size_t npix = 1021; //odd, so vector loop tails are exercised
+   std::vector<dataT> im = testImage<dataT>(npix);
+
+   pixKernels<float> k = getPixKernels<float>(imageStructDataT);
+   REQUIRE( k.convert != nullptr );
+   REQUIRE( k.accumulate != nullptr );
+   REQUIRE( k.darkSubtract != nullptr );
+   REQUIRE( k.scale != nullptr );
+   REQUIRE( k.countAbove != nullptr );
+
+   float (*pixget)(void *, size_t) = getPixPointer<float>(imageStructDataT);
+
+   std::vector<float> dark(npix);
+   for(size_t n = 0; n < npix; ++n) dark[n] = n % 3;
+
+   std::vector<float> thresh(npix);
+   for(size_t n = 0; n < npix; ++n) thresh[n] = (n*13) % 100;
+
+   std::vector<float> conv(npix), accum(npix, 1), dsub(npix), scl(npix), cnt(npix, 2);
+   k.convert(conv.data(), im.data(), npix);
+   k.accumulate(accum.data(), im.data(), npix);
+   k.darkSubtract(dsub.data(), im.data(), dark.data(), npix);
+   k.scale(scl.data(), im.data(), 0.5, npix);
+   k.countAbove(cnt.data(), im.data(), thresh.data(), npix);
+
+   size_t nbad = 0;
+   for(size_t n = 0; n < npix; ++n)
+   {
+      float v = pixget(im.data(), n);
+      if(conv[n] != v) ++nbad;
+      if(accum[n] != v + 1) ++nbad;
+      if(dsub[n] != v - dark[n]) ++nbad;
+      if(scl[n] != v * 0.5f) ++nbad;
+      if(cnt[n] != 2 + (v > thresh[n])) ++nbad;
+   }
+
+   REQUIRE( nbad == 0 );
+}
+
+SCENARIO( "Bulk pixel kernels", "[pixaccess]" )
+{
+   GIVEN("images of each type")
+   {
+      WHEN("checking each kernel against getPix")
+      {
+         checkKernels<IMAGESTRUCT_UINT8>();
+         checkKernels<IMAGESTRUCT_INT8>();
+         checkKernels<IMAGESTRUCT_UINT16>();
+         checkKernels<IMAGESTRUCT_INT16>();
+         checkKernels<IMAGESTRUCT_UINT32>();
+         checkKernels<IMAGESTRUCT_INT32>();
+         checkKernels<IMAGESTRUCT_UINT64>();
+         checkKernels<IMAGESTRUCT_INT64>();
+         checkKernels<IMAGESTRUCT_FLOAT>();
+         checkKernels<IMAGESTRUCT_DOUBLE>();
+      }
+
+      WHEN("the type is unknown")
+      {
+         pixKernels<float> k = getPixKernels<float>(IMAGESTRUCT_COMPLEX_FLOAT);
+         REQUIRE( k.convert == nullptr );
+      }
+   }
+}
+
+/// Time accumulating with getPix per pixel and with the bulk kernel, and print the speedup
+template<int imageStructDataT>
+void benchKernels( const char * name )
+{
+   typedef typename imageStructDataType<imageStructDataT>::type dataT;
+
+   size_t npix = 240*240;
+   int nrep = 2000;
+
+   std::vector<dataT> im = testImage<dataT>(npix);
+   std::vector<float> accum(npix, 0);
+
+   //volatile so the compiler can't inline the call, as it can't in an app which stores the pointer.
+   float (* volatile pixget)(void *, size_t) = getPixPointer<float>(imageStructDataT);
+   pixKernels<float> k = getPixKernels<float>(imageStructDataT);
+
+   auto t0 = std::chrono::steady_clock::now();
+   for(int r = 0; r < nrep; ++r)
+   {
+      float * data = accum.data();
+      for(size_t n = 0; n < npix; ++n) data[n] += pixget(im.data(), n);
+   }
+   auto t1 = std::chrono::steady_clock::now();
+   for(int r = 0; r < nrep; ++r)
+   {
+      k.accumulate(accum.data(), im.data(), npix);
+   }
+   auto t2 = std::chrono::steady_clock::now();
+
+   double tp = std::chrono::duration<double>(t1-t0).count()/nrep;
+   double tk = std::chrono::duration<double>(t2-t1).count()/nrep;
+
+   std::cout << name << ": getPix " << tp*1e6 << " usec, kernel " << tk*1e6 << " usec, speedup " << tp/tk << "\n";
+
+   REQUIRE( accum[1] == 2*nrep*7 );
+}
+
+SCENARIO( "Benchmarking bulk pixel kernels", "[.benchmark][pixaccess]" )
+{
+   GIVEN("a 240x240 image of each type")
+   {
+      WHEN("accumulating")
+      {
+         benchKernels<IMAGESTRUCT_UINT8>("uint8");
+         benchKernels<IMAGESTRUCT_INT8>("int8");
+         benchKernels<IMAGESTRUCT_UINT16>("uint16");
+         benchKernels<IMAGESTRUCT_INT16>("int16");
+         benchKernels<IMAGESTRUCT_UINT32>("uint32");
+         benchKernels<IMAGESTRUCT_INT32>("int32");
+         benchKernels<IMAGESTRUCT_UINT64>("uint64");
+         benchKernels<IMAGESTRUCT_INT64>("int64");
+         benchKernels<IMAGESTRUCT_FLOAT>("float");
+         benchKernels<IMAGESTRUCT_DOUBLE>("double");
+      }
+   }
+}
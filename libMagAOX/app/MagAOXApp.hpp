@@ -43,6 +43,7 @@
 #include "indiDriver.hpp"
 #include "indiMacros.hpp"
 #include "indiUtils.hpp"
+#include "indiPublisher.hpp"
 
 using namespace mx::app;
 
@@ -979,6 +980,54 @@ class MagAOXApp : public application
     /// indi Property to clear an FSM alert.
     pcf::IndiProperty m_indiP_clearFSMAlert;
 
+    /// indi Property to report the status of the logger queue.
+    pcf::IndiProperty m_indiP_logQueue;
+
+    /// Update the logger queue status INDI property.
+    /** Only sends if the values have changed and the INDI mutex can be taken without blocking.
+     * This is called from the main loop.
+     */
+    void updateLogQueue();
+
+    /** \name INDI Publish Policies
+     *
+     * A property can be given a publish policy in the config file, in a section named `publish.<property>`:
+     * \code
+       [publish.fps]
+       maxRate=2     # send at most twice per second, the latest value is sent by the flusher thread
+       minDelta=0.1  # a change of 0.1 or less is not a change
+       deadband=0.01 # a change of 1% or less of the value is not a change
+       \endcode
+     * This applies to the updateIfChanged and updateSwitchIfChanged functions.  A change of property state
+     * is always sent immediately. The number of updates not sent for each property is published in the
+     * `indi_publish` property.
+     *
+     * @{
+     */
+
+    /// The publish policies of the properties which have them.
+    indi::indiPublisher m_indiPublisher;
+
+    /// indi Property to report the number of updates not sent for each property with a publish policy.
+    pcf::IndiProperty m_indiP_publish;
+
+    /// The thread which sends the updates held by the publish policies.
+    std::thread m_publishThread;
+
+    /// Load the publish policies from the `publish.<property>` config sections.
+    void loadPublishPolicies();
+
+    /// Sends the updates held by the publish policies, until shutdown.
+    void publishThreadExec();
+
+    /// Update the publish policy status INDI property.
+    /** Only sends if the values have changed and the INDI mutex can be taken without blocking.
+     * This is called from the main loop.
+     */
+    void updatePublishStats();
+
+    ///@} -- INDI Publish Policies
+
     /// The static callback function to be registered for requesting to clear the FSM alert
     /**
      * \returns 0 on success.
@@ -1283,6 +1332,22 @@ void MagAOXApp<_useINDI>::setDefaults( int argc,
         log<software_error>( { __FILE__, __LINE__, "failed to register new fsm_alert property" } );
     }
 
+    createROIndiNumber( m_indiP_logQueue, "logger_queue", "Logger Queue", "Logger" );
+    m_indiP_logQueue.add( pcf::IndiElement( "depth" ) );
+    m_indiP_logQueue["depth"] = 0;
+    m_indiP_logQueue.add( pcf::IndiElement( "max_depth" ) );
+    m_indiP_logQueue["max_depth"] = 0;
+    m_indiP_logQueue.add( pcf::IndiElement( "capacity" ) );
+    m_indiP_logQueue["capacity"] = m_log.queueCapacity();
+    m_indiP_logQueue.add( pcf::IndiElement( "dropped" ) );
+    m_indiP_logQueue["dropped"] = 0;
+    m_indiP_logQueue.add( pcf::IndiElement( "blocked" ) );
+    m_indiP_logQueue["blocked"] = 0;
+    if( registerIndiPropertyReadOnly( m_indiP_logQueue ) < 0 )
+    {
+        log<software_error>( { __FILE__, __LINE__, "failed to register read only logger_queue property" } );
+    }
+
     return;
 }
 
@@ -1382,6 +1447,9 @@ void MagAOXApp<_useINDI>::loadBasicConfig() // virtual
     //--------- Loop Pause Time --------//
     config( m_loopPause, "loopPause" );
 
+    //-------- INDI Publish Policies --------//
+    loadPublishPolicies();
+
     //--------Power Management --------//
     if( m_powerMgtEnabled )
     {
@@ -1588,6 +1656,11 @@ int MagAOXApp<_useINDI>::execute() // virtual
 
             return -1;
         }
+
+        if( m_indiPublisher.flushInterval() > 0 )
+        {
+            m_publishThread = std::thread( &MagAOXApp::publishThreadExec, this );
+        }
     }
 
     // We have to wait for power status to become available
@@ -1701,6 +1774,10 @@ int MagAOXApp<_useINDI>::execute() // virtual
         // mutex was locked on last attempt.
         state( state() );
 
+        updateLogQueue();
+
+        updatePublishStats();
+
         // Pause loop unless shutdown is set
         if( m_shutdown == 0 )
         {
@@ -1715,6 +1792,11 @@ int MagAOXApp<_useINDI>::execute() // virtual
 
     state( stateCodes::SHUTDOWN );
 
+    if( m_publishThread.joinable() )
+    {
+        m_publishThread.join();
+    }
+
     // Stop INDI communications
     if( m_indiDriver != nullptr )
     {
@@ -2302,6 +2384,122 @@ void MagAOXApp<_useINDI>::state( const stateCodes::stateCodeT &s, bool stateAler
     }
 }
 
+template <bool _useINDI>
+void MagAOXApp<_useINDI>::updateLogQueue()
+{
+    if( !m_useINDI )
+        return;
+
+    std::unique_lock<std::mutex> lock( m_indiMutex, std::try_to_lock );
+
+    if( !lock.owns_lock() )
+        return;
+
+    pcf::IndiProperty::PropertyStateType stst = INDI_IDLE;
+    if( m_log.queueDropped() > 0 )
+        stst = INDI_ALERT;
+    else if( m_log.queueBlocked() > 0 )
+        stst = INDI_BUSY;
+
+    updateIfChanged<uint64_t>( m_indiP_logQueue,
+                               { "depth", "max_depth", "capacity", "dropped", "blocked" },
+                               { m_log.queueDepth(),
+                                 m_log.queueMaxDepth(),
+                                 m_log.queueCapacity(),
+                                 m_log.queueDropped(),
+                                 m_log.queueBlocked() },
+                               stst );
+}
+
+template <bool _useINDI>
+void MagAOXApp<_useINDI>::loadPublishPolicies()
+{
+    std::vector<std::string> sections;
+    config.unusedSections( sections );
+
+    std::string prefix = "publish.";
+    for( size_t n = 0; n < sections.size(); ++n )
+    {
+        if( sections[n].size() <= prefix.size() || sections[n].compare( 0, prefix.size(), prefix ) != 0 )
+            continue;
+
+        std::string name = sections[n].substr( prefix.size() );
+
+        indi::publishPolicy pol;
+        config.configUnused( pol.maxRate, mx::app::iniFile::makeKey( sections[n], "maxRate" ) );
+        config.configUnused( pol.minDelta, mx::app::iniFile::makeKey( sections[n], "minDelta" ) );
+        config.configUnused( pol.deadband, mx::app::iniFile::makeKey( sections[n], "deadband" ) );
+
+        if( m_indiPublisher.setPolicy( name, pol ) < 0 )
+        {
+            log<text_log>( "invalid publish policy for " + name + ": values must not be negative", logPrio::LOG_ERROR );
+            continue;
+        }
+
+        log<text_log>( "publish policy for " + name + ": maxRate=" + std::to_string( pol.maxRate ) +
+                       " minDelta=" + std::to_string( pol.minDelta ) + " deadband=" + std::to_string( pol.deadband ) );
+    }
+
+    if( !m_useINDI || m_indiPublisher.empty() )
+        return;
+
+    createROIndiNumber( m_indiP_publish, "indi_publish", "Updates Not Sent", "INDI" );
+    std::vector<std::string> names = m_indiPublisher.names();
+    for( size_t n = 0; n < names.size(); ++n )
+    {
+        m_indiP_publish.add( pcf::IndiElement( names[n] ) );
+        m_indiP_publish[names[n]] = 0;
+    }
+
+    if( registerIndiPropertyReadOnly( m_indiP_publish ) < 0 )
+    {
+        log<software_error>( { __FILE__, __LINE__, "failed to register read only indi_publish property" } );
+    }
+}
+
+template <bool _useINDI>
+void MagAOXApp<_useINDI>::publishThreadExec()
+{
+    double dt = m_indiPublisher.flushInterval();
+
+    while( m_shutdown == 0 )
+    {
+        std::this_thread::sleep_for( std::chrono::duration<double>( dt ) );
+
+        if( m_indiDriver )
+        {
+            m_indiPublisher.flush( m_indiDriver, indi::indiPublisher::now() );
+        }
+    }
+
+    // Send anything still held, so the last values are the ones published.
+    if( m_indiDriver )
+    {
+        m_indiPublisher.flush( m_indiDriver, indi::indiPublisher::now(), true );
+    }
+}
+
+template <bool _useINDI>
+void MagAOXApp<_useINDI>::updatePublishStats()
+{
+    if( !m_useINDI || m_indiPublisher.empty() )
+        return;
+
+    std::unique_lock<std::mutex> lock( m_indiMutex, std::try_to_lock );
+
+    if( !lock.owns_lock() )
+        return;
+
+    std::vector<std::string> names = m_indiPublisher.names();
+    std::vector<uint64_t> suppressed( names.size() );
+    for( size_t n = 0; n < names.size(); ++n )
+    {
+        suppressed[n] = m_indiPublisher.stats( names[n] ).suppressed;
+    }
+
+    updateIfChanged<uint64_t>( m_indiP_publish, names, suppressed );
+}
+
 template <bool _useINDI>
 int MagAOXApp<_useINDI>::stateLogged()
 {
@@ -3073,6 +3271,15 @@ void MagAOXApp<_useINDI>::updateIfChanged( pcf::IndiProperty &p,
     if( !m_indiDriver )
         return;
 
+    if( m_indiPublisher.hasPolicy( p.getName() ) )
+    {
+        double tol = m_indiPublisher.tolerance( p, { el } );
+        indi::indiPublisher::sender<indiDriver<MagAOXApp>> snd{ &m_indiPublisher, m_indiDriver,
+                                                                indi::indiPublisher::now() };
+        indi::updateIfChanged( p, el, newVal, &snd, ipState, tol );
+        return;
+    }
+
     indi::updateIfChanged( p, el, newVal, m_indiDriver, ipState );
 }
 
@@ -3097,6 +3304,15 @@ void MagAOXApp<_useINDI>::updateSwitchIfChanged( pcf::IndiProperty &p,
     if( !m_indiDriver )
         return;
 
+    if( m_indiPublisher.hasPolicy( p.getName() ) )
+    {
+        m_indiPublisher.tolerance( p, {} ); // only counts the update, a switch has no tolerance
+        indi::indiPublisher::sender<indiDriver<MagAOXApp>> snd{ &m_indiPublisher, m_indiDriver,
+                                                                indi::indiPublisher::now() };
+        indi::updateSwitchIfChanged( p, el, newVal, &snd, ipState );
+        return;
+    }
+
     indi::updateSwitchIfChanged( p, el, newVal, m_indiDriver, ipState );
 }
 
@@ -3118,6 +3334,16 @@ void MagAOXApp<_useINDI>::updateIfChanged( pcf::IndiProperty &p,
     {
         descriptors[index] += std::to_string( index );
     }
+
+    if( m_indiPublisher.hasPolicy( p.getName() ) )
+    {
+        double tol = m_indiPublisher.tolerance( p, descriptors );
+        indi::indiPublisher::sender<indiDriver<MagAOXApp>> snd{ &m_indiPublisher, m_indiDriver,
+                                                                indi::indiPublisher::now() };
+        indi::updateIfChanged( p, descriptors, newVals, &snd, pcf::IndiProperty::Ok, tol );
+        return;
+    }
+
     indi::updateIfChanged( p, descriptors, newVals, m_indiDriver );
 }
 
@@ -3134,6 +3360,15 @@ void MagAOXApp<_useINDI>::updateIfChanged( pcf::IndiProperty &p,
     if( !m_indiDriver )
         return;
 
+    if( m_indiPublisher.hasPolicy( p.getName() ) )
+    {
+        double tol = m_indiPublisher.tolerance( p, els );
+        indi::indiPublisher::sender<indiDriver<MagAOXApp>> snd{ &m_indiPublisher, m_indiDriver,
+                                                                indi::indiPublisher::now() };
+        indi::updateIfChanged( p, els, newVals, &snd, newState, tol );
+        return;
+    }
+
     indi::updateIfChanged( p, els, newVals, m_indiDriver, newState );
 }
 
@@ -0,0 +1,192 @@
+/** \file dmPokeSequencer.hpp
+  * \brief Sequencing of DM poke patterns synchronized to WFS frames
+  *
+  * \ingroup app_files
+  *
+  * History:
+  * - 2026-10-17 created
+  */
+
+#ifndef dmPokeSequencer_hpp
+#define dmPokeSequencer_hpp
+
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+namespace MagAOX
+{
+namespace app
+{
+namespace dev
+{
+
+/// Fill a Hadamard matrix, constructed by Sylvester's method
+/** The order N is the smallest power of 2 which is at least \p n.  The entries are +/-1, the first row and
+  * column are all +1, and the columns are orthogonal so that \f$ H^T H = N I \f$.
+  *
+  * \ingroup appdev
+  */
+template<typename realT>
+void hadamardMatrix( Eigen::Matrix<realT, Eigen::Dynamic, Eigen::Dynamic> & H, ///< [out] the matrix, resized to N x N
+                     size_t n ///< [in] the minimum order
+                   )
+{
+    size_t N = 1;
+    while(N < n) N *= 2;
+
+    H.resize(N, N);
+    H(0,0) = 1;
+
+    for(size_t m = 1; m < N; m *= 2)
+    {
+        H.block(0, m, m, m) = H.block(0, 0, m, m);
+        H.block(m, 0, m, m) = H.block(0, 0, m, m);
+        H.block(m, m, m, m) = -H.block(0, 0, m, m);
+    }
+}
+
+/// Sequences push-pull DM poke patterns against the frame counter of the WFS stream
+/** A sequence is nAverage cycles, each of which applies every pattern with a + then a - sign.  After each DM
+  * command the next nSettle frames are skipped, and then nImages frames are used.  The next command is due as
+  * soon as the last of those frames arrives, so the only time not spent integrating is the settling.
+  *
+  * Frames are identified by the stream's cnt0, so a frame seen twice is only used once, and settling is
+  * counted in frames taken by the camera even if some are not seen.  Usage is
+  * \code
+    seq.setup(nPatterns, nSettle, nImages, nAverage);
+    seq.start(cnt0); //cnt0 of the latest frame
+    apply(seq.pattern(), seq.sign());
+    while(!seq.done())
+    {
+        //wait for a frame, with counter cnt0
+        if(seq.frame(cnt0))
+        {
+            //accumulate the frame for seq.pattern() with seq.sign()
+        }
+
+        if(seq.next())
+        {
+            apply(seq.pattern(), seq.sign());
+        }
+    }
+    \endcode
+  *
+  * \ingroup appdev
+  */
+class dmPokeSequencer
+{
+protected:
+    unsigned m_nPatterns {1}; ///< The number of poke patterns.
+    unsigned m_nSettle {1}; ///< The number of frames to skip after each DM command.
+    unsigned m_nImages {1}; ///< The number of frames to use after each DM command.
+    unsigned m_nAverage {1}; ///< The number of cycles through the patterns.
+
+    uint64_t m_nPhases {0}; ///< The number of DM commands in the sequence.
+    uint64_t m_phase {0}; ///< The current DM command, which sets the pattern and sign.
+
+    uint64_t m_appliedCnt0 {0}; ///< The cnt0 of the last frame before the current command was applied.
+    uint64_t m_lastCnt0 {0}; ///< The cnt0 of the last frame seen.
+    unsigned m_nUsed {0}; ///< The number of frames used for the current command.
+
+public:
+
+    /// Setup a sequence
+    void setup( unsigned nPatterns, ///< [in] the number of poke patterns
+                unsigned nSettle,   ///< [in] the number of frames to skip after each DM command.  The frame being taken when the command is sent is one of these.
+                unsigned nImages,   ///< [in] the number of frames to use after each DM command
+                unsigned nAverage   ///< [in] the number of cycles through the patterns
+              )
+    {
+        m_nPatterns = nPatterns;
+        m_nSettle = nSettle;
+        m_nImages = nImages;
+        m_nAverage = nAverage;
+
+        m_nPhases = 2 * static_cast<uint64_t>(m_nPatterns) * m_nAverage;
+        m_phase = m_nPhases;
+    }
+
+    /// Start the sequence, after which the first command should be applied.
+    void start( uint64_t cnt0 /**< [in] the cnt0 of the latest frame*/)
+    {
+        m_phase = 0;
+        m_appliedCnt0 = cnt0;
+        m_lastCnt0 = cnt0;
+        m_nUsed = 0;
+    }
+
+    /// Check if the sequence is complete, or was never started
+    bool done() const
+    {
+        return m_phase >= m_nPhases;
+    }
+
+    /// The pattern of the current command
+    unsigned pattern() const
+    {
+        return (m_phase / 2) % m_nPatterns;
+    }
+
+    /// The sign of the current command
+    int sign() const
+    {
+        return (m_phase % 2 == 0) ? 1 : -1;
+    }
+
+    /// The number of frames used for each pattern and sign over the whole sequence.
+    uint64_t nFrames() const
+    {
+        return static_cast<uint64_t>(m_nImages) * m_nAverage;
+    }
+
+    /// Process a new frame
+    /**
+      * \returns true if the frame should be used for the current pattern() and sign()
+      * \returns false if the frame was already seen, the DM is settling, or the sequence is done
+      */
+    bool frame( uint64_t cnt0 /**< [in] the cnt0 of the frame*/)
+    {
+        if(done() || cnt0 <= m_lastCnt0 || m_nUsed >= m_nImages)
+        {
+            return false;
+        }
+
+        m_lastCnt0 = cnt0;
+
+        if(cnt0 <= m_appliedCnt0 + m_nSettle)
+        {
+            return false;
+        }
+
+        ++m_nUsed;
+
+        return true;
+    }
+
+    /// Move to the next command if enough frames have been used for this one
+    /** Should be called after each frame, and the new command applied immediately if this returns true.
+      *
+      * \returns true if the next command should be applied
+      * \returns false if more frames are needed, or the sequence is done
+      */
+    bool next()
+    {
+        if(done() || m_nUsed < m_nImages)
+        {
+            return false;
+        }
+
+        ++m_phase;
+        m_nUsed = 0;
+        m_appliedCnt0 = m_lastCnt0;
+
+        return !done();
+    }
+};
+
+} //namespace dev
+} //namespace app
+} //namespace MagAOX
+
+#endif //dmPokeSequencer_hpp
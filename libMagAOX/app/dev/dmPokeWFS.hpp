@@ -14,6 +14,8 @@ using namespace mx::improc;
 
 #include "../../ImageStreamIO/pixaccess.hpp"
 
+#include "dmPokeSequencer.hpp"
+
 /** \defgroup dmPokeWFS
   * \brief The MagAO-X device to coordinate poking a deformable mirror's actuators and synchronize reads of a camera image.
   *
@@ -187,18 +189,32 @@ protected:
 
     float m_poke_amp {0.0};
 
-    float m_dmSleep {10000}; ///<The time to sleep for the DM command to be applied, in microseconds. Default is 10000.
+    unsigned m_nSettleFrames {1}; ///< The number of WFS frames to skip after each DM command, including the one being taken when it is sent.  Default is 1.
+
+    bool m_hadamard {false}; ///< If true, the actuators are poked with Hadamard patterns and the response of each is measured.  Default is false.
 
     ///@}
 
     std::mutex m_wfsImageMutex;
 
     mx::improc::milkImage<float> m_rawImage;
+
+    uint64_t m_rawCnt0 {0}; ///< The cnt0 of the WFS frame in m_rawImage
     
     mx::improc::milkImage<float> m_pokeImage;
     mx::improc::eigenImage<float> m_pokeLocal;
 
-    float (*wfsPixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as float
+    dmPokeSequencer m_pokeSeq; ///< Sequences the poke patterns against the WFS frames
+
+    mx::improc::eigenImage<float> m_pokeWeights; ///< The weight of each actuator in each poke pattern, one row per pattern and one column per actuator
+
+    mx::improc::eigenImage<float> m_pokeAccum; ///< The push-pull sum of the frames of each pattern, one column per pattern
+
+    mx::improc::eigenImage<float> m_imat; ///< The response of each actuator, one column per actuator, from a Hadamard sequence
+
+    mx::improc::milkImage<float> m_imatImage; ///< The stream to publish m_imat
+
+    pixKernels<float> wfsPixkern; ///< The kernels to extract the image data as float
 
     float m_wfsFps {-1}; ///< The WFS camera FPS
 
@@ -206,7 +222,7 @@ protected:
 
     bool m_darkValid {false}; ///< Flag indicating if dark is valid based on its size.
 
-    float (*darkPixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the dark image data as float
+    pixKernels<float> darkPixkern; ///< The kernels to extract the dark image data as float
 
     mx::improc::milkImage<float> m_dmStream;
 
@@ -353,21 +369,34 @@ protected:
     unsigned m_imageSemWait_nsec {0}; ///< The timeout for the image semaphore, nanoseconds component.
 
 
-    /// Apply a single DM poke pattern and record the results
-    /** This accumulates m_nPokeImages*m_nPokeAverage images in m_pokeLocal, so m_pokeLocal
-      * should be zeroed before the first call to this (e.g. for a +1 poke), 
-      * but not zeroed before the second call (e.g. for the -1 poke). You also need
-      * to 0 the DM after finishing a poke pair.
-      * See basicRunSensor() for how to use.
+    /// Wait for the next WFS frame
+    /**
+      * \returns +1 if exit is due to shutdown or stop request
+      * \returns 0 if a new frame is in m_rawImage
+      * \returns -1 if an error occurs
+      */
+    int waitPokeFrame();
+
+    /// Send a poke pattern to the DM
+    void applyPokePattern( unsigned pattern, ///< [in] the row of m_pokeWeights to apply
+                           int sign          ///< [in] the sign to apply to m_poke_amp
+                         );
+
+    /// Run a push-pull sequence of the poke patterns in m_pokeWeights, synchronized to the WFS frames
+    /** The frames of each pattern are summed, with the sign of the poke, into the columns of m_pokeAccum. Each command
+      * is sent as soon as the last frame of the one before it arrives, and then m_nSettleFrames frames are skipped, so
+      * no time is spent sleeping.  The DM is zeroed at the end.
       * 
       * \returns +1 if exit is due to shutdown or stop request
       * \returns 0 if no error
       * \returns -1 if an error occurs
       */
-    int basicTimedPoke(float pokeSign /**< [in] the sign, and possibly a scaling, to apply to m_pokeAmplitude*/);
+    int runPokeSequence();
 
     /// Run the basic +/- poke sensor steps 
-    /** Coordinates the actions of poking and collecting images.
+    /** Coordinates the actions of poking and collecting images, and updates m_pokeImage with the response to poking all
+      * actuators by m_poke_amp.  If m_hadamard is true the actuators are poked with Hadamard patterns, and m_imat and
+      * m_imatImage are also updated with the response to each actuator.
       * 
       * This can be called from the derived class runSensor.
       * 
@@ -395,6 +424,9 @@ protected:
     pcf::IndiProperty m_indiP_nPokeAverage;
     INDI_NEWCALLBACK_DECL(derivedT, m_indiP_nPokeAverage);
 
+    pcf::IndiProperty m_indiP_nSettleFrames;
+    INDI_NEWCALLBACK_DECL(derivedT, m_indiP_nSettleFrames);
+
     pcf::IndiProperty m_indiP_wfsFps; ///< Property to get the FPS from the WFS camera
     INDI_SETCALLBACK_DECL(derivedT, m_indiP_wfsFps);
 
@@ -453,9 +485,10 @@ int dmPokeWFS<derivedT>::setupConfig(mx::app::appConfigurator & config)
     config.add("pokecen.pokeX", "", "pokecen.pokeX", argType::Required, "pokecen", "pokeX", false, "vector<int>", "The x-coordinates of the actuators to poke. ");
     config.add("pokecen.pokeY", "", "pokecen.pokeY", argType::Required, "pokecen", "pokeY", false, "vector<int>", "The y-coordinates of the actuators to poke. ");
     config.add("pokecen.pokeAmp", "", "pokecen.pokeAmp", argType::Required, "pokecen", "pokeAmp", false, "float", "The poke amplitude, in DM command units. Default is 0.");
-    config.add("pokecen.dmSleep", "", "pokecen.dmSleep", argType::Required, "pokecen", "dmSleep", false, "float", "The time to sleep for the DM command to be applied, in microseconds. Default is 10000.");
+    config.add("pokecen.nSettleFrames", "", "pokecen.nSettleFrames", argType::Required, "pokecen", "nSettleFrames", false, "int", "The number of WFS frames to skip after each DM command, including the one being taken when it is sent. Default is 1.");
     config.add("pokecen.nPokeImages", "", "pokecen.nPokeImages", argType::Required, "pokecen", "nPokeImages", false, "int", "The number of poke images to average.  Default 5.");
     config.add("pokecen.nPokeAverage", "", "pokecen.nPokeAverage", argType::Required, "pokecen", "nPokeAverage", false, "int", "The number of poke sequences to average.  Default 10.");
+    config.add("pokecen.hadamard", "", "pokecen.hadamard", argType::Required, "pokecen", "hadamard", false, "bool", "If true, poke the actuators with Hadamard patterns and measure the response of each. Default is false.");
 
 
     return 0;    
@@ -502,12 +535,14 @@ int dmPokeWFS<derivedT>::loadConfig( mx::app::appConfigurator & config)
 
     config(m_poke_amp, "pokecen.pokeAmp");
 
-    config(m_dmSleep, "pokecen.dmSleep");
+    config(m_nSettleFrames, "pokecen.nSettleFrames");
 
     config(m_nPokeImages, "pokecen.nPokeImages");
 
     config(m_nPokeAverage, "pokecen.nPokeAverage");
 
+    config(m_hadamard, "pokecen.hadamard");
+
     return 0;
 }
 
@@ -536,6 +571,10 @@ int dmPokeWFS<derivedT>::appStartup()
     m_indiP_nPokeAverage["current"].setValue(m_nPokeAverage);
     m_indiP_nPokeAverage["target"].setValue(m_nPokeAverage);
 
+    CREATE_REG_INDI_NEW_NUMBERI_DERIVED(m_indiP_nSettleFrames, "nSettleFrames", 0, 1000, 1, "%d", "", "");
+    m_indiP_nSettleFrames["current"].setValue(m_nSettleFrames);
+    m_indiP_nSettleFrames["target"].setValue(m_nSettleFrames);
+
     REG_INDI_SETPROP_DERIVED(m_indiP_wfsFps, m_wfsCamDevName, std::string("fps"));
     
     CREATE_REG_INDI_NEW_TOGGLESWITCH_DERIVED( m_indiP_single, "single");
@@ -625,6 +664,7 @@ int dmPokeWFS<derivedT>::appLogic()
 
     derived().template updateIfChanged( m_indiP_nPokeImages, "current", m_nPokeImages);
     derived().template updateIfChanged( m_indiP_nPokeAverage, "current", m_nPokeAverage);
+    derived().template updateIfChanged( m_indiP_nSettleFrames, "current", m_nSettleFrames);
     derived().template updateIfChanged( m_indiP_poke_amp, "current", m_poke_amp);
 
     return 0;
@@ -667,7 +707,7 @@ int dmPokeWFS<derivedT>::allocate( const wfsShmimT & dummy)
 
     m_rawImage.create( derived().m_configName + "_raw", derived().shmimMonitor().width(), derived().shmimMonitor().height());
 
-    wfsPixget = getPixPointer<float>(derived().shmimMonitor().dataType());
+    wfsPixkern = getPixKernels<float>(derived().shmimMonitor().dataType());
 
     try
     {
@@ -697,6 +737,15 @@ int dmPokeWFS<derivedT>::allocate( const wfsShmimT & dummy)
 
     m_pokeLocal.resize(derived().shmimMonitor().width(), derived().shmimMonitor().height());
 
+    if(m_hadamard)
+    {
+        uint32_t npix = derived().shmimMonitor().width()*derived().shmimMonitor().height();
+        if(m_imatImage.rows() != npix || m_imatImage.cols() != m_poke_x.size())
+        {
+            m_imatImage.create(derived().m_configName + "_imat", npix, m_poke_x.size());
+        }
+    }
+
     return 0;
 }
 
@@ -717,19 +766,15 @@ int dmPokeWFS<derivedT>::processImage( void * curr_src,
 
     if(m_darkValid)
     {
-        for(unsigned nn=0; nn < Npix; ++nn)
-        {
-            data[nn] = wfsPixget(curr_src, nn) - darkData[nn];
-        }
+        wfsPixkern.darkSubtract(data, curr_src, darkData, Npix);
     }
     else
     {
-        for(unsigned nn=0; nn < Npix; ++nn)
-        {
-            data[nn] = wfsPixget(curr_src, nn);
-        }
+        wfsPixkern.convert(data, curr_src, Npix);
     }
 
+    m_rawCnt0 = derived().shmimMonitor().lastCnt0();
+
     if(sem_post(&m_imageSemaphore) < 0)
     {
         return derivedT::template log<software_critical, -1>({__FILE__, __LINE__, errno, 0, "Error posting to semaphore"});
@@ -749,7 +794,7 @@ int dmPokeWFS<derivedT>::allocate( const darkShmimT & dummy)
 
     m_darkImage.resize(derived().darkShmimMonitor().width(), derived().darkShmimMonitor().height());
 
-    darkPixget = getPixPointer<float>(derived().darkShmimMonitor().dataType());
+    darkPixkern = getPixKernels<float>(derived().darkShmimMonitor().dataType());
 
     if(derived().darkShmimMonitor().width() == derived().shmimMonitor().width() && 
          derived().darkShmimMonitor().height() == derived().shmimMonitor().height() )
@@ -779,10 +824,7 @@ int dmPokeWFS<derivedT>::processImage( void * curr_src,
 
     //Copy the data out as float no matter what type it is
     uint64_t nPix = derived().darkShmimMonitor().width()*derived().darkShmimMonitor().height();
-    for(unsigned nn=0; nn < nPix; ++nn)
-    {
-        darkData[nn] = darkPixget(curr_src, nn);
-    }
+    darkPixkern.convert(darkData, curr_src, nPix);
 
     return 0;
 }
@@ -882,132 +924,152 @@ void dmPokeWFS<derivedT>::wfsThreadExec()
 }
 
 template<class derivedT>
-int dmPokeWFS<derivedT>::basicTimedPoke(float pokeSign)
+int dmPokeWFS<derivedT>::waitPokeFrame()
 {
     timespec ts;
 
-    int sign = 1;
-    if(pokeSign < 0) sign = -1;
+    while(!(m_stopMeasurement || derived().m_shutdown))
+    {
+        XWC_SEM_WAIT_TS_DERIVED(ts, m_imageSemWait_sec, m_imageSemWait_nsec);
+        XWC_SEM_TIMEDWAIT_LOOP_DERIVED( m_imageSemaphore, ts )
+
+        //If here, we got an image.  m_rawImage will have been updated
+        return 0;
+    }
 
-    //Prepare the DM image with the pokes
+    if(m_stopMeasurement || derived().m_shutdown)
+    {
+        return 1;
+    }
+
+    return -1;
+}
+
+template<class derivedT>
+void dmPokeWFS<derivedT>::applyPokePattern( unsigned pattern,
+                                            int sign
+                                          )
+{
     m_dmImage.setZero();
 
     for(size_t nn = 0; nn < m_poke_x.size(); ++nn)
     {
-        m_dmImage( m_poke_x[nn], m_poke_y[nn]) = pokeSign*m_poke_amp;
+        m_dmImage( m_poke_x[nn], m_poke_y[nn]) = sign*m_poke_amp*m_pokeWeights(pattern, nn);
     }
 
     //This is where the pokes are applied to the DM
     m_dmStream = m_dmImage;
+}
+
+template<class derivedT>
+int dmPokeWFS<derivedT>::runPokeSequence()
+{
+    uint64_t npix = derived().shmimMonitor().width()*derived().shmimMonitor().height();
 
-    mx::sys::microSleep(m_dmSleep);
+    m_pokeAccum.setZero(npix, m_pokeWeights.rows());
 
-    //flush semaphore so we take the _next_ good image
-    XWC_SEM_FLUSH_DERIVED(m_imageSemaphore);
+    m_pokeSeq.setup(m_pokeWeights.rows(), m_nSettleFrames, m_nPokeImages, m_nPokeAverage);
 
-    //** And wait one image to be sure we are on a whole poke**//
-    XWC_SEM_WAIT_TS_DERIVED(ts, m_imageSemWait_sec, m_imageSemWait_nsec);
-    bool ready = false;
-    while(!ready && !(m_stopMeasurement || derived().m_shutdown))
+    std::unique_lock<std::mutex> lock(m_wfsImageMutex);
+    m_pokeSeq.start(m_rawCnt0);
+    lock.unlock();
+
+    applyPokePattern(m_pokeSeq.pattern(), m_pokeSeq.sign());
+
+    int rv = 0;
+    while(!m_pokeSeq.done())
     {
-        XWC_SEM_TIMEDWAIT_LOOP_DERIVED( m_imageSemaphore, ts )
-        else
+        rv = waitPokeFrame();
+        if(rv != 0)
         {
-            ready = true;
-        }        
-    }
-
-    uint32_t n = 0;
-    while(n < m_nPokeImages && !(m_stopMeasurement || derived().m_shutdown))
-    {    
-        //** Now we record the poke image **//
-        XWC_SEM_WAIT_TS_DERIVED(ts, m_imageSemWait_sec, m_imageSemWait_nsec);
-        XWC_SEM_TIMEDWAIT_LOOP_DERIVED( m_imageSemaphore, ts )
+            break;
+        }
 
-        //If here, we got an image.  m_rawImage will have been updated
-        m_pokeLocal +=  sign*m_rawImage();
+        lock.lock();
+        if(m_pokeSeq.frame(m_rawCnt0))
+        {
+            m_pokeAccum.col(m_pokeSeq.pattern()) += static_cast<float>(m_pokeSeq.sign()) * Eigen::Map<Eigen::ArrayXf>(m_rawImage().data(), npix);
+        }
+        lock.unlock();
 
-        ++n;
+        if(m_pokeSeq.next())
+        {
+            applyPokePattern(m_pokeSeq.pattern(), m_pokeSeq.sign());
+        }
     }
-        
-    if(m_stopMeasurement || derived().m_shutdown) 
+
+    m_dmImage.setZero();
+    m_dmStream = m_dmImage;
+
+    if(rv < 0)
     {
-        m_dmImage.setZero();
-        m_dmStream = m_dmImage;
-        return 1;
+        derivedT::template log<software_error>({__FILE__, __LINE__, "error waiting for WFS frame"});
     }
 
-    return 0;
+    return rv;
 }
 
 template<class derivedT>
 int dmPokeWFS<derivedT>::basicRunSensor()
 {
-    int rv;
-
     if(!m_pokeImage.valid())
     {
         return derivedT::template log<software_error,-1>({__FILE__, __LINE__, "poke image is not allocated"});
     }
 
-    m_pokeLocal.setZero();
+    size_t nPokes = m_poke_x.size();
 
-    for(unsigned nseq = 0; nseq < m_nPokeAverage; ++nseq)
+    if(m_hadamard)
     {
+        Eigen::MatrixXf H;
+        hadamardMatrix(H, nPokes);
+        m_pokeWeights = H.leftCols(nPokes).array();
+    }
+    else
+    {
+        m_pokeWeights.setConstant(1, nPokes, 1);
+    }
 
-        //************** positive POKE **********************/
-
-        rv = basicTimedPoke(+1);
+    int rv = runPokeSequence();
 
-        if(rv < 0)
-        {
-            derivedT::template log<software_error>({__FILE__, __LINE__});
-            return rv;
-        }
-        else if (rv > 0) // shutdown
-        {
-            return rv;
-        }
+    if(rv != 0)
+    {
+        return rv;
+    }
 
-        if(m_stopMeasurement || derived().m_shutdown) 
-        {
-            break;
-        }
+    uint64_t npix = derived().shmimMonitor().width()*derived().shmimMonitor().height();
+    float norm = 2.0*m_pokeSeq.nFrames();
 
-        //************** NEGATIVE POKE **********************/
+    Eigen::Map<Eigen::VectorXf> pokeLocal(m_pokeLocal.data(), npix);
 
-        rv = basicTimedPoke(-1);
+    if(m_hadamard)
+    {
+        //Demodulate, using the orthogonality of the columns of the Hadamard matrix
+        m_imat.resize(npix, nPokes);
+        m_imat.matrix() = m_pokeAccum.matrix() * m_pokeWeights.matrix() / (norm*m_pokeWeights.rows());
 
-        if(rv < 0)
-        {
-            derivedT::template log<software_error>({__FILE__, __LINE__});
-            return rv;
-        }
-        else if (rv > 0) // shutdown
-        {
-            return rv;
-        }
-    
-        if(m_stopMeasurement || derived().m_shutdown) 
-        {
-            break;
-        }
+        //The response to poking all actuators at once
+        pokeLocal = m_imat.matrix().rowwise().sum();
+    }
+    else
+    {
+        pokeLocal = m_pokeAccum.matrix().col(0) / norm;
     }
 
     try
     {
-        m_pokeImage = m_pokeLocal/(2.0*m_nPokeImages*m_nPokeAverage);
+        m_pokeImage = m_pokeLocal;
+
+        if(m_hadamard)
+        {
+            m_imatImage = m_imat;
+        }
     }
     catch(const std::exception& e)
     {
         return derivedT::template log<software_error,-1>({__FILE__, __LINE__, e.what()});
     }
 
-   
-
-    m_dmImage.setZero();
-    m_dmStream = m_dmImage;
-
     return 0;
 }
 
@@ -1058,6 +1120,23 @@ INDI_NEWCALLBACK_DEFN( dmPokeWFS<derivedT>, m_indiP_nPokeAverage )(const pcf::In
     return 0;
 }
 
+template<class derivedT>
+INDI_NEWCALLBACK_DEFN( dmPokeWFS<derivedT>, m_indiP_nSettleFrames )(const pcf::IndiProperty &ipRecv)
+{
+    INDI_VALIDATE_CALLBACK_PROPS_DERIVED(m_indiP_nSettleFrames, ipRecv)
+   
+    float target;
+
+    if( derived().template indiTargetUpdate(m_indiP_nSettleFrames, target, ipRecv, false) < 0)
+    {
+        return derivedT::template log<software_error,-1>({__FILE__, __LINE__});
+    }
+
+    m_nSettleFrames = target;
+
+    return 0;
+}
+
 template<class derivedT>
 INDI_NEWCALLBACK_DEFN( dmPokeWFS<derivedT>, m_indiP_poke_amp )(const pcf::IndiProperty &ipRecv)
 {
@@ -10,6 +10,9 @@
 #define frameGrabber_hpp
 
 #include <sys/syscall.h>
+
+#include <atomic>
+#include <limits>
        
 #include <mx/sigproc/circularBuffer.hpp>
 #include <mx/math/vectorUtils.hpp>
@@ -19,6 +22,7 @@
 #include <ImageStreamIO/ImageStreamIO.h>
 
 #include "../../common/paths.hpp"
+#include "../../utils/latencyHistogram.hpp"
 
 
 namespace MagAOX
@@ -63,6 +67,7 @@ namespace dev
     
     //Acquires the data, and checks if it is valid.
     //This should set m_currImageTimestamp to the image timestamp.
+    //If the camera has a frame counter, this should also set m_currImageFrameNo.
     // returns 0 if valid, < 0 on error, > 0 on no data.
     int derivedT::acquireAndCheckValid()
     
@@ -83,6 +88,15 @@ namespace dev
   * \endcode
   * which determines whether or not the images can be flipped programatically.
   *
+  * Every frame is instrumented.  The time taken by `loadImageIntoStream` (copy) and the time from the image
+  * timestamp to the end of the write (acquire-to-write) are recorded in lock-free histograms, from which the
+  * 50th, 99th, and 99.9th percentiles and the maximum are found over each `appLogic` interval.  The calls to
+  * `acquireAndCheckValid`, the frames written, and the frames dropped and duplicated are counted.  Dropped frames
+  * are gaps in `m_currImageFrameNo`, if the derived class sets it, which can also add frames it knows were dropped
+  * to `m_fgDropped`.  A duplicated frame has the same frame number, or without a frame number the same timestamp,
+  * as the previous frame.  These are reported in the `fg_latency` and `fg_frames` INDI properties and in
+  * the `telem_fgstats` telemetry.
+  *
   * Calls to this class's `setupConfig`, `loadConfig`, `appStartup`, `appLogic`, `updateINDI`, and `appShutdown`
   * functions must be placed in the derived class's functions of the same name. For convenience the 
   *   following macros are defined to provide error checking:
@@ -135,6 +149,11 @@ protected:
    
           
    timespec m_currImageTimestamp {0,0}; ///< The timestamp of the current image.
+
+   /// Value of m_currImageFrameNo meaning the camera does not provide a frame number.
+   static constexpr uint64_t c_noFrameNo = std::numeric_limits<uint64_t>::max();
+
+   uint64_t m_currImageFrameNo {c_noFrameNo}; ///< The camera's frame number of the current image.  Set by derived classes with a frame counter.
    
    bool m_reconfig {false}; ///< Flag to set if a camera reconfiguration requires a framegrabber reset.
    
@@ -162,6 +181,35 @@ protected:
    double m_mnwa;  
    double m_varwa; 
    
+   /** \name Frame Statistics
+     * Written by the framegrabber thread, read by appLogic.
+     * @{
+     */
+   utils::latencyHistogram m_copyHist; ///< Histogram of the time taken by loadImageIntoStream [nsec]
+   utils::latencyHistogram m_awHist; ///< Histogram of the time from the image timestamp to the end of the write [nsec]
+
+   std::atomic<uint64_t> m_fgAcquires {0}; ///< Calls to acquireAndCheckValid.
+   std::atomic<uint64_t> m_fgFrames {0}; ///< Frames written to the stream.
+   std::atomic<uint64_t> m_fgDropped {0}; ///< Frames dropped, from gaps in the camera frame number.  Derived classes may add to this.
+   std::atomic<uint64_t> m_fgDuplicated {0}; ///< Frames with the same frame number or timestamp as the previous one.
+
+   std::vector<uint64_t> m_copyHistCounts; ///< The copy histogram over the last interval.
+   std::vector<uint64_t> m_copyHistLast; ///< The copy histogram at the end of the last interval.
+   std::vector<uint64_t> m_awHistCounts; ///< The acquire-to-write histogram over the last interval.
+   std::vector<uint64_t> m_awHistLast; ///< The acquire-to-write histogram at the end of the last interval.
+
+   double m_copyP50 {0}; ///< The 50th percentile of the copy time [sec]
+   double m_copyP99 {0}; ///< The 99th percentile of the copy time [sec]
+   double m_copyP999 {0}; ///< The 99.9th percentile of the copy time [sec]
+   double m_copyMax {0}; ///< The maximum copy time [sec]
+
+   double m_awP50 {0}; ///< The 50th percentile of the acquire-to-write time [sec]
+   double m_awP99 {0}; ///< The 99th percentile of the acquire-to-write time [sec]
+   double m_awP999 {0}; ///< The 99.9th percentile of the acquire-to-write time [sec]
+   double m_awMax {0}; ///< The maximum acquire-to-write time [sec]
+
+   ///@}
+   
    
    
    
@@ -281,6 +329,10 @@ protected:
    pcf::IndiProperty m_indiP_frameSize; ///< Property used to report the current frame size
 
    pcf::IndiProperty m_indiP_timing;
+
+   pcf::IndiProperty m_indiP_latency; ///< Property used to report the copy and acquire-to-write percentiles
+
+   pcf::IndiProperty m_indiP_frames; ///< Property used to report the frame accounting
 public:
 
    /// Update the INDI properties for this device controller
@@ -300,6 +352,11 @@ public:
 
    int recordFGTimings( bool force = false );
 
+   /// Record the latency and frame counting statistics
+   /** Called by recordFGTimings when forced, so this is recorded at the cadence of the derived app's recordTelem.
+     */
+   int recordFGStats( bool force = false );
+
    /// @}
 
 private:
@@ -446,6 +503,40 @@ int frameGrabber<derivedT>::appStartup()
       return -1;
    }
 
+   //Register the latency INDI property
+   derived().createROIndiNumber( m_indiP_latency, "fg_latency");
+   m_indiP_latency.add(pcf::IndiElement("copy_p50"));
+   m_indiP_latency.add(pcf::IndiElement("copy_p99"));
+   m_indiP_latency.add(pcf::IndiElement("copy_p999"));
+   m_indiP_latency.add(pcf::IndiElement("copy_max"));
+   m_indiP_latency.add(pcf::IndiElement("aw_p50"));
+   m_indiP_latency.add(pcf::IndiElement("aw_p99"));
+   m_indiP_latency.add(pcf::IndiElement("aw_p999"));
+   m_indiP_latency.add(pcf::IndiElement("aw_max"));
+
+   if( derived().registerIndiPropertyReadOnly( m_indiP_latency ) < 0)
+   {
+      #ifndef STDCAMERA_TEST_NOLOG
+      derivedT::template log<software_error>({__FILE__,__LINE__});
+      #endif
+      return -1;
+   }
+
+   //Register the frames INDI property
+   derived().createROIndiNumber( m_indiP_frames, "fg_frames");
+   m_indiP_frames.add(pcf::IndiElement("acquires"));
+   m_indiP_frames.add(pcf::IndiElement("frames"));
+   m_indiP_frames.add(pcf::IndiElement("dropped"));
+   m_indiP_frames.add(pcf::IndiElement("duplicated"));
+
+   if( derived().registerIndiPropertyReadOnly( m_indiP_frames ) < 0)
+   {
+      #ifndef STDCAMERA_TEST_NOLOG
+      derivedT::template log<software_error>({__FILE__,__LINE__});
+      #endif
+      return -1;
+   }
+
    //Start the f.g. thread
    if(derived().threadStart( m_fgThread, m_fgThreadInit, m_fgThreadID, m_fgThreadProp, m_fgThreadPrio, m_fgCpuset, "framegrabber", this, fgThreadStart) < 0)
    {
@@ -468,6 +559,19 @@ int frameGrabber<derivedT>::appLogic()
       return -1;
    }
    
+   //Get the latency percentiles over the interval since the last call.
+   uint64_t nc = m_copyHist.interval(m_copyHistCounts, m_copyHistLast);
+   m_copyP50 = utils::latencyHistogram::percentile(m_copyHistCounts, nc, 0.5)/1e9;
+   m_copyP99 = utils::latencyHistogram::percentile(m_copyHistCounts, nc, 0.99)/1e9;
+   m_copyP999 = utils::latencyHistogram::percentile(m_copyHistCounts, nc, 0.999)/1e9;
+   m_copyMax = utils::latencyHistogram::max(m_copyHistCounts)/1e9;
+
+   uint64_t naw = m_awHist.interval(m_awHistCounts, m_awHistLast);
+   m_awP50 = utils::latencyHistogram::percentile(m_awHistCounts, naw, 0.5)/1e9;
+   m_awP99 = utils::latencyHistogram::percentile(m_awHistCounts, naw, 0.99)/1e9;
+   m_awP999 = utils::latencyHistogram::percentile(m_awHistCounts, naw, 0.999)/1e9;
+   m_awMax = utils::latencyHistogram::max(m_awHistCounts)/1e9;
+
    if( derived().state() == stateCodes::OPERATING && m_atimes.size() > 0 )
    {
       if(m_atimes.size() >= m_atimes.maxEntries())
@@ -665,6 +769,10 @@ void frameGrabber<derivedT>::fgThreadExec()
       if(derived().startAcquisition() < 0) continue;       
          
       uint64_t next_cnt1 = 0; 
+
+      uint64_t last_frameNo = c_noFrameNo;
+      timespec last_atime = {0,0};
+      m_currImageFrameNo = c_noFrameNo;
       char * next_dest = (char *) m_imageStream->array.raw;
       timespec * next_wtimearr = &m_imageStream->writetimearray[0];
       timespec * next_atimearr = &m_imageStream->atimearray[0];
@@ -677,6 +785,8 @@ void frameGrabber<derivedT>::fgThreadExec()
          //Get next image, process validity.
          //====================         
          int isValid = derived().acquireAndCheckValid();
+         m_fgAcquires.fetch_add(1, std::memory_order_relaxed);
+
          if(isValid != 0)
          {
             if( isValid < 0)
@@ -726,6 +836,38 @@ void frameGrabber<derivedT>::fgThreadExec()
             m_atimes.nextEntry(m_imageStream->md->atime);
             m_wtimes.nextEntry(m_imageStream->md->writetime);
          }
+
+         //Update the frame statistics
+         const timespec & wt = m_imageStream->md->writetime;
+
+         int64_t copyns = (wt.tv_sec - writestart.tv_sec)*1000000000LL + (wt.tv_nsec - writestart.tv_nsec);
+         if(copyns >= 0) m_copyHist.record(copyns);
+
+         int64_t awns = (wt.tv_sec - m_currImageTimestamp.tv_sec)*1000000000LL + (wt.tv_nsec - m_currImageTimestamp.tv_nsec);
+         if(awns >= 0) m_awHist.record(awns); //A negative time means the camera clock isn't the system clock.
+
+         m_fgFrames.fetch_add(1, std::memory_order_relaxed);
+
+         if(m_currImageFrameNo != c_noFrameNo)
+         {
+            if(last_frameNo != c_noFrameNo)
+            {
+               if(m_currImageFrameNo == last_frameNo)
+               {
+                  m_fgDuplicated.fetch_add(1, std::memory_order_relaxed);
+               }
+               else if(m_currImageFrameNo > last_frameNo + 1) //a decrease is a counter reset
+               {
+                  m_fgDropped.fetch_add(m_currImageFrameNo - last_frameNo - 1, std::memory_order_relaxed);
+               }
+            }
+            last_frameNo = m_currImageFrameNo;
+         }
+         else if(m_currImageTimestamp.tv_sec == last_atime.tv_sec && m_currImageTimestamp.tv_nsec == last_atime.tv_nsec)
+         {
+            m_fgDuplicated.fetch_add(1, std::memory_order_relaxed);
+         }
+         last_atime = m_currImageTimestamp;
          
          //Now we increment pointers outside the time-critical part of the loop.
          next_cnt1 = m_imageStream->md->cnt1+1;
@@ -805,6 +947,12 @@ int frameGrabber<derivedT>::updateINDI()
 
    indi::updateIfChanged<double>(m_indiP_timing, {"acq_fps","acq_jitter","write_fps","write_jitter","delta_aw","delta_aw_jitter"}, 
                         {fpsa, sqrt(m_vara), fpsw, sqrt(m_varw), m_mnwa, sqrt(m_varwa)},derived().m_indiDriver);
+
+   indi::updateIfChanged<double>(m_indiP_latency, {"copy_p50","copy_p99","copy_p999","copy_max","aw_p50","aw_p99","aw_p999","aw_max"},
+                        {m_copyP50, m_copyP99, m_copyP999, m_copyMax, m_awP50, m_awP99, m_awP999, m_awMax},derived().m_indiDriver);
+
+   indi::updateIfChanged<double>(m_indiP_frames, {"acquires","frames","dropped","duplicated"},
+                        {(double) m_fgAcquires, (double) m_fgFrames, (double) m_fgDropped, (double) m_fgDuplicated},derived().m_indiDriver);
    
    return 0;
 }
@@ -835,10 +983,41 @@ int frameGrabber<derivedT>::recordFGTimings( bool force )
       last_varwa = m_varwa;
    }
 
+   if(force) recordFGStats(true);
+
    return 0;
 
 }
 
+template<class derivedT>
+int frameGrabber<derivedT>::recordFGStats( bool force )
+{
+   static double last_copyP99 = 0;
+   static double last_awP99 = 0;
+   static uint64_t last_frames = 0;
+   static uint64_t last_dropped = 0;
+   static uint64_t last_duplicated = 0;
+
+   uint64_t frames = m_fgFrames;
+   uint64_t dropped = m_fgDropped;
+   uint64_t duplicated = m_fgDuplicated;
+
+   if(force || m_copyP99 != last_copyP99 || m_awP99 != last_awP99 || frames != last_frames || 
+                 dropped != last_dropped || duplicated != last_duplicated )
+   {
+      derived().template telem<telem_fgstats>({m_copyP50, m_copyP99, m_copyP999, m_copyMax, m_awP50, m_awP99, m_awP999, m_awMax,
+                                                (uint64_t) m_fgAcquires, frames, dropped, duplicated});
+
+      last_copyP99 = m_copyP99;
+      last_awP99 = m_awP99;
+      last_frames = frames;
+      last_dropped = dropped;
+      last_duplicated = duplicated;
+   }
+
+   return 0;
+}
+
 /// Call frameGrabberT::setupConfig with error checking for frameGrabber
 /**
   * \param cfig the application configurator 
@@ -9,10 +9,14 @@
 #ifndef shmimMonitor_hpp
 #define shmimMonitor_hpp
 
+#include <atomic>
+#include <mutex>
+
 #include <ImageStreamIO/ImageStruct.h>
 #include <ImageStreamIO/ImageStreamIO.h>
 
 #include "../../libMagAOX/common/paths.hpp"
+#include "semUtilsDerived.hpp"
 
 namespace MagAOX
 {
@@ -90,6 +94,10 @@ struct shmimT
   *       SHMIMMONITORT_APP_SHUTDOWN( SHMIMMONITORT )
   *   \endcode
   *
+  * If the monitor is made passive, by calling `passive(true)` before `appStartup`, the monitor thread still
+  * connects to the stream, calls `allocate`, and restarts if the stream changes, but it does not wait for new images.
+  * Instead another thread, normally a frameGrabber thread, calls `waitImage` which waits for the next image and calls
+  * `processImage` on that thread.  See streamProcessor.
   *
   * \ingroup appdev
   */
@@ -124,6 +132,16 @@ protected:
 
     ino_t m_inode{0}; ///< The inode of the image stream file
 
+    bool m_passive{false}; ///< If true the monitor thread does not wait for images, which are read by another thread with waitImage.
+
+    std::atomic<bool> m_smReady{false}; ///< True while the stream is open and allocated, so waitImage can read it.
+
+    std::mutex m_smReadMutex; ///< Held by waitImage while it reads the stream, so the monitor thread does not close it.
+
+    uint64_t m_smLastCnt0{0}; ///< The cnt0 of the last image read by waitImage, for busy-polling.
+
+    uint64_t m_smImageCnt0{0}; ///< The cnt0 of the image passed to processImage, read with cnt1 before the call.
+
 public:
 
     const std::string & shmimName() const;
@@ -138,6 +156,31 @@ public:
 
     const size_t &typeSize() const;
 
+    /// Get the frame counter of the image passed to processImage
+    /** Read from the stream along with cnt1 before processImage is called, so it labels that image even if the
+      * stream has since been written.  Only meaningful from processImage.
+      */
+    uint64_t lastCnt0() const;
+
+    /// Set whether the monitor thread is passive
+    /** Must be called before appStartup.
+      */
+    void passive(bool p /**< [in] if true, images are read by another thread with waitImage */);
+
+    /// Get whether the monitor thread is passive
+    bool passive() const;
+
+    /// Wait for the next image and process it on the calling thread
+    /** For use when the monitor is passive.  Waits up to 1 second on the stream's semaphore or, if busyPoll
+      * is true, by spinning on `md->cnt0`, then calls `derivedT::processImage` on the calling thread.
+      * While this runs the monitor thread can not close the stream.
+      *
+      * \returns 0 if an image was processed
+      * \returns 1 if there was no new image, because of a timeout or the stream not being ready
+      * \returns -1 on an error, which is logged.
+      */
+    int waitImage(bool busyPoll /**< [in] if true, spin on cnt0 instead of waiting on the semaphore */);
+
     /// Setup the configuration system
     /**
       * This should be called in `derivedT::setupConfig` as
@@ -225,6 +268,13 @@ protected:
     /// Execute the monitoring thread
     void smThreadExec();
 
+    /// Check if the stream file has been deleted or replaced
+    /**
+      * \returns true if the stream has gone or has a new inode
+      * \returns false otherwise
+      */
+    bool streamReplaced();
+
     ///@}
 
     /** \name INDI
@@ -297,6 +347,24 @@ const size_t & shmimMonitor<derivedT, specificT>::typeSize() const
     return m_typeSize;
 }
 
+template <class derivedT, class specificT>
+uint64_t shmimMonitor<derivedT, specificT>::lastCnt0() const
+{
+    return m_smImageCnt0;
+}
+
+template <class derivedT, class specificT>
+void shmimMonitor<derivedT, specificT>::passive(bool p)
+{
+    m_passive = p;
+}
+
+template <class derivedT, class specificT>
+bool shmimMonitor<derivedT, specificT>::passive() const
+{
+    return m_passive;
+}
+
 template <class derivedT, class specificT>
 int shmimMonitor<derivedT, specificT>::setupConfig(mx::app::appConfigurator &config)
 {
@@ -580,6 +648,8 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
 
         if (m_getExistingFirst && !m_restart && derived().shutdown() == 0) // If true, we always get the existing image without waiting on the semaphore.
         {
+            m_smImageCnt0 = __atomic_load_n(&m_imageStream.md[0].cnt0, __ATOMIC_ACQUIRE);
+
             if (m_imageStream.md[0].size[2] > 0) ///\todo change to naxis?
             {
                 curr_image = m_imageStream.md[0].cnt1;
@@ -615,15 +685,40 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
 
             char *curr_src = (char *)m_imageStream.array.raw + curr_image * m_width * m_height * m_typeSize;
 
-            if (derived().processImage(curr_src, specificT()) < 0)
+            if (m_passive)
+            {
+                // Have waitImage read the existing image first
+                m_smLastCnt0 = m_imageStream.md[0].cnt0 - 1;
+                sem_post(sem);
+            }
+            else if (derived().processImage(curr_src, specificT()) < 0)
             {
                 derivedT::template log<software_error>({__FILE__, __LINE__});
             }
         }
+        else
+        {
+            m_smLastCnt0 = m_imageStream.md[0].cnt0;
+        }
+
+        m_smReady = true;
 
         // This is the main image grabbing loop.
         while (derived().shutdown() == 0 && !m_restart && derived().state() == stateCodes::OPERATING)
         {
+            if (m_passive)
+            {
+                // waitImage reads the images, we just watch for the stream going away.
+                sleep(1);
+
+                if (m_imageStream.md[0].sem <= 0)
+                    break; // Indicates that the server has cleaned up.
+
+                if (streamReplaced())
+                    m_restart = true;
+
+                continue;
+            }
 
             timespec ts;
 
@@ -637,6 +732,8 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
 
             if (sem_timedwait(sem, &ts) == 0)
             {
+                m_smImageCnt0 = __atomic_load_n(&m_imageStream.md[0].cnt0, __ATOMIC_ACQUIRE);
+
                 if (m_imageStream.md[0].size[2] > 0) ///\todo change to naxis?
                 {
                     curr_image = m_imageStream.md[0].cnt1;
@@ -695,29 +792,8 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
                     break;
                 }
 
-                // Check if the file has disappeared.
-                int SM_fd;
-                char SM_fname[200];
-                ImageStreamIO_filename(SM_fname, sizeof(SM_fname), m_shmimName.c_str());
-                SM_fd = open(SM_fname, O_RDWR);
-                if (SM_fd == -1)
-                {
-                    m_restart = true;
-                }
-                close(SM_fd);
-
-                // Check if the inode changed
-                struct stat buffer;
-                int rv = stat(SM_fname, &buffer);
-                if (rv != 0)
-                {
+                if (streamReplaced())
                     m_restart = true;
-                }
-
-                if (buffer.st_ino != m_inode)
-                {
-                    m_restart = true;
-                }
             }
         }
 
@@ -725,6 +801,10 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
         // call derived().cleanup()
         //*******
 
+        // Stop waitImage from reading the stream, and wait for it to finish.
+        m_smReady = false;
+        std::lock_guard<std::mutex> readLock(m_smReadMutex);
+
         // opened == true if we can get to this
         if (m_semaphoreNumber >= 0)
             m_imageStream.semReadPID[m_semaphoreNumber] = 0; // release semaphore
@@ -741,11 +821,132 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
 
     if (opened)
     {
+        m_smReady = false;
+        std::lock_guard<std::mutex> readLock(m_smReadMutex);
+
         ImageStreamIO_closeIm(&m_imageStream);
         opened = false;
     }
 }
 
+template <class derivedT, class specificT>
+bool shmimMonitor<derivedT, specificT>::streamReplaced()
+{
+    // Check if the file has disappeared.
+    char SM_fname[200];
+    ImageStreamIO_filename(SM_fname, sizeof(SM_fname), m_shmimName.c_str());
+    int SM_fd = open(SM_fname, O_RDWR);
+    if (SM_fd == -1)
+    {
+        return true;
+    }
+    close(SM_fd);
+
+    // Check if the inode changed
+    struct stat buffer;
+    if (stat(SM_fname, &buffer) != 0)
+    {
+        return true;
+    }
+
+    return (buffer.st_ino != m_inode);
+}
+
+template <class derivedT, class specificT>
+int shmimMonitor<derivedT, specificT>::waitImage(bool busyPoll)
+{
+    if (!m_smReady)
+    {
+        mx::sys::milliSleep(10); // Not connected yet, don't spin the caller.
+        return 1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_smReadMutex);
+
+    if (!m_smReady)
+        return 1; // The stream was closed while we waited for the lock.
+
+    uint64_t cnt0;
+
+    if (busyPoll)
+    {
+        timespec ts0, ts1;
+        clock_gettime(CLOCK_MONOTONIC, &ts0);
+
+        uint64_t n = 0;
+        while ((cnt0 = __atomic_load_n(&m_imageStream.md[0].cnt0, __ATOMIC_ACQUIRE)) == m_smLastCnt0)
+        {
+            if (!m_smReady.load(std::memory_order_relaxed) || derived().shutdown())
+                return 1;
+
+            // Check the time now and then, so the caller still sees timeouts.
+            if ((++n & 0xFFFF) == 0)
+            {
+                clock_gettime(CLOCK_MONOTONIC, &ts1);
+                if (ts1.tv_sec - ts0.tv_sec > 1 || (ts1.tv_sec - ts0.tv_sec == 1 && ts1.tv_nsec >= ts0.tv_nsec))
+                    return 1;
+            }
+
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+    }
+    else
+    {
+        timespec ts;
+        XWC_SEM_WAIT_TS_DERIVED(ts, 1, 0);
+
+        if (sem_timedwait(m_imageStream.semptr[m_semaphoreNumber], &ts) != 0)
+        {
+            // EINTR probably indicates time to shutdown, ETIMEDOUT just means keep waiting
+            if (errno == EINTR || errno == ETIMEDOUT)
+                return 1;
+
+            derivedT::template log<software_error>({__FILE__, __LINE__, errno, "sem_timedwait"});
+            return -1;
+        }
+
+        cnt0 = __atomic_load_n(&m_imageStream.md[0].cnt0, __ATOMIC_ACQUIRE);
+
+        if (cnt0 == m_smLastCnt0)
+            return 1; // A post for an image we have already read, e.g. when several were written since the last wait.
+    }
+
+    m_smLastCnt0 = cnt0;
+    m_smImageCnt0 = cnt0;
+
+    uint64_t curr_image;
+    if (m_imageStream.md[0].size[2] > 0) ///\todo change to naxis?
+    {
+        curr_image = m_imageStream.md[0].cnt1;
+    }
+    else
+    {
+        curr_image = 0;
+    }
+
+    uint32_t snx = m_imageStream.md[0].size[0];
+    uint32_t sny = (m_imageStream.md[0].naxis > 1) ? m_imageStream.md[0].size[1] : 1;
+    uint32_t snz = (m_imageStream.md[0].naxis > 2) ? m_imageStream.md[0].size[2] : 1;
+
+    if (m_imageStream.md[0].datatype != m_dataType || snx != m_width || sny != m_height || snz != m_depth)
+    {
+        m_restart = true; // the monitor thread will get the new image setup.
+        return 1;
+    }
+
+    char *curr_src = (char *)m_imageStream.array.raw + curr_image * m_width * m_height * m_typeSize;
+
+    if (derived().processImage(curr_src, specificT()) < 0)
+    {
+        derivedT::template log<software_error>({__FILE__, __LINE__});
+        return -1;
+    }
+
+    return 0;
+}
+
 template <class derivedT, class specificT>
 int shmimMonitor<derivedT, specificT>::updateINDI()
 {
@@ -0,0 +1,306 @@
+/** \file streamProcessor.hpp
+  * \brief The MagAO-X stream processor, joining a shmimMonitor input to a frameGrabber output.
+  *
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * History:
+  * - 2026-10-17 created
+  *
+  * \ingroup app_files
+  */
+
+#ifndef streamProcessor_hpp
+#define streamProcessor_hpp
+
+#include <atomic>
+
+#include <semaphore.h>
+
+#include "semUtilsDerived.hpp"
+#include "shmimMonitor.hpp"
+#include "frameGrabber.hpp"
+
+namespace MagAOX
+{
+namespace app
+{
+namespace dev
+{
+
+/** MagAO-X stream processor
+  *
+  * Joins a shmimMonitor, which reads an input stream, to a frameGrabber, which computes and publishes an output
+  * stream.  It implements the frameGrabber `acquireAndCheckValid` interface, and has two modes:
+  *
+  * - By default the shmimMonitor thread waits on the input and calls `processImage`, which calls `postImage` to hand
+  *   the frame to the framegrabber thread.  The framegrabber thread wakes, calls `loadImageIntoStream`, and publishes.
+  *
+  * - If `streamProcessor.fused` is true the shmimMonitor is passive, and the framegrabber thread waits on the input
+  *   itself, then calls `processImage` and `loadImageIntoStream` and publishes.  This removes a thread wake-up and a
+  *   transfer of the frame between cores for every frame.  The thread is pinned and prioritized with
+  *   `framegrabber.cpuset` and `framegrabber.threadPrio`.  With `streamProcessor.busyPoll` also true the thread spins on
+  *   the input's `md->cnt0` rather than sleeping on its semaphore, for the lowest latency at the cost of a whole core.
+  *
+  * Either way the derived class implements `processImage` and `loadImageIntoStream` the same way, so the mode is
+  * chosen by configuration alone.  Work on the input data can be done in either, but in the default mode the input
+  * may be overwritten by the time `loadImageIntoStream` is called.
+  *
+  * The derived class `derivedT` has the following requirements:
+  *
+  * - Must be derived from MagAOXApp<true>, shmimMonitor<derivedT, specificT>, and frameGrabber<derivedT>
+  *
+  * - Must contain the following friend declaration:
+  *   \code
+  *       friend class dev::streamProcessor<derivedT, specificT>; //specificT may not need to be included
+  *   \endcode
+  *
+  * - Must not implement `acquireAndCheckValid`.  If there is a name conflict it should be
+  *   \code
+  *       int acquireAndCheckValid()
+  *       {
+  *          return streamProcessorT::acquireAndCheckValid();
+  *       }
+  *   \endcode
+  *
+  * - Must call `postImage()` from `processImage(void *, const specificT &)` when there is a frame to publish.
+  *
+  * - Calls to this class's `setupConfig`, `loadConfig`, and `appStartup` functions must be placed in the derived
+  *   class's functions of the same name.  `loadConfig` must be called after the shmimMonitor's `loadConfig`,
+  *   and `appStartup` before the shmimMonitor's and frameGrabber's `appStartup`.  For convenience the following macros
+  *   are defined to provide error checking:
+  *   \code
+  *       STREAMPROCESSOR_SETUP_CONFIG( cfig )
+  *       STREAMPROCESSOR_LOAD_CONFIG( cfig )
+  *       STREAMPROCESSOR_APP_STARTUP
+  *   \endcode
+  *
+  * \ingroup appdev
+  */
+template<class derivedT, class specificT = shmimT>
+class streamProcessor
+{
+public:
+   typedef shmimMonitor<derivedT, specificT> monitorT;
+
+protected:
+
+   /** \name Configurable Parameters
+    * @{
+    */
+   bool m_spFused {false}; ///< If true the framegrabber thread waits on the input itself.  Default is false.
+
+   bool m_spBusyPoll {false}; ///< If true, and fused, the framegrabber thread spins on the input cnt0.  Default is false.
+
+   ///@}
+
+   sem_t m_spSemaphore; ///< Semaphore used to hand frames from the shmimMonitor thread to the framegrabber thread, if not fused.
+
+   std::atomic<bool> m_spPosted {false}; ///< Set by postImage when processImage has a frame to publish.
+
+public:
+
+   /// Setup the configuration system
+   /**
+     * This should be called in `derivedT::setupConfig` as
+     * \code
+       streamProcessor<derivedT, specificT>::setupConfig(config);
+       \endcode
+     * with appropriate error checking.
+     */
+   int setupConfig(mx::app::appConfigurator & config /**< [out] the derived classes configurator*/);
+
+   /// load the configuration system results
+   /**
+     * This should be called in `derivedT::loadConfig`, after the shmimMonitor's, as
+     * \code
+       streamProcessor<derivedT, specificT>::loadConfig(config);
+       \endcode
+     * with appropriate error checking.
+     */
+   int loadConfig(mx::app::appConfigurator & config /**< [in] the derived classes configurator*/);
+
+   /// Startup function
+   /** Initializes the hand-off semaphore, and makes the shmimMonitor passive if fused.
+     * This should be called in `derivedT::appStartup`, before the shmimMonitor's and frameGrabber's, as
+     * \code
+       streamProcessor<derivedT, specificT>::appStartup();
+       \endcode
+     * with appropriate error checking.
+     *
+     * \returns 0 on success
+     * \returns -1 on error, which is logged.
+     */
+   int appStartup();
+
+   /// Get whether the processing is fused on the framegrabber thread
+   bool fused() const;
+
+   /// Get whether the fused thread busy-polls the input
+   bool busyPoll() const;
+
+   /// Tell the framegrabber that there is a frame to publish
+   /** Call this from `derivedT::processImage`.
+     *
+     * \returns 0 on success
+     * \returns -1 on error, which is logged.
+     */
+   int postImage();
+
+   /// Implementation of the framegrabber acquireAndCheckValid interface
+   /** Waits for a frame from `processImage`, processing it on this thread if fused, and sets the image timestamp.
+     *
+     * \returns 0 if a frame is ready to publish
+     * \returns 1 if there is no frame, e.g. after a timeout
+     * \returns -1 on an error, which is logged.
+     */
+   int acquireAndCheckValid();
+
+private:
+   derivedT & derived()
+   {
+      return *static_cast<derivedT *>(this);
+   }
+};
+
+template<class derivedT, class specificT>
+int streamProcessor<derivedT, specificT>::setupConfig(mx::app::appConfigurator & config)
+{
+   config.add("streamProcessor.fused", "", "streamProcessor.fused", argType::Required, "streamProcessor", "fused", false, "bool", "If true, wait for, process, and publish each frame on the framegrabber thread.  Default is false, in which the shmimMonitor thread waits and hands each frame to the framegrabber thread.");
+
+   config.add("streamProcessor.busyPoll", "", "streamProcessor.busyPoll", argType::Required, "streamProcessor", "busyPoll", false, "bool", "If true, and fused, spin on the input cnt0 instead of waiting on its semaphore.  Uses a whole core.  Default is false.");
+
+   return 0;
+}
+
+template<class derivedT, class specificT>
+int streamProcessor<derivedT, specificT>::loadConfig(mx::app::appConfigurator & config)
+{
+   config(m_spFused, "streamProcessor.fused");
+   config(m_spBusyPoll, "streamProcessor.busyPoll");
+
+   if(m_spBusyPoll && !m_spFused)
+   {
+      derivedT::template log<text_log>("streamProcessor.busyPoll is ignored unless streamProcessor.fused is true", logPrio::LOG_WARNING);
+      m_spBusyPoll = false;
+   }
+
+   return 0;
+}
+
+template<class derivedT, class specificT>
+int streamProcessor<derivedT, specificT>::appStartup()
+{
+   if(sem_init(&m_spSemaphore, 0,0) < 0)
+   {
+      derivedT::template log<software_critical>({__FILE__, __LINE__, errno,0, "Initializing S.P. semaphore"});
+      return -1;
+   }
+
+   static_cast<monitorT &>(derived()).passive(m_spFused);
+
+   if(m_spFused)
+   {
+      std::string msg = "processing fused on the framegrabber thread";
+      if(m_spBusyPoll) msg += ", busy-polling";
+      derivedT::template log<text_log>(msg);
+
+      if(derived().m_fgCpuset == "")
+      {
+         derivedT::template log<text_log>("fused processing without framegrabber.cpuset, the thread is not pinned", logPrio::LOG_NOTICE);
+      }
+   }
+
+   return 0;
+}
+
+template<class derivedT, class specificT>
+bool streamProcessor<derivedT, specificT>::fused() const
+{
+   return m_spFused;
+}
+
+template<class derivedT, class specificT>
+bool streamProcessor<derivedT, specificT>::busyPoll() const
+{
+   return m_spBusyPoll;
+}
+
+template<class derivedT, class specificT>
+int streamProcessor<derivedT, specificT>::postImage()
+{
+   m_spPosted = true;
+
+   //If fused we are already on the framegrabber thread
+   if(m_spFused) return 0;
+
+   //Now tell the f.g. to get going
+   if(sem_post(&m_spSemaphore) < 0)
+   {
+      derivedT::template log<software_critical>({__FILE__, __LINE__, errno, 0, "Error posting to semaphore"});
+      return -1;
+   }
+
+   return 0;
+}
+
+template<class derivedT, class specificT>
+int streamProcessor<derivedT, specificT>::acquireAndCheckValid()
+{
+   if(m_spFused)
+   {
+      int rv = static_cast<monitorT &>(derived()).waitImage(m_spBusyPoll);
+      if(rv != 0) return rv;
+   }
+   else
+   {
+      timespec ts;
+      XWC_SEM_WAIT_TS_DERIVED(ts, 1, 0);
+
+      if(sem_timedwait(&m_spSemaphore, &ts) != 0)
+      {
+         return 1;
+      }
+   }
+
+   //processImage may decide there is nothing to publish
+   if(!m_spPosted.exchange(false)) return 1;
+
+   clock_gettime(CLOCK_REALTIME, &derived().m_currImageTimestamp);
+
+   return 0;
+}
+
+/// Call streamProcessorT::setupConfig with error checking for streamProcessor
+/**
+  * \param cfig the application configurator
+  */
+#define STREAMPROCESSOR_SETUP_CONFIG( cfig )                                                   \
+    if(streamProcessorT::setupConfig(cfig) < 0)                                                \
+    {                                                                                          \
+        log<software_error>({__FILE__, __LINE__, "Error from streamProcessorT::setupConfig"}); \
+        m_shutdown = true;                                                                     \
+        return;                                                                                \
+    }
+
+/// Call streamProcessorT::loadConfig with error checking for streamProcessor
+/** This must be inside a function that returns int, e.g. the standard loadConfigImpl.
+  * \param cfig the application configurator
+  */
+#define STREAMPROCESSOR_LOAD_CONFIG( cfig )                                                             \
+    if(streamProcessorT::loadConfig(cfig) < 0)                                                          \
+    {                                                                                                   \
+        return log<software_error,-1>({__FILE__, __LINE__, "Error from streamProcessorT::loadConfig"}); \
+    }
+
+/// Call streamProcessorT::appStartup with error checking for streamProcessor
+#define STREAMPROCESSOR_APP_STARTUP                                                                     \
+    if(streamProcessorT::appStartup() < 0)                                                              \
+    {                                                                                                   \
+        return log<software_error,-1>({__FILE__, __LINE__, "Error from streamProcessorT::appStartup"}); \
+    }
+
+} //namespace dev
+} //namespace app
+} //namespace MagAOX
+
+#endif //streamProcessor_hpp
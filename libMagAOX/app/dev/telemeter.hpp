@@ -74,6 +74,13 @@ struct telemeter
 
     double m_maxInterval{10.0}; ///< The maximum interval, in seconds, between telemetry records. Default is 10.0 seconds.
 
+    pcf::IndiProperty m_indiP_telQueue; ///< Property used to report the status of the telemetry queue.
+
+    uint64_t m_lastLogBytes{0};    ///< Log file bytes written at the last telem_logwrite record.
+    uint64_t m_lastLogSyscalls{0}; ///< Log file system calls at the last telem_logwrite record.
+    uint64_t m_lastTelBytes{0};    ///< Telemetry file bytes written at the last telem_logwrite record.
+    uint64_t m_lastTelSyscalls{0}; ///< Telemetry file system calls at the last telem_logwrite record.
+
     telemeter();
 
     /// Make a telemetry recording
@@ -121,7 +128,7 @@ struct telemeter
     int appStartup();
 
     /// Perform `telemeter` application logic
-    /** This calls `derivedT::checkRecordTimes()`, and should be called from `derivedT::appLogic`, but only
+    /** This calls `derivedT::checkRecordTimes()`, records telem_logwrite, and updates the telemetry queue status, and should be called from `derivedT::appLogic`, but only
      * when the FSM is in states where telemetry logging makes sense.
      *
      * \returns 0 on success
@@ -161,6 +168,15 @@ struct telemeter
                          telTs... tels    ///< [in] [unused] objects of the additional telemetry types to record
     );
 
+    /// Record the write rates of the log and telemetry files
+    /** Rates are averaged since the last record.  This is called from appLogic() at m_maxInterval, and so
+      * derivedT does not need to include telem_logwrite in checkRecordTimes.
+      *
+      * \returns 0 on succcess
+      * \returns -1 on error
+      */
+    int recordLogWrite();
+
     /// Empty function called at the end of the template list
     /**
      * \returns 0 on succcess
@@ -261,15 +277,83 @@ int telemeter<derivedT>::appStartup()
         return -1;
     }
 
+    derived().createROIndiNumber(m_indiP_telQueue, "telemeter_queue", "Telemetry Queue", "Telemetry");
+    m_indiP_telQueue.add(pcf::IndiElement("depth"));
+    m_indiP_telQueue["depth"] = 0;
+    m_indiP_telQueue.add(pcf::IndiElement("max_depth"));
+    m_indiP_telQueue["max_depth"] = 0;
+    m_indiP_telQueue.add(pcf::IndiElement("capacity"));
+    m_indiP_telQueue["capacity"] = m_tel.queueCapacity();
+    m_indiP_telQueue.add(pcf::IndiElement("dropped"));
+    m_indiP_telQueue["dropped"] = 0;
+    m_indiP_telQueue.add(pcf::IndiElement("blocked"));
+    m_indiP_telQueue["blocked"] = 0;
+
+    if (derived().registerIndiPropertyReadOnly(m_indiP_telQueue) < 0)
+    {
+        derivedT::template log<software_error>({__FILE__, __LINE__});
+        return -1;
+    }
+
     return 0;
 }
 
 template <class derivedT>
 int telemeter<derivedT>::appLogic()
 {
+    pcf::IndiProperty::PropertyStateType stst = INDI_IDLE;
+    if (m_tel.queueDropped() > 0)
+        stst = INDI_ALERT;
+    else if (m_tel.queueBlocked() > 0)
+        stst = INDI_BUSY;
+
+    derived().template updateIfChanged<uint64_t>(m_indiP_telQueue, {"depth", "max_depth", "capacity", "dropped", "blocked"},
+                                                 {m_tel.queueDepth(), m_tel.queueMaxDepth(), m_tel.queueCapacity(), m_tel.queueDropped(), m_tel.queueBlocked()},
+                                                 stst);
+
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    if (((double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9) - ((double)telem_logwrite::lastRecord.tv_sec + ((double)telem_logwrite::lastRecord.tv_nsec) / 1e9) > m_maxInterval - ((double)derived().m_loopPause) / 1e9)
+    {
+        recordLogWrite();
+    }
+
     return derived().checkRecordTimes();
 }
 
+template <class derivedT>
+int telemeter<derivedT>::recordLogWrite()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    uint64_t logBytes = derivedT::m_log.bytesWritten();
+    uint64_t logSyscalls = derivedT::m_log.syscalls();
+    uint64_t telBytes = m_tel.bytesWritten();
+    uint64_t telSyscalls = m_tel.syscalls();
+
+    double dt = ((double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9) - ((double)telem_logwrite::lastRecord.tv_sec + ((double)telem_logwrite::lastRecord.tv_nsec) / 1e9);
+
+    //The first record has no interval to average over, and only sets the reference point.
+    if (telem_logwrite::lastRecord.tv_sec != 0 && dt > 0)
+    {
+        telem<telem_logwrite>({(logBytes - m_lastLogBytes) / dt, (logSyscalls - m_lastLogSyscalls) / dt,
+                               (telBytes - m_lastTelBytes) / dt, (telSyscalls - m_lastTelSyscalls) / dt});
+    }
+    else
+    {
+        telem_logwrite::lastRecord = ts;
+    }
+
+    m_lastLogBytes = logBytes;
+    m_lastLogSyscalls = logSyscalls;
+    m_lastTelBytes = telBytes;
+    m_lastTelSyscalls = telSyscalls;
+
+    return 0;
+}
+
 template <class derivedT>
 int telemeter<derivedT>::appShutdown()
 {
@@ -0,0 +1,244 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../../tests/catch2/catch.hpp"
+
+#include <random>
+#include <vector>
+
+#include "../dmPokeSequencer.hpp"
+
+using namespace MagAOX::app::dev;
+
+namespace dmPokeSequencer_tests
+{
+
+/// A simulated DM and WFS camera.
+/** A DM command lands during the frame after the latest one, so that frame is a mix of the old and new
+  * commands and later frames see only the new command.  Each frame is the weighted sum of the actuator
+  * responses plus a static offset.
+  */
+struct simWFS
+{
+    Eigen::MatrixXf m_resp; ///< The response of each actuator, one column per actuator
+    Eigen::VectorXf m_offset; ///< The static WFS image
+
+    Eigen::VectorXf m_cmd; ///< The current DM command
+    Eigen::VectorXf m_prevCmd; ///< The command before the last change
+    uint64_t m_cmdCnt0 {0}; ///< The frame during which the current command landed
+
+    uint64_t m_cnt0 {100}; ///< The frame counter of the latest frame
+
+    simWFS( int npix,
+            int nact
+          ) : m_resp(Eigen::MatrixXf::Random(npix, nact)), m_offset(Eigen::VectorXf::Random(npix)),
+              m_cmd(Eigen::VectorXf::Zero(nact)), m_prevCmd(Eigen::VectorXf::Zero(nact))
+    {
+    }
+
+    void apply( const Eigen::VectorXf & cmd )
+    {
+        m_prevCmd = m_cmd;
+        m_cmd = cmd;
+        m_cmdCnt0 = m_cnt0 + 1;
+    }
+
+    /// Take the next frame, skipping \p drop frames
+    Eigen::VectorXf frame( uint64_t drop = 0 )
+    {
+        m_cnt0 += 1 + drop;
+
+        if(m_cnt0 <= m_cmdCnt0)
+        {
+            return m_offset + m_resp * (0.5*m_prevCmd + 0.5*m_cmd);
+        }
+
+        return m_offset + m_resp * m_cmd;
+    }
+};
+
+/// Run a sequence, dropping and repeating some frames, and return the accumulated images
+/** If \p advance is true the camera takes another frame while the frame taken as each command lands is being
+  * processed.  Each frame is labelled with the cnt0 read along with it, as shmimMonitor::lastCnt0 does, unless
+  * \p liveCnt0 is true in which case the counter is re-read after processing.
+  */
+Eigen::MatrixXf runSequence( simWFS & wfs,
+                             dmPokeSequencer & seq,
+                             const Eigen::MatrixXf & weights,
+                             unsigned nSettle,
+                             unsigned nImages,
+                             unsigned nAverage,
+                             bool dropAndRepeat,
+                             uint64_t & nFramesTaken,
+                             bool advance = false,
+                             bool liveCnt0 = false
+                           )
+{
+    Eigen::MatrixXf accum = Eigen::MatrixXf::Zero(wfs.m_offset.size(), weights.rows());
+
+    seq.setup(weights.rows(), nSettle, nImages, nAverage);
+
+    uint64_t cnt00 = wfs.m_cnt0;
+    seq.start(wfs.m_cnt0);
+    wfs.apply(seq.sign()*weights.row(seq.pattern()).transpose());
+
+    uint64_t n = 0;
+    while(!seq.done())
+    {
+        uint64_t drop = (dropAndRepeat && n % 7 == 3) ? 1 : 0;
+        Eigen::VectorXf im = wfs.frame(drop);
+        uint64_t cnt0 = wfs.m_cnt0;
+
+        if(advance && wfs.m_cnt0 == wfs.m_cmdCnt0)
+        {
+            wfs.frame(); //written while im is processed, and so never seen
+            if(liveCnt0) cnt0 = wfs.m_cnt0;
+        }
+
+        int nseen = (dropAndRepeat && n % 5 == 2) ? 2 : 1; //the same frame is seen twice
+        for(int k = 0; k < nseen; ++k)
+        {
+            if(seq.frame(cnt0))
+            {
+                accum.col(seq.pattern()) += seq.sign() * im;
+            }
+
+            if(seq.next())
+            {
+                wfs.apply(seq.sign()*weights.row(seq.pattern()).transpose());
+            }
+        }
+
+        ++n;
+    }
+
+    nFramesTaken = wfs.m_cnt0 - cnt00;
+
+    return accum;
+}
+
+} //namespace dmPokeSequencer_tests
+
+using namespace dmPokeSequencer_tests;
+
+SCENARIO( "Hadamard poke patterns", "[dmPokeSequencer]" )
+{
+    GIVEN("a number of actuators")
+    {
+        WHEN("making the Hadamard matrix")
+        {
+            std::vector<size_t> ns = {0, 1, 3, 8, 13};
+            std::vector<long> Ns = {1, 1, 4, 8, 16};
+
+            for(size_t k = 0; k < ns.size(); ++k)
+            {
+                Eigen::MatrixXf H;
+                hadamardMatrix(H, ns[k]);
+
+                REQUIRE( H.rows() == Ns[k] );
+                REQUIRE( H.cols() == Ns[k] );
+                REQUIRE( (H.array().abs() == 1).all() );
+                REQUIRE( (H.row(0).array() == 1).all() );
+                REQUIRE( (H.col(0).array() == 1).all() );
+                REQUIRE( (H.transpose()*H - Ns[k]*Eigen::MatrixXf::Identity(Ns[k], Ns[k])).norm() == 0 );
+            }
+        }
+    }
+}
+
+SCENARIO( "Sequencing pokes against WFS frames", "[dmPokeSequencer]" )
+{
+    GIVEN("a single pattern of all actuators")
+    {
+        simWFS wfs(50, 4);
+        Eigen::MatrixXf weights = Eigen::MatrixXf::Ones(1, 4);
+        dmPokeSequencer seq;
+
+        REQUIRE( seq.done() );
+
+        WHEN("every frame is seen once")
+        {
+            uint64_t nTaken;
+            Eigen::MatrixXf accum = runSequence(wfs, seq, weights, 1, 5, 3, false, nTaken);
+
+            //The only frames not used are the settling frames
+            REQUIRE( nTaken == 2*3*(1 + 5) );
+            REQUIRE( seq.nFrames() == 15 );
+
+            //No frame with the DM moving was used, and the static image cancels
+            Eigen::VectorXf poke = accum.col(0) / (2.0*seq.nFrames());
+            REQUIRE( (poke - wfs.m_resp.rowwise().sum()).cwiseAbs().maxCoeff() < 1e-5 );
+
+            //The DM command is left on the last phase, the caller zeroes it
+            REQUIRE( (wfs.m_cmd.array() == -1).all() );
+        }
+
+        WHEN("the DM needs more frames to settle")
+        {
+            uint64_t nTaken;
+            runSequence(wfs, seq, weights, 3, 2, 2, false, nTaken);
+            REQUIRE( nTaken == 2*2*(3 + 2) );
+        }
+
+        WHEN("frames are dropped and repeated")
+        {
+            uint64_t nTaken;
+            Eigen::MatrixXf accum = runSequence(wfs, seq, weights, 1, 5, 3, true, nTaken);
+
+            Eigen::VectorXf poke = accum.col(0) / (2.0*seq.nFrames());
+            REQUIRE( (poke - wfs.m_resp.rowwise().sum()).cwiseAbs().maxCoeff() < 1e-5 );
+        }
+
+        WHEN("the camera takes a frame while one is being processed")
+        {
+            uint64_t nTaken;
+            Eigen::MatrixXf accum = runSequence(wfs, seq, weights, 1, 5, 3, false, nTaken, true);
+
+            //Each frame is labelled with its own cnt0, so the frames taken as the DM moves are still skipped
+            Eigen::VectorXf poke = accum.col(0) / (2.0*seq.nFrames());
+            REQUIRE( (poke - wfs.m_resp.rowwise().sum()).cwiseAbs().maxCoeff() < 1e-5 );
+
+            //Re-reading the counter after processing labels those frames as the next one, so they are used
+            simWFS wfs2 = wfs;
+            wfs2.m_cmd.setZero();
+            wfs2.m_prevCmd.setZero();
+            accum = runSequence(wfs2, seq, weights, 1, 5, 3, false, nTaken, true, true);
+
+            poke = accum.col(0) / (2.0*seq.nFrames());
+            REQUIRE( (poke - wfs2.m_resp.rowwise().sum()).cwiseAbs().maxCoeff() > 1e-2 );
+        }
+
+        WHEN("no frames are skipped after a command")
+        {
+            uint64_t nTaken;
+            Eigen::MatrixXf accum = runSequence(wfs, seq, weights, 0, 5, 3, false, nTaken);
+
+            //The frames with the DM moving are used, so the measurement is biased
+            Eigen::VectorXf poke = accum.col(0) / (2.0*seq.nFrames());
+            REQUIRE( (poke - wfs.m_resp.rowwise().sum()).cwiseAbs().maxCoeff() > 1e-2 );
+        }
+    }
+
+    GIVEN("Hadamard patterns")
+    {
+        int nact = 11;
+        simWFS wfs(40, nact);
+
+        Eigen::MatrixXf H;
+        hadamardMatrix(H, nact);
+        Eigen::MatrixXf weights = H.leftCols(nact);
+
+        dmPokeSequencer seq;
+
+        WHEN("measuring the response of each actuator")
+        {
+            uint64_t nTaken;
+            Eigen::MatrixXf accum = runSequence(wfs, seq, weights, 1, 3, 2, true, nTaken);
+
+            REQUIRE( weights.rows() == 16 );
+
+            //Demodulate as dmPokeWFS::basicRunSensor does
+            Eigen::MatrixXf imat = accum * weights / (2.0*seq.nFrames()*weights.rows());
+
+            REQUIRE( (imat - wfs.m_resp).cwiseAbs().maxCoeff() < 1e-5 );
+        }
+    }
+}
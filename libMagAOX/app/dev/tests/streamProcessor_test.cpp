@@ -0,0 +1,298 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../../tests/catch2/catch.hpp"
+
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <mx/sys/timeUtils.hpp>
+
+#include "../../MagAOXApp.hpp"
+#include "../streamProcessor.hpp"
+
+using namespace MagAOX::app;
+
+namespace streamProcessor_tests
+{
+
+/// An input stream, written the way frameGrabber does
+struct testStream
+{
+    IMAGE m_image;
+
+    testStream( const std::string &name,
+                uint32_t width,
+                uint32_t height,
+                uint32_t depth
+              )
+    {
+        uint32_t imsize[3] = {width, height, depth};
+        ImageStreamIO_createIm_gpu(&m_image, name.c_str(), 3, imsize, _DATATYPE_FLOAT, -1, 1, IMAGE_NB_SEMAPHORE, 0, CIRCULAR_BUFFER | ZAXIS_TEMPORAL, 0);
+        m_image.md->cnt1 = depth - 1;
+    }
+
+    ~testStream()
+    {
+        ImageStreamIO_destroyIm(&m_image);
+    }
+
+    /// Write a frame with every pixel set to \p val, and post
+    void write( float val )
+    {
+        uint64_t next_cnt1 = m_image.md->cnt1 + 1;
+        if(next_cnt1 >= m_image.md->size[2]) next_cnt1 = 0;
+
+        m_image.md->write = 1;
+
+        size_t npix = m_image.md->size[0] * m_image.md->size[1];
+        for(size_t n = 0; n < npix; ++n) m_image.array.F[next_cnt1 * npix + n] = val;
+
+        m_image.md->cnt1 = next_cnt1;
+        __atomic_add_fetch(&m_image.md->cnt0, 1, __ATOMIC_RELEASE);
+
+        m_image.md->write = 0;
+        ImageStreamIO_sempost(&m_image, -1);
+    }
+};
+
+/// A stream processor which records each frame it processes
+/** Stands in for the frameGrabber too, running its acquireAndCheckValid loop on the test thread.
+  */
+struct streamProcessorTest : public MagAOXApp<true>, public dev::shmimMonitor<streamProcessorTest>, public dev::streamProcessor<streamProcessorTest>
+{
+    typedef dev::shmimMonitor<streamProcessorTest> shmimMonitorT;
+    typedef dev::streamProcessor<streamProcessorTest> streamProcessorT;
+
+    friend class dev::shmimMonitor<streamProcessorTest>;
+    friend class dev::streamProcessor<streamProcessorTest>;
+
+    std::string m_fgCpuset; ///< As in frameGrabber, read by streamProcessor
+    timespec m_currImageTimestamp {0,0}; ///< As in frameGrabber, set by streamProcessor
+
+    int m_nProcessed {0}; ///< The number of calls to processImage
+    float m_procVal {0}; ///< The first pixel of the last image processed
+    uint64_t m_procCnt0 {0}; ///< The cnt0 of the last image processed
+    std::thread::id m_procThread; ///< The thread which called processImage last
+
+    explicit streamProcessorTest( const std::string &shmimName ) : MagAOXApp("sha1",false)
+    {
+        m_shmimName = shmimName;
+    }
+
+    ~streamProcessorTest()
+    {
+        m_shutdown = 1;
+        if(m_smThread.joinable()) m_smThread.join();
+        sem_destroy(&m_spSemaphore);
+    }
+
+    virtual int appStartup(){return 0;}
+    virtual int appLogic(){return 0;}
+    virtual int appShutdown(){return 0;}
+
+    stateCodes::stateCodeT state()
+    {
+        return stateCodes::OPERATING;
+    }
+
+    int allocate( const dev::shmimT & )
+    {
+        return 0;
+    }
+
+    int processImage( void *curr_src,
+                      const dev::shmimT &
+                    )
+    {
+        ++m_nProcessed;
+        m_procVal = *static_cast<float *>(curr_src);
+        m_procCnt0 = lastCnt0();
+        m_procThread = std::this_thread::get_id();
+
+        return postImage();
+    }
+
+    /// Start the shmimMonitor thread, and wait for it to connect to the stream
+    bool start( bool fused,
+                bool busyPoll
+              )
+    {
+        m_spFused = fused;
+        m_spBusyPoll = busyPoll;
+
+        if(streamProcessorT::appStartup() < 0) return false;
+
+        m_smThreadInit = false;
+        m_smThread = std::thread(smThreadStart, static_cast<shmimMonitorT *>(this));
+
+        for(int n = 0; n < 500; ++n)
+        {
+            if(m_smReady) return true;
+            mx::sys::milliSleep(10);
+        }
+
+        return false;
+    }
+
+    /// Write \p val to \p ts until a frame is acquired, as a frameGrabber would while the monitor reconnects
+    int acquireNext( testStream &ts,
+                     float val
+                   )
+    {
+        for(int n = 0; n < 10; ++n)
+        {
+            ts.write(val);
+            int rv = acquireAndCheckValid();
+            if(rv != 1) return rv;
+        }
+
+        return 1;
+    }
+
+    using shmimMonitorT::m_restart;
+    using shmimMonitorT::streamReplaced;
+};
+
+std::string testStreamName()
+{
+    return "streamProcessor_test_" + std::to_string(getpid());
+}
+
+SCENARIO( "processing frames on the shmimMonitor thread", "[streamProcessor]" )
+{
+    GIVEN("a stream processor which is not fused")
+    {
+        testStream ts(testStreamName(), 8, 4, 5);
+
+        streamProcessorTest sp(testStreamName());
+        REQUIRE( sp.start(false, false) );
+        REQUIRE( !sp.passive() );
+
+        WHEN("frames are written one at a time")
+        {
+            for(int n = 0; n < 12; ++n)
+            {
+                ts.write(n);
+                REQUIRE( sp.acquireAndCheckValid() == 0 );
+                REQUIRE( sp.m_nProcessed == n+1 );
+                REQUIRE( sp.m_procVal == n );
+                REQUIRE( sp.m_procCnt0 == ts.m_image.md->cnt0 );
+                REQUIRE( sp.m_procThread != std::this_thread::get_id() );
+                REQUIRE( sp.m_currImageTimestamp.tv_sec > 0 );
+            }
+
+            // no new frame
+            REQUIRE( sp.acquireAndCheckValid() == 1 );
+            REQUIRE( sp.m_nProcessed == 12 );
+        }
+    }
+}
+
+SCENARIO( "processing frames fused on the framegrabber thread", "[streamProcessor]" )
+{
+    GIVEN("a fused stream processor")
+    {
+        bool busyPoll = GENERATE(false, true);
+
+        testStream ts(testStreamName(), 8, 4, 5);
+
+        streamProcessorTest sp(testStreamName());
+        REQUIRE( sp.start(true, busyPoll) );
+        REQUIRE( sp.passive() );
+        REQUIRE( sp.busyPoll() == busyPoll );
+
+        WHEN("frames are written one at a time")
+        {
+            for(int n = 0; n < 12; ++n)
+            {
+                ts.write(n);
+                REQUIRE( sp.acquireAndCheckValid() == 0 );
+                REQUIRE( sp.m_nProcessed == n+1 );
+                REQUIRE( sp.m_procVal == n );
+                REQUIRE( sp.m_procCnt0 == ts.m_image.md->cnt0 );
+                REQUIRE( sp.m_procThread == std::this_thread::get_id() );
+            }
+
+            // no new frame
+            REQUIRE( sp.acquireAndCheckValid() == 1 );
+            REQUIRE( sp.m_nProcessed == 12 );
+        }
+
+        WHEN("a frame is written while waiting")
+        {
+            std::thread wt([&ts](){ mx::sys::milliSleep(50); ts.write(7); });
+
+            REQUIRE( sp.acquireAndCheckValid() == 0 );
+            wt.join();
+
+            REQUIRE( sp.m_procVal == 7 );
+            REQUIRE( sp.m_procCnt0 == ts.m_image.md->cnt0 );
+        }
+
+        WHEN("several frames are written between waits")
+        {
+            ts.write(1);
+            ts.write(2);
+            ts.write(3);
+
+            // cnt0 skips, and only the latest frame is processed
+            REQUIRE( sp.acquireAndCheckValid() == 0 );
+            REQUIRE( sp.m_nProcessed == 1 );
+            REQUIRE( sp.m_procVal == 3 );
+            REQUIRE( sp.m_procCnt0 == ts.m_image.md->cnt0 );
+
+            // the extra posts do not repeat it
+            REQUIRE( sp.acquireAndCheckValid() == 1 );
+            REQUIRE( sp.acquireAndCheckValid() == 1 );
+            REQUIRE( sp.m_nProcessed == 1 );
+
+            // nor hold up the next frame
+            ts.write(4);
+            REQUIRE( sp.acquireAndCheckValid() == 0 );
+            REQUIRE( sp.m_nProcessed == 2 );
+            REQUIRE( sp.m_procVal == 4 );
+            REQUIRE( sp.m_procCnt0 == ts.m_image.md->cnt0 );
+        }
+    }
+}
+
+SCENARIO( "the input stream is replaced or removed", "[streamProcessor]" )
+{
+    GIVEN("a fused stream processor")
+    {
+        bool busyPoll = GENERATE(false, true);
+
+        std::unique_ptr<testStream> ts(new testStream(testStreamName(), 8, 4, 5));
+
+        streamProcessorTest sp(testStreamName());
+        REQUIRE( sp.start(true, busyPoll) );
+
+        REQUIRE( sp.acquireNext(*ts, 1) == 0 );
+        REQUIRE( sp.m_procVal == 1 );
+        REQUIRE( !sp.streamReplaced() );
+
+        WHEN("the stream is replaced")
+        {
+            ts.reset();
+            ts.reset(new testStream(testStreamName(), 8, 4, 5));
+
+            REQUIRE( sp.streamReplaced() );
+
+            // the passive monitor thread reconnects, and frames from the new stream are processed
+            REQUIRE( sp.acquireNext(*ts, 2) == 0 );
+            REQUIRE( sp.m_procVal == 2 );
+            REQUIRE( sp.m_procCnt0 == ts->m_image.md->cnt0 );
+            REQUIRE( !sp.streamReplaced() );
+        }
+
+        WHEN("the stream is removed")
+        {
+            ts.reset();
+
+            REQUIRE( sp.streamReplaced() );
+        }
+    }
+}
+
+} // namespace streamProcessor_tests
@@ -0,0 +1,275 @@
+/** \file indiPublisher.hpp
+  * \brief MagAO-X INDI property publish policies
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * \ingroup app_files
+  */
+
+#ifndef app_indiPublisher_hpp
+#define app_indiPublisher_hpp
+
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../INDI/libcommon/IndiProperty.hpp"
+
+namespace MagAOX
+{
+namespace app
+{
+namespace indi
+{
+
+/// How often, and for how large a change, a property is published.
+/** The defaults publish every change immediately, which is what a property without a policy does.
+  */
+struct publishPolicy
+{
+   double maxRate {0};  ///< The most times per second the property is sent.  Changes in between are sent by the flusher, latest value only.  0 is no limit.
+   double minDelta {0}; ///< A number must change by more than this from the last change to be a change.
+   double deadband {0}; ///< A number must change by more than this fraction of the last change to be a change.
+};
+
+/// Counters for one property with a publish policy.
+struct publishStats
+{
+   uint64_t updates {0};    ///< The number of updates of the property by the app.
+   uint64_t sent {0};       ///< The number of times the property was sent.
+   uint64_t deferred {0};   ///< The number of changes held back by the rate limit.
+   uint64_t suppressed {0}; ///< The number of updates not sent, because the change was too small or was replaced by a later one.
+};
+
+/// Applies publish policies to INDI set property messages.
+/** Properties are looked up by name.  The policies are set at configuration time, before any
+  * other threads start, and are not changed after that, so a property with no policy costs one
+  * lookup and no lock.
+  *
+  * Changes inside the rate limit are held, and the latest of them is sent by flush(), which the
+  * app calls from a thread at an interval shorter than the shortest 1/maxRate.  A change of
+  * property state is always sent immediately, so alarms are never delayed.
+  *
+  * All sends of a property with a policy are made under one mutex, so an immediate send can't
+  * be overtaken by an older held value.
+  */
+class indiPublisher
+{
+protected:
+
+   /// The policy and the publishing state of one property.
+   struct entry
+   {
+      publishPolicy policy;
+      publishStats stats;
+
+      double lastSent {0};       ///< The time the property was last sent [sec].
+      pcf::IndiProperty::PropertyStateType lastState {pcf::IndiProperty::UnknownPropertyState}; ///< The state last sent.
+      bool dirty {false};        ///< Is there a held change to send?
+      pcf::IndiProperty pending; ///< The held change.
+   };
+
+   std::unordered_map<std::string, entry> m_entries;
+
+   std::mutex m_mutex;
+
+public:
+
+   /// Adapter which makes a driver send through a publisher, to pass to the indi::update functions.
+   template<class indiDriverT>
+   struct sender
+   {
+      indiPublisher * m_publisher;
+      indiDriverT * m_driver;
+      double m_time;
+
+      void sendSetProperty( const pcf::IndiProperty & p )
+      {
+         m_publisher->send(p, m_driver, m_time);
+      }
+   };
+
+   /// Get the current time on the clock used for rate limiting.
+   /**
+     * \returns the time in seconds since an arbitrary start
+     */
+   static double now()
+   {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+
+   /// Set the publish policy of a property.  Must not be called once updates have begun.
+   /**
+     * \returns 0 on success
+     * \returns -1 if the policy is invalid
+     */
+   int setPolicy( const std::string & name,  ///< [in] the property name
+                  const publishPolicy & pol  ///< [in] the policy
+                )
+   {
+      if(pol.maxRate < 0 || pol.minDelta < 0 || pol.deadband < 0) return -1;
+
+      m_entries[name].policy = pol;
+      return 0;
+   }
+
+   /// Check if a property has a publish policy
+   /**
+     * \returns true if the property has a policy
+     */
+   bool hasPolicy( const std::string & name /**< [in] the property name */ ) const
+   {
+      if(m_entries.size() == 0) return false;
+      return (m_entries.count(name) > 0);
+   }
+
+   /// Check if any property has a publish policy
+   bool empty() const
+   {
+      return (m_entries.size() == 0);
+   }
+
+   /// Get the names of the properties with publish policies
+   std::vector<std::string> names() const
+   {
+      std::vector<std::string> ns;
+      for(auto it = m_entries.begin(); it != m_entries.end(); ++it) ns.push_back(it->first);
+      return ns;
+   }
+
+   /// Get the counters for a property.
+   /**
+     * \returns the counters, all 0 if the property has no policy
+     */
+   publishStats stats( const std::string & name /**< [in] the property name */)
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      auto it = m_entries.find(name);
+      if(it == m_entries.end()) return publishStats();
+
+      publishStats st = it->second.stats;
+
+      //The held change is not suppressed yet
+      uint64_t done = st.sent + (it->second.dirty ? 1 : 0);
+      st.suppressed = (st.updates > done) ? st.updates - done : 0;
+      return st;
+   }
+
+   /// Get the largest change in the given elements which is not a change under the property's policy.
+   /** For the deadband the smallest magnitude of the elements' current values is used, so no
+     * element is held to a looser band than its own.  Elements which are not numbers are ignored.
+     *
+     * Also counts an update of the property.
+     *
+     * \returns the tolerance to pass to indi::updateIfChanged
+     */
+   double tolerance( const pcf::IndiProperty & p,             ///< [in] the property, holding the published values
+                     const std::vector<std::string> & els     ///< [in] the elements being updated
+                   )
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      auto it = m_entries.find(p.getName());
+      if(it == m_entries.end()) return 0;
+
+      ++it->second.stats.updates;
+
+      const publishPolicy & pol = it->second.policy;
+      if(pol.deadband == 0) return pol.minDelta;
+
+      double minMag = -1;
+      for(size_t n = 0; n < els.size(); ++n)
+      {
+         if(!p.find(els[n])) continue;
+         if(p[els[n]].getNumericType() == pcf::IndiElement::NotNumeric) continue;
+
+         double mag = std::fabs(p[els[n]].get<double>());
+         if(minMag < 0 || mag < minMag) minMag = mag;
+      }
+
+      if(minMag < 0) return pol.minDelta;
+
+      return std::max(pol.minDelta, pol.deadband * minMag);
+   }
+
+   /// Send a property which has changed, or hold it if that would exceed its rate limit.
+   template<class indiDriverT>
+   void send( const pcf::IndiProperty & p, ///< [in] the property to send
+              indiDriverT * indiDriver,    ///< [in] the driver to send with
+              double t                     ///< [in] the current time, from now()
+            )
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      auto it = m_entries.find(p.getName());
+      if(it == m_entries.end())
+      {
+         indiDriver->sendSetProperty(p);
+         return;
+      }
+
+      entry & e = it->second;
+
+      if(e.policy.maxRate > 0 && p.getState() == e.lastState && t - e.lastSent < 1.0/e.policy.maxRate)
+      {
+         ++e.stats.deferred;
+         e.pending = p;
+         e.dirty = true;
+         return;
+      }
+
+      indiDriver->sendSetProperty(p);
+      e.lastSent = t;
+      e.lastState = p.getState();
+      e.dirty = false;
+      ++e.stats.sent;
+   }
+
+   /// Send the held changes of all properties whose rate limit allows it.
+   template<class indiDriverT>
+   void flush( indiDriverT * indiDriver, ///< [in] the driver to send with
+               double t,                 ///< [in] the current time, from now()
+               bool force = false        ///< [in] [optional] if true, send all held changes regardless of the rate limits
+             )
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      for(auto it = m_entries.begin(); it != m_entries.end(); ++it)
+      {
+         entry & e = it->second;
+         if(!e.dirty) continue;
+         if(!force && e.policy.maxRate > 0 && t - e.lastSent < 1.0/e.policy.maxRate) continue;
+
+         indiDriver->sendSetProperty(e.pending);
+         e.lastSent = t;
+         e.lastState = e.pending.getState();
+         e.dirty = false;
+         ++e.stats.sent;
+      }
+   }
+
+   /// Get the interval at which flush() should be called, which is half the shortest rate limit interval.
+   /**
+     * \returns the interval in seconds, or 0 if no policy has a rate limit
+     */
+   double flushInterval() const
+   {
+      double dt = 0;
+      for(auto it = m_entries.begin(); it != m_entries.end(); ++it)
+      {
+         if(it->second.policy.maxRate <= 0) continue;
+         double pdt = 0.5/it->second.policy.maxRate;
+         if(dt == 0 || pdt < dt) dt = pdt;
+      }
+      return dt;
+   }
+};
+
+} //namespace indi
+} //namespace app
+} //namespace MagAOX
+
+#endif //app_indiPublisher_hpp
@@ -87,6 +87,9 @@ int addNumberElement( pcf::IndiProperty & prop, ///< [out] the property to which
 /// Update the value of the INDI element, but only if it has changed.
 /** Only sends the set property message if the new value is different.
   * For properties with more than one element that may have changed, you should use the vector version below.
+  *
+  * Numbers are compared as numbers, and are only formatted as strings when the property is sent.  A change of
+  * no more than the tolerance is not a change, which stops noise in the last digits from being published.
   * 
   * \todo this needs a const char specialization to std::string
   * 
@@ -96,22 +99,17 @@ void updateIfChanged( pcf::IndiProperty & p,   ///< [in/out] The property contai
                       const std::string & el,  ///< [in] The element name
                       const T & newVal,        ///< [in] the new value
                       indiDriverT * indiDriver, ///< [in] the MagAOX INDI driver to use
-                      pcf::IndiProperty::PropertyStateType newState = pcf::IndiProperty::Ok
+                      pcf::IndiProperty::PropertyStateType newState = pcf::IndiProperty::Ok,
+                      double tolerance = 0 ///< [in] [optional] the largest change in a number which is not published
                     )
 {
    if( !indiDriver ) return;
    
    try
    {
-      //This is same code in IndiElement
-      std::stringstream ssValue;
-      ssValue.precision( 15 );
-      ssValue << std::boolalpha << newVal;
-      
       pcf::IndiProperty::PropertyStateType oldState = p.getState();
    
-      //Do comparison in string space, not raw value
-      if(p[el].getValue() != ssValue.str()|| oldState != newState)
+      if(p[el].isChanged(newVal, tolerance) || oldState != newState)
       {
          p[el].set(newVal);
          p.setTimeStamp(pcf::TimeStamp());
@@ -135,6 +133,7 @@ void updateIfChanged( pcf::IndiProperty & p,   ///< [in/out] The property contai
 
 /// Update the elements of an INDI propery, but only if there has been a change in at least one.
 /** Only sends the set property message if at least one of the new values is different, or if the state has changed.
+  * Numbers are compared as numbers, within the tolerance, as in the single element version above.
   *
   * \todo this needs a const char specialization to std::string
   * 
@@ -144,7 +143,8 @@ void updateIfChanged( pcf::IndiProperty & p,   ///< [in/out] The property contai
                       const std::vector<std::string> & els,  ///< [in] The element names
                       const std::vector<T> & newVals,        ///< [in] the new values
                       indiDriverT * indiDriver, ///< [in] the MagAOX INDI driver to use
-                      pcf::IndiProperty::PropertyStateType newState = pcf::IndiProperty::Ok
+                      pcf::IndiProperty::PropertyStateType newState = pcf::IndiProperty::Ok,
+                      double tolerance = 0 ///< [in] [optional] the largest change in a number which is not published
                     )
 {
    if( !indiDriver ) return;
@@ -161,13 +161,7 @@ void updateIfChanged( pcf::IndiProperty & p,   ///< [in/out] The property contai
       
       for(n=0; n< els.size() && changed != true; ++n)
       {
-         //This is same code in IndiElement
-         std::stringstream ssValue;
-         ssValue.precision( 15 );
-         ssValue << std::boolalpha << newVals[n];
-
-         //compare in string space
-         if(p[els[n]].getValue() != ssValue.str()) changed = true;
+         if(p[els[n]].isChanged(newVals[n], tolerance)) changed = true;
       }
       
       //and if there are changes, we send an update
@@ -0,0 +1,179 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <string>
+#include <vector>
+
+#include "../indiUtils.hpp"
+#include "../indiPublisher.hpp"
+using namespace MagAOX::app::indi;
+
+/// Records what would be sent
+struct recordingDriver
+{
+   std::vector<pcf::IndiProperty> m_sent;
+
+   void sendSetProperty( const pcf::IndiProperty & p )
+   {
+      m_sent.push_back(p);
+   }
+};
+
+/// Update the way MagAOXApp does when the property has a policy
+void update( indiPublisher & pub,
+             recordingDriver & drv,
+             pcf::IndiProperty & prop,
+             double val,
+             double t,
+             pcf::IndiProperty::PropertyStateType state = pcf::IndiProperty::Ok
+           )
+{
+   double tol = pub.tolerance(prop, {"current"});
+   indiPublisher::sender<recordingDriver> snd{&pub, &drv, t};
+   updateIfChanged(prop, "current", val, &snd, state, tol);
+}
+
+SCENARIO( "Publishing INDI properties by policy", "[indiPublisher]" )
+{
+   GIVEN("a number property")
+   {
+      recordingDriver drv;
+      pcf::IndiProperty prop(pcf::IndiProperty::Number);
+      prop.setDevice("dev");
+      prop.setName("prop");
+      addNumberElement<double>(prop, "current", 0, 1000, 0, "%0.2f");
+      prop.setState(pcf::IndiProperty::Ok);
+
+      indiPublisher pub;
+
+      WHEN("there is no policy")
+      {
+         REQUIRE( pub.empty() );
+         REQUIRE( !pub.hasPolicy("prop") );
+         REQUIRE( pub.flushInterval() == 0 );
+
+         indiPublisher::sender<recordingDriver> snd{&pub, &drv, 0};
+         for(int n = 1; n <= 10; ++n) updateIfChanged(prop, "current", n, &snd);
+         REQUIRE( drv.m_sent.size() == 10 );
+      }
+
+      WHEN("the rate is limited")
+      {
+         publishPolicy pol;
+         pol.maxRate = 2;
+         REQUIRE( pub.setPolicy("prop", pol) == 0 );
+         REQUIRE( pub.hasPolicy("prop") );
+         REQUIRE( pub.flushInterval() == 0.25 );
+
+         //The first is sent, the next 9 within 0.5 sec are held
+         for(int n = 1; n <= 10; ++n) update(pub, drv, prop, n, 100 + 0.01*n);
+         REQUIRE( drv.m_sent.size() == 1 );
+         REQUIRE( drv.m_sent[0]["current"].get<double>() == 1 );
+
+         //Too soon
+         pub.flush(&drv, 100.2);
+         REQUIRE( drv.m_sent.size() == 1 );
+
+         //Only the latest is sent
+         pub.flush(&drv, 100.6);
+         REQUIRE( drv.m_sent.size() == 2 );
+         REQUIRE( drv.m_sent[1]["current"].get<double>() == 10 );
+
+         pub.flush(&drv, 101.6);
+         REQUIRE( drv.m_sent.size() == 2 );
+
+         publishStats st = pub.stats("prop");
+         REQUIRE( st.updates == 10 );
+         REQUIRE( st.sent == 2 );
+         REQUIRE( st.deferred == 9 );
+         REQUIRE( st.suppressed == 8 );
+      }
+
+      WHEN("the state changes inside the rate limit")
+      {
+         publishPolicy pol;
+         pol.maxRate = 1;
+         pub.setPolicy("prop", pol);
+
+         update(pub, drv, prop, 1, 100);
+         update(pub, drv, prop, 2, 100.1);
+         REQUIRE( drv.m_sent.size() == 1 );
+
+         //An alert goes out at once, and replaces the held change
+         update(pub, drv, prop, 3, 100.2, pcf::IndiProperty::Alert);
+         REQUIRE( drv.m_sent.size() == 2 );
+         REQUIRE( drv.m_sent[1].getState() == pcf::IndiProperty::Alert );
+         REQUIRE( drv.m_sent[1]["current"].get<double>() == 3 );
+
+         pub.flush(&drv, 200);
+         REQUIRE( drv.m_sent.size() == 2 );
+      }
+
+      WHEN("a held change is flushed at shutdown")
+      {
+         publishPolicy pol;
+         pol.maxRate = 0.1;
+         pub.setPolicy("prop", pol);
+
+         update(pub, drv, prop, 1, 100);
+         update(pub, drv, prop, 2, 100.1);
+         pub.flush(&drv, 100.2, true);
+         REQUIRE( drv.m_sent.size() == 2 );
+         REQUIRE( drv.m_sent[1]["current"].get<double>() == 2 );
+      }
+
+      WHEN("there is a minimum change")
+      {
+         publishPolicy pol;
+         pol.minDelta = 0.5;
+         pub.setPolicy("prop", pol);
+
+         update(pub, drv, prop, 10, 0);
+         REQUIRE( drv.m_sent.size() == 1 );
+
+         //Small changes don't move the value which later changes are measured from
+         update(pub, drv, prop, 10.3, 0);
+         update(pub, drv, prop, 10.5, 0);
+         REQUIRE( drv.m_sent.size() == 1 );
+         REQUIRE( prop["current"].get<double>() == 10 );
+
+         update(pub, drv, prop, 10.6, 0);
+         REQUIRE( drv.m_sent.size() == 2 );
+
+         REQUIRE( pub.stats("prop").suppressed == 2 );
+      }
+
+      WHEN("there is a deadband")
+      {
+         publishPolicy pol;
+         pol.deadband = 0.01;
+         pub.setPolicy("prop", pol);
+
+         update(pub, drv, prop, 500, 0);
+         REQUIRE( drv.m_sent.size() == 1 );
+
+         //1% of 500
+         update(pub, drv, prop, 504.9, 0);
+         update(pub, drv, prop, 495.1, 0);
+         REQUIRE( drv.m_sent.size() == 1 );
+
+         update(pub, drv, prop, 505.1, 0);
+         REQUIRE( drv.m_sent.size() == 2 );
+
+         //1% of 5
+         update(pub, drv, prop, 5, 0);
+         update(pub, drv, prop, 5.04, 0);
+         REQUIRE( drv.m_sent.size() == 3 );
+         update(pub, drv, prop, 5.06, 0);
+         REQUIRE( drv.m_sent.size() == 4 );
+      }
+
+      WHEN("the policy is invalid")
+      {
+         publishPolicy pol;
+         pol.maxRate = -1;
+         REQUIRE( pub.setPolicy("prop", pol) == -1 );
+         REQUIRE( !pub.hasPolicy("prop") );
+      }
+   }
+}
@@ -1,6 +1,9 @@
 //#define CATCH_CONFIG_MAIN
 #include "../../../tests/catch2/catch.hpp"
 
+#include <chrono>
+#include <sstream>
+
 #include "../indiUtils.hpp"
 using namespace MagAOX::app::indi;
    
@@ -79,3 +82,253 @@ SCENARIO( "Parsing INDI unique key", "[indiUtils]" )
 }
 
 
+/// A stand-in for the INDI driver, which counts the properties sent
+struct countingDriver
+{
+   int m_sent {0};
+   size_t m_chars {0};
+
+   void sendSetProperty( const pcf::IndiProperty & p )
+   {
+      ++m_sent;
+
+      //Get the strings, as the real driver does when it writes the XML
+      for(unsigned n = 0; n < p.getNumElements(); ++n) m_chars += p[n].getValue().size();
+   }
+};
+
+SCENARIO( "Updating INDI properties only if changed", "[indiUtils]" )
+{
+   GIVEN("a number property")
+   {
+      countingDriver drv;
+      pcf::IndiProperty prop(pcf::IndiProperty::Number);
+      prop.setDevice("dev");
+      prop.setName("prop");
+      addNumberElement<double>(prop, "current", 0, 100, 0, "%0.2f");
+      addNumberElement<int>(prop, "count", 0, 100, 1, "%d");
+
+      WHEN("a double changes")
+      {
+         updateIfChanged(prop, "current", 1.5, &drv);
+         REQUIRE( drv.m_sent == 1 );
+         REQUIRE( prop["current"].getValue() == "1.5" );
+
+         updateIfChanged(prop, "current", 1.5, &drv);
+         REQUIRE( drv.m_sent == 1 );
+
+         updateIfChanged(prop, "current", 1.5000001, &drv);
+         REQUIRE( drv.m_sent == 2 );
+         REQUIRE( prop["current"].getValue() == "1.5000001" );
+         REQUIRE( prop["current"].get<double>() == 1.5000001 );
+      }
+
+      WHEN("a double changes by less than the tolerance")
+      {
+         updateIfChanged(prop, "current", 1.5, &drv, INDI_OK, 0.01);
+         REQUIRE( drv.m_sent == 1 );
+
+         updateIfChanged(prop, "current", 1.505, &drv, INDI_OK, 0.01);
+         REQUIRE( drv.m_sent == 1 );
+         REQUIRE( prop["current"].get<double>() == 1.5 );
+
+         updateIfChanged(prop, "current", 1.52, &drv, INDI_OK, 0.01);
+         REQUIRE( drv.m_sent == 2 );
+      }
+
+      WHEN("only the state changes")
+      {
+         updateIfChanged(prop, "current", 0.0, &drv, INDI_OK);
+         REQUIRE( drv.m_sent == 1 );
+
+         updateIfChanged(prop, "current", 0.0, &drv, INDI_BUSY);
+         REQUIRE( drv.m_sent == 2 );
+      }
+
+      WHEN("the value is NaN")
+      {
+         updateIfChanged(prop, "current", std::numeric_limits<double>::quiet_NaN(), &drv);
+         REQUIRE( drv.m_sent == 1 );
+
+         updateIfChanged(prop, "current", std::numeric_limits<double>::quiet_NaN(), &drv);
+         REQUIRE( drv.m_sent == 1 );
+      }
+
+      WHEN("a vector of values changes")
+      {
+         updateIfChanged<double>(prop, {"current", "count"}, {2.25, 7}, &drv);
+         REQUIRE( drv.m_sent == 1 );
+         REQUIRE( prop["count"].getValue() == "7" );
+
+         updateIfChanged<double>(prop, {"current", "count"}, {2.25, 7}, &drv);
+         REQUIRE( drv.m_sent == 1 );
+
+         updateIfChanged<double>(prop, {"current", "count"}, {2.25, 8}, &drv);
+         REQUIRE( drv.m_sent == 2 );
+      }
+
+      WHEN("the value was set as a string")
+      {
+         prop["count"].setValue("12");
+         updateIfChanged(prop, "count", 12, &drv);
+         REQUIRE( drv.m_sent == 1 ); //the state changed from unknown
+
+         updateIfChanged(prop, "count", 12, &drv);
+         REQUIRE( drv.m_sent == 1 );
+
+         updateIfChanged(prop, "count", 13, &drv);
+         REQUIRE( drv.m_sent == 2 );
+         REQUIRE( prop["count"].getNumericType() == pcf::IndiElement::NumericInt );
+      }
+   }
+
+   GIVEN("a text property")
+   {
+      countingDriver drv;
+      pcf::IndiProperty prop(pcf::IndiProperty::Text);
+      prop.setDevice("dev");
+      prop.setName("prop");
+      addTextElement(prop, "text");
+
+      WHEN("the text changes")
+      {
+         updateIfChanged(prop, "text", std::string("ready"), &drv);
+         REQUIRE( drv.m_sent == 1 );
+         REQUIRE( prop["text"].getValue() == "ready" );
+
+         updateIfChanged(prop, "text", std::string("ready"), &drv);
+         REQUIRE( drv.m_sent == 1 );
+
+         updateIfChanged(prop, "text", "set", &drv);
+         REQUIRE( drv.m_sent == 2 );
+         REQUIRE( prop["text"].getValue() == "set" );
+      }
+   }
+}
+
+SCENARIO( "Formatting INDI numbers", "[indiUtils]" )
+{
+   GIVEN("numbers of each type")
+   {
+      WHEN("formatting without a stringstream")
+      {
+         std::vector<double> xs = {0, 1, -1, 0.1, 1.5000001, 3.14159265358979, 1e-20, 6.02e23, 123456789012345678.0,
+                                   std::numeric_limits<double>::infinity()};
+
+         for(double x : xs)
+         {
+            std::stringstream ss;
+            ss.precision(15);
+            ss << x;
+            REQUIRE( pcf::IndiElement::formatNumber(x) == ss.str() );
+
+            std::stringstream ssn;
+            ssn.precision(15);
+            ssn << -x;
+            REQUIRE( pcf::IndiElement::formatNumber(-x) == ssn.str() );
+         }
+
+         REQUIRE( pcf::IndiElement::formatNumber(0.1f) == "0.100000001490116" );
+         REQUIRE( pcf::IndiElement::formatNumber(-42) == "-42" );
+         REQUIRE( pcf::IndiElement::formatNumber(std::numeric_limits<int64_t>::min()) == "-9223372036854775808" );
+         REQUIRE( pcf::IndiElement::formatNumber(std::numeric_limits<uint64_t>::max()) == "18446744073709551615" );
+      }
+
+      WHEN("setting and getting")
+      {
+         pcf::IndiElement el("el");
+
+         el.set(std::numeric_limits<uint64_t>::max());
+         REQUIRE( el.get<uint64_t>() == std::numeric_limits<uint64_t>::max() );
+         REQUIRE( el.getValue() == "18446744073709551615" );
+
+         el.set(true);
+         REQUIRE( el.getValue() == "true" );
+         REQUIRE( el.get<bool>() == true );
+
+         el.set(-3.5);
+         pcf::IndiElement cp(el);
+         REQUIRE( cp.get<double>() == -3.5 );
+         REQUIRE( cp.getValue() == "-3.5" );
+         REQUIRE( cp == el );
+      }
+   }
+}
+
+/// Update a property with the string comparison which updateIfChanged used to use
+template<class indiDriverT>
+void updateIfChangedString( pcf::IndiProperty & p,
+                            const std::vector<std::string> & els,
+                            const std::vector<double> & newVals,
+                            indiDriverT * indiDriver
+                          )
+{
+   bool changed = false;
+   for(size_t n=0; n< els.size() && changed != true; ++n)
+   {
+      std::stringstream ssValue;
+      ssValue.precision( 15 );
+      ssValue << std::boolalpha << newVals[n];
+
+      if(p[els[n]].getValue() != ssValue.str()) changed = true;
+   }
+
+   if(changed)
+   {
+      for(size_t n=0; n< els.size(); ++n)
+      {
+         std::stringstream ssValue;
+         ssValue.precision( 15 );
+         ssValue << std::boolalpha << newVals[n];
+         p[els[n]].setValue(ssValue.str());
+      }
+      p.setTimeStamp(pcf::TimeStamp());
+      p.setState (pcf::IndiProperty::Ok);
+      indiDriver->sendSetProperty (p);
+   }
+}
+
+SCENARIO( "Benchmarking updateIfChanged", "[.benchmark][indiUtils]" )
+{
+   GIVEN("a property with 8 numbers, of which 1 in 10 updates changes")
+   {
+      countingDriver drv;
+      pcf::IndiProperty prop(pcf::IndiProperty::Number);
+      prop.setDevice("dev");
+      prop.setName("prop");
+
+      std::vector<std::string> els;
+      for(int n = 0; n < 8; ++n)
+      {
+         els.push_back("el" + std::to_string(n));
+         addNumberElement<double>(prop, els.back(), 0, 100, 0, "%0.2f");
+      }
+
+      int nrep = 200000;
+      std::vector<double> vals(els.size());
+
+      WHEN("updating")
+      {
+         auto t0 = std::chrono::steady_clock::now();
+         for(int r = 0; r < nrep; ++r)
+         {
+            for(size_t n = 0; n < vals.size(); ++n) vals[n] = 20.0 + 0.123456789*n + (r/10)*1e-3;
+            updateIfChangedString(prop, els, vals, &drv);
+         }
+         auto t1 = std::chrono::steady_clock::now();
+         for(int r = 0; r < nrep; ++r)
+         {
+            for(size_t n = 0; n < vals.size(); ++n) vals[n] = 20.0 + 0.123456789*n + (r/10)*1e-3 + 1;
+            updateIfChanged(prop, els, vals, &drv);
+         }
+         auto t2 = std::chrono::steady_clock::now();
+
+         double ts = std::chrono::duration<double>(t1-t0).count();
+         double tt = std::chrono::duration<double>(t2-t1).count();
+
+         std::cout << "string compare: " << nrep/ts << " updates/sec, typed compare: " << nrep/tt << " updates/sec, speedup " << ts/tt << "\n";
+
+         REQUIRE( drv.m_sent == 2*nrep/10 );
+      }
+   }
+}
@@ -40,6 +40,42 @@
    #define MAGAOX_default_max_logSize (10485760)
 #endif
 
+#ifndef MAGAOX_default_logQueueLength
+   /// The default logger queue length
+   /** Defines the default number of entries in the lock-free logger queue.  This is also the number of
+     * buffers in the smallest size class of the buffer pool.  Default is 2048.
+     *
+     * Units: log entries
+     */
+   #define MAGAOX_default_logQueueLength (2048)
+#endif
+
+#ifndef MAGAOX_default_logIndexExt
+   /// The default extension for log index files
+   /** The index for a log file is written next to it, with this extension appended to the full log file name.
+     */
+   #define MAGAOX_default_logIndexExt "idx"
+#endif
+
+#ifndef MAGAOX_default_logIndexStride
+   /// The default maximum spacing of entries in a log index
+   /** An index entry is made for an event code at least every this many bytes, so that a lookup never scans
+     * more than this much of the file.  Default is 64 kB.
+     *
+     * Units: bytes
+     */
+   #define MAGAOX_default_logIndexStride (65536)
+#endif
+
+#ifndef MAGAOX_default_logIndexCount
+   /// The default maximum number of log entries between log index entries for an event code
+   /** Default is 64.
+     *
+     * Units: log entries
+     */
+   #define MAGAOX_default_logIndexCount (64)
+#endif
+
 #ifndef MAGAOX_default_loopPause
    /// The default application loopPause
    /** Defines default value of how long the event loop in execute() pauses. Default is 1 sec.
@@ -24,6 +24,7 @@
 #include "app/dev/edtCamera.hpp"
 #include "app/dev/dssShutter.hpp"
 #include "app/dev/shmimMonitor.hpp"
+#include "app/dev/streamProcessor.hpp"
 #include "app/dev/dm.hpp"
 #include "app/dev/telemeter.hpp"
 #include "app/dev/dmPokeWFS.hpp"
@@ -38,6 +39,10 @@
 
 #include "logger/logFileRaw.hpp"
 #include "logger/logManager.hpp"
+#include "logger/logQueue.hpp"
+#include "logger/logIndex.hpp"
+#include "logger/logMappedFile.hpp"
+#include "logger/logFollower.hpp"
 #include "logger/logFileName.hpp"
 #include "logger/logMap.hpp"
 #include "logger/logMeta.hpp"
@@ -47,6 +52,7 @@
 #include "logger/generated/logVerify.hpp"
 #include "logger/generated/logTypes.hpp"
 #include "logger/generated/logCodeValid.hpp"
+#include "logger/generated/logSchemata.hpp"
 
 
 //#define TTY_DEBUG
@@ -7,6 +7,12 @@
   */
 
 #include <cstring>
+#include <climits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
 #include "logFileRaw.hpp"
 
 namespace MagAOX
@@ -67,25 +73,92 @@ size_t logFileRaw::maxLogSize()
    return m_maxLogSize;
 }
 
+int logFileRaw::durability( durabilityT dur )
+{
+   m_durability = dur;
+   return 0;
+}
+
+int logFileRaw::durability( const std::string & dur )
+{
+   if(dur == "none") m_durability = durabilityNone;
+   else if(dur == "interval") m_durability = durabilityInterval;
+   else if(dur == "bytes") m_durability = durabilityBytes;
+   else return -1;
+
+   return 0;
+}
+
+logFileRaw::durabilityT logFileRaw::durability()
+{
+   return m_durability;
+}
+
+int logFileRaw::syncInterval( unsigned long si )
+{
+   m_syncInterval = si;
+   return 0;
+}
+
+unsigned long logFileRaw::syncInterval()
+{
+   return m_syncInterval;
+}
+
+int logFileRaw::syncBytes( size_t sb )
+{
+   m_syncBytes = sb;
+   return 0;
+}
+
+size_t logFileRaw::syncBytes()
+{
+   return m_syncBytes;
+}
+
+int logFileRaw::writeIndex( bool wi )
+{
+   m_writeIndex = wi;
+   return 0;
+}
+
+bool logFileRaw::writeIndex()
+{
+   return m_writeIndex;
+}
+
+uint64_t logFileRaw::bytesWritten()
+{
+   return m_bytesWritten;
+}
+
+uint64_t logFileRaw::syscalls()
+{
+   return m_syscalls;
+}
+
+uint64_t logFileRaw::syncErrors()
+{
+   return m_syncErrors;
+}
+
 int logFileRaw::writeLog( flatlogs::bufferPtrT & data )
 {
    size_t N = flatlogs::logHeader::totalSize(data);
 
    //Check if we need a new file
-   if(m_currFileSize + N > m_maxLogSize || m_fout == 0)
+   if(m_currFileSize + N > m_maxLogSize || m_fd < 0)
    {
+      //Anything pending goes in the current file
+      if(writePending() < 0) return -1;
+
       flatlogs::timespecX ts = flatlogs::logHeader::timespec(data);
       if( createFile(ts) < 0 ) return -1;
    }
 
-   size_t nwr = fwrite( data.get(), sizeof(char), N, m_fout);
+   m_iov.push_back({data.get(), N});
 
-   if(nwr != N*sizeof(char))
-   {
-      std::cerr << "logFileRaw::writeLog: Error by fwrite.  At: " << __FILE__ << " " << __LINE__ << "\n";
-      std::cerr << "logFileRaw::writeLog: errno says: " << strerror(errno) << "\n";
-      return -1;
-   }
+   if(m_writeIndex) m_index.add(flatlogs::logHeader::timespec(data), flatlogs::logHeader::eventCode(data), m_currFileSize, N);
 
    m_currFileSize += N;
 
@@ -94,15 +167,50 @@ int logFileRaw::writeLog( flatlogs::bufferPtrT & data )
 
 int logFileRaw::flush()
 {
-   ///\todo this probably should be fsync, with appropriate error handling (see fsyncgate)
-   if(m_fout) fflush(m_fout);
+   if(writePending() < 0) return -1;
+
+   if(m_fd < 0 || m_unsyncedBytes == 0) return 0;
+
+   if(m_durability == durabilityInterval)
+   {
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+
+      double dt = (now.tv_sec - m_lastSync.tv_sec)*1000.0 + (now.tv_nsec - m_lastSync.tv_nsec)/1e6;
+
+      if(dt >= m_syncInterval) sync();
+   }
+   else if(m_durability == durabilityBytes)
+   {
+      if(m_unsyncedBytes >= m_syncBytes) sync();
+   }
 
    return 0;
 }
 
 int logFileRaw::close()
 {
-   if(m_fout) fclose(m_fout);
+   writePending();
+
+   if(m_fd >= 0)
+   {
+      if(m_durability != durabilityNone && m_unsyncedBytes > 0) sync();
+
+      if(m_fd >= 0)
+      {
+         ::close(m_fd);
+
+         //Only index a file which was completely written.
+         if(m_writeIndex && m_index.nRecords() > 0)
+         {
+            m_index.finish();
+            m_index.write(logIndex::indexName(m_fileName));
+         }
+      }
+   }
+
+   m_fd = -1;
+   m_index.clear();
 
    return 0;
 }
@@ -114,22 +222,112 @@ int logFileRaw::createFile(flatlogs::timespecX & ts)
    //Create the standard log name
    std::string fname = m_logPath + "/" + m_logName + "_" + tstamp + "." + m_logExt;
 
-   if(m_fout) fclose(m_fout);
+   close();
 
    errno = 0;
    ///\todo handle case where file exists (only if another instance tries at same ns -- pathological)
-   m_fout = fopen(fname.c_str(), "wb");
+   m_fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
 
-   if(m_fout == 0)
+   if(m_fd < 0)
    {
-      std::cerr << "logFileRaw::createFile: Error by fopen. At: " << __FILE__ << " " << __LINE__ << "\n";
+      std::cerr << "logFileRaw::createFile: Error by open. At: " << __FILE__ << " " << __LINE__ << "\n";
       std::cerr << "logFileRaw::createFile: errno says: " << strerror(errno) << "\n";
       std::cerr << "logFileRaw::createFile: fname = " << fname << "\n";
       return -1;
    }
 
+   m_fileName = fname;
+
    //Reset counters.
    m_currFileSize = 0;
+   m_unsyncedBytes = 0;
+   clock_gettime(CLOCK_MONOTONIC, &m_lastSync);
+
+   return 0;
+}
+
+int logFileRaw::writePending()
+{
+   if(m_iov.size() == 0) return 0;
+
+   if(m_fd < 0)
+   {
+      std::cerr << "logFileRaw::writePending: No file open.  At: " << __FILE__ << " " << __LINE__ << "\n";
+      m_iov.clear();
+      return -1;
+   }
+
+   size_t n = 0;
+   while(n < m_iov.size())
+   {
+      int niov = m_iov.size() - n;
+      if(niov > IOV_MAX) niov = IOV_MAX;
+
+      errno = 0;
+      ssize_t nwr = writev(m_fd, &m_iov[n], niov);
+      ++m_syscalls;
+
+      if(nwr < 0)
+      {
+         if(errno == EINTR) continue;
+
+         std::cerr << "logFileRaw::writePending: Error by writev.  At: " << __FILE__ << " " << __LINE__ << "\n";
+         std::cerr << "logFileRaw::writePending: errno says: " << strerror(errno) << "\n";
+         m_iov.clear();
+         return -1;
+      }
+
+      m_bytesWritten += nwr;
+      m_unsyncedBytes += nwr;
+
+      //Advance past what was written, which could end in the middle of an entry
+      size_t uwr = nwr;
+      while(uwr > 0 && n < m_iov.size())
+      {
+         if(uwr >= m_iov[n].iov_len)
+         {
+            uwr -= m_iov[n].iov_len;
+            ++n;
+         }
+         else
+         {
+            m_iov[n].iov_base = static_cast<char*>(m_iov[n].iov_base) + uwr;
+            m_iov[n].iov_len -= uwr;
+            uwr = 0;
+         }
+      }
+   }
+
+   m_iov.clear();
+
+   return 0;
+}
+
+int logFileRaw::sync()
+{
+   if(m_fd < 0) return 0;
+
+   errno = 0;
+   int rv = fdatasync(m_fd);
+   ++m_syscalls;
+
+   if(rv < 0)
+   {
+      ++m_syncErrors;
+
+      std::cerr << "logFileRaw::sync: Error by fdatasync.  At: " << __FILE__ << " " << __LINE__ << "\n";
+      std::cerr << "logFileRaw::sync: errno says: " << strerror(errno) << "\n";
+      std::cerr << "logFileRaw::sync: starting a new file\n";
+
+      //Don't retry, the kernel may have dropped the dirty pages.  The next write starts a new file.
+      ::close(m_fd);
+      m_fd = -1;
+
+      return -1;
+   }
+
+   m_unsyncedBytes = 0;
+   clock_gettime(CLOCK_MONOTONIC, &m_lastSync);
 
    return 0;
 }
@@ -15,6 +15,11 @@
 #include <iostream>
 
 #include <string>
+#include <vector>
+#include <atomic>
+#include <ctime>
+
+#include <sys/uio.h>
 
 
 #include <mx/ioutils/stringUtils.hpp>
@@ -22,6 +27,8 @@
 #include "../common/defaults.hpp"
 #include <flatlogs/flatlogs.hpp>
 
+#include "logIndex.hpp"
+
 namespace MagAOX
 {
 namespace logger
@@ -37,10 +44,32 @@ namespace logger
   *
   * The timestamp is from the first entry of the file.
   *
+  * Entries passed to writeLog are not written immediately.  They are gathered and written with a single
+  * `writev` call per batch when flush() is called, so the entry buffers must remain valid until then.
+  *
+  * Durability is configurable:
+  * - none: the data is left in the page cache for the kernel to write back (the default).
+  * - interval: `fdatasync` is called from flush() if at least m_syncInterval ms have passed since the last sync.
+  * - bytes: `fdatasync` is called from flush() if at least m_syncBytes bytes have been written since the last sync.
+  *
+  * Files are always synced before being closed when durability is not none.  If `fdatasync` fails the
+  * file is closed and a new one started, since after a failed sync the kernel may have discarded the
+  * dirty pages and a retry can not be trusted (the "fsyncgate" problem).
+  *
+  * Unless disabled with writeIndex(false), a logIndex is built as entries are written and saved next to
+  * the file when it is closed, so that readers (see logMappedFile) can find entries without scanning.
   */
 class logFileRaw
 {
 
+public:
+
+   /// The durability modes
+   enum durabilityT { durabilityNone, ///< Never sync, leave it to the kernel.
+                      durabilityInterval, ///< Sync every m_syncInterval milliseconds.
+                      durabilityBytes ///< Sync every m_syncBytes bytes.
+                    };
+
 protected:
 
    /** \name Configurable Parameters
@@ -51,15 +80,39 @@ protected:
    std::string m_logExt {MAGAOX_default_logExt}; ///< The extension for the log files.
 
    size_t m_maxLogSize {MAGAOX_default_max_logSize}; ///< The maximum file size in bytes. Default is 10 MB.
+
+   durabilityT m_durability {durabilityNone}; ///< The durability mode.  Default is none.
+
+   unsigned long m_syncInterval {1000}; ///< The interval between syncs in ms, for durability mode interval. Default is 1000 ms.
+
+   size_t m_syncBytes {1048576}; ///< The number of bytes between syncs, for durability mode bytes. Default is 1 MB.
+
+   bool m_writeIndex {true}; ///< Whether or not to write an index file when each log file is closed.  Default is true.
    ///@}
 
    /** \name Internal State
      *@{
      */
 
-   FILE * m_fout {0}; ///< The file pointer
+   int m_fd {-1}; ///< The file descriptor
+
+   std::string m_fileName; ///< The full name of the current file
+
+   logIndex m_index; ///< The index of the current file
+
+   size_t m_currFileSize {0}; ///< The current file size, including pending entries.
+
+   std::vector<iovec> m_iov; ///< The entries pending a write.
+
+   size_t m_unsyncedBytes {0}; ///< Bytes written since the last sync.
+
+   timespec m_lastSync {0,0}; ///< Time of the last sync.
+
+   std::atomic<uint64_t> m_bytesWritten {0}; ///< Total bytes written, for statistics.
 
-   size_t m_currFileSize {0}; ///< The current file size.
+   std::atomic<uint64_t> m_syscalls {0}; ///< Total write and sync system calls made, for statistics.
+
+   std::atomic<uint64_t> m_syncErrors {0}; ///< Total sync errors, each of which caused a new file.
 
    ///@}
 
@@ -131,25 +184,99 @@ public:
      */
    size_t maxLogSize();
 
-   ///Write a log entry to the file
-   /** Checks if this write will exceed m_maxLogSize, and if so opens a new file.
+   /// Set the durability mode
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int durability( durabilityT dur /**< [in] the new durability mode */);
+
+   /// Set the durability mode from a string
+   /** Valid values are "none", "interval", and "bytes".
+     *
+     * \returns 0 on success
+     * \returns -1 on error, in which case the mode is not changed.
+     */
+   int durability( const std::string & dur /**< [in] the new durability mode */);
+
+   /// Get the durability mode
+   /**
+     * \returns the current value of m_durability
+     */
+   durabilityT durability();
+
+   /// Set the sync interval
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int syncInterval( unsigned long si /**< [in] the new sync interval in ms */);
+
+   /// Get the sync interval
+   /**
+     * \returns the current value of m_syncInterval
+     */
+   unsigned long syncInterval();
+
+   /// Set the sync bytes
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int syncBytes( size_t sb /**< [in] the new number of bytes between syncs */);
+
+   /// Get the sync bytes
+   /**
+     * \returns the current value of m_syncBytes
+     */
+   size_t syncBytes();
+
+   /// Set whether or not to write index files
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int writeIndex( bool wi /**< [in] the new value of m_writeIndex */);
+
+   /// Get whether or not index files are written
+   /**
+     * \returns the current value of m_writeIndex
+     */
+   bool writeIndex();
+
+   /// Get the total number of bytes written
+   uint64_t bytesWritten();
+
+   /// Get the total number of write and sync system calls
+   uint64_t syscalls();
+
+   /// Get the total number of sync errors
+   uint64_t syncErrors();
+
+   ///Queue a log entry to be written to the file
+   /** Checks if this write will exceed m_maxLogSize, and if so writes any pending entries and opens a new file.
      * The new file will have the timestamp of this log entry.
      *
+     * The entry is not written until flush() is called, and so the buffer must remain valid until then.
+     *
      * \returns 0 on success
      * \returns -1 on error
      */
    int writeLog( flatlogs::bufferPtrT & data ///< [in] the log entry to write to disk
                );
 
-   /// Flush the stream
-   /**
+   /// Write all pending entries, and sync according to the durability mode.
+   /** The pending entries are written with as few `writev` calls as possible.
+     * A sync error is reported and handled by starting a new file, and is not treated as an error here.
+     *
      * \returns 0 on success
      * \returns -1 on error
      */
    int flush();
 
    ///Close the file pointer
-   /**
+   /** Writes the index file if enabled.
+     *
      * \returns 0 on success
      * \returns -1 on error
      */
@@ -167,6 +294,22 @@ protected:
      */
    int createFile(flatlogs::timespecX & ts /**< [in] A MagAOX timespec, used to set the timestamp */);
 
+   /// Write the pending entries to the file.
+   /** Handles partial writes and the IOV_MAX limit.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int writePending();
+
+   /// Sync the file data to disk.
+   /** On error the file is closed so that the next write will start a new file.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int sync();
+
 
 };
 
@@ -0,0 +1,468 @@
+/** \file logFollower.cpp
+  * \brief Follow the binary logs of many applications at once.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * \ingroup logger_files
+  *
+  */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "logFollower.hpp"
+#include "logMappedFile.hpp"
+
+using namespace flatlogs;
+
+namespace MagAOX
+{
+namespace logger
+{
+
+namespace
+{
+
+/// Get the time on the monotonic clock, in seconds
+double monotonicNow()
+{
+   return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Get the application name from a log file name, without the path, of the form appName_YYYYMMDDHHMMSSNNNNNNNNN.ext
+/** Unlike logFileName this is quiet about names which don't match, since every file written in the
+  * directory is seen.
+  *
+  * \returns 0 if the name is that of a log file with the extension
+  * \returns -1 otherwise
+  */
+int logAppName( std::string & appName,      ///< [out] the application name
+                const std::string & name,   ///< [in] the file name
+                const std::string & ext     ///< [in] the extension, including the '.'
+              )
+{
+   if(name.size() < ext.size() + 25) return -1;
+   if(name.compare(name.size() - ext.size(), ext.size(), ext) != 0) return -1;
+
+   size_t ts = name.size() - ext.size() - 23;
+   if(name[ts-1] != '_') return -1;
+
+   for(size_t n = ts; n < ts + 23; ++n)
+   {
+      if(name[n] < '0' || name[n] > '9') return -1;
+   }
+
+   appName = name.substr(0, ts-1);
+   return 0;
+}
+
+} //namespace
+
+logFollower::logFollower()
+{
+}
+
+logFollower::~logFollower()
+{
+   close();
+}
+
+int logFollower::open( const std::string & dir,
+                       const std::string & ext,
+                       const std::vector<std::string> & apps,
+                       const timespecX & start
+                     )
+{
+   close();
+
+   m_dir = dir;
+   m_ext = ext;
+   m_all = (apps.size() == 0);
+   m_start = start;
+
+   m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   if(m_inotify < 0)
+   {
+      std::cerr << "logFollower::open: Error by inotify_init1. At: " << __FILE__ << " " << __LINE__ << "\n";
+      std::cerr << "logFollower::open: errno says: " << strerror(errno) << "\n";
+      return -1;
+   }
+
+   //Watch before looking for files, so none created in between are missed.
+   if(inotify_add_watch(m_inotify, m_dir.c_str(), IN_CREATE | IN_MOVED_TO | IN_MODIFY | IN_DELETE_SELF | IN_MOVE_SELF) < 0)
+   {
+      std::cerr << "logFollower::open: Error by inotify_add_watch. At: " << __FILE__ << " " << __LINE__ << "\n";
+      std::cerr << "logFollower::open: errno says: " << strerror(errno) << "\n";
+      std::cerr << "logFollower::open: dir = " << m_dir << "\n";
+      close();
+      return -1;
+   }
+
+   //Applications without a file yet are followed once they create one.
+   for(size_t n = 0; n < apps.size(); ++n)
+   {
+      m_files[apps[n]].m_appName = apps[n];
+   }
+
+   if(scan(true) < 0)
+   {
+      close();
+      return -1;
+   }
+
+   return 0;
+}
+
+void logFollower::close()
+{
+   for(auto it = m_files.begin(); it != m_files.end(); ++it)
+   {
+      if(it->second.m_fd >= 0) ::close(it->second.m_fd);
+   }
+   m_files.clear();
+
+   if(m_inotify >= 0) ::close(m_inotify);
+   m_inotify = -1;
+
+   m_held.clear();
+}
+
+int logFollower::latency( double lat )
+{
+   if(lat < 0 || !std::isfinite(lat)) return -1;
+
+   m_latency = lat;
+   return 0;
+}
+
+double logFollower::latency() const
+{
+   return m_latency;
+}
+
+std::vector<std::string> logFollower::appNames() const
+{
+   std::vector<std::string> names;
+   for(auto it = m_files.begin(); it != m_files.end(); ++it) names.push_back(it->first);
+   return names;
+}
+
+std::string logFollower::fileName( const std::string & appName ) const
+{
+   auto it = m_files.find(appName);
+   if(it == m_files.end()) return "";
+
+   return it->second.m_fileName;
+}
+
+int logFollower::poll( std::vector<entry> & entries,
+                       int timeout
+                     )
+{
+   if(m_inotify < 0) return -1;
+
+   size_t nstart = entries.size();
+
+   double now = monotonicNow();
+   double deadline = now + 0.001*timeout;
+
+   while(true)
+   {
+      release(entries, now);
+      if(entries.size() > nstart) return 0;
+
+      //Wait for an event, or until the earliest held entry is ready, or the timeout.
+      double wait = -1;
+      if(timeout >= 0) wait = deadline - now;
+      if(m_held.size() > 0)
+      {
+         double rwait = m_held.front().m_release - now;
+         if(wait < 0 || rwait < wait) wait = rwait;
+      }
+
+      int waitms = -1;
+      if(wait >= 0) waitms = ceil(1000*wait);
+
+      pollfd pfd = {m_inotify, POLLIN, 0};
+      int rv = ::poll(&pfd, 1, waitms);
+
+      if(rv < 0)
+      {
+         if(errno == EINTR) return 0;
+
+         std::cerr << "logFollower::poll: Error by poll. At: " << __FILE__ << " " << __LINE__ << "\n";
+         std::cerr << "logFollower::poll: errno says: " << strerror(errno) << "\n";
+         return -1;
+      }
+
+      if(rv > 0)
+      {
+         if(readEvents() < 0) return -1;
+      }
+
+      now = monotonicNow();
+
+      if(timeout >= 0 && now >= deadline)
+      {
+         release(entries, now);
+         return 0;
+      }
+   }
+}
+
+void logFollower::flush( std::vector<entry> & entries )
+{
+   while(m_held.size() > 0)
+   {
+      std::pop_heap(m_held.begin(), m_held.end(), heldLater());
+      entries.push_back(std::move(m_held.back().m_entry));
+      m_held.pop_back();
+   }
+}
+
+int logFollower::scan( bool useStart )
+{
+   DIR * d = opendir(m_dir.c_str());
+   if(d == nullptr)
+   {
+      std::cerr << "logFollower::scan: Error by opendir. At: " << __FILE__ << " " << __LINE__ << "\n";
+      std::cerr << "logFollower::scan: errno says: " << strerror(errno) << "\n";
+      std::cerr << "logFollower::scan: dir = " << m_dir << "\n";
+      return -1;
+   }
+
+   //The timestamps in the names are fixed width, so the newest file has the greatest name.
+   std::map<std::string, std::string> newest;
+
+   dirent * de;
+   while( (de = readdir(d)) != nullptr )
+   {
+      std::string name = de->d_name;
+      std::string appName;
+      if(logAppName(appName, name, m_ext) < 0) continue;
+
+      if(!m_all && m_files.count(appName) == 0) continue;
+
+      std::string & nn = newest[appName];
+      if(name > nn) nn = name;
+   }
+
+   closedir(d);
+
+   for(auto it = newest.begin(); it != newest.end(); ++it)
+   {
+      followedFile & ff = m_files[it->first];
+      if(it->second <= ff.m_baseName) continue;
+
+      ff.m_appName = it->first;
+      if(follow(it->first, it->second, useStart) < 0) return -1;
+   }
+
+   return 0;
+}
+
+int logFollower::follow( const std::string & appName,
+                         const std::string & baseName,
+                         bool useStart
+                       )
+{
+   followedFile & ff = m_files[appName];
+
+   //Finish the old file first.  Its writer has closed it by the time the new one exists.
+   if(ff.m_fd >= 0)
+   {
+      readFile(ff);
+      ::close(ff.m_fd);
+      ff.m_fd = -1;
+   }
+
+   ff.m_appName = appName;
+   ff.m_baseName = baseName;
+   ff.m_fileName = m_dir + "/" + baseName;
+   ff.m_offset = 0;
+   ff.m_partial.clear();
+
+   ff.m_fd = ::open(ff.m_fileName.c_str(), O_RDONLY | O_CLOEXEC);
+   if(ff.m_fd < 0)
+   {
+      //It may already have been removed, in which case keep waiting for the next one.
+      if(errno == ENOENT) return 0;
+
+      std::cerr << "logFollower::follow: Error by open. At: " << __FILE__ << " " << __LINE__ << "\n";
+      std::cerr << "logFollower::follow: errno says: " << strerror(errno) << "\n";
+      std::cerr << "logFollower::follow: fname = " << ff.m_fileName << "\n";
+      return -1;
+   }
+
+   //Use the index to find the start, rather than reading the whole file.
+   if(useStart && (m_start.time_s > 0 || m_start.time_ns > 0))
+   {
+      logMappedFile lmf;
+      if(lmf.open(ff.m_fileName) == 0)
+      {
+         ff.m_offset = lmf.seek(m_start) - lmf.data();
+      }
+   }
+
+   return readFile(ff);
+}
+
+int logFollower::readFile( followedFile & ff )
+{
+   if(ff.m_fd < 0) return 0;
+
+   static constexpr size_t chunk = 65536;
+
+   //Read everything new, appended to any partial entry.
+   while(true)
+   {
+      size_t sz = ff.m_partial.size();
+      ff.m_partial.resize(sz + chunk);
+
+      ssize_t nrd = pread(ff.m_fd, ff.m_partial.data() + sz, chunk, ff.m_offset);
+
+      if(nrd < 0)
+      {
+         ff.m_partial.resize(sz);
+         if(errno == EINTR) continue;
+
+         std::cerr << "logFollower::readFile: Error by pread. At: " << __FILE__ << " " << __LINE__ << "\n";
+         std::cerr << "logFollower::readFile: errno says: " << strerror(errno) << "\n";
+         std::cerr << "logFollower::readFile: fname = " << ff.m_fileName << "\n";
+         return -1;
+      }
+
+      ff.m_partial.resize(sz + nrd);
+      ff.m_offset += nrd;
+
+      if((size_t) nrd < chunk) break;
+   }
+
+   double release = monotonicNow() + m_latency;
+
+   //Take the complete entries, leaving a partial one for next time.
+   size_t pos = 0;
+   while(ff.m_partial.size() - pos >= logHeader::minHeadSize)
+   {
+      char * buffer = ff.m_partial.data() + pos;
+      size_t left = ff.m_partial.size() - pos;
+
+      if(logHeader::headerSize(buffer) > left) break;
+
+      size_t tSz = logHeader::totalSize(buffer);
+      if(tSz > left) break;
+
+      heldEntry he;
+      he.m_ts = logHeader::timespec(buffer);
+      he.m_release = release;
+      he.m_seq = m_seq++;
+      he.m_entry.m_appName = ff.m_appName;
+      he.m_entry.m_logBuff = bufferPtrT(new char[tSz], std::default_delete<char[]>());
+      memcpy(he.m_entry.m_logBuff.get(), buffer, tSz);
+
+      m_held.push_back(std::move(he));
+      std::push_heap(m_held.begin(), m_held.end(), heldLater());
+
+      pos += tSz;
+   }
+
+   ff.m_partial.erase(ff.m_partial.begin(), ff.m_partial.begin() + pos);
+
+   return 0;
+}
+
+int logFollower::readEvents()
+{
+   alignas(inotify_event) char buf[16384];
+
+   while(true)
+   {
+      ssize_t nrd = read(m_inotify, buf, sizeof(buf));
+
+      if(nrd < 0)
+      {
+         if(errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+         if(errno == EINTR) continue;
+
+         std::cerr << "logFollower::readEvents: Error by read. At: " << __FILE__ << " " << __LINE__ << "\n";
+         std::cerr << "logFollower::readEvents: errno says: " << strerror(errno) << "\n";
+         return -1;
+      }
+
+      if(nrd == 0) return 0;
+
+      for(char * p = buf; p < buf + nrd; p += sizeof(inotify_event) + reinterpret_cast<inotify_event *>(p)->len)
+      {
+         inotify_event * ev = reinterpret_cast<inotify_event *>(p);
+
+         if(ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+         {
+            std::cerr << "logFollower::readEvents: log directory removed. At: " << __FILE__ << " " << __LINE__ << "\n";
+            std::cerr << "logFollower::readEvents: dir = " << m_dir << "\n";
+            return -1;
+         }
+
+         //Events were lost, so read every file and look for new ones.
+         if(ev->mask & IN_Q_OVERFLOW)
+         {
+            for(auto it = m_files.begin(); it != m_files.end(); ++it)
+            {
+               if(readFile(it->second) < 0) return -1;
+            }
+
+            if(scan(false) < 0) return -1;
+            continue;
+         }
+
+         if(ev->len == 0) continue;
+
+         std::string name = ev->name;
+         std::string appName;
+         if(logAppName(appName, name, m_ext) < 0) continue;
+
+         auto it = m_files.find(appName);
+         if(it == m_files.end())
+         {
+            if(!m_all) continue;
+            it = m_files.emplace(appName, followedFile()).first;
+            it->second.m_appName = appName;
+         }
+
+         followedFile & ff = it->second;
+
+         if(name > ff.m_baseName)
+         {
+            //A new file, or a write to one whose creation we didn't see.
+            if(follow(appName, name, false) < 0) return -1;
+         }
+         else if(name == ff.m_baseName && (ev->mask & IN_MODIFY))
+         {
+            if(readFile(ff) < 0) return -1;
+         }
+      }
+   }
+}
+
+void logFollower::release( std::vector<entry> & entries,
+                           double now
+                         )
+{
+   while(m_held.size() > 0 && m_held.front().m_release <= now)
+   {
+      std::pop_heap(m_held.begin(), m_held.end(), heldLater());
+      entries.push_back(std::move(m_held.back().m_entry));
+      m_held.pop_back();
+   }
+}
+
+} //namespace logger
+} //namespace MagAOX
@@ -0,0 +1,211 @@
+/** \file logFollower.hpp
+  * \brief Follow the binary logs of many applications at once.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * \ingroup logger_files
+  *
+  * History:
+  * - 2026-10-17 created
+  */
+
+#ifndef logger_logFollower_hpp
+#define logger_logFollower_hpp
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <flatlogs/flatlogs.hpp>
+
+namespace MagAOX
+{
+namespace logger
+{
+
+/// Follow the binary logs of many applications at once, using inotify.
+/** A single inotify watch on the log directory reports writes to, and creation of, log files.  Only the
+  * files reported as written are read, so the cost of following does not grow with the number of idle
+  * applications, and a new entry is seen as soon as it is written rather than at the next poll.
+  *
+  * The newest file of each followed application is read.  When an application creates a new file, the
+  * rest of its old file is read and then the new file is followed from its start.  If all applications are
+  * followed, an application which creates its first file is followed from then on.
+  *
+  * Entries from all applications are merged in time order.  An entry is held for up to the latency after
+  * it was read, so that entries with earlier times which are written by other applications at about the
+  * same time can be put before it.  This bounds both the time an entry waits and how late an entry can be
+  * and still be in order.
+  *
+  * \ingroup logger
+  */
+class logFollower
+{
+public:
+
+   /// An entry read from a log
+   struct entry
+   {
+      std::string m_appName;        ///< The application which wrote the entry
+      flatlogs::bufferPtrT m_logBuff; ///< The raw log entry
+   };
+
+protected:
+
+   /// A file being followed
+   struct followedFile
+   {
+      std::string m_appName;  ///< The application name
+      std::string m_fileName; ///< The full name of the file
+      std::string m_baseName; ///< The name of the file without the path, to match inotify events and sort
+      int m_fd {-1};          ///< The file descriptor, -1 if no file is open
+      off_t m_offset {0};     ///< The offset of the next byte to read
+      std::vector<char> m_partial; ///< The bytes of an entry which is not yet completely written
+   };
+
+   /// An entry waiting to be released
+   struct heldEntry
+   {
+      flatlogs::timespecX m_ts; ///< The time of the entry
+      double m_release {0};     ///< The time at which it is released, on the monotonic clock
+      uint64_t m_seq {0};       ///< Order of arrival, so entries with the same time keep the order they were read
+      entry m_entry;            ///< The entry
+   };
+
+   /// Order the held entries so the earliest is at the top of the heap.
+   struct heldLater
+   {
+      bool operator()( const heldEntry & a,
+                       const heldEntry & b
+                     ) const
+      {
+         if(a.m_ts.time_s != b.m_ts.time_s) return a.m_ts.time_s > b.m_ts.time_s;
+         if(a.m_ts.time_ns != b.m_ts.time_ns) return a.m_ts.time_ns > b.m_ts.time_ns;
+         return a.m_seq > b.m_seq;
+      }
+   };
+
+   std::string m_dir; ///< The directory containing the logs
+   std::string m_ext; ///< The extension of the log files, including the '.'
+
+   bool m_all {false}; ///< If true, all applications are followed, including those which start later.
+
+   std::map<std::string, followedFile> m_files; ///< The files being followed, by application name
+
+   int m_inotify {-1}; ///< The inotify descriptor
+
+   double m_latency {0.25}; ///< The time in seconds an entry is held for merging
+
+   std::vector<heldEntry> m_held; ///< Entries waiting to be released, a heap ordered by heldLater
+
+   uint64_t m_seq {0}; ///< The arrival counter
+
+   flatlogs::timespecX m_start {0,0}; ///< Entries in the first files before this time are skipped
+
+public:
+
+   /// Default c'tor
+   logFollower();
+
+   /// Destructor.  Closes all files.
+   ~logFollower();
+
+   logFollower( const logFollower & ) = delete;
+   logFollower & operator=( const logFollower & ) = delete;
+
+   /// Start following logs
+   /** The newest file of each application is opened, and its entries at or after the start time will be
+     * the first ones returned.  Entries of later files are all returned.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int open( const std::string & dir,               ///< [in] the directory containing the logs
+             const std::string & ext,               ///< [in] the extension of the log files, including the '.'
+             const std::vector<std::string> & apps, ///< [in] the applications to follow. If empty, all are followed.
+             const flatlogs::timespecX & start      ///< [in] the time of the earliest entry to return from the current files
+           );
+
+   /// Stop following and close all files.
+   void close();
+
+   /// Set the time an entry is held for merging
+   /**
+     * \returns 0 on success
+     * \returns -1 if the latency is negative
+     */
+   int latency( double lat /**< [in] the new latency, in seconds */);
+
+   /// Get the time an entry is held for merging
+   /**
+     * \returns the current value of m_latency
+     */
+   double latency() const;
+
+   /// Get the applications being followed
+   std::vector<std::string> appNames() const;
+
+   /// Get the name of the file being followed for an application
+   /**
+     * \returns the full name of the file
+     * \returns an empty string if the application is not being followed
+     */
+   std::string fileName( const std::string & appName /**< [in] the application */) const;
+
+   /// Wait for entries and return those ready to be released, in time order.
+   /** Waits until there is at least one entry to release or the timeout expires.  Entries are appended to
+     * the output.
+     *
+     * \returns 0 on success, including if no entries are ready
+     * \returns -1 on error
+     */
+   int poll( std::vector<entry> & entries, ///< [out] the released entries are appended to this
+             int timeout                   ///< [in] the maximum time to wait, in milliseconds. -1 waits until an entry is ready.
+           );
+
+   /// Release all held entries at once, e.g. when shutting down.
+   void flush( std::vector<entry> & entries /**< [out] the held entries are appended to this */);
+
+protected:
+
+   /// Find the newest file of each application, and follow it if it is newer than the current one
+   /** The rest of a file being replaced is read first.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int scan( bool useStart /**< [in] if true, entries before m_start are skipped in the files found*/);
+
+   /// Start following a file of an application, replacing its current file
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int follow( const std::string & appName,  ///< [in] the application
+               const std::string & baseName, ///< [in] the file name without the path
+               bool useStart                 ///< [in] if true, entries before m_start are skipped
+             );
+
+   /// Read all new complete entries of a file, adding them to the held entries
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int readFile( followedFile & ff /**< [in] the file to read */);
+
+   /// Process the events waiting on the inotify descriptor
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int readEvents();
+
+   /// Move the entries which are ready from the heap to the output
+   void release( std::vector<entry> & entries, ///< [out] the released entries are appended to this
+                 double now                    ///< [in] the current time on the monotonic clock
+               );
+};
+
+} //namespace logger
+} //namespace MagAOX
+
+#endif //logger_logFollower_hpp
@@ -0,0 +1,344 @@
+/** \file logIndex.cpp
+  * \brief A sparse timestamp and event code index for a binary log file.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * \ingroup logger_files
+  *
+  */
+
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "logIndex.hpp"
+
+using namespace flatlogs;
+
+namespace MagAOX
+{
+namespace logger
+{
+
+void logIndex::strideBytes( uint64_t sb )
+{
+   m_strideBytes = sb;
+}
+
+uint64_t logIndex::strideBytes() const
+{
+   return m_strideBytes;
+}
+
+void logIndex::strideCount( uint32_t sc )
+{
+   m_strideCount = sc;
+}
+
+uint32_t logIndex::strideCount()
+{
+   return m_strideCount;
+}
+
+std::string logIndex::indexName( const std::string & logName )
+{
+   return logName + "." + MAGAOX_default_logIndexExt;
+}
+
+void logIndex::clear()
+{
+   m_header = headerT();
+   m_entries.clear();
+   m_codeState.clear();
+   m_byCode.clear();
+}
+
+void logIndex::add( const timespecX & ts,
+                    eventCodeT ec,
+                    uint64_t offset,
+                    uint64_t size
+                  )
+{
+   if(m_header.m_nRecords == 0) m_header.m_startTime = ts;
+   m_header.m_endTime = ts;
+   ++m_header.m_nRecords;
+   m_header.m_fileSize = offset + size;
+
+   logIndexEntry ent;
+   ent.m_ts = ts;
+   ent.m_offset = offset;
+   ent.m_ec = ec;
+
+   auto it = m_codeState.find(ec);
+
+   if(it == m_codeState.end())
+   {
+      //First occurrence is always indexed
+      codeStateT cs;
+      cs.m_lastIndexed = offset;
+      cs.m_count = 0;
+      cs.m_last = ent;
+      m_codeState.emplace(ec, cs);
+      m_entries.push_back(ent);
+      return;
+   }
+
+   codeStateT & cs = it->second;
+
+   ++cs.m_count;
+   if(cs.m_count >= m_strideCount || offset - cs.m_lastIndexed >= m_strideBytes)
+   {
+      m_entries.push_back(ent);
+      cs.m_lastIndexed = offset;
+      cs.m_count = 0;
+   }
+
+   cs.m_last = ent;
+}
+
+void logIndex::finish()
+{
+   //Make sure the last occurrence of each code is indexed
+   for(auto & cs : m_codeState)
+   {
+      if(cs.second.m_lastIndexed != cs.second.m_last.m_offset) m_entries.push_back(cs.second.m_last);
+   }
+
+   std::sort(m_entries.begin(), m_entries.end(), [](const logIndexEntry & a, const logIndexEntry & b){ return a.m_offset < b.m_offset; });
+
+   m_header.m_nEntries = m_entries.size();
+   m_header.m_strideBytes = m_strideBytes;
+
+   m_codeState.clear();
+
+   makeLookup();
+}
+
+int logIndex::build( const char * data,
+                     size_t size
+                   )
+{
+   clear();
+
+   size_t st = 0;
+   while(st < size)
+   {
+      //Stop at an incomplete entry, which is probably still being written.
+      if(size - st < (size_t) logHeader::minHeadSize) break;
+
+      char * buffer = const_cast<char *>(data) + st;
+
+      if(logHeader::headerSize(buffer) > size - st) break;
+
+      size_t ts = logHeader::totalSize(buffer);
+      if(ts > size - st) break;
+
+      add(logHeader::timespec(buffer), logHeader::eventCode(buffer), st, ts);
+
+      st += ts;
+   }
+
+   finish();
+
+   if(st < size && m_header.m_nRecords == 0)
+   {
+      std::cerr << __FILE__ << " " << __LINE__ << " logIndex::build: possibly corrupt log file\n";
+      return -1;
+   }
+
+   return 0;
+}
+
+int logIndex::write( const std::string & fname )
+{
+   std::string tmpName = fname + ".tmp";
+
+   int fd = ::open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+   if(fd < 0)
+   {
+      std::cerr << "logIndex::write: Error by open. At: " << __FILE__ << " " << __LINE__ << "\n";
+      std::cerr << "logIndex::write: errno says: " << strerror(errno) << "\n";
+      std::cerr << "logIndex::write: fname = " << tmpName << "\n";
+      return -1;
+   }
+
+   m_header.m_nEntries = m_entries.size();
+
+   iovec iov[2];
+   iov[0].iov_base = &m_header;
+   iov[0].iov_len = sizeof(m_header);
+   iov[1].iov_base = m_entries.data();
+   iov[1].iov_len = m_entries.size()*sizeof(logIndexEntry);
+
+   ssize_t nwr = writev(fd, iov, 2);
+   ::close(fd);
+
+   if(nwr != (ssize_t) (iov[0].iov_len + iov[1].iov_len))
+   {
+      std::cerr << "logIndex::write: Error by writev. At: " << __FILE__ << " " << __LINE__ << "\n";
+      ::unlink(tmpName.c_str());
+      return -1;
+   }
+
+   if(::rename(tmpName.c_str(), fname.c_str()) < 0)
+   {
+      std::cerr << "logIndex::write: Error by rename. At: " << __FILE__ << " " << __LINE__ << "\n";
+      std::cerr << "logIndex::write: errno says: " << strerror(errno) << "\n";
+      ::unlink(tmpName.c_str());
+      return -1;
+   }
+
+   return 0;
+}
+
+int logIndex::read( const std::string & fname,
+                    uint64_t fileSize
+                  )
+{
+   clear();
+
+   int fd = ::open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+   if(fd < 0) return -1;
+
+   headerT head;
+   ssize_t nrd = ::read(fd, &head, sizeof(head));
+
+   headerT ref;
+   if(nrd != sizeof(head) || memcmp(head.m_magic, ref.m_magic, sizeof(ref.m_magic)) != 0 || head.m_version != ref.m_version
+          || head.m_entrySize != ref.m_entrySize || head.m_fileSize != fileSize)
+   {
+      ::close(fd);
+      return -1;
+   }
+
+   try
+   {
+      m_entries.resize(head.m_nEntries);
+   }
+   catch(...)
+   {
+      ::close(fd);
+      return -1;
+   }
+
+   size_t sz = head.m_nEntries*sizeof(logIndexEntry);
+   nrd = ::read(fd, m_entries.data(), sz);
+   ::close(fd);
+
+   if(nrd != (ssize_t) sz)
+   {
+      m_entries.clear();
+      return -1;
+   }
+
+   m_header = head;
+   m_strideBytes = head.m_strideBytes; //so lookups are bounded by the stride the file was indexed with
+
+   makeLookup();
+
+   return 0;
+}
+
+uint64_t logIndex::fileSize() const
+{
+   return m_header.m_fileSize;
+}
+
+uint64_t logIndex::nRecords() const
+{
+   return m_header.m_nRecords;
+}
+
+timespecX logIndex::startTime() const
+{
+   return m_header.m_startTime;
+}
+
+timespecX logIndex::endTime() const
+{
+   return m_header.m_endTime;
+}
+
+const std::vector<logIndexEntry> & logIndex::entries() const
+{
+   return m_entries;
+}
+
+const logIndexEntry * logIndex::prior( eventCodeT ec,
+                                       const timespecX & ts
+                                     ) const
+{
+   auto it = m_byCode.find(ec);
+   if(it == m_byCode.end()) return nullptr;
+
+   const std::vector<size_t> & pos = it->second;
+
+   //first with m_ts >= ts
+   auto ub = std::lower_bound(pos.begin(), pos.end(), ts, [this](size_t p, const timespecX & t){ return m_entries[p].m_ts < t; });
+
+   if(ub == pos.begin()) return nullptr;
+   --ub;
+
+   return &m_entries[*ub];
+}
+
+const logIndexEntry * logIndex::next( eventCodeT ec,
+                                      uint64_t offset
+                                    ) const
+{
+   auto it = m_byCode.find(ec);
+   if(it == m_byCode.end()) return nullptr;
+
+   const std::vector<size_t> & pos = it->second;
+
+   auto ub = std::upper_bound(pos.begin(), pos.end(), offset, [this](uint64_t o, size_t p){ return o < m_entries[p].m_offset; });
+
+   if(ub == pos.end()) return nullptr;
+
+   return &m_entries[*ub];
+}
+
+const logIndexEntry * logIndex::first( eventCodeT ec ) const
+{
+   auto it = m_byCode.find(ec);
+   if(it == m_byCode.end() || it->second.size() == 0) return nullptr;
+
+   return &m_entries[it->second.front()];
+}
+
+const logIndexEntry * logIndex::last( eventCodeT ec ) const
+{
+   auto it = m_byCode.find(ec);
+   if(it == m_byCode.end() || it->second.size() == 0) return nullptr;
+
+   return &m_entries[it->second.back()];
+}
+
+uint64_t logIndex::seek( const timespecX & ts ) const
+{
+   auto ub = std::lower_bound(m_entries.begin(), m_entries.end(), ts, [](const logIndexEntry & e, const timespecX & t){ return e.m_ts < t; });
+
+   if(ub == m_entries.begin()) return 0;
+   --ub;
+
+   return ub->m_offset;
+}
+
+void logIndex::makeLookup()
+{
+   m_byCode.clear();
+
+   for(size_t n = 0; n < m_entries.size(); ++n)
+   {
+      m_byCode[m_entries[n].m_ec].push_back(n);
+   }
+}
+
+} //namespace logger
+} //namespace MagAOX
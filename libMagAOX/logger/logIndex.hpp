@@ -0,0 +1,228 @@
+/** \file logIndex.hpp
+  * \brief A sparse timestamp and event code index for a binary log file.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * \ingroup logger_files
+  *
+  * History:
+  * - 2026-10-17 created
+  */
+
+#ifndef logger_logIndex_hpp
+#define logger_logIndex_hpp
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <flatlogs/flatlogs.hpp>
+
+#include "../common/defaults.hpp"
+
+namespace MagAOX
+{
+namespace logger
+{
+
+/// An entry in a log index, locating a single log entry in the file.
+/** This is written to disk as is, so it is fixed width.
+  *
+  * \ingroup logger
+  */
+struct logIndexEntry
+{
+   flatlogs::timespecX m_ts; ///< The timestamp of the log entry.
+   uint64_t m_offset {0}; ///< The offset of the log entry from the beginning of the file, in bytes.
+   flatlogs::eventCodeT m_ec {0}; ///< The event code of the log entry.
+   uint16_t m_reserved0 {0}; ///< Reserved, always 0.
+   uint32_t m_reserved1 {0}; ///< Reserved, always 0.
+};
+
+/// A sparse index of a binary log file.
+/** Records the time bounds and number of entries in the file, and a sparse table locating log entries by
+  * timestamp and event code.  For each event code the table contains its first and last entry, and then at
+  * least one entry every m_strideCount occurrences or every m_strideBytes bytes, whichever comes first.
+  * This means that finding the entry of a given event code nearest a time is a binary search of the table
+  * followed by a scan of at most m_strideBytes of the file.  Since the entries are sparse the index is small,
+  * typically well under 1% of the file.
+  *
+  * The index is built as entries are written by logFileRaw, and written next to the log file when the
+  * file is closed (at rotation or shutdown).  The index file name is the full log file name with
+  * MAGAOX_default_logIndexExt appended.  If a log file has no index, e.g. because it is still being written or
+  * the app crashed, the index can be built by scanning the file with build().
+  *
+  * Lookups assume that the timestamps in a file are monotonic, which is true of the logs written by logManager
+  * to within the precision of the clock.
+  *
+  * \ingroup logger
+  */
+class logIndex
+{
+public:
+
+   /// The on-disk header of an index file
+   struct headerT
+   {
+      char m_magic[8] {'X','L','O','G','I','D','X','\0'}; ///< Identifies the file as a log index.
+      uint32_t m_version {2}; ///< The format version.
+      uint32_t m_entrySize {sizeof(logIndexEntry)}; ///< The size of each index entry, as a check.
+      uint64_t m_fileSize {0}; ///< The size of the indexed log file.  An index which does not match is stale.
+      uint64_t m_nRecords {0}; ///< The number of log entries in the file.
+      flatlogs::timespecX m_startTime; ///< The timestamp of the first entry in the file.
+      flatlogs::timespecX m_endTime; ///< The timestamp of the last entry in the file.
+      uint64_t m_nEntries {0}; ///< The number of index entries following the header.
+      uint64_t m_strideBytes {0}; ///< The stride in bytes the index was built with, which bounds the scan after an entry.
+   };
+
+protected:
+
+   /** \name Configurable Parameters
+     *@{
+     */
+   uint64_t m_strideBytes {MAGAOX_default_logIndexStride}; ///< The maximum distance in bytes between index entries for an event code.
+
+   uint32_t m_strideCount {MAGAOX_default_logIndexCount}; ///< The maximum number of occurrences between index entries for an event code.
+   ///@}
+
+   headerT m_header; ///< The header, holding the file bounds.
+
+   std::vector<logIndexEntry> m_entries; ///< The index entries, in file order.
+
+   /// The state of an event code while building.
+   struct codeStateT
+   {
+      uint64_t m_lastIndexed {0}; ///< Offset of the last index entry made for this code.
+      uint32_t m_count {0}; ///< Occurrences since the last index entry.
+      logIndexEntry m_last; ///< The most recent occurrence.
+   };
+
+   std::unordered_map<flatlogs::eventCodeT, codeStateT> m_codeState; ///< Per event code state while building.
+
+   std::unordered_map<flatlogs::eventCodeT, std::vector<size_t>> m_byCode; ///< Positions in m_entries of each event code, for lookups.
+
+public:
+
+   /// Set the maximum distance in bytes between index entries for an event code
+   void strideBytes( uint64_t sb /**< [in] the new stride in bytes */);
+
+   /// Get the maximum distance in bytes between index entries for an event code
+   uint64_t strideBytes() const;
+
+   /// Set the maximum number of occurrences between index entries for an event code
+   void strideCount( uint32_t sc /**< [in] the new stride in occurrences */);
+
+   /// Get the maximum number of occurrences between index entries for an event code
+   uint32_t strideCount();
+
+   /// Get the index file name for a log file
+   static std::string indexName( const std::string & logName /**< [in] the full name of the log file */);
+
+   /// Clear the index, in preparation for a new file.
+   void clear();
+
+   /// Add a log entry while building
+   /** Must be called for every entry in the file, in order.
+     */
+   void add( const flatlogs::timespecX & ts, ///< [in] the timestamp of the entry
+             flatlogs::eventCodeT ec,        ///< [in] the event code of the entry
+             uint64_t offset,                ///< [in] the offset of the entry in the file
+             uint64_t size                   ///< [in] the total size of the entry
+           );
+
+   /// Finish building the index
+   /** Adds the last occurrence of each event code and prepares the index for lookups.
+     */
+   void finish();
+
+   /// Build the index by scanning a log file in memory
+   /** Scanning stops at an incomplete entry at the end of the buffer, as happens when reading a file which
+     * is being written, so fileSize() is the number of bytes of complete entries.
+     *
+     * \returns 0 on success
+     * \returns -1 if the data is corrupt
+     */
+   int build( const char * data, ///< [in] the log file contents
+              size_t size        ///< [in] the size of data
+            );
+
+   /// Write the index to a file
+   /** The file is written to a temporary name and then renamed, so a reader never sees a partial index.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int write( const std::string & fname /**< [in] the index file name*/);
+
+   /// Read the index from a file
+   /**
+     * \returns 0 on success
+     * \returns -1 if the file does not exist, is not a valid index, or does not match fileSize
+     */
+   int read( const std::string & fname, ///< [in] the index file name
+             uint64_t fileSize          ///< [in] the current size of the log file
+           );
+
+   /// Get the size of the indexed log file
+   uint64_t fileSize() const;
+
+   /// Get the number of log entries in the file
+   uint64_t nRecords() const;
+
+   /// Get the timestamp of the first entry in the file
+   flatlogs::timespecX startTime() const;
+
+   /// Get the timestamp of the last entry in the file
+   flatlogs::timespecX endTime() const;
+
+   /// Get the index entries
+   const std::vector<logIndexEntry> & entries() const;
+
+   /// Get the last index entry for an event code with a timestamp before a time
+   /**
+     * \returns a pointer to the entry
+     * \returns nullptr if there is none
+     */
+   const logIndexEntry * prior( flatlogs::eventCodeT ec,       ///< [in] the event code
+                                const flatlogs::timespecX & ts ///< [in] the time to be before
+                              ) const;
+
+   /// Get the first index entry for an event code after an offset
+   /**
+     * \returns a pointer to the entry
+     * \returns nullptr if there is none
+     */
+   const logIndexEntry * next( flatlogs::eventCodeT ec, ///< [in] the event code
+                               uint64_t offset          ///< [in] the offset to be after
+                             ) const;
+
+   /// Get the index entry of the first occurrence of an event code
+   /**
+     * \returns a pointer to the entry
+     * \returns nullptr if the event code is not in the file
+     */
+   const logIndexEntry * first( flatlogs::eventCodeT ec /**< [in] the event code */) const;
+
+   /// Get the index entry of the last occurrence of an event code
+   /**
+     * \returns a pointer to the entry
+     * \returns nullptr if the event code is not in the file
+     */
+   const logIndexEntry * last( flatlogs::eventCodeT ec /**< [in] the event code */) const;
+
+   /// Get an offset from which to scan for the first entry at or after a time
+   /** This is the offset of the last index entry, of any event code, before the time.
+     *
+     * \returns the offset, which is 0 if the time is before the first index entry
+     */
+   uint64_t seek( const flatlogs::timespecX & ts /**< [in] the time */) const;
+
+protected:
+
+   /// Build m_byCode from m_entries.
+   void makeLookup();
+};
+
+} //namespace logger
+} //namespace MagAOX
+
+#endif //logger_logIndex_hpp
@@ -12,11 +12,10 @@
 #define logger_logManager_hpp
 
 #include <memory>
-#include <list>
+#include <vector>
 
 #include <thread>
 
-#include <mutex>
 #include <ratio>
 
 #include <mx/app/appConfigurator.hpp>
@@ -27,6 +26,8 @@ using namespace flatlogs;
 
 #include "../common/defaults.hpp"
 
+#include "logQueue.hpp"
+
 #include "generated/logTypes.hpp"
 #include "generated/logStdFormat.hpp"
 
@@ -38,13 +39,24 @@ namespace logger
 /// The standard MagAOX log manager, used for both process logs and telemetry streams.
 /** Manages the formatting and queueing of the log entries.
   *
-  * A log entry is made using one of the standard log types.  These are formatted into a binary stream and
-  * stored in a std::list.  This occurs in the calling thread.  The insertion into the list is mutex-ed, so
-  * it is safe to make logs from different threads concurrently.
+  * A log entry is made using one of the standard log types.  These are formatted into a binary stream in a
+  * buffer taken from a pre-allocated pool, and pushed onto a bounded lock-free queue (see logQueue).  This occurs
+  * in the calling thread, which neither allocates memory nor takes a lock, so it is safe and cheap to make logs
+  * from different threads concurrently, including RT threads.
+  *
+  * If the queue or the pool is exhausted, the overflow policy applies.  With policy "drop" the entry is discarded
+  * and counted.  With policy "block" (the default) entries with level at or more severe than m_overflowBlockLevel
+  * wait for space while the log thread drains the queue, and less severe entries are dropped and counted.
+  * Entries can only wait once logThreadStart has been called, since until then nothing drains the queue.  So before
+  * the log thread is started, once the queue holds MAGAOX_default_logQueueLength entries (2048 by default) all further
+  * entries are dropped and counted, whatever their level and the policy.  The queued entries are written when the
+  * thread starts, or by the destructor.
   *
   * Write-to-disk occurs in a separate thread, which
   * is normally set to the lowest priority so as not to interfere with higher-priority tasks.  The
-  * log thread cycles through pending log entries in the list, dispatching them to the logFile.
+  * log thread takes all pending log entries from the queue as a batch, dispatches them to the logFile,
+  * and then calls flush() so that the batch is written with as few system calls as possible.  The entry buffers
+  * are returned to the pool only after the flush.
   *
   * The template parameter logFileT is one of the logFile types, which is used to actually write to disk.
   *
@@ -84,10 +96,11 @@ public:
    std::string m_configSection {"logger"}; ///<The configuration files section name.  Default is `logger`.
    
 protected:
-   std::list<bufferPtrT> m_logQueue; ///< Log entries are stored here, and writen to the file by the log thread.
+   logQueue m_logQueue; ///< Log entries are stored here, and writen to the file by the log thread.
+
+   std::vector<logQueueEntry> m_logBatch; ///< The entries being written by the log thread in the current pass.
 
    std::thread m_logThread; ///< A separate thread for actually writing to the file.
-   std::mutex m_qMutex; ///< Mutex for accessing the m_logQueue.
 
    bool m_logShutdown {false}; ///< Flag to signal the log thread to shutdown.
 
@@ -97,6 +110,10 @@ public:
    logPrioT m_logLevel {logPrio::LOG_INFO}; ///< The minimum log level to actually record.  Logs with level below this are rejected. Default is INFO. Configure with logger.logLevel.
 
 protected:
+   bool m_overflowBlock {true}; ///< If true, entries at or above m_overflowBlockLevel wait for space when the queue is full.  Otherwise all are dropped.  Configure with logger.overflowPolicy.
+
+   logPrioT m_overflowBlockLevel {logPrio::LOG_WARNING}; ///< Entries this severe or more will block on overflow if m_overflowBlock is true. Default is WARNING.  Configure with logger.overflowBlockLevel.
+
    int m_logThreadPrio {0};
 
    bool m_logThreadRunning {false};
@@ -167,6 +184,40 @@ public:
    /** \returns the current value of m_logThreadRunning 
      */
    bool logThreadRunning();
+
+   /// Set the overflow policy
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int overflowPolicy( bool block,              ///< [in] if true, entries at or above blockLevel wait for space.  If false all are dropped.
+                       logPrioT blockLevel      ///< [in] the least severe level which will wait for space
+                     );
+
+   /// Get the overflow blocking flag
+   /** \returns the current value of m_overflowBlock
+     */
+   bool overflowBlock();
+
+   /// Get the overflow block level
+   /** \returns the current value of m_overflowBlockLevel
+     */
+   logPrioT overflowBlockLevel();
+
+   /// Get the current number of entries waiting in the queue
+   size_t queueDepth();
+
+   /// Get the largest number of entries seen waiting in the queue
+   size_t queueMaxDepth();
+
+   /// Get the capacity of the queue
+   size_t queueCapacity();
+
+   /// Get the number of entries dropped due to overflow
+   uint64_t queueDropped();
+
+   /// Get the number of entries which waited for space due to overflow
+   uint64_t queueBlocked();
    
    ///Setup an application configurator for the logger section
    int setupConfig( mx::app::appConfigurator & config /**< [in] an application configuration to setup */);
@@ -181,6 +232,11 @@ public:
    static void _logThreadStart( logManager * l /**< [in] a pointer to a logger instance (normally this) */);
 
    /// Start the logger thread.
+   /** Until this is called entries beyond the queue length are dropped, see the overflow policy above.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
    int logThreadStart();
 
    /// Execute the logger thread.
@@ -248,11 +304,22 @@ public:
              logPrioT level = logPrio::LOG_DEFAULT ///< [in] [optional] the log level.  The default is used if not specified.
            );
 
+protected:
+   /// Format a log entry into a pooled buffer and push it onto the queue, applying the overflow policy.
+   /**
+     * \tparam logT is a log entry type
+     */
+   template<typename logT>
+   void queueLog( const timespecX & ts, ///< [in] the timestamp of the log entry
+                  const typename logT::messageT & msg, ///< [in] the message to log
+                  logPrioT level ///< [in] the log level, already resolved from the default
+                );
 };
 
 template<class parentT, class logFileT>
 logManager<parentT, logFileT>::logManager()
 {
+   m_logBatch.resize(m_logQueue.capacity());
 }
 
 template<class parentT, class logFileT>
@@ -263,7 +330,7 @@ logManager<parentT, logFileT>::~logManager()
    if(m_logThread.joinable()) m_logThread.join();
 
    //One last check to see if there are any unwritten logs.
-   if( !m_logQueue.empty() ) logThreadExec();
+   if( m_logQueue.depth() > 0 ) logThreadExec();
 
 }
 
@@ -333,6 +400,61 @@ bool logManager<parentT, logFileT>::logThreadRunning()
    return m_logThreadRunning;
 }
 
+template<class parentT, class logFileT>
+int logManager<parentT, logFileT>::overflowPolicy( bool block,
+                                                   logPrioT blockLevel
+                                                 )
+{
+   if(blockLevel == logPrio::LOG_UNKNOWN || blockLevel == logPrio::LOG_DEFAULT) return -1;
+
+   m_overflowBlock = block;
+   m_overflowBlockLevel = blockLevel;
+
+   return 0;
+}
+
+template<class parentT, class logFileT>
+bool logManager<parentT, logFileT>::overflowBlock()
+{
+   return m_overflowBlock;
+}
+
+template<class parentT, class logFileT>
+logPrioT logManager<parentT, logFileT>::overflowBlockLevel()
+{
+   return m_overflowBlockLevel;
+}
+
+template<class parentT, class logFileT>
+size_t logManager<parentT, logFileT>::queueDepth()
+{
+   return m_logQueue.depth();
+}
+
+template<class parentT, class logFileT>
+size_t logManager<parentT, logFileT>::queueMaxDepth()
+{
+   return m_logQueue.maxDepth();
+}
+
+template<class parentT, class logFileT>
+size_t logManager<parentT, logFileT>::queueCapacity()
+{
+   return m_logQueue.capacity();
+}
+
+template<class parentT, class logFileT>
+uint64_t logManager<parentT, logFileT>::queueDropped()
+{
+   return m_logQueue.dropped();
+}
+
+template<class parentT, class logFileT>
+uint64_t logManager<parentT, logFileT>::queueBlocked()
+{
+   return m_logQueue.blocked();
+}
+
 template<class parentT, class logFileT>
 int logManager<parentT, logFileT>::setupConfig( mx::app::appConfigurator & config )
 {
@@ -342,6 +464,12 @@ int logManager<parentT, logFileT>::setupConfig( mx::app::appConfigurator & confi
    config.add(m_configSection+".writePause","", "writePause",mx::app::argType::Required, m_configSection, "writePause", false, "unsigned long", "The log thread pause time in ns");
    config.add(m_configSection+".logThreadPrio", "", "logThreadPrio", mx::app::argType::Required, m_configSection, "logThreadPrio", false, "int", "The log thread priority");
    config.add(m_configSection+".logLevel","l", "logLevel",mx::app::argType::Required, m_configSection, "logLevel", false, "string", "The log level");
+   config.add(m_configSection+".durability","", "durability",mx::app::argType::Required, m_configSection, "durability", false, "string", "The durability mode: none, interval (fdatasync every syncInterval ms), or bytes (fdatasync every syncBytes bytes).  Default is none.");
+   config.add(m_configSection+".syncInterval","", "syncInterval",mx::app::argType::Required, m_configSection, "syncInterval", false, "unsigned long", "The interval in ms between syncs for durability=interval.  Default is 1000 ms.");
+   config.add(m_configSection+".syncBytes","", "syncBytes",mx::app::argType::Required, m_configSection, "syncBytes", false, "size_t", "The number of bytes between syncs for durability=bytes.  Default is 1 MB.");
+   config.add(m_configSection+".writeIndex","", "writeIndex",mx::app::argType::Required, m_configSection, "writeIndex", false, "bool", "Whether or not to write an index file next to each log file when it is closed.  Default is true.");
+   config.add(m_configSection+".overflowPolicy","", "overflowPolicy",mx::app::argType::Required, m_configSection, "overflowPolicy", false, "string", "What to do when the log queue is full: drop or block.  With block, only entries at or above overflowBlockLevel wait, others are dropped.  Default is block.");
+   config.add(m_configSection+".overflowBlockLevel","", "overflowBlockLevel",mx::app::argType::Required, m_configSection, "overflowBlockLevel", false, "string", "The least severe log level which waits for space when the queue is full.  Default is WARNING.");
 
    return 0;
 }
@@ -385,6 +513,53 @@ int logManager<parentT, logFileT>::loadConfig( mx::app::appConfigurator & config
    //logThreadPrio
    config(m_logThreadPrio, m_configSection+".logThreadPrio");
 
+   //durability
+   tmp = "";
+   config(tmp, m_configSection+".durability");
+   if(tmp != "")
+   {
+      if(this->durability(tmp) < 0)
+      {
+         std::cerr << "Unknown durability specified.  Using default (none)\n";
+         this->durability(logFileT::durabilityNone);
+      }
+   }
+
+   //syncInterval
+   config(this->m_syncInterval, m_configSection+".syncInterval");
+
+   //syncBytes
+   config(this->m_syncBytes, m_configSection+".syncBytes");
+
+   //writeIndex
+   config(this->m_writeIndex, m_configSection+".writeIndex");
+
+   //overflowPolicy
+   tmp = "";
+   config(tmp, m_configSection+".overflowPolicy");
+   if(tmp == "drop") m_overflowBlock = false;
+   else if(tmp == "block") m_overflowBlock = true;
+   else if(tmp != "")
+   {
+      std::cerr << "Unknown overflowPolicy specified.  Using default (block)\n";
+      m_overflowBlock = true;
+   }
+
+   //overflowBlockLevel
+   tmp = "";
+   config(tmp, m_configSection+".overflowBlockLevel");
+   if(tmp != "")
+   {
+      logPrioT lev = logLevelFromString(tmp);
+
+      if( lev == logPrio::LOG_DEFAULT || lev == logPrio::LOG_UNKNOWN )
+      {
+         std::cerr << "Unkown overflowBlockLevel specified.  Using default (WARNING)\n";
+         lev = logPrio::LOG_WARNING;
+      }
+      m_overflowBlockLevel = lev;
+   }
+
    return 0;
 }
 
@@ -397,23 +572,29 @@ void logManager<parentT, logFileT>::_logThreadStart( logManager * l)
 template<class parentT, class logFileT>
 int logManager<parentT, logFileT>::logThreadStart()
 {
+   //Set now so entries made from here on can wait for space, rather than being dropped until the thread is scheduled.
+   m_logThreadRunning = true;
+
    try
    {
       m_logThread = std::thread( _logThreadStart, this);
    }
    catch( const std::exception & e )
    {
+      m_logThreadRunning = false;
       log<software_error>({__FILE__,__LINE__, 0, 0, std::string("Exception on log thread start: ") + e.what()});
       return -1;
    }
    catch( ... )
    {
+      m_logThreadRunning = false;
       log<software_error>({__FILE__,__LINE__, 0, 0, "Unkown exception on log thread start"});
       return -1;
    }
    
    if(!m_logThread.joinable())
    {
+      m_logThreadRunning = false;
       log<software_error>({__FILE__, __LINE__, 0, 0,  "Log thread did not start"});
       return -1;
    }
@@ -440,58 +621,51 @@ void logManager<parentT, logFileT>::logThreadExec()
 
    m_logThreadRunning = true;
    
-   std::unique_lock<std::mutex> lock(m_qMutex, std::defer_lock);
-
-   while(!m_logShutdown || !m_logQueue.empty())
+   while(!m_logShutdown || m_logQueue.depth() > 0)
    {
-      std::list<bufferPtrT>::iterator beg, it, er, end;
+      //We process at most one queue's worth per pass, so that flush happens even if producers keep up.
+      size_t nb = 0;
+      while( nb < m_logBatch.size() && m_logQueue.pop(m_logBatch[nb]) == 0 ) ++nb;
 
-      //Get begin and end once, so we only process logs in the list at this point.
-      //Do it locked so we don't have any collisions with new logs (maybe not necessary)
-      lock.lock();
-      beg = m_logQueue.begin();
-      end = m_logQueue.end();
-      lock.unlock();
-
-      //Note: we're avoiding use of size() since that could be altered concurrently by a push_back.
-      if( beg != end )
+      int rv = 0;
+      for(size_t n = 0; n < nb; ++n)
       {
-         it = beg;
-         while( it != end )
+         //A non-owning shared_ptr (no control block is allocated), the buffer belongs to the pool.
+         bufferPtrT logBuffer(bufferPtrT(), m_logBatch[n].m_buffer);
+
+         //m_logFile.
+         if( this->writeLog( logBuffer ) < 0) 
          {
-            //m_logFile.
-            if( this->writeLog( *it ) < 0) 
-            {
-               m_logThreadRunning = false;
-               return;
-            }
-        
-            if(m_parent)
-            {
-               m_parent->logMessage( *it );
-            }
-            else if( logHeader::logLevel( *it ) <= logPrio::LOG_NOTICE )
-            {
-               logStdFormat(std::cerr, *it);
-               std::cerr << "\n";
-            }
-            
-            er = it;
-            ++it;
-
-            //Erase while locked so we don't collide with a push_back.
-            lock.lock();
-            m_logQueue.erase(er);
-            lock.unlock();
+            rv = -1;
+            break;
+         }
+     
+         if(m_parent)
+         {
+            m_parent->logMessage( logBuffer );
+         }
+         else if( logHeader::logLevel( logBuffer ) <= logPrio::LOG_NOTICE )
+         {
+            logStdFormat(std::cerr, logBuffer);
+            std::cerr << "\n";
          }
       }
 
       //m_logFile.
-      ///\todo must check this for errors, and investigate how `fsyncgate` impacts us
-      this->flush();
+      //Writes the batch, and syncs according to the durability mode.  Sync errors are handled by the logFile.
+      if(rv == 0) rv = this->flush();
+
+      //The buffers can only be returned after the flush.
+      for(size_t n = 0; n < nb; ++n) m_logQueue.release(m_logBatch[n]);
+
+      if(rv < 0)
+      {
+         m_logThreadRunning = false;
+         return;
+      }
 
       //We only pause if there's nothing to do.
-      if(m_logQueue.empty() && !m_logShutdown) std::this_thread::sleep_for( std::chrono::duration<unsigned long, std::nano>(m_writePause));
+      if(m_logQueue.depth() == 0 && !m_logShutdown) std::this_thread::sleep_for( std::chrono::duration<unsigned long, std::nano>(m_writePause));
    }
 
    m_logThreadRunning = false;
@@ -533,15 +707,12 @@ void logManager<parentT, logFileT>::log( const typename logT::messageT & msg,
 
    if(level > m_logLevel) return; // We do nothing with this.
    
-   //Step 1 create log
-   bufferPtrT logBuffer;
-   createLog<logT>(logBuffer, msg, level);
-
-   //Step 2 add log to queue
-   std::lock_guard<std::mutex> guard(m_qMutex);  //Lock the mutex before pushing back.
-   m_logQueue.push_back(logBuffer);
-   
+   //Step 1 get the time
+   timespecX ts;
+   ts.gettime();
 
+   //Step 2 create log and add it to the queue
+   queueLog<logT>(ts, msg, level);
 }
 
 template<class parentT, class logFileT>
@@ -556,14 +727,8 @@ void logManager<parentT, logFileT>::log( timespecX & ts,
 
    if(level > m_logLevel) return; // We do nothing with this.
 
-   //Step 1 create log
-   bufferPtrT logBuffer;
-   createLog<logT>(logBuffer, ts, msg, level);
-
-   //Step 2 add log to queue
-   std::lock_guard<std::mutex> guard(m_qMutex);  //Lock the mutex before pushing back.
-   m_logQueue.push_back(logBuffer);
-
+   //Create log and add it to the queue
+   queueLog<logT>(ts, msg, level);
 }
 
 template<class parentT, class logFileT>
@@ -582,6 +747,57 @@ void logManager<parentT, logFileT>::log( timespecX & ts,
    log<logT>( ts, emptyMessage(), level );
 }
 
+template<class parentT, class logFileT>
+template<typename logT>
+void logManager<parentT, logFileT>::queueLog( const timespecX & ts,
+                                              const typename logT::messageT & msg,
+                                              logPrioT level
+                                            )
+{
+   //We only wait if the log thread is running to drain the queue, otherwise we'd never return.
+   bool canBlock = (m_overflowBlock && level <= m_overflowBlockLevel);
+   bool counted = false;
+
+   msgLenT len = logT::length(msg);
+   size_t N = logHeader::totalSize(len);
+
+   logQueueEntry lqe;
+   while( m_logQueue.acquire(lqe, N) < 0 )
+   {
+      if(!canBlock || !m_logThreadRunning)
+      {
+         m_logQueue.countDropped();
+         return;
+      }
+
+      if(!counted)
+      {
+         m_logQueue.countBlocked();
+         counted = true;
+      }
+      std::this_thread::yield();
+   }
+
+   logHeader::createLog<logT>(lqe.m_buffer, ts, len, msg, level);
+
+   while( m_logQueue.push(lqe) < 0 )
+   {
+      if(!canBlock || !m_logThreadRunning)
+      {
+         m_logQueue.release(lqe);
+         m_logQueue.countDropped();
+         return;
+      }
+
+      if(!counted)
+      {
+         m_logQueue.countBlocked();
+         counted = true;
+      }
+      std::this_thread::yield();
+   }
+}
+
 //class logFileRaw;
 
 //extern template struct logManager<logFileRaw>;
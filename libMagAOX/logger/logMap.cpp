@@ -8,9 +8,7 @@
 
 #include "logMap.hpp"
 
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include <algorithm>
 
 using namespace flatlogs;
 
@@ -18,102 +16,214 @@ namespace MagAOX
 {
 namespace logger
 {
-   
-int logInMemory::loadFile( logFileName const& lfn)
+
+size_t logSeries::prior( const flatlogs::timespecX & ts )
 {
-   int fd = open(lfn.fullName().c_str(), O_RDONLY );
+   size_t N = m_times.size();
+   if(N == 0) return 0;
 
-   off_t fsz = mx::ioutils::fileSize(fd);
-   
-   std::vector<char> memory(fsz);
-   
-   ssize_t nrd = read(fd, memory.data(), memory.size());
-   
-   close(fd);
-   
-   if(nrd != fsz)
+   auto before = [&ts](const flatlogs::timespecX & t){ return t < ts; };
+
+   //Find a range [lo, hi] containing the number of entries before ts, by galloping out from the cursor.
+   size_t c = std::min(m_cursor, N-1);
+   size_t lo, hi;
+   size_t step = 1;
+   if(m_times[c] < ts)
    {
-      std::cerr << __FILE__ << " " << __LINE__ << " logInMemory::loadFile(" << lfn.fullName() << ") did not read all bytes\n";
-      return -1;
+      lo = c + 1;
+      while(lo + step - 1 < N && m_times[lo + step - 1] < ts)
+      {
+         lo += step;
+         step *= 2;
+      }
+      hi = std::min(lo + step - 1, N);
    }
-   
-   flatlogs::timespecX startTime = logHeader::timespec(memory.data());
-   
-   size_t st=0;
-   size_t ed = logHeader::totalSize(memory.data());
-   st = ed;
-   
-   while(st < memory.size())
+   else
    {
-      ed = logHeader::totalSize(memory.data()+st);
-      st = st + ed;
+      hi = c;
+      while(hi >= step && !(m_times[hi - step] < ts))
+      {
+         hi -= step;
+         step *= 2;
+      }
+      lo = (hi >= step) ? hi - step + 1 : 0;
    }
-   
-   if(st != memory.size())
+
+   size_t p = std::partition_point(m_times.begin() + lo, m_times.begin() + hi, before) - m_times.begin();
+
+   //If none are before, the first entry is the closest we can do.
+   m_cursor = (p > 0) ? p - 1 : 0;
+
+   return m_cursor;
+}
+
+long logSeries::find( const char * logEntry )
+{
+   size_t N = m_entries.size();
+
+   //Usually it is the last one found, or next to it.
+   for(size_t n = (m_cursor > 0) ? m_cursor - 1 : 0; n < N && n < m_cursor + 2; ++n)
    {
-      std::cerr <<  __FILE__ << " " << __LINE__ << " Possibly corrupt logfile.\n";
-      return -1;
+      if(m_entries[n] == logEntry)
+      {
+         m_cursor = n;
+         return n;
+      }
    }
-   
-   st -= ed;
-   
-   flatlogs::timespecX endTime = logHeader::timespec(memory.data()+st);
-   
-   if(m_memory.size() == 0)
+
+   flatlogs::timespecX ts = logHeader::timespec(const_cast<char *>(logEntry));
+   for(size_t n = std::lower_bound(m_times.begin(), m_times.end(), ts) - m_times.begin(); n < N && !(ts < m_times[n]); ++n)
    {
-      m_memory.swap(memory);
-      m_startTime = startTime;
-      m_endTime = endTime;
+      if(m_entries[n] == logEntry)
+      {
+         m_cursor = n;
+         return n;
+      }
+   }
 
-      std::string timestamp;   
-      timespec ts{ endTime.time_s, endTime.time_ns};
-      mx::sys::timeStamp(timestamp, ts);
+   return -1;
+}
+
+size_t logSeries::insert( size_t at,
+                          const logMappedFile & lmf,
+                          flatlogs::eventCodeT ev
+                        )
+{
+   std::vector<char *> entries;
+   std::vector<flatlogs::timespecX> times;
 
+   char * buffer = lmf.first(ev);
+   while(buffer)
+   {
+      entries.push_back(buffer);
+      times.push_back(logHeader::timespec(buffer));
+      buffer = lmf.next(buffer);
+   }
+
+   if(entries.size() == 0) return 0;
+
+   if(at <= m_cursor && at < m_entries.size()) m_cursor += entries.size();
+
+   m_entries.insert(m_entries.begin() + at, entries.begin(), entries.end());
+   m_times.insert(m_times.begin() + at, times.begin(), times.end());
+
+   return entries.size();
+}
+
+int logInMemory::loadFile( logFileName const& lfn)
+{
+   std::unique_ptr<logMappedFile> lmf(new logMappedFile);
+
+   if(lmf->open(lfn.fullName()) < 0)
+   {
+      std::cerr << __FILE__ << " " << __LINE__ << " logInMemory::loadFile(" << lfn.fullName() << ") could not map file\n";
+      return -1;
+   }
+
+   if(lmf->index().nRecords() == 0)
+   {
       #ifdef DEBUG
-      std::cerr << __FILE__ << " " << __LINE__ << " loading: " << lfn.fullName() << " " << timestamp << "\n";
+      std::cerr << __FILE__ << " " << __LINE__ << " skipping empty file: " << lfn.fullName() << "\n";
       #endif
-
       return 0;
    }
-   
-   if(startTime < m_startTime)
+
+   flatlogs::timespecX startTime = lmf->startTime();
+   flatlogs::timespecX endTime = lmf->endTime();
+
+   #ifdef DEBUG
+   std::string timestamp;
+   timespec ts{ endTime.time_s, endTime.time_ns};
+   mx::sys::timeStamp(timestamp, ts);
+   std::cerr << __FILE__ << " " << __LINE__ << " loading: " << lfn.fullName() << " " << timestamp << "\n";
+   #endif
+
+   //Find where it goes.  The mapped data does not move, so pointers into other files stay valid.
+   size_t pos = 0;
+   while(pos < m_files.size() && m_files[pos]->startTime() < startTime) ++pos;
+
+   if( (pos > 0 && m_files[pos-1]->endTime() > startTime) || (pos < m_files.size() && endTime > m_files[pos]->startTime()) )
+   {
+      std::cerr <<  __FILE__ << " " << __LINE__ << " overlapping log files!\n";
+      return -1;
+   }
+
+   m_files.insert(m_files.begin() + pos, std::move(lmf));
+
+   //Add the new file to the series already built.  The files do not overlap, so its entries go in one place,
+   //after the last entry of the files before it.
+   for(auto & it : m_series)
    {
-      
-      if(endTime >= m_startTime)
+      logSeries & ls = it.second;
+
+      size_t at = 0;
+      for(size_t n = pos; n > 0; --n)
       {
-         std::cerr <<  __FILE__ << " " << __LINE__ << " overlapping log files!\n";
-         return -1;
+         char * last = m_files[n-1]->last(it.first);
+         if(last == nullptr) continue;
+
+         size_t cursor = ls.m_cursor;
+         at = ls.find(last) + 1;
+         ls.m_cursor = cursor;
+         break;
       }
-      
-      m_memory.insert(m_memory.begin(), memory.begin(), memory.end());
-      m_startTime = startTime;
-      std::cerr <<  __FILE__ << " " << __LINE__ << " added before!\n";
-      return 0;
+
+      ls.insert(at, *m_files[pos], it.first);
    }
-   
-   if(startTime > m_endTime)
+
+   m_startTime = m_files.front()->startTime();
+   m_endTime = m_files.back()->endTime();
+
+   return 0;
+}
+
+bool logInMemory::isLoaded( logFileName const& lfn )
+{
+   for(size_t n = 0; n < m_files.size(); ++n)
    {
-      #ifdef DEBUG
-      std::cerr <<  __FILE__ << " " << __LINE__ << " gonna append\n";
-      #endif
+      if(m_files[n]->fileName() == lfn.fullName()) return true;
+   }
 
-      m_memory.insert(m_memory.end(), memory.begin(), memory.end());
-      m_endTime = endTime;
-      
-      #ifdef DEBUG
-      std::cerr <<  __FILE__ << " " << __LINE__ << " added after!\n";
-      #endif
-      
-      return 0;
+   return false;
+}
+
+int logInMemory::fileBefore( const flatlogs::timespecX & ts )
+{
+   if(m_files.size() == 0) return -1;
+
+   //first file which does not start before ts
+   auto it = std::lower_bound(m_files.begin(), m_files.end(), ts, [](const std::unique_ptr<logMappedFile> & f, const flatlogs::timespecX & t){ return f->startTime() < t; });
+
+   if(it == m_files.begin()) return 0;
+
+   return (it - m_files.begin()) - 1;
+}
+
+int logInMemory::fileOf( const char * logEntry )
+{
+   for(size_t n = 0; n < m_files.size(); ++n)
+   {
+      if(m_files[n]->contains(logEntry)) return n;
    }
-   
-   std::cerr <<  __FILE__ << " " << __LINE__ << " Need to implement insert in the middle!\n";
-   std::cerr << m_startTime.time_s << " " << m_startTime.time_ns << "\n";
-   std::cerr << startTime.time_s << " " << startTime.time_ns << "\n";
-   
+
    return -1;
 }
 
+logSeries & logInMemory::series( flatlogs::eventCodeT ev )
+{
+   auto it = m_series.find(ev);
+   if(it != m_series.end()) return it->second;
+
+   logSeries & ls = m_series[ev];
+
+   for(size_t n = 0; n < m_files.size(); ++n)
+   {
+      ls.insert(ls.m_entries.size(), *m_files[n], ev);
+   }
+
+   return ls;
+}
+
 int logMap::loadAppToFileMap( const std::string & dir,
                               const std::string & ext
                             )
@@ -139,161 +249,123 @@ int logMap::getPriorLog( char * &logBefore,
                          char * hint
                        )
 {
-   flatlogs::eventCodeT evL;
-   
-   #ifdef DEBUG
-   std::cerr << __FILE__ << " " << __LINE__ << "\n";
-   #endif
+   static_cast<void>(hint);
 
    if(m_appToFileMap[appName].size() == 0)
    {
       std::cerr << __FILE__ << " " << __LINE__ << " getPriorLog empty map\n";
       return -1;
    }
-   
-   #ifdef DEBUG
-   std::cerr << __FILE__ << " " << __LINE__ << "\n";
-   #endif
 
    logInMemory & lim = m_appToBufferMap[appName];
-   
+
    flatlogs::timespecX et = lim.m_endTime;
    et.time_s += 30;
-   if(lim.m_startTime > ts || et < ts)
+   if(lim.m_files.size() == 0 || lim.m_startTime > ts || et < ts)
    {
-      #ifdef DEBUG
-      std::cerr << __FILE__ << " " << __LINE__ << "\n";
-      #endif
-
       if(loadFiles(appName, ts) < 0)
       {
          std::cerr << __FILE__ << " " << __LINE__ << " error returned from loadfiles\n";
          return -1;
       }
    }
-   
-   char* buffer, *priorBuffer;
-   
-   if(hint) 
-   {
-      if(logHeader::timespec(hint) <= ts) buffer = hint;
-      else buffer = lim.m_memory.data();
-   }
-      
-   else buffer = lim.m_memory.data();
-   
-   priorBuffer = buffer;
-   evL = logHeader::eventCode(buffer);
-   
-   while(evL != ev)
+
+   if(lim.m_files.size() == 0)
    {
-      priorBuffer = buffer;
-      buffer += logHeader::totalSize(buffer);
-      if(buffer >=lim.m_memory.data() + lim.m_memory.size()) break;
-      evL = logHeader::eventCode(buffer);
+      std::cerr << __FILE__ << " " << __LINE__ << " no files loaded for " << appName << "\n";
+      return -1;
    }
-   
-   if(evL != ev)
+
+   //If there isn't an entry before ts, the first entry is the closest we can do.
+   logSeries & ls = lim.series(ev);
+   if(ls.m_entries.size() == 0)
    {
       std::cerr <<  __FILE__ << " " << __LINE__ << " Event code not found.\n";
       return -1;
    }
-   
-   if( logHeader::timespec(buffer) < ts )
+
+   char * buffer = ls.m_entries[ls.prior(ts)];
+
+   //Make sure the prior log is bracketed by a following log.
+   char * after;
+   int rv = getNextLog(after, buffer, appName);
+   if(rv != 0)
    {
-      while( logHeader::timespec(buffer) < ts ) //Loop until buffer is after the timestamp we want
-      {
-         if(buffer >lim.m_memory.data() +lim.m_memory.size()) 
-         {
-            std::cerr << __FILE__ << " " << __LINE__ << " attempt to read too mach data, possible log corruption.\n";
-            return -1;
-         }
-         
-         if(buffer ==lim.m_memory.data() +lim.m_memory.size()) 
-         {
-            std::cerr << __FILE__ << " " << __LINE__ << " did not find following log for " << appName << " -- need to load more data.\n";
-            //Proper action here is to load the next file if possible...
-            return 1;
-         }
-         
-         priorBuffer = buffer;
-         
-         buffer += logHeader::totalSize(buffer);
-         
-         evL = logHeader::eventCode(buffer);
-         
-         while(evL != ev) //Find the next log with the event code we want.
-         {
-            if(buffer >lim.m_memory.data() + lim.m_memory.size()) 
-            {
-               std::cerr << __FILE__ << " " << __LINE__ << " attempt to read too mach data, possible log corruption.\n";
-               return -1;
-            }
-            
-            if(buffer ==lim.m_memory.data() + lim.m_memory.size()) 
-            {
-               std::cerr << __FILE__ << " " << __LINE__ << " did not find following log for " << appName << " -- need to load more data.\n";
-               //Proper action here is to load the next file if possible...
-               return 1;
-            }
-            
-            buffer += logHeader::totalSize(buffer);
-            evL = logHeader::eventCode(buffer);
-         }
-      }
-      
+      if(rv > 0) std::cerr << __FILE__ << " " << __LINE__ << " did not find following log for " << appName << "\n";
+      return rv;
    }
-   
-   logBefore = priorBuffer;
-   
+
+   logBefore = buffer;
+
    return 0;
 }//getPriorLog
 
-int logMap::getNextLog( char * &logAfter,            
-                        char * logCurrent,           
+int logMap::getNextLog( char * &logAfter,
+                        char * logCurrent,
                         const std::string & appName
                       )
 {
-   flatlogs::eventCodeT ev, evL;
-   
    logInMemory & lim = m_appToBufferMap[appName];
-   
-   char* buffer;
-   
-   ev = logHeader::eventCode(logCurrent);
-   
-   buffer = logCurrent;
-   
-   buffer += logHeader::totalSize(buffer);
-   if(buffer >= lim.m_memory.data() + lim.m_memory.size())
-   {
-      std::cerr << __FILE__ << " " << __LINE__ << " Reached end of data for " << appName << " -- need to load more data\n";
-      //propoer action is to load the next file if possible.
-      return 1;
-   }
-      
-   evL = logHeader::eventCode(buffer);
-   
-   while(evL != ev)
+
+   flatlogs::eventCodeT ev = logHeader::eventCode(logCurrent);
+
+   //The next entry in the series, unless the current one is the last loaded.
+   auto sit = lim.m_series.find(ev);
+   if(sit != lim.m_series.end())
    {
-      buffer += logHeader::totalSize(buffer);
-      if(buffer >= lim.m_memory.data() + lim.m_memory.size())
+      logSeries & ls = sit->second;
+      long pos = ls.find(logCurrent);
+      if(pos >= 0 && pos + 1 < (long) ls.m_entries.size())
       {
-         std::cerr << __FILE__ << " " << __LINE__ << " Reached end of data for " << appName << "-- need to load more data\n";
-         //propoer action is to load the next file if possible.
-         return 1;
+         ls.m_cursor = pos + 1;
+         logAfter = ls.m_entries[pos + 1];
+         return 0;
       }
-      evL = logHeader::eventCode(buffer);
    }
-   
-   if(evL != ev)
+
+   int fno = lim.fileOf(logCurrent);
+   if(fno < 0)
    {
-      std::cerr << "Event code not found.\n";
+      std::cerr << __FILE__ << " " << __LINE__ << " log is not in loaded data for " << appName << "\n";
       return -1;
    }
-   
+
+   char * buffer = lim.m_files[fno]->next(logCurrent);
+
+   //Continue into later files, loading them as needed.
+   while(buffer == nullptr)
+   {
+      ++fno;
+
+      if(fno >= (int) lim.m_files.size())
+      {
+         auto it = m_appToFileMap[appName].upper_bound(logFileName(lim.m_files.back()->fileName()));
+         if(it == m_appToFileMap[appName].end())
+         {
+            std::cerr << __FILE__ << " " << __LINE__ << " Reached end of data for " << appName << "\n";
+            return 1;
+         }
+
+         size_t nfiles = lim.m_files.size();
+         if(lim.loadFile(*it) < 0) return -1;
+
+         //An empty file is skipped without being added, so step past it by name.
+         while(lim.m_files.size() == nfiles)
+         {
+            if(++it == m_appToFileMap[appName].end())
+            {
+               std::cerr << __FILE__ << " " << __LINE__ << " Reached end of data for " << appName << "\n";
+               return 1;
+            }
+            if(lim.loadFile(*it) < 0) return -1;
+         }
+      }
+
+      buffer = lim.m_files[fno]->first(ev);
+   }
+
    logAfter = buffer;
-   
+
    return 0;
 }
 
@@ -308,128 +380,39 @@ int logMap::loadFiles( const std::string & appName,
       std::cerr << "*************************************\n\n";
       return -1;
    }
- 
-   #ifdef DEBUG
-   std::cerr << __FILE__ << " " << __LINE__ << "\n";
-   #endif
 
-   //First check if already loaded files cover this time
-   if(m_appToBufferMap[appName].m_memory.size() > 0)
-   {
-      if( m_appToBufferMap[appName].m_startTime <= startTime && m_appToBufferMap[appName].m_endTime >= startTime) 
-      {
-         std::cerr << "good!\n";
-         return 0;
-      }
-      
-      #ifdef DEBUG
-      std::cerr << __FILE__ << " " << __LINE__ << "\n";
-      #endif
-
-      if( m_appToBufferMap[appName].m_startTime > startTime ) // Files don't go back far enough
-      {
-         #ifdef DEBUG
-         std::cerr << __FILE__ << " " << __LINE__ << "\n";
-         #endif
-
-         auto last = m_appToFileMap[appName].begin();
-         while( last->timestamp() < m_appToBufferMap[appName].m_startTime)
-         {
-            ++last;
-            if(last == m_appToFileMap[appName].end()) break;
-         }
-         //Now last is the last file to open in the for loop sense.
-         auto first = last;
-         
-         while( first->timestamp() > startTime)
-         {
-            --first;
-            if(first == m_appToFileMap[appName].begin()) break;
-         }
-         
-         //Now open each of these files, in reverse
-         std::cerr << "open earlier files!\n";
-         --last;
-         --first;
-         for(auto it=last; it != first; --it)
-         {
-            m_appToBufferMap[appName].loadFile(*it);
-         }
-         
-         return 0;
-      }
-      else
-      {
-         auto first = m_appToFileMap[appName].end();
-         --first;
-         
-         while( first->timestamp() > m_appToBufferMap[appName].m_endTime)
-         {
-            --first;
-            if(first == m_appToFileMap[appName].begin()) break;
-         }
-         ++first;
-         auto last = first;
-         while( last->timestamp() < startTime)
-         {
-            ++last;
-            if(last == m_appToFileMap[appName].end()) break;
-         }
-         
-         //Now open each of these files
-         std::cerr << "open later file for " << appName << "!\n";
-         for(auto it=first; it != last; ++it)
-         {
-            m_appToBufferMap[appName].loadFile(*it);
-         }
-         return 0;
-      }
-      
-   }
- 
-   #ifdef DEBUG
-   std::cerr << __FILE__ << " " << __LINE__ << "\n";
-   #endif
+   std::set<logFileName, compLogFileName> & files = m_appToFileMap[appName];
 
-   auto before = m_appToFileMap[appName].begin();
-   
-   for(; before != m_appToFileMap[appName].end(); ++before)
+   //Find the last file which starts before the time
+   auto before = files.end();
+   for(auto it = files.begin(); it != files.end(); ++it)
    {
-      if( !(before->timestamp() < startTime) )
-      {
-         break;
-      }
+      if( !(it->timestamp() < startTime) ) break;
+      before = it;
    }
 
-   #ifdef debug
-   std::cerr << __FILE__ << " " << __LINE__ << "\n";
-   #endif
-
-   if(before == m_appToFileMap[appName].begin())
+   if(before == files.end())
    {
       std::cerr << "No files in range for " << appName << "\n";
+      before = files.begin();
    }
-   --before;
-   
-   #ifdef DEBUG 
-   std::cerr << __FILE__ << " " << __LINE__ << "\n";
-   #endif
 
-   m_appToBufferMap.emplace(std::pair<std::string, logInMemory>(appName, logInMemory()));
-   
-   #ifdef DEBUG
-   std::cerr << __FILE__ << " " << __LINE__ << "\n";
-   #endif
+   //Mapping is cheap, so load the neighbors too in case the entries we want are across a file boundary.
+   auto first = before;
+   if(first != files.begin()) --first;
 
-   m_appToBufferMap[appName].loadFile(*before);
-   if(++before != m_appToFileMap[appName].end()) 
+   auto last = before;
+   ++last;
+   if(last != files.end()) ++last;
+
+   logInMemory & lim = m_appToBufferMap[appName];
+
+   for(auto it = first; it != last; ++it)
    {
-      m_appToBufferMap[appName].loadFile(*before);
+      if(lim.isLoaded(*it)) continue;
+
+      if(lim.loadFile(*it) < 0) return -1;
    }
-   
-   #ifdef DEBUG
-   std::cerr << __FILE__ << " " << __LINE__ << "\n";
-   #endif
 
    return 0;
 }
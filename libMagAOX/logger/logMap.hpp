@@ -18,25 +18,87 @@ using namespace mx::sys::tscomp;
 
 #include <vector>
 #include <map>
+#include <memory>
 
 #include <flatlogs/flatlogs.hpp>
 #include "logFileName.hpp"
+#include "logMappedFile.hpp"
 
 namespace MagAOX
 {
 namespace logger
 {
 
-/// Structure to hold a log file in memory, tracking when a new file needs to be opened.
+/// The entries of one event code of an application, in time order.
+/** Lookups are usually made at increasing times, e.g. for each frame of an archive, so each search starts from
+  * the position of the last one and gallops out from there.  A sequence of lookups is then a merge of the
+  * lookup times with the entries, rather than a separate search for each.
+  */
+struct logSeries
+{
+   std::vector<char *> m_entries; ///< The entries, in time order.
+   std::vector<flatlogs::timespecX> m_times; ///< The time of each entry, so searches don't touch the mapped files.
+   size_t m_cursor {0}; ///< The position of the last entry found.
+
+   /// Get the position of the last entry before a time
+   /**
+     * \returns the position, which is 0 if no entry is before the time
+     */
+   size_t prior( const flatlogs::timespecX & ts /**< [in] the time */);
+
+   /// Get the position of an entry
+   /**
+     * \returns the position
+     * \returns -1 if the entry is not in the series
+     */
+   long find( const char * logEntry /**< [in] the entry */);
+
+   /// Insert the entries of an event code in a file
+   /** The cursor stays on the same entry.
+     *
+     * \returns the number of entries inserted
+     */
+   size_t insert( size_t at,                  ///< [in] the position to insert at, which must keep the series in time order
+                  const logMappedFile & lmf,  ///< [in] the file
+                  flatlogs::eventCodeT ev     ///< [in] the event code
+                );
+};
+
+/// Structure to hold the log files of an application in memory, tracking when a new file needs to be opened.
+/** Each file is memory-mapped with its index (see logMappedFile), so loading a file does not copy it and
+  * adding an earlier or later file does not move the ones already loaded.
+  */
 struct logInMemory
 {
-   std::vector<char> m_memory; ///< The buffer holding the log.
-   
+   std::vector<std::unique_ptr<logMappedFile>> m_files; ///< The loaded files, in time order.
+
+   std::map<flatlogs::eventCodeT, logSeries> m_series; ///< The series of each event code looked up.  Extended with each file loaded.
+
    flatlogs::timespecX m_startTime {0,0};
    flatlogs::timespecX m_endTime{0,0};
-   
+
    int loadFile( logFileName const& lfn);
 
+   /// Check if a file has already been loaded
+   bool isLoaded( logFileName const& lfn );
+
+   /// Get the position in m_files of the last file which starts before a time
+   /**
+     * \returns the position, which is 0 if no file starts before the time
+     * \returns -1 if no files are loaded
+     */
+   int fileBefore( const flatlogs::timespecX & ts /**< [in] the time */);
+
+   /// Get the position in m_files of the file containing a log entry
+   /**
+     * \returns the position
+     * \returns -1 if the entry is not in a loaded file
+     */
+   int fileOf( const char * logEntry /**< [in] a pointer to the log entry */);
+
+   /// Get the series of an event code in the loaded files, building it if needed
+   logSeries & series( flatlogs::eventCodeT ev /**< [in] the event code */);
+
 };
 
 /// Map of log entries by application name, mapping both to files and to loaded buffers.
@@ -58,14 +120,27 @@ struct logMap
                        );
 
    ///Get the log for an event code which is the first prior to the supplied time
+   /** The search is in the logSeries of the event code, starting from the last entry found, so lookups at
+     * increasing times cost little more than stepping through the entries.
+     *
+     * \returns 0 on success
+     * \returns 1 if there is no following log with the event code, so more data needs to be loaded
+     * \returns -1 on error
+     */
    int getPriorLog( char * &logBefore,           ///< [out] pointer to the first byte of the prior log entry
                     const std::string & appName, ///< [in] the name of the app specifying which log to search
                     const flatlogs::eventCodeT & ev,       ///< [in] the event code to search for
                     const flatlogs::timespecX & ts,        ///< [in] the timestamp to be prior to
-                    char * hint = 0              ///< [in] [optional] a hint specifying where to start searching.  If null search starts at beginning. 
+                    char * hint = 0              ///< [in] [optional] unused, retained for compatibility.
                   );
    
    ///Get the next log with the same event code which is after the supplied time
+   /** Continues into the next loaded file if needed.
+     *
+     * \returns 0 on success
+     * \returns 1 if there is no following log with the event code, so more data needs to be loaded
+     * \returns -1 on error
+     */
    int getNextLog( char * &logAfter,            ///< [out] pointer to the first byte of the prior log entry
                    char * logCurrent,           ///< [in] The log to start from
                    const std::string & appName  ///< [in] the name of the app specifying which log to search
@@ -76,8 +151,14 @@ struct logMap
                        const std::string & appName
                      );
                        
+   /// Load the files for an app around a time
+   /** Loads the file containing the time, and the files before and after it.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
    int loadFiles( const std::string & appName, ///< MagAO-X app name for which to load files
-                  const flatlogs::timespecX & startTime  ///<
+                  const flatlogs::timespecX & startTime  ///< the time to load files for
                 );
 
    
@@ -0,0 +1,237 @@
+/** \file logMappedFile.cpp
+  * \brief A memory-mapped binary log file with its index.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * \ingroup logger_files
+  *
+  */
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "logMappedFile.hpp"
+
+using namespace flatlogs;
+
+namespace MagAOX
+{
+namespace logger
+{
+
+logMappedFile::logMappedFile()
+{
+}
+
+logMappedFile::~logMappedFile()
+{
+   close();
+}
+
+int logMappedFile::open( const std::string & fname,
+                         bool useIndexFile
+                       )
+{
+   close();
+
+   int fd = ::open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+   if(fd < 0)
+   {
+      std::cerr << "logMappedFile::open: Error by open. At: " << __FILE__ << " " << __LINE__ << "\n";
+      std::cerr << "logMappedFile::open: errno says: " << strerror(errno) << "\n";
+      std::cerr << "logMappedFile::open: fname = " << fname << "\n";
+      return -1;
+   }
+
+   struct stat st;
+   if(fstat(fd, &st) < 0)
+   {
+      std::cerr << "logMappedFile::open: Error by fstat. At: " << __FILE__ << " " << __LINE__ << "\n";
+      std::cerr << "logMappedFile::open: errno says: " << strerror(errno) << "\n";
+      ::close(fd);
+      return -1;
+   }
+
+   m_fileName = fname;
+   m_mapSize = st.st_size;
+
+   if(m_mapSize > 0)
+   {
+      void * addr = mmap(nullptr, m_mapSize, PROT_READ, MAP_SHARED, fd, 0);
+      if(addr == MAP_FAILED)
+      {
+         std::cerr << "logMappedFile::open: Error by mmap. At: " << __FILE__ << " " << __LINE__ << "\n";
+         std::cerr << "logMappedFile::open: errno says: " << strerror(errno) << "\n";
+         std::cerr << "logMappedFile::open: fname = " << fname << "\n";
+         ::close(fd);
+         m_mapSize = 0;
+         return -1;
+      }
+
+      m_data = static_cast<char *>(addr);
+   }
+
+   //The mapping stays valid after the descriptor is closed.
+   ::close(fd);
+
+   if(useIndexFile && m_index.read(logIndex::indexName(fname), m_mapSize) == 0)
+   {
+      m_size = m_index.fileSize();
+      return 0;
+   }
+
+   //No current index, so scan the file.  This touches every page, so tell the kernel.
+   if(m_data) madvise(m_data, m_mapSize, MADV_SEQUENTIAL);
+
+   if(m_index.build(m_data, m_mapSize) < 0)
+   {
+      std::cerr << "logMappedFile::open: Error building index. At: " << __FILE__ << " " << __LINE__ << "\n";
+      std::cerr << "logMappedFile::open: fname = " << fname << "\n";
+      close();
+      return -1;
+   }
+
+   if(m_data) madvise(m_data, m_mapSize, MADV_NORMAL);
+
+   m_size = m_index.fileSize();
+
+   return 0;
+}
+
+void logMappedFile::close()
+{
+   if(m_data) munmap(m_data, m_mapSize);
+
+   m_data = nullptr;
+   m_mapSize = 0;
+   m_size = 0;
+   m_index.clear();
+}
+
+std::string logMappedFile::fileName() const
+{
+   return m_fileName;
+}
+
+char * logMappedFile::data() const
+{
+   return m_data;
+}
+
+size_t logMappedFile::size() const
+{
+   return m_size;
+}
+
+char * logMappedFile::end() const
+{
+   return m_data + m_size;
+}
+
+const logIndex & logMappedFile::index() const
+{
+   return m_index;
+}
+
+timespecX logMappedFile::startTime() const
+{
+   return m_index.startTime();
+}
+
+timespecX logMappedFile::endTime() const
+{
+   return m_index.endTime();
+}
+
+bool logMappedFile::contains( const char * logEntry ) const
+{
+   return (m_data != nullptr && logEntry >= m_data && logEntry < m_data + m_size);
+}
+
+char * logMappedFile::prior( eventCodeT ev,
+                             const timespecX & ts
+                           ) const
+{
+   const logIndexEntry * ie = m_index.prior(ev, ts);
+   if(ie == nullptr) return nullptr;
+
+   //The answer is between this index entry and the next one for this code, which is not before ts.
+   //An occurrence at least the stride past this index entry would have been indexed, so the scan stops there.
+   char * best = m_data + ie->m_offset;
+
+   const logIndexEntry * ne = m_index.next(ev, ie->m_offset);
+   char * stop = (ne) ? m_data + ne->m_offset : end();
+   if(m_index.strideBytes() < (uint64_t) (stop - best)) stop = best + m_index.strideBytes();
+
+   char * buffer = best + logHeader::totalSize(best);
+   while(buffer < stop)
+   {
+      if( !(logHeader::timespec(buffer) < ts) ) break;
+
+      if(logHeader::eventCode(buffer) == ev) best = buffer;
+
+      buffer += logHeader::totalSize(buffer);
+   }
+
+   return best;
+}
+
+char * logMappedFile::next( char * logCurrent ) const
+{
+   if(!contains(logCurrent)) return nullptr;
+
+   eventCodeT ev = logHeader::eventCode(logCurrent);
+
+   const logIndexEntry * ne = m_index.next(ev, logCurrent - m_data);
+   char * stop = (ne) ? m_data + ne->m_offset : end();
+
+   char * buffer = logCurrent + logHeader::totalSize(logCurrent);
+   while(buffer < stop)
+   {
+      if(logHeader::eventCode(buffer) == ev) return buffer;
+
+      buffer += logHeader::totalSize(buffer);
+   }
+
+   if(ne) return stop;
+
+   return nullptr;
+}
+
+char * logMappedFile::first( eventCodeT ev ) const
+{
+   const logIndexEntry * ie = m_index.first(ev);
+   if(ie == nullptr) return nullptr;
+
+   return m_data + ie->m_offset;
+}
+
+char * logMappedFile::last( eventCodeT ev ) const
+{
+   const logIndexEntry * ie = m_index.last(ev);
+   if(ie == nullptr) return nullptr;
+
+   return m_data + ie->m_offset;
+}
+
+char * logMappedFile::seek( const timespecX & ts ) const
+{
+   char * buffer = m_data + m_index.seek(ts);
+
+   while(buffer < end())
+   {
+      if( !(logHeader::timespec(buffer) < ts) ) break;
+
+      buffer += logHeader::totalSize(buffer);
+   }
+
+   return buffer;
+}
+
+} //namespace logger
+} //namespace MagAOX
@@ -0,0 +1,138 @@
+/** \file logMappedFile.hpp
+  * \brief A memory-mapped binary log file with its index.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * \ingroup logger_files
+  *
+  * History:
+  * - 2026-10-17 created
+  */
+
+#ifndef logger_logMappedFile_hpp
+#define logger_logMappedFile_hpp
+
+#include <string>
+
+#include <flatlogs/flatlogs.hpp>
+
+#include "logIndex.hpp"
+
+namespace MagAOX
+{
+namespace logger
+{
+
+/// A binary log file mapped read-only into memory, with its index.
+/** The file is mapped with `mmap`, so opening it costs nothing until the pages are touched, and the entries
+  * are accessed in place without copying.  The index is read from the sidecar index file if present and
+  * current, and otherwise built by scanning the file.
+  *
+  * A file which is still being written can be opened, in which case only the complete entries present when
+  * it was opened are visible, and size() does not include a partial entry at the end.
+  *
+  * \ingroup logger
+  */
+class logMappedFile
+{
+protected:
+   std::string m_fileName; ///< The full name of the log file.
+
+   char * m_data {nullptr}; ///< The start of the mapping.
+
+   size_t m_mapSize {0}; ///< The size of the mapping.
+
+   size_t m_size {0}; ///< The number of bytes of complete entries in the file.
+
+   logIndex m_index; ///< The index of the file.
+
+public:
+
+   /// Default c'tor
+   logMappedFile();
+
+   /// Destructor.  Unmaps the file.
+   ~logMappedFile();
+
+   logMappedFile( const logMappedFile & ) = delete;
+   logMappedFile & operator=( const logMappedFile & ) = delete;
+
+   /// Map a log file and load its index
+   /** Any previously mapped file is unmapped.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int open( const std::string & fname,  ///< [in] the full name of the log file
+             bool useIndexFile = true    ///< [in] [optional] if false, the index file is ignored and the index is always built.
+           );
+
+   /// Unmap the file.
+   void close();
+
+   /// Get the full name of the log file
+   std::string fileName() const;
+
+   /// Get a pointer to the first entry
+   char * data() const;
+
+   /// Get the number of bytes of complete entries
+   size_t size() const;
+
+   /// Get a pointer to one past the last complete entry
+   char * end() const;
+
+   /// Get the index
+   const logIndex & index() const;
+
+   /// Get the timestamp of the first entry
+   flatlogs::timespecX startTime() const;
+
+   /// Get the timestamp of the last entry
+   flatlogs::timespecX endTime() const;
+
+   /// Check if a pointer is to an entry in this file
+   bool contains( const char * logEntry /**< [in] the pointer to check */) const;
+
+   /// Get the last entry with an event code which is before a time
+   /** A lookup in the index followed by a scan of at most the index stride in bytes.
+     *
+     * \returns a pointer to the entry
+     * \returns nullptr if there is no such entry in this file
+     */
+   char * prior( flatlogs::eventCodeT ev,       ///< [in] the event code
+                 const flatlogs::timespecX & ts ///< [in] the time to be before
+               ) const;
+
+   /// Get the next entry in this file with the same event code as an entry
+   /**
+     * \returns a pointer to the entry
+     * \returns nullptr if there is no such entry in this file
+     */
+   char * next( char * logCurrent /**< [in] an entry in this file */) const;
+
+   /// Get the first entry in this file with an event code
+   /**
+     * \returns a pointer to the entry
+     * \returns nullptr if there is no such entry in this file
+     */
+   char * first( flatlogs::eventCodeT ev /**< [in] the event code */) const;
+
+   /// Get the last entry in this file with an event code
+   /**
+     * \returns a pointer to the entry
+     * \returns nullptr if there is no such entry in this file
+     */
+   char * last( flatlogs::eventCodeT ev /**< [in] the event code */) const;
+
+   /// Get the first entry at or after a time
+   /**
+     * \returns a pointer to the entry
+     * \returns end() if all entries are before the time
+     */
+   char * seek( const flatlogs::timespecX & ts /**< [in] the time */) const;
+};
+
+} //namespace logger
+} //namespace MagAOX
+
+#endif //logger_logMappedFile_hpp
@@ -458,6 +458,11 @@ mx::fits::fitsHeaderCard logMeta::card( logMap &lm,
    std::cerr << __FILE__ << " " << __LINE__ << "\n";
    #endif
 
+   return card(vstr);
+}
+
+mx::fits::fitsHeaderCard logMeta::card( const std::string & vstr )
+{
    std::string keyw;
    if(m_detail.hierarch)
    {
@@ -329,6 +329,9 @@ public:
                                   const flatlogs::timespecX & stime,
                                   const flatlogs::timespecX & atime 
                                 );
+
+   /// Make the header card for a value already found by value(), so it isn't looked up twice.
+   mx::fits::fitsHeaderCard card( const std::string & vstr /**< [in] the value*/);
          
 };
 
@@ -0,0 +1,197 @@
+/** \file logQueue.cpp
+  * \brief A bounded lock-free log entry queue with pooled buffers.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * \ingroup logger_files
+  *
+  */
+
+#include "logQueue.hpp"
+
+namespace MagAOX
+{
+namespace logger
+{
+
+size_t logQueue::classSize( int sc )
+{
+   switch(sc)
+   {
+      case 0:
+         return 128;
+      case 1:
+         return 1024;
+      case 2:
+         return 8192;
+      case 3:
+         return 65536 + flatlogs::logHeader::maxHeadSize;
+      default:
+         return 0;
+   }
+}
+
+size_t logQueue::classCount( int sc )
+{
+   if(sc < 0 || sc >= N_SIZE_CLASSES) return 0;
+
+   return m_free[sc].capacity();
+}
+
+logQueue::logQueue()
+{
+   allocate(MAGAOX_default_logQueueLength);
+}
+
+logQueue::~logQueue()
+{
+   logQueueEntry lqe;
+   while(pop(lqe) == 0) release(lqe);
+}
+
+int logQueue::allocate( size_t length )
+{
+   //Release anything heap allocated before we throw the ring away
+   logQueueEntry lqe;
+   while(pop(lqe) == 0) release(lqe);
+
+   if(m_ring.resize(length) < 0) return -1;
+
+   size_t count = m_ring.capacity();
+
+   for(int sc = 0; sc < N_SIZE_CLASSES; ++sc)
+   {
+      if(m_free[sc].resize(count) < 0) return -1;
+
+      //resize rounds up to power of 2, use all of it.
+      count = m_free[sc].capacity();
+
+      try
+      {
+         m_storage[sc].resize(count*classSize(sc));
+      }
+      catch(...)
+      {
+         return -1;
+      }
+
+      for(size_t n = 0; n < count; ++n) m_free[sc].push(m_storage[sc].data() + n*classSize(sc));
+
+      count /= 8;
+      if(count < 4) count = 4;
+   }
+
+   m_maxDepth = 0;
+
+   return 0;
+}
+
+size_t logQueue::capacity() const
+{
+   return m_ring.capacity();
+}
+
+size_t logQueue::depth() const
+{
+   return m_ring.size();
+}
+
+size_t logQueue::maxDepth() const
+{
+   return m_maxDepth.load(std::memory_order_relaxed);
+}
+
+uint64_t logQueue::dropped() const
+{
+   return m_dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t logQueue::blocked() const
+{
+   return m_blocked.load(std::memory_order_relaxed);
+}
+
+uint64_t logQueue::oversize() const
+{
+   return m_oversize.load(std::memory_order_relaxed);
+}
+
+int logQueue::acquire( logQueueEntry & lqe,
+                       size_t sz
+                     )
+{
+   lqe.m_buffer = nullptr;
+   lqe.m_sizeClass = -1;
+
+   int sc = 0;
+   while(sc < N_SIZE_CLASSES && classSize(sc) < sz) ++sc;
+
+   if(sc == N_SIZE_CLASSES)
+   {
+      //Too big for the pool.  This is rare enough that we fall back to the heap.
+      lqe.m_buffer = (char *) ::operator new(sz*sizeof(char), std::nothrow);
+      if(lqe.m_buffer == nullptr) return -1;
+      ++m_oversize;
+      return 0;
+   }
+
+   //Try the best-fit class first, then larger ones if it is exhausted.
+   for(; sc < N_SIZE_CLASSES; ++sc)
+   {
+      if(m_free[sc].pop(lqe.m_buffer))
+      {
+         lqe.m_sizeClass = sc;
+         return 0;
+      }
+   }
+
+   lqe.m_buffer = nullptr;
+   return -1;
+}
+
+void logQueue::release( logQueueEntry & lqe )
+{
+   if(lqe.m_buffer == nullptr) return;
+
+   if(lqe.m_sizeClass < 0 || lqe.m_sizeClass >= N_SIZE_CLASSES)
+   {
+      ::operator delete(lqe.m_buffer);
+   }
+   else
+   {
+      //This can't fail, since there are exactly as many free slots as buffers.
+      m_free[lqe.m_sizeClass].push(lqe.m_buffer);
+   }
+
+   lqe.m_buffer = nullptr;
+}
+
+int logQueue::push( const logQueueEntry & lqe )
+{
+   if(!m_ring.push(lqe)) return -1;
+
+   size_t d = m_ring.size();
+   size_t md = m_maxDepth.load(std::memory_order_relaxed);
+   while(d > md && !m_maxDepth.compare_exchange_weak(md, d, std::memory_order_relaxed));
+
+   return 0;
+}
+
+int logQueue::pop( logQueueEntry & lqe )
+{
+   if(!m_ring.pop(lqe)) return -1;
+
+   return 0;
+}
+
+void logQueue::countDropped()
+{
+   ++m_dropped;
+}
+
+void logQueue::countBlocked()
+{
+   ++m_blocked;
+}
+
+} //namespace logger
+} //namespace MagAOX
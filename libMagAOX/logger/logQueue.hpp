@@ -0,0 +1,306 @@
+/** \file logQueue.hpp
+  * \brief A bounded lock-free log entry queue with pooled buffers.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * \ingroup logger_files
+  *
+  * History:
+  * - 2026-10-17 created
+  */
+
+#ifndef logger_logQueue_hpp
+#define logger_logQueue_hpp
+
+#include <atomic>
+#include <new>
+#include <memory>
+#include <vector>
+
+#include <flatlogs/flatlogs.hpp>
+
+#include "../common/defaults.hpp"
+
+namespace MagAOX
+{
+namespace logger
+{
+
+/// A bounded lock-free multi-producer/multi-consumer ring buffer.
+/** This is the sequence-numbered cell design of D. Vyukov.  Each cell carries a sequence
+  * number which tells a producer or consumer whether the cell is ready for it, so that
+  * push and pop each need only a single CAS on the position counter and never block.
+  *
+  * The capacity is rounded up to a power of two.  resize() is not thread safe and must only be
+  * called when no other thread is accessing the ring.
+  *
+  * \tparam T the trivially copyable element type
+  *
+  * \ingroup logger
+  */
+template<typename T>
+class mpmcRing
+{
+protected:
+
+   struct cell
+   {
+      std::atomic<size_t> m_seq;
+      T m_data;
+   };
+
+   std::unique_ptr<cell[]> m_cells; ///< The ring storage
+   size_t m_mask {0}; ///< Capacity - 1, used to wrap positions.
+
+   alignas(64) std::atomic<size_t> m_enqPos {0}; ///< The next position to push to.
+   alignas(64) std::atomic<size_t> m_deqPos {0}; ///< The next position to pop from.
+
+public:
+
+   /// Allocate the ring
+   /** Any existing contents are discarded.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int resize( size_t sz /**< [in] the requested capacity, rounded up to a power of 2*/)
+   {
+      if(sz < 2) sz = 2;
+
+      size_t cap = 1;
+      while(cap < sz) cap <<= 1;
+
+      try
+      {
+         m_cells.reset(new cell[cap]);
+      }
+      catch(...)
+      {
+         m_cells.reset();
+         m_mask = 0;
+         return -1;
+      }
+
+      for(size_t n = 0; n < cap; ++n) m_cells[n].m_seq.store(n, std::memory_order_relaxed);
+
+      m_mask = cap - 1;
+      m_enqPos.store(0, std::memory_order_relaxed);
+      m_deqPos.store(0, std::memory_order_relaxed);
+
+      return 0;
+   }
+
+   /// Get the capacity of the ring
+   size_t capacity() const
+   {
+      if(!m_cells) return 0;
+      return m_mask + 1;
+   }
+
+   /// Get the number of entries in the ring
+   /** This is only a snapshot and can be out of date by the time it returns.
+     */
+   size_t size() const
+   {
+      size_t e = m_enqPos.load(std::memory_order_relaxed);
+      size_t d = m_deqPos.load(std::memory_order_relaxed);
+      if(e < d) return 0;
+      return e - d;
+   }
+
+   /// Push an entry onto the ring
+   /**
+     * \returns true on success
+     * \returns false if the ring is full
+     */
+   bool push( const T & data /**< [in] the entry to push */)
+   {
+      if(!m_cells) return false;
+
+      cell * c;
+      size_t pos = m_enqPos.load(std::memory_order_relaxed);
+
+      for(;;)
+      {
+         c = &m_cells[pos & m_mask];
+         size_t seq = c->m_seq.load(std::memory_order_acquire);
+         intptr_t dif = (intptr_t) seq - (intptr_t) pos;
+
+         if(dif == 0)
+         {
+            if(m_enqPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+         }
+         else if(dif < 0) return false; //full
+         else pos = m_enqPos.load(std::memory_order_relaxed);
+      }
+
+      c->m_data = data;
+      c->m_seq.store(pos + 1, std::memory_order_release);
+
+      return true;
+   }
+
+   /// Pop an entry from the ring
+   /**
+     * \returns true on success
+     * \returns false if the ring is empty
+     */
+   bool pop( T & data /**< [out] the entry popped */)
+   {
+      if(!m_cells) return false;
+
+      cell * c;
+      size_t pos = m_deqPos.load(std::memory_order_relaxed);
+
+      for(;;)
+      {
+         c = &m_cells[pos & m_mask];
+         size_t seq = c->m_seq.load(std::memory_order_acquire);
+         intptr_t dif = (intptr_t) seq - (intptr_t) (pos + 1);
+
+         if(dif == 0)
+         {
+            if(m_deqPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+         }
+         else if(dif < 0) return false; //empty
+         else pos = m_deqPos.load(std::memory_order_relaxed);
+      }
+
+      data = c->m_data;
+      c->m_seq.store(pos + m_mask + 1, std::memory_order_release);
+
+      return true;
+   }
+};
+
+/// An entry in the log queue.
+/** Refers to a log buffer obtained from the logQueue pool.
+  *
+  * \ingroup logger
+  */
+struct logQueueEntry
+{
+   char * m_buffer {nullptr}; ///< The raw log entry buffer.
+   int m_sizeClass {-1}; ///< The pool size class of the buffer. -1 means it was heap allocated because it was too large for any class.
+};
+
+/// A bounded lock-free log queue backed by a size-classed buffer pool.
+/** Producers (any thread calling `log`) acquire a pre-allocated buffer large enough for the entry,
+  * format the entry into it, and push it onto an MPSC ring.  The single consumer (the log thread)
+  * pops entries, writes them, and releases the buffers back to the pool.  Neither side allocates
+  * memory or takes a lock in steady state.
+  *
+  * Buffers come from a fixed set of size classes, with smaller classes having more buffers since most
+  * entries are short.  An entry larger than the largest class is heap-allocated as a fallback, which is
+  * counted in oversize().
+  *
+  * What happens when the ring or the pool is exhausted is decided by the caller (see logManager), which
+  * either drops the entry and counts it with dropped(), or spins until space is available.
+  *
+  * \ingroup logger
+  */
+class logQueue
+{
+public:
+
+   /// The number of buffer size classes
+   static constexpr int N_SIZE_CLASSES = 4;
+
+   /// Get the buffer size, in bytes, of a size class.
+   static size_t classSize( int sc /**< [in] the size class*/);
+
+   /// Get the number of buffers allocated for a size class.
+   size_t classCount( int sc /**< [in] the size class*/);
+
+protected:
+
+   mpmcRing<logQueueEntry> m_ring; ///< The queue of pending log entries.
+
+   mpmcRing<char *> m_free[N_SIZE_CLASSES]; ///< The free lists for each size class.
+
+   std::vector<char> m_storage[N_SIZE_CLASSES]; ///< The backing storage for each size class.
+
+   std::atomic<uint64_t> m_dropped {0}; ///< Counter of entries dropped due to overflow.
+
+   std::atomic<uint64_t> m_blocked {0}; ///< Counter of entries which had to wait for space.
+
+   std::atomic<uint64_t> m_oversize {0}; ///< Counter of entries too large for any size class.
+
+   std::atomic<size_t> m_maxDepth {0}; ///< The largest queue depth seen.
+
+public:
+
+   /// Default c'tor.  Allocates the queue and pool with MAGAOX_default_logQueueLength.
+   logQueue();
+
+   /// Destructor.  Releases any heap allocated entries still in the queue.
+   ~logQueue();
+
+   /// Allocate the queue and pool.
+   /** Must only be called when no other thread is using the queue.  Any entries in the queue are discarded.
+     *
+     * The smallest size class gets `length` buffers, and each larger class gets 1/8 as many as the one before,
+     * with a minimum of 4.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int allocate( size_t length /**< [in] the length of the queue*/);
+
+   /// Get the capacity of the queue
+   size_t capacity() const;
+
+   /// Get the current number of entries in the queue
+   size_t depth() const;
+
+   /// Get the largest number of entries seen in the queue
+   size_t maxDepth() const;
+
+   /// Get the number of dropped entries
+   uint64_t dropped() const;
+
+   /// Get the number of entries which had to wait for space
+   uint64_t blocked() const;
+
+   /// Get the number of entries which were too large for the pool
+   uint64_t oversize() const;
+
+   /// Acquire a buffer for an entry of the given size
+   /** Does not block.  If the entry is larger than the largest size class a buffer is allocated from the heap.
+     *
+     * \returns 0 on success
+     * \returns -1 if no buffer of a suitable size class is free
+     */
+   int acquire( logQueueEntry & lqe, ///< [out] the entry with its buffer set
+                size_t sz            ///< [in] the total size of the log entry in bytes
+              );
+
+   /// Release an entry's buffer back to the pool.
+   void release( logQueueEntry & lqe /**< [in] the entry to release. m_buffer is set to nullptr on return. */);
+
+   /// Push a formatted entry onto the queue
+   /** Does not block.
+     *
+     * \returns 0 on success
+     * \returns -1 if the queue is full
+     */
+   int push( const logQueueEntry & lqe /**< [in] the entry to push */);
+
+   /// Pop the next entry from the queue
+   /** Only the log thread should call this.
+     *
+     * \returns 0 on success
+     * \returns -1 if the queue is empty
+     */
+   int pop( logQueueEntry & lqe /**< [out] the next entry */);
+
+   /// Count a dropped entry
+   void countDropped();
+
+   /// Count an entry which had to wait for space
+   void countBlocked();
+};
+
+} //namespace logger
+} //namespace MagAOX
+
+#endif //logger_logQueue_hpp
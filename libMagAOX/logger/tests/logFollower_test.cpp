@@ -0,0 +1,229 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../logFollower.hpp"
+
+#include "testIntLog.hpp"
+
+using namespace MagAOX::logger;
+
+/// A log file written a piece at a time, the way the logger appends to it.
+struct testLogFile
+{
+   std::string m_fileName;
+   int m_fd {-1};
+
+   testLogFile( const std::string & dir,
+                const std::string & appName,
+                time_t t0
+              )
+   {
+      m_fileName = dir + "/" + appName + "_" + flatlogs::timespecX(t0, 0).timeStamp() + ".binlog";
+      m_fd = ::open(m_fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+   }
+
+   ~testLogFile()
+   {
+      if(m_fd >= 0) ::close(m_fd);
+   }
+
+   /// Write an entry, or the first nbytes of it if nbytes > 0, or the rest of it if nbytes < 0.
+   void write( time_t ts,
+               int val,
+               int nbytes = 0
+             )
+   {
+      flatlogs::msgLenT len = sizeof(int);
+      std::vector<char> buf(flatlogs::logHeader::totalSize(len));
+      flatlogs::logHeader::createLog<test_int_log>(buf.data(), flatlogs::timespecX(ts, 0), len, val, flatlogs::logPrio::LOG_INFO);
+
+      if(nbytes > 0) ::write(m_fd, buf.data(), nbytes);
+      else if(nbytes < 0) ::write(m_fd, buf.data() - nbytes, buf.size() + nbytes);
+      else ::write(m_fd, buf.data(), buf.size());
+   }
+};
+
+/// Get the value of an entry
+int value( logFollower::entry & e )
+{
+   int v;
+   memcpy(&v, flatlogs::logHeader::messageBuffer(e.m_logBuff), sizeof(int));
+   return v;
+}
+
+/// Get the time of an entry
+time_t seconds( logFollower::entry & e )
+{
+   return flatlogs::logHeader::timespec(e.m_logBuff).time_s;
+}
+
+SCENARIO( "Following the logs of several applications", "[logFollower]" )
+{
+   testLogDir tmpDir("logFollower_test");
+   std::string dir = tmpDir.m_path;
+   REQUIRE( dir != "" );
+
+   GIVEN("two applications with logs")
+   {
+      testLogFile oldA(dir, "appA", 500);
+      oldA.write(500, -1);
+
+      testLogFile fileA(dir, "appA", 1000);
+      testLogFile fileB(dir, "appB", 1000);
+      for(int n = 0; n < 10; ++n)
+      {
+         fileA.write(1000 + 2*n, n);
+         fileB.write(1001 + 2*n, 100 + n);
+      }
+
+      //Not logs, and so ignored
+      testLogFile other(dir, "appA", 2000);
+      ::rename(other.m_fileName.c_str(), (other.m_fileName + ".idx").c_str());
+
+      logFollower lf;
+      REQUIRE( lf.latency(-1) == -1 );
+      REQUIRE( lf.latency(0) == 0 );
+
+      WHEN("following all of them")
+      {
+         REQUIRE( lf.open(dir, ".binlog", {}, flatlogs::timespecX(1010, 0)) == 0 );
+         REQUIRE( lf.appNames() == std::vector<std::string>({"appA", "appB"}) );
+         REQUIRE( lf.fileName("appA") == fileA.m_fileName );
+
+         //Only entries after the start, merged in time order
+         std::vector<logFollower::entry> es;
+         REQUIRE( lf.poll(es, 0) == 0 );
+         REQUIRE( es.size() == 10 );
+         for(size_t n = 0; n < es.size(); ++n)
+         {
+            REQUIRE( seconds(es[n]) == 1010 + (time_t) n );
+            REQUIRE( es[n].m_appName == (n % 2 == 0 ? "appA" : "appB") );
+         }
+
+         //Nothing more
+         es.clear();
+         REQUIRE( lf.poll(es, 10) == 0 );
+         REQUIRE( es.size() == 0 );
+
+         //New entries are returned as they are written
+         fileB.write(1030, 200);
+         REQUIRE( lf.poll(es, 1000) == 0 );
+         REQUIRE( es.size() == 1 );
+         REQUIRE( value(es[0]) == 200 );
+
+         //An entry written in pieces is returned when complete
+         es.clear();
+         fileA.write(1031, 201, 5);
+         REQUIRE( lf.poll(es, 50) == 0 );
+         REQUIRE( es.size() == 0 );
+         fileA.write(1031, 201, -5);
+         REQUIRE( lf.poll(es, 1000) == 0 );
+         REQUIRE( es.size() == 1 );
+         REQUIRE( value(es[0]) == 201 );
+
+         //The old file is finished before the new one is followed
+         es.clear();
+         fileA.write(1032, 202);
+         testLogFile newA(dir, "appA", 1033);
+         newA.write(1033, 203);
+         while(es.size() < 2) REQUIRE( lf.poll(es, 1000) == 0 );
+         REQUIRE( value(es[0]) == 202 );
+         REQUIRE( value(es[1]) == 203 );
+         REQUIRE( lf.fileName("appA") == newA.m_fileName );
+
+         //An application which starts later is followed
+         es.clear();
+         testLogFile fileC(dir, "appC", 1034);
+         fileC.write(1034, 300);
+         while(es.size() < 1) REQUIRE( lf.poll(es, 1000) == 0 );
+         REQUIRE( es[0].m_appName == "appC" );
+         REQUIRE( lf.appNames().size() == 3 );
+      }
+
+      WHEN("following one of them")
+      {
+         REQUIRE( lf.open(dir, ".binlog", {"appB", "appD"}, flatlogs::timespecX(0, 0)) == 0 );
+         REQUIRE( lf.fileName("appA") == "" );
+         REQUIRE( lf.fileName("appD") == "" );
+
+         std::vector<logFollower::entry> es;
+         REQUIRE( lf.poll(es, 0) == 0 );
+         REQUIRE( es.size() == 10 );
+         for(size_t n = 0; n < es.size(); ++n) REQUIRE( es[n].m_appName == "appB" );
+
+         es.clear();
+         fileA.write(1030, 200);
+         fileB.write(1031, 201);
+         REQUIRE( lf.poll(es, 1000) == 0 );
+         REQUIRE( es.size() == 1 );
+         REQUIRE( value(es[0]) == 201 );
+
+         //An application without logs is followed once it has one
+         es.clear();
+         testLogFile fileD(dir, "appD", 1032);
+         fileD.write(1032, 400);
+         while(es.size() < 1) REQUIRE( lf.poll(es, 1000) == 0 );
+         REQUIRE( es[0].m_appName == "appD" );
+      }
+
+      WHEN("entries are written out of order by different applications")
+      {
+         REQUIRE( lf.latency(0.2) == 0 );
+         REQUIRE( lf.open(dir, ".binlog", {}, flatlogs::timespecX(2000, 0)) == 0 );
+
+         std::vector<logFollower::entry> es;
+         REQUIRE( lf.poll(es, 0) == 0 );
+         REQUIRE( es.size() == 0 );
+
+         auto t0 = std::chrono::steady_clock::now();
+
+         fileB.write(1041, 501);
+         REQUIRE( lf.poll(es, 50) == 0 );
+         REQUIRE( es.size() == 0 ); //held for the latency
+
+         fileA.write(1040, 500);
+
+         while(es.size() < 2) REQUIRE( lf.poll(es, 1000) == 0 );
+
+         double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+         REQUIRE( dt >= 0.2 );
+         REQUIRE( dt < 1.0 );
+
+         //The later written, earlier entry comes first
+         REQUIRE( value(es[0]) == 500 );
+         REQUIRE( value(es[1]) == 501 );
+      }
+
+      WHEN("shutting down with entries held")
+      {
+         REQUIRE( lf.latency(100) == 0 );
+         REQUIRE( lf.open(dir, ".binlog", {}, flatlogs::timespecX(1015, 0)) == 0 );
+
+         std::vector<logFollower::entry> es;
+         REQUIRE( lf.poll(es, 0) == 0 );
+         REQUIRE( es.size() == 0 );
+
+         lf.flush(es);
+         REQUIRE( es.size() == 5 );
+         REQUIRE( seconds(es[0]) == 1015 );
+         REQUIRE( seconds(es[4]) == 1019 );
+      }
+   }
+
+   GIVEN("a directory which does not exist")
+   {
+      logFollower lf;
+      REQUIRE( lf.open(dir + "/none", ".binlog", {}, flatlogs::timespecX(0,0)) == -1 );
+
+      std::vector<logFollower::entry> es;
+      REQUIRE( lf.poll(es, 0) == -1 );
+   }
+}
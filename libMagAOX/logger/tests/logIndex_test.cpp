@@ -0,0 +1,151 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../logFileRaw.hpp"
+#include "../logIndex.hpp"
+#include "../logMappedFile.hpp"
+
+#include "testIntLog.hpp"
+
+using namespace MagAOX::logger;
+
+SCENARIO( "Finding log entries with an index", "[logIndex]" )
+{
+   testLogDir tmpDir("logIndex_test");
+   std::string dir = tmpDir.m_path;
+   REQUIRE( dir != "" );
+
+   GIVEN("a file written with an index")
+   {
+      std::string fname = writeTestLog(dir, 10000, true);
+
+      REQUIRE( access(logIndex::indexName(fname).c_str(), F_OK) == 0 );
+
+      logMappedFile lmf;
+      REQUIRE( lmf.open(fname) == 0 );
+
+      REQUIRE( lmf.index().nRecords() == 10000 );
+      REQUIRE( lmf.startTime().time_s == 1000 );
+      REQUIRE( lmf.endTime().time_s == 10999 );
+
+      //The index is sparse
+      REQUIRE( lmf.index().entries().size() < 1000 );
+
+      WHEN("looking up the prior entry of the common code")
+      {
+         char * p = lmf.prior(1, flatlogs::timespecX(5432, 500));
+         REQUIRE( p != nullptr );
+         REQUIRE( flatlogs::logHeader::timespec(p).time_s == 5432 );
+
+         //The next entry is also code 1
+         char * q = lmf.next(p);
+         REQUIRE( q != nullptr );
+         REQUIRE( flatlogs::logHeader::timespec(q).time_s == 5433 );
+      }
+
+      WHEN("looking up the prior entry of the rare code")
+      {
+         char * p = lmf.prior(2, flatlogs::timespecX(5432, 500));
+         REQUIRE( p != nullptr );
+         REQUIRE( flatlogs::logHeader::timespec(p).time_s == 5000 );
+
+         char * q = lmf.next(p);
+         REQUIRE( q != nullptr );
+         REQUIRE( flatlogs::logHeader::timespec(q).time_s == 5500 );
+
+         REQUIRE( lmf.prior(2, flatlogs::timespecX(1000, 0)) == nullptr );
+         REQUIRE( lmf.next(lmf.last(2)) == nullptr );
+         REQUIRE( flatlogs::logHeader::timespec(lmf.last(2)).time_s == 10500 );
+      }
+
+      WHEN("looking up the rare code at many times")
+      {
+         //The index was read with the stride it was written with, which bounds the scans
+         REQUIRE( lmf.index().strideBytes() == MAGAOX_default_logIndexStride );
+
+         for(int t = 1001; t < 11000; t += 37)
+         {
+            char * p = lmf.prior(2, flatlogs::timespecX(t, 500));
+            REQUIRE( p != nullptr );
+            REQUIRE( (int) flatlogs::logHeader::timespec(p).time_s == 1000 + ((t-1000)/500)*500 );
+         }
+      }
+
+      WHEN("seeking to a time")
+      {
+         char * p = lmf.seek(flatlogs::timespecX(7777, 1));
+         REQUIRE( flatlogs::logHeader::timespec(p).time_s == 7778 );
+
+         REQUIRE( lmf.seek(flatlogs::timespecX(20000, 0)) == lmf.end() );
+      }
+   }
+
+   GIVEN("a file written without an index")
+   {
+      std::string fname = writeTestLog(dir, 2000, false);
+
+      REQUIRE( access(logIndex::indexName(fname).c_str(), F_OK) != 0 );
+
+      logMappedFile lmf;
+      REQUIRE( lmf.open(fname) == 0 );
+
+      REQUIRE( lmf.index().nRecords() == 2000 );
+
+      char * p = lmf.prior(2, flatlogs::timespecX(2600, 0));
+      REQUIRE( p != nullptr );
+      REQUIRE( flatlogs::logHeader::timespec(p).time_s == 2500 );
+   }
+
+   GIVEN("an index built with a stride shorter than the spacing of the rare code")
+   {
+      std::string fname = writeTestLog(dir, 10000, false);
+
+      logMappedFile lmf;
+      REQUIRE( lmf.open(fname) == 0 );
+      size_t sz = lmf.size();
+
+      //Every occurrence of the rare code is then indexed, and the common code every 256 bytes at most
+      logIndex idx;
+      idx.strideBytes(256);
+      REQUIRE( idx.build(lmf.data(), sz) == 0 );
+      REQUIRE( idx.write(logIndex::indexName(fname)) == 0 );
+      lmf.close();
+
+      REQUIRE( lmf.open(fname) == 0 );
+      REQUIRE( lmf.index().strideBytes() == 256 );
+
+      for(int t = 1001; t < 11000; t += 37)
+      {
+         char * p = lmf.prior(1, flatlogs::timespecX(t, 500));
+         REQUIRE( p != nullptr );
+         int n = t - 1000;
+         if(n % 500 == 0) --n;
+         REQUIRE( (int) flatlogs::logHeader::timespec(p).time_s == 1000 + n );
+
+         p = lmf.prior(2, flatlogs::timespecX(t, 500));
+         REQUIRE( p != nullptr );
+         REQUIRE( (int) flatlogs::logHeader::timespec(p).time_s == 1000 + ((t-1000)/500)*500 );
+      }
+   }
+
+   GIVEN("a file with an incomplete entry at the end")
+   {
+      std::string fname = writeTestLog(dir, 100, false);
+
+      logMappedFile lmf;
+      REQUIRE( lmf.open(fname) == 0 );
+      size_t sz = lmf.size();
+      lmf.close();
+
+      REQUIRE( truncate(fname.c_str(), sz - 2) == 0 );
+
+      REQUIRE( lmf.open(fname) == 0 );
+      REQUIRE( lmf.index().nRecords() == 99 );
+      REQUIRE( lmf.size() < sz - 2 );
+   }
+}
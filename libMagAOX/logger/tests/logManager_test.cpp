@@ -0,0 +1,139 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../logManager.hpp"
+
+using namespace MagAOX::logger;
+
+namespace logManager_tests
+{
+
+/// A logFile which keeps the messages written to it.
+struct memLogFile
+{
+   std::vector<std::string> m_msgs; ///< The messages of the entries written, in order
+   std::atomic<size_t> m_nWritten {0}; ///< The size of m_msgs, for reading from another thread
+
+   int writeLog( bufferPtrT & logBuffer )
+   {
+      m_msgs.push_back( text_log::msgString( logHeader::messageBuffer(logBuffer), logHeader::msgLen(logBuffer) ) );
+      ++m_nWritten;
+      return 0;
+   }
+
+   int flush()
+   {
+      return 0;
+   }
+};
+
+/// A parent which counts the entries it is shown, so they aren't printed.
+struct countingParent
+{
+   size_t m_n {0};
+
+   void logMessage( bufferPtrT & logBuffer )
+   {
+      static_cast<void>(logBuffer);
+      ++m_n;
+   }
+};
+
+typedef logManager<countingParent, memLogFile> testLogManager;
+
+/// Wait up to 10 seconds for the log thread to write \p n entries
+bool waitWritten( testLogManager & lm,
+                  size_t n
+                )
+{
+   for(int i = 0; i < 10000; ++i)
+   {
+      if(lm.m_nWritten >= n) return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   }
+
+   return false;
+}
+
+SCENARIO( "Overflowing the log queue", "[logManager]" )
+{
+   GIVEN("a log manager with the default blocking policy")
+   {
+      countingParent parent;
+      testLogManager lm;
+      lm.parent(&parent);
+      lm.writePause(1000);
+
+      REQUIRE( lm.overflowBlock() == true );
+      REQUIRE( lm.overflowBlockLevel() == logPrio::LOG_WARNING );
+      REQUIRE( lm.queueCapacity() == MAGAOX_default_logQueueLength );
+
+      size_t cap = lm.queueCapacity();
+
+      WHEN("logging more than the queue holds before the log thread starts")
+      {
+         //Even entries which would block are dropped, since nothing would drain the queue.
+         for(size_t n = 0; n < cap + 100; ++n) lm.log<text_log>("entry " + std::to_string(n), logPrio::LOG_WARNING);
+
+         REQUIRE( lm.queueDepth() == cap );
+         REQUIRE( lm.queueDropped() == 100 );
+         REQUIRE( lm.queueBlocked() == 0 );
+
+         //The first entries are kept, and written once the thread starts
+         REQUIRE( lm.logThreadStart() == 0 );
+         REQUIRE( waitWritten(lm, cap) );
+
+         REQUIRE( lm.m_msgs.size() == cap );
+         for(size_t n = 0; n < cap; ++n) REQUIRE( lm.m_msgs[n] == "entry " + std::to_string(n) );
+
+         REQUIRE( lm.queueDropped() == 100 );
+      }
+
+      WHEN("logging more than the queue holds with the log thread running")
+      {
+         REQUIRE( lm.logThreadStart() == 0 );
+
+         for(size_t n = 0; n < 4*cap; ++n) lm.log<text_log>("entry " + std::to_string(n), logPrio::LOG_WARNING);
+
+         //Nothing is dropped, entries wait for space instead
+         REQUIRE( waitWritten(lm, 4*cap) );
+         REQUIRE( lm.queueDropped() == 0 );
+
+         REQUIRE( lm.m_msgs.size() == 4*cap );
+         for(size_t n = 0; n < 4*cap; ++n) REQUIRE( lm.m_msgs[n] == "entry " + std::to_string(n) );
+      }
+
+      WHEN("logging less severe entries than the block level before the log thread starts")
+      {
+         for(size_t n = 0; n < cap + 10; ++n) lm.log<text_log>("entry " + std::to_string(n), logPrio::LOG_INFO);
+
+         REQUIRE( lm.queueDepth() == cap );
+         REQUIRE( lm.queueDropped() == 10 );
+      }
+   }
+
+   GIVEN("a log manager with the drop policy")
+   {
+      countingParent parent;
+      testLogManager lm;
+      lm.parent(&parent);
+
+      REQUIRE( lm.overflowPolicy(false, logPrio::LOG_WARNING) == 0 );
+
+      WHEN("logging more than the queue holds before the log thread starts")
+      {
+         size_t cap = lm.queueCapacity();
+         for(size_t n = 0; n < cap + 5; ++n) lm.log<text_log>("entry " + std::to_string(n), logPrio::LOG_CRITICAL);
+
+         REQUIRE( lm.queueDepth() == cap );
+         REQUIRE( lm.queueDropped() == 5 );
+      }
+   }
+}
+
+} //namespace logManager_tests
@@ -0,0 +1,123 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../logFileRaw.hpp"
+#include "../logMap.hpp"
+
+#include "testIntLog.hpp"
+
+using namespace MagAOX::logger;
+
+/// Get the value of an entry
+int value( char * logEntry )
+{
+   int v;
+   memcpy(&v, flatlogs::logHeader::messageBuffer(logEntry), sizeof(int));
+   return v;
+}
+
+SCENARIO( "Looking up log entries by time", "[logMap]" )
+{
+   testLogDir tmpDir("logMap_test");
+   std::string dir = tmpDir.m_path;
+   REQUIRE( dir != "" );
+
+   GIVEN("logs over several files")
+   {
+      //Entry n is at 1000+2n seconds and every 10th has code 2, over several files
+      writeTestLog(dir, 2000, true, "maptest", 2, 10, 4096);
+
+      logMap lm;
+      REQUIRE( lm.loadAppToFileMap(dir, ".binlog") == 0 );
+      REQUIRE( lm.m_appToFileMap["maptest"].size() > 3 );
+
+      REQUIRE( lm.loadFiles("maptest", flatlogs::timespecX(2000,0)) == 0 );
+
+      WHEN("looking up at increasing times, as for the frames of an archive")
+      {
+         char * prior = nullptr;
+         for(int t = 2000; t < 2400; t += 3)
+         {
+            REQUIRE( lm.getPriorLog(prior, "maptest", 1, flatlogs::timespecX(t, 500)) == 0 );
+
+            //The last entry with code 1 at or before t
+            int n = (t - 1000)/2;
+            if(n % 10 == 0) --n;
+            REQUIRE( value(prior) == n );
+         }
+      }
+
+      WHEN("looking up at decreasing times")
+      {
+         char * prior = nullptr;
+         for(int t = 2400; t > 2000; t -= 7)
+         {
+            REQUIRE( lm.getPriorLog(prior, "maptest", 2, flatlogs::timespecX(t, 0)) == 0 );
+
+            //The last entry with code 2 before t
+            int n = (t - 1 - 1000)/2;
+            n -= n % 10;
+            REQUIRE( value(prior) == n );
+         }
+      }
+
+      WHEN("stepping through the entries of a code")
+      {
+         char * curr = nullptr;
+         REQUIRE( lm.getPriorLog(curr, "maptest", 2, flatlogs::timespecX(2001,0)) == 0 );
+         REQUIRE( value(curr) == 500 );
+
+         //Continues into files which are not yet loaded
+         for(int n = 510; n < 1500; n += 10)
+         {
+            char * next = nullptr;
+            REQUIRE( lm.getNextLog(next, curr, "maptest") == 0 );
+            REQUIRE( value(next) == n );
+            curr = next;
+         }
+      }
+
+      WHEN("loading files out of order after the series are built")
+      {
+         std::vector<logFileName> files(lm.m_appToFileMap["maptest"].begin(), lm.m_appToFileMap["maptest"].end());
+
+         logInMemory lim;
+         REQUIRE( lim.loadFile(files[files.size()/2]) == 0 );
+         REQUIRE( lim.series(1).m_entries.size() > 0 );
+         REQUIRE( lim.series(2).m_entries.size() > 0 );
+         lim.series(1).prior(flatlogs::timespecX(1000000,0)); //move the cursor to the end
+
+         //Later files, then earlier ones, then the rest
+         for(size_t n = files.size()/2 + 1; n < files.size(); n += 2) REQUIRE( lim.loadFile(files[n]) == 0 );
+         for(size_t n = 0; n < files.size()/2; n += 2) REQUIRE( lim.loadFile(files[n]) == 0 );
+         for(size_t n = 0; n < files.size(); ++n)
+         {
+            if(!lim.isLoaded(files[n])) REQUIRE( lim.loadFile(files[n]) == 0 );
+         }
+
+         //The series were extended to match ones built from all the files
+         for(flatlogs::eventCodeT ev = 1; ev <= 2; ++ev)
+         {
+            logSeries & ls = lim.series(ev);
+
+            logSeries full;
+            for(size_t n = 0; n < lim.m_files.size(); ++n) full.insert(full.m_entries.size(), *lim.m_files[n], ev);
+
+            REQUIRE( ls.m_entries == full.m_entries );
+            REQUIRE( ls.m_times.size() == full.m_times.size() );
+            for(size_t n = 0; n < ls.m_times.size(); ++n) REQUIRE( ls.m_times[n] == full.m_times[n] );
+         }
+
+         REQUIRE( lim.series(1).m_entries.size() == 1800 );
+         REQUIRE( lim.series(2).m_entries.size() == 200 );
+
+         //The cursor stayed on the same entry
+         REQUIRE( value(lim.series(1).m_entries[lim.series(1).m_cursor]) == value(lim.m_files[files.size()/2]->last(1)) );
+      }
+   }
+}
@@ -0,0 +1,153 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "../logQueue.hpp"
+
+using namespace MagAOX::logger;
+
+SCENARIO( "Pushing and popping the lock-free ring", "[logQueue]" )
+{
+   GIVEN("a ring of capacity 8")
+   {
+      mpmcRing<int> ring;
+      REQUIRE( ring.resize(5) == 0 );
+      REQUIRE( ring.capacity() == 8 );
+
+      WHEN("filled past capacity")
+      {
+         for(int n = 0; n < 8; ++n) REQUIRE( ring.push(n) == true );
+
+         REQUIRE( ring.push(8) == false );
+         REQUIRE( ring.size() == 8 );
+
+         int v;
+         for(int n = 0; n < 8; ++n)
+         {
+            REQUIRE( ring.pop(v) == true );
+            REQUIRE( v == n );
+         }
+         REQUIRE( ring.pop(v) == false );
+         REQUIRE( ring.size() == 0 );
+      }
+   }
+}
+
+SCENARIO( "Acquiring and releasing pooled log buffers", "[logQueue]" )
+{
+   GIVEN("a queue of length 16")
+   {
+      logQueue lq;
+      REQUIRE( lq.allocate(16) == 0 );
+      REQUIRE( lq.capacity() == 16 );
+
+      WHEN("acquiring small buffers")
+      {
+         std::vector<logQueueEntry> ents(lq.classCount(0));
+         for(size_t n = 0; n < ents.size(); ++n)
+         {
+            REQUIRE( lq.acquire(ents[n], 32) == 0 );
+            REQUIRE( ents[n].m_sizeClass == 0 );
+         }
+
+         //Now the next class up is used
+         logQueueEntry lqe;
+         REQUIRE( lq.acquire(lqe, 32) == 0 );
+         REQUIRE( lqe.m_sizeClass == 1 );
+         lq.release(lqe);
+         REQUIRE( lqe.m_buffer == nullptr );
+
+         for(size_t n = 0; n < ents.size(); ++n) lq.release(ents[n]);
+
+         REQUIRE( lq.acquire(lqe, 32) == 0 );
+         REQUIRE( lqe.m_sizeClass == 0 );
+         lq.release(lqe);
+      }
+
+      WHEN("acquiring an oversize buffer")
+      {
+         logQueueEntry lqe;
+         REQUIRE( lq.acquire(lqe, logQueue::classSize(logQueue::N_SIZE_CLASSES-1) + 1) == 0 );
+         REQUIRE( lqe.m_sizeClass == -1 );
+         REQUIRE( lq.oversize() == 1 );
+         lq.release(lqe);
+      }
+
+      WHEN("the queue is full")
+      {
+         logQueueEntry lqe;
+         for(size_t n = 0; n < lq.capacity(); ++n)
+         {
+            REQUIRE( lq.acquire(lqe, 16) == 0 );
+            REQUIRE( lq.push(lqe) == 0 );
+         }
+
+         REQUIRE( lq.acquire(lqe, 16) == 0 );
+         REQUIRE( lq.push(lqe) == -1 );
+         lq.release(lqe);
+
+         REQUIRE( lq.depth() == lq.capacity() );
+         REQUIRE( lq.maxDepth() == lq.capacity() );
+
+         while( lq.pop(lqe) == 0 ) lq.release(lqe);
+         REQUIRE( lq.depth() == 0 );
+      }
+   }
+}
+
+SCENARIO( "Multiple producers with one consumer", "[logQueue]" )
+{
+   GIVEN("4 producers writing 10000 entries each")
+   {
+      logQueue lq;
+      REQUIRE( lq.allocate(64) == 0 );
+
+      const int nprod = 4;
+      const int nper = 10000;
+
+      std::vector<std::thread> prods;
+      for(int p = 0; p < nprod; ++p)
+      {
+         prods.emplace_back( [&lq, p]()
+         {
+            for(int n = 0; n < nper; ++n)
+            {
+               logQueueEntry lqe;
+               while(lq.acquire(lqe, sizeof(int)*2) < 0) std::this_thread::yield();
+               reinterpret_cast<int*>(lqe.m_buffer)[0] = p;
+               reinterpret_cast<int*>(lqe.m_buffer)[1] = n;
+               while(lq.push(lqe) < 0) std::this_thread::yield();
+            }
+         });
+      }
+
+      //Entries from each producer must arrive in order, and none can be lost.
+      std::vector<int> next(nprod, 0);
+      int nrecv = 0;
+      bool inorder = true;
+      while(nrecv < nprod*nper)
+      {
+         logQueueEntry lqe;
+         if(lq.pop(lqe) < 0)
+         {
+            std::this_thread::yield();
+            continue;
+         }
+
+         int p = reinterpret_cast<int*>(lqe.m_buffer)[0];
+         int n = reinterpret_cast<int*>(lqe.m_buffer)[1];
+         if(n != next[p]) inorder = false;
+         next[p] = n + 1;
+         lq.release(lqe);
+         ++nrecv;
+      }
+
+      for(auto & t : prods) t.join();
+
+      REQUIRE( inorder == true );
+      REQUIRE( lq.depth() == 0 );
+      for(int p = 0; p < nprod; ++p) REQUIRE( next[p] == nper );
+   }
+}
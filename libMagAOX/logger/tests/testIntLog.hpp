@@ -0,0 +1,115 @@
+/** \file testIntLog.hpp
+  * \brief A minimal log type, a writer of test log files using it, and a temporary directory for them
+  *
+  * \ingroup logger_files
+  */
+
+#ifndef logger_tests_testIntLog_hpp
+#define logger_tests_testIntLog_hpp
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <flatlogs/flatlogs.hpp>
+
+#include "../logFileRaw.hpp"
+
+/// A temporary directory for test files, removed with the files in it at the end of the scope.
+struct testLogDir
+{
+   std::string m_path; ///< The full path of the directory, empty if it could not be created.
+
+   explicit testLogDir( const std::string & prefix /**< [in] the start of the directory name in /tmp */)
+   {
+      std::string tmpl = "/tmp/" + prefix + "XXXXXX";
+      if(mkdtemp(&tmpl[0]) != nullptr) m_path = tmpl;
+   }
+
+   ~testLogDir()
+   {
+      if(m_path == "") return;
+
+      DIR * d = opendir(m_path.c_str());
+      if(d)
+      {
+         dirent * de;
+         while((de = readdir(d)) != nullptr)
+         {
+            std::string name = de->d_name;
+            if(name == "." || name == "..") continue;
+            unlink((m_path + "/" + name).c_str());
+         }
+         closedir(d);
+      }
+
+      rmdir(m_path.c_str());
+   }
+
+   testLogDir( const testLogDir & ) = delete;
+   testLogDir & operator=( const testLogDir & ) = delete;
+};
+
+/// A minimal log type holding an int, for building test files.
+struct test_int_log
+{
+   static const flatlogs::eventCodeT eventCode = 1;
+   static const flatlogs::logPrioT defaultLevel = flatlogs::logPrio::LOG_INFO;
+
+   typedef int messageT;
+
+   static flatlogs::msgLenT length( const messageT & msg )
+   {
+      static_cast<void>(msg);
+      return sizeof(int);
+   }
+
+   static int format( void * msgBuffer, const messageT & msg )
+   {
+      memcpy(msgBuffer, &msg, sizeof(int));
+      return 0;
+   }
+};
+
+/// Write test logs with two event codes, code 2 being rare.  The time of entry n is 1000+dt*n seconds.
+/**
+  * \returns the name of the first file written
+  */
+inline
+std::string writeTestLog( const std::string & dir,                ///< [in] the directory to write to
+                          int N,                                  ///< [in] the number of entries
+                          bool writeIndex,                        ///< [in] whether to write an index with each file
+                          const std::string & name = "idxtest",   ///< [in] the app name of the logs
+                          int dt = 1,                             ///< [in] the time between entries, in seconds
+                          int rareEvery = 500,                    ///< [in] every rareEvery-th entry, starting with the first, gets code 2
+                          size_t maxLogSize = 1024*1024*1024      ///< [in] the maximum file size, by default large enough to not rotate
+                        )
+{
+   MagAOX::logger::logFileRaw lfr;
+   lfr.logPath(dir);
+   lfr.logName(name);
+   lfr.maxLogSize(maxLogSize);
+   lfr.writeIndex(writeIndex);
+
+   std::vector<flatlogs::bufferPtrT> bufs; //entries must remain valid until flushed
+   for(int n = 0; n < N; ++n)
+   {
+      flatlogs::msgLenT len = sizeof(int);
+      flatlogs::bufferPtrT buf(new char[flatlogs::logHeader::totalSize(len)], std::default_delete<char[]>());
+      flatlogs::logHeader::createLog<test_int_log>(buf.get(), flatlogs::timespecX(1000+dt*n, 0), len, n, flatlogs::logPrio::LOG_INFO);
+
+      if(n % rareEvery == 0) flatlogs::logHeader::eventCode(buf, 2);
+
+      lfr.writeLog(buf);
+      bufs.push_back(buf);
+      if(n % 100 == 0) lfr.flush();
+   }
+   lfr.close();
+
+   return dir + "/" + name + "_" + flatlogs::timespecX(1000,0).timeStamp() + "." + lfr.logExt();
+}
+
+#endif //logger_tests_testIntLog_hpp
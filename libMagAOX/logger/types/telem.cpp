@@ -23,10 +23,12 @@ timespec telem_coretemps::lastRecord = {0,0};
 timespec telem_dmmodes::lastRecord = {0,0};
 timespec telem_dmspeck::lastRecord = {0,0};
 timespec telem_drivetemps::lastRecord = {0,0};
+timespec telem_fgstats::lastRecord = {0,0};
 timespec telem_fgtimings::lastRecord = {0,0};
 timespec telem_fsm::lastRecord = {0,0};
 timespec telem_fxngen::lastRecord = {0,0};
 timespec telem_loopgain::lastRecord = {0,0};
+timespec telem_logwrite::lastRecord = {0,0};
 timespec telem_observer::lastRecord = {0,0};
 timespec telem_pi335::lastRecord = {0,0};
 timespec telem_pico::lastRecord = {0,0};
@@ -0,0 +1,203 @@
+/** \file telem_fgstats.hpp
+  * \brief The MagAO-X logger telem_fgstats log type.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * \ingroup logger_types_files
+  *
+  * History:
+  * - 2026-10-17 created
+  */
+#ifndef logger_types_telem_fgstats_hpp
+#define logger_types_telem_fgstats_hpp
+
+#include "generated/telem_fgstats_generated.h"
+#include "flatbuffer_log.hpp"
+
+namespace MagAOX
+{
+namespace logger
+{
+
+
+/// Log entry recording framegrabber latency percentiles and frame accounting.
+/** The percentiles are over the interval since the previous entry.  The counts are totals since the app started.
+  *
+  * \ingroup logger_types
+  */
+struct telem_fgstats : public flatbuffer_log
+{
+   ///The event code
+   static const flatlogs::eventCodeT eventCode = eventCodes::TELEM_FGSTATS;
+
+   ///The default level
+   static const flatlogs::logPrioT defaultLevel = flatlogs::logPrio::LOG_TELEM;
+
+   static timespec lastRecord; ///< The timestamp of the last time this log was recorded.  Used by the telemetry system.
+
+   ///The type of the input message
+   struct messageT : public fbMessage
+   {
+      ///Construct from components
+      messageT( const double & copy_p50,     ///< [in] copy time 50th percentile [sec]
+                const double & copy_p99,     ///< [in] copy time 99th percentile [sec]
+                const double & copy_p999,    ///< [in] copy time 99.9th percentile [sec]
+                const double & copy_max,     ///< [in] copy time maximum [sec]
+                const double & aw_p50,       ///< [in] acquire to write time 50th percentile [sec]
+                const double & aw_p99,       ///< [in] acquire to write time 99th percentile [sec]
+                const double & aw_p999,      ///< [in] acquire to write time 99.9th percentile [sec]
+                const double & aw_max,       ///< [in] acquire to write time maximum [sec]
+                const uint64_t & acquires,   ///< [in] total calls to acquire a frame
+                const uint64_t & frames,     ///< [in] total frames written to the stream
+                const uint64_t & dropped,    ///< [in] total frames dropped, from gaps in the camera frame counter
+                const uint64_t & duplicated  ///< [in] total frames acquired more than once
+              )
+      {
+         auto fp = CreateTelem_fgstats_fb(builder, copy_p50, copy_p99, copy_p999, copy_max, aw_p50, aw_p99, aw_p999, aw_max, acquires, frames, dropped, duplicated);
+         builder.Finish(fp);
+      }
+
+   };
+
+   static bool verify( flatlogs::bufferPtrT & logBuff,  ///< [in] Buffer containing the flatbuffer serialized message.
+                       flatlogs::msgLenT len            ///< [in] length of msgBuffer.
+                     )
+   {
+      auto verifier = flatbuffers::Verifier( static_cast<uint8_t*>(flatlogs::logHeader::messageBuffer(logBuff)), static_cast<size_t>(len));
+      return VerifyTelem_fgstats_fbBuffer(verifier);
+   }
+
+   ///Get the message formatted for human consumption.
+   static std::string msgString( void * msgBuffer,  /**< [in] Buffer containing the flatbuffer serialized message.*/
+                                 flatlogs::msgLenT len  /**< [in] [unused] length of msgBuffer.*/
+                               )
+   {
+      static_cast<void>(len);
+
+      char buf[128];
+
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+
+      std::string msg = "[fgstats]";
+
+      snprintf(buf, sizeof(buf), " copy: %0.1f/%0.1f/%0.1f/%0.1f", fbs->copy_p50()*1e6, fbs->copy_p99()*1e6, fbs->copy_p999()*1e6, fbs->copy_max()*1e6);
+      msg += buf;
+
+      snprintf(buf, sizeof(buf), " acq-wrt: %0.1f/%0.1f/%0.1f/%0.1f", fbs->aw_p50()*1e6, fbs->aw_p99()*1e6, fbs->aw_p999()*1e6, fbs->aw_max()*1e6);
+      msg += buf;
+
+      msg += " usec p50/p99/p99.9/max";
+
+      msg += " acq: " + std::to_string(fbs->acquires());
+      msg += " frames: " + std::to_string(fbs->frames());
+      msg += " dropped: " + std::to_string(fbs->dropped());
+      msg += " dup: " + std::to_string(fbs->duplicated());
+
+      return msg;
+   }
+
+   static double copy_p50( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->copy_p50();
+   }
+
+   static double copy_p99( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->copy_p99();
+   }
+
+   static double copy_p999( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->copy_p999();
+   }
+
+   static double copy_max( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->copy_max();
+   }
+
+   static double aw_p50( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->aw_p50();
+   }
+
+   static double aw_p99( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->aw_p99();
+   }
+
+   static double aw_p999( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->aw_p999();
+   }
+
+   static double aw_max( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->aw_max();
+   }
+
+   static uint64_t acquires( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->acquires();
+   }
+
+   static uint64_t frames( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->frames();
+   }
+
+   static uint64_t dropped( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->dropped();
+   }
+
+   static uint64_t duplicated( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgstats_fb(msgBuffer);
+      return fbs->duplicated();
+   }
+
+   /// Get pointer to the accessor for a member by name
+   /**
+     * \returns the function pointer cast to void*
+     * \returns -1 for an unknown member
+     */
+   static logMetaDetail getAccessor( const std::string & member /**< [in] the name of the member */ )
+   {
+      if(member == "copy_p50") return logMetaDetail({"COPY P50", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&copy_p50)});
+      else if(member == "copy_p99") return logMetaDetail({"COPY P99", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&copy_p99)});
+      else if(member == "copy_p999") return logMetaDetail({"COPY P99.9", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&copy_p999)});
+      else if(member == "copy_max") return logMetaDetail({"COPY MAX", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&copy_max)});
+      else if(member == "aw_p50") return logMetaDetail({"ACQ-WRT P50", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&aw_p50)});
+      else if(member == "aw_p99") return logMetaDetail({"ACQ-WRT P99", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&aw_p99)});
+      else if(member == "aw_p999") return logMetaDetail({"ACQ-WRT P99.9", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&aw_p999)});
+      else if(member == "aw_max") return logMetaDetail({"ACQ-WRT MAX", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&aw_max)});
+      else if(member == "acquires") return logMetaDetail({"ACQUIRES", logMeta::valTypes::ULongLong, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&acquires)});
+      else if(member == "frames") return logMetaDetail({"FRAMES", logMeta::valTypes::ULongLong, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&frames)});
+      else if(member == "dropped") return logMetaDetail({"DROPPED", logMeta::valTypes::ULongLong, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&dropped)});
+      else if(member == "duplicated") return logMetaDetail({"DUPLICATED", logMeta::valTypes::ULongLong, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&duplicated)});
+      else
+      {
+         std::cerr << "No string member " << member << " in telem_fgstats\n";
+         return logMetaDetail();
+      }
+   }
+
+}; //telem_fgstats
+
+
+
+} //namespace logger
+} //namespace MagAOX
+
+#endif //logger_types_telem_fgstats_hpp
@@ -0,0 +1,140 @@
+/** \file telem_logwrite.hpp
+  * \brief The MagAO-X logger telem_logwrite log type.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * \ingroup logger_types_files
+  *
+  * History:
+  * - 2026-10-17 created
+  */
+#ifndef logger_types_telem_logwrite_hpp
+#define logger_types_telem_logwrite_hpp
+
+#include "generated/telem_logwrite_generated.h"
+#include "flatbuffer_log.hpp"
+
+namespace MagAOX
+{
+namespace logger
+{
+
+
+/// Log entry recording the write rates of the log and telemetry files.
+/** \ingroup logger_types
+  */
+struct telem_logwrite : public flatbuffer_log
+{
+   ///The event code
+   static const flatlogs::eventCodeT eventCode = eventCodes::TELEM_LOGWRITE;
+
+   ///The default level
+   static const flatlogs::logPrioT defaultLevel = flatlogs::logPrio::LOG_TELEM;
+
+   static timespec lastRecord; ///< The timestamp of the last time this log was recorded.  Used by the telemetry system.
+
+   ///The type of the input message
+   struct messageT : public fbMessage
+   {
+      ///Construct from components
+      messageT( const double & log_bytes_sec,    ///< [in] bytes per second written to the log file
+                const double & log_syscalls_sec, ///< [in] write and sync system calls per second for the log file
+                const double & tel_bytes_sec,    ///< [in] bytes per second written to the telemetry file
+                const double & tel_syscalls_sec  ///< [in] write and sync system calls per second for the telemetry file
+              )
+      {
+         auto fp = CreateTelem_logwrite_fb(builder, log_bytes_sec, log_syscalls_sec, tel_bytes_sec, tel_syscalls_sec);
+         builder.Finish(fp);
+      }
+
+   };
+
+   static bool verify( flatlogs::bufferPtrT & logBuff,  ///< [in] Buffer containing the flatbuffer serialized message.
+                       flatlogs::msgLenT len            ///< [in] length of msgBuffer.
+                     )
+   {
+      auto verifier = flatbuffers::Verifier( static_cast<uint8_t*>(flatlogs::logHeader::messageBuffer(logBuff)), static_cast<size_t>(len));
+      return VerifyTelem_logwrite_fbBuffer(verifier);
+   }
+
+   ///Get the message formatted for human consumption.
+   static std::string msgString( void * msgBuffer,  /**< [in] Buffer containing the flatbuffer serialized message.*/
+                                 flatlogs::msgLenT len  /**< [in] [unused] length of msgBuffer.*/
+                               )
+   {
+      static_cast<void>(len);
+
+      char buf[64];
+
+      auto fbs = GetTelem_logwrite_fb(msgBuffer);
+
+      std::string msg = "[logwrite]";
+
+      msg += " log: ";
+      snprintf(buf, sizeof(buf), "%0.1f", fbs->log_bytes_sec());
+      msg += buf;
+      msg += " B/s ";
+      snprintf(buf, sizeof(buf), "%0.1f", fbs->log_syscalls_sec());
+      msg += buf;
+      msg += " calls/s";
+
+      msg += " tel: ";
+      snprintf(buf, sizeof(buf), "%0.1f", fbs->tel_bytes_sec());
+      msg += buf;
+      msg += " B/s ";
+      snprintf(buf, sizeof(buf), "%0.1f", fbs->tel_syscalls_sec());
+      msg += buf;
+      msg += " calls/s";
+
+      return msg;
+   }
+
+   static double log_bytes_sec( void * msgBuffer )
+   {
+      auto fbs = GetTelem_logwrite_fb(msgBuffer);
+      return fbs->log_bytes_sec();
+   }
+
+   static double log_syscalls_sec( void * msgBuffer )
+   {
+      auto fbs = GetTelem_logwrite_fb(msgBuffer);
+      return fbs->log_syscalls_sec();
+   }
+
+   static double tel_bytes_sec( void * msgBuffer )
+   {
+      auto fbs = GetTelem_logwrite_fb(msgBuffer);
+      return fbs->tel_bytes_sec();
+   }
+
+   static double tel_syscalls_sec( void * msgBuffer )
+   {
+      auto fbs = GetTelem_logwrite_fb(msgBuffer);
+      return fbs->tel_syscalls_sec();
+   }
+
+   /// Get pointer to the accessor for a member by name
+   /**
+     * \returns the function pointer cast to void*
+     * \returns -1 for an unknown member
+     */
+   static logMetaDetail getAccessor( const std::string & member /**< [in] the name of the member */ )
+   {
+      if(member == "log_bytes_sec") return logMetaDetail({"LOG BYTES/SEC", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&log_bytes_sec)});
+      else if(member == "log_syscalls_sec") return logMetaDetail({"LOG SYSCALLS/SEC", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&log_syscalls_sec)});
+      else if(member == "tel_bytes_sec") return logMetaDetail({"TEL BYTES/SEC", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&tel_bytes_sec)});
+      else if(member == "tel_syscalls_sec") return logMetaDetail({"TEL SYSCALLS/SEC", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&tel_syscalls_sec)});
+      else
+      {
+         std::cerr << "No string member " << member << " in telem_logwrite\n";
+         return logMetaDetail();
+      }
+   }
+
+}; //telem_logwrite
+
+
+
+} //namespace logger
+} //namespace MagAOX
+
+#endif //logger_types_telem_logwrite_hpp
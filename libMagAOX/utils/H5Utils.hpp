@@ -56,6 +56,22 @@ struct H5AttributeT
    }
 };
 
+struct H5GroupT
+{
+   static herr_t close( hid_t & h )
+   {
+      return H5Gclose(h);
+   }
+};
+
+struct H5DatatypeT
+{
+   static herr_t close( hid_t & h )
+   {
+      return H5Tclose(h);
+   }
+};
+
 ///A somewhat smart HDF5 handle.
 /** Makes sure that the associated hdf5 library resources are closed when out of scope.
   * Does not do reference counting, so copy and assignment are deleted. Assignment operator from hid_t is the only way to
@@ -137,6 +153,12 @@ typedef H5Handle<H5PropertyT> H5Handle_P;
 ///Handle for an HDF5 attribute.
 typedef H5Handle<H5AttributeT> H5Handle_A;
 
+///Handle for an HDF5 group.
+typedef H5Handle<H5GroupT> H5Handle_G;
+
+///Handle for an HDF5 datatype.  Only for types created with e.g. H5Tcopy or H5Tvlen_create, not the predefined types.
+typedef H5Handle<H5DatatypeT> H5Handle_T;
+
 } //namespace utils
 } //namespace MagAOX
 
@@ -0,0 +1,169 @@
+/** \file latencyHistogram.hpp
+  * \brief A lock-free log-linear histogram for latency measurements.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * History:
+  * - 2026-10-17 created
+  */
+
+#ifndef utils_latencyHistogram_hpp
+#define utils_latencyHistogram_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace MagAOX
+{
+namespace utils
+{
+
+/// A histogram of latencies in nanoseconds, with log-linear buckets.
+/** Values below 2*subBuckets nanoseconds each get their own bucket.  Above that each power of two is split into
+  * subBuckets equal buckets, so the bucket width is never more than 1/subBuckets of its value (about 3%), from
+  * nanoseconds up to the full range of a uint64_t.  This is the bucketing of HdrHistogram.
+  *
+  * The histogram is for a single writer thread, which calls record() and never blocks.  Any number of other threads
+  * can read it at any time with snapshot().  The counts are never reset, so a reader gets the histogram over an
+  * interval by differencing two snapshots, which it can do with interval().
+  *
+  * \ingroup utils
+  */
+class latencyHistogram
+{
+public:
+   static constexpr unsigned subBits = 5; ///< The log2 of the number of buckets per power of two.
+   static constexpr uint64_t subBuckets = (1 << subBits); ///< The number of buckets per power of two.
+   static constexpr size_t nBuckets = 2*subBuckets + (63-subBits)*subBuckets; ///< The total number of buckets.
+
+protected:
+   std::atomic<uint64_t> m_counts[nBuckets]; ///< The count in each bucket.
+
+public:
+
+   /// Default c'tor.  Zeroes the counts.
+   latencyHistogram()
+   {
+      for(size_t n = 0; n < nBuckets; ++n) m_counts[n].store(0, std::memory_order_relaxed);
+   }
+
+   latencyHistogram( const latencyHistogram & ) = delete;
+   latencyHistogram & operator=( const latencyHistogram & ) = delete;
+
+   /// Get the bucket of a value
+   static size_t bucket( uint64_t val /**< [in] the value */)
+   {
+      if(val < 2*subBuckets) return val;
+
+      unsigned shift = (63 - __builtin_clzll(val)) - subBits;
+
+      return shift*subBuckets + (val >> shift);
+   }
+
+   /// Get the largest value in a bucket
+   static uint64_t bucketMax( size_t idx /**< [in] the bucket */)
+   {
+      if(idx < 2*subBuckets) return idx;
+
+      unsigned shift = idx/subBuckets - 1;
+      uint64_t mant = idx % subBuckets + subBuckets;
+
+      return ((mant + 1) << shift) - 1;
+   }
+
+   /// Record a value.  Only one thread may call this.
+   void record( uint64_t val /**< [in] the value, in nanoseconds */)
+   {
+      std::atomic<uint64_t> & c = m_counts[bucket(val)];
+
+      //There is only one writer, so this need not be a read-modify-write.
+      c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+   }
+
+   /// Copy the counts
+   /**
+     * \returns the total count
+     */
+   uint64_t snapshot( std::vector<uint64_t> & counts /**< [out] the count in each bucket, resized to nBuckets */) const
+   {
+      counts.resize(nBuckets);
+
+      uint64_t total = 0;
+      for(size_t n = 0; n < nBuckets; ++n)
+      {
+         counts[n] = m_counts[n].load(std::memory_order_relaxed);
+         total += counts[n];
+      }
+
+      return total;
+   }
+
+   /// Get the counts since the last call
+   /**
+     * \returns the total count in the interval
+     */
+   uint64_t interval( std::vector<uint64_t> & counts, ///< [out] the count in each bucket during the interval
+                      std::vector<uint64_t> & last    ///< [in/out] the snapshot at the start of the interval, updated to the end.  Empty for the first call.
+                    ) const
+   {
+      snapshot(counts);
+      last.resize(nBuckets, 0);
+
+      uint64_t total = 0;
+      for(size_t n = 0; n < nBuckets; ++n)
+      {
+         uint64_t c = counts[n];
+         counts[n] = c - last[n];
+         last[n] = c;
+         total += counts[n];
+      }
+
+      return total;
+   }
+
+   /// Get a percentile from a set of counts
+   /** The answer is the largest value in the bucket containing the percentile, so it is never an underestimate.
+     *
+     * \returns the value below which the fraction q of the counts lie, in nanoseconds
+     * \returns 0 if the total is 0
+     */
+   static uint64_t percentile( const std::vector<uint64_t> & counts, ///< [in] the counts, from snapshot() or interval()
+                               uint64_t total,                       ///< [in] the total of counts
+                               double q                              ///< [in] the fraction, e.g. 0.99 for the 99th percentile
+                             )
+   {
+      if(total == 0) return 0;
+
+      uint64_t rank = q*total;
+      if(rank >= total) rank = total - 1;
+
+      uint64_t sum = 0;
+      for(size_t n = 0; n < counts.size(); ++n)
+      {
+         sum += counts[n];
+         if(sum > rank) return bucketMax(n);
+      }
+
+      return bucketMax(counts.size()-1);
+   }
+
+   /// Get the largest value recorded in a set of counts
+   /**
+     * \returns the largest value in the highest non-empty bucket, in nanoseconds
+     * \returns 0 if all buckets are empty
+     */
+   static uint64_t max( const std::vector<uint64_t> & counts /**< [in] the counts, from snapshot() or interval() */)
+   {
+      for(size_t n = counts.size(); n > 0; --n)
+      {
+         if(counts[n-1] > 0) return bucketMax(n-1);
+      }
+
+      return 0;
+   }
+};
+
+} //namespace utils
+} //namespace MagAOX
+
+#endif //utils_latencyHistogram_hpp
@@ -0,0 +1,112 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "../latencyHistogram.hpp"
+
+using namespace MagAOX::utils;
+
+SCENARIO( "Bucketing latencies", "[latencyHistogram]" )
+{
+   GIVEN("values across the range")
+   {
+      WHEN("values are small")
+      {
+         for(uint64_t v = 0; v < 2*latencyHistogram::subBuckets; ++v)
+         {
+            REQUIRE( latencyHistogram::bucket(v) == v );
+            REQUIRE( latencyHistogram::bucketMax(v) == v );
+         }
+      }
+
+      WHEN("values are large")
+      {
+         size_t last = latencyHistogram::bucket(63);
+         for(uint64_t v = 64; v < 1000000; v = v + v/7 + 1)
+         {
+            size_t b = latencyHistogram::bucket(v);
+
+            //Buckets increase with value, and the value is in its bucket
+            REQUIRE( b >= last );
+            REQUIRE( latencyHistogram::bucketMax(b) >= v );
+            REQUIRE( latencyHistogram::bucketMax(b-1) < v );
+
+            //The resolution is about 3%
+            REQUIRE( latencyHistogram::bucketMax(b) - v <= v/latencyHistogram::subBuckets );
+
+            last = b;
+         }
+
+         REQUIRE( latencyHistogram::bucket(UINT64_MAX) == latencyHistogram::nBuckets - 1 );
+         REQUIRE( latencyHistogram::bucketMax(latencyHistogram::nBuckets - 1) == UINT64_MAX );
+      }
+   }
+}
+
+SCENARIO( "Getting percentiles", "[latencyHistogram]" )
+{
+   GIVEN("a histogram of 1 to 1000 usec")
+   {
+      latencyHistogram h;
+
+      for(uint64_t v = 1; v <= 1000; ++v) h.record(v*1000);
+
+      std::vector<uint64_t> counts;
+      uint64_t total = h.snapshot(counts);
+      REQUIRE( total == 1000 );
+
+      WHEN("getting the median and the tail")
+      {
+         uint64_t p50 = latencyHistogram::percentile(counts, total, 0.5);
+         REQUIRE( p50 >= 501000 );
+         REQUIRE( p50 < 501000*1.04 );
+
+         uint64_t p99 = latencyHistogram::percentile(counts, total, 0.99);
+         REQUIRE( p99 >= 991000 );
+         REQUIRE( p99 < 991000*1.04 );
+
+         uint64_t mx = latencyHistogram::max(counts);
+         REQUIRE( mx >= 1000000 );
+         REQUIRE( mx < 1000000*1.04 );
+      }
+
+      WHEN("getting an interval")
+      {
+         std::vector<uint64_t> last;
+         REQUIRE( h.interval(counts, last) == 1000 );
+
+         for(int n = 0; n < 10; ++n) h.record(5000000);
+
+         total = h.interval(counts, last);
+         REQUIRE( total == 10 );
+         REQUIRE( latencyHistogram::percentile(counts, total, 0.5) >= 5000000 );
+         REQUIRE( latencyHistogram::percentile(counts, total, 0.5) < 5000000*1.04 );
+
+         REQUIRE( h.interval(counts, last) == 0 );
+         REQUIRE( latencyHistogram::percentile(counts, 0, 0.5) == 0 );
+         REQUIRE( latencyHistogram::max(counts) == 0 );
+      }
+   }
+
+   GIVEN("a reader running while the writer records")
+   {
+      latencyHistogram h;
+
+      std::thread writer([&h]()
+      {
+         for(uint64_t n = 0; n < 1000000; ++n) h.record(n % 10000);
+      });
+
+      std::vector<uint64_t> counts;
+      std::vector<uint64_t> last;
+      uint64_t total = 0;
+      for(int n = 0; n < 100; ++n) total += h.interval(counts, last);
+
+      writer.join();
+
+      total += h.interval(counts, last);
+      REQUIRE( total == 1000000 );
+   }
+}
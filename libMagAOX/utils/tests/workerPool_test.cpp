@@ -0,0 +1,69 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "../workerPool.hpp"
+
+using namespace MagAOX::utils;
+
+SCENARIO( "Splitting jobs across threads", "[workerPool]" )
+{
+   GIVEN("a pool")
+   {
+      workerPool wp;
+
+      WHEN("no workers are started")
+      {
+         REQUIRE( wp.nParts() == 1 );
+
+         std::vector<int> done(1, 0);
+         wp.run( [&done](size_t p){ ++done[p]; } );
+         REQUIRE( done[0] == 1 );
+      }
+
+      WHEN("workers are started")
+      {
+         wp.start(4);
+         REQUIRE( wp.nParts() == 4 );
+
+         //Each part is done once per job, and part 0 by the caller
+         std::vector<int> done(4, 0);
+         std::vector<std::thread::id> ids(4);
+         for(int j = 0; j < 100; ++j)
+         {
+            wp.run( [&done, &ids](size_t p){ ++done[p]; ids[p] = std::this_thread::get_id(); } );
+         }
+
+         for(size_t p = 0; p < done.size(); ++p) REQUIRE( done[p] == 100 );
+
+         REQUIRE( ids[0] == std::this_thread::get_id() );
+         for(size_t p = 1; p < ids.size(); ++p) REQUIRE( ids[p] != ids[0] );
+
+         //Restarting with fewer
+         wp.start(2);
+         REQUIRE( wp.nParts() == 2 );
+
+         std::vector<int> done2(2, 0);
+         wp.run( [&done2](size_t p){ ++done2[p]; } );
+         REQUIRE( done2[0] == 1 );
+         REQUIRE( done2[1] == 1 );
+
+         wp.stop();
+         REQUIRE( wp.nParts() == 1 );
+      }
+
+      WHEN("a worker is pinned")
+      {
+         wp.start(3, {0});
+
+         //Part 1 is pinned to CPU 0, part 2 is not pinned
+         std::vector<int> cpus(3, -1);
+         wp.run( [&cpus](size_t p){ cpus[p] = sched_getcpu(); } );
+
+         REQUIRE( cpus[1] == 0 );
+         REQUIRE( cpus[2] >= 0 );
+      }
+   }
+}
@@ -0,0 +1,171 @@
+/** \file workerPool.hpp
+  * \brief A pool of threads which each do a part of a job.
+  * \author Jared R. Males (jaredmales@gmail.com)
+  *
+  * History:
+  * - 2026-10-17 created
+  */
+
+#ifndef utils_workerPool_hpp
+#define utils_workerPool_hpp
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace MagAOX
+{
+namespace utils
+{
+
+/// A pool of threads which each do a part of a job, for splitting per-frame calculations across cores.
+/** A job is a function of the part number.  run() calls it once for each part, with the calling thread doing
+  * part 0 and the workers the rest, and returns when all parts are done.  The workers wait on a condition
+  * variable between jobs, so an idle pool uses no CPU.
+  *
+  * The workers can be pinned to CPUs, so that per-frame work does not migrate between cores.  The caller,
+  * which does part 0, is not pinned by the pool.
+  *
+  * run() is for one thread at a time, and must not be called during start() or stop().
+  *
+  * \ingroup utils
+  */
+class workerPool
+{
+public:
+   typedef std::function<void(size_t)> jobT; ///< The job type, called with the part number
+
+protected:
+   std::vector<std::thread> m_threads; ///< The workers, one fewer than the parts
+   std::mutex m_mutex; ///< Protects the pool state
+   std::condition_variable m_cvStart; ///< Signals the workers to start a job
+   std::condition_variable m_cvDone; ///< Signals the caller that a worker is done
+   uint64_t m_gen {0}; ///< Incremented for each job
+   size_t m_pending {0}; ///< The number of workers still working on the job
+   bool m_stop {false}; ///< Tells the workers to exit
+   const jobT * m_job {nullptr}; ///< The current job
+
+public:
+
+   /// Default c'tor.  The pool has one part, done by the caller.
+   workerPool()
+   {
+   }
+
+   /// Destructor.  Stops the workers.
+   ~workerPool()
+   {
+      stop();
+   }
+
+   workerPool( const workerPool & ) = delete;
+   workerPool & operator=( const workerPool & ) = delete;
+
+   /// Start the workers, stopping any already started
+   void start( size_t nParts,                       ///< [in] the number of parts in each job, including the caller's.  0 is taken as 1.
+               const std::vector<int> & cpus = {}   /**< [in] [optional] the CPU to pin each worker to, for parts 1, 2, ....  Workers
+                                                                         beyond the end are not pinned.*/
+             )
+   {
+      stop();
+
+      m_stop = false;
+      m_gen = 0;
+      for(size_t n = 1; n < nParts; ++n)
+      {
+         m_threads.emplace_back(&workerPool::worker, this, n);
+
+         if(n-1 < cpus.size())
+         {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(cpus[n-1], &cpuset);
+
+            int rv = pthread_setaffinity_np(m_threads.back().native_handle(), sizeof(cpuset), &cpuset);
+            if(rv != 0)
+            {
+               std::cerr << __FILE__ << " " << __LINE__ << " pthread_setaffinity_np failed for cpu " << cpus[n-1] << ": " << rv << "\n";
+            }
+         }
+      }
+   }
+
+   /// Stop the workers.  Jobs are then done entirely by the caller.
+   void stop()
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         m_stop = true;
+      }
+      m_cvStart.notify_all();
+
+      for(size_t n = 0; n < m_threads.size(); ++n) m_threads[n].join();
+      m_threads.clear();
+   }
+
+   /// Get the number of parts in each job
+   size_t nParts() const
+   {
+      return m_threads.size() + 1;
+   }
+
+   /// Do a job, returning when all parts are done
+   void run( const jobT & job /**< [in] the job, called once with each part number */)
+   {
+      if(m_threads.size() == 0)
+      {
+         job(0);
+         return;
+      }
+
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         m_job = &job;
+         m_pending = m_threads.size();
+         ++m_gen;
+      }
+      m_cvStart.notify_all();
+
+      job(0);
+
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cvDone.wait(lock, [this]{ return m_pending == 0; });
+      m_job = nullptr;
+   }
+
+protected:
+
+   /// The thread function of the workers
+   void worker( size_t part /**< [in] the part this worker does */)
+   {
+      uint64_t gen = 0;
+
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while(1)
+      {
+         m_cvStart.wait(lock, [this, gen]{ return m_stop || m_gen != gen; });
+         if(m_stop) return;
+
+         gen = m_gen;
+         const jobT * job = m_job;
+
+         lock.unlock();
+         (*job)(part);
+         lock.lock();
+
+         if(--m_pending == 0) m_cvDone.notify_one();
+      }
+   }
+};
+
+} //namespace utils
+} //namespace MagAOX
+
+#endif //utils_workerPool_hpp
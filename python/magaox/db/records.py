@@ -81,9 +81,10 @@ class Telem:
 
     @classmethod
     def from_json(cls, device, json_str):
+        # device is None for output of logdump following many devices, which gives it as "app"
         payload = _parse_msg_json(json_str)
         return cls(
-            device=device,
+            device=device if device is not None else payload['app'],
             ts=parse_iso_datetime_as_utc(payload['ts']),
             ec=payload['ec'],
             msg=payload['msg'],
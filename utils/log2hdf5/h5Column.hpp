@@ -0,0 +1,291 @@
+/** \file h5Column.hpp
+  * \brief A typed, chunked, appendable HDF5 column.
+  *
+  * \ingroup log2hdf5_files
+  */
+
+#ifndef log2hdf5_h5Column_hpp
+#define log2hdf5_h5Column_hpp
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <hdf5.h>
+
+#include "../../libMagAOX/utils/H5Utils.hpp"
+
+/// The element types of an h5Column
+enum class h5ColType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Int64, UInt64, Float, Double, String };
+
+/// A single column of a table, written to a 1-D chunked and extendible HDF5 dataset.
+/** Rows are buffered in memory and appended to the dataset one chunk at a time, so memory use is bounded
+  * by the chunk size no matter how many rows are written.  A column holds either one value per row, or a
+  * variable length vector of values per row (stored as an HDF5 vlen type).  Strings are variable length
+  * HDF5 strings.
+  *
+  * Usage for each row is to push the value(s) and then call endRow().
+  *
+  * \ingroup log2hdf5
+  */
+class h5Column
+{
+protected:
+   std::string m_name; ///< The name of the dataset.
+   h5ColType m_type {h5ColType::Double}; ///< The element type.
+   bool m_vector {false}; ///< Whether each row is a variable length vector.
+   hsize_t m_chunkRows {4096}; ///< The number of rows in each chunk.
+
+   MagAOX::utils::H5Handle_D m_dataset; ///< The dataset.
+   MagAOX::utils::H5Handle_T m_memType; ///< The memory type, for vectors and strings.
+
+   std::vector<char> m_data; ///< The buffered element data.
+   std::vector<size_t> m_rowEnds; ///< The end of each buffered row in m_data, for vectors and strings.
+
+   hsize_t m_nRows {0}; ///< The number of buffered rows.
+   hsize_t m_written {0}; ///< The number of rows written to the dataset.
+
+public:
+
+   /// Get the size in bytes of an element type.
+   static size_t typeSize( h5ColType type /**< [in] the type */)
+   {
+      switch(type)
+      {
+         case h5ColType::Int8: case h5ColType::UInt8: return 1;
+         case h5ColType::Int16: case h5ColType::UInt16: return 2;
+         case h5ColType::Int32: case h5ColType::UInt32: case h5ColType::Float: return 4;
+         case h5ColType::Int64: case h5ColType::UInt64: case h5ColType::Double: return 8;
+         default: return 1;
+      }
+   }
+
+   /// Get the native HDF5 type of a numeric element type.
+   static hid_t nativeType( h5ColType type /**< [in] the type */)
+   {
+      switch(type)
+      {
+         case h5ColType::Int8: return H5T_NATIVE_INT8;
+         case h5ColType::UInt8: return H5T_NATIVE_UINT8;
+         case h5ColType::Int16: return H5T_NATIVE_INT16;
+         case h5ColType::UInt16: return H5T_NATIVE_UINT16;
+         case h5ColType::Int32: return H5T_NATIVE_INT32;
+         case h5ColType::UInt32: return H5T_NATIVE_UINT32;
+         case h5ColType::Int64: return H5T_NATIVE_INT64;
+         case h5ColType::UInt64: return H5T_NATIVE_UINT64;
+         case h5ColType::Float: return H5T_NATIVE_FLOAT;
+         case h5ColType::Double: return H5T_NATIVE_DOUBLE;
+         default: return H5T_NATIVE_UINT8;
+      }
+   }
+
+   /// Create the dataset
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int create( hid_t group,                ///< [in] the group to create the dataset in
+               const std::string & name,   ///< [in] the name of the dataset
+               h5ColType type,             ///< [in] the element type
+               bool vector,                ///< [in] whether each row is a variable length vector
+               hsize_t chunkRows,          ///< [in] the number of rows in each chunk
+               int deflate                 ///< [in] the gzip compression level, 0 for none
+             )
+   {
+      m_name = name;
+      m_type = type;
+      m_vector = vector;
+      m_chunkRows = chunkRows;
+
+      if(m_type == h5ColType::String)
+      {
+         m_vector = false;
+         m_memType = H5Tcopy(H5T_C_S1);
+         H5Tset_size(m_memType, H5T_VARIABLE);
+         H5Tset_cset(m_memType, H5T_CSET_UTF8);
+      }
+      else if(m_vector)
+      {
+         m_memType = H5Tvlen_create(nativeType(m_type));
+      }
+
+      hsize_t dims = 0;
+      hsize_t maxdims = H5S_UNLIMITED;
+      MagAOX::utils::H5Handle_S space;
+      space = H5Screate_simple(1, &dims, &maxdims);
+
+      MagAOX::utils::H5Handle_P dcpl;
+      dcpl = H5Pcreate(H5P_DATASET_CREATE);
+      H5Pset_chunk(dcpl, 1, &m_chunkRows);
+
+      if(deflate > 0)
+      {
+         //Shuffling only helps fixed size elements.
+         if(!m_vector && m_type != h5ColType::String) H5Pset_shuffle(dcpl);
+         H5Pset_deflate(dcpl, deflate);
+      }
+
+      m_dataset = H5Dcreate2(group, m_name.c_str(), fileType(), space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+
+      if(m_dataset < 0)
+      {
+         std::cerr << "h5Column::create: error creating dataset " << m_name << "\n";
+         return -1;
+      }
+
+      m_data.reserve(m_chunkRows*typeSize(m_type));
+
+      return 0;
+   }
+
+   /// Get the dataset handle, e.g. to add attributes
+   hid_t dataset()
+   {
+      return m_dataset;
+   }
+
+   /// Push a numeric value, converting it to the column type
+   /** For a vector column this adds an element to the current row.
+     */
+   template<typename T>
+   void push( T val /**< [in] the value */)
+   {
+      switch(m_type)
+      {
+         case h5ColType::Int8: put<int8_t>(val); break;
+         case h5ColType::UInt8: put<uint8_t>(val); break;
+         case h5ColType::Int16: put<int16_t>(val); break;
+         case h5ColType::UInt16: put<uint16_t>(val); break;
+         case h5ColType::Int32: put<int32_t>(val); break;
+         case h5ColType::UInt32: put<uint32_t>(val); break;
+         case h5ColType::Int64: put<int64_t>(val); break;
+         case h5ColType::UInt64: put<uint64_t>(val); break;
+         case h5ColType::Float: put<float>(val); break;
+         case h5ColType::Double: put<double>(val); break;
+         default: break;
+      }
+   }
+
+   /// Push the value of a string column
+   void pushString( const char * str, ///< [in] the string, need not be null terminated
+                    size_t len        ///< [in] the length of the string
+                  )
+   {
+      m_data.insert(m_data.end(), str, str + len);
+   }
+
+   /// Finish the current row, writing a chunk if the buffer is full
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int endRow()
+   {
+      if(m_type == h5ColType::String) m_data.push_back('\0');
+
+      if(m_vector || m_type == h5ColType::String) m_rowEnds.push_back(m_data.size());
+
+      ++m_nRows;
+
+      if(m_nRows >= m_chunkRows) return flush();
+
+      return 0;
+   }
+
+   /// Write the buffered rows to the dataset
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int flush()
+   {
+      if(m_nRows == 0) return 0;
+
+      hsize_t newSize = m_written + m_nRows;
+      if(H5Dset_extent(m_dataset, &newSize) < 0)
+      {
+         std::cerr << "h5Column::flush: error extending " << m_name << "\n";
+         return -1;
+      }
+
+      MagAOX::utils::H5Handle_S fspace;
+      fspace = H5Dget_space(m_dataset);
+      H5Sselect_hyperslab(fspace, H5S_SELECT_SET, &m_written, NULL, &m_nRows, NULL);
+
+      MagAOX::utils::H5Handle_S mspace;
+      mspace = H5Screate_simple(1, &m_nRows, NULL);
+
+      herr_t rv;
+
+      if(m_type == h5ColType::String)
+      {
+         std::vector<const char *> ptrs(m_nRows);
+         size_t st = 0;
+         for(size_t n = 0; n < m_nRows; ++n)
+         {
+            ptrs[n] = m_data.data() + st;
+            st = m_rowEnds[n];
+         }
+         rv = H5Dwrite(m_dataset, m_memType, mspace, fspace, H5P_DEFAULT, ptrs.data());
+      }
+      else if(m_vector)
+      {
+         size_t esz = typeSize(m_type);
+         std::vector<hvl_t> vls(m_nRows);
+         size_t st = 0;
+         for(size_t n = 0; n < m_nRows; ++n)
+         {
+            vls[n].len = (m_rowEnds[n] - st)/esz;
+            vls[n].p = m_data.data() + st;
+            st = m_rowEnds[n];
+         }
+         rv = H5Dwrite(m_dataset, m_memType, mspace, fspace, H5P_DEFAULT, vls.data());
+      }
+      else
+      {
+         rv = H5Dwrite(m_dataset, nativeType(m_type), mspace, fspace, H5P_DEFAULT, m_data.data());
+      }
+
+      if(rv < 0)
+      {
+         std::cerr << "h5Column::flush: error writing " << m_name << "\n";
+         return -1;
+      }
+
+      m_written = newSize;
+      m_nRows = 0;
+      m_data.clear();
+      m_rowEnds.clear();
+
+      return 0;
+   }
+
+   /// Get the number of rows, including those not yet written
+   hsize_t rows()
+   {
+      return m_written + m_nRows;
+   }
+
+protected:
+
+   /// Get the type of the dataset in the file
+   hid_t fileType()
+   {
+      if(m_type == h5ColType::String || m_vector) return m_memType;
+
+      return nativeType(m_type);
+   }
+
+   /// Append a value to the buffer as type S
+   template<typename S, typename T>
+   void put( T val )
+   {
+      S s = static_cast<S>(val);
+      size_t st = m_data.size();
+      m_data.resize(st + sizeof(S));
+      memcpy(m_data.data() + st, &s, sizeof(S));
+   }
+};
+
+#endif //log2hdf5_h5Column_hpp
@@ -0,0 +1,17 @@
+/** \file log2hdf5.cpp
+  * \brief A utility to export MagAO-X binary telemetry logs to columnar HDF5 tables.
+  *
+  * \ingroup log2hdf5_files
+  */
+
+#include "log2hdf5.hpp"
+
+
+
+int main(int argc, char **argv)
+{
+   log2hdf5 l2h;
+
+   return l2h.main(argc, argv);
+
+}
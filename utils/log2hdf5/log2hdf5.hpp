@@ -0,0 +1,602 @@
+/** \file log2hdf5.hpp
+  * \brief A utility to export MagAO-X binary telemetry logs to columnar HDF5 tables.
+  *
+  * \ingroup log2hdf5_files
+  */
+
+#ifndef log2hdf5_hpp
+#define log2hdf5_hpp
+
+#include <iostream>
+#include <cstring>
+#include <memory>
+#include <map>
+#include <algorithm>
+
+#include <hdf5.h>
+
+#include <flatbuffers/reflection.h>
+
+#include <mx/ioutils/fileUtils.hpp>
+
+#include "../../libMagAOX/libMagAOX.hpp"
+using namespace MagAOX::logger;
+
+using namespace flatlogs;
+
+#include "h5Column.hpp"
+
+/** \defgroup log2hdf5 log2hdf5: MagAO-X Telemetry Exporter
+  * \brief Export MagAO-X binary telemetry logs to HDF5 tables.
+  *
+  * <a href="../handbook/utils/log2hdf5.html">Utility Documentation</a>
+  *
+  * \ingroup utils
+  *
+  */
+
+/** \defgroup log2hdf5_files log2hdf5 Files
+  * \ingroup log2hdf5
+  */
+
+/// An application to export MagAO-X binary telemetry logs to columnar HDF5 tables.
+/** Each (application, event code) pair becomes an HDF5 group `/<app>/<log type>` holding one dataset per
+  * column, all with one row per log entry.  The `time` column holds the entry timestamp as nanoseconds since
+  * the Unix epoch.  The other columns are found from the flatbuffers binary schema of the log type, with one
+  * typed column per field:
+  * - scalars are stored in their native type (bool as uint8),
+  * - strings are variable length strings,
+  * - vectors of scalars are variable length arrays, one per row,
+  * - sub-tables are flattened, so field `xcen` of table `roi` becomes column `roi.xcen`.
+  *
+  * Fields which are structs, unions, or vectors of non-scalars are skipped.
+  *
+  * The columns are chunked, compressed, and written one chunk at a time as the log files are read, so memory
+  * use is bounded by the chunk size and the number of columns no matter how much data is converted.
+  *
+  * \ingroup log2hdf5
+  */
+class log2hdf5 : public mx::app::application
+{
+protected:
+
+   std::string m_dir; ///< The directory to search for logs.
+   std::string m_ext; ///< The extension of log files.
+   std::string m_file; ///< A single file to convert.
+
+   std::vector<std::string> m_prefixes; ///< The applications to convert.
+
+   size_t m_nfiles {0}; ///< Number of files to convert per application, the most recent.  Default is 0, all.
+
+   std::vector<eventCodeT> m_codes; ///< The event codes to convert.  If empty, all telemetry codes are converted.
+
+   std::string m_output; ///< The output file name.
+
+   hsize_t m_chunkRows {4096}; ///< The number of rows in each chunk.  Default is 4096.
+
+   int m_compress {4}; ///< The gzip compression level.  0 means no compression.  Default is 4.
+
+   /// A column holding one field of a log type.
+   struct fieldColumn
+   {
+      std::vector<const reflection::Field *> m_path; ///< The sub-table fields leading to the field, then the field itself.
+      reflection::BaseType m_baseType {reflection::None}; ///< The base type of the field, or of the elements of a vector.
+      bool m_vector {false}; ///< Whether the field is a vector.
+      h5Column m_col; ///< The column.
+   };
+
+   /// The table for one event code of one application.
+   struct logTable
+   {
+      MagAOX::utils::H5Handle_G m_group; ///< The group holding the columns.
+      const reflection::Schema * m_schema {nullptr}; ///< The schema of the log type, or nullptr for empty logs.
+      h5Column m_time; ///< The timestamps.
+      std::vector<std::unique_ptr<fieldColumn>> m_fields; ///< The field columns.
+   };
+
+   MagAOX::utils::H5Handle_F m_h5file; ///< The output file.
+
+   std::map<eventCodeT, std::unique_ptr<logTable>> m_tables; ///< The tables of the application being converted.
+
+   /// Get the column type for a flatbuffers base type
+   /**
+     * \returns 0 on success
+     * \returns -1 if the type can not be stored in a column
+     */
+   static int columnType( h5ColType & type,            ///< [out] the column type
+                          reflection::BaseType baseType ///< [in] the flatbuffers type
+                        );
+
+   /// Add the columns for the fields of a table, recursing into sub-tables
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int addColumns( logTable & tab,                                ///< [in/out] the table
+                   const reflection::Object * obj,                ///< [in] the flatbuffers table type
+                   std::vector<const reflection::Field *> & path, ///< [in/out] the path to obj
+                   const std::string & prefix                     ///< [in] the prefix for the column names
+                 );
+
+   /// Get the table for an event code, creating it if needed
+   /**
+     * \returns a pointer to the table
+     * \returns nullptr on error
+     */
+   logTable * getTable( hid_t appGroup, ///< [in] the group of the application
+                        eventCodeT ec   ///< [in] the event code
+                      );
+
+   /// Add a row to a table from a log entry
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int addRow( logTable & tab,   ///< [in/out] the table
+               char * logEntry   ///< [in] the log entry
+             );
+
+   /// Push one field value to its column
+   void pushField( fieldColumn & fc,               ///< [in/out] the column
+                   const flatbuffers::Table * root ///< [in] the root table of the entry
+                 );
+
+   /// Convert the log files of one application
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int convertApp( const std::string & app,              ///< [in] the application name, used for the group
+                   const std::vector<std::string> & logs ///< [in] the files, in time order
+                 );
+
+   /// Write a string attribute
+   static int writeAttribute( hid_t obj,                 ///< [in] the object to attach the attribute to
+                              const std::string & name,  ///< [in] the name of the attribute
+                              const std::string & value  ///< [in] the value of the attribute
+                            );
+
+   /// Write an integer attribute
+   static int writeAttribute( hid_t obj,                ///< [in] the object to attach the attribute to
+                              const std::string & name, ///< [in] the name of the attribute
+                              int64_t value             ///< [in] the value of the attribute
+                            );
+
+public:
+   virtual void setupConfig();
+
+   virtual void loadConfig();
+
+   virtual int execute();
+
+};
+
+inline
+void log2hdf5::setupConfig()
+{
+   config.add("dir","d", "dir" , argType::Required, "", "dir", false,  "string", "Directory to search for logs. Default is the MagAO-X telemetry directory.");
+   config.add("ext","e", "ext" , argType::Required, "", "ext", false,  "string", "The file extension of log files.  Default is .bintel, the telemetry extension.");
+   config.add("nfiles","n", "nfiles" , argType::Required, "", "nfiles", false,  "int", "Number of log files to convert per application, the most recent.  If 0, then all matching files are converted.  Default: 0.");
+   config.add("code","C", "code" , argType::Required, "", "code", false,  "int", "The event code, or vector of codes, to convert.  If not specified, all telemetry codes are converted.  See logCodes.hpp for a complete list of codes.");
+   config.add("file","F", "file" , argType::Required, "", "file", false,  "string", "A single file to convert.  If no / are found in name it will look in the specified directory (or MagAO-X default).");
+   config.add("output","o", "output" , argType::Required, "", "output", false,  "string", "The output HDF5 file.  Will be overwritten if it exists.");
+   config.add("chunkRows","", "chunkRows" , argType::Required, "", "chunkRows", false,  "int", "The number of rows in each HDF5 chunk.  This sets the memory used per column.  Default: 4096.");
+   config.add("compress","z", "compress" , argType::Required, "", "compress", false,  "int", "The gzip compression level, 0-9.  0 means no compression.  Default: 4.");
+}
+
+inline
+void log2hdf5::loadConfig()
+{
+   //Get default log dir
+   std::string tmpstr = mx::sys::getEnv(MAGAOX_env_path);
+   if(tmpstr == "")
+   {
+      tmpstr = MAGAOX_path;
+   }
+   m_dir = tmpstr +  "/" + MAGAOX_telRelPath;
+
+   //Now check for config option for dir
+   config(m_dir, "dir");
+
+   m_ext = ".bintel";
+   config(m_ext, "ext");
+
+   config(m_file, "file");
+
+   if(m_file == "" && config.nonOptions.size() < 1)
+   {
+      std::cerr << "log2hdf5: need application name. Try log2hdf5 -h for help.\n";
+   }
+
+   m_prefixes.resize(config.nonOptions.size());
+   for(size_t i=0;i<config.nonOptions.size(); ++i)
+   {
+      m_prefixes[i] = config.nonOptions[i];
+   }
+
+   config(m_nfiles, "nfiles");
+   config(m_codes, "code");
+   config(m_output, "output");
+   config(m_chunkRows, "chunkRows");
+   config(m_compress, "compress");
+
+   if(m_output == "")
+   {
+      std::cerr << "log2hdf5: need an output file. Try log2hdf5 -h for help.\n";
+   }
+
+   if(m_chunkRows < 1) m_chunkRows = 1;
+   if(m_compress < 0) m_compress = 0;
+   if(m_compress > 9) m_compress = 9;
+}
+
+inline
+int log2hdf5::execute()
+{
+   if(m_file == "" && m_prefixes.size() == 0) return -1; //error message will have been printed in loadConfig.
+   if(m_output == "") return -1;
+
+   m_h5file = H5Fcreate(m_output.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+   if(m_h5file < 0)
+   {
+      std::cerr << "log2hdf5: error creating " << m_output << "\n";
+      return -1;
+   }
+
+   if(m_file != "")
+   {
+      if(m_file.find('/') == std::string::npos)
+      {
+         m_file = m_dir + '/' + m_file;
+      }
+
+      //The application name is the part of the file name before the timestamp
+      std::string app = mx::ioutils::pathFilename(m_file);
+      size_t us = app.rfind('_');
+      if(us != std::string::npos) app = app.substr(0, us);
+
+      return convertApp(app, std::vector<std::string>({m_file}));
+   }
+
+   for(size_t n = 0; n < m_prefixes.size(); ++n)
+   {
+      std::vector<std::string> logs = mx::ioutils::getFileNames( m_dir, m_prefixes[n], "", m_ext);
+
+      if(m_nfiles > 0 && m_nfiles < logs.size()) logs.erase(logs.begin(), logs.end() - m_nfiles);
+
+      if(convertApp(m_prefixes[n], logs) < 0) return -1;
+   }
+
+   return 0;
+}
+
+inline
+int log2hdf5::columnType( h5ColType & type,
+                          reflection::BaseType baseType
+                        )
+{
+   switch(baseType)
+   {
+      case reflection::Bool: type = h5ColType::UInt8; return 0;
+      case reflection::Byte: type = h5ColType::Int8; return 0;
+      case reflection::UByte: type = h5ColType::UInt8; return 0;
+      case reflection::Short: type = h5ColType::Int16; return 0;
+      case reflection::UShort: type = h5ColType::UInt16; return 0;
+      case reflection::Int: type = h5ColType::Int32; return 0;
+      case reflection::UInt: type = h5ColType::UInt32; return 0;
+      case reflection::Long: type = h5ColType::Int64; return 0;
+      case reflection::ULong: type = h5ColType::UInt64; return 0;
+      case reflection::Float: type = h5ColType::Float; return 0;
+      case reflection::Double: type = h5ColType::Double; return 0;
+      case reflection::String: type = h5ColType::String; return 0;
+      default: return -1;
+   }
+}
+
+inline
+int log2hdf5::addColumns( logTable & tab,
+                          const reflection::Object * obj,
+                          std::vector<const reflection::Field *> & path,
+                          const std::string & prefix
+                        )
+{
+   //The schema lists fields by name, we want them in declaration order.
+   std::vector<const reflection::Field *> fields(obj->fields()->begin(), obj->fields()->end());
+   std::sort(fields.begin(), fields.end(), [](const reflection::Field * a, const reflection::Field * b){ return a->id() < b->id(); });
+
+   for(const reflection::Field * field : fields)
+   {
+      if(field->deprecated()) continue;
+
+      std::string name = prefix + field->name()->str();
+
+      reflection::BaseType bt = field->type()->base_type();
+
+      if(bt == reflection::Obj)
+      {
+         const reflection::Object * sub = tab.m_schema->objects()->Get(field->type()->index());
+         if(sub->is_struct())
+         {
+            std::cerr << "log2hdf5: skipping struct field " << name << "\n";
+            continue;
+         }
+
+         path.push_back(field);
+         if(addColumns(tab, sub, path, name + ".") < 0) return -1;
+         path.pop_back();
+         continue;
+      }
+
+      bool vector = false;
+      if(bt == reflection::Vector)
+      {
+         vector = true;
+         bt = field->type()->element();
+      }
+
+      h5ColType type;
+      if(columnType(type, bt) < 0 || (vector && type == h5ColType::String))
+      {
+         //Unions and their type fields, and vectors of tables or strings
+         std::cerr << "log2hdf5: skipping field " << name << "\n";
+         continue;
+      }
+
+      std::unique_ptr<fieldColumn> fc(new fieldColumn);
+      fc->m_path = path;
+      fc->m_path.push_back(field);
+      fc->m_baseType = bt;
+      fc->m_vector = vector;
+
+      //Don't let a field hide the timestamps
+      if(name == "time") name = "time_";
+
+      if(fc->m_col.create(tab.m_group, name, type, vector, m_chunkRows, m_compress) < 0) return -1;
+
+      tab.m_fields.push_back(std::move(fc));
+   }
+
+   return 0;
+}
+
+inline
+log2hdf5::logTable * log2hdf5::getTable( hid_t appGroup,
+                                         eventCodeT ec
+                                       )
+{
+   auto it = m_tables.find(ec);
+   if(it != m_tables.end()) return it->second.get();
+
+   std::string typeName;
+   const uint8_t * bfbs;
+   unsigned int bfbsLen;
+
+   if(logSchema(typeName, bfbs, bfbsLen, ec) < 0)
+   {
+      std::cerr << "log2hdf5: unknown event code " << ec << "\n";
+      return nullptr;
+   }
+
+   std::unique_ptr<logTable> tab(new logTable);
+
+   tab->m_group = H5Gcreate2(appGroup, typeName.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+   if(tab->m_group < 0)
+   {
+      std::cerr << "log2hdf5: error creating group " << typeName << "\n";
+      return nullptr;
+   }
+
+   writeAttribute(tab->m_group, "eventCode", ec);
+
+   if(tab->m_time.create(tab->m_group, "time", h5ColType::Int64, false, m_chunkRows, m_compress) < 0) return nullptr;
+   writeAttribute(tab->m_time.dataset(), "units", "ns since 1970-01-01T00:00:00Z");
+
+   if(bfbs != nullptr)
+   {
+      flatbuffers::Verifier verifier(bfbs, bfbsLen);
+      if(!reflection::VerifySchemaBuffer(verifier))
+      {
+         std::cerr << "log2hdf5: invalid binary schema for " << typeName << "\n";
+         return nullptr;
+      }
+
+      tab->m_schema = reflection::GetSchema(bfbs);
+
+      std::vector<const reflection::Field *> path;
+      if(addColumns(*tab, tab->m_schema->root_table(), path, "") < 0) return nullptr;
+   }
+
+   logTable * tp = tab.get();
+   m_tables.emplace(ec, std::move(tab));
+
+   return tp;
+}
+
+inline
+void log2hdf5::pushField( fieldColumn & fc,
+                          const flatbuffers::Table * root
+                        )
+{
+   //Walk down the sub-tables.  A missing sub-table gives the defaults.
+   const flatbuffers::Table * tab = root;
+   for(size_t n = 0; n < fc.m_path.size() - 1 && tab != nullptr; ++n)
+   {
+      tab = flatbuffers::GetFieldT(*tab, *fc.m_path[n]);
+   }
+
+   const reflection::Field & field = *fc.m_path.back();
+
+   if(fc.m_vector)
+   {
+      const flatbuffers::VectorOfAny * vec = (tab) ? flatbuffers::GetFieldAnyV(*tab, field) : nullptr;
+      if(vec == nullptr) return;
+
+      for(flatbuffers::uoffset_t i = 0; i < vec->size(); ++i)
+      {
+         if(fc.m_baseType == reflection::Float || fc.m_baseType == reflection::Double)
+         {
+            fc.m_col.push(flatbuffers::GetAnyVectorElemF(vec, fc.m_baseType, i));
+         }
+         else
+         {
+            fc.m_col.push(flatbuffers::GetAnyVectorElemI(vec, fc.m_baseType, i));
+         }
+      }
+      return;
+   }
+
+   if(fc.m_baseType == reflection::String)
+   {
+      const flatbuffers::String * str = (tab) ? flatbuffers::GetFieldS(*tab, field) : nullptr;
+      if(str) fc.m_col.pushString(str->c_str(), str->size());
+      return;
+   }
+
+   if(fc.m_baseType == reflection::Float || fc.m_baseType == reflection::Double)
+   {
+      if(tab) fc.m_col.push(flatbuffers::GetAnyFieldF(*tab, field));
+      else fc.m_col.push(field.default_real());
+      return;
+   }
+
+   if(tab) fc.m_col.push(flatbuffers::GetAnyFieldI(*tab, field));
+   else fc.m_col.push(field.default_integer());
+}
+
+inline
+int log2hdf5::addRow( logTable & tab,
+                      char * logEntry
+                    )
+{
+   timespecX ts = logHeader::timespec(logEntry);
+   tab.m_time.push( static_cast<int64_t>(ts.time_s)*1000000000 + ts.time_ns );
+   if(tab.m_time.endRow() < 0) return -1;
+
+   if(tab.m_schema == nullptr) return 0;
+
+   const flatbuffers::Table * root = flatbuffers::GetAnyRoot(reinterpret_cast<uint8_t *>(logHeader::messageBuffer(logEntry)));
+
+   for(size_t n = 0; n < tab.m_fields.size(); ++n)
+   {
+      pushField(*tab.m_fields[n], root);
+      if(tab.m_fields[n]->m_col.endRow() < 0) return -1;
+   }
+
+   return 0;
+}
+
+inline
+int log2hdf5::convertApp( const std::string & app,
+                          const std::vector<std::string> & logs
+                        )
+{
+   MagAOX::utils::H5Handle_G appGroup;
+   appGroup = H5Gcreate2(m_h5file, app.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+   if(appGroup < 0)
+   {
+      std::cerr << "log2hdf5: error creating group " << app << "\n";
+      return -1;
+   }
+
+   for(size_t n = 0; n < logs.size(); ++n)
+   {
+      logMappedFile lmf;
+      if(lmf.open(logs[n]) < 0) return -1;
+
+      std::cerr << logs[n] << "\n";
+
+      char * buffer = lmf.data();
+      while(buffer < lmf.end())
+      {
+         size_t tSz = logHeader::totalSize(buffer);
+
+         eventCodeT ec = logHeader::eventCode(buffer);
+
+         bool sel;
+         if(m_codes.size() == 0) sel = (logHeader::logLevel(buffer) == logPrio::LOG_TELEM);
+         else sel = (std::find(m_codes.begin(), m_codes.end(), ec) != m_codes.end());
+
+         if(!sel)
+         {
+            buffer += tSz;
+            continue;
+         }
+
+         //Non-owning pointer into the mapping, no copy needed.
+         bufferPtrT logBuff(bufferPtrT(), buffer);
+
+         if (!logVerify(ec, logBuff, logHeader::msgLen(buffer)))
+         {
+            std::cerr << "Log " << logs[n] << " failed verification on code=" << ec <<  " at byte=" << buffer - lmf.data() <<". File possibly corrupt.  Exiting." << std::endl;
+            return -1;
+         }
+
+         logTable * tab = getTable(appGroup, ec);
+         if(tab == nullptr) return -1;
+
+         if(addRow(*tab, buffer) < 0) return -1;
+
+         buffer += tSz;
+      }
+   }
+
+   //Write the partial chunks, and release this application's tables
+   for(auto & it : m_tables)
+   {
+      logTable & tab = *it.second;
+
+      if(tab.m_time.flush() < 0) return -1;
+      for(size_t n = 0; n < tab.m_fields.size(); ++n)
+      {
+         if(tab.m_fields[n]->m_col.flush() < 0) return -1;
+      }
+
+      std::cerr << app << "/" << it.first << ": " << tab.m_time.rows() << " rows\n";
+   }
+
+   m_tables.clear();
+
+   return 0;
+}
+
+inline
+int log2hdf5::writeAttribute( hid_t obj,
+                              const std::string & name,
+                              const std::string & value
+                            )
+{
+   MagAOX::utils::H5Handle_T type;
+   type = H5Tcopy(H5T_C_S1);
+   H5Tset_size(type, value.size() + 1);
+
+   MagAOX::utils::H5Handle_S space;
+   space = H5Screate(H5S_SCALAR);
+
+   MagAOX::utils::H5Handle_A attr;
+   attr = H5Acreate2(obj, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT);
+   if(attr < 0) return -1;
+
+   if(H5Awrite(attr, type, value.c_str()) < 0) return -1;
+
+   return 0;
+}
+
+inline
+int log2hdf5::writeAttribute( hid_t obj,
+                              const std::string & name,
+                              int64_t value
+                            )
+{
+   MagAOX::utils::H5Handle_S space;
+   space = H5Screate(H5S_SCALAR);
+
+   MagAOX::utils::H5Handle_A attr;
+   attr = H5Acreate2(obj, name.c_str(), H5T_NATIVE_INT64, space, H5P_DEFAULT, H5P_DEFAULT);
+   if(attr < 0) return -1;
+
+   if(H5Awrite(attr, H5T_NATIVE_INT64, &value) < 0) return -1;
+
+   return 0;
+}
+
+#endif //log2hdf5_hpp
@@ -8,7 +8,16 @@
 #define logdump_hpp
 
 #include <iostream>
+#include <sstream>
 #include <cstring>
+#include <cctype>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <atomic>
 
 #include <mx/ioutils/fileUtils.hpp>
 
@@ -47,8 +56,7 @@ protected:
    bool m_time {false};
    bool m_jsonMode {false};
 
-   unsigned long m_pauseTime {250}; ///When following, pause time to check for new data. msec. Default is 250 msec.
-   int m_fileCheckInterval {20}; ///When following, number of loops to wait before checking for a new file.  Default is 4.
+   double m_latency {0.25}; ///< When following, the time in seconds entries are held to merge the applications in time order.  Default is 0.25 sec.
 
    std::vector<std::string> m_prefixes;
 
@@ -60,15 +68,138 @@ protected:
 
    std::vector<eventCodeT> m_codes;
 
-   void printLogBuff( const logPrioT & lvl,
+   bool m_useStart {false}; ///< Whether or not a start time was specified.
+   timespecX m_start; ///< Only entries at or after this time are dumped, if m_useStart is true.
+
+   bool m_useEnd {false}; ///< Whether or not an end time was specified.
+   timespecX m_end; ///< Only entries before this time are dumped, if m_useEnd is true.
+
+   unsigned m_threads {0}; ///< Number of worker threads for parallel decoding.  Default is 0, which uses the serial path.
+
+   size_t m_chunkSize {1048576}; ///< The size in bytes of the file segments decoded by the worker threads.  Default is 1 MB.
+
+   /// Check if an entry passes the level, event code, and time filters.
+   bool selected( logPrioT lvl,
+                  eventCodeT ec,
+                  const timespecX & ts
+                );
+
+   /// Parse a time from a string
+   /** The digits of the string are read as YYYYMMDDHHMMSS followed by fractional seconds, so both the log
+     * file name format and ISO 8601 (e.g. 2023-01-31T23:59:59.5) are accepted.  The time is UTC.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int parseTime( timespecX & ts,         ///< [out] the parsed time
+                  const std::string & str ///< [in] the string to parse
+                );
+
+   void printLogBuff( std::ostream & os,
+                      const logPrioT & lvl,
                       const eventCodeT & ec,
+                      const msgLenT & len,
+                      bufferPtrT & logBuff,
+                      const std::string & appName = "" ///< [in] [optional] if not empty, printed before the entry
+                    );
+   void printLogJson( std::ostream & os,
                       const msgLenT & len,
                       bufferPtrT & logBuff
                     );
-   void printLogJson( const msgLenT & len,
+
+   /// Print an entry as JSON with an "app" member holding the application name.
+   void printLogJson( std::ostream & os,
+                      const std::string & appName,
+                      const msgLenT & len,
                       bufferPtrT & logBuff
                     );
 
+   /// Follow the logs of the applications, printing new entries as they are written.
+   /** A logFollower is notified of writes by inotify, so entries are printed as soon as they are written
+     * without polling.  The entries of all the applications are merged in time order, each being held at
+     * most m_latency seconds.  With no applications given all are followed, including ones which start
+     * later.
+     *
+     * Only returns on error.
+     *
+     * \returns -1 on error
+     */
+   int followLogs();
+
+   /// Dump a complete file which is not being followed.
+   /** The file is memory-mapped and the entries are printed in place, without copying.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int dumpMapped( const std::string & fname /**< [in] the full name of the file */);
+
+   /// A segment of a log file, decoded and formatted by a worker thread.
+   struct dumpSegment
+   {
+      logMappedFile * m_file {nullptr}; ///< The file containing the segment.
+      size_t m_begin {0}; ///< The offset of the first entry in the segment.
+      size_t m_end {0}; ///< The offset one past the last entry in the segment.
+
+      std::string m_text; ///< The formatted entries.
+      std::vector<timespecX> m_ts; ///< The timestamp of each formatted entry.
+      std::vector<size_t> m_ends; ///< The position in m_text one past the end of each formatted entry.
+
+      bool m_done {false}; ///< Set when the worker has finished the segment.
+      bool m_failed {false}; ///< Set if an entry failed verification, in which case m_text ends before it.
+      size_t m_failOffset {0}; ///< The offset of the entry which failed verification.
+      eventCodeT m_failCode {0}; ///< The event code of the entry which failed verification.
+   };
+
+   /// The segments of the files of one application, in time order.
+   struct dumpStream
+   {
+      std::vector<std::unique_ptr<logMappedFile>> m_files; ///< The mapped files.
+      std::vector<dumpSegment> m_segs; ///< The segments of all the files.
+      size_t m_nextStart {0}; ///< The next segment to give to a worker.
+      size_t m_nextConsume {0}; ///< The next segment to be merged into the output.
+   };
+
+   std::vector<dumpStream> m_streams; ///< The streams being merged in parallel mode.
+   size_t m_streamDepth {2}; ///< The maximum number of segments of a stream in progress or waiting to be merged.
+   bool m_stop {false}; ///< Tells the workers to stop.
+   std::mutex m_streamMutex; ///< Protects the stream state.
+   std::condition_variable m_streamCond; ///< Signals a change in the stream state.
+
+   /// Decode, filter, and format one segment.
+   void decodeSegment( dumpSegment & seg /**< [in/out] the segment */);
+
+   /// The worker thread loop.  Decodes segments until all are done or m_stop is set.
+   void segmentWorker();
+
+   /// Wait until the next segment of a stream with any entries is ready.
+   /**
+     * \returns 0 if a segment is ready
+     * \returns 1 if the stream is finished
+     * \returns -1 if the segment failed verification, after its entries have been output
+     */
+   int waitSegment( size_t s /**< [in] the stream */);
+
+   /// Release the current segment of a stream, which has been written
+   void releaseSegment( size_t s /**< [in] the stream */);
+
+   /// Print the error for a segment which failed verification
+   void reportFailure( const dumpSegment & seg /**< [in] the failed segment */);
+
+   /// Dump files in parallel, merging the applications in time order.
+   /** Each application's files form one stream, and the entries of all streams are merged by timestamp.
+     * The files are split into segments of about m_chunkSize bytes at entry boundaries (found from the
+     * index), which are filtered and formatted by m_threads worker threads.  Each stream has at most
+     * m_streamDepth segments in flight, so memory use is bounded regardless of how much data is dumped.
+     *
+     * For a single application the output is identical to the serial path.  Entries with equal timestamps
+     * in different applications are output in the order the applications were given.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int executeParallel( std::vector<std::vector<std::string>> & logs /**< [in] the files of each application, in time order*/);
+
 public:
    virtual void setupConfig();
 
@@ -82,26 +213,31 @@ public:
 
 void logdump::setupConfig()
 {
-   config.add("pauseTime","p", "pauseTime" , argType::Required, "", "pauseTime", false,  "int", "When following, time in milliseconds to pause before checking for new entries.");
-   config.add("fileCheckInterval","", "fileCheckInterval" , argType::Required, "", "fileCheckInterval", false,  "int", "When following, number of pause intervals between checks for new files.");
+   config.add("pauseTime","p", "pauseTime" , argType::Required, "", "pauseTime", false,  "int", "Not used.  Following is notified of new entries, and does not poll.");
+   config.add("fileCheckInterval","", "fileCheckInterval" , argType::Required, "", "fileCheckInterval", false,  "int", "Not used.  Following is notified of new files, and does not poll.");
+   config.add("latency","l", "latency" , argType::Required, "", "latency", false,  "real", "When following, the time in seconds entries are held so that the applications are merged in time order.  Default: 0.25.");
 
    config.add("dir","d", "dir" , argType::Required, "", "dir", false,  "string", "Directory to search for logs. MagAO-X default is normally used.");
    config.add("ext","e", "ext" , argType::Required, "", "ext", false,  "string", "The file extension of log files.  MagAO-X default is normally used.");
    config.add("nfiles","n", "nfiles" , argType::Required, "", "nfiles", false,  "int", "Number of log files to dump.  If 0, then all matching files dumped.  Default: 0, 1 if following.");
-   config.add("follow","f", "follow" , argType::True, "", "follow", false,  "bool", "Follow the log, printing new entries as they appear.");
+   config.add("follow","f", "follow" , argType::True, "", "follow", false,  "bool", "Follow the logs, printing new entries as they appear.  More than one application can be given, and if none are given all are followed.  Entries from the last 10 seconds, or since the start time, are printed first.");
    config.add("level","L", "level" , argType::Required, "", "level", false,  "int/string", "Minimum log level to dump, either an integer or a string. -1/TELEMETRY [the default], 0/DEFAULT, 1/D1/DBG1/DEBUG2, 2/D2/DBG2/DEBUG1,3/INFO,4/WARNING,5/ERROR,6/CRITICAL,7/FATAL.  Note that only the mininum unique string is required.");
    config.add("code","C", "code" , argType::Required, "", "code", false,  "int", "The event code, or vector of codes, to dump.  If not specified, all codes are dumped.  See logCodes.hpp for a complete list of codes.");
    config.add("file","F", "file" , argType::Required, "", "file", false,  "string", "A single file to process.  If no / are found in name it will look in the specified directory (or MagAO-X default).");
    config.add("time","T", "time" , argType::True, "", "time", false,  "bool", "time span mode: prints the ISO 8601 UTC timestamps of the first and last entry, the elapsed time in seconds, and the number of records in the file as a space-delimited string");
    config.add("json","J", "json" , argType::True, "", "json", false,  "bool", "JSON mode: emits one JSON document per line for each record in the log");
+   config.add("start","s", "start" , argType::Required, "", "start", false,  "string", "Only dump entries at or after this UTC time, either ISO 8601 (YYYY-MM-DDTHH:MM:SS.SSS) or YYYYMMDDHHMMSS.");
+   config.add("end","E", "end" , argType::Required, "", "end", false,  "string", "Only dump entries before this UTC time, either ISO 8601 (YYYY-MM-DDTHH:MM:SS.SSS) or YYYYMMDDHHMMSS.");
+   config.add("threads","j", "threads" , argType::Required, "", "threads", false,  "int", "Number of worker threads for parallel decoding.  In parallel mode more than one application can be given, and their logs are merged in time order.  Not used when following.  Default: 0, serial.");
+   config.add("chunkSize","", "chunkSize" , argType::Required, "", "chunkSize", false,  "int", "In parallel mode, the size in bytes of the file segments given to each thread.  Default: 1048576.");
 
 
 }
 
 void logdump::loadConfig()
 {
-   config(m_pauseTime, "pauseTime");
-   config(m_fileCheckInterval, "fileCheckInterval");
+   config(m_latency, "latency");
+   config(m_follow, "follow");
 
    //Get default log dir
    std::string tmpstr = mx::sys::getEnv(MAGAOX_env_path);
@@ -121,14 +257,17 @@ void logdump::loadConfig()
 
    config(m_file, "file");
 
-   if(m_file == "" && config.nonOptions.size() < 1)
+   if(m_file == "" && config.nonOptions.size() < 1 && !m_follow)
    {
       std::cerr << "logdump: need application name. Try logdump -h for help.\n";
    }
 
-   if(m_file == "" && config.nonOptions.size() > 1)
+   config(m_threads, "threads");
+   config(m_chunkSize, "chunkSize");
+
+   if(m_file == "" && config.nonOptions.size() > 1 && m_threads == 0 && !m_follow)
    {
-      std::cerr << "logdump: only one application at a time supported. Try logdump -h for help.\n";
+      std::cerr << "logdump: only one application at a time supported without --threads. Try logdump -h for help.\n";
    }
 
    m_prefixes.resize(config.nonOptions.size());
@@ -140,8 +279,6 @@ void logdump::loadConfig()
    if(config.isSet("time")) m_time = true;
    if(config.isSet("json")) m_jsonMode = true;
 
-   config(m_follow, "follow");
-
    if(m_follow) m_nfiles = 1; //default to 1 if follow is set.
    config(m_nfiles, "nfiles");
 
@@ -155,10 +292,56 @@ void logdump::loadConfig()
    config(m_codes, "code");
 
    std::cerr << m_codes.size() << "\n";
+
+   tmpstr = "";
+   config(tmpstr, "start");
+   if(tmpstr != "")
+   {
+      if(parseTime(m_start, tmpstr) < 0) std::cerr << "logdump: invalid start time: " << tmpstr << "\n";
+      else m_useStart = true;
+   }
+
+   tmpstr = "";
+   config(tmpstr, "end");
+   if(tmpstr != "")
+   {
+      if(parseTime(m_end, tmpstr) < 0) std::cerr << "logdump: invalid end time: " << tmpstr << "\n";
+      else m_useEnd = true;
+   }
 }
 
 int logdump::execute()
 {
+   if(m_follow && !m_time) return followLogs();
+
+   if(m_file == "" && m_prefixes.size() == 0) return -1; //error message will have been printed in loadConfig.
+
+   if(m_threads > 0 && !m_time)
+   {
+      std::vector<std::vector<std::string>> logs;
+
+      if(m_file != "")
+      {
+         if(m_file.find('/') == std::string::npos)
+         {
+            m_file = m_dir + '/' + m_file;
+         }
+         logs.push_back(std::vector<std::string>({m_file}));
+      }
+      else
+      {
+         for(size_t n = 0; n < m_prefixes.size(); ++n)
+         {
+            std::vector<std::string> flist = mx::ioutils::getFileNames( m_dir, m_prefixes[n], "", m_ext);
+
+            if(m_nfiles > 0 && m_nfiles < flist.size()) flist.erase(flist.begin(), flist.end() - m_nfiles);
+
+            logs.push_back(flist);
+         }
+      }
+
+      return executeParallel(logs);
+   }
 
    if(m_file == "" && m_prefixes.size() !=1 ) return -1; //error message will have been printed in loadConfig.
 
@@ -179,7 +362,6 @@ int logdump::execute()
       logs = mx::ioutils::getFileNames( m_dir, m_prefixes[0], "", m_ext);
    }
 
-   ///\todo if follow is set, then should nfiles default to 1 unless explicitly set?
    if(m_nfiles == 0)
    {
       m_nfiles = logs.size();
@@ -192,331 +374,652 @@ int logdump::execute()
       return gettimes(logs);
    }
 
-   bool firstRun = true; //for only showing latest entries on first run when following.
-   
    for(size_t i=logs.size() - m_nfiles; i < logs.size(); ++i)
    {
-      std::string fname = logs[i];
-      FILE * fin;
+      if(dumpMapped(logs[i]) < 0) return -1;
+   }
 
-      bufferPtrT head(new char[logHeader::maxHeadSize]);
+   return 0;
+}
 
-      bufferPtrT logBuff;
+inline
+void logdump::printLogBuff( std::ostream & os,
+                            const logPrioT & lvl,
+                            const eventCodeT & ec,
+                            const msgLenT & len,
+                            bufferPtrT & logBuff,
+                            const std::string & appName
+                          )
+{
+   static_cast<void>(len); //be unused
 
-      fin = fopen(fname.c_str(), "rb");
+   if(ec == eventCodes::GIT_STATE)
+   {
+      if(git_state::repoName(logHeader::messageBuffer(logBuff)) == "MagAOX")
+      {
+         for(int i=0;i<80;++i) os << '-';
+         os << "\n\t\t\t\t SOFTWARE RESTART\n";
+         for(int i=0;i<80;++i) os << '-';
+         os << '\n';
+      }
 
-      //--> get size here!!
-      off_t finSize = mx::ioutils::fileSize( fileno(fin) );
-      
-      std::cerr << fname << "\n";
+   }
 
-      off_t totNrd = 0;
-      
-      size_t buffSz = 0;
-      while(!feof(fin)) //<--This should be an exit condition controlled by loop logic, not feof.
+   if(lvl < logPrio::LOG_INFO)
+   {
+      if(lvl == logPrio::LOG_EMERGENCY)
       {
-         int nrd;
+         os << "\033[104m\033[91m\033[5m\033[1m";
+      }
 
-         ///\todo check for errors on all reads . . .
-         
-         //Read next header
-         nrd = fread( head.get(), sizeof(char), logHeader::minHeadSize, fin);
-         if(nrd == 0)
-         {
-            //If we're following and on the last log file, wait for more to show up.
-            if( m_follow == true  && i == logs.size()-1)
-            {
-               int check = 0;
-               firstRun = false; //from now on we show all logs
-               while(nrd == 0)
-               {
-                  std::this_thread::sleep_for( std::chrono::duration<unsigned long, std::milli>(m_pauseTime));
-                  clearerr(fin);
-                  nrd = fread( head.get(), sizeof(char), logHeader::minHeadSize, fin);
-                  if(nrd > 0) break;
-
-                  ++check;
-                  if(check >= m_fileCheckInterval)
-                  {
-                     //Check if a new file exists now.
-                     size_t oldsz = logs.size();
-                     logs = mx::ioutils::getFileNames( m_dir, m_prefixes[0], "", m_ext);
-                     if(logs.size() > oldsz)
-                     {
-                        //new file(s) detected;
-                        break;
-                     }
-                     check = 0;
-                  }
-               }
-            }
-            else
-            {
-               break;
-            }
-         }
+      if(lvl == logPrio::LOG_ALERT)
+      {
+         os << "\033[101m\033[5m";
+      }
 
-         //We got here without any data, probably means time to get a new file.
-         if(nrd == 0) break;
+      if(lvl == logPrio::LOG_CRITICAL)
+      {
+         os << "\033[41m\033[1m";
+      }
 
-         totNrd += nrd;
-         
-         if( logHeader::msgLen0(head) == logHeader::MAX_LEN0-1)
-         {
-            //Intermediate size message, read two more bytes
-            nrd = fread( head.get() + logHeader::minHeadSize, sizeof(char), sizeof(msgLen1T), fin);
-         }
-         else if( logHeader::msgLen0(head) == logHeader::MAX_LEN0)
-         {
-            //Large size message: read 8 more bytes
-            nrd = fread( head.get() + logHeader::minHeadSize, sizeof(char), sizeof(msgLen2T), fin);
-         }
+      if(lvl == logPrio::LOG_ERROR)
+      {
+         os << "\033[91m\033[1m";
+      }
 
-         logPrioT lvl = logHeader::logLevel(head);
-         eventCodeT ec = logHeader::eventCode(head);
-         msgLenT len = logHeader::msgLen(head);
+      if(lvl == logPrio::LOG_WARNING)
+      {
+         os << "\033[93m\033[1m";
+      }
 
-         //Here: check if lvl, eventCode, etc, match what we want.
-         //If not, fseek and loop.
-         if(lvl > m_level)
-         {
-            fseek(fin, len, SEEK_CUR);
-            continue;
-         }
+      if(lvl == logPrio::LOG_NOTICE)
+      {
+         os << "\033[1m";
+      }
 
+   }
 
-         if(m_codes.size() > 0)
-         {
-            bool found = false;
-            for(size_t c = 0; c< m_codes.size(); ++c)
-            {
-               if( m_codes[c] == ec )
-               {
-                  found = true;
-                  break;
-               }
-            }
+   if(appName != "") os << appName << " ";
 
-            if(!found)
-            {
-               fseek(fin, len, SEEK_CUR);
-               continue;
-            }
-         }
+   logStdFormat( os, logBuff);
 
-         size_t hSz = logHeader::headerSize(head);
+   os << "\033[0m";
+   os << std::endl;
+}
 
-         if( (size_t) hSz + (size_t) len > buffSz )
-         {
-            logBuff = bufferPtrT(new char[hSz + len]);
-         }
-         memcpy( logBuff.get(), head.get(), hSz);
 
-         ///\todo what do we do if nrd not equal to expected size?
-         nrd = fread( logBuff.get() + hSz, sizeof(char), len, fin);
-         // If not following, exit loop without printing the incomplete log entry (go on to next file).cd
-         // If following, wait for it, but also be checking for new log file in case of crash
+inline
+void logdump::printLogJson( std::ostream & os,
+                            const msgLenT & len,
+                            bufferPtrT & logBuff
+                          )
+{
+   static_cast<void>(len); //be unused
+   logJsonFormat(os, logBuff);
+   os << std::endl;
+
+}
 
-         totNrd += nrd;
-         
-         if(m_follow && firstRun && finSize > 512 && totNrd < finSize-512) 
-         {
-            //firstRun = false;
-            continue;
-         }
+inline
+void logdump::printLogJson( std::ostream & os,
+                            const std::string & appName,
+                            const msgLenT & len,
+                            bufferPtrT & logBuff
+                          )
+{
+   static_cast<void>(len); //be unused
 
-         if (!logVerify(ec, logBuff, len))
-         {
-            std::cerr << "Log " << fname << " failed verification on code=" << ec <<  " at byte=" << totNrd-len-hSz <<". File possibly corrupt.  Exiting." << std::endl;
-            return -1;
-         }
+   std::ostringstream js;
+   logJsonFormat(js, logBuff);
+
+   //Insert the app as the first member
+   std::string str = js.str();
+   os << "{\"app\": \"" << appName << "\", ";
+   os.write(str.data() + 1, str.size() - 1);
+   os << std::endl;
+}
 
-         if (m_jsonMode) 
-         {
-            printLogJson(len, logBuff);
-         } 
-         else 
-         {
-            printLogBuff(lvl, ec, len, logBuff);
-         }
 
+inline
+int logdump::dumpMapped( const std::string & fname )
+{
+   logMappedFile lmf;
+
+   if(lmf.open(fname) < 0) return -1;
+
+   std::cerr << fname << "\n";
+
+   char * buffer = lmf.data();
+   while(buffer < lmf.end())
+   {
+      size_t tSz = logHeader::totalSize(buffer);
+
+      logPrioT lvl = logHeader::logLevel(buffer);
+      eventCodeT ec = logHeader::eventCode(buffer);
+      msgLenT len = logHeader::msgLen(buffer);
+
+      if(!selected(lvl, ec, logHeader::timespec(buffer)))
+      {
+         buffer += tSz;
+         continue;
       }
 
-      fclose(fin);
+      //Non-owning pointer into the mapping, no copy needed.
+      bufferPtrT logBuff(bufferPtrT(), buffer);
+
+      if (!logVerify(ec, logBuff, len))
+      {
+         std::cerr << "Log " << fname << " failed verification on code=" << ec <<  " at byte=" << buffer - lmf.data() <<". File possibly corrupt.  Exiting." << std::endl;
+         return -1;
+      }
+
+      if (m_jsonMode)
+      {
+         printLogJson(std::cout, len, logBuff);
+      }
+      else
+      {
+         printLogBuff(std::cout, lvl, ec, len, logBuff);
+      }
+
+      buffer += tSz;
    }
 
    return 0;
 }
 
 inline
-void logdump::printLogBuff( const logPrioT & lvl,
-                            const eventCodeT & ec,
-                            const msgLenT & len,
-                            bufferPtrT & logBuff
-                          )
+bool logdump::selected( logPrioT lvl,
+                        eventCodeT ec,
+                        const timespecX & ts
+                      )
 {
-   static_cast<void>(len); //be unused
+   if(lvl > m_level) return false;
 
-   if(ec == eventCodes::GIT_STATE)
+   if(m_codes.size() > 0)
    {
-      if(git_state::repoName(logHeader::messageBuffer(logBuff)) == "MagAOX")
+      bool found = false;
+      for(size_t c = 0; c< m_codes.size(); ++c)
       {
-         for(int i=0;i<80;++i) std::cout << '-';
-         std::cout << "\n\t\t\t\t SOFTWARE RESTART\n";
-         for(int i=0;i<80;++i) std::cout << '-';
-         std::cout << '\n';
+         if( m_codes[c] == ec )
+         {
+            found = true;
+            break;
+         }
       }
 
+      if(!found) return false;
    }
 
-   if(lvl < logPrio::LOG_INFO)
+   if(m_useStart && ts < m_start) return false;
+
+   if(m_useEnd && !(ts < m_end)) return false;
+
+   return true;
+}
+
+inline
+int logdump::parseTime( timespecX & ts,
+                        const std::string & str
+                      )
+{
+   std::string digits;
+   for(size_t n = 0; n < str.size(); ++n)
    {
-      if(lvl == logPrio::LOG_EMERGENCY)
+      if(isdigit(str[n])) digits += str[n];
+   }
+
+   //Need at least the date
+   if(digits.size() < 8) return -1;
+
+   if(digits.size() < 14) digits.append(14 - digits.size(), '0');
+
+   tm tmst;
+   memset(&tmst, 0, sizeof(tmst));
+   tmst.tm_year = std::stoi(digits.substr(0,4)) - 1900;
+   tmst.tm_mon = std::stoi(digits.substr(4,2)) - 1;
+   tmst.tm_mday = std::stoi(digits.substr(6,2));
+   tmst.tm_hour = std::stoi(digits.substr(8,2));
+   tmst.tm_min = std::stoi(digits.substr(10,2));
+   tmst.tm_sec = std::stoi(digits.substr(12,2));
+
+   std::string frac = digits.substr(14);
+   frac.resize(9, '0');
+
+   ts.time_s = timegm(&tmst);
+   ts.time_ns = std::stoi(frac);
+
+   return 0;
+}
+
+inline
+int logdump::followLogs()
+{
+   std::string dir = m_dir;
+   std::vector<std::string> apps = m_prefixes;
+
+   //A single file is followed as its application, from its directory.
+   if(m_file != "")
+   {
+      if(m_file.find('/') == std::string::npos)
       {
-         std::cout << "\033[104m\033[91m\033[5m\033[1m";
+         m_file = m_dir + '/' + m_file;
       }
 
-      if(lvl == logPrio::LOG_ALERT)
+      logFileName lfn(m_file);
+      if(!lfn.valid())
       {
-         std::cout << "\033[101m\033[5m";
+         std::cerr << "logdump: can not follow " << m_file << ", which is not named as a log file.\n";
+         return -1;
       }
 
-      if(lvl == logPrio::LOG_CRITICAL)
+      dir = m_file.substr(0, m_file.rfind('/'));
+      apps = std::vector<std::string>({lfn.appName()});
+   }
+
+   //Show some context before the new entries, as the old polling follower did.
+   timespecX start;
+   if(m_useStart)
+   {
+      start = m_start;
+   }
+   else
+   {
+      timespec now;
+      clock_gettime(CLOCK_REALTIME, &now);
+      start = timespecX(now.tv_sec - 10, now.tv_nsec);
+   }
+
+   logFollower lf;
+
+   if(lf.latency(m_latency) < 0)
+   {
+      std::cerr << "logdump: invalid latency: " << m_latency << "\n";
+      return -1;
+   }
+
+   if(lf.open(dir, m_ext, apps, start) < 0) return -1;
+
+   //The app name is only needed to tell more than one apart
+   bool showApp = (apps.size() != 1);
+
+   std::vector<logFollower::entry> entries;
+   while(true)
+   {
+      entries.clear();
+      if(lf.poll(entries, -1) < 0) return -1;
+
+      for(size_t n = 0; n < entries.size(); ++n)
       {
-         std::cout << "\033[41m\033[1m";
+         bufferPtrT & logBuff = entries[n].m_logBuff;
+
+         logPrioT lvl = logHeader::logLevel(logBuff);
+         eventCodeT ec = logHeader::eventCode(logBuff);
+         msgLenT len = logHeader::msgLen(logBuff);
+
+         if(!selected(lvl, ec, logHeader::timespec(logBuff))) continue;
+
+         //One bad entry shouldn't stop all the others from being followed.
+         if (!logVerify(ec, logBuff, len))
+         {
+            std::cerr << "Log of " << entries[n].m_appName << " failed verification on code=" << ec << ". File possibly corrupt.  Skipping." << std::endl;
+            continue;
+         }
+
+         if (m_jsonMode)
+         {
+            printLogJson(std::cout, entries[n].m_appName, len, logBuff);
+         }
+         else
+         {
+            printLogBuff(std::cout, lvl, ec, len, logBuff, (showApp ? entries[n].m_appName : ""));
+         }
       }
+   }
 
-      if(lvl == logPrio::LOG_ERROR)
+   return -1;
+}
+
+inline
+void logdump::decodeSegment( dumpSegment & seg )
+{
+   std::ostringstream os;
+
+   char * data = seg.m_file->data();
+   char * buffer = data + seg.m_begin;
+   char * end = data + seg.m_end;
+
+   while(buffer < end)
+   {
+      size_t tSz = logHeader::totalSize(buffer);
+
+      logPrioT lvl = logHeader::logLevel(buffer);
+      eventCodeT ec = logHeader::eventCode(buffer);
+      msgLenT len = logHeader::msgLen(buffer);
+      timespecX ts = logHeader::timespec(buffer);
+
+      if(!selected(lvl, ec, ts))
       {
-         std::cout << "\033[91m\033[1m";
+         buffer += tSz;
+         continue;
       }
 
-      if(lvl == logPrio::LOG_WARNING)
+      bufferPtrT logBuff(bufferPtrT(), buffer);
+
+      if (!logVerify(ec, logBuff, len))
       {
-         std::cout << "\033[93m\033[1m";
+         seg.m_failed = true;
+         seg.m_failOffset = buffer - data;
+         seg.m_failCode = ec;
+         break;
       }
 
-      if(lvl == logPrio::LOG_NOTICE)
+      if (m_jsonMode)
       {
-         std::cout << "\033[1m";
+         printLogJson(os, len, logBuff);
       }
+      else
+      {
+         printLogBuff(os, lvl, ec, len, logBuff);
+      }
+
+      seg.m_ts.push_back(ts);
+      seg.m_ends.push_back(os.tellp());
 
+      buffer += tSz;
    }
 
-   logStdFormat( std::cout, logBuff);
+   seg.m_text = os.str();
+}
+
+inline
+void logdump::segmentWorker()
+{
+   std::unique_lock<std::mutex> lock(m_streamMutex);
+
+   while(!m_stop)
+   {
+      //Work on the stream whose next segment is earliest, so the merge is not kept waiting.
+      size_t best = m_streams.size();
+      timespecX bestTime;
+      bool remaining = false;
+
+      for(size_t s = 0; s < m_streams.size(); ++s)
+      {
+         dumpStream & st = m_streams[s];
+
+         if(st.m_nextStart >= st.m_segs.size()) continue;
+
+         remaining = true;
+
+         if(st.m_nextStart - st.m_nextConsume >= m_streamDepth) continue;
+
+         dumpSegment & seg = st.m_segs[st.m_nextStart];
+         timespecX segTime = logHeader::timespec(seg.m_file->data() + seg.m_begin);
+
+         if(best == m_streams.size() || segTime < bestTime)
+         {
+            best = s;
+            bestTime = segTime;
+         }
+      }
 
-   std::cout << "\033[0m";
-   std::cout << std::endl;
+      if(!remaining) return;
+
+      if(best == m_streams.size())
+      {
+         m_streamCond.wait(lock);
+         continue;
+      }
+
+      dumpSegment & seg = m_streams[best].m_segs[m_streams[best].m_nextStart];
+      ++m_streams[best].m_nextStart;
+
+      lock.unlock();
+      decodeSegment(seg);
+      lock.lock();
+
+      seg.m_done = true;
+      m_streamCond.notify_all();
+   }
 }
 
+inline
+int logdump::waitSegment( size_t s )
+{
+   dumpStream & st = m_streams[s];
+
+   std::unique_lock<std::mutex> lock(m_streamMutex);
+
+   while(st.m_nextConsume < st.m_segs.size())
+   {
+      dumpSegment & seg = st.m_segs[st.m_nextConsume];
+
+      while(!seg.m_done) m_streamCond.wait(lock);
+
+      if(seg.m_ts.size() > 0) return 0;
+
+      if(seg.m_failed) return -1;
+
+      //Nothing passed the filters, move on.
+      ++st.m_nextConsume;
+      m_streamCond.notify_all();
+   }
+
+   return 1;
+}
 
 inline
-void logdump::printLogJson( const msgLenT & len,
-                            bufferPtrT & logBuff
-                          )
+void logdump::releaseSegment( size_t s )
 {
-   static_cast<void>(len); //be unused
-   logJsonFormat(std::cout, logBuff);
-   std::cout << std::endl;
+   dumpStream & st = m_streams[s];
+
+   std::lock_guard<std::mutex> lock(m_streamMutex);
+
+   dumpSegment & seg = st.m_segs[st.m_nextConsume];
 
+   std::string().swap(seg.m_text);
+   std::vector<timespecX>().swap(seg.m_ts);
+   std::vector<size_t>().swap(seg.m_ends);
+
+   ++st.m_nextConsume;
+   m_streamCond.notify_all();
 }
 
+inline
+void logdump::reportFailure( const dumpSegment & seg )
+{
+   std::cerr << "Log " << seg.m_file->fileName() << " failed verification on code=" << seg.m_failCode <<  " at byte=" << seg.m_failOffset <<". File possibly corrupt.  Exiting." << std::endl;
+}
 
-int logdump::gettimes(std::vector<std::string> & logs)
+inline
+int logdump::executeParallel( std::vector<std::vector<std::string>> & logs )
 {
-   for(size_t i=logs.size() - m_nfiles; i < logs.size(); ++i)
+   m_streams.clear();
+   m_streams.resize(logs.size());
+   m_stop = false;
+
+   //Map the files and load their indexes in parallel, since a file without an index has to be scanned.
+   std::vector<std::pair<size_t, size_t>> flist;
+   for(size_t s = 0; s < logs.size(); ++s)
    {
-      std::string fname = logs[i];
-      FILE * fin;
+      m_streams[s].m_files.resize(logs[s].size());
+      for(size_t f = 0; f < logs[s].size(); ++f) flist.push_back({s,f});
+   }
+
+   std::atomic<size_t> nextFile {0};
+   std::atomic<int> openErrors {0};
+
+   std::vector<std::thread> threads;
+   for(unsigned n = 0; n < m_threads; ++n)
+   {
+      threads.emplace_back( [&]()
+      {
+         size_t f;
+         while( (f = nextFile++) < flist.size() )
+         {
+            std::unique_ptr<logMappedFile> lmf(new logMappedFile);
+            if(lmf->open(logs[flist[f].first][flist[f].second]) < 0)
+            {
+               ++openErrors;
+               continue;
+            }
+            m_streams[flist[f].first].m_files[flist[f].second] = std::move(lmf);
+         }
+      });
+   }
+   for(auto & t : threads) t.join();
+   threads.clear();
+
+   if(openErrors > 0) return -1;
+
+   //Split the files into segments at entry boundaries, which are the offsets in the index.
+   for(auto & st : m_streams)
+   {
+      for(auto & lmf : st.m_files)
+      {
+         if(lmf->size() == 0) continue;
+         if(m_useStart && lmf->endTime() < m_start) continue;
+         if(m_useEnd && !(lmf->startTime() < m_end)) continue;
+
+         size_t begin = 0;
+         if(m_useStart) begin = lmf->seek(m_start) - lmf->data();
+
+         size_t end = lmf->size();
+         if(m_useEnd) end = lmf->seek(m_end) - lmf->data();
+
+         dumpSegment seg;
+         seg.m_file = lmf.get();
+         seg.m_begin = begin;
+
+         for(auto & ie : lmf->index().entries())
+         {
+            if(ie.m_offset <= seg.m_begin) continue;
+            if(ie.m_offset >= end) break;
 
-      bufferPtrT head(new char[logHeader::maxHeadSize]);
+            if(ie.m_offset - seg.m_begin >= m_chunkSize)
+            {
+               seg.m_end = ie.m_offset;
+               st.m_segs.push_back(seg);
+               seg.m_begin = ie.m_offset;
+            }
+         }
 
-      fin = fopen(fname.c_str(), "rb");
+         seg.m_end = end;
+         if(seg.m_begin < seg.m_end) st.m_segs.push_back(seg);
+      }
+   }
 
-      //--> get size here!!
-      //off_t finSize = mx::ioutils::fileSize( fileno(fin) );
-      
-      
-      off_t totNrd = 0;
-      
-      //size_t buffSz = 0;
+   m_streamDepth = 2*m_threads/m_streams.size();
+   if(m_streamDepth < 2) m_streamDepth = 2;
 
-      //Read firs header
+   for(unsigned n = 0; n < m_threads; ++n) threads.emplace_back(&logdump::segmentWorker, this);
 
-      int nrd;
+   //k-way merge.  The heap holds the timestamp of the next entry of each stream, with ties going to the first stream.
+   typedef std::pair<timespecX, size_t> headT;
+   auto later = [](const headT & a, const headT & b)
+   {
+      if(a.first == b.first) return a.second > b.second;
+      return b.first < a.first;
+   };
+   std::priority_queue<headT, std::vector<headT>, decltype(later)> heads(later);
+
+   std::vector<size_t> rec(m_streams.size(), 0);
+
+   int rv = 0;
 
-      ///\todo check for errors on all reads . . .
-         
-      //Read next header
-      nrd = fread( head.get(), sizeof(char), logHeader::minHeadSize, fin);
-      if(nrd == 0)
+   for(size_t s = 0; s < m_streams.size(); ++s)
+   {
+      int w = waitSegment(s);
+      if(w == 0) heads.push({m_streams[s].m_segs[m_streams[s].m_nextConsume].m_ts[0], s});
+      else if(w < 0)
       {
-         std::cerr << "got no header\n";
-         return 0;
+         reportFailure(m_streams[s].m_segs[m_streams[s].m_nextConsume]);
+         rv = -1;
+         break;
       }
+   }
+
+   while(rv == 0 && !heads.empty())
+   {
+      size_t s = heads.top().second;
+      heads.pop();
+
+      dumpSegment & seg = m_streams[s].m_segs[m_streams[s].m_nextConsume];
 
-      if( logHeader::msgLen0(head) == logHeader::MAX_LEN0-1)
+      //Write all the entries of this stream which come before the next entry of any other stream at once.
+      size_t r0 = rec[s];
+      size_t r1 = r0 + 1;
+      if(heads.empty()) r1 = seg.m_ts.size();
+      else
       {
-         //Intermediate size message, read two more bytes
-         nrd = fread( head.get() + logHeader::minHeadSize, sizeof(char), sizeof(msgLen1T), fin);
+         while(r1 < seg.m_ts.size() && !later({seg.m_ts[r1], s}, heads.top())) ++r1;
       }
-      else if( logHeader::msgLen0(head) == logHeader::MAX_LEN0)
+
+      size_t st = (r0 == 0) ? 0 : seg.m_ends[r0-1];
+      std::cout.write(seg.m_text.data() + st, seg.m_ends[r1-1] - st);
+
+      if(r1 < seg.m_ts.size())
       {
-         //Large size message: read 8 more bytes
-         nrd = fread( head.get() + logHeader::minHeadSize, sizeof(char), sizeof(msgLen2T), fin);
+         rec[s] = r1;
+         heads.push({seg.m_ts[r1], s});
+         continue;
       }
 
-      //logPrioT lvl = logHeader::logLevel(head);
-      //eventCodeT ec = logHeader::eventCode(head);
-      msgLenT len = logHeader::msgLen(head);
-      timespecX ts0 = logHeader::timespec(head);
-      //size_t hSz = logHeader::headerSize(head);
+      rec[s] = 0;
 
-      uint32_t nRecords = 1;
-      fseek(fin, len, SEEK_CUR);
+      if(seg.m_failed)
+      {
+         reportFailure(seg);
+         rv = -1;
+         break;
+      }
 
-      timespecX ts;
+      releaseSegment(s);
 
-      while(!feof(fin)) //<--This should be an exit condition controlled by loop logic, not feof.
+      int w = waitSegment(s);
+      if(w == 0) heads.push({m_streams[s].m_segs[m_streams[s].m_nextConsume].m_ts[0], s});
+      else if(w < 0)
       {
-         int nrd;
+         reportFailure(m_streams[s].m_segs[m_streams[s].m_nextConsume]);
+         rv = -1;
+      }
+   }
 
-         //Read next header
-         nrd = fread( head.get(), sizeof(char), logHeader::minHeadSize, fin);
-         if(nrd == 0)
-         {
-            break;
-         }
-         nRecords += 1;
+   std::cout.flush();
 
-         //We got here without any data, probably means time to get a new file.
-         if(nrd == 0) break;
+   {
+      std::lock_guard<std::mutex> lock(m_streamMutex);
+      m_stop = true;
+   }
+   m_streamCond.notify_all();
 
-         totNrd += nrd;
-         
-         if( logHeader::msgLen0(head) == logHeader::MAX_LEN0-1)
-         {
-            //Intermediate size message, read two more bytes
-            nrd = fread( head.get() + logHeader::minHeadSize, sizeof(char), sizeof(msgLen1T), fin);
-         }
-         else if( logHeader::msgLen0(head) == logHeader::MAX_LEN0)
-         {
-            //Large size message: read 8 more bytes
-            nrd = fread( head.get() + logHeader::minHeadSize, sizeof(char), sizeof(msgLen2T), fin);
-         }
+   for(auto & t : threads) t.join();
 
-         //lvl = logHeader::logLevel(head);
-         //ec = logHeader::eventCode(head);
-         len = logHeader::msgLen(head);
-         ts = logHeader::timespec(head);
-         //hSz = logHeader::headerSize(head);
-         
-         fseek(fin, len, SEEK_CUR);
+   m_streams.clear();
 
+   return rv;
+}
 
+int logdump::gettimes(std::vector<std::string> & logs)
+{
+   for(size_t i=logs.size() - m_nfiles; i < logs.size(); ++i)
+   {
+      std::string fname = logs[i];
+
+      //The bounds come from the index if there is one, otherwise from a scan of the headers.
+      logMappedFile lmf;
+      if(lmf.open(fname) < 0) return -1;
+
+      if(lmf.index().nRecords() == 0)
+      {
+         std::cerr << "got no header\n";
+         return 0;
       }
 
-      fclose(fin);
+      timespecX ts0 = lmf.startTime();
+      timespecX ts = lmf.endTime();
+      uint64_t nRecords = lmf.index().nRecords();
 
       double t0 = ts0.time_s + ts0.time_ns/1e9;
       double t = ts.time_s + ts.time_ns/1e9;
@@ -0,0 +1,187 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include "../logdump.hpp"
+#include "../../../libMagAOX/logger/tests/testIntLog.hpp"
+
+namespace logdump_tests
+{
+
+/// Write text logs for one application, rotating files every maxLogSize bytes.  The time of entry n is t0+dt*n milliseconds.
+void writeTextLog( const std::string & dir,  ///< [in] the directory to write to
+                   const std::string & name, ///< [in] the app name of the logs
+                   int N,                    ///< [in] the number of entries
+                   int t0,                   ///< [in] the time of the first entry, in seconds
+                   int dt,                   ///< [in] the time between entries, in milliseconds
+                   size_t maxLogSize,        ///< [in] the maximum file size
+                   bool writeIndex           ///< [in] whether to write an index with each file
+                 )
+{
+   MagAOX::logger::logFileRaw lfr;
+   lfr.logPath(dir);
+   lfr.logName(name);
+   lfr.maxLogSize(maxLogSize);
+   lfr.writeIndex(writeIndex);
+
+   std::vector<flatlogs::bufferPtrT> bufs; //entries must remain valid until flushed
+   for(int n = 0; n < N; ++n)
+   {
+      int64_t t = t0*1000LL + dt*(int64_t)n;
+
+      flatlogs::bufferPtrT buf;
+      flatlogs::logHeader::createLog<text_log>(buf, flatlogs::timespecX(t/1000, (t%1000)*1000000), name + " entry " + std::to_string(n), logPrio::LOG_NOTICE + (n % 3));
+
+      lfr.writeLog(buf);
+      bufs.push_back(buf);
+      if(n % 100 == 0)
+      {
+         lfr.flush();
+         bufs.clear();
+      }
+   }
+   lfr.close();
+}
+
+/// A logdump run without the configuration system, which returns what it wrote to std::cout.
+struct logdumpTest : public logdump
+{
+   logdumpTest( const std::string & dir,
+                const std::vector<std::string> & apps,
+                unsigned threads,
+                size_t chunkSize
+              )
+   {
+      m_dir = dir;
+      m_ext = std::string(".") + MAGAOX_default_logExt;
+      m_prefixes = apps;
+      m_threads = threads;
+      m_chunkSize = chunkSize;
+   }
+
+   using logdump::m_jsonMode;
+   using logdump::m_level;
+   using logdump::m_useStart;
+   using logdump::m_start;
+   using logdump::m_useEnd;
+   using logdump::m_end;
+
+   int m_rv {0}; ///< The return value of execute
+
+   std::string dump()
+   {
+      std::ostringstream os;
+      std::streambuf * sb = std::cout.rdbuf(os.rdbuf());
+      m_rv = execute();
+      std::cout.rdbuf(sb);
+
+      return os.str();
+   }
+};
+
+/// Dump serially and in parallel with the same options, checking the outputs are identical
+void checkParallel( const std::string & dir,
+                    const std::string & app,
+                    bool json,
+                    bool window
+                  )
+{
+   logdumpTest ser(dir, {app}, 0, 0);
+   ser.m_jsonMode = json;
+   if(window)
+   {
+      ser.m_level = logPrio::LOG_INFO;
+      ser.m_useStart = true;
+      ser.m_start = flatlogs::timespecX(1003, 500000000);
+      ser.m_useEnd = true;
+      ser.m_end = flatlogs::timespecX(1017, 0);
+   }
+
+   std::string serial = ser.dump();
+   REQUIRE( ser.m_rv == 0 );
+   REQUIRE( serial.size() > 0 );
+
+   for(unsigned threads : {1, 3, 8})
+   {
+      for(size_t chunkSize : {256, 4096, 1048576})
+      {
+         logdumpTest par(dir, {app}, threads, chunkSize);
+         par.m_jsonMode = ser.m_jsonMode;
+         par.m_level = ser.m_level;
+         par.m_useStart = ser.m_useStart;
+         par.m_start = ser.m_start;
+         par.m_useEnd = ser.m_useEnd;
+         par.m_end = ser.m_end;
+
+         std::string parallel = par.dump();
+         REQUIRE( par.m_rv == 0 );
+         REQUIRE( parallel == serial );
+      }
+   }
+}
+
+SCENARIO( "Dumping logs in parallel", "[logdump]" )
+{
+   GIVEN("an application's logs in several files")
+   {
+      testLogDir tmpDir("logdump_test");
+      std::string dir = tmpDir.m_path;
+      REQUIRE( dir != "" );
+
+      writeTextLog(dir, "appA", 5000, 1000, 4, 40000, true);
+      writeTextLog(dir, "appB", 3000, 1000, 7, 30000, false);
+
+      WHEN("the files are indexed")
+      {
+         checkParallel(dir, "appA", false, false);
+      }
+
+      WHEN("the files are not indexed")
+      {
+         checkParallel(dir, "appB", false, false);
+      }
+
+      WHEN("dumping JSON")
+      {
+         checkParallel(dir, "appA", true, false);
+      }
+
+      WHEN("filtering by level and time")
+      {
+         checkParallel(dir, "appA", false, true);
+         checkParallel(dir, "appB", true, true);
+      }
+
+      WHEN("merging two applications")
+      {
+         logdumpTest par(dir, {"appA", "appB"}, 4, 4096);
+         std::string merged = par.dump();
+         REQUIRE( par.m_rv == 0 );
+
+         logdumpTest serA(dir, {"appA"}, 0, 0);
+         logdumpTest serB(dir, {"appB"}, 0, 0);
+         std::string a = serA.dump();
+         std::string b = serB.dump();
+
+         //Every entry of both, in time order, with appA first at equal times.  Entry i of appA is at 4*i ms, and j of appB at 7*j ms.
+         std::istringstream isa(a), isb(b);
+         std::vector<std::string> la, lb;
+         std::string line;
+         while(std::getline(isa, line)) la.push_back(line + "\n");
+         while(std::getline(isb, line)) lb.push_back(line + "\n");
+         REQUIRE( la.size() == 5000 );
+         REQUIRE( lb.size() == 3000 );
+
+         std::string expected;
+         size_t i = 0, j = 0;
+         while(i < la.size() || j < lb.size())
+         {
+            if(j == lb.size() || (i < la.size() && 4*i <= 7*j)) expected += la[i++];
+            else expected += lb[j++];
+         }
+
+         REQUIRE( merged == expected );
+      }
+   }
+}
+
+} //namespace logdump_tests
@@ -12,9 +12,6 @@ int main(int argc, char **argv)
 {
    logstream ls;
 
-   std::set<std::string> appNames;
-   return ls.getAppsWithLogs( appNames );
-   
-   return 0;
+   return ls.streamLogs();
 
 }
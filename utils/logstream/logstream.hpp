@@ -7,8 +7,8 @@
 
 #include <iostream>
 #include <string>
-#include <set>
-#include <map>
+#include <vector>
+#include <ctime>
 
 #include <mx/ioutils/fileUtils.hpp>
 
@@ -18,6 +18,9 @@
 //using namespace flatlogs;
 
 
+/// Stream the logs of all applications to the terminal, merged in time order.
+/** The logs are followed with a logFollower, so new entries are printed as soon as they are written.
+  */
 class logstream //: public mx::app::application
 {
 
@@ -26,156 +29,80 @@ public:
    std::string m_dir {"/opt/MagAOX/logs/"};
    std::string m_ext {".binlog"};
       
-   unsigned long m_pauseTime {1000};
-   int m_fileCheckInterval {5}; ///When following, number of loops to wait before checking for a new file.  Default is 20 (5 seconds).
+   unsigned long m_pauseTime {1000}; ///< The longest time to wait for entries before checking the minute header, msec.
    
-   logPrioT m_level {logPrio::LOG_DEFAULT};
+   double m_latency {0.1}; ///< The time in seconds entries are held so the applications are merged in time order.
    
-   double m_startTime {0};
+   logPrioT m_level {logPrio::LOG_DEFAULT};
    
    bool m_shutdown {false};
    
-   ///Mutex for disk access
-   std::mutex m_diskMutex;
-   
-   ///Mutex for locking stream access
-   std::mutex m_streamMutex;
-   
-   struct s_logThread
-   {
-      std::string m_appName;
-      
-      std::shared_ptr<std::thread>  m_thread; ///< Thread for monitoring a single log 
-      
-      logstream * m_lstr {nullptr};            ///< a pointer to a logstream instance (normally this)
-      
-      ///C'tor to create the thread object
-      s_logThread() : m_thread {std::shared_ptr<std::thread>(new std::thread)}
-      {
-      }      
-      
-      s_logThread( const s_logThread & cplt ) : m_appName{cplt.m_appName}, m_thread {cplt.m_thread}, m_lstr {cplt.m_lstr}
-      {
-      }
-
-   };
-   
-   std::vector<s_logThread> m_logThreads; 
-   
-   
-   struct s_logEntry
-   {
-      std::string m_appName;
-      
-      bufferPtrT logBuff;
-      
-      explicit s_logEntry( const std::string & appName ) : m_appName{appName}
-      {
-      }
-      
-   };
-   
-   std::multimap<double, s_logEntry> m_logStream;
-   
 public: 
    
    logstream();
    
-   int getAppsWithLogs( std::set<std::string> & appNames );
+   /// Follow the logs of all applications, printing entries until shutdown.
+   /**
+     * \returns 0 on shutdown
+     * \returns -1 on error
+     */
+   int streamLogs();
    
    void printLogBuff( const std::string & appName,
                       bufferPtrT & logBuff
                     );
-   
-   private:
-   
-   ///Log thread starter, called by logThreadStart on thread construction.  Calls logThreadExec.
-   static void internal_logThreadStart( s_logThread* lt /**< [in] a pointer to an s_logThread structure */);
-
-public:
-   /// Start the log thread.
-   int logThreadStart( size_t thno /**< [in] the thread to start */);
-
-   /// Execute the log thread.
-   void logThreadExec( const std::string & appName /**< [in] the application name to monitor */ );
 };
 
 inline 
 logstream::logstream()
 {
-   m_startTime = mx::sys::get_curr_time();
 }
 
 inline
-int logstream::getAppsWithLogs( std::set<std::string> & appNames )
+int logstream::streamLogs()
 {
-   std::vector<std::string> allfiles = mx::ioutils::getFileNames( m_dir, m_ext);
+   //Show the last 10 seconds of entries
+   timespec now;
+   clock_gettime(CLOCK_REALTIME, &now);
    
-   std::cerr << "Found " << allfiles.size() << " files\n";
+   logFollower lf;
+   lf.latency(m_latency);
    
-   for(size_t i=0; i< allfiles.size(); ++i)
-   {
-      std::string fullPath = allfiles[i].substr(0, allfiles[i].size()-31);
-      size_t spos = fullPath.rfind('/');
-      if(spos == std::string::npos) spos = 0;
-      else ++spos;
-      
-      std::string appName = fullPath.substr(spos);
-      
-      appNames.insert(appName);
-      
-   }
-   
-   m_logThreads.resize( appNames.size() );
-   
-   size_t n = 0;
-   for(auto it = appNames.begin(); it != appNames.end();it++)
-   {
-      //std::cerr << *it << "\n";
-      m_logThreads[n].m_appName = *it;
-      m_logThreads[n].m_lstr = this;
-      
-      logThreadStart(n);
-      
-      ++n;
-   }
+   if(lf.open(m_dir, m_ext, {}, timespecX(now.tv_sec - 10, now.tv_nsec)) < 0) return -1;
    
-   //m_shutdown = true;
+   std::cerr << "Following " << lf.appNames().size() << " apps\n";
    
    int last_min = -1;
    bool min_printed = false;
+   std::vector<logFollower::entry> entries;
    while(!m_shutdown)
    {
-      if( m_logStream.size() > 0)
-      {
-         auto it=m_logStream.begin();
-         
-         timespecX ts = logHeader::timespec(it->second.logBuff);
+      entries.clear();
+      if(lf.poll(entries, m_pauseTime) < 0) return -1;
       
-         if(ts.minute() != last_min)
+      if( entries.size() > 0)
+      {
+         for(size_t n = 0; n < entries.size(); ++n)
          {
-            char tstr1[25];
-      
-            //strftime(tstr1, 25, "%FT%H:%M:", &bdt);
+            if(logHeader::logLevel(entries[n].m_logBuff) > m_level) continue;
             
-            std::cout << ts.ISO8601DateTimeStr2MinX() << ":\n";
+            timespecX ts = logHeader::timespec(entries[n].m_logBuff);
+         
+            if(ts.minute() != last_min)
+            {
+               std::cout << ts.ISO8601DateTimeStr2MinX() << ":\n";
+               
+               last_min = ts.minute();
+            }
             
-            last_min = ts.minute();
+            printLogBuff(entries[n].m_appName, entries[n].m_logBuff);
          }
          min_printed = false;
          
-         while(it != m_logStream.end())
-         {
-            printLogBuff(it->second.m_appName, it->second.logBuff);
-            
-            m_logStream.erase(it);
-            it = m_logStream.begin();
-         }
+         std::cout.flush();
       }
       else
       {
-         std::this_thread::sleep_for( std::chrono::duration<unsigned long, std::milli>(m_pauseTime));
-         
          tm bdt; //broken down time
          time_t tt = time(0);
          gmtime_r( &tt, &bdt);
@@ -186,7 +113,7 @@ int logstream::getAppsWithLogs( std::set<std::string> & appNames )
       
             strftime(tstr1, 25, "%FT%H:%M:", &bdt);
             
-            std::cout << tstr1 << "\n";
+            std::cout << tstr1 << std::endl;
             
             last_min = bdt.tm_min;
             min_printed = true;
@@ -260,166 +187,4 @@ void logstream::printLogBuff( const std::string & appName,
    std::cout << "\n";
 }
 
-void logstream::internal_logThreadStart( s_logThread* lt )
-{
-   lt->m_lstr->logThreadExec( lt->m_appName );
-}
-
-int logstream::logThreadStart( size_t thno )
-{
-   try
-   {
-      *m_logThreads[thno].m_thread = std::thread( internal_logThreadStart, &m_logThreads[thno]);
-   }
-   catch( const std::exception & e )
-   {
-      //log<software_error>({__FILE__, __LINE__, std::string("exception in log thread startup: ") +e.what()});
-      return -1;
-   }
-   catch( ... )
-   {
-      //log<software_error>({__FILE__, __LINE__, "unknown exception in log thread startup"});
-      return -1;
-   }
-   
-   if(!m_logThreads[thno].m_thread->joinable())
-   {
-      //log<sofware_error>({__FILE__, __LINE__, "log thread did not start"});
-      return -1;
-   }
-   
-   
-   return 0;
-}
-
-void logstream::logThreadExec( const std::string & appName )
-{
-   int counter = m_fileCheckInterval;
-   
-   while(!m_shutdown)
-   {
-      if(counter <  m_fileCheckInterval)
-      {
-         std::this_thread::sleep_for( std::chrono::duration<unsigned long, std::milli>(m_pauseTime));
-         ++counter;
-         continue;
-      }
-      
-      counter = 0;
-      FILE * fin = 0;
-   
-      std::vector<std::string> logs = mx::ioutils::getFileNames( m_dir, appName, "", m_ext);
-
-      std::string fname = logs[logs.size()-1];
-
-      bufferPtrT head(new char[logHeader::maxHeadSize]);
-
-      bufferPtrT logBuff;
-
-      fin = fopen(fname.c_str(), "rb");
-
-      size_t buffSz = 0;
-      while(!feof(fin) && !m_shutdown) //<--This should be an exit condition controlled by loop logic, not feof.
-      {
-         int nrd;
-
-         ///\todo check for errors on all reads . . .
-         nrd = fread( head.get(), sizeof(char), logHeader::minHeadSize, fin);
-         if(nrd == 0)
-         {
-            int check = 0;
-            while(nrd == 0 && !m_shutdown)
-            {
-               //if(appName != "camwfs-avg") std::cerr << appName << " sleeping here \n";
-               std::this_thread::sleep_for( std::chrono::duration<unsigned long, std::milli>(m_pauseTime));
-               clearerr(fin);
-               nrd = fread( head.get(), sizeof(char), logHeader::minHeadSize, fin);
-               if(nrd > 0) break;
-
-               ++check;
-               if(check >= m_fileCheckInterval)
-               {
-                  std::unique_lock<std::mutex> lock(m_diskMutex);
-                  std::this_thread::sleep_for( std::chrono::duration<unsigned long, std::milli>(m_pauseTime)); //Hold the lock for a bit to prevent slamming the disk
-                  //if(appName != "camwfs-avg") std::cerr << appName << " getting files \n";
-                  //Check if a new file exists now.
-                  size_t oldsz = logs.size();
-                  logs = mx::ioutils::getFileNames( m_dir, appName, "", m_ext);
-                  if(logs.size() > oldsz)
-                  {
-                     //new file(s) detected;
-                     break;
-                  }
-                  check = 0;
-               }
-            }
-            
-            if(m_shutdown) break;
-         
-         }
-
-         //We got here without any data, probably means time to get a new file.
-         if(nrd == 0) break;
-
-
-         if( logHeader::msgLen0(head) == logHeader::MAX_LEN0-1)
-         {
-            //Intermediate size message, read two more bytes
-            nrd = fread( head.get() + logHeader::minHeadSize, sizeof(char), sizeof(msgLen1T), fin);
-         }
-         else if( logHeader::msgLen0(head) == logHeader::MAX_LEN0)
-         {
-            //Large size message: read 8 more bytes
-            nrd = fread( head.get() + logHeader::minHeadSize, sizeof(char), sizeof(msgLen2T), fin);
-         }
-
-
-         logPrioT lvl = logHeader::logLevel(head);
-         eventCodeT ec = logHeader::eventCode(head);
-         msgLenT len = logHeader::msgLen(head);
-
-         //Here: check if lvl, eventCode, etc, match what we want.
-         //If not, fseek and loop.
-         if(lvl > m_level)
-         {
-            fseek(fin, len, SEEK_CUR);
-            continue;
-         }
-
-         
-         size_t hSz = logHeader::headerSize(head);
-
-         if( (size_t) hSz + (size_t) len > buffSz )
-         {
-            logBuff = bufferPtrT(new char[hSz + len]);
-         }
-
-         memcpy( logBuff.get(), head.get(), hSz);
-
-         ///\todo what do we do if nrd not equal to expected size?
-         nrd = fread( logBuff.get() + hSz, sizeof(char), len, fin);
-         // If not following, exit loop without printing the incomplete log entry (go on to next file).
-         // If following, wait for it, but also be checking for new log file in case of crash
-
-         //printLogBuff(lvl, ec, len, logBuff);
-
-         timespecX ts = logHeader::timespec(logBuff);
-         double dts = ((double) ts.time_s) + ((double) ts.time_ns)/1e9;
-         
-         if(m_startTime - dts > 10.0) continue;
-         
-         {
-            std::unique_lock<std::mutex> lock(m_streamMutex);
-            auto it = m_logStream.insert( std::pair<double,s_logEntry>(dts, s_logEntry(appName)));
-         
-            it->second.logBuff = logBuff;
-         }
-      }
-
-      fclose(fin);
-   }
-
-}
-
-
 #endif
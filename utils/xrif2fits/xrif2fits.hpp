@@ -11,6 +11,12 @@
 
 #include <xrif/xrif.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 
 
 
@@ -61,7 +67,15 @@ void sigTermHandler( int signum,
 }
 
 /// A utility to stream MagaO-X images from xrif compressed archives to an ImageStreamIO stream.
-/**
+/** Archives are read and decoded by m_threads worker threads while the main thread writes the ones already
+  * decoded, in order.  At most m_depth archives are decoded ahead of the one being written, so memory use is
+  * bounded regardless of how many archives are converted.
+  *
+  * If a time window is given, only the archives which contain frames in it are read.  Archive file names
+  * hold the time of their first frame, so this is decided from the names without opening the files.  Then
+  * the timing data of each archive is decoded first, and the images are decoded only if a frame is in the
+  * window.
+  *
   * \todo finish md doc for xrif2fits
   *
   * \ingroup xrif2fits
@@ -80,32 +94,131 @@ protected:
    std::vector<std::string> m_logDir;
 
    std::vector<std::string> m_telDir;
-   
-   std::string m_outDir = "fits/";   
-   
+
+   std::string m_outDir = "fits/";
+
    bool m_noMeta {false};
-   
+
    bool m_metaOnly {false};
 
    bool m_timesOnly {false};
-   
+
    bool m_cubeMode {false};
 
+   unsigned m_threads {0}; ///< Number of worker threads decoding archives.  Default is 0, in which case the archives are decoded in turn by the main thread.
+
+   bool m_useStart {false}; ///< Whether or not a start time was specified.
+   timespec m_start {0,0}; ///< Only frames acquired at or after this time are written, if m_useStart is true.
+
+   bool m_useEnd {false}; ///< Whether or not an end time was specified.
+   timespec m_end {0,0}; ///< Only frames acquired before this time are written, if m_useEnd is true.
+
    logMap logs;
-   
+
    logMap tels;
 
 protected:
    ///@}
 
+   /// An archive, read and decoded by a worker and then written by the main thread.
+   struct decodedArchive
+   {
+      std::string m_fileName; ///< The full name of the archive.
 
-   xrif_t m_xrif {nullptr};
-   xrif_t m_xrif_timing {nullptr};
+      xrif_t m_xrif {nullptr}; ///< The image data.
+      xrif_t m_xrif_timing {nullptr}; ///< The timing data.
 
+      std::string m_details; ///< The compression details, printed when the archive is written.
 
-public:
+      size_t m_q0 {0}; ///< The first frame in the time window.
+      size_t m_q1 {0}; ///< One past the last frame in the time window.
 
-   ~xrif2fits();
+      bool m_done {false}; ///< Set when the archive has been decoded.
+      int m_rv {0}; ///< 0 if the archive was decoded, -1 on an error.
+
+      decodedArchive( const std::string & fname ) : m_fileName{fname}
+      {
+      }
+
+      ~decodedArchive()
+      {
+         if(m_xrif) xrif_delete(m_xrif);
+         if(m_xrif_timing) xrif_delete(m_xrif_timing);
+      }
+
+      decodedArchive( const decodedArchive & ) = delete;
+      decodedArchive & operator=( const decodedArchive & ) = delete;
+   };
+
+   std::vector<std::unique_ptr<decodedArchive>> m_archives; ///< The archives to convert, released once written.
+   size_t m_nextDecode {0}; ///< The next archive to give to a worker.
+   size_t m_nextWrite {0}; ///< The next archive to be written.
+   size_t m_depth {1}; ///< The maximum number of archives decoded, or being decoded, ahead of the one being written.
+   bool m_stop {false}; ///< Tells the workers to stop.
+   std::mutex m_archiveMutex; ///< Protects the archive state.
+   std::condition_variable m_archiveCond; ///< Signals a change in the archive state.
+
+   /// Parse a time from a string
+   /** The digits of the string are read as YYYYMMDDHHMMSS followed by fractional seconds, so both the file
+     * name format and ISO 8601 (e.g. 2023-01-31T23:59:59.5) are accepted.  The time is UTC.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int parseTime( timespec & ts,           ///< [out] the parsed time
+                  const std::string & str  ///< [in] the string to parse
+                );
+
+   /// Check if an acquisition time is in the time window
+   bool inWindow( const timespec & atime /**< [in] the acquisition time */);
+
+   /// Remove the files which can not have frames in the time window
+   /** Each archive holds the frames from the time in its name up to the time in the name of the camera's
+     * next archive.
+     */
+   void selectFiles();
+
+   /// Add the log meta data to put in the headers of an archive's frames
+   void metaSpecs( std::vector<logMeta> & logMetas, ///< [out] the meta data entries
+                   const logFileName & lfn          ///< [in] the archive name
+                 );
+
+   /// Read an archive and decode its timing data, and its images if any frames are in the time window.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int decodeArchive( decodedArchive & da /**< [in/out] the archive */);
+
+   /// The worker thread loop.  Decodes archives until all are done or m_stop is set.
+   void decodeWorker();
+
+   /// Wait for an archive to be decoded, decoding it here if there are no workers.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int waitArchive( size_t n /**< [in] the archive */);
+
+   /// Write the frames of a decoded archive.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int writeArchive( decodedArchive & da,     ///< [in] the archive
+                     std::ofstream & metaOut  ///< [in] the meta data file
+                   );
+
+   /// Exposure time and start of exposure for a frame
+   /**
+     * \returns the exposure time, -1 if not known
+     */
+   double exposure( timespec & stime,            ///< [out] the start of the exposure, calculated as atime-exptime
+                    const logFileName & lfn,     ///< [in] the archive name
+                    const timespec & atime       ///< [in] the acquisition time of the exposure
+                  );
+
+public:
 
    virtual void setupConfig();
 
@@ -113,26 +226,12 @@ public:
 
    virtual int execute();
 
-   virtual int writeFloat( int n,
+   virtual int writeFloat( decodedArchive & da,
                            logFileName & lfn,
                            std::vector<logMeta> & logMetas
                          );
 };
 
-inline
-xrif2fits::~xrif2fits()
-{
-   if(m_xrif)
-   {
-      xrif_delete(m_xrif);
-   }
-   
-   if(m_xrif_timing)
-   {
-      xrif_delete(m_xrif_timing);
-   }
-}
-
 inline
 void xrif2fits::setupConfig()
 {
@@ -142,12 +241,16 @@ void xrif2fits::setupConfig()
    config.add("teldir","t", "teldir" , argType::Required, "", "teldir", false,  "vector<string>", "Directory(ies) for telemetry files.");
 
    config.add("outDir","D", "outDir" , argType::Required, "", "outDir", false,  "string", "The directory in which to write output files.  Default is ./fits/.");
-   
+
    config.add("metaOnly","", "metaOnly" , argType::True, "", "metaOnly", false,  "bool", "If true, output only meta data, without decoding images.  Default is false.");
    config.add("time","T", "time" , argType::True, "", "time", false,  "bool", "time span mode: output one line per input file in the format [filename] [start time] [end time] [number of frames], with ISO 8601 timestamps");
-   
+
    config.add("noMeta","", "noMeta" , argType::True, "", "noMeta", false,  "bool", "If true, the meta data file is not written (FITS headers will still be).  Default is false.");
    config.add("cubeMode","C", "cubeMode" , argType::True, "", "cubeMode", false,  "bool", "If true, the archive is written as a FITS cube with minimal header.  Default is false.");
+
+   config.add("threads","j", "threads" , argType::Required, "", "threads", false,  "int", "Number of worker threads decoding archives while others are written.  Default: 0, archives are decoded in turn.");
+   config.add("start","s", "start" , argType::Required, "", "start", false,  "string", "Only write frames acquired at or after this UTC time, either ISO 8601 (YYYY-MM-DDTHH:MM:SS.SSS) or YYYYMMDDHHMMSS.");
+   config.add("end","E", "end" , argType::Required, "", "end", false,  "string", "Only write frames acquired before this UTC time, either ISO 8601 (YYYY-MM-DDTHH:MM:SS.SSS) or YYYYMMDDHHMMSS.");
 }
 
 inline
@@ -162,6 +265,23 @@ void xrif2fits::loadConfig()
    config(m_timesOnly, "time");
    config(m_noMeta, "noMeta");
    config(m_cubeMode, "cubeMode");
+   config(m_threads, "threads");
+
+   std::string tmpstr;
+   config(tmpstr, "start");
+   if(tmpstr != "")
+   {
+      if(parseTime(m_start, tmpstr) < 0) std::cerr << " (" << invokedName << "): invalid start time: " << tmpstr << "\n";
+      else m_useStart = true;
+   }
+
+   tmpstr = "";
+   config(tmpstr, "end");
+   if(tmpstr != "")
+   {
+      if(parseTime(m_end, tmpstr) < 0) std::cerr << " (" << invokedName << "): invalid end time: " << tmpstr << "\n";
+      else m_useEnd = true;
+   }
 }
 
 inline
@@ -220,6 +340,8 @@ int xrif2fits::execute()
       }
    }
 
+   if(m_useStart || m_useEnd) selectFiles();
+
    if(m_files.size() == 0)
    {
       std::cerr << " (" << invokedName << "): No files found.\n";
@@ -234,43 +356,18 @@ int xrif2fits::execute()
    {
       //Make sure the slash exists, then mkdir
       if(m_outDir[m_outDir.size()-1] != '/') m_outDir += '/';
-      
+
       if (!m_timesOnly) {
          mkdir(m_outDir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
       }
    }
-   
-   xrif_error_t rv;
-   rv = xrif_new(&m_xrif);
-
-   if(rv < 0)
-   {
-      std::cerr << " (" << invokedName << "): Error allocating xrif.\n";
-      return -1;
-   }
-
-   rv = xrif_new(&m_xrif_timing);
-
-   if(rv < 0)
-   {
-      std::cerr << " (" << invokedName << "): Error allocating xrif_timing.\n";
-      return -1;
-   }
-   
-   char header[XRIF_HEADER_SIZE];
-
-   
-      
-   
 
-   
-   
    std::cerr << "loading log file names . . .\n";
    for(size_t n=0; n < m_logDir.size(); ++n)
    {
       logs.loadAppToFileMap( m_logDir[n], ".binlog");
    }
-   
+
    std::cerr << "loading telemetry file names . . .\n";
    for(size_t n=0; n < m_telDir.size(); ++n)
    {
@@ -291,509 +388,724 @@ int xrif2fits::execute()
       }
       metaOut << "\n";*/
    }
-      
-   //Now de-compress and load the frames
-   //Only decompressing the number of files needed, and only copying the number of frames needed
+
+   m_archives.clear();
    for(size_t n=0; n < m_files.size(); ++n)
    {
-      logFileName lfn(m_files[n]);
-
-      std::vector<logMeta> logMetas;
-      logMetas.push_back(logMetaSpec({"observers", telem_observer::eventCode, "email"}));
-      logMetas.push_back(logMetaSpec({"observers", telem_observer::eventCode, "obsName"}));
-
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catObj"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catRA"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catDec"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catEp"}));
-   
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "ra"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "dec"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "epoch"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "el"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "am"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "ha"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_teldata::eventCode, "pa"}));
-
-      logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "state"}));
-      logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "gain"}));
-      logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "multcoef"}));
-      logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "limit"}));
-
-      logMetas.push_back(logMetaSpec({"fxngenmodwfs", telem_fxngen::eventCode, "C1freq"}));
-      logMetas.push_back(logMetaSpec({"fxngenmodwfs", telem_fxngen::eventCode, "C2freq"}));
-   
-      logMetas.push_back(logMetaSpec({"stagebs", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"stagebs", telem_stage::eventCode, "preset"}));
-      logMetas.push_back(logMetaSpec({"stagebs", telem_zaber::eventCode, "pos"}));
-
-      logMetas.push_back(logMetaSpec({"fwscind", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwscind", telem_stage::eventCode, "preset"}));
-
-      logMetas.push_back(logMetaSpec({"fwpupil", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwpupil", telem_stage::eventCode, "preset"}));
-      
-      logMetas.push_back(logMetaSpec({"fwfpm", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwfpm", telem_stage::eventCode, "preset"}));
-   
-      logMetas.push_back(logMetaSpec({"fwlowfs", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwlowfs", telem_stage::eventCode, "preset"}));
-
-      logMetas.push_back(logMetaSpec({"fwlyot", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwlyot", telem_stage::eventCode, "preset"}));
-   
-      logMetas.push_back(logMetaSpec({"stagescibs", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"stagescibs", telem_stage::eventCode, "preset"}));
-      logMetas.push_back(logMetaSpec({"stagescibs", telem_zaber::eventCode, "pos"}));
-
-      logMetas.push_back(logMetaSpec({"fwsci1", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwsci1", telem_stage::eventCode, "preset"}));
-      
-      logMetas.push_back(logMetaSpec({"fwsci2", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwsci2", telem_stage::eventCode, "preset"}));
-
-      logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "fps"));
-      logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "xbin"));
-      logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "ybin"));
-      logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "emGain"));
-      
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "exptime"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "fps"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "mode"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "xcen"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "ycen"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "width"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "xbin"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "ybin"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "emGain"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "adcSpeed"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "temp"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "shutterState"));
-
-      std::string channel = lfn.appName().substr(3);
-
-      // For channels with associated focus stages, report those positions as headers
-      if (channel == "sci1" || channel == "sci2" || channel == "lowfs") {
-         logMetas.push_back(logMetaSpec({"stage" + channel, telem_stage::eventCode, "presetName"}));
-         logMetas.push_back(logMetaSpec({"stage" + channel, telem_stage::eventCode, "preset"}));
-         logMetas.push_back(logMetaSpec({"stage" + channel, telem_zaber::eventCode, "pos"}));
-      }
+      m_archives.emplace_back(new decodedArchive(m_files[n]));
+   }
 
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "modulating"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "trigger"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "frequency"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "separations"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "angles"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "amplitudes"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "crosses"}));
+   m_nextDecode = 0;
+   m_nextWrite = 0;
+   m_stop = false;
+   m_depth = (m_threads > 0) ? 2*m_threads : 1;
 
-      logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "state"}));
-      logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "gain"}));
-      logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "multcoef"}));
-      logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "limit"}));
+   std::vector<std::thread> threads;
+   for(unsigned n = 0; n < m_threads; ++n) threads.emplace_back(&xrif2fits::decodeWorker, this);
 
+   //Now write the archives in order as they are decoded
+   int rv = 0;
+   for(size_t n=0; n < m_archives.size(); ++n)
+   {
       if(g_timeToDie == true) break; //check before going on
 
-      
-      
-      tels.loadFiles(lfn.appName(), lfn.timestamp());
-      
-      logMeta exptimeMeta(logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "exptime"));
-
-      if (!m_timesOnly) {
-
-         std::cout << "******************************************************\n";
-         std::cout << "* xrif2fits: decoding for " << lfn.appName() << " (" + m_files[n] << ")\n";
-         std::cout << "******************************************************\n";
-      }
-      
-      FILE * fp_xrif = fopen(m_files[n].c_str(), "rb");
-      if(fp_xrif == nullptr)
+      if(waitArchive(n) < 0)
       {
-         std::cerr << " (" << invokedName << "): Error opening " << m_files[n] << "\n";
-         std::cerr << " (" << invokedName << "): " << strerror(errno) << "\n";
-         return -1;
+         rv = -1;
+         break;
       }
 
-      size_t nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
-      if(nr != XRIF_HEADER_SIZE)
-      {
-         std::cerr << " (" << invokedName << "): Error reading header of " << m_files[n] << "\n";
-         fclose(fp_xrif);
-         return -1;
-      }
+      if(g_timeToDie == true) break; //check after the decode
 
-      uint32_t header_size;
-      xrif_read_header(m_xrif, &header_size , header);
-      if (!m_timesOnly) {
-         std::cout << "xrif compression details:\n";
-         std::cout << "  difference method:  " << xrif_difference_method_string(m_xrif->difference_method) << '\n';
-         std::cout << "  reorder method:     " << xrif_reorder_method_string(m_xrif->reorder_method) << '\n';
-         std::cout << "  compression method: " << xrif_compress_method_string( m_xrif->compress_method) << '\n';
-         if(m_xrif->compress_method == XRIF_COMPRESS_LZ4)
-         {
-            std::cout << "    LZ4 acceleration: " << m_xrif->lz4_acceleration << '\n';
-         }
-         std::cout << "  dimensions:         " << m_xrif->width << " x " << m_xrif->height << " x " << m_xrif->depth << " x " << m_xrif->frames << "\n";
-         std::cout << "  raw size:           " << m_xrif->width*m_xrif->height*m_xrif->depth*m_xrif->frames*m_xrif->data_size << " bytes\n";
-         std::cout << "  encoded size:       " << m_xrif->compressed_size << " bytes\n";
-         std::cout << "  ratio:              " << ((double)m_xrif->compressed_size) / (m_xrif->width*m_xrif->height*m_xrif->depth*m_xrif->frames*m_xrif->data_size) << '\n';
-      }
-      rv = xrif_allocate_raw(m_xrif); 
-      if( rv != XRIF_NOERROR)
+      if(writeArchive(*m_archives[n], metaOut) < 0)
       {
-         std::cerr << " (" << invokedName << "): Error allocating raw buffer for " << m_files[n] << "\n";
-         std::cerr << "\t code: " << rv << "\n";
-         return -1;
-      }
-      
-      rv = xrif_allocate_reordered(m_xrif); 
-      if(rv != XRIF_NOERROR)
-      {
-         std::cerr << " (" << invokedName << "): Error allocating reordered buffer for " << m_files[n] << "\n";
-         std::cerr << "\t code: " << rv << "\n";
-         return -1;
+         rv = -1;
+         break;
       }
 
-      nr = fread(m_xrif->raw_buffer, 1, m_xrif->compressed_size, fp_xrif);
-      
-      if(nr != m_xrif->compressed_size)
+      //Free the buffers, and let the workers start another.
+      std::unique_lock<std::mutex> lock(m_archiveMutex);
+      m_archives[n].reset();
+      ++m_nextWrite;
+      m_archiveCond.notify_all();
+   }
+
+   {
+      std::unique_lock<std::mutex> lock(m_archiveMutex);
+      m_stop = true;
+      m_archiveCond.notify_all();
+   }
+
+   for(auto & t : threads) t.join();
+
+   m_archives.clear();
+
+   if(!m_noMeta) metaOut.close();
+
+   if(rv < 0) return rv;
+
+   std::cerr << " (" << invokedName << "): exited normally.\n";
+
+   return 0;
+}
+
+inline
+int xrif2fits::parseTime( timespec & ts,
+                          const std::string & str
+                        )
+{
+   std::string digits;
+   for(size_t n = 0; n < str.size(); ++n)
+   {
+      if(isdigit(str[n])) digits += str[n];
+   }
+
+   //Need at least the date
+   if(digits.size() < 8) return -1;
+
+   if(digits.size() < 14) digits.append(14 - digits.size(), '0');
+
+   tm tmst;
+   memset(&tmst, 0, sizeof(tmst));
+   tmst.tm_year = std::stoi(digits.substr(0,4)) - 1900;
+   tmst.tm_mon = std::stoi(digits.substr(4,2)) - 1;
+   tmst.tm_mday = std::stoi(digits.substr(6,2));
+   tmst.tm_hour = std::stoi(digits.substr(8,2));
+   tmst.tm_min = std::stoi(digits.substr(10,2));
+   tmst.tm_sec = std::stoi(digits.substr(12,2));
+
+   std::string frac = digits.substr(14);
+   frac.resize(9, '0');
+
+   ts.tv_sec = timegm(&tmst);
+   ts.tv_nsec = std::stoi(frac);
+
+   return 0;
+}
+
+inline
+bool xrif2fits::inWindow( const timespec & atime )
+{
+   if(m_useStart && atime < m_start) return false;
+
+   if(m_useEnd && !(atime < m_end)) return false;
+
+   return true;
+}
+
+inline
+void xrif2fits::selectFiles()
+{
+   //Order by camera, then time
+   std::vector<logFileName> lfns;
+   std::vector<std::string> keep;
+   for(size_t n = 0; n < m_files.size(); ++n)
+   {
+      logFileName lfn(m_files[n]);
+
+      //If the time isn't in the name, the archive has to be read to know.
+      if(!lfn.valid()) keep.push_back(m_files[n]);
+      else lfns.push_back(lfn);
+   }
+
+   std::sort(lfns.begin(), lfns.end(), [](const logFileName & a, const logFileName & b)
+                                       {
+                                          if(a.appName() != b.appName()) return a.appName() < b.appName();
+                                          return a.timestamp() < b.timestamp();
+                                       });
+
+   for(size_t n = 0; n < lfns.size(); ++n)
+   {
+      timespec first = {(time_t) lfns[n].timestamp().time_s, (long) lfns[n].timestamp().time_ns};
+
+      if(m_useEnd && !(first < m_end)) continue;
+
+      //The frames end before the camera's next archive starts
+      if(m_useStart && n + 1 < lfns.size() && lfns[n+1].appName() == lfns[n].appName())
       {
-         std::cerr << " (" << invokedName << "): Error reading data from " << m_files[n] << "\n";
-         return -1;
+         timespec next = {(time_t) lfns[n+1].timestamp().time_s, (long) lfns[n+1].timestamp().time_ns};
+         if(!(m_start < next)) continue;
       }
 
-      
-      //Now get timing data
-      nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
-      if(nr != XRIF_HEADER_SIZE)
+      keep.push_back(lfns[n].fullName());
+   }
+
+   m_files = keep;
+}
+
+inline
+void xrif2fits::metaSpecs( std::vector<logMeta> & logMetas,
+                           const logFileName & lfn
+                         )
+{
+   logMetas.push_back(logMetaSpec({"observers", telem_observer::eventCode, "email"}));
+   logMetas.push_back(logMetaSpec({"observers", telem_observer::eventCode, "obsName"}));
+
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catObj"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catRA"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catDec"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catEp"}));
+
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "ra"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "dec"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "epoch"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "el"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "am"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "ha"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_teldata::eventCode, "pa"}));
+
+   logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "state"}));
+   logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "gain"}));
+   logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "multcoef"}));
+   logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "limit"}));
+
+   logMetas.push_back(logMetaSpec({"fxngenmodwfs", telem_fxngen::eventCode, "C1freq"}));
+   logMetas.push_back(logMetaSpec({"fxngenmodwfs", telem_fxngen::eventCode, "C2freq"}));
+
+   logMetas.push_back(logMetaSpec({"stagebs", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"stagebs", telem_stage::eventCode, "preset"}));
+   logMetas.push_back(logMetaSpec({"stagebs", telem_zaber::eventCode, "pos"}));
+
+   logMetas.push_back(logMetaSpec({"fwscind", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwscind", telem_stage::eventCode, "preset"}));
+
+   logMetas.push_back(logMetaSpec({"fwpupil", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwpupil", telem_stage::eventCode, "preset"}));
+
+   logMetas.push_back(logMetaSpec({"fwfpm", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwfpm", telem_stage::eventCode, "preset"}));
+
+   logMetas.push_back(logMetaSpec({"fwlowfs", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwlowfs", telem_stage::eventCode, "preset"}));
+
+   logMetas.push_back(logMetaSpec({"fwlyot", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwlyot", telem_stage::eventCode, "preset"}));
+
+   logMetas.push_back(logMetaSpec({"stagescibs", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"stagescibs", telem_stage::eventCode, "preset"}));
+   logMetas.push_back(logMetaSpec({"stagescibs", telem_zaber::eventCode, "pos"}));
+
+   logMetas.push_back(logMetaSpec({"fwsci1", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwsci1", telem_stage::eventCode, "preset"}));
+
+   logMetas.push_back(logMetaSpec({"fwsci2", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwsci2", telem_stage::eventCode, "preset"}));
+
+   logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "fps"));
+   logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "xbin"));
+   logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "ybin"));
+   logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "emGain"));
+
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "exptime"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "fps"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "mode"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "xcen"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "ycen"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "width"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "xbin"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "ybin"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "emGain"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "adcSpeed"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "temp"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "shutterState"));
+
+   std::string channel = lfn.appName().substr(3);
+
+   // For channels with associated focus stages, report those positions as headers
+   if (channel == "sci1" || channel == "sci2" || channel == "lowfs") {
+      logMetas.push_back(logMetaSpec({"stage" + channel, telem_stage::eventCode, "presetName"}));
+      logMetas.push_back(logMetaSpec({"stage" + channel, telem_stage::eventCode, "preset"}));
+      logMetas.push_back(logMetaSpec({"stage" + channel, telem_zaber::eventCode, "pos"}));
+   }
+
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "modulating"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "trigger"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "frequency"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "separations"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "angles"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "amplitudes"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "crosses"}));
+
+   logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "state"}));
+   logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "gain"}));
+   logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "multcoef"}));
+   logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "limit"}));
+}
+
+inline
+int xrif2fits::decodeArchive( decodedArchive & da )
+{
+   char header[XRIF_HEADER_SIZE];
+
+   xrif_error_t rv;
+   rv = xrif_new(&da.m_xrif);
+
+   if(rv < 0)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating xrif.\n";
+      return -1;
+   }
+
+   rv = xrif_new(&da.m_xrif_timing);
+
+   if(rv < 0)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating xrif_timing.\n";
+      return -1;
+   }
+
+   xrif_t xrif = da.m_xrif;
+   xrif_t xrif_timing = da.m_xrif_timing;
+
+   std::ostringstream details;
+
+   FILE * fp_xrif = fopen(da.m_fileName.c_str(), "rb");
+   if(fp_xrif == nullptr)
+   {
+      std::cerr << " (" << invokedName << "): Error opening " << da.m_fileName << "\n";
+      std::cerr << " (" << invokedName << "): " << strerror(errno) << "\n";
+      return -1;
+   }
+
+   size_t nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
+   if(nr != XRIF_HEADER_SIZE)
+   {
+      std::cerr << " (" << invokedName << "): Error reading header of " << da.m_fileName << "\n";
+      fclose(fp_xrif);
+      return -1;
+   }
+
+   uint32_t header_size;
+   xrif_read_header(xrif, &header_size , header);
+
+   details << "xrif compression details:\n";
+   details << "  difference method:  " << xrif_difference_method_string(xrif->difference_method) << '\n';
+   details << "  reorder method:     " << xrif_reorder_method_string(xrif->reorder_method) << '\n';
+   details << "  compression method: " << xrif_compress_method_string( xrif->compress_method) << '\n';
+   if(xrif->compress_method == XRIF_COMPRESS_LZ4)
+   {
+      details << "    LZ4 acceleration: " << xrif->lz4_acceleration << '\n';
+   }
+   details << "  dimensions:         " << xrif->width << " x " << xrif->height << " x " << xrif->depth << " x " << xrif->frames << "\n";
+   details << "  raw size:           " << xrif->width*xrif->height*xrif->depth*xrif->frames*xrif->data_size << " bytes\n";
+   details << "  encoded size:       " << xrif->compressed_size << " bytes\n";
+   details << "  ratio:              " << ((double)xrif->compressed_size) / (xrif->width*xrif->height*xrif->depth*xrif->frames*xrif->data_size) << '\n';
+
+   rv = xrif_allocate_raw(xrif);
+   if( rv != XRIF_NOERROR)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating raw buffer for " << da.m_fileName << "\n";
+      std::cerr << "\t code: " << rv << "\n";
+      fclose(fp_xrif);
+      return -1;
+   }
+
+   rv = xrif_allocate_reordered(xrif);
+   if(rv != XRIF_NOERROR)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating reordered buffer for " << da.m_fileName << "\n";
+      std::cerr << "\t code: " << rv << "\n";
+      fclose(fp_xrif);
+      return -1;
+   }
+
+   nr = fread(xrif->raw_buffer, 1, xrif->compressed_size, fp_xrif);
+
+   if(nr != xrif->compressed_size)
+   {
+      std::cerr << " (" << invokedName << "): Error reading data from " << da.m_fileName << "\n";
+      fclose(fp_xrif);
+      return -1;
+   }
+
+   //Now get timing data
+   nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
+   if(nr != XRIF_HEADER_SIZE)
+   {
+      std::cerr << " (" << invokedName << "): Error reading timing header of " << da.m_fileName << "\n";
+      fclose(fp_xrif);
+      return -1;
+   }
+
+   xrif_read_header(xrif_timing, &header_size , header);
+
+   details << "xrif timing data compression details:\n";
+   details << "  difference method:  " << xrif_difference_method_string(xrif_timing->difference_method) << '\n';
+   details << "  reorder method:     " << xrif_reorder_method_string(xrif_timing->reorder_method) << '\n';
+   details << "  compression method: " << xrif_compress_method_string( xrif_timing->compress_method) << '\n';
+   if(xrif_timing->compress_method == XRIF_COMPRESS_LZ4)
+   {
+      details << "    LZ4 acceleration: " << xrif_timing->lz4_acceleration << '\n';
+   }
+   details << "  dimensions:         " << xrif_timing->width << " x " << xrif_timing->height << " x " << xrif_timing->depth << " x " << xrif_timing->frames << "\n";
+   details << "  raw size:           " << xrif_timing->width*xrif_timing->height*xrif_timing->depth*xrif_timing->frames*xrif_timing->data_size << " bytes\n";
+   details << "  encoded size:       " << xrif_timing->compressed_size << " bytes\n";
+   details << "  ratio:              " << ((double)xrif_timing->compressed_size) / (xrif_timing->width*xrif_timing->height*xrif_timing->depth*xrif_timing->frames*xrif_timing->data_size) << '\n';
+
+   da.m_details = details.str();
+
+   rv = xrif_allocate_raw(xrif_timing);
+   if(rv != XRIF_NOERROR)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating raw buffer for timing data from " << da.m_fileName << "\n";
+      std::cerr << "\t code: " << rv << "\n";
+      fclose(fp_xrif);
+      return -1;
+   }
+
+   rv = xrif_allocate_reordered(xrif_timing);
+   if(rv != XRIF_NOERROR)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating reordered buffer for  timing data from " << da.m_fileName << "\n";
+      std::cerr << "\t code: " << rv << "\n";
+      fclose(fp_xrif);
+      return -1;
+   }
+
+   nr = fread(xrif_timing->raw_buffer, 1, xrif_timing->compressed_size, fp_xrif);
+
+   if(nr != xrif_timing->compressed_size)
+   {
+      std::cerr << " (" << invokedName << "): Error reading timing data from " << da.m_fileName << "\n";
+      fclose(fp_xrif);
+      return -1;
+   }
+
+   fclose(fp_xrif);
+
+   if(g_timeToDie == true) return 0; //check after the long read.
+
+   //The timing data is small, so decode it first to find the frames in the window.
+   rv = xrif_decode(xrif_timing);
+   if(rv != XRIF_NOERROR)
+   {
+      std::cerr << " (" << invokedName << "): Error decoding timing data from " << da.m_fileName << "\n";
+      std::cerr << "\t code: " << rv << "\n";
+      return -1;
+   }
+
+   da.m_q0 = 0;
+   da.m_q1 = xrif->frames;
+
+   if(m_useStart || m_useEnd)
+   {
+      //The frames are in time order
+      da.m_q0 = da.m_q1;
+      for(size_t q = 0; q < xrif->frames; ++q)
       {
-         std::cerr << " (" << invokedName << "): Error reading timing header of " << m_files[n] << "\n";
-         fclose(fp_xrif);
-         return -1;
-      }
-      
-      xrif_read_header(m_xrif_timing, &header_size , header);
+         uint64_t * curr_timing = (uint64_t*) xrif_timing->raw_buffer + 5*q;
+         timespec atime = {(time_t) curr_timing[1], (long) curr_timing[2]};
 
-      if (!m_timesOnly) {
-         std::cout << "xrif timing data compression details:\n";
-         std::cout << "  difference method:  " << xrif_difference_method_string(m_xrif_timing->difference_method) << '\n';
-         std::cout << "  reorder method:     " << xrif_reorder_method_string(m_xrif_timing->reorder_method) << '\n';
-         std::cout << "  compression method: " << xrif_compress_method_string( m_xrif_timing->compress_method) << '\n';
-         if(m_xrif_timing->compress_method == XRIF_COMPRESS_LZ4)
+         if(inWindow(atime))
          {
-            std::cout << "    LZ4 acceleration: " << m_xrif_timing->lz4_acceleration << '\n';
+            if(da.m_q0 == xrif->frames) da.m_q0 = q;
+            da.m_q1 = q + 1;
          }
-         std::cout << "  dimensions:         " << m_xrif_timing->width << " x " << m_xrif_timing->height << " x " << m_xrif_timing->depth << " x " << m_xrif_timing->frames << "\n";
-         std::cout << "  raw size:           " << m_xrif_timing->width*m_xrif_timing->height*m_xrif_timing->depth*m_xrif_timing->frames*m_xrif_timing->data_size << " bytes\n";
-         std::cout << "  encoded size:       " << m_xrif_timing->compressed_size << " bytes\n";
-         std::cout << "  ratio:              " << ((double)m_xrif_timing->compressed_size) / (m_xrif_timing->width*m_xrif_timing->height*m_xrif_timing->depth*m_xrif_timing->frames*m_xrif_timing->data_size) << '\n';
       }
-      rv = xrif_allocate_raw(m_xrif_timing);
-      if(rv != XRIF_NOERROR)
-      {
-         std::cerr << " (" << invokedName << "): Error allocating raw buffer for timing data from " << m_files[n] << "\n";
-         std::cerr << "\t code: " << rv << "\n";
-         return -1;
-      }
-      
-      rv = xrif_allocate_reordered(m_xrif_timing);
+
+      if(da.m_q0 == xrif->frames) da.m_q0 = da.m_q1 = 0;
+   }
+
+   if(!m_metaOnly && !m_timesOnly && da.m_q1 > da.m_q0)
+   {
+      rv = xrif_decode(xrif);
       if(rv != XRIF_NOERROR)
       {
-         std::cerr << " (" << invokedName << "): Error allocating reordered buffer for  timing data from " << m_files[n] << "\n";
+         std::cerr << " (" << invokedName << "): Error decoding image data from " << da.m_fileName << "\n";
          std::cerr << "\t code: " << rv << "\n";
          return -1;
       }
-      
-      nr = fread(m_xrif_timing->raw_buffer, 1, m_xrif_timing->compressed_size, fp_xrif);
-    
-      if(nr != m_xrif_timing->compressed_size)
-      {
-         std::cerr << " (" << invokedName << "): Error reading timing data from " << m_files[n] << "\n";
-         return -1;
-      }
-      
-      fclose(fp_xrif);
+   }
 
-      if(g_timeToDie == true) break; //check after the long read.
+   return 0;
+}
 
-      if(!m_metaOnly)
-      {
-         rv = xrif_decode(m_xrif);
-         if(rv != XRIF_NOERROR)
-         {
-            std::cerr << " (" << invokedName << "): Error decoding image data from " << m_files[n] << "\n";
-            std::cerr << "\t code: " << rv << "\n";
-            return -1;
-         }
-      }
-      
-      rv = xrif_decode(m_xrif_timing); 
-      if(rv != XRIF_NOERROR)
+inline
+void xrif2fits::decodeWorker()
+{
+   std::unique_lock<std::mutex> lock(m_archiveMutex);
+
+   while(!m_stop)
+   {
+      if(m_nextDecode >= m_archives.size()) break;
+
+      if(m_nextDecode >= m_nextWrite + m_depth || g_timeToDie)
       {
-         std::cerr << " (" << invokedName << "): Error decoding timing data from " << m_files[n] << "\n";
-         std::cerr << "\t code: " << rv << "\n";
-         return -1;
+         m_archiveCond.wait_for(lock, std::chrono::milliseconds(100));
+         continue;
       }
-               
-      if(g_timeToDie == true) break; //check after the decompress.
 
+      decodedArchive & da = *m_archives[m_nextDecode];
+      ++m_nextDecode;
 
-      if(m_timesOnly) {
-         std::cout << m_files[n] << " ";
-         double totalExposureTime = 0;
+      lock.unlock();
+      int rv = decodeArchive(da);
+      lock.lock();
 
-         for(xrif_dimension_t q=0; q < m_xrif->frames; ++q)
-         {
-            timespec atime; //This is the acquisition time of the exposure
-            timespec stime = {0,0}; //This is the start time of the exposure, calculated as atime-exptime.
+      da.m_rv = rv;
+      da.m_done = true;
+      m_archiveCond.notify_all();
+   }
+}
 
-            uint64_t * curr_timing = (uint64_t*) m_xrif_timing->raw_buffer + 5*q;
+inline
+int xrif2fits::waitArchive( size_t n )
+{
+   if(m_threads == 0)
+   {
+      decodedArchive & da = *m_archives[n];
+      da.m_rv = decodeArchive(da);
+      da.m_done = true;
+      return da.m_rv;
+   }
 
-            atime.tv_sec = curr_timing[1];
-            atime.tv_nsec = curr_timing[2];
+   std::unique_lock<std::mutex> lock(m_archiveMutex);
+   while(!m_archives[n]->m_done)
+   {
+      m_archiveCond.wait_for(lock, std::chrono::milliseconds(100));
+      if(g_timeToDie) return 0;
+   }
 
-            //We have to bootstrap the exposure time
-            char * prior = nullptr;
-            tels.getPriorLog(prior, lfn.appName(), eventCodes::TELEM_STDCAM, atime);
-            double exptime = -1;
-            if(prior)
-            {
-               char * priorprior = nullptr;
-               exptime = telem_stdcam::exptime(logHeader::messageBuffer(prior));
-               stime = atime-exptime;
-               tels.getPriorLog(priorprior, lfn.appName(), eventCodes::TELEM_STDCAM, stime);
-
-               if(telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) != exptime) ///\todo this needs to check for any log entries between end and start
-               {
-                  std::cerr << "Change in exposure time mid-exposure\n";
-               }
-            }
-            else
-            {
-               std::cerr << "no prior\n";
-            }
-            totalExposureTime += exptime;
+   return m_archives[n]->m_rv;
+}
 
-            std::string timestamp;
-            mx::sys::timeStamp(timestamp, atime);
+inline
+double xrif2fits::exposure( timespec & stime,
+                            const logFileName & lfn,
+                            const timespec & atime
+                          )
+{
+   //We have to bootstrap the exposure time
+   char * prior = nullptr;
+   tels.getPriorLog(prior, lfn.appName(), eventCodes::TELEM_STDCAM, atime);
+   double exptime = -1;
+   if(prior)
+   {
+      char * priorprior = nullptr;
+      exptime = telem_stdcam::exptime(logHeader::messageBuffer(prior));
 
-            std::string dateobs = mx::sys::ISO8601DateTimeStr(atime, 1);
-            if (q == 0) {
-               std::cout << dateobs << " ";
-            }
-            if (q == (m_xrif->frames - 1)) {
-               std::cout << dateobs << " " << totalExposureTime << " " << m_xrif->frames << "\n";
-            }
-         }
-      } else if (m_xrif->type_code == XRIF_TYPECODE_FLOAT)
-      {
-         writeFloat(n, lfn, logMetas);
-      }
-      else
-      {
-      mx::improc::eigenCube<unsigned short> tmpc( (unsigned short*) m_xrif->raw_buffer, m_xrif->width, m_xrif->height, m_xrif->frames);
+      stime = atime-exptime;
+      tels.getPriorLog(priorprior, lfn.appName(), eventCodes::TELEM_STDCAM, stime);
 
-      mx::fits::fitsFile<unsigned short> ff;
-      mx::fits::fitsHeader fh;
-      
-      if(m_cubeMode)
+      //std::cerr << "Exptime: " << telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) << "\n";
+
+      if(telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) != exptime) ///\todo this needs to check for any log entries between end and start
       {
-         std::string outfname = m_outDir + mx::ioutils::pathStem(m_files[n]) + ".fits";
-         ff.write(outfname, tmpc);
+         std::cerr << "Change in exposure time mid-exposure\n";
       }
-      else
-      {
+   }
+   else
+   {
+      std::cerr << "no prior\n";
+   }
+
+   return exptime;
+}
 
-      for( int q=0; q < tmpc.planes(); ++q)
+inline
+int xrif2fits::writeArchive( decodedArchive & da,
+                             std::ofstream & metaOut
+                           )
+{
+   logFileName lfn(da.m_fileName);
+
+   std::vector<logMeta> logMetas;
+   metaSpecs(logMetas, lfn);
+
+   tels.loadFiles(lfn.appName(), lfn.timestamp());
+
+   logMeta exptimeMeta(logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "exptime"));
+
+   if (!m_timesOnly) {
+
+      std::cout << "******************************************************\n";
+      std::cout << "* xrif2fits: decoding for " << lfn.appName() << " (" + da.m_fileName << ")\n";
+      std::cout << "******************************************************\n";
+      std::cout << da.m_details;
+   }
+
+   //No frames in the time window
+   if(da.m_q1 <= da.m_q0) return 0;
+
+   xrif_t xrif = da.m_xrif;
+   xrif_t xrif_timing = da.m_xrif_timing;
+
+   if(m_timesOnly) {
+      std::cout << da.m_fileName << " ";
+      double totalExposureTime = 0;
+
+      for(xrif_dimension_t q=da.m_q0; q < da.m_q1; ++q)
       {
-         uint64_t cnt0;
          timespec atime; //This is the acquisition time of the exposure
-         timespec wtime;
          timespec stime = {0,0}; //This is the start time of the exposure, calculated as atime-exptime.
-      
-         uint64_t * curr_timing = (uint64_t*) m_xrif_timing->raw_buffer + 5*q;
-         
-         cnt0 = curr_timing[0];
-         atime.tv_sec = curr_timing[1];
-         atime.tv_nsec = curr_timing[2]; 
-         wtime.tv_sec = curr_timing[3];
-         wtime.tv_nsec = curr_timing[4];
 
-         //We have to bootstrap the exposure time
-         char * prior = nullptr;
-         tels.getPriorLog(prior, lfn.appName(), eventCodes::TELEM_STDCAM, atime);
-         double exptime = -1;
-         if(prior)
-         {
-            char * priorprior = nullptr;
-            exptime = telem_stdcam::exptime(logHeader::messageBuffer(prior));
-         
-            stime = atime-exptime;
-            tels.getPriorLog(priorprior, lfn.appName(), eventCodes::TELEM_STDCAM, stime);
+         uint64_t * curr_timing = (uint64_t*) xrif_timing->raw_buffer + 5*q;
 
-            //std::cerr << "Exptime: " << telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) << "\n";
+         atime.tv_sec = curr_timing[1];
+         atime.tv_nsec = curr_timing[2];
 
-            if(telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) != exptime) ///\todo this needs to check for any log entries between end and start
-            {
-               std::cerr << "Change in exposure time mid-exposure\n";
-            }
-         }
-         else
-         {
-            std::cerr << "no prior\n";
-         }
-         
-         std::string timestamp;
-         mx::sys::timeStamp(timestamp, atime);
-         std::string outfname = m_outDir + lfn.appName() + "_" + timestamp + ".fits";
+         double exptime = exposure(stime, lfn, atime);
+         totalExposureTime += exptime;
 
-         fh.clear();
-         
          std::string dateobs = mx::sys::ISO8601DateTimeStr(atime, 1);
-         
-         fh.append("DATE-OBS", dateobs, "Date of observation (UTC)");
-         fh.append("INSTRUME", "MagAO-X");
-         fh.append("CAMERA", lfn.appName());
-         fh.append("TELESCOP", "Magellan Clay, Las Campanas Obs.");
-         
-         if(!m_noMeta)
-         {
-            metaOut << dateobs << " " << cnt0 << " " << atime.tv_sec << " " << atime.tv_nsec << " " << wtime.tv_sec << " " << wtime.tv_nsec << " ";
+         if (q == da.m_q0) {
+            std::cout << dateobs << " ";
          }
-         
-         if(exptime > -1)
-         {
-            //First output exposure time
-            //fh.append(exptimeMeta.card(tels,stime,atime));
-            if(!m_noMeta) metaOut << exptimeMeta.value(tels, stime, atime);
-
-            //Then output each value in turn
-            for(size_t u=0;u<logMetas.size();++u)
-            {
-               mx::fits::fitsHeaderCard fc = logMetas[u].card(tels, stime, atime);
-               fh.append(fc);
-               if(!m_noMeta) metaOut << " " << logMetas[u].value(tels, stime, atime) ;
-            }         
+         if (q == (da.m_q1 - 1)) {
+            std::cout << dateobs << " " << totalExposureTime << " " << da.m_q1 - da.m_q0 << "\n";
          }
+      }
+   } else if (xrif->type_code == XRIF_TYPECODE_FLOAT)
+   {
+      writeFloat(da, lfn, logMetas);
+   }
+   else
+   {
+   mx::improc::eigenCube<unsigned short> tmpc( (unsigned short*) xrif->raw_buffer, xrif->width, xrif->height, xrif->frames);
 
+   mx::fits::fitsFile<unsigned short> ff;
+   mx::fits::fitsHeader fh;
 
-         fh.append("FRAMENO", cnt0);
-         fh.append("ACQSEC", atime.tv_sec);
-         fh.append("ACQNSEC", atime.tv_nsec);
-         fh.append("WRTSEC", wtime.tv_sec);
-         fh.append("WRTNSEC", wtime.tv_nsec);
+   if(m_cubeMode)
+   {
+      std::string outfname = m_outDir + mx::ioutils::pathStem(da.m_fileName) + ".fits";
 
+      //Only the frames in the time window
+      mx::improc::eigenCube<unsigned short> subc( (unsigned short*) xrif->raw_buffer + da.m_q0*xrif->width*xrif->height, xrif->width, xrif->height, da.m_q1-da.m_q0);
+      ff.write(outfname, subc);
+   }
+   else
+   {
 
-         if(!m_noMeta) metaOut << "\n";
+   for( int q=da.m_q0; q < (int) da.m_q1; ++q)
+   {
+      uint64_t cnt0;
+      timespec atime; //This is the acquisition time of the exposure
+      timespec wtime;
+      timespec stime = {0,0}; //This is the start time of the exposure, calculated as atime-exptime.
 
+      uint64_t * curr_timing = (uint64_t*) xrif_timing->raw_buffer + 5*q;
 
-         if(!m_metaOnly)
-         {
-            mx::improc::eigenImage<unsigned short> im = tmpc.image(q);
-            ff.write(outfname, tmpc.image(q), fh);
-         }
+      cnt0 = curr_timing[0];
+      atime.tv_sec = curr_timing[1];
+      atime.tv_nsec = curr_timing[2];
+      wtime.tv_sec = curr_timing[3];
+      wtime.tv_nsec = curr_timing[4];
+
+      double exptime = exposure(stime, lfn, atime);
+
+      std::string timestamp;
+      mx::sys::timeStamp(timestamp, atime);
+      std::string outfname = m_outDir + lfn.appName() + "_" + timestamp + ".fits";
 
+      fh.clear();
+
+      std::string dateobs = mx::sys::ISO8601DateTimeStr(atime, 1);
+
+      fh.append("DATE-OBS", dateobs, "Date of observation (UTC)");
+      fh.append("INSTRUME", "MagAO-X");
+      fh.append("CAMERA", lfn.appName());
+      fh.append("TELESCOP", "Magellan Clay, Las Campanas Obs.");
+
+      if(!m_noMeta)
+      {
+         metaOut << dateobs << " " << cnt0 << " " << atime.tv_sec << " " << atime.tv_nsec << " " << wtime.tv_sec << " " << wtime.tv_nsec << " ";
       }
+
+      if(exptime > -1)
+      {
+         //First output exposure time
+         //fh.append(exptimeMeta.card(tels,stime,atime));
+         if(!m_noMeta) metaOut << exptimeMeta.value(tels, stime, atime);
+
+         //Then output each value in turn, looking each up once for both outputs
+         for(size_t u=0;u<logMetas.size();++u)
+         {
+            std::string vstr = logMetas[u].value(tels, stime, atime);
+            fh.append(logMetas[u].card(vstr));
+            if(!m_noMeta) metaOut << " " << vstr;
+         }
       }
-      //Below is for cubes
-      /*
-      outname = m_files[n];
-      ext = outname.find(".xrif");
-      outname.replace( ext, 5, ".time");
-      
-      std::ofstream fout;
-      fout.open(outname);
-      fout << "#cnt0   atime-sec  atime-nsec wtime-sec  wtime-nsec\n";
-      for(int i=0; i< tmpc.planes(); ++i)
+
+
+      fh.append("FRAMENO", cnt0);
+      fh.append("ACQSEC", atime.tv_sec);
+      fh.append("ACQNSEC", atime.tv_nsec);
+      fh.append("WRTSEC", wtime.tv_sec);
+      fh.append("WRTNSEC", wtime.tv_nsec);
+
+
+      if(!m_noMeta) metaOut << "\n";
+
+
+      if(!m_metaOnly)
       {
-         uint64_t * curr_timing = (uint64_t*) m_xrif_timing->raw_buffer + 5*i;
-         
-         fout << curr_timing[0] << " " << curr_timing[1] << " " << curr_timing[2] << "  " << curr_timing[3] << " " << curr_timing[4] << "\n";
-      }*/
-   }
+         ff.write(outfname, tmpc.image(q), fh);
+      }
 
    }
-   if(!m_noMeta) metaOut.close();
-   
-   std::cerr << " (" << invokedName << "): exited normally.\n";
+   }
+   }
 
-   
    return 0;
 }
 
 inline
-int xrif2fits::writeFloat( int n,
+int xrif2fits::writeFloat( decodedArchive & da,
                            logFileName & lfn,
                            std::vector<logMeta> & logMetas
                          )
 {
-   mx::improc::eigenCube<float> tmpc( (float*) m_xrif->raw_buffer, m_xrif->width, m_xrif->height, m_xrif->frames);
+   xrif_t xrif = da.m_xrif;
+   xrif_t xrif_timing = da.m_xrif_timing;
+
+   mx::improc::eigenCube<float> tmpc( (float*) xrif->raw_buffer, xrif->width, xrif->height, xrif->frames);
 
       mx::fits::fitsFile<float> ff;
       mx::fits::fitsHeader fh;
-      
+
       if(m_cubeMode)
       {
-         std::string outfname = m_outDir + mx::ioutils::pathStem(m_files[n]) + ".fits";
-         ff.write(outfname, tmpc);
+         std::string outfname = m_outDir + mx::ioutils::pathStem(da.m_fileName) + ".fits";
+
+         //Only the frames in the time window
+         mx::improc::eigenCube<float> subc( (float*) xrif->raw_buffer + da.m_q0*xrif->width*xrif->height, xrif->width, xrif->height, da.m_q1-da.m_q0);
+         ff.write(outfname, subc);
       }
       else
       {
 
-      for( int q=0; q < tmpc.planes(); ++q)
+      for( int q=da.m_q0; q < (int) da.m_q1; ++q)
       {
          uint64_t cnt0;
          timespec atime; //This is the acquisition time of the exposure
          timespec wtime;
          timespec stime = {0,0}; //This is the start time of the exposure, calculated as atime-exptime.
-      
-         uint64_t * curr_timing = (uint64_t*) m_xrif_timing->raw_buffer + 5*q;
-         
+
+         uint64_t * curr_timing = (uint64_t*) xrif_timing->raw_buffer + 5*q;
+
          cnt0 = curr_timing[0];
          atime.tv_sec = curr_timing[1];
-         atime.tv_nsec = curr_timing[2]; 
+         atime.tv_nsec = curr_timing[2];
          wtime.tv_sec = curr_timing[3];
          wtime.tv_nsec = curr_timing[4];
 
-         //We have to bootstrap the exposure time
-         char * prior = nullptr;
-         tels.getPriorLog(prior, lfn.appName(), eventCodes::TELEM_STDCAM, atime);
-         double exptime = -1;
-         if(prior)
-         {
-            char * priorprior = nullptr;
-            exptime = telem_stdcam::exptime(logHeader::messageBuffer(prior));
-         
-            stime = atime-exptime;
-            tels.getPriorLog(priorprior, lfn.appName(), eventCodes::TELEM_STDCAM, stime);
-
-            //std::cerr << "Exptime: " << telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) << "\n";
-
-            if(telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) != exptime) ///\todo this needs to check for any log entries between end and start
-            {
-               std::cerr << "Change in exposure time mid-exposure\n";
-            }
-         }
-         else
-         {
-            std::cerr << "no prior\n";
-         }
+         double exptime = exposure(stime, lfn, atime);
 
          //timespecX midexp = mx::meanTimespec( atime, stime);
-         
+
          std::string timestamp;
          mx::sys::timeStamp(timestamp, atime);
          std::string outfname = m_outDir + lfn.appName() + "_" + timestamp + ".fits";
 
          fh.clear();
-         
+
          std::string dateobs = mx::sys::ISO8601DateTimeStr(atime, 1);
-         
+
          fh.append("DATE-OBS", dateobs, "Date of obs. YYYY-mm-ddTHH:MM:SS");
          fh.append("INSTRUME", "MagAO-X " + lfn.appName());
          fh.append("TELESCOP", "Magellan Clay, Las Campanas Obs.");
-                  
+
          if(exptime > -1)
          {
             //Then output each value in turn
@@ -801,9 +1113,9 @@ int xrif2fits::writeFloat( int n,
             {
                mx::fits::fitsHeaderCard fc = logMetas[u].card(tels, stime, atime);
                fh.append(fc);
-            }         
+            }
          }
-         
+
          fh.append("FRAMENO", cnt0);
          fh.append("ACQSEC", atime.tv_sec);
          fh.append("ACQNSEC", atime.tv_nsec);
@@ -811,10 +1123,9 @@ int xrif2fits::writeFloat( int n,
          fh.append("WRTNSEC", wtime.tv_nsec);
 
 
-         mx::improc::eigenImage<float> im = tmpc.image(q);
          ff.write(outfname, tmpc.image(q), fh);
       }}
-      
+
    return 0;
 }
 